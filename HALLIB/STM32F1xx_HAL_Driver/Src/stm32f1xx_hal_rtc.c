@@ -229,7 +229,7 @@ static HAL_StatusTypeDef  RTC_EnterInitMode(RTC_HandleTypeDef *hrtc);
 static HAL_StatusTypeDef  RTC_ExitInitMode(RTC_HandleTypeDef *hrtc);
 static uint8_t            RTC_ByteToBcd2(uint8_t Value);
 static uint8_t            RTC_Bcd2ToByte(uint8_t Value);
-static uint8_t            RTC_IsLeapYear(uint16_t nYear);
+static uint32_t           RTC_DaysFromCivil(uint32_t nYear, uint32_t nMonth, uint32_t nDay);
 static void               RTC_DateUpdate(RTC_HandleTypeDef *hrtc, uint32_t DayElapsed);
 static uint8_t            RTC_WeekDayNum(uint32_t nYear, uint8_t nMonth, uint8_t nDay);
 
@@ -1774,128 +1774,70 @@ static uint8_t RTC_Bcd2ToByte(uint8_t Value)
   return (tmp + (Value & (uint8_t)0x0F));
 }
 
+/**
+  * @brief  Converts a date to a day number.
+  * @param  nYear   year, offset from 2000 as stored in RTC_DateTypeDef
+  * @param  nMonth  month (1..12)
+  * @param  nDay    day of month (1..31)
+  * @note   Days are counted from 0000-03-01 of the proleptic Gregorian
+  *         calendar. Starting the year in March puts the leap day at the end
+  *         of the year so month lengths follow a fixed pattern.
+  * @retval Day number
+  */
+static uint32_t RTC_DaysFromCivil(uint32_t nYear, uint32_t nMonth, uint32_t nDay)
+{
+  uint32_t year = 2000U + nYear;
+  uint32_t era = 0U, yoe = 0U, doy = 0U;
+
+  if (nMonth <= 2U)
+  {
+    year--;
+    nMonth += 12U;
+  }
+
+  era = year / 400U;
+  yoe = year - (era * 400U);                              /* [0, 399]   */
+  doy = (((153U * (nMonth - 3U)) + 2U) / 5U) + nDay - 1U; /* [0, 365]   */
+
+  return (era * 146097U) + (yoe * 365U) + (yoe / 4U) - (yoe / 100U) + doy;
+}
+
 /**
   * @brief  Updates date when time is 23:59:59.
   * @param  hrtc   pointer to a RTC_HandleTypeDef structure that contains
   *                the configuration information for RTC.
   * @param  DayElapsed: Number of days elapsed from last date update
+  * @note   The new date is computed in constant time whatever DayElapsed is.
   * @retval None
   */
 static void RTC_DateUpdate(RTC_HandleTypeDef *hrtc, uint32_t DayElapsed)
 {
+  uint32_t days = 0U, era = 0U, doe = 0U, yoe = 0U, doy = 0U, mp = 0U;
   uint32_t year = 0U, month = 0U, day = 0U;
-  uint32_t loop = 0U;
 
-  /* Get the current year*/
-  year = hrtc->DateToUpdate.Year;
+  days = RTC_DaysFromCivil(hrtc->DateToUpdate.Year, hrtc->DateToUpdate.Month, hrtc->DateToUpdate.Date) + DayElapsed;
 
-  /* Get the current month and day */
-  month = hrtc->DateToUpdate.Month;
-  day = hrtc->DateToUpdate.Date;
+  /* Split the day number into 400-year era, year of era and day of year */
+  era = days / 146097U;
+  doe = days - (era * 146097U);                                                   /* [0, 146096] */
+  yoe = (doe - (doe / 1460U) + (doe / 36524U) - (doe / 146096U)) / 365U;          /* [0, 399]    */
+  doy = doe - ((365U * yoe) + (yoe / 4U) - (yoe / 100U));                         /* [0, 365]    */
 
-  for (loop = 0U; loop < DayElapsed; loop++)
-  {
-    if ((month == 1U) || (month == 3U) || (month == 5U) || (month == 7U) || \
-        (month == 8U) || (month == 10U) || (month == 12U))
-    {
-      if (day < 31U)
-      {
-        day++;
-      }
-      /* Date structure member: day = 31 */
-      else
-      {
-        if (month != 12U)
-        {
-          month++;
-          day = 1U;
-        }
-        /* Date structure member: day = 31 & month =12 */
-        else
-        {
-          month = 1U;
-          day = 1U;
-          year++;
-        }
-      }
-    }
-    else if ((month == 4U) || (month == 6U) || (month == 9U) || (month == 11U))
-    {
-      if (day < 30U)
-      {
-        day++;
-      }
-      /* Date structure member: day = 30 */
-      else
-      {
-        month++;
-        day = 1U;
-      }
-    }
-    else if (month == 2U)
-    {
-      if (day < 28U)
-      {
-        day++;
-      }
-      else if (day == 28U)
-      {
-        /* Leap year */
-        if (RTC_IsLeapYear(year))
-        {
-          day++;
-        }
-        else
-        {
-          month++;
-          day = 1U;
-        }
-      }
-      else if (day == 29U)
-      {
-        month++;
-        day = 1U;
-      }
-    }
-  }
+  /* Month and day counted from March */
+  mp = ((5U * doy) + 2U) / 153U;                                                  /* [0, 11]     */
+  day = doy - (((153U * mp) + 2U) / 5U) + 1U;
+  month = (mp < 10U) ? (mp + 3U) : (mp - 9U);
+  year = (era * 400U) + yoe + ((month <= 2U) ? 1U : 0U);
 
   /* Update year */
-  hrtc->DateToUpdate.Year = year;
+  hrtc->DateToUpdate.Year = year - 2000U;
 
   /* Update day and month */
   hrtc->DateToUpdate.Month = month;
   hrtc->DateToUpdate.Date = day;
 
   /* Update day of the week */
-  hrtc->DateToUpdate.WeekDay = RTC_WeekDayNum(year, month, day);
-}
-
-/**
-  * @brief  Check whether the passed year is Leap or not.
-  * @param  nYear  year to check
-  * @retval 1: leap year
-  *         0: not leap year
-  */
-static uint8_t RTC_IsLeapYear(uint16_t nYear)
-{
-  if ((nYear % 4U) != 0U)
-  {
-    return 0U;
-  }
-
-  if ((nYear % 100U) != 0U)
-  {
-    return 1U;
-  }
-
-  if ((nYear % 400U) == 0U)
-  {
-    return 1U;
-  }
-  else
-  {
-    return 0U;
-  }
+  hrtc->DateToUpdate.WeekDay = (uint8_t)((days + 3U) % 7U);
 }
 
 /**
@@ -1915,22 +1857,8 @@ static uint8_t RTC_IsLeapYear(uint16_t nYear)
   */
 static uint8_t RTC_WeekDayNum(uint32_t nYear, uint8_t nMonth, uint8_t nDay)
 {
-  uint32_t year = 0U, weekday = 0U;
-
-  year = 2000U + nYear;
-
-  if (nMonth < 3U)
-  {
-    /*D = { [(23 x month)/9] + day + 4 + year + [(year-1)/4] - [(year-1)/100] + [(year-1)/400] } mod 7*/
-    weekday = (((23U * nMonth) / 9U) + nDay + 4U + year + ((year - 1U) / 4U) - ((year - 1U) / 100U) + ((year - 1U) / 400U)) % 7U;
-  }
-  else
-  {
-    /*D = { [(23 x month)/9] + day + 4 + year + [year/4] - [year/100] + [year/400] - 2 } mod 7*/
-    weekday = (((23U * nMonth) / 9U) + nDay + 4U + year + (year / 4U) - (year / 100U) + (year / 400U) - 2U) % 7U;
-  }
-
-  return (uint8_t)weekday;
+  /* 0000-03-01 was a Wednesday */
+  return (uint8_t)((RTC_DaysFromCivil(nYear, nMonth, nDay) + 3U) % 7U);
 }
 
 /**
@@ -12,7 +12,9 @@
 #include <stdint.h>
 #include <rthw.h>
 #include <rtthread.h>
+#include "stm32f1xx_hal.h"
 #include <console.h>
+#include <sysclk.h>
 
 /**
  * @brief 动态内存heap
@@ -31,13 +33,6 @@
     #define HEAP_END                       STM32_SRAM1_END
 #endif
 
-#define _SCB_BASE       (0xE000E010UL)
-#define _SYSTICK_CTRL   (*(rt_uint32_t *)(_SCB_BASE + 0x0))
-#define _SYSTICK_LOAD   (*(rt_uint32_t *)(_SCB_BASE + 0x4))
-#define _SYSTICK_VAL    (*(rt_uint32_t *)(_SCB_BASE + 0x8))
-#define _SYSTICK_CALIB  (*(rt_uint32_t *)(_SCB_BASE + 0xC))
-#define _SYSTICK_PRI    (*(rt_uint8_t  *)(0xE000ED23UL))
-
 // Updates the variable SystemCoreClock and must be called 
 // whenever the core clock is changed during program execution.
 extern void SystemCoreClockUpdate(void);
@@ -47,21 +42,6 @@ extern void SystemCoreClockUpdate(void);
 // core clock.
 extern uint32_t SystemCoreClock;
 
-static uint32_t _SysTick_Config(rt_uint32_t ticks)
-{
-    if ((ticks - 1) > 0xFFFFFF)
-    {
-        return 1;
-    }
-    
-    _SYSTICK_LOAD = ticks - 1; 
-    _SYSTICK_PRI = 0xFF;
-    _SYSTICK_VAL  = 0;
-    _SYSTICK_CTRL = 0x07;  
-    
-    return 0;
-}
-
 #if defined(RT_USING_USER_MAIN) && defined(RT_USING_HEAP) && defined(RT_USING_DYNAMIC_HEAP)
 #define RT_HEAP_SIZE 1024
 static uint32_t rt_heap[RT_HEAP_SIZE];     // heap default size: 4K(1024 * 4)
@@ -84,8 +64,11 @@ void rt_hw_board_init()
     /* System Clock Update */
     SystemCoreClockUpdate();
     
-    /* System Tick Configuration */
-    _SysTick_Config(SystemCoreClock / RT_TICK_PER_SECOND);
+    /* HAL 初始化，SysTick 由 HAL_InitTick（timebase.c）按 RT_TICK_PER_SECOND 配置 */
+    HAL_Init();
+
+    /* HSE + PLL 切到默认主频，失败时保持 HSI */
+    sysclk_init();
 
     /* Call components board initial (use INIT_BOARD_EXPORT()) */
 #ifdef RT_USING_COMPONENTS_INIT
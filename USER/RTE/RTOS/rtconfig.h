@@ -64,6 +64,36 @@
 // </c>
 // </h>
 
+// <h>Profiling Configuration
+// <c1>Using DWT cycle counter profiling
+//  <i>probe and interrupt latency histograms, msh command prof; turns on RT_USING_HOOK
+//  <i>adds histogram work to every interrupt, leave off in production images
+//#define RT_USING_PROF
+// </c>
+// <o>the number of user probes <1-32>
+//  <i>Default: 8
+#define RT_PROF_USER_PROBES     8
+// </h>
+
+#if defined(RT_USING_PROF) && !defined(RT_USING_HOOK)
+    #define RT_USING_HOOK
+#endif
+
+// <h>Trace Configuration
+// <c1>Using binary event trace
+//  <i>events go to the ITM stimulus port when SWO is attached, otherwise to a RAM ring
+#define RT_USING_TRACE
+// </c>
+// <o>the ITM stimulus port for trace event headers <0-30>
+//  <i>the arguments go to the next port
+//  <i>Default: 1
+#define RT_TRACE_ITM_PORT       1
+// <o>the number of events kept in RAM <16-1024>
+//  <i>must be a power of two, 24 bytes per event
+//  <i>Default: 64
+#define RT_TRACE_RING_SIZE      64
+// </h>
+
 // <e>Software timers Configuration
 // <i> Enables user timers
 #define RT_USING_TIMER_SOFT         0
@@ -116,6 +146,14 @@
 // </c>
 // </h>
 
+// <h>Device Configuration
+// <c1>Using device framework
+//  <i>needed to register block devices such as "w25q"
+//  <i>finsh then reads from a console device instead of rt_hw_console_getchar
+//#define RT_USING_DEVICE
+// </c>
+// </h>
+
 // <h>Console Configuration
 // <c1>Using console
 //  <i>Using console
@@ -125,6 +163,69 @@
 //  <i>the buffer size of console
 //  <i>Default: 128  (128Byte)
 #define RT_CONSOLEBUF_SIZE          128
+// <o>the rx ringbuffer size of console <16-1024>
+//  <i>must be a power of two
+//  <i>Default: 256  (256Byte)
+#define RT_CONSOLE_RX_BUF_SIZE      256
+// <c1>Using DMA receive for console
+//  <i>circular DMA + IDLE line detection instead of one interrupt per byte
+#define RT_CONSOLE_USING_RX_DMA
+// </c>
+// <o>the rx dma buffer size of console <16-1024>
+//  <i>Default: 64  (64Byte)
+#define RT_CONSOLE_RX_DMA_BUF_SIZE  64
+// </h>
+
+// <h>Deferred Log Configuration
+// <c1>Using deferred log
+//  <i>dlog() stores the format pointer and arguments, a background thread formats and prints
+#define RT_USING_DLOG
+// </c>
+// <o>the number of messages in the log ring <8-256>
+//  <i>must be a power of two, 24 bytes per message
+//  <i>Default: 32
+#define RT_DLOG_RING_SIZE           32
+// <o>the overflow policy when the ring is full
+//  <0=> drop newest <1=> drop oldest <2=> block
+//  <i>block waits in thread context and drops the newest message in interrupts
+//  <i>Default: 0
+#define RT_DLOG_OVERFLOW_POLICY     0
+// <o>the priority of the log thread <1-7>
+//  <i>Default: 6
+#define RT_DLOG_THREAD_PRIORITY     6
+// <o>the stack size of the log thread <256-4096>
+//  <i>Default: 512  (512Byte)
+#define RT_DLOG_THREAD_STACK_SIZE   512
+// </h>
+
+// <h>Clock Configuration
+// <o>the system clock profile after reset
+//  <0=> 72MHz <1=> 48MHz <2=> 24MHz <3=> 8MHz
+//  <i>HSE 8MHz as the source, PLL for the profiles above 8MHz
+//  <i>Default: 0  (72MHz)
+#define RT_SYSCLK_DEFAULT_PROFILE   0
+// </h>
+
+// <h>SPI Flash Configuration
+// <c1>Using W25Qxx SPI NOR flash
+//  <i>4KB write-back sector cache, registered as block device "w25q" with RT_USING_DEVICE
+//#define RT_USING_W25Q
+// </c>
+// <o>the SPI bus of the flash <1-3>
+//  <i>SPI1 PA5~7, SPI2 PB13~15, SPI3 PB3~5 (JTAG disabled, SWD kept)
+//  <i>Default: 1
+#define RT_W25Q_SPI_BUS             1
+// <o>the chip select port
+//  <0=> GPIOA <1=> GPIOB <2=> GPIOC <3=> GPIOD
+//  <i>Default: 0  (GPIOA)
+#define RT_W25Q_CS_PORT             0
+// <o>the chip select pin <0-15>
+//  <i>Default: 4  (PA4)
+#define RT_W25Q_CS_PIN              4
+// <o>the max SPI clock in Hz
+//  <i>rounded down to PCLK / 2^n
+//  <i>Default: 18000000
+#define RT_W25Q_MAX_HZ              18000000
 // </h>
 
 #if defined(RT_USING_FINSH)
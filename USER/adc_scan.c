@@ -0,0 +1,728 @@
+/**
+  ******************************************************************************
+  * @file			adc_scan.c
+  * @brief			timer triggered adc scan engine with circular dma
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <dma_alloc.h>
+#include <adc_scan.h>
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#define ADC_SCAN_MAX_CLK    14000000    /*!< ADC 时钟上限 */
+#define ADC_SCAN_MARGIN     90          /*!< 扫描时间最多占触发周期的百分比 */
+#define ADC_SCAN_LANE_RUN   16          /*!< 16 个 12 位采样相加不会进位到高半字 */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static struct adc_scan *adc_scan_active;
+
+/* 各采样时间的 ADC 时钟数 x2，下标即 ADC_SAMPLETIME_xxx */
+static const rt_uint16_t adc_smp_half_cycles[8] = {3, 15, 27, 57, 83, 111, 143, 479};
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           配置 ADC 时钟：PCLK2 最小的不超过 14MHz 的分频
+ *
+ * @param[in]       none
+ *
+ * @return          ADC 时钟 Hz
+ *============================================================================*/
+static rt_uint32_t _adc_scan_clock(void)
+{
+    static const rt_uint32_t divs[4] = {RCC_ADCPCLK2_DIV2, RCC_ADCPCLK2_DIV4,
+                                        RCC_ADCPCLK2_DIV6, RCC_ADCPCLK2_DIV8};
+    RCC_PeriphCLKInitTypeDef clk = {0};
+    rt_uint32_t pclk2 = HAL_RCC_GetPCLK2Freq();
+    rt_uint32_t i;
+
+    for (i = 0; i < 3 && pclk2 / (2 * (i + 1)) > ADC_SCAN_MAX_CLK; i++);
+
+    clk.PeriphClockSelection = RCC_PERIPHCLK_ADC;
+    clk.AdcClockSelection    = divs[i];
+    HAL_RCCEx_PeriphCLKConfig(&clk);
+
+    return pclk2 / (2 * (i + 1));
+}
+
+/**=============================================================================
+ * @brief           通道对应的引脚设为模拟输入，内部通道 16/17 跳过
+ *
+ * @param[in]       channel ADC_CHANNEL_x
+ *
+ * @return          none
+ *============================================================================*/
+static void _adc_scan_pin_init(rt_uint8_t channel)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_TypeDef *port;
+
+    if (channel < 8)
+    {
+        __HAL_RCC_GPIOA_CLK_ENABLE();
+        port = GPIOA;
+        GPIO_InitStruct.Pin = 1U << channel;
+    }
+    else if (channel < 10)
+    {
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+        port = GPIOB;
+        GPIO_InitStruct.Pin = 1U << (channel - 8);
+    }
+    else if (channel < 16)
+    {
+        __HAL_RCC_GPIOC_CLK_ENABLE();
+        port = GPIOC;
+        GPIO_InitStruct.Pin = 1U << (channel - 10);
+    }
+    else
+    {
+        return;
+    }
+
+    GPIO_InitStruct.Mode = GPIO_MODE_ANALOG;
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
+}
+
+/**=============================================================================
+ * @brief           初始化一个 ADC 的规则组，不配置通道
+ *
+ * @param[in]       hadc    ADC 句柄，Instance 已设置
+ * @param[in]       ranks   规则组通道数
+ * @param[in]       trigger ADC_EXTERNALTRIGCONV_xxx 或 ADC_SOFTWARE_START
+ *
+ * @return          RT_EOK 成功，-RT_EIO 失败
+ *============================================================================*/
+static rt_err_t _adc_scan_adc_init(ADC_HandleTypeDef *hadc, rt_uint32_t ranks, rt_uint32_t trigger)
+{
+    hadc->Init.DataAlign             = ADC_DATAALIGN_RIGHT;
+    hadc->Init.ScanConvMode          = ADC_SCAN_ENABLE;
+    hadc->Init.ContinuousConvMode    = DISABLE;
+    hadc->Init.NbrOfConversion       = ranks;
+    hadc->Init.DiscontinuousConvMode = DISABLE;
+    hadc->Init.NbrOfDiscConversion   = 1;
+    hadc->Init.ExternalTrigConv      = trigger;
+    if (HAL_ADC_Init(hadc) != HAL_OK)
+        return -RT_EIO;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           按当前采样时间配置两个 ADC 的规则组
+ *
+ * @param[in]       scan 引擎
+ *
+ * @return          RT_EOK 成功，-RT_EIO 失败
+ *============================================================================*/
+static rt_err_t _adc_scan_config_channels(struct adc_scan *scan)
+{
+    ADC_ChannelConfTypeDef sConfig = {0};
+    ADC_HandleTypeDef *hadc;
+    rt_uint32_t i;
+
+    sConfig.SamplingTime = scan->sample_time;
+    for (i = 0; i < scan->count; i++)
+    {
+        if (scan->flags & ADC_SCAN_DUAL)
+        {
+            hadc         = (i & 1) ? &scan->hadc2 : &scan->hadc;
+            sConfig.Rank = ADC_REGULAR_RANK_1 + i / 2;
+        }
+        else
+        {
+            hadc         = &scan->hadc;
+            sConfig.Rank = ADC_REGULAR_RANK_1 + i;
+        }
+        sConfig.Channel = scan->channels[i];
+        if (HAL_ADC_ConfigChannel(hadc, &sConfig) != HAL_OK)
+            return -RT_EIO;
+    }
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           选出能在触发周期内完成一次扫描的最长采样时间
+ *
+ * @param[in]       scan 引擎
+ * @param[in]       rate 触发频率 Hz
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 速率太高
+ *============================================================================*/
+static rt_err_t _adc_scan_pick_sample_time(struct adc_scan *scan, rt_uint32_t rate)
+{
+    rt_uint64_t budget = (rt_uint64_t)_adc_scan_clock() * 2 * ADC_SCAN_MARGIN / 100;
+    rt_uint32_t ranks  = (scan->flags & ADC_SCAN_DUAL) ? scan->count / 2 : scan->count;
+    rt_int32_t i;
+
+    /* 一次转换为采样时间加 12.5 个时钟，全部按 x2 计算 */
+    for (i = 7; i >= 0; i--)
+    {
+        if ((rt_uint64_t)ranks * (adc_smp_half_cycles[i] + 25) * rate <= budget)
+        {
+            scan->sample_time = i;
+            return RT_EOK;
+        }
+    }
+
+    return -RT_EINVAL;
+}
+
+/**=============================================================================
+ * @brief           配置 TIM3 以 rate 产生更新事件作为 ADC 触发
+ *
+ * @param[in]       scan 引擎
+ * @param[in]       rate 触发频率 Hz
+ *
+ * @return          RT_EOK 成功，-RT_EIO 失败
+ *============================================================================*/
+static rt_err_t _adc_scan_timer_init(struct adc_scan *scan, rt_uint32_t rate)
+{
+    TIM_MasterConfigTypeDef sMaster = {0};
+    rt_uint32_t clk = HAL_RCC_GetPCLK1Freq();
+    rt_uint32_t period, psc, arr;
+
+    /* APB1 分频不为 1 时定时器时钟为 PCLK1 x2 */
+    if ((RCC->CFGR & RCC_CFGR_PPRE1) != RCC_CFGR_PPRE1_DIV1)
+        clk *= 2;
+
+    period = (clk + rate / 2) / rate;
+    if (period < 2)
+        return -RT_EINVAL;
+    psc = (period - 1) / 65536;
+    arr = period / (psc + 1) - 1;
+
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    scan->htim.Instance               = TIM3;
+    scan->htim.Init.Prescaler         = psc;
+    scan->htim.Init.CounterMode       = TIM_COUNTERMODE_UP;
+    scan->htim.Init.Period            = arr;
+    scan->htim.Init.ClockDivision     = TIM_CLOCKDIVISION_DIV1;
+    scan->htim.Init.AutoReloadPreload = TIM_AUTORELOAD_PRELOAD_ENABLE;
+    if (HAL_TIM_Base_Init(&scan->htim) != HAL_OK)
+        return -RT_EIO;
+
+    sMaster.MasterOutputTrigger = TIM_TRGO_UPDATE;
+    sMaster.MasterSlaveMode     = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(&scan->htim, &sMaster) != HAL_OK)
+        return -RT_EIO;
+
+    scan->rate = clk / ((psc + 1) * (arr + 1));
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           过采样：每 os_ratio 组按通道累加、舍入右移，结果原地写回块首
+ *
+ * @param[in]       scan 引擎
+ * @param[in]       data 刚采满的块，DMA 正在写另一块
+ *
+ * @return          none
+ *
+ * @note            通道数为偶数且对齐时按字读取，一次加法同时累加两个通道：
+ *                  每 ADC_SCAN_LANE_RUN 组拆开一次高低半字，避免低半字进位；
+ *                  第 j 个结果写在第 j 组，该组此前已经累加过，不会被提前覆盖
+ *============================================================================*/
+static void _adc_scan_oversample(struct adc_scan *scan, rt_uint16_t *data)
+{
+    const rt_uint32_t count = scan->count, ratio = scan->os_ratio;
+    const rt_uint32_t pairs = count / 2;
+    const rt_uint32_t round = scan->os_shift ? 1U << (scan->os_shift - 1) : 0;
+    rt_uint32_t sums[2 * ADC_SCAN_MAX_RANKS];
+    rt_uint32_t lanes[ADC_SCAN_MAX_RANKS];
+    const rt_uint16_t *g = data;
+    const rt_uint32_t *w;
+    rt_uint32_t j, k, ch, run, left;
+
+    for (j = 0; j < scan->samples / ratio; j++)
+    {
+        for (ch = 0; ch < count; ch++)
+            sums[ch] = 0;
+
+        if (!(count & 1) && !((rt_ubase_t)g & 3))
+        {
+            w = (const rt_uint32_t *)g;
+            for (left = ratio; left; left -= run)
+            {
+                run = left < ADC_SCAN_LANE_RUN ? left : ADC_SCAN_LANE_RUN;
+                for (k = 0; k < pairs; k++)
+                    lanes[k] = 0;
+                for (k = 0; k < run; k++)
+                {
+                    for (ch = 0; ch < pairs; ch++)
+                        lanes[ch] += *w++;
+                }
+                for (k = 0; k < pairs; k++)
+                {
+                    sums[2 * k]     += lanes[k] & 0xFFFF;
+                    sums[2 * k + 1] += lanes[k] >> 16;
+                }
+            }
+            g = (const rt_uint16_t *)w;
+        }
+        else
+        {
+            for (k = 0; k < ratio; k++)
+            {
+                for (ch = 0; ch < count; ch++)
+                    sums[ch] += *g++;
+            }
+        }
+
+        for (ch = 0; ch < count; ch++)
+            data[j * count + ch] = (rt_uint16_t)((sums[ch] + round) >> scan->os_shift);
+    }
+}
+
+/**=============================================================================
+ * @brief           一块采满，在 DMA 中断中调用
+ *
+ * @param[in]       scan  引擎
+ * @param[in]       index 采满的块
+ *
+ * @return          none
+ *
+ * @note            此时 DMA 已开始写另一块：另一块若还没被取走就丢弃，
+ *                  若使用者正在处理则记为被覆盖
+ *============================================================================*/
+static void _adc_scan_block_done(struct adc_scan *scan, rt_int8_t index)
+{
+    rt_int8_t other = index ^ 1;
+    rt_int8_t was   = scan->pending;
+
+    if (scan->os_ratio > 1)
+        _adc_scan_oversample(scan, scan->buf + (rt_size_t)index * scan->count * scan->samples);
+
+    scan->stats.blocks++;
+    if (scan->held == other)
+    {
+        scan->held = ADC_SCAN_NONE;
+        scan->stats.torn++;
+    }
+    if (was == other)
+        scan->stats.overruns++;
+
+    scan->pending     = index;
+    scan->pending_seq = scan->seq++;
+
+    /* 被丢弃的块已释放过信号量，新块沿用 */
+    if (was == ADC_SCAN_NONE)
+        rt_sem_release(&scan->ready);
+}
+
+/**=============================================================================
+ * @brief           初始化采集引擎：ADC1（同步模式加 ADC2）、DMA 和引脚
+ *
+ * @param[in]       scan     引擎
+ * @param[in]       flags    ADC_SCAN_DUAL 或 0
+ * @param[in]       channels 通道列表 ADC_CHANNEL_x，同步模式下偶数项给 ADC1，
+ *                           奇数项给 ADC2，内部通道 16/17 只能给 ADC1
+ * @param[in]       count    通道数，同步模式须为偶数
+ * @param[in]       buf      DMA 缓冲，ADC_SCAN_BUF_SIZE(count, samples) 个半字，
+ *                           同步模式须 4 字节对齐
+ * @param[in]       samples  每块的组数
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 参数错误，-RT_EBUSY DMA 通道被占用，
+ *                  -RT_EIO ADC 初始化失败
+ *
+ * @note            本模块实现了 HAL 的 ADC 转换完成和错误回调，只处理最后一次
+ *                  初始化的引擎的 ADC1，其他 ADC 的回调被忽略，要用要另行分发
+ *============================================================================*/
+rt_err_t adc_scan_init(struct adc_scan *scan, rt_uint8_t flags, const rt_uint8_t *channels,
+                       rt_uint8_t count, rt_uint16_t *buf, rt_uint16_t samples)
+{
+    ADC_MultiModeTypeDef multimode = {0};
+    rt_uint32_t ranks, i;
+    rt_err_t ret;
+
+    RT_ASSERT(scan != RT_NULL);
+
+    ranks = (flags & ADC_SCAN_DUAL) ? count / 2 : count;
+    if (channels == RT_NULL || buf == RT_NULL || samples == 0 || ranks == 0 ||
+        ranks > ADC_SCAN_MAX_RANKS || ADC_SCAN_BUF_SIZE(count, samples) > 0xFFFF)
+        return -RT_EINVAL;
+    if ((flags & ADC_SCAN_DUAL) && ((count & 1) || ((rt_ubase_t)buf & 3)))
+        return -RT_EINVAL;
+    for (i = 0; i < count; i++)
+    {
+        if (channels[i] > 17 || ((flags & ADC_SCAN_DUAL) && (i & 1) && channels[i] > 15))
+            return -RT_EINVAL;
+    }
+
+    rt_memset(scan, 0, sizeof(*scan));
+    rt_memcpy(scan->channels, channels, count);
+    scan->count    = count;
+    scan->flags    = flags;
+    scan->buf      = buf;
+    scan->samples  = samples;
+    scan->pending  = ADC_SCAN_NONE;
+    scan->held     = ADC_SCAN_NONE;
+    scan->os_ratio = 1;
+
+    if (dma_alloc(&scan->hdma, DMA_REQ_ADC1, DMA_CLASS_LATENCY) != RT_EOK)
+        return -RT_EBUSY;
+
+    for (i = 0; i < count; i++)
+        _adc_scan_pin_init(channels[i]);
+    _adc_scan_clock();
+
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    scan->hadc.Instance = ADC1;
+    ret = _adc_scan_adc_init(&scan->hadc, ranks, ADC_EXTERNALTRIGCONV_T3_TRGO);
+    if (ret == RT_EOK && (flags & ADC_SCAN_DUAL))
+    {
+        /* 从 ADC 必须是软件触发，实际由主 ADC 同步启动 */
+        __HAL_RCC_ADC2_CLK_ENABLE();
+        scan->hadc2.Instance = ADC2;
+        ret = _adc_scan_adc_init(&scan->hadc2, ranks, ADC_SOFTWARE_START);
+    }
+
+    /* 多 ADC 模式只能在两个 ADC 都关闭时设置，所以放在校准之前 */
+    multimode.Mode = (flags & ADC_SCAN_DUAL) ? ADC_DUALMODE_REGSIMULT : ADC_MODE_INDEPENDENT;
+    if (ret == RT_EOK && HAL_ADCEx_MultiModeConfigChannel(&scan->hadc, &multimode) != HAL_OK)
+        ret = -RT_EIO;
+    if (ret == RT_EOK && HAL_ADCEx_Calibration_Start(&scan->hadc) != HAL_OK)
+        ret = -RT_EIO;
+    if (ret == RT_EOK && (flags & ADC_SCAN_DUAL) &&
+        HAL_ADCEx_Calibration_Start(&scan->hadc2) != HAL_OK)
+        ret = -RT_EIO;
+    if (ret != RT_EOK)
+    {
+        dma_free(&scan->hdma);
+        return ret;
+    }
+
+    /* 同步模式每次搬一个字：低半字为 ADC1，高半字为 ADC2，正好是通道列表的顺序 */
+    scan->hdma.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    scan->hdma.Init.PeriphInc           = DMA_PINC_DISABLE;
+    scan->hdma.Init.MemInc              = DMA_MINC_ENABLE;
+    if (flags & ADC_SCAN_DUAL)
+    {
+        scan->hdma.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+        scan->hdma.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+    }
+    else
+    {
+        scan->hdma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+        scan->hdma.Init.MemDataAlignment    = DMA_MDATAALIGN_HALFWORD;
+    }
+    scan->hdma.Init.Mode                = DMA_CIRCULAR;
+    HAL_DMA_Init(&scan->hdma);
+    __HAL_LINKDMA(&scan->hadc, DMA_Handle, scan->hdma);
+
+    rt_sem_init(&scan->ready, "adc", 0, RT_IPC_FLAG_FIFO);
+    adc_scan_active = scan;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           开始连续采集
+ *
+ * @param[in]       scan 引擎
+ * @param[in]       rate 每秒扫描次数，实际值见 scan->rate
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 速率为 0 或太高，-RT_EBUSY 已在采集，
+ *                  -RT_EIO 启动失败
+ *
+ * @note            时钟按启动时计算，切换系统时钟后需要停止再启动
+ *============================================================================*/
+rt_err_t adc_scan_start(struct adc_scan *scan, rt_uint32_t rate)
+{
+    rt_uint32_t len = ADC_SCAN_BUF_SIZE(scan->count, scan->samples);
+    HAL_StatusTypeDef status;
+    rt_err_t ret;
+
+    RT_ASSERT(scan != RT_NULL);
+
+    if (scan->running)
+        return -RT_EBUSY;
+    if (rate == 0)
+        return -RT_EINVAL;
+
+    ret = _adc_scan_pick_sample_time(scan, rate);
+    if (ret == RT_EOK)
+        ret = _adc_scan_timer_init(scan, rate);
+    if (ret == RT_EOK)
+        ret = _adc_scan_config_channels(scan);
+    if (ret != RT_EOK)
+        return ret;
+
+    while (rt_sem_trytake(&scan->ready) == RT_EOK);
+    scan->pending     = ADC_SCAN_NONE;
+    scan->held        = ADC_SCAN_NONE;
+    scan->result      = RT_EOK;
+    scan->stats.start = rt_tick_get();
+
+    if (scan->flags & ADC_SCAN_DUAL)
+        status = HAL_ADCEx_MultiModeStart_DMA(&scan->hadc, (uint32_t *)scan->buf, len / 2);
+    else
+        status = HAL_ADC_Start_DMA(&scan->hadc, (uint32_t *)scan->buf, len);
+    if (status != HAL_OK)
+        return -RT_EIO;
+
+    scan->running = 1;
+    HAL_TIM_Base_Start(&scan->htim);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           停止采集，等待中的使用者返回 -RT_EINTR
+ *
+ * @param[in]       scan 引擎
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t adc_scan_stop(struct adc_scan *scan)
+{
+    rt_base_t level;
+
+    RT_ASSERT(scan != RT_NULL);
+
+    if (!scan->running)
+        return RT_EOK;
+
+    HAL_TIM_Base_Stop(&scan->htim);
+    if (scan->flags & ADC_SCAN_DUAL)
+        HAL_ADCEx_MultiModeStop_DMA(&scan->hadc);
+    else
+        HAL_ADC_Stop_DMA(&scan->hadc);
+
+    level = rt_hw_interrupt_disable();
+    scan->running = 0;
+    scan->result  = -RT_EINTR;
+    if (scan->pending == ADC_SCAN_NONE)
+        rt_sem_release(&scan->ready);
+    scan->pending = ADC_SCAN_NONE;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           设置过采样，停止时调用，下次启动生效
+ *
+ * @param[in]       scan  引擎
+ * @param[in]       ratio 过采样比 ADC_SCAN_OS_MIN ~ ADC_SCAN_OS_MAX 之间 2 的幂，
+ *                        须整除每块的组数；1 表示关闭
+ * @param[in]       shift 累加和右移位数，不超过 log2(ratio)
+ *
+ * @return          RT_EOK 成功，-RT_EBUSY 正在采集，-RT_EINVAL 参数错误或结果
+ *                  超过 ADC_SCAN_OS_BITS 位
+ *
+ * @note            每多 1 位分辨率需要 4 倍过采样，如 16x 右移 2 得 14 位，
+ *                  256x 右移 4 得 16 位；每个结果只花一次中断，线程不需要再累加
+ *============================================================================*/
+rt_err_t adc_scan_set_oversample(struct adc_scan *scan, rt_uint16_t ratio, rt_uint8_t shift)
+{
+    rt_uint32_t sum_bits;
+
+    RT_ASSERT(scan != RT_NULL);
+
+    if (scan->running)
+        return -RT_EBUSY;
+    if (ratio <= 1)
+    {
+        scan->os_ratio = 1;
+        scan->os_shift = 0;
+        return RT_EOK;
+    }
+    if (ratio < ADC_SCAN_OS_MIN || ratio > ADC_SCAN_OS_MAX || (ratio & (ratio - 1)) ||
+        scan->samples % ratio)
+        return -RT_EINVAL;
+
+    /* 12 位采样累加 ratio 次后的位数 */
+    sum_bits = 12 + 32 - __CLZ(ratio - 1);
+    if (shift > sum_bits - 12 || sum_bits - shift > ADC_SCAN_OS_BITS)
+        return -RT_EINVAL;
+
+    scan->os_ratio = ratio;
+    scan->os_shift = shift;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           等待下一块数据，只能在线程中调用
+ *
+ * @param[in]       scan    引擎
+ * @param[out]      blk     数据块，指向 DMA 缓冲
+ * @param[in]       timeout 超时 tick，RT_WAITING_FOREVER 一直等
+ *
+ * @return          RT_EOK 成功，-RT_ETIMEOUT 超时，-RT_EINTR 已停止，
+ *                  -RT_EIO DMA 出错
+ *
+ * @note            取到的块须在 DMA 写满另一块前处理完并调用 adc_scan_release，
+ *                  即一块的采集时间；再次等待会自动释放上一块。过采样时块中
+ *                  只有 samples / os_ratio 组结果
+ *============================================================================*/
+rt_err_t adc_scan_wait(struct adc_scan *scan, struct adc_scan_block *blk, rt_int32_t timeout)
+{
+    rt_base_t level;
+    rt_err_t ret;
+
+    RT_ASSERT(scan != RT_NULL);
+    RT_ASSERT(blk != RT_NULL);
+
+    scan->held = ADC_SCAN_NONE;
+    if (!scan->running)
+        return scan->result != RT_EOK ? scan->result : -RT_EINTR;
+
+    ret = rt_sem_take(&scan->ready, timeout);
+    if (ret != RT_EOK)
+        return ret;
+
+    level = rt_hw_interrupt_disable();
+    if (scan->pending == ADC_SCAN_NONE)
+    {
+        ret = scan->result != RT_EOK ? scan->result : -RT_EINTR;
+        rt_hw_interrupt_enable(level);
+        return ret;
+    }
+    blk->index    = scan->pending;
+    blk->seq      = scan->pending_seq;
+    scan->held    = scan->pending;
+    scan->pending = ADC_SCAN_NONE;
+    scan->stats.delivered++;
+    rt_hw_interrupt_enable(level);
+
+    blk->count   = scan->count;
+    blk->samples = scan->samples / scan->os_ratio;
+    blk->data    = scan->buf + (rt_size_t)blk->index * scan->count * scan->samples;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           处理完当前块，交还给 DMA
+ *
+ * @param[in]       scan 引擎
+ *
+ * @return          RT_EOK 成功，-RT_EFULL 处理期间已被 DMA 覆盖，数据不可信
+ *============================================================================*/
+rt_err_t adc_scan_release(struct adc_scan *scan)
+{
+    rt_base_t level;
+    rt_err_t ret;
+
+    RT_ASSERT(scan != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    ret = scan->held == ADC_SCAN_NONE ? -RT_EFULL : RT_EOK;
+    scan->held = ADC_SCAN_NONE;
+    rt_hw_interrupt_enable(level);
+
+    return ret;
+}
+
+/**=============================================================================
+ * @brief           回调的句柄对应的引擎，不是 adc_scan_init 登记的 ADC 时为空
+ *
+ * @param[in]       hadc ADC 句柄
+ *
+ * @return          引擎，RT_NULL 表示不属于本模块
+ *============================================================================*/
+static struct adc_scan *_adc_scan_of(ADC_HandleTypeDef *hadc)
+{
+    struct adc_scan *scan = adc_scan_active;
+
+    return (scan != RT_NULL && hadc == &scan->hadc) ? scan : RT_NULL;
+}
+
+/* HAL 回调，其他 ADC 的回调直接忽略 ------------------------------------------*/
+void HAL_ADC_ConvHalfCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    struct adc_scan *scan = _adc_scan_of(hadc);
+
+    if (scan != RT_NULL)
+        _adc_scan_block_done(scan, 0);
+}
+
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc)
+{
+    struct adc_scan *scan = _adc_scan_of(hadc);
+
+    if (scan != RT_NULL)
+        _adc_scan_block_done(scan, 1);
+}
+
+/**=============================================================================
+ * @brief           DMA 传输错误，采集停止，唤醒等待者
+ *
+ * @param[in]       hadc ADC 句柄
+ *
+ * @return          none
+ *============================================================================*/
+void HAL_ADC_ErrorCallback(ADC_HandleTypeDef *hadc)
+{
+    struct adc_scan *scan = _adc_scan_of(hadc);
+
+    if (scan == RT_NULL)
+        return;
+    HAL_TIM_Base_Stop(&scan->htim);
+    scan->stats.errors++;
+    scan->running = 0;
+    scan->result  = -RT_EIO;
+    if (scan->pending == ADC_SCAN_NONE)
+        rt_sem_release(&scan->ready);
+    scan->pending = ADC_SCAN_NONE;
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           打印采集统计和实测速率
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int adc(void)
+{
+    struct adc_scan *scan = adc_scan_active;
+    struct adc_scan_stats *st;
+    rt_tick_t elapsed;
+    rt_uint64_t measured = 0;
+
+    if (scan == RT_NULL)
+    {
+        rt_kprintf("adc scan not initialized\n");
+        return 0;
+    }
+    st = &scan->stats;
+
+    elapsed = rt_tick_get() - st->start;
+    if (scan->running && elapsed > 0)
+        measured = (rt_uint64_t)st->blocks * scan->samples * RT_TICK_PER_SECOND / elapsed;
+
+    rt_kprintf("mode %s, %d channels, %d samples/block, sample time %d.5 cycles\n",
+               (scan->flags & ADC_SCAN_DUAL) ? "dual" : "single", scan->count,
+               scan->samples, adc_smp_half_cycles[scan->sample_time] / 2);
+    rt_kprintf("rate %u Hz, measured %u Hz, %s\n", scan->rate, (rt_uint32_t)measured,
+               scan->running ? "running" : "stopped");
+    if (scan->os_ratio > 1)
+        rt_kprintf("oversample %ux >> %u, %u bits, %u Hz\n", scan->os_ratio, scan->os_shift,
+                   12 + 32 - __CLZ(scan->os_ratio - 1) - scan->os_shift, scan->rate / scan->os_ratio);
+    rt_kprintf("blocks %u, delivered %u, overruns %u, torn %u, errors %u\n",
+               st->blocks, st->delivered, st->overruns, st->torn, st->errors);
+
+    return 0;
+}
+MSH_CMD_EXPORT(adc, show adc scan statistics);
+#endif
@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file			adc_scan.h
+  * @brief			timer triggered adc scan engine with circular dma header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __ADC_SCAN_H_
+#define __ADC_SCAN_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define ADC_SCAN_MAX_RANKS      16          /*!< 每个 ADC 规则组最多的通道数 */
+#define ADC_SCAN_NONE           (-1)
+#define ADC_SCAN_OS_MIN         4           /*!< 过采样比范围，须为 2 的幂 */
+#define ADC_SCAN_OS_MAX         256
+#define ADC_SCAN_OS_BITS        16          /*!< 过采样结果最多的位数 */
+
+/* 采集标志 */
+#define ADC_SCAN_DUAL           0x01        /*!< ADC1/ADC2 同步规则模式，偶数项给 ADC1，奇数项给 ADC2 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* 缓冲区需要的半字数：两个块，每块 samples 组，每组 count 个 */
+#define ADC_SCAN_BUF_SIZE(count, samples)   (2 * (rt_size_t)(count) * (samples))
+
+/* 块中第 i 组第 ch 个通道的采样值，ch 为 channels 中的序号 */
+#define ADC_SCAN_SAMPLE(blk, ch, i)         ((blk)->data[(rt_size_t)(i) * (blk)->count + (ch)])
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 交给使用者的一块数据，直接指向 DMA 缓冲的一半，不拷贝
+ *
+ * 数据按组排列，每组是同一触发时刻各通道的采样，顺序与 channels 一致
+ */
+struct adc_scan_block
+{
+    const rt_uint16_t      *data;
+    rt_uint16_t             samples;        /*!< 组数，过采样时为结果个数 */
+    rt_uint8_t              count;          /*!< 每组通道数，即组间跨度 */
+    rt_uint8_t              index;          /*!< 缓冲的前半 0 或后半 1 */
+    rt_uint32_t             seq;            /*!< 块序号，不连续说明中间的块被丢弃 */
+};
+
+struct adc_scan_stats
+{
+    rt_uint32_t             blocks;         /*!< 采满的块 */
+    rt_uint32_t             delivered;      /*!< 交给使用者的块 */
+    rt_uint32_t             overruns;       /*!< 来不及取走被覆盖丢弃的块 */
+    rt_uint32_t             torn;           /*!< 使用者还没释放就被 DMA 覆盖的块 */
+    rt_uint32_t             errors;
+    rt_tick_t               start;          /*!< 开始采集的时刻 */
+};
+
+/**
+ * 采集引擎：TIM3 更新事件触发一次扫描，DMA 循环搬入双块缓冲，
+ * 半满和全满中断各交出一块，使用者在线程中等待、处理后释放
+ *
+ * 打开过采样后，半满/全满中断先把每 os_ratio 组累加、右移成一组，
+ * 原地写回块的开头，使用者拿到的每组就是一个高分辨率采样
+ */
+struct adc_scan
+{
+    ADC_HandleTypeDef       hadc;           /*!< 必须是第一个成员，HAL 回调由它找到引擎 */
+    ADC_HandleTypeDef       hadc2;          /*!< 同步模式的从 ADC */
+    DMA_HandleTypeDef       hdma;
+    TIM_HandleTypeDef       htim;
+    struct rt_semaphore     ready;
+
+    rt_uint8_t              channels[2 * ADC_SCAN_MAX_RANKS];
+    rt_uint8_t              count;
+    rt_uint8_t              flags;
+    rt_uint8_t              sample_time;    /*!< ADC_SAMPLETIME_xxx，启动时按速率选择 */
+    rt_uint8_t              running;
+    rt_uint16_t            *buf;
+    rt_uint16_t             samples;        /*!< 每块的组数 */
+    rt_uint32_t             rate;           /*!< 实际触发频率 Hz */
+    rt_uint16_t             os_ratio;       /*!< 过采样比，1 表示关闭 */
+    rt_uint8_t              os_shift;
+
+    /* 内部使用 */
+    volatile rt_int8_t      pending;        /*!< 已采满待取的块 */
+    volatile rt_int8_t      held;           /*!< 使用者正在处理的块 */
+    rt_uint32_t             seq;
+    rt_uint32_t             pending_seq;
+    volatile rt_err_t       result;
+    struct adc_scan_stats   stats;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t adc_scan_init(struct adc_scan *scan, rt_uint8_t flags, const rt_uint8_t *channels,
+                       rt_uint8_t count, rt_uint16_t *buf, rt_uint16_t samples);
+rt_err_t adc_scan_start(struct adc_scan *scan, rt_uint32_t rate);
+rt_err_t adc_scan_stop(struct adc_scan *scan);
+rt_err_t adc_scan_set_oversample(struct adc_scan *scan, rt_uint16_t ratio, rt_uint8_t shift);
+rt_err_t adc_scan_wait(struct adc_scan *scan, struct adc_scan_block *blk, rt_int32_t timeout);
+rt_err_t adc_scan_release(struct adc_scan *scan);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __ADC_SCAN_H_ */
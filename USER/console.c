@@ -12,175 +12,149 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "stm32f1xx_hal.h"
+#include <rthw.h>
 #include <rtthread.h>
 #include <string.h>
+#include <ringbuffer.h>
+#include <sysclk.h>
+#include <dma_alloc.h>
 
 /* Private constants ---------------------------------------------------------*/
 #define CONSOLE_GET_CHAR_INT_MODE   /*!< 中断方式获取终端输入字符 */
+#ifdef RT_CONSOLE_USING_RX_DMA
+#define CONSOLE_GET_CHAR_DMA_MODE   /*!< 在中断方式的基础上，由循环 DMA 接收，空闲中断整块提交 */
+#endif
 
+#ifdef RT_CONSOLE_RX_BUF_SIZE
+#define UART_RX_BUF_LEN     RT_CONSOLE_RX_BUF_SIZE
+#else
 #define UART_RX_BUF_LEN     16
+#endif
+#if (UART_RX_BUF_LEN & (UART_RX_BUF_LEN - 1)) != 0
+#error "RT_CONSOLE_RX_BUF_SIZE must be a power of two"
+#endif
+#ifdef RT_CONSOLE_RX_DMA_BUF_SIZE
+#define UART_RX_DMA_BUF_LEN RT_CONSOLE_RX_DMA_BUF_SIZE
+#else
+#define UART_RX_DMA_BUF_LEN 64
+#endif
+#define UART_TX_BUF_LEN     512
+#define UART_TX_WAIT_TICKS  (RT_TICK_PER_SECOND / 10)  /*!< 缓冲满时单次等待上限，防止 DMA 异常时永久阻塞 */
 #define USART_RX_Pin        GPIO_PIN_9
 #define USART_TX_Pin        GPIO_PIN_10
 /* Private macro -------------------------------------------------------------*/
-#define rt_ringbuffer_space_len(rb) ((rb)->buffer_size - rt_ringbuffer_data_len(rb))
-
 /* Private typedef -----------------------------------------------------------*/
-struct rt_ringbuffer
-{
-    rt_uint8_t *buffer_ptr;
-
-    rt_uint16_t read_mirror : 1;
-    rt_uint16_t read_index : 15;
-    rt_uint16_t write_mirror : 1;
-    rt_uint16_t write_index : 15;
-
-    rt_int16_t buffer_size;
-};
-
-enum rt_ringbuffer_state
-{
-    RT_RINGBUFFER_EMPTY,
-    RT_RINGBUFFER_FULL,
-    /* half full is neither full nor empty */
-    RT_RINGBUFFER_HALFFULL,
-};
-
 /* Private variables ---------------------------------------------------------*/
 rt_uint8_t uart_rx_buf[UART_RX_BUF_LEN] = {0};
 struct rt_ringbuffer  uart_rxcb;         /* 定义一个 ringbuffer cb */
 static UART_HandleTypeDef UartHandle;
+static DMA_HandleTypeDef hdma_usart1_tx;
+#ifdef CONSOLE_GET_CHAR_DMA_MODE
+static DMA_HandleTypeDef hdma_usart1_rx;
+static rt_uint8_t uart_rx_dma_buf[UART_RX_DMA_BUF_LEN];
+static rt_uint32_t uart_rx_dma_pos = 0;             /*!< 上次提交到 ringbuffer 的 DMA 位置 */
+#endif
 static struct rt_semaphore shell_rx_sem; /* 定义一个静态信号量 */
+static volatile rt_uint32_t uart_rx_dropped = 0;    /*!< 接收 ringbuffer 满而丢弃的字节数 */
+
+/* 发送环形缓冲，输出方写入，DMA 回调读出 */
+static rt_uint8_t uart_tx_buf[UART_TX_BUF_LEN];
+static struct rt_ringbuffer uart_txcb;
+static volatile rt_uint16_t uart_tx_inflight = 0;   /*!< 当前 DMA 传输中尚未释放的字节数 */
+static volatile rt_uint8_t  uart_tx_ready = 0;      /*!< 串口与 DMA 已初始化 */
+static struct rt_semaphore  uart_tx_sem;            /*!< 发送完成回调腾出空间后释放 */
+static volatile rt_uint8_t  uart_tx_waiters = 0;    /*!< 因缓冲满而等待的线程数 */
 
 /* Private function ----------------------------------------------------------*/
 
 /**=============================================================================
- * @brief           ringbuffer状态
+ * @brief           启动下一段发送 DMA
  *
  * @param[in]       none
  *
  * @return          none
- *============================================================================*/
-rt_inline enum rt_ringbuffer_state rt_ringbuffer_status(struct rt_ringbuffer *rb)
-{
-    if (rb->read_index == rb->write_index)
-    {
-        if (rb->read_mirror == rb->write_mirror)
-            return RT_RINGBUFFER_EMPTY;
-        else
-            return RT_RINGBUFFER_FULL;
-    }
-    return RT_RINGBUFFER_HALFFULL;
-}
-
-/**=============================================================================
- * @brief           get the size of data in rb
  *
- * @param[in]       none
- *
- * @return          none
+ * @note            需在关中断或 DMA/串口中断上下文中调用，每次只发送缓冲中
+ *                  连续的一段，回绕部分在完成回调中继续发送
  *============================================================================*/
-rt_size_t rt_ringbuffer_data_len(struct rt_ringbuffer *rb)
+static void _uart_tx_kick(void)
 {
-    switch (rt_ringbuffer_status(rb))
-    {
-    case RT_RINGBUFFER_EMPTY:
-        return 0;
-    case RT_RINGBUFFER_FULL:
-        return rb->buffer_size;
-    case RT_RINGBUFFER_HALFFULL:
-    default:
-        if (rb->write_index > rb->read_index)
-            return rb->write_index - rb->read_index;
-        else
-            return rb->buffer_size - (rb->read_index - rb->write_index);
-    };
-}
+    rt_uint8_t *ptr;
+    rt_size_t len;
 
-/**=============================================================================
- * @brief           ringbuffer init
- *
- * @param[in]       none
- *
- * @return          none
- *============================================================================*/
-void rt_ringbuffer_init(struct rt_ringbuffer *rb,
-                        rt_uint8_t           *pool,
-                        rt_int16_t            size)
-{
-    RT_ASSERT(rb != RT_NULL);
-    RT_ASSERT(size > 0);
+    if (!uart_tx_ready || uart_tx_inflight)
+        return;
 
-    /* initialize read and write index */
-    rb->read_mirror = rb->read_index = 0;
-    rb->write_mirror = rb->write_index = 0;
+    len = rt_ringbuffer_peek(&uart_txcb, &ptr);
+    if (len == 0)
+        return;
 
-    /* set buffer pool and size */
-    rb->buffer_ptr = pool;
-    rb->buffer_size = RT_ALIGN_DOWN(size, RT_ALIGN_SIZE);
+    uart_tx_inflight = len;
+    if (HAL_UART_Transmit_DMA(&UartHandle, ptr, len) != HAL_OK)
+    {
+        uart_tx_inflight = 0;
+    }
 }
 
 /**=============================================================================
- * @brief           put a character into ring buffer
+ * @brief           唤醒因发送缓冲满而等待的线程
  *
  * @param[in]       none
  *
  * @return          none
+ *
+ * @note            在 DMA 发送回调中调用，waiters 在关中断下加减
  *============================================================================*/
-rt_size_t rt_ringbuffer_putchar(struct rt_ringbuffer *rb, const rt_uint8_t ch)
+static void _uart_tx_wake(void)
 {
-    RT_ASSERT(rb != RT_NULL);
-
-    /* whether has enough space */
-    if (!rt_ringbuffer_space_len(rb))
-        return 0;
-
-    rb->buffer_ptr[rb->write_index] = ch;
-
-    /* flip mirror */
-    if (rb->write_index == rb->buffer_size-1)
+    while (uart_tx_waiters)
     {
-        rb->write_mirror = ~rb->write_mirror;
-        rb->write_index = 0;
+        uart_tx_waiters--;
+        rt_sem_release(&uart_tx_sem);
     }
-    else
-    {
-        rb->write_index++;
-    }
-
-    return 1;
 }
 
+#ifdef CONSOLE_GET_CHAR_DMA_MODE
 /**=============================================================================
- * @brief           get a character from a ringbuffer
+ * @brief           把 DMA 新收到的数据整块提交到接收 ringbuffer
  *
  * @param[in]       none
  *
  * @return          none
+ *
+ * @note            由空闲中断、DMA 过半和完成中断调用，三者同优先级不会嵌套；
+ *                  半满/全满中断保证两次调用之间不超过半个 DMA 缓冲
  *============================================================================*/
-rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch)
+static void _uart_rx_dma_update(void)
 {
-    RT_ASSERT(rb != RT_NULL);
-
-    /* ringbuffer is empty */
-    if (!rt_ringbuffer_data_len(rb))
-        return 0;
+    rt_uint32_t pos = UART_RX_DMA_BUF_LEN - __HAL_DMA_GET_COUNTER(&hdma_usart1_rx);
+    rt_size_t len, put;
 
-    /* put character */
-    *ch = rb->buffer_ptr[rb->read_index];
+    if (pos == UART_RX_DMA_BUF_LEN)
+        pos = 0;
+    if (pos == uart_rx_dma_pos)
+        return;
 
-    if (rb->read_index == rb->buffer_size-1)
+    if (pos > uart_rx_dma_pos)
     {
-        rb->read_mirror = ~rb->read_mirror;
-        rb->read_index = 0;
+        len = pos - uart_rx_dma_pos;
+        put = rt_ringbuffer_put(&uart_rxcb, &uart_rx_dma_buf[uart_rx_dma_pos], len);
     }
     else
     {
-        rb->read_index++;
+        len = UART_RX_DMA_BUF_LEN - uart_rx_dma_pos + pos;
+        put = rt_ringbuffer_put(&uart_rxcb, &uart_rx_dma_buf[uart_rx_dma_pos], UART_RX_DMA_BUF_LEN - uart_rx_dma_pos);
+        put += rt_ringbuffer_put(&uart_rxcb, &uart_rx_dma_buf[0], pos);
     }
+    /* 消费者来不及取走，ringbuffer 放不下的部分丢弃 */
+    uart_rx_dropped += len - put;
+    uart_rx_dma_pos = pos;
 
-    return 1;
+    /* 每块数据只通知一次 */
+    rt_sem_release(&shell_rx_sem);
 }
 
+#endif
 /**=============================================================================
  * @brief           初始化串口，中断方式
  *
@@ -190,6 +164,12 @@ rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch)
  *============================================================================*/
 static int rt_hw_uart_init(void)
 {
+    rt_base_t level;
+
+    /* 已由自动初始化完成，再次 HAL_UART_Init 会打断正在进行的 DMA 收发 */
+    if (uart_tx_ready)
+        return 0;
+
     /* 初始化串口接收 ringbuffer  */
     rt_ringbuffer_init(&uart_rxcb, uart_rx_buf, UART_RX_BUF_LEN);
 #ifdef CONSOLE_GET_CHAR_INT_MODE 
@@ -211,13 +191,30 @@ static int rt_hw_uart_init(void)
     {
         while (1);
     }
-
-#ifdef CONSOLE_GET_CHAR_INT_MODE
+    /* 运行时切换主频后自动重算波特率 */
+    sysclk_register_uart(&UartHandle);
+
+#if defined(CONSOLE_GET_CHAR_DMA_MODE)
+    /* 循环 DMA 接收，空闲中断用于提交不足半个缓冲的数据 */
+    HAL_UART_Receive_DMA(&UartHandle, uart_rx_dma_buf, UART_RX_DMA_BUF_LEN);
+    __HAL_UART_CLEAR_IDLEFLAG(&UartHandle);
+    __HAL_UART_ENABLE_IT(&UartHandle, UART_IT_IDLE);
+#elif defined(CONSOLE_GET_CHAR_INT_MODE)
     /* 中断配置 */
     __HAL_UART_ENABLE_IT(&UartHandle, UART_IT_RXNE);
-    HAL_NVIC_EnableIRQ(USART1_IRQn);
-    HAL_NVIC_SetPriority(USART1_IRQn, 3, 3);
 #endif 
+    /* 发送完成需要 TC 中断收尾，不论接收方式如何都打开串口中断 */
+    HAL_NVIC_SetPriority(USART1_IRQn, 3, 3);
+    HAL_NVIC_EnableIRQ(USART1_IRQn);
+
+    /* 初始化之前 rt_kprintf 的输出已缓存在发送缓冲中，此时开始发送 */
+    if (uart_txcb.buffer_ptr == RT_NULL)
+        rt_ringbuffer_init(&uart_txcb, uart_tx_buf, UART_TX_BUF_LEN);
+    rt_sem_init(&uart_tx_sem, "con_tx", 0, RT_IPC_FLAG_FIFO);
+    uart_tx_ready = 1;
+    level = rt_hw_interrupt_disable();
+    _uart_tx_kick();
+    rt_hw_interrupt_enable(level);
 
     return 0;
 }
@@ -231,23 +228,85 @@ INIT_BOARD_EXPORT(rt_hw_uart_init);
  * @return          none
  * 
  * @note            移植控制台，实现控制台输出, 对接 rt_hw_console_output
+ *                  输出只拷贝进发送缓冲（同时完成 \n -> \r\n 转换），由
+ *                  DMA 在后台发出。线程、中断和 rt_kputs 都可能同时输出，
+ *                  预留、拷贝、提交在关中断下完成，每次最多一段连续空间；
+ *                  缓冲满时线程阻塞在信号量上，由 DMA 发送回调唤醒；
+ *                  中断中或关中断时放不下整条就整条丢弃，避免死等
  *============================================================================*/
 void rt_hw_console_output(const char *str)
 {
-    rt_size_t i = 0, size = 0;
-    char a = '\r';
+    rt_base_t level;
+    rt_uint8_t *ptr;
+    rt_size_t n, i;
+    rt_bool_t cr_pending = RT_FALSE;
+    rt_bool_t can_wait;
+    const char *s;
+
+    /* 发送缓冲在 rt_hw_uart_init 之前就可能被用到 */
+    if (uart_txcb.buffer_ptr == RT_NULL)
+        rt_ringbuffer_init(&uart_txcb, uart_tx_buf, UART_TX_BUF_LEN);
 
-    __HAL_UNLOCK(&UartHandle);
+    can_wait = uart_tx_ready && rt_interrupt_get_nest() == 0 &&
+               __get_PRIMASK() == 0 && rt_thread_self() != RT_NULL;
 
-    size = rt_strlen(str);
-    for (i = 0; i < size; i++)
+    level = rt_hw_interrupt_disable();
+    if (!can_wait)
     {
-        if (*(str + i) == '\n')
+        /* 不能等待时整条放下或整条丢弃，不留下半行或孤立的 \r */
+        for (s = str, n = 0; *s != '\0'; s++)
+            n += *s == '\n' ? 2 : 1;
+        if (n > rt_ringbuffer_space_len(&uart_txcb))
         {
-            HAL_UART_Transmit(&UartHandle, (uint8_t *)&a, 1, 1);
+            rt_hw_interrupt_enable(level);
+            return;
         }
-        HAL_UART_Transmit(&UartHandle, (uint8_t *)(str + i), 1, 1);
     }
+
+    while (*str != '\0' || cr_pending)
+    {
+        /* 一次填满连续空间 */
+        n = rt_ringbuffer_put_reserve(&uart_txcb, &ptr);
+        for (i = 0; i < n && (*str != '\0' || cr_pending); i++)
+        {
+            if (*str == '\n' && !cr_pending)
+            {
+                ptr[i] = '\r';
+                cr_pending = RT_TRUE;
+            }
+            else
+            {
+                ptr[i] = *str++;
+                cr_pending = RT_FALSE;
+            }
+        }
+        rt_ringbuffer_put_commit(&uart_txcb, i);
+        /* 确保 DMA 在运行 */
+        _uart_tx_kick();
+
+        /* 不能等待时空间已预先确认，回绕的第二段在同一次关中断内写完 */
+        if (!can_wait)
+        {
+            if (n == 0)
+                break;
+            continue;
+        }
+        if (n == 0)
+            uart_tx_waiters++;
+        rt_hw_interrupt_enable(level);
+        if (n == 0 && rt_sem_take(&uart_tx_sem, UART_TX_WAIT_TICKS) == -RT_ETIMEOUT)
+        {
+            level = rt_hw_interrupt_disable();
+            /* 超时没人唤醒时撤回计数；超时后才被唤醒则收回多发的那次信号 */
+            if (uart_tx_waiters)
+                uart_tx_waiters--;
+            else
+                rt_sem_trytake(&uart_tx_sem);
+            continue;
+        }
+        level = rt_hw_interrupt_disable();
+    }
+    rt_hw_interrupt_enable(level);
 }
 
 /**=============================================================================
@@ -293,6 +352,18 @@ char rt_hw_console_getchar(void)
 }
 #endif
 
+/**=============================================================================
+ * @brief           接收 ringbuffer 满而丢弃的字节数
+ *
+ * @param[in]       none
+ *
+ * @return          字节数
+ *============================================================================*/
+rt_uint32_t rt_console_get_rx_dropped(void)
+{
+    return uart_rx_dropped;
+}
+
 /**=============================================================================
  * @brief           串口中断
  *
@@ -300,14 +371,23 @@ char rt_hw_console_getchar(void)
  *
  * @return          none
  *============================================================================*/
-#ifdef CONSOLE_GET_CHAR_INT_MODE
 void USART1_IRQHandler(void)
 {
+#if defined(CONSOLE_GET_CHAR_INT_MODE) && !defined(CONSOLE_GET_CHAR_DMA_MODE)
     int ch = -1;
-    rt_base_t level;
+#endif
     /* enter interrupt */
     rt_interrupt_enter();          //在中断中一定要调用这对函数，进入中断
 
+#if defined(CONSOLE_GET_CHAR_DMA_MODE)
+    /* 空闲或接收出错，读 SR 后读 DR 清除标志，再提交已收到的数据 */
+    if ((UartHandle.Instance->SR & (UART_FLAG_IDLE | UART_FLAG_ORE |
+                                    UART_FLAG_NE | UART_FLAG_FE | UART_FLAG_PE)) != RESET)
+    {
+        __HAL_UART_CLEAR_PEFLAG(&UartHandle);
+        _uart_rx_dma_update();
+    }
+#elif defined(CONSOLE_GET_CHAR_INT_MODE)
     if ((__HAL_UART_GET_FLAG(&(UartHandle), UART_FLAG_RXNE) != RESET) &&
         (__HAL_UART_GET_IT_SOURCE(&(UartHandle), UART_IT_RXNE) != RESET))
     {
@@ -323,15 +403,93 @@ void USART1_IRQHandler(void)
                 break;
             }  
             /* 读取到数据，将数据存入 ringbuffer */
-            rt_ringbuffer_putchar(&uart_rxcb, ch);
+            if (rt_ringbuffer_putchar(&uart_rxcb, ch) == 0)
+                uart_rx_dropped++;
         }        
         rt_sem_release(&shell_rx_sem);
     }
+#endif
+
+    /* DMA 发送的最后一个字节已移出，结束本次发送（同 UART_EndTransmit_IT） */
+    if ((__HAL_UART_GET_FLAG(&(UartHandle), UART_FLAG_TC) != RESET) &&
+        (__HAL_UART_GET_IT_SOURCE(&(UartHandle), UART_IT_TC) != RESET))
+    {
+        __HAL_UART_DISABLE_IT(&UartHandle, UART_IT_TC);
+        UartHandle.gState = HAL_UART_STATE_READY;
+        HAL_UART_TxCpltCallback(&UartHandle);
+    }
 
     /* leave interrupt */
     rt_interrupt_leave();    //在中断中一定要调用这对函数，离开中断
 }
-#endif 
+
+#ifdef CONSOLE_GET_CHAR_DMA_MODE
+/**=============================================================================
+ * @brief           DMA 接收过半
+ *
+ * @param[in]       huart 串口句柄
+ *
+ * @return          none
+ *============================================================================*/
+void HAL_UART_RxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART1)
+        _uart_rx_dma_update();
+}
+
+/**=============================================================================
+ * @brief           DMA 接收回绕
+ *
+ * @param[in]       huart 串口句柄
+ *
+ * @return          none
+ *============================================================================*/
+void HAL_UART_RxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance == USART1)
+        _uart_rx_dma_update();
+}
+#endif
+
+/**=============================================================================
+ * @brief           DMA 发送过半，提前释放已发出的一半空间
+ *
+ * @param[in]       huart 串口句柄
+ *
+ * @return          none
+ *============================================================================*/
+void HAL_UART_TxHalfCpltCallback(UART_HandleTypeDef *huart)
+{
+    rt_uint16_t half;
+
+    if (huart->Instance != USART1)
+        return;
+
+    half = huart->TxXferSize / 2;
+    if (half > uart_tx_inflight)
+        half = uart_tx_inflight;
+    rt_ringbuffer_skip(&uart_txcb, half);
+    uart_tx_inflight -= half;
+    _uart_tx_wake();
+}
+
+/**=============================================================================
+ * @brief           DMA 发送完成，释放剩余空间并发送下一段
+ *
+ * @param[in]       huart 串口句柄
+ *
+ * @return          none
+ *============================================================================*/
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+    if (huart->Instance != USART1)
+        return;
+
+    rt_ringbuffer_skip(&uart_txcb, uart_tx_inflight);
+    uart_tx_inflight = 0;
+    _uart_tx_kick();
+    _uart_tx_wake();
+}
 
 /**=============================================================================
  * @brief           
@@ -358,6 +516,30 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
 		GPIO_InitStruct.Pin = GPIO_PIN_10;			//PA10
 		GPIO_InitStruct.Mode = GPIO_MODE_AF_INPUT;	
 		HAL_GPIO_Init(GPIOA, &GPIO_InitStruct);	   		
+
+        /* USART1_TX 对应 DMA1 通道4，通道中断由 dma_alloc 分发 */
+        dma_alloc(&hdma_usart1_tx, DMA_REQ_USART1_TX, DMA_CLASS_STREAM);
+        hdma_usart1_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+        hdma_usart1_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+        hdma_usart1_tx.Init.MemInc              = DMA_MINC_ENABLE;
+        hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        hdma_usart1_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+        hdma_usart1_tx.Init.Mode                = DMA_NORMAL;
+        HAL_DMA_Init(&hdma_usart1_tx);
+        __HAL_LINKDMA(huart, hdmatx, hdma_usart1_tx);
+
+#ifdef CONSOLE_GET_CHAR_DMA_MODE
+        /* USART1_RX 对应 DMA1 通道5，循环模式，来不及搬走会丢数据 */
+        dma_alloc(&hdma_usart1_rx, DMA_REQ_USART1_RX, DMA_CLASS_LATENCY);
+        hdma_usart1_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+        hdma_usart1_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+        hdma_usart1_rx.Init.MemInc              = DMA_MINC_ENABLE;
+        hdma_usart1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+        hdma_usart1_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+        hdma_usart1_rx.Init.Mode                = DMA_CIRCULAR;
+        HAL_DMA_Init(&hdma_usart1_rx);
+        __HAL_LINKDMA(huart, hdmarx, hdma_usart1_rx);
+#endif
     }
 }
 
@@ -367,6 +549,8 @@ void HAL_UART_MspInit(UART_HandleTypeDef *huart)
  * @param[in]       none
  *
  * @return          none
+ *
+ * @note            开启自动初始化时 INIT_BOARD_EXPORT 已经调用过，这里直接返回
  *============================================================================*/
 void rt_console_init(void)
 {
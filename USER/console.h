@@ -15,6 +15,7 @@
 #define __CONSOLE_H_
 
 /* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
 
 #ifdef __cplusplus
 extern "C"{
@@ -26,6 +27,7 @@ extern "C"{
 /* Exported variables ------------------------------------------------------- */
 /* Exported functions ------------------------------------------------------- */
 void rt_console_init(void);
+rt_uint32_t rt_console_get_rx_dropped(void);
 
 #ifdef __cplusplus
 }
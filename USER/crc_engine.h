@@ -0,0 +1,55 @@
+/**
+  ******************************************************************************
+  * @file			crc_engine.h
+  * @brief			crc engine header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CRC_ENGINE_H_
+#define __CRC_ENGINE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define CRC_ENGINE_INIT_VALUE   0xFFFFFFFFUL    /*!< STM32 CRC 单元复位值 */
+#define CRC_ENGINE_POLY         0x04C11DB7UL    /*!< CRC-32，不反转 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 计算后端，结果与 HAL_CRC_Calculate 完全一致
+ *
+ * 数据按小端 32 位字送入，每个字从最高位开始计算；长度不是 4 的倍数时，
+ * 剩余字节逐字节（高位在前）用软件计算，各后端处理方式相同。
+ */
+typedef enum
+{
+    CRC_ENGINE_HW = 0,      /*!< CPU 逐字写 CRC->DR */
+    CRC_ENGINE_HW_DMA,      /*!< DMA 存储器到存储器写 CRC->DR，短数据或未对齐时退回 CPU 写 */
+    CRC_ENGINE_SW_SLICE4,   /*!< 软件查表，每次 4 字节 */
+    CRC_ENGINE_SW_SLICE8,   /*!< 软件查表，每次 8 字节 */
+    CRC_ENGINE_SW,          /*!< 软件查表，每次 1 字节，只用 1 KB 表 */
+} crc_engine_t;
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+int         crc_engine_init(void);
+rt_uint32_t crc_engine_calculate(crc_engine_t engine, const void *buf, rt_size_t len);
+rt_uint32_t crc_engine_accumulate(crc_engine_t engine, rt_uint32_t crc, const void *buf, rt_size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __CRC_ENGINE_H_ */
@@ -0,0 +1,316 @@
+/**
+  ******************************************************************************
+  * @file			dlog.c
+  * @brief			deferred formatting log, lock-free ring and drain thread
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <stdarg.h>
+#include <dlog.h>
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+#ifdef RT_USING_DLOG
+
+/* Private constants ---------------------------------------------------------*/
+#if (RT_DLOG_RING_SIZE & (RT_DLOG_RING_SIZE - 1)) != 0
+#error "RT_DLOG_RING_SIZE must be a power of two"
+#endif
+
+#define DLOG_MASK           (RT_DLOG_RING_SIZE - 1)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/**
+ * 槽位的 seq 等于 pos 时可写，等于 pos + 1 时可读（有界 MPMC 队列）
+ */
+struct dlog_slot
+{
+    volatile rt_uint32_t seq;
+    const char          *fmt;
+    rt_uint32_t          arg[DLOG_ARGS_MAX];
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct dlog_slot     dlog_ring[RT_DLOG_RING_SIZE];
+static volatile rt_uint32_t dlog_head;
+static volatile rt_uint32_t dlog_tail;
+static volatile rt_uint32_t dlog_dropped;
+static volatile rt_uint32_t dlog_wake;      /*!< 已通知后台线程、它还没开始取消息 */
+static rt_uint8_t           dlog_ready;
+
+static struct rt_semaphore  dlog_sem;
+static struct rt_thread     dlog_thread;
+ALIGN(RT_ALIGN_SIZE)
+static rt_uint8_t           dlog_stack[RT_DLOG_THREAD_STACK_SIZE];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           比较并交换
+ *
+ * @param[in]       addr   地址
+ * @param[in]       expect 期望的旧值
+ * @param[in]       value  新值
+ *
+ * @return          RT_TRUE 交换成功
+ *============================================================================*/
+static rt_bool_t _dlog_cas(volatile rt_uint32_t *addr, rt_uint32_t expect, rt_uint32_t value)
+{
+    do
+    {
+        if (__LDREXW(addr) != expect)
+        {
+            __CLREX();
+            return RT_FALSE;
+        }
+    } while (__STREXW(value, addr) != 0);
+
+    return RT_TRUE;
+}
+
+/**=============================================================================
+ * @brief           原子加一
+ *
+ * @param[in]       addr 地址
+ *
+ * @return          none
+ *============================================================================*/
+static void _dlog_inc(volatile rt_uint32_t *addr)
+{
+    rt_uint32_t v;
+
+    do
+    {
+        v = __LDREXW(addr);
+    } while (__STREXW(v + 1, addr) != 0);
+}
+
+/**=============================================================================
+ * @brief           取出最旧的一条消息
+ *
+ * @param[out]      out 消息，为 RT_NULL 时只丢弃
+ *
+ * @return          RT_EOK 成功，-RT_EEMPTY 没有消息
+ *
+ * @note            溢出策略为丢弃最旧时生产者也会调用，所以同样用 CAS
+ *============================================================================*/
+static rt_err_t _dlog_pop(struct dlog_slot *out)
+{
+    struct dlog_slot *slot;
+    rt_uint32_t pos;
+
+    for (;;)
+    {
+        pos  = dlog_tail;
+        slot = &dlog_ring[pos & DLOG_MASK];
+        if ((rt_int32_t)(slot->seq - (pos + 1)) < 0)
+            return -RT_EEMPTY;
+        if (slot->seq != pos + 1)
+            continue;                       /* tail 已被别人推进，重新读取 */
+
+        if (_dlog_cas(&dlog_tail, pos, pos + 1))
+            break;
+    }
+
+    if (out)
+        *out = *slot;
+    __DMB();
+    slot->seq = pos + RT_DLOG_RING_SIZE;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           写入一条消息
+ *
+ * @param[in]       fmt  格式串
+ * @param[in]       arg  参数
+ *
+ * @return          RT_EOK 成功，-RT_EFULL 已满
+ *============================================================================*/
+static rt_err_t _dlog_push(const char *fmt, const rt_uint32_t *arg)
+{
+    struct dlog_slot *slot;
+    rt_uint32_t pos, i;
+
+    for (;;)
+    {
+        pos  = dlog_head;
+        slot = &dlog_ring[pos & DLOG_MASK];
+        if ((rt_int32_t)(slot->seq - pos) < 0)
+            return -RT_EFULL;
+        if (slot->seq != pos)
+            continue;
+
+        if (_dlog_cas(&dlog_head, pos, pos + 1))
+            break;
+    }
+
+    slot->fmt = fmt;
+    for (i = 0; i < DLOG_ARGS_MAX; i++)
+        slot->arg[i] = arg[i];
+    __DMB();
+    slot->seq = pos + 1;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           后台线程，格式化并输出
+ *
+ * @param[in]       parameter 未使用
+ *
+ * @return          none
+ *============================================================================*/
+static void _dlog_thread_entry(void *parameter)
+{
+    char buf[RT_CONSOLEBUF_SIZE];
+    struct dlog_slot msg;
+
+    for (;;)
+    {
+        rt_sem_take(&dlog_sem, RT_WAITING_FOREVER);
+
+        /* 先清通知标志再取：此后写入的消息要么本轮取到，要么重新通知 */
+        dlog_wake = 0;
+        __DMB();
+        while (_dlog_pop(&msg) == RT_EOK)
+        {
+            rt_snprintf(buf, sizeof(buf), msg.fmt, msg.arg[0], msg.arg[1], msg.arg[2], msg.arg[3]);
+            rt_kputs(buf);
+        }
+    }
+}
+
+/**=============================================================================
+ * @brief           创建后台输出线程
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+int dlog_init(void)
+{
+    rt_uint32_t i;
+
+    for (i = 0; i < RT_DLOG_RING_SIZE; i++)
+        dlog_ring[i].seq = i;
+
+    rt_sem_init(&dlog_sem, "dlog", 0, RT_IPC_FLAG_FIFO);
+    rt_thread_init(&dlog_thread, "dlog", _dlog_thread_entry, RT_NULL,
+                   dlog_stack, sizeof(dlog_stack), RT_DLOG_THREAD_PRIORITY, 10);
+    rt_thread_startup(&dlog_thread);
+    dlog_ready = 1;
+
+    return 0;
+}
+INIT_ENV_EXPORT(dlog_init);
+
+/**=============================================================================
+ * @brief           记录一条日志，只保存格式串指针和参数
+ *
+ * @param[in]       fmt 格式串
+ * @param[in]       ... 参数
+ *
+ * @return          none
+ *============================================================================*/
+void dlog(const char *fmt, ...)
+{
+    rt_uint32_t arg[DLOG_ARGS_MAX] = {0};
+    rt_uint32_t n = 0;
+    const char *p;
+    va_list ap;
+
+    if (!dlog_ready)
+        return;
+
+    /* 按转换说明的个数取参数，%% 不占参数，* 宽度占一个 */
+    va_start(ap, fmt);
+    for (p = fmt; *p && n < DLOG_ARGS_MAX; p++)
+    {
+        if (*p != '%')
+            continue;
+        if (*++p == '%')
+            continue;
+        for (; *p && n < DLOG_ARGS_MAX; p++)
+        {
+            if (*p == '*')
+                arg[n++] = va_arg(ap, rt_uint32_t);
+            else if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z'))
+                break;
+        }
+        if (*p == '\0')
+            break;
+        if (n < DLOG_ARGS_MAX)
+            arg[n++] = va_arg(ap, rt_uint32_t);
+    }
+    va_end(ap);
+
+    while (_dlog_push(fmt, arg) != RT_EOK)
+    {
+#if RT_DLOG_OVERFLOW_POLICY == DLOG_OVERFLOW_DROP_OLDEST
+        /* 最旧的一条可能正被打断的生产者占着，此时只能丢弃本条 */
+        _dlog_inc(&dlog_dropped);
+        if (_dlog_pop(RT_NULL) != RT_EOK)
+            return;
+#elif RT_DLOG_OVERFLOW_POLICY == DLOG_OVERFLOW_BLOCK
+        if (rt_thread_self() == RT_NULL || rt_interrupt_get_nest() != 0 || __get_PRIMASK())
+        {
+            _dlog_inc(&dlog_dropped);
+            return;
+        }
+        rt_sem_release(&dlog_sem);
+        rt_thread_delay(1);
+#else
+        _dlog_inc(&dlog_dropped);
+        return;
+#endif
+    }
+
+    /* 后台线程还没处理上次的通知时，本条会一起输出 */
+    if (_dlog_cas(&dlog_wake, 0, 1))
+        rt_sem_release(&dlog_sem);
+}
+
+/**=============================================================================
+ * @brief           因溢出丢弃的消息数
+ *
+ * @param[in]       none
+ *
+ * @return          消息数
+ *============================================================================*/
+rt_uint32_t dlog_get_dropped(void)
+{
+    return dlog_dropped;
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           打印日志缓冲状态
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int dlog_stat(void)
+{
+    rt_kprintf("pending %u/%u, dropped %u\n",
+               dlog_head - dlog_tail, RT_DLOG_RING_SIZE, dlog_dropped);
+
+    return 0;
+}
+MSH_CMD_EXPORT(dlog_stat, show deferred log ring usage);
+#endif
+
+#endif  /* RT_USING_DLOG */
@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file			dlog.h
+  * @brief			deferred formatting log header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DLOG_H_
+#define __DLOG_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define DLOG_ARGS_MAX               4       /*!< 每条消息最多保存的参数个数 */
+
+#define DLOG_OVERFLOW_DROP_NEWEST   0       /*!< 丢弃新消息 */
+#define DLOG_OVERFLOW_DROP_OLDEST   1       /*!< 丢弃最旧的消息 */
+#define DLOG_OVERFLOW_BLOCK         2       /*!< 线程中等待空间，中断中退化为丢弃新消息 */
+
+#ifndef RT_DLOG_RING_SIZE
+#define RT_DLOG_RING_SIZE           32
+#endif
+#ifndef RT_DLOG_OVERFLOW_POLICY
+#define RT_DLOG_OVERFLOW_POLICY     DLOG_OVERFLOW_DROP_NEWEST
+#endif
+#ifndef RT_DLOG_THREAD_PRIORITY
+#define RT_DLOG_THREAD_PRIORITY     (RT_THREAD_PRIORITY_MAX - 2)
+#endif
+#ifndef RT_DLOG_THREAD_STACK_SIZE
+#define RT_DLOG_THREAD_STACK_SIZE   512
+#endif
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+/**
+ * 用法同 rt_kprintf，但调用者只保存格式串指针和参数，格式化和输出由后台
+ * 线程完成。参数按 32 位整数保存，因此：
+ *  - 格式串和 %s 指向的字符串必须在输出之前一直有效（一般用字符串常量）
+ *  - 不支持浮点和 64 位参数，超过 DLOG_ARGS_MAX 个的参数被忽略
+ * 任意上下文可调用，包括中断
+ */
+void        dlog(const char *fmt, ...);
+int         dlog_init(void);
+rt_uint32_t dlog_get_dropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DLOG_H_ */
@@ -0,0 +1,379 @@
+/**
+  ******************************************************************************
+  * @file			dma_alloc.c
+  * @brief			dma channel allocation, priority and shared irq dispatch
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <dma_alloc.h>
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#define _DMA_REQ_CHANNEL(name, ch)  ch,
+#define _DMA_REQ_NAME(name, ch)     #name,
+
+/* Private macro -------------------------------------------------------------*/
+#define DMA_CHANNEL(inst, irq)      {inst, irq, RT_NULL, RT_NULL, RT_NULL, -1, 0, 0, 0, 0}
+/* Private typedef -----------------------------------------------------------*/
+struct dma_channel
+{
+    DMA_Channel_TypeDef *instance;
+    IRQn_Type            irqn;
+    DMA_HandleTypeDef   *hdma;              /*!< 占用者，空闲时为 RT_NULL */
+    dma_irq_hook_t       hook;
+    void                *hook_arg;
+    rt_int16_t           request;
+    rt_uint32_t          alloc_count;
+    rt_uint32_t          irq_count;
+    rt_tick_t            alloc_tick;
+    rt_tick_t            busy_ticks;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static const rt_uint8_t dma_request_channel[DMA_REQ_NUM] =
+{
+    DMA_REQUEST_TABLE(_DMA_REQ_CHANNEL)
+};
+
+static const char * const dma_request_name[DMA_REQ_NUM] =
+{
+    DMA_REQUEST_TABLE(_DMA_REQ_NAME)
+};
+
+/* 存储器到存储器优先占用本板不太会用到的 DMA2 通道 */
+static const rt_uint8_t dma_mem2mem_order[DMA_CH_NUM] =
+{
+    DMA_CH2_1, DMA_CH2_2, DMA_CH2_3, DMA_CH2_4, DMA_CH2_5, DMA_CH1_1,
+    DMA_CH1_7, DMA_CH1_6, DMA_CH1_3, DMA_CH1_2, DMA_CH1_5, DMA_CH1_4,
+};
+
+static const rt_uint32_t dma_class_priority[DMA_CLASS_NUM] =
+{
+    DMA_PRIORITY_LOW, DMA_PRIORITY_MEDIUM, DMA_PRIORITY_HIGH, DMA_PRIORITY_VERY_HIGH,
+};
+
+static struct dma_channel dma_channels[DMA_CH_NUM] =
+{
+    DMA_CHANNEL(DMA1_Channel1, DMA1_Channel1_IRQn),
+    DMA_CHANNEL(DMA1_Channel2, DMA1_Channel2_IRQn),
+    DMA_CHANNEL(DMA1_Channel3, DMA1_Channel3_IRQn),
+    DMA_CHANNEL(DMA1_Channel4, DMA1_Channel4_IRQn),
+    DMA_CHANNEL(DMA1_Channel5, DMA1_Channel5_IRQn),
+    DMA_CHANNEL(DMA1_Channel6, DMA1_Channel6_IRQn),
+    DMA_CHANNEL(DMA1_Channel7, DMA1_Channel7_IRQn),
+    DMA_CHANNEL(DMA2_Channel1, DMA2_Channel1_IRQn),
+    DMA_CHANNEL(DMA2_Channel2, DMA2_Channel2_IRQn),
+    DMA_CHANNEL(DMA2_Channel3, DMA2_Channel3_IRQn),
+    DMA_CHANNEL(DMA2_Channel4, DMA2_Channel4_5_IRQn),
+    DMA_CHANNEL(DMA2_Channel5, DMA2_Channel4_5_IRQn),
+};
+
+static rt_uint32_t dma_conflicts;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           由句柄找到通道编号
+ *
+ * @param[in]       hdma DMA 句柄
+ *
+ * @return          通道编号，没有分配时为 DMA_CH_NUM
+ *============================================================================*/
+static rt_uint32_t _dma_find(DMA_HandleTypeDef *hdma)
+{
+    rt_uint32_t i;
+
+    for (i = 0; i < DMA_CH_NUM; i++)
+    {
+        if (dma_channels[i].hdma == hdma)
+            break;
+    }
+
+    return i;
+}
+
+/**=============================================================================
+ * @brief           分发通道中断
+ *
+ * @param[in]       ch 通道编号
+ *
+ * @return          none
+ *============================================================================*/
+static void _dma_dispatch(rt_uint32_t ch)
+{
+    struct dma_channel *c = &dma_channels[ch];
+
+    c->irq_count++;
+    if (c->hdma == RT_NULL)
+    {
+        /* 没有占用者的通道不应产生中断，关掉它 */
+        c->instance->CCR &= ~(DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE);
+        return;
+    }
+    if (c->hook && c->hook(c->hook_arg))
+        return;
+
+    HAL_DMA_IRQHandler(c->hdma);
+}
+
+/**=============================================================================
+ * @brief           为外设请求分配通道，并按流量类别设置优先级
+ *
+ * @param[in]       hdma    DMA 句柄，成功后 Instance 和 Init.Priority 已填好
+ * @param[in]       request 外设请求
+ * @param[in]       cls     流量类别
+ *
+ * @return          RT_EOK 成功，-RT_EBUSY 通道已被占用
+ *
+ * @note            之后由调用者填写其余 Init 字段并调用 HAL_DMA_Init；通道中断
+ *                  由本模块统一分发到 HAL_DMA_IRQHandler，不需要再写中断函数
+ *============================================================================*/
+rt_err_t dma_alloc(DMA_HandleTypeDef *hdma, dma_request_t request, dma_class_t cls)
+{
+    struct dma_channel *c = RT_NULL;
+    rt_uint32_t i, ch;
+    rt_base_t level;
+
+    RT_ASSERT(hdma != RT_NULL);
+    RT_ASSERT((rt_uint32_t)request < DMA_REQ_NUM);
+    RT_ASSERT((rt_uint32_t)cls < DMA_CLASS_NUM);
+
+    level = rt_hw_interrupt_disable();
+
+    ch = dma_request_channel[request];
+    if (ch == DMA_CH_ANY)
+    {
+        /* 重复分配时沿用原来的通道 */
+        i = _dma_find(hdma);
+        if (i < DMA_CH_NUM)
+            c = &dma_channels[i];
+        for (i = 0; c == RT_NULL && i < DMA_CH_NUM; i++)
+        {
+            if (dma_channels[dma_mem2mem_order[i]].hdma == RT_NULL)
+            {
+                c = &dma_channels[dma_mem2mem_order[i]];
+                break;
+            }
+        }
+    }
+    else if (dma_channels[ch].hdma == RT_NULL || dma_channels[ch].hdma == hdma)
+    {
+        c = &dma_channels[ch];
+    }
+
+    if (c == RT_NULL)
+    {
+        dma_conflicts++;
+        rt_hw_interrupt_enable(level);
+        return -RT_EBUSY;
+    }
+
+    c->hdma       = hdma;
+    c->hook       = RT_NULL;
+    c->request    = (rt_int16_t)request;
+    c->alloc_tick = rt_tick_get();
+    c->alloc_count++;
+    rt_hw_interrupt_enable(level);
+
+    hdma->Instance      = c->instance;
+    hdma->Init.Priority = dma_class_priority[cls];
+
+    if (c->instance < DMA2_Channel1)
+        __HAL_RCC_DMA1_CLK_ENABLE();
+    else
+        __HAL_RCC_DMA2_CLK_ENABLE();
+
+    HAL_NVIC_SetPriority(c->irqn, 3, 3);
+    HAL_NVIC_EnableIRQ(c->irqn);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           释放通道，调用前应已停止传输（HAL_DMA_Abort/DeInit）
+ *
+ * @param[in]       hdma DMA 句柄
+ *
+ * @return          none
+ *============================================================================*/
+void dma_free(DMA_HandleTypeDef *hdma)
+{
+    struct dma_channel *c;
+    rt_uint32_t ch;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    ch = _dma_find(hdma);
+    if (ch == DMA_CH_NUM)
+    {
+        rt_hw_interrupt_enable(level);
+        return;
+    }
+    c = &dma_channels[ch];
+
+    c->instance->CCR &= ~(DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_HTIE | DMA_CCR_TEIE);
+    c->busy_ticks += rt_tick_get() - c->alloc_tick;
+    c->hdma    = RT_NULL;
+    c->hook    = RT_NULL;
+    c->request = -1;
+
+    /* DMA2 通道 4、5 共用一个中断 */
+    if (!(ch == DMA_CH2_4 && dma_channels[DMA_CH2_5].hdma) &&
+        !(ch == DMA_CH2_5 && dma_channels[DMA_CH2_4].hdma))
+        HAL_NVIC_DisableIRQ(c->irqn);
+    rt_hw_interrupt_enable(level);
+
+    hdma->Instance = RT_NULL;
+}
+
+/**=============================================================================
+ * @brief           设置通道中断的前置处理，返回 RT_TRUE 时不再调用
+ *                  HAL_DMA_IRQHandler，用于绕过 HAL 的传输（如分散-聚集）
+ *
+ * @param[in]       hdma 已分配的 DMA 句柄
+ * @param[in]       hook 前置处理，RT_NULL 取消
+ * @param[in]       arg  参数
+ *
+ * @return          none
+ *============================================================================*/
+void dma_set_irq_hook(DMA_HandleTypeDef *hdma, dma_irq_hook_t hook, void *arg)
+{
+    rt_uint32_t ch;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    ch = _dma_find(hdma);
+    if (ch < DMA_CH_NUM)
+    {
+        dma_channels[ch].hook     = hook;
+        dma_channels[ch].hook_arg = arg;
+    }
+    rt_hw_interrupt_enable(level);
+
+    RT_ASSERT(ch < DMA_CH_NUM);
+}
+
+/**=============================================================================
+ * @brief           读取通道使用统计
+ *
+ * @param[in]       ch    通道编号 DMA_CHx_y
+ * @param[out]      stats 统计
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t dma_get_channel_stats(rt_uint32_t ch, struct dma_channel_stats *stats)
+{
+    struct dma_channel *c;
+    rt_base_t level;
+
+    RT_ASSERT(stats != RT_NULL);
+
+    if (ch >= DMA_CH_NUM)
+        return -RT_EINVAL;
+    c = &dma_channels[ch];
+
+    level = rt_hw_interrupt_disable();
+    stats->request     = c->hdma ? c->request : -1;
+    stats->priority    = (rt_uint8_t)((c->instance->CCR & DMA_CCR_PL) >> DMA_CCR_PL_Pos);
+    stats->alloc_count = c->alloc_count;
+    stats->irq_count   = c->irq_count;
+    stats->busy_ticks  = c->busy_ticks + (c->hdma ? rt_tick_get() - c->alloc_tick : 0);
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           因通道被占用而分配失败的次数
+ *
+ * @param[in]       none
+ *
+ * @return          次数
+ *============================================================================*/
+rt_uint32_t dma_get_conflicts(void)
+{
+    return dma_conflicts;
+}
+
+/* 中断函数 ------------------------------------------------------------------*/
+#define DMA_IRQ_HANDLER(name, ch)                                               \
+void name(void)                                                                 \
+{                                                                               \
+    rt_interrupt_enter();                                                       \
+    _dma_dispatch(ch);                                                          \
+    rt_interrupt_leave();                                                       \
+}
+
+DMA_IRQ_HANDLER(DMA1_Channel1_IRQHandler, DMA_CH1_1)
+DMA_IRQ_HANDLER(DMA1_Channel2_IRQHandler, DMA_CH1_2)
+DMA_IRQ_HANDLER(DMA1_Channel3_IRQHandler, DMA_CH1_3)
+DMA_IRQ_HANDLER(DMA1_Channel4_IRQHandler, DMA_CH1_4)
+DMA_IRQ_HANDLER(DMA1_Channel5_IRQHandler, DMA_CH1_5)
+DMA_IRQ_HANDLER(DMA1_Channel6_IRQHandler, DMA_CH1_6)
+DMA_IRQ_HANDLER(DMA1_Channel7_IRQHandler, DMA_CH1_7)
+DMA_IRQ_HANDLER(DMA2_Channel1_IRQHandler, DMA_CH2_1)
+DMA_IRQ_HANDLER(DMA2_Channel2_IRQHandler, DMA_CH2_2)
+DMA_IRQ_HANDLER(DMA2_Channel3_IRQHandler, DMA_CH2_3)
+
+/**=============================================================================
+ * @brief           DMA2 通道 4、5 共用的中断，按标志分发
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+void DMA2_Channel4_5_IRQHandler(void)
+{
+    rt_uint32_t isr;
+
+    rt_interrupt_enter();
+    isr = DMA2->ISR;
+    if (isr & (DMA_ISR_GIF4 | DMA_ISR_TCIF4 | DMA_ISR_HTIF4 | DMA_ISR_TEIF4))
+        _dma_dispatch(DMA_CH2_4);
+    if (isr & (DMA_ISR_GIF5 | DMA_ISR_TCIF5 | DMA_ISR_HTIF5 | DMA_ISR_TEIF5))
+        _dma_dispatch(DMA_CH2_5);
+    rt_interrupt_leave();
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           打印各通道占用和统计
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int dma(void)
+{
+    static const char * const prio[] = {"low", "medium", "high", "vhigh"};
+    struct dma_channel_stats st;
+    rt_uint32_t ch;
+
+    rt_kprintf("chan    owner      prio    allocs     irqs   busy(tick)\n");
+    for (ch = 0; ch < DMA_CH_NUM; ch++)
+    {
+        dma_get_channel_stats(ch, &st);
+        rt_kprintf("DMA%d.%d  %-10s %-6s %7u %8u %10u\n",
+                   ch < DMA_CH2_1 ? 1 : 2, ch < DMA_CH2_1 ? ch + 1 : ch - DMA_CH2_1 + 1,
+                   st.request < 0 ? "-" : dma_request_name[st.request],
+                   st.request < 0 ? "-" : prio[st.priority & 3],
+                   st.alloc_count, st.irq_count, st.busy_ticks);
+    }
+    rt_kprintf("conflicts %u\n", dma_conflicts);
+
+    return 0;
+}
+MSH_CMD_EXPORT(dma, show dma channel owners and usage);
+#endif
@@ -0,0 +1,119 @@
+/**
+  ******************************************************************************
+  * @file			dma_alloc.h
+  * @brief			dma channel allocator header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DMA_ALLOC_H_
+#define __DMA_ALLOC_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+/* 通道编号：DMA1 通道 1~7 为 0~6，DMA2 通道 1~5 为 7~11 */
+#define DMA_CH1_1       0
+#define DMA_CH1_2       1
+#define DMA_CH1_3       2
+#define DMA_CH1_4       3
+#define DMA_CH1_5       4
+#define DMA_CH1_6       5
+#define DMA_CH1_7       6
+#define DMA_CH2_1       7
+#define DMA_CH2_2       8
+#define DMA_CH2_3       9
+#define DMA_CH2_4       10
+#define DMA_CH2_5       11
+#define DMA_CH_NUM      12
+#define DMA_CH_ANY      0xFF            /*!< 存储器到存储器，任意空闲通道 */
+
+/* Exported macros -----------------------------------------------------------*/
+/**
+ * STM32F103xE 的 DMA 请求映射（RM0008 表 78、79），F1 没有请求复用器，
+ * 除存储器到存储器外每个请求只能使用固定的通道
+ */
+#define DMA_REQUEST_TABLE(X)                                                    \
+    X(MEM2MEM,   DMA_CH_ANY)                                                    \
+    X(ADC1,      DMA_CH1_1)  X(ADC3,      DMA_CH2_5)                            \
+    X(SPI1_RX,   DMA_CH1_2)  X(SPI1_TX,   DMA_CH1_3)                            \
+    X(SPI2_RX,   DMA_CH1_4)  X(SPI2_TX,   DMA_CH1_5)                            \
+    X(SPI3_RX,   DMA_CH2_1)  X(SPI3_TX,   DMA_CH2_2)                            \
+    X(USART1_TX, DMA_CH1_4)  X(USART1_RX, DMA_CH1_5)                            \
+    X(USART2_TX, DMA_CH1_7)  X(USART2_RX, DMA_CH1_6)                            \
+    X(USART3_TX, DMA_CH1_2)  X(USART3_RX, DMA_CH1_3)                            \
+    X(UART4_TX,  DMA_CH2_5)  X(UART4_RX,  DMA_CH2_3)                            \
+    X(I2C1_TX,   DMA_CH1_6)  X(I2C1_RX,   DMA_CH1_7)                            \
+    X(I2C2_TX,   DMA_CH1_4)  X(I2C2_RX,   DMA_CH1_5)                            \
+    X(SDIO,      DMA_CH2_4)                                                     \
+    X(DAC_CH1,   DMA_CH2_3)  X(DAC_CH2,   DMA_CH2_4)                            \
+    X(TIM1_UP,   DMA_CH1_5)  X(TIM1_CH1,  DMA_CH1_2)  X(TIM1_CH2,  DMA_CH1_3)   \
+    X(TIM1_CH3,  DMA_CH1_6)  X(TIM1_CH4,  DMA_CH1_4)                            \
+    X(TIM2_UP,   DMA_CH1_2)  X(TIM2_CH1,  DMA_CH1_5)  X(TIM2_CH2,  DMA_CH1_7)   \
+    X(TIM2_CH3,  DMA_CH1_1)  X(TIM2_CH4,  DMA_CH1_7)                            \
+    X(TIM3_UP,   DMA_CH1_3)  X(TIM3_CH1,  DMA_CH1_6)  X(TIM3_CH3,  DMA_CH1_2)   \
+    X(TIM3_CH4,  DMA_CH1_3)                                                     \
+    X(TIM4_UP,   DMA_CH1_7)  X(TIM4_CH1,  DMA_CH1_1)  X(TIM4_CH2,  DMA_CH1_4)   \
+    X(TIM4_CH3,  DMA_CH1_5)                                                     \
+    X(TIM5_UP,   DMA_CH2_2)  X(TIM5_CH1,  DMA_CH2_5)  X(TIM5_CH2,  DMA_CH2_4)   \
+    X(TIM5_CH3,  DMA_CH2_2)  X(TIM5_CH4,  DMA_CH2_1)                            \
+    X(TIM6_UP,   DMA_CH2_3)  X(TIM7_UP,   DMA_CH2_4)                            \
+    X(TIM8_UP,   DMA_CH2_1)  X(TIM8_CH1,  DMA_CH2_3)  X(TIM8_CH2,  DMA_CH2_5)   \
+    X(TIM8_CH3,  DMA_CH2_1)  X(TIM8_CH4,  DMA_CH2_2)
+
+#define _DMA_REQ_ENUM(name, ch)     DMA_REQ_##name,
+
+/* Exported typedef ----------------------------------------------------------*/
+typedef enum
+{
+    DMA_REQUEST_TABLE(_DMA_REQ_ENUM)
+    DMA_REQ_NUM
+} dma_request_t;
+
+/**
+ * 流量类别，决定通道仲裁优先级
+ */
+typedef enum
+{
+    DMA_CLASS_BULK = 0,                 /*!< 内存拷贝、校验等，可以等待 */
+    DMA_CLASS_STREAM,                   /*!< 连续的外设数据流，如串口发送 */
+    DMA_CLASS_LATENCY,                  /*!< 来不及搬走就会溢出，如串口接收、ADC */
+    DMA_CLASS_REALTIME,                 /*!< 严格定时，如定时器驱动的波形输出 */
+    DMA_CLASS_NUM
+} dma_class_t;
+
+typedef rt_bool_t (*dma_irq_hook_t)(void *arg);
+
+struct dma_channel_stats
+{
+    rt_int16_t  request;                /*!< 当前占用者的请求，-1 表示空闲 */
+    rt_uint8_t  priority;               /*!< DMA_PRIORITY_xxx >> DMA_CCR_PL_Pos */
+    rt_uint32_t alloc_count;
+    rt_uint32_t irq_count;
+    rt_tick_t   busy_ticks;             /*!< 累计被占用的时间，含当前占用 */
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t    dma_alloc(DMA_HandleTypeDef *hdma, dma_request_t request, dma_class_t cls);
+void        dma_free(DMA_HandleTypeDef *hdma);
+void        dma_set_irq_hook(DMA_HandleTypeDef *hdma, dma_irq_hook_t hook, void *arg);
+rt_err_t    dma_get_channel_stats(rt_uint32_t ch, struct dma_channel_stats *stats);
+rt_uint32_t dma_get_conflicts(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DMA_ALLOC_H_ */
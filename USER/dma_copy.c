@@ -0,0 +1,299 @@
+/**
+  ******************************************************************************
+  * @file			dma_copy.c
+  * @brief			asynchronous memory to memory copy on a dma channel
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <string.h>
+#include <dma_copy.h>
+#include <dma_alloc.h>
+
+/* Private constants ---------------------------------------------------------*/
+#define DMA_COPY_MAX_ITEMS  0xFFFF      /*!< CNDTR 为 16 位 */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static DMA_HandleTypeDef    hdma_copy;
+static struct dma_copy_req *dma_copy_head;      /*!< 正在传输的请求 */
+static struct dma_copy_req *dma_copy_tail;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           启动当前请求的下一段，关中断或在中断中调用
+ *
+ * @param[in]       req 请求
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _dma_copy_start(struct dma_copy_req *req)
+{
+    rt_uint32_t items, size;
+
+    items = (req->len - req->offset) / req->width;
+    if (items > DMA_COPY_MAX_ITEMS)
+        items = DMA_COPY_MAX_ITEMS;
+
+    size = req->width == 4 ? DMA_PDATAALIGN_WORD | DMA_MDATAALIGN_WORD :
+           req->width == 2 ? DMA_PDATAALIGN_HALFWORD | DMA_MDATAALIGN_HALFWORD :
+                             DMA_PDATAALIGN_BYTE | DMA_MDATAALIGN_BYTE;
+    hdma_copy.Init.PeriphDataAlignment = size & DMA_CCR_PSIZE;
+    hdma_copy.Init.MemDataAlignment    = size & DMA_CCR_MSIZE;
+    MODIFY_REG(hdma_copy.Instance->CCR, DMA_CCR_PSIZE | DMA_CCR_MSIZE, size);
+
+    /* 存储器到存储器时 CPAR 为源，CMAR 为目的 */
+    if (HAL_DMA_Start_IT(&hdma_copy, (uint32_t)(rt_ubase_t)req->src + req->offset,
+                         (uint32_t)(rt_ubase_t)req->dst + req->offset, items) != HAL_OK)
+        return -RT_EIO;
+
+    req->offset += items * req->width;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           结束队首请求，然后按顺序处理后面的请求：排队的小块直接
+ *                  用 CPU 拷贝，遇到需要 DMA 的请求启动后返回。关中断或在
+ *                  中断中调用
+ *
+ * @param[in]       result 队首请求的结果
+ *
+ * @return          none
+ *============================================================================*/
+static void _dma_copy_finish(rt_err_t result)
+{
+    struct dma_copy_req *req;
+
+    while ((req = dma_copy_head) != RT_NULL)
+    {
+        dma_copy_head = req->next;
+        if (dma_copy_head == RT_NULL)
+            dma_copy_tail = RT_NULL;
+
+        req->result = result;
+        if (req->done)
+            req->done(req);
+        if (req->sem)
+            rt_sem_release(req->sem);
+
+        if ((req = dma_copy_head) == RT_NULL)
+            break;
+        if (req->width == 0)
+        {
+            memcpy(req->dst, req->src, req->len);
+            result = RT_EOK;
+            continue;
+        }
+        /* 启动失败的请求直接结束，继续尝试下一个 */
+        if (_dma_copy_start(req) == RT_EOK)
+            break;
+        result = -RT_EIO;
+    }
+}
+
+/**=============================================================================
+ * @brief           队列为空时用 CPU 完成小块拷贝
+ *
+ * @param[in]       dst 目的
+ * @param[in]       src 源
+ * @param[in]       len 字节数，小于 DMA_COPY_THRESHOLD
+ *
+ * @return          RT_TRUE 已完成，RT_FALSE 前面还有请求，必须排队
+ *
+ * @note            检查和拷贝都在关中断中进行，前面提交的请求不会在拷贝之后
+ *                  才写到同一块内存
+ *============================================================================*/
+static rt_bool_t _dma_copy_cpu(void *dst, const void *src, rt_size_t len)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (dma_copy_head != RT_NULL)
+    {
+        rt_hw_interrupt_enable(level);
+        return RT_FALSE;
+    }
+    memcpy(dst, src, len);
+    rt_hw_interrupt_enable(level);
+
+    return RT_TRUE;
+}
+
+/**=============================================================================
+ * @brief           一段传输完成
+ *
+ * @param[in]       hdma DMA 句柄
+ *
+ * @return          none
+ *============================================================================*/
+static void _dma_copy_cplt(DMA_HandleTypeDef *hdma)
+{
+    struct dma_copy_req *req = dma_copy_head;
+
+    if (req->offset < req->len)
+    {
+        if (_dma_copy_start(req) == RT_EOK)
+            return;
+        _dma_copy_finish(-RT_EIO);
+        return;
+    }
+
+    _dma_copy_finish(RT_EOK);
+}
+
+/**=============================================================================
+ * @brief           传输出错
+ *
+ * @param[in]       hdma DMA 句柄
+ *
+ * @return          none
+ *============================================================================*/
+static void _dma_copy_error(DMA_HandleTypeDef *hdma)
+{
+    _dma_copy_finish(-RT_EIO);
+}
+
+/**=============================================================================
+ * @brief           初始化拷贝通道
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *
+ * @note            没有空闲通道时所有拷贝退回 CPU 完成
+ *============================================================================*/
+int dma_copy_init(void)
+{
+    /* 让外设请求优先 */
+    if (dma_alloc(&hdma_copy, DMA_REQ_MEM2MEM, DMA_CLASS_BULK) != RT_EOK)
+        return -RT_EBUSY;
+
+    hdma_copy.Init.Direction           = DMA_MEMORY_TO_MEMORY;
+    hdma_copy.Init.PeriphInc           = DMA_PINC_ENABLE;
+    hdma_copy.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma_copy.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    hdma_copy.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
+    hdma_copy.Init.Mode                = DMA_NORMAL;
+    HAL_DMA_Init(&hdma_copy);
+    hdma_copy.XferCpltCallback  = _dma_copy_cplt;
+    hdma_copy.XferErrorCallback = _dma_copy_error;
+
+    return 0;
+}
+INIT_DEVICE_EXPORT(dma_copy_init);
+
+/**=============================================================================
+ * @brief           提交异步拷贝，任意上下文可调用
+ *
+ * @param[in]       req 请求，完成前必须保持有效
+ *
+ * @return          RT_EOK 已提交（或已用 CPU 完成），-RT_EINVAL 参数错误
+ *
+ * @note            请求按提交顺序完成，小块拷贝只在队列为空时立即完成，否则
+ *                  排在前面的请求之后。按源、目的和长度的共同对齐选择字、
+ *                  半字或字节传输，超过 65535 项时自动分段
+ *============================================================================*/
+rt_err_t dma_copy_submit(struct dma_copy_req *req)
+{
+    rt_uint32_t align;
+    rt_base_t level;
+
+    if (req == RT_NULL || (req->len && (req->dst == RT_NULL || req->src == RT_NULL)))
+        return -RT_EINVAL;
+
+    req->next   = RT_NULL;
+    req->offset = 0;
+    req->result = -RT_EBUSY;
+
+    /* 小块拷贝配置 DMA 不划算，队列为空时直接完成，否则排队由 CPU 按序完成 */
+    if (hdma_copy.Instance == RT_NULL ||
+        (req->len < DMA_COPY_THRESHOLD && _dma_copy_cpu(req->dst, req->src, req->len)))
+    {
+        if (hdma_copy.Instance == RT_NULL)
+            memcpy(req->dst, req->src, req->len);
+        req->result = RT_EOK;
+        if (req->done)
+            req->done(req);
+        if (req->sem)
+            rt_sem_release(req->sem);
+        return RT_EOK;
+    }
+
+    align = (rt_uint32_t)(rt_ubase_t)req->dst | (rt_uint32_t)(rt_ubase_t)req->src | req->len;
+    req->width = req->len < DMA_COPY_THRESHOLD ? 0 :
+                 (align & 3) == 0 ? 4 : (align & 1) == 0 ? 2 : 1;
+
+    level = rt_hw_interrupt_disable();
+    if (dma_copy_tail)
+    {
+        dma_copy_tail->next = req;
+        dma_copy_tail = req;
+    }
+    else
+    {
+        /* 检查队列之后被中断清空，小块在这里完成 */
+        dma_copy_head = dma_copy_tail = req;
+        if (req->width == 0)
+        {
+            memcpy(req->dst, req->src, req->len);
+            _dma_copy_finish(RT_EOK);
+        }
+        else if (_dma_copy_start(req) != RT_EOK)
+            _dma_copy_finish(-RT_EIO);
+    }
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           同步拷贝，等待完成后返回
+ *
+ * @param[in]       dst 目的
+ * @param[in]       src 源
+ * @param[in]       len 字节数
+ *
+ * @return          RT_EOK 成功
+ *
+ * @note            中断中、关中断时或调度器启动前直接用 CPU 拷贝；小块在队列
+ *                  为空时直接拷贝，否则等前面的请求完成
+ *============================================================================*/
+rt_err_t dma_copy(void *dst, const void *src, rt_size_t len)
+{
+    struct dma_copy_req req;
+    struct rt_semaphore sem;
+
+    if (rt_thread_self() == RT_NULL || rt_interrupt_get_nest() != 0 || __get_PRIMASK())
+    {
+        memcpy(dst, src, len);
+        return RT_EOK;
+    }
+    if (len < DMA_COPY_THRESHOLD && _dma_copy_cpu(dst, src, len))
+        return RT_EOK;
+
+    rt_sem_init(&sem, "dmacpy", 0, RT_IPC_FLAG_FIFO);
+    memset(&req, 0, sizeof(req));
+    req.dst = dst;
+    req.src = src;
+    req.len = len;
+    req.sem = &sem;
+
+    if (dma_copy_submit(&req) == RT_EOK)
+        rt_sem_take(&sem, RT_WAITING_FOREVER);
+    else
+        req.result = -RT_EINVAL;
+    rt_sem_detach(&sem);
+
+    return req.result;
+}
@@ -0,0 +1,62 @@
+/**
+  ******************************************************************************
+  * @file			dma_copy.h
+  * @brief			dma memory copy service header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DMA_COPY_H_
+#define __DMA_COPY_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define DMA_COPY_THRESHOLD      128         /*!< 少于该字节数直接用 CPU 拷贝 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+struct dma_copy_req;
+typedef void (*dma_copy_done_t)(struct dma_copy_req *req);
+
+/**
+ * 一次拷贝请求，提交后到完成前由本模块持有，调用者不能修改或释放
+ */
+struct dma_copy_req
+{
+    void               *dst;
+    const void         *src;
+    rt_size_t           len;
+
+    dma_copy_done_t     done;               /*!< 完成回调，在中断中执行，可为空 */
+    rt_sem_t            sem;                /*!< 完成时释放，可为空 */
+    void               *user_data;
+    volatile rt_err_t   result;             /*!< 完成前为 -RT_EBUSY */
+
+    /* 内部使用 */
+    struct dma_copy_req *next;
+    rt_size_t           offset;
+    rt_uint32_t         width;              /*!< 每次传输字节数 1/2/4 */
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+int      dma_copy_init(void);
+rt_err_t dma_copy_submit(struct dma_copy_req *req);
+rt_err_t dma_copy(void *dst, const void *src, rt_size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DMA_COPY_H_ */
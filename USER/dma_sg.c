@@ -0,0 +1,353 @@
+/**
+  ******************************************************************************
+  * @file			dma_sg.c
+  * @brief			scatter-gather transmit emulated on a single dma channel
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <dma_sg.h>
+#include <dma_alloc.h>
+
+/* Private constants ---------------------------------------------------------*/
+#define DMA_SG_MAX_ITEMS    0xFFFF      /*!< CNDTR 为 16 位 */
+#define DMA_SG_WAIT_LOOPS   100000      /*!< 轮询 SPI 标志的上限，远大于最慢 PCLK/256 时的一帧 */
+
+/* Private macro -------------------------------------------------------------*/
+#define DMA_SG_FLAGS(hdma, f)   ((f) << (hdma)->ChannelIndex)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           装载下一段，跳过空片段
+ *
+ * @param[in]       sg 状态
+ *
+ * @return          RT_TRUE 已装载，RT_FALSE 没有剩余数据
+ *
+ * @note            通道此时已停止，只改写 CMAR/CNDTR 后重新使能，其余配置
+ *                  保持不变，衔接只需几条存储指令
+ *============================================================================*/
+static rt_bool_t _dma_sg_load(struct dma_sg *sg)
+{
+    DMA_Channel_TypeDef *ch = sg->hdma->Instance;
+    const struct dma_sg_iov *v;
+    rt_size_t n;
+
+    while (sg->index < sg->count)
+    {
+        v = &sg->iov[sg->index];
+        if (sg->offset < v->len)
+        {
+            n = v->len - sg->offset;
+            if (n > DMA_SG_MAX_ITEMS)
+                n = DMA_SG_MAX_ITEMS;
+
+            ch->CCR  &= ~DMA_CCR_EN;
+            ch->CMAR  = (rt_uint32_t)(rt_ubase_t)v->base + sg->offset;
+            ch->CNDTR = n;
+            ch->CCR  |= DMA_CCR_EN;
+
+            sg->offset += n;
+            sg->segments++;
+            return RT_TRUE;
+        }
+
+        sg->index++;
+        sg->offset = 0;
+    }
+
+    return RT_FALSE;
+}
+
+/**=============================================================================
+ * @brief           结束传输
+ *
+ * @param[in]       sg     状态
+ * @param[in]       result 结果
+ *
+ * @return          none
+ *============================================================================*/
+static void _dma_sg_complete(struct dma_sg *sg, rt_err_t result)
+{
+    DMA_HandleTypeDef *hdma = sg->hdma;
+    rt_err_t err;
+
+    hdma->Instance->CCR &= ~(DMA_CCR_EN | DMA_CCR_TCIE | DMA_CCR_TEIE | DMA_CCR_HTIE);
+    hdma->DmaBaseAddress->IFCR = DMA_SG_FLAGS(hdma, DMA_FLAG_GL1);
+    hdma->State = HAL_DMA_STATE_READY;
+    sg->iov = RT_NULL;
+
+    if (sg->finish)
+    {
+        err = sg->finish(sg);
+        if (result == RT_EOK)
+            result = err;
+    }
+    if (sg->done)
+        sg->done(sg, result);
+}
+
+/**=============================================================================
+ * @brief           通道中断前置处理
+ *
+ * @param[in]       arg 状态
+ *
+ * @return          RT_TRUE 已处理
+ *============================================================================*/
+static rt_bool_t _dma_sg_irq_hook(void *arg)
+{
+    return dma_sg_irq_handler((struct dma_sg *)arg);
+}
+
+/**=============================================================================
+ * @brief           开始发送一组片段到外设数据寄存器
+ *
+ * @param[in]       sg          状态，hdma 须已由 dma_alloc 分配并按存储器到
+ *                              外设、字节宽度初始化
+ * @param[in]       periph_addr 外设数据寄存器地址
+ * @param[in]       iov         片段数组
+ * @param[in]       count       片段个数
+ *
+ * @return          RT_EOK 成功，-RT_EBUSY 通道忙，-RT_EEMPTY 没有数据
+ *
+ * @note            通道中断自动先交给 dma_sg_irq_handler
+ *============================================================================*/
+rt_err_t dma_sg_start(struct dma_sg *sg, rt_uint32_t periph_addr,
+                      const struct dma_sg_iov *iov, rt_size_t count)
+{
+    DMA_HandleTypeDef *hdma;
+    rt_base_t level;
+
+    RT_ASSERT(sg != RT_NULL && sg->hdma != RT_NULL);
+    RT_ASSERT(iov != RT_NULL || count == 0);
+    hdma = sg->hdma;
+
+    level = rt_hw_interrupt_disable();
+    if (hdma->State != HAL_DMA_STATE_READY || sg->iov != RT_NULL)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_EBUSY;
+    }
+
+    sg->iov    = iov;
+    sg->count  = count;
+    sg->index  = 0;
+    sg->offset = 0;
+    dma_set_irq_hook(hdma, _dma_sg_irq_hook, sg);
+
+    hdma->State     = HAL_DMA_STATE_BUSY;
+    hdma->ErrorCode = HAL_DMA_ERROR_NONE;
+    hdma->Instance->CCR &= ~(DMA_CCR_EN | DMA_CCR_HTIE);
+    hdma->DmaBaseAddress->IFCR = DMA_SG_FLAGS(hdma, DMA_FLAG_GL1);
+    hdma->Instance->CPAR = periph_addr;
+    hdma->Instance->CCR |= DMA_CCR_TCIE | DMA_CCR_TEIE;
+
+    if (!_dma_sg_load(sg))
+    {
+        hdma->Instance->CCR &= ~(DMA_CCR_TCIE | DMA_CCR_TEIE);
+        hdma->State = HAL_DMA_STATE_READY;
+        sg->iov = RT_NULL;
+        rt_hw_interrupt_enable(level);
+        return -RT_EEMPTY;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           通道中断处理，由 dma_alloc 的中断分发在 HAL_DMA_IRQHandler
+ *                  之前调用
+ *
+ * @param[in]       sg 状态
+ *
+ * @return          RT_TRUE 已处理，RT_FALSE 通道不在分散-聚集传输中，
+ *                  交给 HAL_DMA_IRQHandler
+ *============================================================================*/
+rt_bool_t dma_sg_irq_handler(struct dma_sg *sg)
+{
+    DMA_HandleTypeDef *hdma = sg->hdma;
+    rt_uint32_t isr;
+
+    if (sg->iov == RT_NULL)
+        return RT_FALSE;
+
+    isr = hdma->DmaBaseAddress->ISR;
+
+    if (isr & DMA_SG_FLAGS(hdma, DMA_FLAG_TE1))
+    {
+        hdma->ErrorCode = HAL_DMA_ERROR_TE;
+        _dma_sg_complete(sg, -RT_EIO);
+    }
+    else if (isr & DMA_SG_FLAGS(hdma, DMA_FLAG_TC1))
+    {
+        /* 先装载下一段再做其他事，缩短片段之间的空档 */
+        hdma->DmaBaseAddress->IFCR = DMA_SG_FLAGS(hdma, DMA_FLAG_TC1 | DMA_FLAG_GL1);
+        if (!_dma_sg_load(sg))
+            _dma_sg_complete(sg, RT_EOK);
+    }
+
+    return RT_TRUE;
+}
+
+/**=============================================================================
+ * @brief           串口发送结束，恢复 HAL 状态
+ *
+ * @param[in]       sg 状态
+ *
+ * @return          RT_EOK
+ *============================================================================*/
+static rt_err_t _dma_sg_uart_finish(struct dma_sg *sg)
+{
+    UART_HandleTypeDef *huart = (UART_HandleTypeDef *)sg->owner;
+
+    CLEAR_BIT(huart->Instance->CR3, USART_CR3_DMAT);
+    huart->gState = HAL_UART_STATE_READY;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           串口分散-聚集发送，例如 帧头 + 负载 + CRC 不必先拷贝拼接
+ *
+ * @param[in]       sg    状态，sg->hdma 为空时使用 huart->hdmatx
+ * @param[in]       huart 已初始化并关联了发送 DMA 的串口
+ * @param[in]       iov   片段数组
+ * @param[in]       count 片段个数
+ *
+ * @return          RT_EOK 成功，-RT_EBUSY 串口忙
+ *
+ * @note            完成回调在最后一个字节写入 DR 时调用，此时最后一帧可能
+ *                  还在移位
+ *============================================================================*/
+rt_err_t dma_sg_uart_transmit(struct dma_sg *sg, UART_HandleTypeDef *huart,
+                              const struct dma_sg_iov *iov, rt_size_t count)
+{
+    rt_base_t level;
+    rt_err_t err;
+
+    RT_ASSERT(sg != RT_NULL && huart != RT_NULL);
+
+    if (sg->hdma == RT_NULL)
+        sg->hdma = huart->hdmatx;
+    RT_ASSERT(sg->hdma != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    if (huart->gState != HAL_UART_STATE_READY)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_EBUSY;
+    }
+    huart->gState = HAL_UART_STATE_BUSY_TX;
+    rt_hw_interrupt_enable(level);
+
+    sg->owner  = huart;
+    sg->finish = _dma_sg_uart_finish;
+
+    err = dma_sg_start(sg, (rt_uint32_t)(rt_ubase_t)&huart->Instance->DR, iov, count);
+    if (err != RT_EOK)
+    {
+        huart->gState = HAL_UART_STATE_READY;
+        return err;
+    }
+    SET_BIT(huart->Instance->CR3, USART_CR3_DMAT);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           SPI 发送结束，等待移位完成并清除只发不收产生的溢出
+ *
+ * @param[in]       sg 状态
+ *
+ * @return          RT_EOK 最后一帧已移出，-RT_ETIMEOUT 等 TXE/BSY 超时，
+ *                  此时 SPI 仍被释放，但最后一帧可能还没发完
+ *============================================================================*/
+static rt_err_t _dma_sg_spi_finish(struct dma_sg *sg)
+{
+    SPI_HandleTypeDef *hspi = (SPI_HandleTypeDef *)sg->owner;
+    rt_err_t err = RT_EOK;
+    rt_uint32_t loops;
+
+    loops = DMA_SG_WAIT_LOOPS;
+    while (!(hspi->Instance->SR & SPI_SR_TXE))
+    {
+        if (--loops == 0)
+        {
+            err = -RT_ETIMEOUT;
+            break;
+        }
+    }
+    loops = DMA_SG_WAIT_LOOPS;
+    while (err == RT_EOK && (hspi->Instance->SR & SPI_SR_BSY))
+    {
+        if (--loops == 0)
+            err = -RT_ETIMEOUT;
+    }
+
+    CLEAR_BIT(hspi->Instance->CR2, SPI_CR2_TXDMAEN);
+    __HAL_SPI_CLEAR_OVRFLAG(hspi);
+    hspi->State = HAL_SPI_STATE_READY;
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           SPI 分散-聚集发送，接收数据丢弃
+ *
+ * @param[in]       sg    状态，sg->hdma 为空时使用 hspi->hdmatx
+ * @param[in]       hspi  已初始化并关联了发送 DMA 的 SPI
+ * @param[in]       iov   片段数组
+ * @param[in]       count 片段个数
+ *
+ * @return          RT_EOK 成功，-RT_EBUSY SPI 忙
+ *
+ * @note            完成回调在最后一帧移出、BSY 清零后调用，可以直接拉高片选；
+ *                  等待超时时回调收到 -RT_ETIMEOUT
+ *============================================================================*/
+rt_err_t dma_sg_spi_transmit(struct dma_sg *sg, SPI_HandleTypeDef *hspi,
+                             const struct dma_sg_iov *iov, rt_size_t count)
+{
+    rt_base_t level;
+    rt_err_t err;
+
+    RT_ASSERT(sg != RT_NULL && hspi != RT_NULL);
+
+    if (sg->hdma == RT_NULL)
+        sg->hdma = hspi->hdmatx;
+    RT_ASSERT(sg->hdma != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    if (hspi->State != HAL_SPI_STATE_READY)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_EBUSY;
+    }
+    hspi->State = HAL_SPI_STATE_BUSY_TX;
+    rt_hw_interrupt_enable(level);
+
+    sg->owner  = hspi;
+    sg->finish = _dma_sg_spi_finish;
+
+    __HAL_SPI_ENABLE(hspi);
+    err = dma_sg_start(sg, (rt_uint32_t)(rt_ubase_t)&hspi->Instance->DR, iov, count);
+    if (err != RT_EOK)
+    {
+        hspi->State = HAL_SPI_STATE_READY;
+        return err;
+    }
+    SET_BIT(hspi->Instance->CR2, SPI_CR2_TXDMAEN);
+
+    return RT_EOK;
+}
@@ -0,0 +1,73 @@
+/**
+  ******************************************************************************
+  * @file			dma_sg.h
+  * @brief			scatter-gather dma transmit header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DMA_SG_H_
+#define __DMA_SG_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+struct dma_sg_iov
+{
+    const void *base;
+    rt_size_t   len;
+};
+
+struct dma_sg;
+typedef void (*dma_sg_done_t)(struct dma_sg *sg, rt_err_t result);
+
+/**
+ * 一个发送通道的分散-聚集状态，一次只能有一组片段在传输
+ *
+ * 片段在传输完成中断中直接改写 CMAR/CNDTR 衔接，期间调用者不能修改 iov
+ * 数组及其指向的数据
+ */
+struct dma_sg
+{
+    DMA_HandleTypeDef       *hdma;
+    dma_sg_done_t            done;          /*!< 全部发出后在中断中调用，可为空 */
+    void                    *user_data;
+
+    /* 内部使用 */
+    rt_err_t               (*finish)(struct dma_sg *sg);   /*!< 出错时覆盖 done 的 RT_EOK */
+    void                    *owner;
+    const struct dma_sg_iov *iov;
+    rt_size_t                count;
+    rt_size_t                index;
+    rt_size_t                offset;        /*!< 当前片段已装载的字节数 */
+    rt_uint32_t              segments;      /*!< 统计：装载的段数 */
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t  dma_sg_start(struct dma_sg *sg, rt_uint32_t periph_addr,
+                       const struct dma_sg_iov *iov, rt_size_t count);
+rt_bool_t dma_sg_irq_handler(struct dma_sg *sg);
+rt_err_t  dma_sg_uart_transmit(struct dma_sg *sg, UART_HandleTypeDef *huart,
+                               const struct dma_sg_iov *iov, rt_size_t count);
+rt_err_t  dma_sg_spi_transmit(struct dma_sg *sg, SPI_HandleTypeDef *hspi,
+                              const struct dma_sg_iov *iov, rt_size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DMA_SG_H_ */
@@ -0,0 +1,556 @@
+/**
+  ******************************************************************************
+  * @file			dsp.c
+  * @brief			fixed-point block filters for adc sample streams
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <dsp.h>
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#define DSP_BENCH_N         128         /*!< 基准测试每次处理的样本数 */
+
+/* Private macro -------------------------------------------------------------*/
+/* 关中断执行 call，打印每个输入样本的周期数 */
+#define DSP_BENCH(name, call)                                                   \
+    do {                                                                        \
+        rt_base_t _level = rt_hw_interrupt_disable();                           \
+        rt_uint32_t _start = DWT->CYCCNT;                                       \
+        call;                                                                   \
+        _start = DWT->CYCCNT - _start;                                          \
+        rt_hw_interrupt_enable(_level);                                         \
+        _dsp_bench_print(name, _start);                                         \
+    } while (0)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           饱和到 Q15，编译为一条 SSAT
+ *
+ * @param[in]       x 值
+ *
+ * @return          饱和后的值
+ *============================================================================*/
+rt_inline q15_t _dsp_sat_q15(rt_int32_t x)
+{
+    return (q15_t)__SSAT(x, 16);
+}
+
+/**=============================================================================
+ * @brief           64 位累加结果饱和到 Q31
+ *
+ * @param[in]       x 值
+ *
+ * @return          饱和后的值
+ *============================================================================*/
+rt_inline q31_t _dsp_sat_q31(rt_int64_t x)
+{
+    if (x > 0x7FFFFFFFLL)
+        return 0x7FFFFFFF;
+    if (x < -0x80000000LL)
+        return (q31_t)0x80000000;
+    return (q31_t)x;
+}
+
+/**=============================================================================
+ * @brief           原始 ADC 采样去掉中点偏置并转为 Q15
+ *
+ * @param[in]       in     输入，12 位无符号
+ * @param[in]       stride 相邻两个输入的间隔，单位为采样
+ * @param[out]      out    输出，连续存放
+ * @param[in]       n      样本数
+ *
+ * @return          none
+ *============================================================================*/
+void dsp_adc_to_q15(const rt_uint16_t *in, rt_size_t stride, q15_t *out, rt_size_t n)
+{
+    const rt_int32_t mid = 1 << (DSP_ADC_BITS - 1);
+
+    while (n--)
+    {
+        *out++ = (q15_t)((*in - mid) * (1 << (16 - DSP_ADC_BITS)));
+        in += stride;
+    }
+}
+
+/**=============================================================================
+ * @brief           初始化 Q15 抽取 FIR
+ *
+ * @param[in]       fir    滤波器
+ * @param[in]       coeffs 系数，taps 个，绝对值之和须小于 2
+ * @param[in]       state  状态缓冲，DSP_FIR_STATE_SIZE(taps) 个
+ * @param[in]       taps   抽头数
+ * @param[in]       decim  抽取比，1 表示不抽取
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 参数错误
+ *
+ * @note            累加器为 32 位，每个抽头一条 MLA；Q30 乘积留 1 位余量，
+ *                  系数绝对值之和小于 2 时不会溢出
+ *============================================================================*/
+rt_err_t dsp_fir_q15_init(struct dsp_fir_q15 *fir, const q15_t *coeffs, q15_t *state,
+                          rt_uint16_t taps, rt_uint16_t decim)
+{
+    RT_ASSERT(fir != RT_NULL);
+
+    if (coeffs == RT_NULL || state == RT_NULL || taps == 0 || decim == 0)
+        return -RT_EINVAL;
+
+    fir->coeffs = coeffs;
+    fir->state  = state;
+    fir->taps   = taps;
+    fir->pos    = 0;
+    fir->decim  = decim;
+    fir->phase  = 0;
+    rt_memset(state, 0, DSP_FIR_STATE_SIZE(taps) * sizeof(q15_t));
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           Q15 FIR 处理一块
+ *
+ * @param[in]       fir 滤波器
+ * @param[in]       in  输入，n 个
+ * @param[out]      out 输出，最多 n / decim + 1 个，可以与 in 相同
+ * @param[in]       n   输入样本数
+ *
+ * @return          输出样本数
+ *============================================================================*/
+rt_size_t dsp_fir_q15_process(struct dsp_fir_q15 *fir, const q15_t *in, q15_t *out, rt_size_t n)
+{
+    const rt_uint32_t taps = fir->taps;
+    rt_uint32_t pos = fir->pos, phase = fir->phase;
+    const q15_t *c, *s;
+    rt_size_t produced = 0;
+    rt_int32_t acc;
+    rt_uint32_t k;
+
+    while (n--)
+    {
+        pos = (pos ? pos : taps) - 1;
+        fir->state[pos] = fir->state[pos + taps] = *in++;
+        if (++phase < fir->decim)
+            continue;
+        phase = 0;
+
+        c   = fir->coeffs;
+        s   = fir->state + pos;
+        acc = 0;
+        for (k = taps >> 2; k; k--)
+        {
+            acc += *c++ * *s++;
+            acc += *c++ * *s++;
+            acc += *c++ * *s++;
+            acc += *c++ * *s++;
+        }
+        for (k = taps & 3; k; k--)
+            acc += *c++ * *s++;
+
+        out[produced++] = _dsp_sat_q15(acc >> 15);
+    }
+
+    fir->pos   = pos;
+    fir->phase = phase;
+
+    return produced;
+}
+
+/**=============================================================================
+ * @brief           初始化 Q31 抽取 FIR
+ *
+ * @param[in]       fir    滤波器
+ * @param[in]       coeffs 系数，taps 个，绝对值之和须小于 1
+ * @param[in]       state  状态缓冲，DSP_FIR_STATE_SIZE(taps) 个
+ * @param[in]       taps   抽头数
+ * @param[in]       decim  抽取比，1 表示不抽取
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 参数错误
+ *
+ * @note            每个抽头一条 SMLAL，64 位累加 Q62 乘积
+ *============================================================================*/
+rt_err_t dsp_fir_q31_init(struct dsp_fir_q31 *fir, const q31_t *coeffs, q31_t *state,
+                          rt_uint16_t taps, rt_uint16_t decim)
+{
+    RT_ASSERT(fir != RT_NULL);
+
+    if (coeffs == RT_NULL || state == RT_NULL || taps == 0 || decim == 0)
+        return -RT_EINVAL;
+
+    fir->coeffs = coeffs;
+    fir->state  = state;
+    fir->taps   = taps;
+    fir->pos    = 0;
+    fir->decim  = decim;
+    fir->phase  = 0;
+    rt_memset(state, 0, DSP_FIR_STATE_SIZE(taps) * sizeof(q31_t));
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           Q31 FIR 处理一块
+ *
+ * @param[in]       fir 滤波器
+ * @param[in]       in  输入，n 个
+ * @param[out]      out 输出，最多 n / decim + 1 个，可以与 in 相同
+ * @param[in]       n   输入样本数
+ *
+ * @return          输出样本数
+ *============================================================================*/
+rt_size_t dsp_fir_q31_process(struct dsp_fir_q31 *fir, const q31_t *in, q31_t *out, rt_size_t n)
+{
+    const rt_uint32_t taps = fir->taps;
+    rt_uint32_t pos = fir->pos, phase = fir->phase;
+    const q31_t *c, *s;
+    rt_size_t produced = 0;
+    rt_int64_t acc;
+    rt_uint32_t k;
+
+    while (n--)
+    {
+        pos = (pos ? pos : taps) - 1;
+        fir->state[pos] = fir->state[pos + taps] = *in++;
+        if (++phase < fir->decim)
+            continue;
+        phase = 0;
+
+        c   = fir->coeffs;
+        s   = fir->state + pos;
+        acc = 0;
+        for (k = taps >> 2; k; k--)
+        {
+            acc += (rt_int64_t)*c++ * *s++;
+            acc += (rt_int64_t)*c++ * *s++;
+            acc += (rt_int64_t)*c++ * *s++;
+            acc += (rt_int64_t)*c++ * *s++;
+        }
+        for (k = taps & 3; k; k--)
+            acc += (rt_int64_t)*c++ * *s++;
+
+        out[produced++] = _dsp_sat_q31(acc >> 31);
+    }
+
+    fir->pos   = pos;
+    fir->phase = phase;
+
+    return produced;
+}
+
+/**=============================================================================
+ * @brief           初始化 Q15 级联双二阶 IIR
+ *
+ * @param[in]       iir    滤波器
+ * @param[in]       coeffs 系数，每级 5 个 {b0, b1, b2, a1, a2}，Q14
+ * @param[in]       state  状态缓冲，DSP_BIQUAD_STATE_SIZE(stages) 个
+ * @param[in]       stages 级数
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 参数错误
+ *
+ * @note            a1、a2 按 MATLAB 的符号给出，即分母 1 + a1 z^-1 + a2 z^-2
+ *============================================================================*/
+rt_err_t dsp_biquad_q15_init(struct dsp_biquad_q15 *iir, const q15_t *coeffs, q15_t *state,
+                             rt_uint8_t stages)
+{
+    RT_ASSERT(iir != RT_NULL);
+
+    if (coeffs == RT_NULL || state == RT_NULL || stages == 0)
+        return -RT_EINVAL;
+
+    iir->coeffs = coeffs;
+    iir->state  = state;
+    iir->stages = stages;
+    rt_memset(state, 0, DSP_BIQUAD_STATE_SIZE(stages) * sizeof(q15_t));
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           Q15 双二阶 IIR 处理一块，逐级整块处理
+ *
+ * @param[in]       iir 滤波器
+ * @param[in]       in  输入，n 个
+ * @param[out]      out 输出，n 个，可以与 in 相同
+ * @param[in]       n   样本数
+ *
+ * @return          none
+ *
+ * @note            Q14 系数可到 2，五个乘积之和可能超过 32 位，所以用 64 位累加，
+ *                  每级输出饱和到 Q15
+ *============================================================================*/
+void dsp_biquad_q15_process(struct dsp_biquad_q15 *iir, const q15_t *in, q15_t *out, rt_size_t n)
+{
+    const q15_t *c = iir->coeffs;
+    q15_t *st = iir->state;
+    const q15_t *src = in;
+    rt_int32_t b0, b1, b2, a1, a2;
+    rt_int32_t x0, x1, x2, y1, y2;
+    rt_int64_t acc;
+    rt_uint32_t stage;
+    rt_size_t i;
+
+    for (stage = 0; stage < iir->stages; stage++)
+    {
+        b0 = c[0]; b1 = c[1]; b2 = c[2]; a1 = c[3]; a2 = c[4];
+        x1 = st[0]; x2 = st[1]; y1 = st[2]; y2 = st[3];
+
+        /* 第一级读 in，之后各级在 out 上原地处理 */
+        for (i = 0; i < n; i++)
+        {
+            x0  = src[i];
+            acc = (rt_int64_t)b0 * x0;
+            acc += (rt_int64_t)b1 * x1;
+            acc += (rt_int64_t)b2 * x2;
+            acc -= (rt_int64_t)a1 * y1;
+            acc -= (rt_int64_t)a2 * y2;
+
+            x2 = x1;
+            x1 = x0;
+            y2 = y1;
+            y1 = _dsp_sat_q15((rt_int32_t)(acc >> 14));
+            out[i] = (q15_t)y1;
+        }
+
+        st[0] = x1; st[1] = x2; st[2] = y1; st[3] = y2;
+        c  += 5;
+        st += 4;
+        src = out;
+    }
+}
+
+/**=============================================================================
+ * @brief           初始化 CIC 抽取器
+ *
+ * @param[in]       cic      抽取器
+ * @param[in]       order    级数 1 ~ DSP_CIC_MAX_ORDER
+ * @param[in]       rate     抽取比，不小于 2
+ * @param[in]       out_bits 输出位数，不超过 31
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 参数错误或增益超过 32 位
+ *
+ * @note            输入为 DSP_ADC_BITS 位，增益按 order * ceil(log2(rate)) 位计，
+ *                  输出右移到 out_bits 位；rate 不是 2 的幂时输出到不了满量程
+ *============================================================================*/
+rt_err_t dsp_cic_init(struct dsp_cic *cic, rt_uint8_t order, rt_uint16_t rate, rt_uint8_t out_bits)
+{
+    rt_uint32_t bits;
+
+    RT_ASSERT(cic != RT_NULL);
+
+    if (order == 0 || order > DSP_CIC_MAX_ORDER || rate < 2 || out_bits == 0 || out_bits > 31)
+        return -RT_EINVAL;
+
+    bits = DSP_ADC_BITS + order * (32 - __CLZ(rate - 1));
+    if (bits > 32)
+        return -RT_EINVAL;
+
+    rt_memset(cic, 0, sizeof(*cic));
+    cic->order = order;
+    cic->rate  = rate;
+    cic->shift = bits > out_bits ? bits - out_bits : 0;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           CIC 抽取一块
+ *
+ * @param[in]       cic    抽取器
+ * @param[in]       in     输入，原始 ADC 采样
+ * @param[in]       stride 相邻两个输入的间隔，单位为采样
+ * @param[out]      out    输出，最多 n / rate + 1 个
+ * @param[in]       n      输入样本数
+ *
+ * @return          输出样本数
+ *============================================================================*/
+rt_size_t dsp_cic_process(struct dsp_cic *cic, const rt_uint16_t *in, rt_size_t stride,
+                          rt_int32_t *out, rt_size_t n)
+{
+    const rt_uint32_t order = cic->order;
+    rt_uint32_t count = cic->count;
+    rt_size_t produced = 0;
+    rt_uint32_t v, t, k;
+
+    while (n--)
+    {
+        v = *in;
+        in += stride;
+        for (k = 0; k < order; k++)
+            v = cic->integ[k] += v;
+
+        if (++count < cic->rate)
+            continue;
+        count = 0;
+
+        for (k = 0; k < order; k++)
+        {
+            t = v;
+            v -= cic->comb[k];
+            cic->comb[k] = t;
+        }
+        out[produced++] = (rt_int32_t)(v >> cic->shift);
+    }
+    cic->count = count;
+
+    return produced;
+}
+
+/**=============================================================================
+ * @brief           初始化滑动平均
+ *
+ * @param[in]       avg  滤波器
+ * @param[in]       hist 历史缓冲，len 个
+ * @param[in]       len  窗口长度
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 参数错误
+ *
+ * @note            历史清零，前 len 个输出从 0 爬升
+ *============================================================================*/
+rt_err_t dsp_mavg_init(struct dsp_mavg *avg, rt_uint16_t *hist, rt_uint16_t len)
+{
+    RT_ASSERT(avg != RT_NULL);
+
+    if (hist == RT_NULL || len == 0)
+        return -RT_EINVAL;
+
+    avg->hist  = hist;
+    avg->sum   = 0;
+    avg->len   = len;
+    avg->pos   = 0;
+    avg->shift = (len & (len - 1)) ? -1 : 31 - __CLZ(len);
+    rt_memset(hist, 0, len * sizeof(rt_uint16_t));
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           滑动平均处理一块，每个输入一个输出
+ *
+ * @param[in]       avg    滤波器
+ * @param[in]       in     输入，原始 ADC 采样
+ * @param[in]       stride 相邻两个输入的间隔，单位为采样
+ * @param[out]      out    输出，n 个
+ * @param[in]       n      样本数
+ *
+ * @return          none
+ *============================================================================*/
+void dsp_mavg_process(struct dsp_mavg *avg, const rt_uint16_t *in, rt_size_t stride,
+                      rt_uint16_t *out, rt_size_t n)
+{
+    rt_uint32_t sum = avg->sum, pos = avg->pos;
+    rt_uint16_t x;
+
+    while (n--)
+    {
+        x = *in;
+        in += stride;
+        sum += x - avg->hist[pos];
+        avg->hist[pos] = x;
+        if (++pos == avg->len)
+            pos = 0;
+
+        *out++ = (rt_uint16_t)(avg->shift >= 0 ? sum >> avg->shift : sum / avg->len);
+    }
+
+    avg->sum = sum;
+    avg->pos = pos;
+}
+
+#ifdef RT_USING_FINSH
+static q15_t       dsp_bench_q15[DSP_BENCH_N];
+static q31_t       dsp_bench_q31[DSP_BENCH_N];
+static rt_uint16_t dsp_bench_adc[DSP_BENCH_N];
+static rt_int32_t  dsp_bench_out[DSP_BENCH_N];
+static rt_uint16_t dsp_bench_mavg[DSP_BENCH_N];
+
+/**=============================================================================
+ * @brief           打印一项基准结果
+ *
+ * @param[in]       name   名称
+ * @param[in]       cycles 处理 DSP_BENCH_N 个样本的周期数
+ *
+ * @return          none
+ *============================================================================*/
+static void _dsp_bench_print(const char *name, rt_uint32_t cycles)
+{
+    rt_kprintf("%-20s %5u.%02u\n", name, cycles / DSP_BENCH_N,
+               (cycles % DSP_BENCH_N) * 100 / DSP_BENCH_N);
+}
+
+/**=============================================================================
+ * @brief           用 DWT 周期计数测各滤波器每个输入样本的周期数，关中断测量
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int dsp(void)
+{
+    static const q15_t biquad[10] =
+    {
+        /* 二阶巴特沃斯低通，截止 0.1fs，两级 */
+        DSP_Q14(0.0675), DSP_Q14(0.1349), DSP_Q14(0.0675), DSP_Q14(-1.1430), DSP_Q14(0.4128),
+        DSP_Q14(0.0675), DSP_Q14(0.1349), DSP_Q14(0.0675), DSP_Q14(-1.1430), DSP_Q14(0.4128),
+    };
+    static q15_t  fir15_coeffs[32], fir15_state[DSP_FIR_STATE_SIZE(32)];
+    static q31_t  fir31_coeffs[32], fir31_state[DSP_FIR_STATE_SIZE(32)];
+    static q15_t  biquad_state[DSP_BIQUAD_STATE_SIZE(2)];
+    static rt_uint16_t mavg_hist[16];
+    struct dsp_fir_q15 fir15;
+    struct dsp_fir_q31 fir31;
+    struct dsp_biquad_q15 iir;
+    struct dsp_cic cic;
+    struct dsp_mavg avg;
+    rt_uint32_t i;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    for (i = 0; i < 32; i++)
+    {
+        fir15_coeffs[i] = DSP_Q15(1.0 / 32);
+        fir31_coeffs[i] = DSP_Q31(1.0 / 32);
+    }
+    for (i = 0; i < DSP_BENCH_N; i++)
+    {
+        dsp_bench_adc[i] = (i * 97) & 0xFFF;
+        dsp_bench_q31[i] = (q31_t)(i * 0x01234567);
+    }
+
+    rt_kprintf("kernel               cycles/sample\n");
+    DSP_BENCH("adc_to_q15", dsp_adc_to_q15(dsp_bench_adc, 1, dsp_bench_q15, DSP_BENCH_N));
+
+    dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, 32, 1);
+    DSP_BENCH("fir_q15 32 taps", dsp_fir_q15_process(&fir15, dsp_bench_q15, dsp_bench_q15, DSP_BENCH_N));
+    dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, 32, 4);
+    DSP_BENCH("fir_q15 32 taps /4", dsp_fir_q15_process(&fir15, dsp_bench_q15, dsp_bench_q15, DSP_BENCH_N));
+
+    dsp_fir_q31_init(&fir31, fir31_coeffs, fir31_state, 32, 1);
+    DSP_BENCH("fir_q31 32 taps", dsp_fir_q31_process(&fir31, dsp_bench_q31, dsp_bench_q31, DSP_BENCH_N));
+
+    dsp_biquad_q15_init(&iir, biquad, biquad_state, 2);
+    DSP_BENCH("biquad_q15 2 stages", dsp_biquad_q15_process(&iir, dsp_bench_q15, dsp_bench_q15, DSP_BENCH_N));
+
+    dsp_cic_init(&cic, 3, 16, 16);
+    DSP_BENCH("cic 3rd order /16", dsp_cic_process(&cic, dsp_bench_adc, 1, dsp_bench_out, DSP_BENCH_N));
+
+    dsp_mavg_init(&avg, mavg_hist, 16);
+    DSP_BENCH("mavg 16", dsp_mavg_process(&avg, dsp_bench_adc, 1, dsp_bench_mavg, DSP_BENCH_N));
+
+    return 0;
+}
+MSH_CMD_EXPORT(dsp, benchmark fixed-point filter kernels);
+#endif
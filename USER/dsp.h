@@ -0,0 +1,142 @@
+/**
+  ******************************************************************************
+  * @file			dsp.h
+  * @brief			fixed-point block filters for adc sample streams header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __DSP_H_
+#define __DSP_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define DSP_CIC_MAX_ORDER       4
+#define DSP_ADC_BITS            12          /*!< 原始 ADC 采样的位数 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* 编译期把 [-1, 1) 的小数转成定点，用于系数表 */
+#define DSP_Q15(x)              ((q15_t)((x) * 32768.0 + ((x) >= 0 ? 0.5 : -0.5)))
+#define DSP_Q31(x)              ((q31_t)((x) * 2147483648.0 + ((x) >= 0 ? 0.5 : -0.5)))
+/* 双二阶系数范围 [-2, 2) */
+#define DSP_Q14(x)              ((q15_t)((x) * 16384.0 + ((x) >= 0 ? 0.5 : -0.5)))
+
+/* 各滤波器状态缓冲需要的元素个数 */
+#define DSP_FIR_STATE_SIZE(taps)        (2 * (taps))
+#define DSP_BIQUAD_STATE_SIZE(stages)   (4 * (stages))
+
+/* Exported typedef ----------------------------------------------------------*/
+typedef rt_int16_t q15_t;
+typedef rt_int32_t q31_t;
+
+/**
+ * 抽取 FIR：每输入 decim 个样本输出一个，只计算需要输出的点
+ *
+ * 延迟线长度为两倍抽头，新样本同时写两处，卷积窗口始终连续，
+ * 内循环不需要取模
+ */
+struct dsp_fir_q15
+{
+    const q15_t            *coeffs;         /*!< taps 个，coeffs[0] 乘最新样本 */
+    q15_t                  *state;          /*!< DSP_FIR_STATE_SIZE(taps) 个 */
+    rt_uint16_t             taps;
+    rt_uint16_t             pos;
+    rt_uint16_t             decim;
+    rt_uint16_t             phase;
+};
+
+struct dsp_fir_q31
+{
+    const q31_t            *coeffs;         /*!< 系数绝对值之和须小于 1，否则输出饱和 */
+    q31_t                  *state;
+    rt_uint16_t             taps;
+    rt_uint16_t             pos;
+    rt_uint16_t             decim;
+    rt_uint16_t             phase;
+};
+
+/**
+ * 级联双二阶 IIR，直接 I 型：
+ * y = b0*x + b1*x1 + b2*x2 - a1*y1 - a2*y2，系数为 Q14，64 位累加
+ */
+struct dsp_biquad_q15
+{
+    const q15_t            *coeffs;         /*!< 每级 {b0, b1, b2, a1, a2} */
+    q15_t                  *state;          /*!< 每级 {x1, x2, y1, y2} */
+    rt_uint8_t              stages;
+};
+
+/**
+ * CIC 抽取器，差分延迟为 1，增益 rate^order
+ *
+ * 积分器按 32 位取模运算，只要最终结果在 32 位内，中间溢出不影响输出
+ */
+struct dsp_cic
+{
+    rt_uint32_t             integ[DSP_CIC_MAX_ORDER];
+    rt_uint32_t             comb[DSP_CIC_MAX_ORDER];    /*!< 梳状级上一次的输入 */
+    rt_uint16_t             rate;
+    rt_uint16_t             count;
+    rt_uint8_t              order;
+    rt_uint8_t              shift;          /*!< 输出右移位数 */
+};
+
+/**
+ * 滑动平均，长度为 2 的幂时用移位代替除法
+ */
+struct dsp_mavg
+{
+    rt_uint16_t            *hist;           /*!< len 个 */
+    rt_uint32_t             sum;
+    rt_uint16_t             len;
+    rt_uint16_t             pos;
+    rt_int8_t               shift;          /*!< -1 表示长度不是 2 的幂 */
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+/*
+ * 输入为原始 ADC 采样的函数都带 stride，可以直接读 adc_scan 交出的块，
+ * 例如第 ch 个通道：
+ *
+ *   dsp_cic_process(&cic, &ADC_SCAN_SAMPLE(&blk, ch, 0), blk.count,
+ *                   out, blk.samples);
+ */
+void      dsp_adc_to_q15(const rt_uint16_t *in, rt_size_t stride, q15_t *out, rt_size_t n);
+
+rt_err_t  dsp_fir_q15_init(struct dsp_fir_q15 *fir, const q15_t *coeffs, q15_t *state,
+                           rt_uint16_t taps, rt_uint16_t decim);
+rt_size_t dsp_fir_q15_process(struct dsp_fir_q15 *fir, const q15_t *in, q15_t *out, rt_size_t n);
+rt_err_t  dsp_fir_q31_init(struct dsp_fir_q31 *fir, const q31_t *coeffs, q31_t *state,
+                           rt_uint16_t taps, rt_uint16_t decim);
+rt_size_t dsp_fir_q31_process(struct dsp_fir_q31 *fir, const q31_t *in, q31_t *out, rt_size_t n);
+
+rt_err_t  dsp_biquad_q15_init(struct dsp_biquad_q15 *iir, const q15_t *coeffs, q15_t *state,
+                              rt_uint8_t stages);
+void      dsp_biquad_q15_process(struct dsp_biquad_q15 *iir, const q15_t *in, q15_t *out, rt_size_t n);
+
+rt_err_t  dsp_cic_init(struct dsp_cic *cic, rt_uint8_t order, rt_uint16_t rate, rt_uint8_t out_bits);
+rt_size_t dsp_cic_process(struct dsp_cic *cic, const rt_uint16_t *in, rt_size_t stride,
+                          rt_int32_t *out, rt_size_t n);
+
+rt_err_t  dsp_mavg_init(struct dsp_mavg *avg, rt_uint16_t *hist, rt_uint16_t len);
+void      dsp_mavg_process(struct dsp_mavg *avg, const rt_uint16_t *in, rt_size_t stride,
+                           rt_uint16_t *out, rt_size_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __DSP_H_ */
@@ -0,0 +1,292 @@
+/**
+  ******************************************************************************
+  * @file			flash_writer.c
+  * @brief			buffered, page aware internal flash writer
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <string.h>
+#include <flash_writer.h>
+
+/* Private constants ---------------------------------------------------------*/
+#define FW_BUSY_LOOPS       0x20000     /*!< 半字编程约 60us，按 72MHz 留足余量 */
+
+/* Private macro -------------------------------------------------------------*/
+#define FW_PAGE_OF(addr)    ((addr) & ~(FLASH_PAGE_SIZE - 1))
+#define FW_FLASH_HW(addr)   ((volatile rt_uint16_t *)(rt_ubase_t)(addr))
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           等待上一次编程结束，不依赖 HAL_GetTick
+ *
+ * @param[in]       none
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _fw_wait_busy(void)
+{
+    rt_uint32_t loops = FW_BUSY_LOOPS;
+
+    while (FLASH->SR & FLASH_SR_BSY)
+    {
+        if (--loops == 0)
+            return -RT_ETIMEOUT;
+    }
+
+    if (FLASH->SR & (FLASH_SR_PGERR | FLASH_SR_WRPRTERR))
+    {
+        FLASH->SR = FLASH_SR_PGERR | FLASH_SR_WRPRTERR;
+        return -RT_EIO;
+    }
+    FLASH->SR = FLASH_SR_EOP;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           把缓存页写入 flash
+ *
+ * @param[in]       fw writer
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _fw_commit(struct flash_writer *fw)
+{
+    volatile rt_uint16_t *flash = FW_FLASH_HW(fw->page_addr);
+    const rt_uint16_t *buf = fw->page.h;
+    FLASH_EraseInitTypeDef erase;
+    rt_uint32_t i, page_error;
+    rt_bool_t need_erase = RT_FALSE;
+    rt_err_t err = RT_EOK;
+
+    /* 只能把 1 写成 0，已编程的半字要改成别的值才需要擦除 */
+    for (i = 0; i < FLASH_PAGE_SIZE / 2; i++)
+    {
+        if (flash[i] != buf[i] && flash[i] != 0xFFFF)
+        {
+            need_erase = RT_TRUE;
+            break;
+        }
+    }
+
+    HAL_FLASH_Unlock();
+
+    if (need_erase)
+    {
+        erase.TypeErase   = FLASH_TYPEERASE_PAGES;
+        erase.Banks       = FLASH_BANK_1;
+        erase.PageAddress = fw->page_addr;
+        erase.NbPages     = 1;
+        if (HAL_FLASHEx_Erase(&erase, &page_error) != HAL_OK)
+        {
+            HAL_FLASH_Lock();
+            return -RT_EIO;
+        }
+        fw->erase_count++;
+    }
+    else
+    {
+        fw->erase_skipped++;
+    }
+
+    /* PG 只置一次，逐个编程有变化的半字 */
+    SET_BIT(FLASH->CR, FLASH_CR_PG);
+    for (i = 0; i < FLASH_PAGE_SIZE / 2; i++)
+    {
+        if (buf[i] == 0xFFFF || flash[i] == buf[i])
+            continue;
+
+        flash[i] = buf[i];
+        err = _fw_wait_busy();
+        if (err != RT_EOK)
+            break;
+        fw->program_count++;
+    }
+    CLEAR_BIT(FLASH->CR, FLASH_CR_PG);
+
+    HAL_FLASH_Lock();
+
+    if (err == RT_EOK && memcmp((const void *)(rt_ubase_t)fw->page_addr, buf, FLASH_PAGE_SIZE) != 0)
+        err = -RT_EIO;
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           片上 flash 的结束地址（不含）
+ *
+ * @param[in]       none
+ *
+ * @return          地址
+ *
+ * @note            按 FLASHSIZE_BASE 中的容量（KB）计算，同一份代码可用于
+ *                  RC/RE 等不同容量的芯片；读出值不合理时按头文件的最大容量
+ *============================================================================*/
+rt_uint32_t flash_writer_flash_end(void)
+{
+    rt_uint32_t size = (rt_uint32_t)(*(volatile rt_uint16_t *)FLASHSIZE_BASE) * 1024u;
+
+    if (size == 0 || size > FLASH_BANK1_END + 1 - FLASH_BASE)
+        size = FLASH_BANK1_END + 1 - FLASH_BASE;
+
+    return FLASH_BASE + size;
+}
+
+/**=============================================================================
+ * @brief           打开一段 flash 区域，写位置置于区域起点
+ *
+ * @param[in]       fw   writer
+ * @param[in]       addr 起始地址
+ * @param[in]       size 区域大小
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t flash_writer_open(struct flash_writer *fw, rt_uint32_t addr, rt_uint32_t size)
+{
+    rt_uint32_t end = flash_writer_flash_end();
+
+    RT_ASSERT(fw != RT_NULL);
+
+    if (addr < FLASH_BASE || addr >= end || size == 0 || size > end - addr)
+        return -RT_EINVAL;
+
+    fw->region_start  = addr;
+    fw->region_end    = addr + size;
+    fw->pos           = addr;
+    fw->page_addr     = 0;
+    fw->dirty         = 0;
+    fw->erase_count   = 0;
+    fw->erase_skipped = 0;
+    fw->program_count = 0;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           移动写位置
+ *
+ * @param[in]       fw   writer
+ * @param[in]       addr 新的写入地址
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t flash_writer_seek(struct flash_writer *fw, rt_uint32_t addr)
+{
+    RT_ASSERT(fw != RT_NULL);
+
+    if (addr < fw->region_start || addr > fw->region_end)
+        return -RT_EINVAL;
+
+    fw->pos = addr;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           写入数据，数据先进入页缓存
+ *
+ * @param[in]       fw   writer
+ * @param[in]       data 数据
+ * @param[in]       len  长度
+ *
+ * @return          RT_EOK 成功，-RT_EFULL 超出区域（区域内部分已写入）
+ *============================================================================*/
+rt_err_t flash_writer_write(struct flash_writer *fw, const void *data, rt_size_t len)
+{
+    const rt_uint8_t *p = (const rt_uint8_t *)data;
+    rt_uint32_t page, off, n;
+    rt_err_t err;
+
+    RT_ASSERT(fw != RT_NULL);
+
+    while (len)
+    {
+        if (fw->pos >= fw->region_end)
+            return -RT_EFULL;
+
+        page = FW_PAGE_OF(fw->pos);
+        if (page != fw->page_addr)
+        {
+            err = flash_writer_flush(fw);
+            if (err != RT_EOK)
+                return err;
+
+            /* 页内区域外的数据原样保留 */
+            memcpy(fw->page.b, (const void *)(rt_ubase_t)page, FLASH_PAGE_SIZE);
+            fw->page_addr = page;
+        }
+
+        off = fw->pos - page;
+        n = FLASH_PAGE_SIZE - off;
+        if (n > fw->region_end - fw->pos)
+            n = fw->region_end - fw->pos;
+        if (n > len)
+            n = len;
+
+        if (memcmp(&fw->page.b[off], p, n) != 0)
+        {
+            memcpy(&fw->page.b[off], p, n);
+            fw->dirty = 1;
+        }
+
+        fw->pos += n;
+        p += n;
+        len -= n;
+    }
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           把缓存页写入 flash
+ *
+ * @param[in]       fw   writer
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t flash_writer_flush(struct flash_writer *fw)
+{
+    rt_err_t err;
+
+    RT_ASSERT(fw != RT_NULL);
+
+    if (!fw->dirty)
+        return RT_EOK;
+
+    err = _fw_commit(fw);
+    if (err == RT_EOK)
+        fw->dirty = 0;
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           写入剩余数据并关闭
+ *
+ * @param[in]       fw   writer
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t flash_writer_close(struct flash_writer *fw)
+{
+    rt_err_t err;
+
+    RT_ASSERT(fw != RT_NULL);
+
+    err = flash_writer_flush(fw);
+    fw->page_addr = 0;
+    fw->dirty = 0;
+
+    return err;
+}
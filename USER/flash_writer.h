@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file			flash_writer.h
+  * @brief			flash writer header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FLASH_WRITER_H_
+#define __FLASH_WRITER_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 顺序写入内部 flash 的一段区域
+ *
+ * 写入先缓存在一页大小的 RAM 中，换页或 flush 时才落到 flash：只有出现
+ * 0->1 的位时才擦除该页，已经等于目标值或目标为 0xFFFF 的半字不再编程。
+ */
+struct flash_writer
+{
+    rt_uint32_t region_start;
+    rt_uint32_t region_end;         /*!< 不含 */
+    rt_uint32_t pos;                /*!< 下一个写入地址 */
+    rt_uint32_t page_addr;          /*!< 缓存中的页，0 表示没有 */
+    rt_uint8_t  dirty;
+
+    /* 统计 */
+    rt_uint32_t erase_count;
+    rt_uint32_t erase_skipped;
+    rt_uint32_t program_count;      /*!< 实际编程的半字数 */
+
+    union
+    {
+        rt_uint8_t  b[FLASH_PAGE_SIZE];
+        rt_uint16_t h[FLASH_PAGE_SIZE / 2];
+    } page;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_uint32_t flash_writer_flash_end(void);
+rt_err_t flash_writer_open(struct flash_writer *fw, rt_uint32_t addr, rt_uint32_t size);
+rt_err_t flash_writer_seek(struct flash_writer *fw, rt_uint32_t addr);
+rt_err_t flash_writer_write(struct flash_writer *fw, const void *data, rt_size_t len);
+rt_err_t flash_writer_flush(struct flash_writer *fw);
+rt_err_t flash_writer_close(struct flash_writer *fw);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __FLASH_WRITER_H_ */
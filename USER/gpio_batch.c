@@ -0,0 +1,205 @@
+/**
+  ******************************************************************************
+  * @file			gpio_batch.c
+  * @brief			batched gpio configuration, one write per register
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <string.h>
+#include <gpio_batch.h>
+
+/* Private constants ---------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           把引脚描述表合并成每个端口的寄存器镜像
+ *
+ * @param[in]       pins      引脚描述表，可跨端口，同一引脚后出现的覆盖先出现的
+ * @param[in]       count     描述个数
+ * @param[out]      ports     端口镜像
+ * @param[in]       max_ports ports 容量
+ *
+ * @return          用到的端口数，ports 容量不足时返回 -RT_EFULL
+ *============================================================================*/
+int gpio_batch_compile(const gpio_batch_pin_t *pins, rt_size_t count,
+                       struct gpio_batch_port *ports, rt_size_t max_ports)
+{
+    struct gpio_batch_port *p;
+    rt_uint32_t n, bit, cnf;
+    rt_size_t i, j, k, used = 0;
+
+    RT_ASSERT(pins != RT_NULL || count == 0);
+    RT_ASSERT(ports != RT_NULL || max_ports == 0);
+
+    for (i = 0; i < count; i++)
+    {
+        RT_ASSERT(IS_GPIO_ALL_INSTANCE(pins[i].Port));
+        RT_ASSERT(IS_GPIO_PIN(pins[i].Pin));
+        RT_ASSERT(IS_GPIO_MODE(pins[i].Mode));
+
+        for (j = 0; j < used; j++)
+        {
+            if (ports[j].port == pins[i].Port)
+                break;
+        }
+        if (j == used)
+        {
+            if (used == max_ports)
+                return -RT_EFULL;
+            memset(&ports[used], 0, sizeof(ports[used]));
+            ports[used].port = pins[i].Port;
+            used++;
+        }
+        p = &ports[j];
+
+        cnf = GPIO_BATCH_CNF(pins[i].Mode, pins[i].Pull, pins[i].Speed);
+        for (n = 0; n < 16; n++)
+        {
+            bit = 1u << n;
+            if ((pins[i].Pin & bit) == 0)
+                continue;
+
+            if (n < 8)
+            {
+                p->crl_mask |= 0xFu << (n * 4);
+                p->crl = (p->crl & ~(0xFu << (n * 4))) | (cnf << (n * 4));
+            }
+            else
+            {
+                p->crh_mask |= 0xFu << ((n - 8) * 4);
+                p->crh = (p->crh & ~(0xFu << ((n - 8) * 4))) | (cnf << ((n - 8) * 4));
+            }
+
+            /* 与 HAL_GPIO_Init 一样，只有上拉/下拉输入写 ODR，其他模式保留
+               前面的描述留下的值 */
+            if (GPIO_BATCH_SET(n, pins[i].Mode, pins[i].Pull) | GPIO_BATCH_RESET(n, pins[i].Mode, pins[i].Pull))
+            {
+                p->odr_set   = (p->odr_set & ~bit) | GPIO_BATCH_SET(n, pins[i].Mode, pins[i].Pull);
+                p->odr_reset = (p->odr_reset & ~bit) | GPIO_BATCH_RESET(n, pins[i].Mode, pins[i].Pull);
+            }
+
+            /* 非 EXTI 模式不改动该线的 EXTI 配置；一条线只能属于一个端口，
+               以最后配置它的描述为准 */
+            if (GPIO_BATCH_EXTI(n, pins[i].Mode) == 0)
+                continue;
+            for (k = 0; k < used; k++)
+            {
+                ports[k].exti &= ~bit;
+                ports[k].imr  &= ~bit;
+                ports[k].emr  &= ~bit;
+                ports[k].rtsr &= ~bit;
+                ports[k].ftsr &= ~bit;
+            }
+            p->exti |= bit;
+            p->imr  |= GPIO_BATCH_EXTI_BIT(n, pins[i].Mode, GPIO_BATCH_MODE_IT);
+            p->emr  |= GPIO_BATCH_EXTI_BIT(n, pins[i].Mode, GPIO_BATCH_MODE_EVT);
+            p->rtsr |= GPIO_BATCH_EXTI_BIT(n, pins[i].Mode, GPIO_BATCH_RISING);
+            p->ftsr |= GPIO_BATCH_EXTI_BIT(n, pins[i].Mode, GPIO_BATCH_FALLING);
+        }
+    }
+
+    return (int)used;
+}
+
+/**=============================================================================
+ * @brief           提交端口镜像，每个寄存器只读写一次
+ *
+ * @param[in]       ports 端口镜像
+ * @param[in]       count 端口个数
+ *
+ * @return          none
+ *
+ * @note            寄存器最终值与对相同引脚逐个调用 HAL_GPIO_Init 一致，端口
+ *                  时钟需要调用者先打开
+ *============================================================================*/
+void gpio_batch_apply(const struct gpio_batch_port *ports, rt_size_t count)
+{
+    rt_uint32_t exticr_mask[4] = {0}, exticr[4] = {0};
+    rt_uint32_t exti = 0, imr = 0, emr = 0, rtsr = 0, ftsr = 0;
+    rt_uint32_t n, idx, shift;
+    const struct gpio_batch_port *p;
+    rt_size_t i;
+
+    RT_ASSERT(ports != RT_NULL || count == 0);
+
+    for (i = 0; i < count; i++)
+    {
+        p = &ports[i];
+
+        /* 先定上下拉方向再切换模式，与 HAL_GPIO_Init 的顺序相同 */
+        if (p->odr_set | p->odr_reset)
+            p->port->BSRR = (rt_uint32_t)p->odr_set | ((rt_uint32_t)p->odr_reset << 16);
+        if (p->crl_mask)
+            p->port->CRL = (p->port->CRL & ~p->crl_mask) | p->crl;
+        if (p->crh_mask)
+            p->port->CRH = (p->port->CRH & ~p->crh_mask) | p->crh;
+
+        if (p->exti == 0)
+            continue;
+
+        idx = GPIO_GET_INDEX(p->port);
+        for (n = 0; n < 16; n++)
+        {
+            if ((p->exti & (1u << n)) == 0)
+                continue;
+            shift = 4u * (n & 0x03u);
+            exticr_mask[n >> 2] |= 0x0Fu << shift;
+            exticr[n >> 2] = (exticr[n >> 2] & ~(0x0Fu << shift)) | (idx << shift);
+        }
+
+        /* 同一条 EXTI 线以后出现的端口为准 */
+        imr  = (imr  & ~p->exti) | p->imr;
+        emr  = (emr  & ~p->exti) | p->emr;
+        rtsr = (rtsr & ~p->exti) | p->rtsr;
+        ftsr = (ftsr & ~p->exti) | p->ftsr;
+        exti |= p->exti;
+    }
+
+    if (exti == 0)
+        return;
+
+    __HAL_RCC_AFIO_CLK_ENABLE();
+    for (n = 0; n < 4; n++)
+    {
+        if (exticr_mask[n])
+            AFIO->EXTICR[n] = (AFIO->EXTICR[n] & ~exticr_mask[n]) | exticr[n];
+    }
+
+    EXTI->IMR  = (EXTI->IMR  & ~exti) | imr;
+    EXTI->EMR  = (EXTI->EMR  & ~exti) | emr;
+    EXTI->RTSR = (EXTI->RTSR & ~exti) | rtsr;
+    EXTI->FTSR = (EXTI->FTSR & ~exti) | ftsr;
+}
+
+/**=============================================================================
+ * @brief           按引脚描述表配置 GPIO
+ *
+ * @param[in]       pins  引脚描述表
+ * @param[in]       count 描述个数
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t gpio_batch_init(const gpio_batch_pin_t *pins, rt_size_t count)
+{
+    struct gpio_batch_port ports[GPIO_BATCH_MAX_PORTS];
+    int used;
+
+    used = gpio_batch_compile(pins, count, ports, GPIO_BATCH_MAX_PORTS);
+    if (used < 0)
+        return used;
+
+    gpio_batch_apply(ports, (rt_size_t)used);
+
+    return RT_EOK;
+}
@@ -0,0 +1,140 @@
+/**
+  ******************************************************************************
+  * @file			gpio_batch.h
+  * @brief			batched gpio configuration header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __GPIO_BATCH_H_
+#define __GPIO_BATCH_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define GPIO_BATCH_MAX_PORTS    7           /*!< GPIOA ~ GPIOG */
+
+/* 与 stm32f1xx_hal_gpio.c 中的私有定义一致 */
+#define GPIO_BATCH_EXTI_MODE    0x10000000u
+#define GPIO_BATCH_MODE_IT      0x00010000u
+#define GPIO_BATCH_MODE_EVT     0x00020000u
+#define GPIO_BATCH_RISING       0x00100000u
+#define GPIO_BATCH_FALLING      0x00200000u
+
+/* Exported macros -----------------------------------------------------------*/
+/* 单个引脚的 MODE/CNF 四位，与 HAL_GPIO_Init 的计算相同，可用于常量表达式 */
+#define GPIO_BATCH_CNF(mode, pull, speed)                                       \
+    ((mode) == GPIO_MODE_OUTPUT_PP ? (speed) + 0x0u :                          \
+     (mode) == GPIO_MODE_OUTPUT_OD ? (speed) + 0x4u :                          \
+     (mode) == GPIO_MODE_AF_PP     ? (speed) + 0x8u :                          \
+     (mode) == GPIO_MODE_AF_OD     ? (speed) + 0xCu :                          \
+     (mode) == GPIO_MODE_ANALOG    ? 0x0u :                                    \
+     (pull) == GPIO_NOPULL         ? 0x4u : 0x8u)
+
+#define GPIO_BATCH_IS_INPUT(mode)                                               \
+    ((mode) == GPIO_MODE_INPUT || ((mode) & GPIO_BATCH_EXTI_MODE) != 0u)
+
+#define GPIO_BATCH_CRL_MASK(n)  ((n) < 8u ? 0xFu << ((n) * 4u) : 0u)
+#define GPIO_BATCH_CRH_MASK(n)  ((n) < 8u ? 0u : 0xFu << (((n) - 8u) * 4u))
+#define GPIO_BATCH_CRL(n, mode, pull, speed)                                    \
+    ((n) < 8u ? GPIO_BATCH_CNF(mode, pull, speed) << ((n) * 4u) : 0u)
+#define GPIO_BATCH_CRH(n, mode, pull, speed)                                    \
+    ((n) < 8u ? 0u : GPIO_BATCH_CNF(mode, pull, speed) << (((n) - 8u) * 4u))
+
+/* 上拉/下拉输入通过 ODR 选择方向 */
+#define GPIO_BATCH_SET(n, mode, pull)                                           \
+    (GPIO_BATCH_IS_INPUT(mode) && (pull) == GPIO_PULLUP   ? 1u << (n) : 0u)
+#define GPIO_BATCH_RESET(n, mode, pull)                                         \
+    (GPIO_BATCH_IS_INPUT(mode) && (pull) == GPIO_PULLDOWN ? 1u << (n) : 0u)
+
+#define GPIO_BATCH_EXTI(n, mode)                                                \
+    (((mode) & GPIO_BATCH_EXTI_MODE) ? 1u << (n) : 0u)
+#define GPIO_BATCH_EXTI_BIT(n, mode, bit)                                       \
+    (((mode) & GPIO_BATCH_EXTI_MODE) && ((mode) & (bit)) ? 1u << (n) : 0u)
+
+/* 引脚列表展开用，每项为 PIN(n, mode, pull, speed) */
+#define _GPIO_BATCH_X_CRL_MASK(n, m, p, s)  GPIO_BATCH_CRL_MASK(n) |
+#define _GPIO_BATCH_X_CRL(n, m, p, s)       GPIO_BATCH_CRL(n, m, p, s) |
+#define _GPIO_BATCH_X_CRH_MASK(n, m, p, s)  GPIO_BATCH_CRH_MASK(n) |
+#define _GPIO_BATCH_X_CRH(n, m, p, s)       GPIO_BATCH_CRH(n, m, p, s) |
+#define _GPIO_BATCH_X_SET(n, m, p, s)       GPIO_BATCH_SET(n, m, p) |
+#define _GPIO_BATCH_X_RESET(n, m, p, s)     GPIO_BATCH_RESET(n, m, p) |
+#define _GPIO_BATCH_X_EXTI(n, m, p, s)      GPIO_BATCH_EXTI(n, m) |
+#define _GPIO_BATCH_X_IMR(n, m, p, s)       GPIO_BATCH_EXTI_BIT(n, m, GPIO_BATCH_MODE_IT) |
+#define _GPIO_BATCH_X_EMR(n, m, p, s)       GPIO_BATCH_EXTI_BIT(n, m, GPIO_BATCH_MODE_EVT) |
+#define _GPIO_BATCH_X_RTSR(n, m, p, s)      GPIO_BATCH_EXTI_BIT(n, m, GPIO_BATCH_RISING) |
+#define _GPIO_BATCH_X_FTSR(n, m, p, s)      GPIO_BATCH_EXTI_BIT(n, m, GPIO_BATCH_FALLING) |
+
+/**
+ * 编译期生成一个端口的寄存器镜像，用法：
+ *
+ *   #define KEY_PINS(PIN)  PIN(0, GPIO_MODE_INPUT, GPIO_PULLUP, 0) \
+ *                          PIN(1, GPIO_MODE_IT_FALLING, GPIO_PULLUP, 0)
+ *   static const struct gpio_batch_port key_port = GPIO_BATCH_PORT(GPIOC, KEY_PINS);
+ */
+#define GPIO_BATCH_PORT(gpio, LIST)                                             \
+    {                                                                           \
+        (gpio),                                                                 \
+        LIST(_GPIO_BATCH_X_CRL_MASK) 0u, LIST(_GPIO_BATCH_X_CRL) 0u,            \
+        LIST(_GPIO_BATCH_X_CRH_MASK) 0u, LIST(_GPIO_BATCH_X_CRH) 0u,            \
+        LIST(_GPIO_BATCH_X_SET) 0u, LIST(_GPIO_BATCH_X_RESET) 0u,               \
+        LIST(_GPIO_BATCH_X_EXTI) 0u,                                            \
+        LIST(_GPIO_BATCH_X_IMR) 0u, LIST(_GPIO_BATCH_X_EMR) 0u,                 \
+        LIST(_GPIO_BATCH_X_RTSR) 0u, LIST(_GPIO_BATCH_X_FTSR) 0u                \
+    }
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 引脚描述，字段含义同 GPIO_InitTypeDef，Pin 可以是多个引脚的组合
+ */
+typedef struct
+{
+    GPIO_TypeDef *Port;
+    uint32_t      Pin;
+    uint32_t      Mode;
+    uint32_t      Pull;
+    uint32_t      Speed;
+} gpio_batch_pin_t;
+
+/**
+ * 一个端口的最终寄存器值，提交时每个寄存器只写一次
+ */
+struct gpio_batch_port
+{
+    GPIO_TypeDef *port;
+    rt_uint32_t   crl_mask;
+    rt_uint32_t   crl;
+    rt_uint32_t   crh_mask;
+    rt_uint32_t   crh;
+    rt_uint16_t   odr_set;
+    rt_uint16_t   odr_reset;
+    rt_uint16_t   exti;             /*!< 配置为 EXTI 的引脚 */
+    rt_uint16_t   imr;
+    rt_uint16_t   emr;
+    rt_uint16_t   rtsr;
+    rt_uint16_t   ftsr;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+int      gpio_batch_compile(const gpio_batch_pin_t *pins, rt_size_t count,
+                            struct gpio_batch_port *ports, rt_size_t max_ports);
+void     gpio_batch_apply(const struct gpio_batch_port *ports, rt_size_t count);
+rt_err_t gpio_batch_init(const gpio_batch_pin_t *pins, rt_size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __GPIO_BATCH_H_ */
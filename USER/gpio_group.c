@@ -0,0 +1,233 @@
+/**
+  ******************************************************************************
+  * @file			gpio_group.c
+  * @brief			gpio pin group, atomic multi-pin update through BSRR
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <string.h>
+#include <gpio_group.h>
+
+/* Private constants ---------------------------------------------------------*/
+#define GG_NOT_LINEAR       127         /*!< shift 取该值表示映射不是整体移位 */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           组值转换为某个端口的引脚
+ *
+ * @param[in]       grp   引脚组
+ * @param[in]       p     端口
+ * @param[in]       value 组值
+ *
+ * @return          引脚掩码
+ *============================================================================*/
+static rt_uint32_t _gg_to_pins(const struct gpio_group *grp,
+                               const struct gpio_group_port *p, rt_uint32_t value)
+{
+    rt_uint32_t pins = 0;
+    rt_uint32_t i;
+
+    value &= p->bits;
+
+    if (p->shift != GG_NOT_LINEAR)
+        return p->shift >= 0 ? value << p->shift : value >> -p->shift;
+
+    for (i = 0; value; i++, value >>= 1)
+    {
+        if (value & 1u)
+            pins |= grp->pin_of[i];
+    }
+
+    return pins;
+}
+
+/**=============================================================================
+ * @brief           某个端口的引脚转换为组值
+ *
+ * @param[in]       grp   引脚组
+ * @param[in]       p     端口
+ * @param[in]       pins  引脚电平
+ *
+ * @return          组值
+ *============================================================================*/
+static rt_uint32_t _gg_from_pins(const struct gpio_group *grp,
+                                 const struct gpio_group_port *p, rt_uint32_t pins)
+{
+    rt_uint32_t value = 0;
+    rt_uint32_t i, bits;
+
+    pins &= p->mask;
+
+    if (p->shift != GG_NOT_LINEAR)
+        return p->shift >= 0 ? pins >> p->shift : pins << -p->shift;
+
+    for (i = 0, bits = p->bits; bits; i++, bits >>= 1)
+    {
+        if ((bits & 1u) && (pins & grp->pin_of[i]))
+            value |= 1u << i;
+    }
+
+    return value;
+}
+
+/**=============================================================================
+ * @brief           建立引脚组
+ *
+ * @param[out]      grp   引脚组
+ * @param[in]       pins  成员表，第 i 项对应组值的第 i 位
+ * @param[in]       count 成员个数
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 成员非法或重复，-RT_EFULL 端口过多
+ *============================================================================*/
+rt_err_t gpio_group_init(struct gpio_group *grp, const struct gpio_group_pin *pins, rt_size_t count)
+{
+    struct gpio_group_port *p;
+    rt_uint32_t i, j, n;
+
+    RT_ASSERT(grp != RT_NULL);
+    RT_ASSERT(pins != RT_NULL || count == 0);
+
+    if (count > GPIO_GROUP_MAX_PINS)
+        return -RT_EINVAL;
+
+    memset(grp, 0, sizeof(*grp));
+
+    for (i = 0; i < count; i++)
+    {
+        /* 每个成员必须是单个引脚 */
+        if (pins[i].pin == 0 || (pins[i].pin & (pins[i].pin - 1)) != 0)
+            return -RT_EINVAL;
+
+        for (j = 0; j < grp->nports; j++)
+        {
+            if (grp->port[j].port == pins[i].port)
+                break;
+        }
+        if (j == grp->nports)
+        {
+            if (j == GPIO_GROUP_MAX_PORTS)
+                return -RT_EFULL;
+            grp->port[j].port = pins[i].port;
+            grp->nports++;
+        }
+        p = &grp->port[j];
+
+        if (p->mask & pins[i].pin)
+            return -RT_EINVAL;
+
+        for (n = 0; (pins[i].pin >> n) != 1u; n++)
+            ;
+
+        /* 所有成员 引脚号 - 位号 相同时，转换只需一次移位 */
+        if (p->mask == 0)
+            p->shift = (rt_int8_t)((rt_int32_t)n - (rt_int32_t)i);
+        else if (p->shift != (rt_int32_t)n - (rt_int32_t)i)
+            p->shift = GG_NOT_LINEAR;
+
+        p->mask |= pins[i].pin;
+        p->bits |= 1u << i;
+        grp->port_of[i] = (rt_uint8_t)j;
+        grp->pin_of[i]  = pins[i].pin;
+    }
+    grp->npins = (rt_uint8_t)count;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           按组值输出，为 1 的位置高，其余清零
+ *
+ * @param[in]       grp   引脚组
+ * @param[in]       value 组值
+ *
+ * @return          none
+ *============================================================================*/
+void gpio_group_write(const struct gpio_group *grp, rt_uint32_t value)
+{
+    const struct gpio_group_port *p;
+    rt_uint32_t set;
+
+    for (p = grp->port; p < &grp->port[grp->nports]; p++)
+    {
+        set = _gg_to_pins(grp, p, value);
+        p->port->BSRR = set | ((p->mask & ~set) << 16);
+    }
+}
+
+/**=============================================================================
+ * @brief           置位部分成员并清零另一部分，未涉及的成员保持不变
+ *
+ * @param[in]       grp   引脚组
+ * @param[in]       set   要置高的位
+ * @param[in]       clear 要清零的位，与 set 重叠时以 set 为准
+ *
+ * @return          none
+ *============================================================================*/
+void gpio_group_modify(const struct gpio_group *grp, rt_uint32_t set, rt_uint32_t clear)
+{
+    const struct gpio_group_port *p;
+    rt_uint32_t bsrr;
+
+    for (p = grp->port; p < &grp->port[grp->nports]; p++)
+    {
+        bsrr = _gg_to_pins(grp, p, set) | (_gg_to_pins(grp, p, clear & ~set) << 16);
+        if (bsrr)
+            p->port->BSRR = bsrr;
+    }
+}
+
+/**=============================================================================
+ * @brief           翻转部分成员
+ *
+ * @param[in]       grp   引脚组
+ * @param[in]       bits  要翻转的位
+ *
+ * @return          none
+ *
+ * @note            与 HAL_GPIO_TogglePin 不同，写回用 BSRR 完成，中断中修改同
+ *                  一端口的其他引脚不会被覆盖
+ *============================================================================*/
+void gpio_group_toggle(const struct gpio_group *grp, rt_uint32_t bits)
+{
+    const struct gpio_group_port *p;
+    rt_uint32_t pins, odr;
+
+    for (p = grp->port; p < &grp->port[grp->nports]; p++)
+    {
+        pins = _gg_to_pins(grp, p, bits);
+        if (pins == 0)
+            continue;
+        odr = p->port->ODR;
+        p->port->BSRR = (pins & ~odr) | ((pins & odr) << 16);
+    }
+}
+
+/**=============================================================================
+ * @brief           读取组内引脚电平
+ *
+ * @param[in]       grp   引脚组
+ *
+ * @return          组值
+ *============================================================================*/
+rt_uint32_t gpio_group_read(const struct gpio_group *grp)
+{
+    const struct gpio_group_port *p;
+    rt_uint32_t value = 0;
+
+    for (p = grp->port; p < &grp->port[grp->nports]; p++)
+        value |= _gg_from_pins(grp, p, p->port->IDR);
+
+    return value;
+}
@@ -0,0 +1,72 @@
+/**
+  ******************************************************************************
+  * @file			gpio_group.h
+  * @brief			gpio pin group header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __GPIO_GROUP_H_
+#define __GPIO_GROUP_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define GPIO_GROUP_MAX_PINS     32          /*!< 组内引脚数，对应 32 位值 */
+#define GPIO_GROUP_MAX_PORTS    4           /*!< 组内涉及的端口数 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 组成员，在表中的序号即该引脚在组值中的位号
+ */
+struct gpio_group_pin
+{
+    GPIO_TypeDef *port;
+    rt_uint16_t   pin;              /*!< GPIO_PIN_x，单个引脚 */
+};
+
+struct gpio_group_port
+{
+    GPIO_TypeDef *port;
+    rt_uint16_t   mask;             /*!< 本端口属于组的引脚 */
+    rt_int8_t     shift;            /*!< 引脚号 = 位号 + shift，不是整体移位时为 127 */
+    rt_uint32_t   bits;             /*!< 本端口引脚对应的组值位 */
+};
+
+/**
+ * 引脚组，写入时每个端口只写一次 BSRR，置位和清零在同一次写中完成
+ */
+struct gpio_group
+{
+    rt_uint8_t             npins;
+    rt_uint8_t             nports;
+    rt_uint8_t             port_of[GPIO_GROUP_MAX_PINS];   /*!< 位号 -> 端口下标 */
+    rt_uint16_t            pin_of[GPIO_GROUP_MAX_PINS];    /*!< 位号 -> 引脚 */
+    struct gpio_group_port port[GPIO_GROUP_MAX_PORTS];
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t    gpio_group_init(struct gpio_group *grp, const struct gpio_group_pin *pins, rt_size_t count);
+void        gpio_group_write(const struct gpio_group *grp, rt_uint32_t value);
+void        gpio_group_modify(const struct gpio_group *grp, rt_uint32_t set, rt_uint32_t clear);
+void        gpio_group_toggle(const struct gpio_group *grp, rt_uint32_t bits);
+rt_uint32_t gpio_group_read(const struct gpio_group *grp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __GPIO_GROUP_H_ */
@@ -0,0 +1,832 @@
+/**
+  ******************************************************************************
+  * @file			i2c_bus.c
+  * @brief			interrupt driven i2c master transaction queue
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <dma_alloc.h>
+#include <timebase.h>
+#include <i2c_bus.h>
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#define I2C_BUS_NUM         2
+#define I2C_BUS_HALF_CLK_US 5           /*!< 恢复时手动时钟的半周期，100kHz */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static struct i2c_bus *i2c_buses[I2C_BUS_NUM];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           查找设备地址的熔断状态
+ *
+ * @param[in]       bus    总线
+ * @param[in]       addr   7 位地址
+ * @param[in]       create 没有时分配一个空闲或已恢复正常的槽位
+ *
+ * @return          状态，没有时为 RT_NULL
+ *============================================================================*/
+static struct i2c_breaker *_i2c_breaker_find(struct i2c_bus *bus, rt_uint16_t addr, rt_bool_t create)
+{
+    struct i2c_breaker *b, *spare = RT_NULL;
+
+    for (b = bus->breakers; b < bus->breakers + I2C_BUS_BREAKERS; b++)
+    {
+        if (b->addr == addr)
+            return b;
+        if (spare == RT_NULL && (b->addr == 0 || (b->fails == 0 && !b->open)))
+            spare = b;
+    }
+
+    if (!create || spare == RT_NULL)
+        return RT_NULL;
+
+    spare->addr  = addr;
+    spare->fails = 0;
+    spare->open  = 0;
+
+    return spare;
+}
+
+/**=============================================================================
+ * @brief           地址是否允许访问，关中断或在中断中调用
+ *
+ * @param[in]       bus  总线
+ * @param[in]       addr 7 位地址
+ *
+ * @return          RT_FALSE 熔断中
+ *============================================================================*/
+static rt_bool_t _i2c_breaker_allow(struct i2c_bus *bus, rt_uint16_t addr)
+{
+    struct i2c_breaker *b = _i2c_breaker_find(bus, addr, RT_FALSE);
+
+    if (b == RT_NULL || !b->open)
+        return RT_TRUE;
+    if ((rt_int32_t)(rt_tick_get() - b->until) < 0)
+        return RT_FALSE;
+
+    /* 冷却结束，放行一次试探，再失败一次就重新断开 */
+    b->open  = 0;
+    b->fails = I2C_BUS_BREAKER_FAILS - 1;
+
+    return RT_TRUE;
+}
+
+/**=============================================================================
+ * @brief           记录一次访问结果，关中断或在中断中调用
+ *
+ * @param[in]       bus    总线
+ * @param[in]       addr   7 位地址
+ * @param[in]       result 结果，只统计无应答和超时，总线错误由恢复处理
+ *
+ * @return          none
+ *============================================================================*/
+static void _i2c_breaker_record(struct i2c_bus *bus, rt_uint16_t addr, rt_err_t result)
+{
+    struct i2c_breaker *b;
+
+    if (result == RT_EOK)
+    {
+        b = _i2c_breaker_find(bus, addr, RT_FALSE);
+        if (b)
+            b->addr = 0;
+        return;
+    }
+    if (result != -RT_EIO && result != -RT_ETIMEOUT)
+        return;
+
+    b = _i2c_breaker_find(bus, addr, RT_TRUE);
+    if (b == RT_NULL || b->open)
+        return;
+
+    if (++b->fails >= I2C_BUS_BREAKER_FAILS)
+    {
+        b->open  = 1;
+        b->until = rt_tick_get() + I2C_BUS_BREAKER_COOLDOWN;
+        bus->stats.trips++;
+    }
+}
+
+/**=============================================================================
+ * @brief           总线恢复：手动产生最多 9 个时钟放出拉住 SDA 的从机，再发
+ *                  STOP，最后复位 I2C 单元，关中断或在中断中调用
+ *
+ * @param[in]       bus 总线
+ *
+ * @return          none
+ *
+ * @note            引脚切为 GPIO 后 SCL/SDA 各翻转一次，同时也是勘误 ES096
+ *                  2.13.7 中模拟滤波器锁住 BUSY 的解决步骤，最长约 110us
+ *============================================================================*/
+static void _i2c_bus_recover(struct i2c_bus *bus)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_TypeDef *port = bus->port;
+    rt_uint32_t i;
+
+    bus->stats.recoveries++;
+
+    if (bus->use_dma)
+    {
+        if (bus->hdma_tx.State == HAL_DMA_STATE_BUSY)
+            HAL_DMA_Abort(&bus->hdma_tx);
+        if (bus->hdma_rx.State == HAL_DMA_STATE_BUSY)
+            HAL_DMA_Abort(&bus->hdma_rx);
+    }
+    CLEAR_BIT(bus->hi2c.Instance->CR1, I2C_CR1_PE);
+
+    port->BSRR = bus->scl | bus->sda;
+    GPIO_InitStruct.Pin   = bus->scl | bus->sda;
+    GPIO_InitStruct.Mode  = GPIO_MODE_OUTPUT_OD;
+    GPIO_InitStruct.Pull  = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
+    timebase_delay_us(I2C_BUS_HALF_CLK_US);
+
+    /* 从机在读操作中途被打断时会拉住 SDA，送完剩下的位就会释放 */
+    for (i = 0; i < 9 && !(port->IDR & bus->sda); i++)
+    {
+        port->BRR = bus->scl;
+        timebase_delay_us(I2C_BUS_HALF_CLK_US);
+        port->BSRR = bus->scl;
+        timebase_delay_us(I2C_BUS_HALF_CLK_US);
+    }
+
+    /* STOP：SCL 为高时 SDA 由低变高 */
+    port->BRR = bus->scl;
+    timebase_delay_us(I2C_BUS_HALF_CLK_US);
+    port->BRR = bus->sda;
+    timebase_delay_us(I2C_BUS_HALF_CLK_US);
+    port->BSRR = bus->scl;
+    timebase_delay_us(I2C_BUS_HALF_CLK_US);
+    port->BSRR = bus->sda;
+    timebase_delay_us(I2C_BUS_HALF_CLK_US);
+
+    GPIO_InitStruct.Mode = GPIO_MODE_AF_OD;
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
+
+    /* HAL_I2C_Init 只开关 PE，锁住的 BUSY 要靠 SWRST 复位全部寄存器才能清除 */
+    SET_BIT(bus->hi2c.Instance->CR1, I2C_CR1_SWRST);
+    CLEAR_BIT(bus->hi2c.Instance->CR1, I2C_CR1_SWRST);
+    __HAL_UNLOCK(&bus->hi2c);
+    HAL_I2C_Init(&bus->hi2c);
+}
+
+/**=============================================================================
+ * @brief           空闲时检查 BUSY 是否被锁住，锁住时立即恢复，不让 HAL 在
+ *                  启动时空等 25ms
+ *
+ * @param[in]       bus 总线
+ *
+ * @return          none
+ *============================================================================*/
+static void _i2c_bus_check_idle(struct i2c_bus *bus)
+{
+    if (!__HAL_I2C_GET_FLAG(&bus->hi2c, I2C_FLAG_BUSY))
+        return;
+
+    /* 刚发出的 STOP 可能还没结束，等一个时钟周期再看 */
+    timebase_delay_us(2 * I2C_BUS_HALF_CLK_US);
+    if (__HAL_I2C_GET_FLAG(&bus->hi2c, I2C_FLAG_BUSY))
+        _i2c_bus_recover(bus);
+}
+
+/**=============================================================================
+ * @brief           寄存器地址发完后用 DMA 收发数据，在寄存器阶段的完成中断中调用
+ *
+ * @param[in]       bus 总线
+ *
+ * @return          HAL 状态
+ *
+ * @note            写操作方向不变，不再发起始，接着寄存器地址送出数据；读操作
+ *                  方向改变，HAL 自动发重复起始
+ *============================================================================*/
+static HAL_StatusTypeDef _i2c_bus_data_dma(struct i2c_bus *bus)
+{
+    struct i2c_msg *msg = &bus->head->msgs[bus->head->index];
+    rt_uint16_t dev = msg->addr << 1;
+
+    bus->reg_phase = 0;
+    if (msg->flags & I2C_MSG_RD)
+        return HAL_I2C_Master_Seq_Receive_DMA(&bus->hi2c, dev, msg->buf, msg->len, I2C_LAST_FRAME);
+    return HAL_I2C_Master_Seq_Transmit_DMA(&bus->hi2c, dev, msg->buf, msg->len, I2C_LAST_FRAME);
+}
+
+/**=============================================================================
+ * @brief           启动当前请求的当前消息，关中断或在中断中调用
+ *
+ * @param[in]       bus 总线
+ *
+ * @return          RT_EOK 成功
+ *
+ * @note            只调用不等待总线事件的 HAL 接口。HAL_I2C_Mem_*_DMA 在调用者
+ *                  上下文中轮询地址阶段，关中断时 HAL_GetTick 不走，从机拉住
+ *                  SCL 就会卡死，所以 DMA 消息的寄存器地址先用中断方式发送
+ *============================================================================*/
+static rt_err_t _i2c_bus_start(struct i2c_bus *bus)
+{
+    struct i2c_msg *msg = &bus->head->msgs[bus->head->index];
+    I2C_HandleTypeDef *hi2c = &bus->hi2c;
+    rt_uint16_t dev = msg->addr << 1;
+    rt_uint16_t size = msg->reg_len == 2 ? I2C_MEMADD_SIZE_16BIT : I2C_MEMADD_SIZE_8BIT;
+    rt_bool_t dma = bus->use_dma && msg->len >= I2C_BUS_DMA_THRESHOLD;
+    HAL_StatusTypeDef status;
+
+    /* 上一条消息无应答或出错后 BUSY 可能被锁住，HAL 启动时会空等 25ms；
+       完成中断里接上的消息也要查 */
+    _i2c_bus_check_idle(bus);
+
+    if (msg->reg_len && dma)
+    {
+        bus->reg_buf[0] = (rt_uint8_t)(msg->reg_len == 2 ? msg->reg >> 8 : msg->reg);
+        bus->reg_buf[1] = (rt_uint8_t)msg->reg;
+        bus->reg_phase  = 1;
+        status = HAL_I2C_Master_Seq_Transmit_IT(hi2c, dev, bus->reg_buf, msg->reg_len, I2C_FIRST_FRAME);
+    }
+    else if (msg->reg_len && (msg->flags & I2C_MSG_RD))
+        status = HAL_I2C_Mem_Read_IT(hi2c, dev, msg->reg, size, msg->buf, msg->len);
+    else if (msg->reg_len)
+        status = HAL_I2C_Mem_Write_IT(hi2c, dev, msg->reg, size, msg->buf, msg->len);
+    else if (msg->flags & I2C_MSG_RD)
+        status = dma ? HAL_I2C_Master_Receive_DMA(hi2c, dev, msg->buf, msg->len) :
+                       HAL_I2C_Master_Receive_IT(hi2c, dev, msg->buf, msg->len);
+    else
+        status = dma ? HAL_I2C_Master_Transmit_DMA(hi2c, dev, msg->buf, msg->len) :
+                       HAL_I2C_Master_Transmit_IT(hi2c, dev, msg->buf, msg->len);
+
+    if (status != HAL_OK)
+    {
+        bus->reg_phase = 0;
+        if (hi2c->ErrorCode & HAL_I2C_ERROR_AF)
+            _i2c_breaker_record(bus, msg->addr, -RT_EIO);
+        else if (hi2c->ErrorCode & HAL_I2C_ERROR_TIMEOUT)
+            _i2c_breaker_record(bus, msg->addr, -RT_ETIMEOUT);
+        return -RT_EIO;
+    }
+
+    bus->stats.msgs++;
+    rt_timer_start(&bus->timer);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           结束队首请求并启动下一个，关中断或在中断中调用
+ *
+ * @param[in]       bus    总线
+ * @param[in]       result 队首请求的结果
+ *
+ * @return          none
+ *============================================================================*/
+static void _i2c_bus_finish(struct i2c_bus *bus, rt_err_t result)
+{
+    struct i2c_req *req;
+
+    while ((req = bus->head) != RT_NULL)
+    {
+        bus->head = req->next;
+        if (bus->head == RT_NULL)
+            bus->tail = RT_NULL;
+
+        if (result != RT_EOK)
+            bus->stats.errors++;
+        req->result = result;
+        if (req->done)
+            req->done(req);
+        if (req->sem)
+            rt_sem_release(req->sem);
+
+        if (bus->head == RT_NULL)
+            break;
+        if (_i2c_bus_start(bus) == RT_EOK)
+        {
+            bus->stats.chained++;
+            break;
+        }
+        /* 启动失败的请求直接结束，继续尝试下一个 */
+        result = -RT_EIO;
+    }
+}
+
+/**=============================================================================
+ * @brief           一条消息结束，接着启动下一条消息或下一个请求
+ *
+ * @param[in]       bus    总线
+ * @param[in]       result 结果
+ *
+ * @return          none
+ *============================================================================*/
+static void _i2c_bus_msg_done(struct i2c_bus *bus, rt_err_t result)
+{
+    struct i2c_req *req = bus->head;
+
+    if (req == RT_NULL)
+        return;
+    rt_timer_stop(&bus->timer);
+    bus->reg_phase = 0;
+
+    _i2c_breaker_record(bus, req->msgs[req->index].addr, result);
+    /* 仲裁丢失或总线错误后 BUSY 常被锁住，先恢复再启动下一个 */
+    if (result == -RT_ERROR)
+        _i2c_bus_recover(bus);
+    /* HAL 只在主机模式下对无应答发 STOP，存储器模式要自己发，否则总线一直忙 */
+    if (result == -RT_EIO)
+        SET_BIT(bus->hi2c.Instance->CR1, I2C_CR1_STOP);
+
+    if (result == RT_EOK)
+    {
+        bus->stats.bytes += req->msgs[req->index].len;
+        if (++req->index < req->count)
+        {
+            if (_i2c_bus_start(bus) == RT_EOK)
+            {
+                bus->stats.chained++;
+                return;
+            }
+            result = -RT_EIO;
+        }
+    }
+
+    _i2c_bus_finish(bus, result);
+}
+
+/**=============================================================================
+ * @brief           消息超时，在定时器中断中执行
+ *
+ * @param[in]       arg 总线
+ *
+ * @return          none
+ *============================================================================*/
+static void _i2c_bus_timeout(void *arg)
+{
+    struct i2c_bus *bus = (struct i2c_bus *)arg;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    if (bus->head)
+    {
+        bus->stats.timeouts++;
+        _i2c_bus_recover(bus);
+        _i2c_bus_msg_done(bus, -RT_ETIMEOUT);
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+/**=============================================================================
+ * @brief           时钟切换前检查，关中断调用
+ *
+ * @param[in]       n 总线的通知
+ *
+ * @return          RT_TRUE 有请求正在执行
+ *============================================================================*/
+static rt_bool_t _i2c_bus_clk_busy(struct sysclk_notifier *n)
+{
+    struct i2c_bus *bus = n->user_data;
+
+    return bus->head != RT_NULL;
+}
+
+/**=============================================================================
+ * @brief           时钟切换后按新的 PCLK1 重算 FREQ/CCR/TRISE，关中断调用
+ *
+ * @param[in]       n 总线的通知
+ *
+ * @return          none
+ *============================================================================*/
+static void _i2c_bus_clk_changed(struct sysclk_notifier *n)
+{
+    struct i2c_bus *bus = n->user_data;
+
+    HAL_I2C_Init(&bus->hi2c);
+}
+
+/**=============================================================================
+ * @brief           初始化总线：引脚、I2C 单元、DMA 通道和中断
+ *
+ * @param[in]       bus   总线
+ * @param[in]       i2c   I2C1(PB6/PB7) 或 I2C2(PB10/PB11)
+ * @param[in]       speed 时钟频率，最高 400000
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 不支持的 I2C，-RT_EIO 初始化失败
+ *
+ * @note            本模块实现了 HAL 的 I2C 主机回调，I2C1/I2C2 都要经过本模块，
+ *                  不是 i2c_bus_init 登记的句柄的回调被忽略
+ *============================================================================*/
+rt_err_t i2c_bus_init(struct i2c_bus *bus, I2C_TypeDef *i2c, rt_uint32_t speed)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    dma_request_t req_tx, req_rx;
+    IRQn_Type ev_irqn, er_irqn;
+    rt_uint32_t index;
+    rt_uint16_t pins;
+
+    RT_ASSERT(bus != RT_NULL);
+
+    if (i2c == I2C1)
+    {
+        __HAL_RCC_I2C1_CLK_ENABLE();
+        index   = 0;
+        pins    = GPIO_PIN_6 | GPIO_PIN_7;
+        ev_irqn = I2C1_EV_IRQn;
+        er_irqn = I2C1_ER_IRQn;
+        req_tx  = DMA_REQ_I2C1_TX;
+        req_rx  = DMA_REQ_I2C1_RX;
+    }
+    else if (i2c == I2C2)
+    {
+        __HAL_RCC_I2C2_CLK_ENABLE();
+        index   = 1;
+        pins    = GPIO_PIN_10 | GPIO_PIN_11;
+        ev_irqn = I2C2_EV_IRQn;
+        er_irqn = I2C2_ER_IRQn;
+        req_tx  = DMA_REQ_I2C2_TX;
+        req_rx  = DMA_REQ_I2C2_RX;
+    }
+    else
+    {
+        return -RT_EINVAL;
+    }
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+
+    rt_memset(bus, 0, sizeof(*bus));
+    bus->port = GPIOB;
+    bus->scl  = pins & (GPIO_PIN_6 | GPIO_PIN_10);
+    bus->sda  = pins & (GPIO_PIN_7 | GPIO_PIN_11);
+
+    GPIO_InitStruct.Pin   = pins;
+    GPIO_InitStruct.Mode  = GPIO_MODE_AF_OD;
+    GPIO_InitStruct.Pull  = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOB, &GPIO_InitStruct);
+
+    bus->hi2c.Instance             = i2c;
+    bus->hi2c.Init.ClockSpeed      = speed;
+    bus->hi2c.Init.DutyCycle       = I2C_DUTYCYCLE_2;
+    bus->hi2c.Init.OwnAddress1     = 0;
+    bus->hi2c.Init.AddressingMode  = I2C_ADDRESSINGMODE_7BIT;
+    bus->hi2c.Init.DualAddressMode = I2C_DUALADDRESS_DISABLE;
+    bus->hi2c.Init.OwnAddress2     = 0;
+    bus->hi2c.Init.GeneralCallMode = I2C_GENERALCALL_DISABLE;
+    bus->hi2c.Init.NoStretchMode   = I2C_NOSTRETCH_DISABLE;
+    if (HAL_I2C_Init(&bus->hi2c) != HAL_OK)
+        return -RT_EIO;
+    _i2c_bus_check_idle(bus);
+
+    /* 通道被占用时只用中断方式，例如 I2C2 与控制台串口共用 DMA1 通道 4/5 */
+    if (dma_alloc(&bus->hdma_rx, req_rx, DMA_CLASS_LATENCY) == RT_EOK)
+    {
+        if (dma_alloc(&bus->hdma_tx, req_tx, DMA_CLASS_STREAM) == RT_EOK)
+        {
+            bus->hdma_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+            bus->hdma_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+            bus->hdma_rx.Init.MemInc              = DMA_MINC_ENABLE;
+            bus->hdma_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+            bus->hdma_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+            bus->hdma_rx.Init.Mode                = DMA_NORMAL;
+            HAL_DMA_Init(&bus->hdma_rx);
+            __HAL_LINKDMA(&bus->hi2c, hdmarx, bus->hdma_rx);
+
+            bus->hdma_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+            bus->hdma_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+            bus->hdma_tx.Init.MemInc              = DMA_MINC_ENABLE;
+            bus->hdma_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+            bus->hdma_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+            bus->hdma_tx.Init.Mode                = DMA_NORMAL;
+            HAL_DMA_Init(&bus->hdma_tx);
+            __HAL_LINKDMA(&bus->hi2c, hdmatx, bus->hdma_tx);
+
+            bus->use_dma = 1;
+        }
+        else
+        {
+            dma_free(&bus->hdma_rx);
+        }
+    }
+
+    rt_timer_init(&bus->timer, "i2c", _i2c_bus_timeout, bus, I2C_BUS_MSG_TIMEOUT,
+                  RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+    i2c_buses[index] = bus;
+
+    bus->clk.periph    = i2c;
+    bus->clk.busy      = _i2c_bus_clk_busy;
+    bus->clk.changed   = _i2c_bus_clk_changed;
+    bus->clk.user_data = bus;
+    sysclk_register_notifier(&bus->clk);
+
+    HAL_NVIC_SetPriority(ev_irqn, 3, 3);
+    HAL_NVIC_EnableIRQ(ev_irqn);
+    HAL_NVIC_SetPriority(er_irqn, 3, 3);
+    HAL_NVIC_EnableIRQ(er_irqn);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           提交异步请求，任意上下文可调用
+ *
+ * @param[in]       bus 总线
+ * @param[in]       req 请求，完成前必须保持有效
+ *
+ * @return          RT_EOK 已提交，-RT_EINVAL 参数错误，-RT_EBUSY 某个地址
+ *                  熔断中，请求没有提交，也不会调用完成通知
+ *
+ * @note            请求按提交顺序执行，前一个完成后在中断中直接启动下一个，
+ *                  同一请求的多条消息之间不会插入其他请求
+ *============================================================================*/
+rt_err_t i2c_bus_submit(struct i2c_bus *bus, struct i2c_req *req)
+{
+    rt_base_t level;
+    rt_uint16_t i;
+
+    if (bus == RT_NULL || req == RT_NULL || req->msgs == RT_NULL || req->count == 0)
+        return -RT_EINVAL;
+    for (i = 0; i < req->count; i++)
+    {
+        if (req->msgs[i].len == 0 || req->msgs[i].buf == RT_NULL || req->msgs[i].reg_len > 2)
+            return -RT_EINVAL;
+    }
+
+    req->next   = RT_NULL;
+    req->index  = 0;
+    req->result = -RT_EBUSY;
+
+    level = rt_hw_interrupt_disable();
+    for (i = 0; i < req->count; i++)
+    {
+        if (!_i2c_breaker_allow(bus, req->msgs[i].addr))
+        {
+            bus->stats.fast_fails++;
+            rt_hw_interrupt_enable(level);
+            return -RT_EBUSY;
+        }
+    }
+
+    bus->stats.reqs++;
+    if (bus->tail)
+    {
+        bus->tail->next = req;
+        bus->tail = req;
+    }
+    else
+    {
+        bus->head = bus->tail = req;
+        if (_i2c_bus_start(bus) != RT_EOK)
+            _i2c_bus_finish(bus, -RT_EIO);
+    }
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           同步执行一组消息，例如一次读出多个传感器的寄存器
+ *
+ * @param[in]       bus   总线
+ * @param[in]       msgs  消息数组
+ * @param[in]       count 消息条数
+ *
+ * @return          RT_EOK 成功，-RT_EIO 无应答或启动失败，-RT_ERROR 总线错误，
+ *                  -RT_ETIMEOUT 超时，-RT_EBUSY 设备熔断中
+ *
+ * @note            只能在线程中调用
+ *============================================================================*/
+rt_err_t i2c_bus_transfer(struct i2c_bus *bus, struct i2c_msg *msgs, rt_uint16_t count)
+{
+    struct i2c_req req;
+    struct rt_semaphore sem;
+    rt_err_t err;
+
+    if (rt_thread_self() == RT_NULL || rt_interrupt_get_nest() != 0)
+        return -RT_ERROR;
+
+    rt_sem_init(&sem, "i2c", 0, RT_IPC_FLAG_FIFO);
+    rt_memset(&req, 0, sizeof(req));
+    req.msgs  = msgs;
+    req.count = count;
+    req.sem   = &sem;
+
+    err = i2c_bus_submit(bus, &req);
+    if (err == RT_EOK)
+    {
+        /* 每条消息都有超时，一定会完成 */
+        rt_sem_take(&sem, RT_WAITING_FOREVER);
+        err = req.result;
+    }
+    rt_sem_detach(&sem);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           读寄存器
+ *
+ * @param[in]       bus  总线
+ * @param[in]       addr 7 位地址
+ * @param[in]       reg  寄存器
+ * @param[out]      buf  缓冲
+ * @param[in]       len  字节数
+ *
+ * @return          同 i2c_bus_transfer
+ *============================================================================*/
+rt_err_t i2c_bus_read_reg(struct i2c_bus *bus, rt_uint16_t addr, rt_uint8_t reg,
+                          void *buf, rt_uint16_t len)
+{
+    struct i2c_msg msg;
+
+    msg.addr    = addr;
+    msg.reg     = reg;
+    msg.reg_len = 1;
+    msg.flags   = I2C_MSG_RD;
+    msg.len     = len;
+    msg.buf     = (rt_uint8_t *)buf;
+
+    return i2c_bus_transfer(bus, &msg, 1);
+}
+
+/**=============================================================================
+ * @brief           写寄存器
+ *
+ * @param[in]       bus  总线
+ * @param[in]       addr 7 位地址
+ * @param[in]       reg  寄存器
+ * @param[in]       buf  数据
+ * @param[in]       len  字节数
+ *
+ * @return          同 i2c_bus_transfer
+ *============================================================================*/
+rt_err_t i2c_bus_write_reg(struct i2c_bus *bus, rt_uint16_t addr, rt_uint8_t reg,
+                           const void *buf, rt_uint16_t len)
+{
+    struct i2c_msg msg;
+
+    msg.addr    = addr;
+    msg.reg     = reg;
+    msg.reg_len = 1;
+    msg.flags   = I2C_MSG_WR;
+    msg.len     = len;
+    msg.buf     = (rt_uint8_t *)buf;
+
+    return i2c_bus_transfer(bus, &msg, 1);
+}
+
+/**=============================================================================
+ * @brief           回调的句柄对应的总线，不是 i2c_bus_init 登记的 I2C 时为空
+ *
+ * @param[in]       hi2c I2C 句柄
+ *
+ * @return          总线，RT_NULL 表示不属于本模块
+ *============================================================================*/
+static struct i2c_bus *_i2c_bus_of(I2C_HandleTypeDef *hi2c)
+{
+    rt_size_t i;
+
+    for (i = 0; i < I2C_BUS_NUM; i++)
+    {
+        if (i2c_buses[i] != RT_NULL && hi2c == &i2c_buses[i]->hi2c)
+            return i2c_buses[i];
+    }
+    return RT_NULL;
+}
+
+/* HAL 回调，其他 I2C 句柄的回调直接忽略 --------------------------------------*/
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_bus *bus = _i2c_bus_of(hi2c);
+
+    if (bus == RT_NULL)
+        return;
+
+    /* 寄存器地址已发出，总线仍被本主机占用，接着启动数据阶段 */
+    if (bus->reg_phase)
+    {
+        if (_i2c_bus_data_dma(bus) != HAL_OK)
+            _i2c_bus_msg_done(bus, -RT_EIO);
+        return;
+    }
+    _i2c_bus_msg_done(bus, RT_EOK);
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_bus *bus = _i2c_bus_of(hi2c);
+
+    if (bus != RT_NULL)
+        _i2c_bus_msg_done(bus, RT_EOK);
+}
+
+void HAL_I2C_MemTxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_bus *bus = _i2c_bus_of(hi2c);
+
+    if (bus != RT_NULL)
+        _i2c_bus_msg_done(bus, RT_EOK);
+}
+
+void HAL_I2C_MemRxCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_bus *bus = _i2c_bus_of(hi2c);
+
+    if (bus != RT_NULL)
+        _i2c_bus_msg_done(bus, RT_EOK);
+}
+
+/**=============================================================================
+ * @brief           传输出错，无应答为 -RT_EIO，其余总线错误为 -RT_ERROR
+ *
+ * @param[in]       hi2c I2C 句柄
+ *
+ * @return          none
+ *============================================================================*/
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_bus *bus = _i2c_bus_of(hi2c);
+
+    if (bus != RT_NULL)
+        _i2c_bus_msg_done(bus, hi2c->ErrorCode == HAL_I2C_ERROR_AF ? -RT_EIO : -RT_ERROR);
+}
+
+void HAL_I2C_AbortCpltCallback(I2C_HandleTypeDef *hi2c)
+{
+    struct i2c_bus *bus = _i2c_bus_of(hi2c);
+
+    if (bus != RT_NULL)
+        _i2c_bus_msg_done(bus, -RT_ERROR);
+}
+
+/* 中断函数 ------------------------------------------------------------------*/
+void I2C1_EV_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    if (i2c_buses[0])
+        HAL_I2C_EV_IRQHandler(&i2c_buses[0]->hi2c);
+    rt_interrupt_leave();
+}
+
+void I2C1_ER_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    if (i2c_buses[0])
+        HAL_I2C_ER_IRQHandler(&i2c_buses[0]->hi2c);
+    rt_interrupt_leave();
+}
+
+void I2C2_EV_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    if (i2c_buses[1])
+        HAL_I2C_EV_IRQHandler(&i2c_buses[1]->hi2c);
+    rt_interrupt_leave();
+}
+
+void I2C2_ER_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    if (i2c_buses[1])
+        HAL_I2C_ER_IRQHandler(&i2c_buses[1]->hi2c);
+    rt_interrupt_leave();
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           打印各总线统计
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int i2c(void)
+{
+    struct i2c_bus_stats *st;
+    rt_uint32_t i;
+
+    rt_kprintf("bus   dma  reqs     msgs     chained  bytes      errors  timeouts recover trips  fast_fails\n");
+    for (i = 0; i < I2C_BUS_NUM; i++)
+    {
+        if (i2c_buses[i] == RT_NULL)
+            continue;
+        st = &i2c_buses[i]->stats;
+        rt_kprintf("i2c%d  %-4s %-8u %-8u %-8u %-10u %-7u %-8u %-7u %-6u %u\n", i + 1,
+                   i2c_buses[i]->use_dma ? "yes" : "no", st->reqs, st->msgs,
+                   st->chained, st->bytes, st->errors, st->timeouts,
+                   st->recoveries, st->trips, st->fast_fails);
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(i2c, show i2c bus statistics);
+#endif
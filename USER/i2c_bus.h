@@ -0,0 +1,135 @@
+/**
+  ******************************************************************************
+  * @file			i2c_bus.h
+  * @brief			interrupt driven i2c master transaction queue header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __I2C_BUS_H_
+#define __I2C_BUS_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <sysclk.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define I2C_BUS_DMA_THRESHOLD   8           /*!< 不少于该字节数且有 DMA 通道时用 DMA */
+#define I2C_BUS_MSG_TIMEOUT     (RT_TICK_PER_SECOND / 20)   /*!< 单条消息超时 */
+#define I2C_BUS_BREAKERS        8           /*!< 每条总线跟踪的设备地址数 */
+#define I2C_BUS_BREAKER_FAILS   3           /*!< 连续失败该次数后断开 */
+#define I2C_BUS_BREAKER_COOLDOWN RT_TICK_PER_SECOND         /*!< 断开后多久放行一次试探 */
+
+/* 消息标志 */
+#define I2C_MSG_WR              0x00
+#define I2C_MSG_RD              0x01
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 一条消息：reg_len 不为 0 时先写寄存器地址，读操作用重复起始
+ */
+struct i2c_msg
+{
+    rt_uint16_t             addr;           /*!< 7 位地址 */
+    rt_uint16_t             reg;
+    rt_uint8_t              reg_len;        /*!< 寄存器地址字节数 0/1/2 */
+    rt_uint8_t              flags;          /*!< I2C_MSG_RD/I2C_MSG_WR */
+    rt_uint16_t             len;
+    rt_uint8_t             *buf;
+};
+
+struct i2c_req;
+typedef void (*i2c_req_done_t)(struct i2c_req *req);
+
+/**
+ * 一次请求，包含一条或多条消息，在中断中背靠背执行，全部完成后通知一次
+ *
+ * 提交后到完成前由本模块持有，调用者不能修改或释放
+ */
+struct i2c_req
+{
+    struct i2c_msg         *msgs;
+    rt_uint16_t             count;
+
+    i2c_req_done_t          done;           /*!< 完成回调，在中断中执行，可为空 */
+    rt_sem_t                sem;            /*!< 完成时释放，可为空 */
+    void                   *user_data;
+    volatile rt_err_t       result;         /*!< 完成前为 -RT_EBUSY */
+
+    /* 内部使用 */
+    struct i2c_req         *next;
+    rt_uint16_t             index;          /*!< 正在执行的消息 */
+};
+
+/**
+ * 设备地址的熔断状态：连续无应答或超时达到次数后断开，冷却期内提交
+ * 直接返回 -RT_EBUSY，不再占用总线等超时；冷却结束后放行一次，成功则
+ * 恢复，失败立即再次断开
+ */
+struct i2c_breaker
+{
+    rt_uint16_t             addr;           /*!< 0 表示空闲 */
+    rt_uint8_t              fails;
+    rt_uint8_t              open;
+    rt_tick_t               until;
+};
+
+struct i2c_bus_stats
+{
+    rt_uint32_t             reqs;
+    rt_uint32_t             msgs;
+    rt_uint32_t             chained;        /*!< 在完成中断中直接启动的消息 */
+    rt_uint32_t             bytes;
+    rt_uint32_t             errors;
+    rt_uint32_t             timeouts;
+    rt_uint32_t             recoveries;     /*!< 9 时钟恢复和复位的次数 */
+    rt_uint32_t             trips;          /*!< 熔断次数 */
+    rt_uint32_t             fast_fails;     /*!< 熔断期间直接拒绝的请求 */
+};
+
+struct i2c_bus
+{
+    I2C_HandleTypeDef       hi2c;           /*!< 必须是第一个成员，HAL 回调由它找到总线 */
+    DMA_HandleTypeDef       hdma_tx;
+    DMA_HandleTypeDef       hdma_rx;
+    rt_uint8_t              use_dma;
+    struct rt_timer         timer;
+    GPIO_TypeDef           *port;
+    rt_uint16_t             scl;
+    rt_uint16_t             sda;
+    struct i2c_breaker      breakers[I2C_BUS_BREAKERS];
+    struct sysclk_notifier  clk;
+    rt_uint8_t              reg_buf[2];     /*!< DMA 消息的寄存器地址，高字节在前 */
+    rt_uint8_t              reg_phase;      /*!< 正在用中断方式发送寄存器地址 */
+
+    struct i2c_req         *head;           /*!< 正在执行的请求 */
+    struct i2c_req         *tail;
+    struct i2c_bus_stats    stats;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t i2c_bus_init(struct i2c_bus *bus, I2C_TypeDef *i2c, rt_uint32_t speed);
+rt_err_t i2c_bus_submit(struct i2c_bus *bus, struct i2c_req *req);
+rt_err_t i2c_bus_transfer(struct i2c_bus *bus, struct i2c_msg *msgs, rt_uint16_t count);
+rt_err_t i2c_bus_read_reg(struct i2c_bus *bus, rt_uint16_t addr, rt_uint8_t reg,
+                          void *buf, rt_uint16_t len);
+rt_err_t i2c_bus_write_reg(struct i2c_bus *bus, rt_uint16_t addr, rt_uint8_t reg,
+                           const void *buf, rt_uint16_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __I2C_BUS_H_ */
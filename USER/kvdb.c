@@ -0,0 +1,664 @@
+/**
+  ******************************************************************************
+  * @file			kvdb.c
+  * @brief			log structured key-value store on internal flash
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <string.h>
+#include <crc_engine.h>
+#include <flash_writer.h>
+#include <kvdb.h>
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#define KVDB_SECTOR_PAGES   2
+#define KVDB_SECTOR_SIZE    (KVDB_SECTOR_PAGES * FLASH_PAGE_SIZE)
+#define KVDB_INDEX_SIZE     64          /*!< 2 的幂，大于 KVDB_MAX_KEYS */
+
+#define KVDB_SECTOR_MAGIC   0x4B564442UL    /*!< "KVDB" */
+#define KVDB_REC_MAGIC      0x5AA5
+#define KVDB_REC_LIVE       0xFF
+#define KVDB_REC_TOMBSTONE  0x00
+
+/* Private macro -------------------------------------------------------------*/
+#define KVDB_OTHER(sector)  ((sector) == kvdb_base ? kvdb_base + KVDB_SECTOR_SIZE : kvdb_base)
+#define KVDB_REC_SIZE(rec)  RT_ALIGN(sizeof(struct kvdb_rec) + (rec)->key_len + (rec)->value_len, 4)
+#define KVDB_REC_KEY(rec)   ((const char *)(rec) + sizeof(struct kvdb_rec))
+#define KVDB_REC_VALUE(rec) ((const rt_uint8_t *)KVDB_REC_KEY(rec) + (rec)->key_len)
+
+/* Private typedef -----------------------------------------------------------*/
+/* 扇区头，回收时最后写入，seq 大的为当前扇区 */
+struct kvdb_sector_hdr
+{
+    rt_uint32_t magic;
+    rt_uint32_t seq;
+};
+
+/* 记录头，后跟键和值，按 4 字节补齐；crc 覆盖 crc 之前的字段、键和值 */
+struct kvdb_rec
+{
+    rt_uint16_t magic;
+    rt_uint8_t  key_len;
+    rt_uint8_t  flags;
+    rt_uint16_t value_len;
+    rt_uint16_t reserved;
+    rt_uint32_t crc;
+};
+
+/* RAM 索引，addr 为 0 表示空槽；删除的键保留槽位直到回收 */
+struct kvdb_slot
+{
+    rt_uint32_t hash;
+    rt_uint32_t addr;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct flash_writer kvdb_fw;
+static rt_uint32_t kvdb_base = 0;           /*!< 占用 flash 最后两个扇区，按芯片实际容量在初始化时确定 */
+static struct kvdb_slot kvdb_index[KVDB_INDEX_SIZE];
+static rt_uint32_t kvdb_keys = 0;
+static rt_uint32_t kvdb_sector = 0;
+static rt_uint32_t kvdb_seq = 0;
+static rt_uint32_t kvdb_tail = 0;
+static struct rt_semaphore kvdb_lock;
+static struct kvdb_stats kvdb_stat;
+static rt_uint8_t kvdb_mounted = 0;
+static rt_uint32_t kvdb_rec_buf[RT_ALIGN(sizeof(struct kvdb_rec) + KVDB_KEY_MAX + KVDB_VALUE_MAX, 4) / 4];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           FNV-1a
+ *
+ * @param[in]       key 键
+ * @param[in]       len 长度
+ *
+ * @return          hash
+ *============================================================================*/
+static rt_uint32_t _kvdb_hash(const char *key, rt_size_t len)
+{
+    rt_uint32_t h = 2166136261UL;
+
+    while (len--)
+    {
+        h ^= (rt_uint8_t)*key++;
+        h *= 16777619UL;
+    }
+    return h;
+}
+
+/**=============================================================================
+ * @brief           计算记录 crc
+ *
+ * @param[in]       rec 记录，可在 flash 或 RAM 中
+ *
+ * @return          crc
+ *============================================================================*/
+static rt_uint32_t _kvdb_rec_crc(const struct kvdb_rec *rec)
+{
+    rt_uint32_t crc;
+
+    crc = crc_engine_calculate(CRC_ENGINE_HW, rec, RT_ALIGN_DOWN(sizeof(struct kvdb_rec) - sizeof(rec->crc), 4));
+    return crc_engine_accumulate(CRC_ENGINE_HW, crc, KVDB_REC_KEY(rec), rec->key_len + rec->value_len);
+}
+
+/**=============================================================================
+ * @brief           检查记录头是否合理（不校验 crc）
+ *
+ * @param[in]       rec 记录
+ * @param[in]       end 扇区结束地址
+ *
+ * @return          RT_TRUE 合理
+ *============================================================================*/
+static rt_bool_t _kvdb_rec_sane(const struct kvdb_rec *rec, rt_uint32_t end)
+{
+    return rec->magic == KVDB_REC_MAGIC &&
+           rec->key_len != 0 && rec->key_len <= KVDB_KEY_MAX &&
+           rec->value_len <= KVDB_VALUE_MAX &&
+           (rt_uint32_t)(rt_ubase_t)rec + KVDB_REC_SIZE(rec) <= end;
+}
+
+/**=============================================================================
+ * @brief           在索引中查找键
+ *
+ * @param[in]       key  键
+ * @param[in]       len  键长度
+ * @param[in]       hash 键的 hash
+ *
+ * @return          命中的槽，未命中时为可插入的空槽，表满时为 RT_NULL
+ *============================================================================*/
+static struct kvdb_slot *_kvdb_lookup(const char *key, rt_size_t len, rt_uint32_t hash)
+{
+    const struct kvdb_rec *rec;
+    rt_uint32_t i, n;
+
+    for (i = hash, n = 0; n < KVDB_INDEX_SIZE; i++, n++)
+    {
+        struct kvdb_slot *slot = &kvdb_index[i & (KVDB_INDEX_SIZE - 1)];
+
+        if (slot->addr == 0)
+            return slot;
+
+        rec = (const struct kvdb_rec *)(rt_ubase_t)slot->addr;
+        if (slot->hash == hash && rec->key_len == len && memcmp(KVDB_REC_KEY(rec), key, len) == 0)
+            return slot;
+    }
+    return RT_NULL;
+}
+
+/**=============================================================================
+ * @brief           把一条有效记录登记到索引
+ *
+ * @param[in]       rec 记录
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _kvdb_index_apply(const struct kvdb_rec *rec)
+{
+    rt_uint32_t hash = _kvdb_hash(KVDB_REC_KEY(rec), rec->key_len);
+    struct kvdb_slot *slot = _kvdb_lookup(KVDB_REC_KEY(rec), rec->key_len, hash);
+
+    if (slot == RT_NULL)
+        return -RT_EFULL;
+
+    if (slot->addr == 0)
+    {
+        if (kvdb_keys >= KVDB_MAX_KEYS)
+            return -RT_EFULL;
+        kvdb_keys++;
+    }
+    slot->hash = hash;
+    slot->addr = (rt_uint32_t)(rt_ubase_t)rec;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           扫描扇区，重建索引并找到写入位置
+ *
+ * @param[in]       sector 扇区地址
+ *
+ * @return          none
+ *
+ * @note            耗时与扇区大小成正比，与写入历史无关
+ *============================================================================*/
+static void _kvdb_scan(rt_uint32_t sector)
+{
+    rt_uint32_t end = sector + KVDB_SECTOR_SIZE;
+    rt_uint32_t addr = sector + sizeof(struct kvdb_sector_hdr);
+    const struct kvdb_rec *rec;
+
+    memset(kvdb_index, 0, sizeof(kvdb_index));
+    kvdb_keys = 0;
+    kvdb_stat.mount_records = 0;
+
+    while (addr + sizeof(struct kvdb_rec) <= end)
+    {
+        rec = (const struct kvdb_rec *)(rt_ubase_t)addr;
+        if (rec->magic == 0xFFFF)
+            break;
+
+        if (!_kvdb_rec_sane(rec, end))
+        {
+            /* 无法确定后面是否可写，下次写入时先回收 */
+            addr = end;
+            break;
+        }
+
+        /* 掉电写了一半的记录 crc 不对，跳过 */
+        if (_kvdb_rec_crc(rec) == rec->crc)
+        {
+            _kvdb_index_apply(rec);
+            kvdb_stat.mount_records++;
+        }
+        addr += KVDB_REC_SIZE(rec);
+    }
+
+    kvdb_sector = sector;
+    kvdb_tail = addr;
+}
+
+/**=============================================================================
+ * @brief           写 flash 并立即落盘
+ *
+ * @param[in]       addr 地址
+ * @param[in]       data 数据
+ * @param[in]       len  长度
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _kvdb_write(rt_uint32_t addr, const void *data, rt_size_t len)
+{
+    rt_err_t err;
+
+    err = flash_writer_seek(&kvdb_fw, addr);
+    if (err == RT_EOK)
+        err = flash_writer_write(&kvdb_fw, data, len);
+    if (err == RT_EOK)
+        err = flash_writer_flush(&kvdb_fw);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           擦除扇区，已经是空白时跳过
+ *
+ * @param[in]       sector 扇区地址
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _kvdb_erase(rt_uint32_t sector)
+{
+    const rt_uint32_t *p = (const rt_uint32_t *)(rt_ubase_t)sector;
+    FLASH_EraseInitTypeDef erase;
+    rt_uint32_t i, page_error;
+    HAL_StatusTypeDef status;
+
+    for (i = 0; i < KVDB_SECTOR_SIZE / 4; i++)
+    {
+        if (p[i] != 0xFFFFFFFFUL)
+            break;
+    }
+    if (i == KVDB_SECTOR_SIZE / 4)
+        return RT_EOK;
+
+    /* 写缓存中可能还留着该扇区的旧页 */
+    flash_writer_close(&kvdb_fw);
+
+    erase.TypeErase   = FLASH_TYPEERASE_PAGES;
+    erase.Banks       = FLASH_BANK_1;
+    erase.PageAddress = sector;
+    erase.NbPages     = KVDB_SECTOR_PAGES;
+
+    HAL_FLASH_Unlock();
+    status = HAL_FLASHEx_Erase(&erase, &page_error);
+    HAL_FLASH_Lock();
+
+    kvdb_stat.erase_count += KVDB_SECTOR_PAGES;
+
+    return status == HAL_OK ? RT_EOK : -RT_EIO;
+}
+
+/**=============================================================================
+ * @brief           写扇区头，使其成为当前扇区
+ *
+ * @param[in]       sector 扇区地址
+ * @param[in]       seq    序号
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _kvdb_activate(rt_uint32_t sector, rt_uint32_t seq)
+{
+    struct kvdb_sector_hdr hdr;
+    rt_err_t err;
+
+    hdr.magic = KVDB_SECTOR_MAGIC;
+    hdr.seq   = seq;
+
+    err = _kvdb_write(sector, &hdr, sizeof(hdr));
+    if (err == RT_EOK)
+    {
+        kvdb_sector = sector;
+        kvdb_seq = seq;
+    }
+    return err;
+}
+
+/**=============================================================================
+ * @brief           把有效记录搬到备用扇区，然后擦除当前扇区
+ *
+ * @param[in]       none
+ *
+ * @return          RT_EOK 成功
+ *
+ * @note            扇区头在记录全部写完后才写入，掉电后仍以旧扇区为准
+ *============================================================================*/
+static rt_err_t _kvdb_gc(void)
+{
+    rt_uint32_t old = kvdb_sector;
+    rt_uint32_t spare = KVDB_OTHER(old);
+    rt_uint32_t pos = spare + sizeof(struct kvdb_sector_hdr);
+    const struct kvdb_rec *rec;
+    rt_tick_t start = rt_tick_get();
+    rt_err_t err;
+    rt_uint32_t i;
+
+    err = _kvdb_erase(spare);
+    if (err != RT_EOK)
+        return err;
+
+    for (i = 0; i < KVDB_INDEX_SIZE; i++)
+    {
+        if (kvdb_index[i].addr == 0)
+            continue;
+
+        rec = (const struct kvdb_rec *)(rt_ubase_t)kvdb_index[i].addr;
+        if (rec->flags == KVDB_REC_TOMBSTONE)
+            continue;
+
+        err = flash_writer_seek(&kvdb_fw, pos);
+        if (err == RT_EOK)
+            err = flash_writer_write(&kvdb_fw, rec, KVDB_REC_SIZE(rec));
+        if (err != RT_EOK)
+            return err;
+        pos += KVDB_REC_SIZE(rec);
+    }
+    err = flash_writer_flush(&kvdb_fw);
+    if (err == RT_EOK)
+        err = _kvdb_activate(spare, kvdb_seq + 1);
+    if (err != RT_EOK)
+        return err;
+
+    err = _kvdb_erase(old);
+    _kvdb_scan(spare);
+
+    kvdb_stat.gc_count++;
+    kvdb_stat.gc_ticks += rt_tick_get() - start;
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           追加一条记录，空间不足时先回收
+ *
+ * @param[in]       rec 已填好（含 crc）的记录
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _kvdb_append(const struct kvdb_rec *rec, rt_bool_t new_key)
+{
+    rt_uint32_t size = KVDB_REC_SIZE(rec);
+    rt_err_t err;
+
+    if (kvdb_tail + size > kvdb_sector + KVDB_SECTOR_SIZE ||
+        (new_key && kvdb_keys >= KVDB_MAX_KEYS))
+    {
+        err = _kvdb_gc();
+        if (err != RT_EOK)
+            return err;
+        if (kvdb_tail + size > kvdb_sector + KVDB_SECTOR_SIZE ||
+            (new_key && kvdb_keys >= KVDB_MAX_KEYS))
+            return -RT_EFULL;
+    }
+
+    err = _kvdb_write(kvdb_tail, rec, size);
+    if (err != RT_EOK)
+    {
+        /* 写入位置已不可信，下次写入前回收 */
+        kvdb_tail = kvdb_sector + KVDB_SECTOR_SIZE;
+        return err;
+    }
+
+    rec = (const struct kvdb_rec *)(rt_ubase_t)kvdb_tail;
+    kvdb_tail += size;
+
+    return _kvdb_index_apply(rec);
+}
+
+/**=============================================================================
+ * @brief           在 RAM 中组装一条记录
+ *
+ * @param[in]       key       键
+ * @param[in]       key_len   键长度
+ * @param[in]       value     值
+ * @param[in]       value_len 值长度
+ * @param[in]       flags     KVDB_REC_LIVE 或 KVDB_REC_TOMBSTONE
+ *
+ * @return          记录
+ *============================================================================*/
+static struct kvdb_rec *_kvdb_build(const char *key, rt_size_t key_len,
+                                    const void *value, rt_size_t value_len, rt_uint8_t flags)
+{
+    struct kvdb_rec *rec = (struct kvdb_rec *)kvdb_rec_buf;
+
+    memset(kvdb_rec_buf, 0xFF, sizeof(kvdb_rec_buf));
+    rec->magic     = KVDB_REC_MAGIC;
+    rec->key_len   = key_len;
+    rec->flags     = flags;
+    rec->value_len = value_len;
+    memcpy((char *)KVDB_REC_KEY(rec), key, key_len);
+    if (value_len)
+        memcpy((rt_uint8_t *)KVDB_REC_VALUE(rec), value, value_len);
+    rec->crc = _kvdb_rec_crc(rec);
+
+    return rec;
+}
+
+/**=============================================================================
+ * @brief           初始化并挂载
+ *
+ * @param[in]       none
+ *
+ * @return          0
+ *============================================================================*/
+int kvdb_init(void)
+{
+    rt_sem_init(&kvdb_lock, "kvdb", 1, RT_IPC_FLAG_FIFO);
+    kvdb_base = flash_writer_flash_end() - 2 * KVDB_SECTOR_SIZE;
+    kvdb_mount();
+
+    return 0;
+}
+INIT_ENV_EXPORT(kvdb_init);
+
+/**=============================================================================
+ * @brief           挂载：选出当前扇区并重建 RAM 索引，没有有效扇区时格式化
+ *
+ * @param[in]       none
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t kvdb_mount(void)
+{
+    const struct kvdb_sector_hdr *h0 = (const struct kvdb_sector_hdr *)(rt_ubase_t)kvdb_base;
+    const struct kvdb_sector_hdr *h1 = (const struct kvdb_sector_hdr *)(rt_ubase_t)(kvdb_base + KVDB_SECTOR_SIZE);
+    rt_bool_t v0 = h0->magic == KVDB_SECTOR_MAGIC;
+    rt_bool_t v1 = h1->magic == KVDB_SECTOR_MAGIC;
+    rt_tick_t start = rt_tick_get();
+    rt_uint32_t active;
+    rt_err_t err = RT_EOK;
+
+    rt_sem_take(&kvdb_lock, RT_WAITING_FOREVER);
+
+    kvdb_mounted = 0;
+
+    /* 重新打开会清零 writer 的计数，先并入统计 */
+    kvdb_stat.flash_bytes += kvdb_fw.program_count * 2;
+    kvdb_stat.erase_count += kvdb_fw.erase_count;
+    flash_writer_open(&kvdb_fw, kvdb_base, 2 * KVDB_SECTOR_SIZE);
+
+    if (!v0 && !v1)
+    {
+        err = _kvdb_erase(kvdb_base);
+        if (err == RT_EOK)
+            err = _kvdb_erase(kvdb_base + KVDB_SECTOR_SIZE);
+        if (err == RT_EOK)
+            err = _kvdb_activate(kvdb_base, 1);
+        active = kvdb_base;
+    }
+    else
+    {
+        if (v0 && v1)
+            active = (rt_int32_t)(h1->seq - h0->seq) > 0 ? kvdb_base + KVDB_SECTOR_SIZE : kvdb_base;
+        else
+            active = v0 ? kvdb_base : kvdb_base + KVDB_SECTOR_SIZE;
+
+        kvdb_seq = ((const struct kvdb_sector_hdr *)(rt_ubase_t)active)->seq;
+
+        /* 两个扇区都有效说明回收完成后擦除旧扇区前掉电 */
+        if (v0 && v1)
+            err = _kvdb_erase(KVDB_OTHER(active));
+    }
+
+    if (err == RT_EOK)
+    {
+        _kvdb_scan(active);
+        kvdb_mounted = 1;
+    }
+
+    kvdb_stat.mount_ticks = rt_tick_get() - start;
+    rt_sem_release(&kvdb_lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           写入键值
+ *
+ * @param[in]       key   键，以 '\0' 结束
+ * @param[in]       value 值
+ * @param[in]       len   值长度
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t kvdb_set(const char *key, const void *value, rt_size_t len)
+{
+    rt_size_t key_len = rt_strlen(key);
+    rt_uint32_t hash = _kvdb_hash(key, key_len);
+    struct kvdb_slot *slot;
+    const struct kvdb_rec *old;
+    rt_err_t err;
+
+    if (key_len == 0 || key_len > KVDB_KEY_MAX || len > KVDB_VALUE_MAX || (len && value == RT_NULL))
+        return -RT_EINVAL;
+
+    rt_sem_take(&kvdb_lock, RT_WAITING_FOREVER);
+    if (!kvdb_mounted)
+    {
+        rt_sem_release(&kvdb_lock);
+        return -RT_EIO;
+    }
+
+    /* 值没有变化时不写 flash */
+    slot = _kvdb_lookup(key, key_len, hash);
+    old = (slot && slot->addr) ? (const struct kvdb_rec *)(rt_ubase_t)slot->addr : RT_NULL;
+    if (old && old->flags == KVDB_REC_LIVE && old->value_len == len &&
+        memcmp(KVDB_REC_VALUE(old), value, len) == 0)
+    {
+        rt_sem_release(&kvdb_lock);
+        return RT_EOK;
+    }
+
+    err = _kvdb_append(_kvdb_build(key, key_len, value, len, KVDB_REC_LIVE), old == RT_NULL);
+    if (err == RT_EOK)
+        kvdb_stat.user_bytes += key_len + len;
+
+    rt_sem_release(&kvdb_lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           读取键值
+ *
+ * @param[in]       key   键
+ * @param[out]      value 缓冲区
+ * @param[in]       size  缓冲区大小，值较长时截断
+ * @param[out]      len   值的实际长度，可为 RT_NULL
+ *
+ * @return          RT_EOK 成功，-RT_EEMPTY 键不存在
+ *============================================================================*/
+rt_err_t kvdb_get(const char *key, void *value, rt_size_t size, rt_size_t *len)
+{
+    rt_size_t key_len = rt_strlen(key);
+    struct kvdb_slot *slot;
+    const struct kvdb_rec *rec;
+    rt_err_t err = -RT_EEMPTY;
+
+    rt_sem_take(&kvdb_lock, RT_WAITING_FOREVER);
+
+    slot = _kvdb_lookup(key, key_len, _kvdb_hash(key, key_len));
+    if (kvdb_mounted && slot && slot->addr)
+    {
+        rec = (const struct kvdb_rec *)(rt_ubase_t)slot->addr;
+        if (rec->flags == KVDB_REC_LIVE)
+        {
+            memcpy(value, KVDB_REC_VALUE(rec), rec->value_len < size ? rec->value_len : size);
+            if (len)
+                *len = rec->value_len;
+            err = RT_EOK;
+        }
+    }
+
+    rt_sem_release(&kvdb_lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           删除键，写入一条删除记录，空间在回收时释放
+ *
+ * @param[in]       key   键
+ *
+ * @return          RT_EOK 成功，-RT_EEMPTY 键不存在
+ *============================================================================*/
+rt_err_t kvdb_delete(const char *key)
+{
+    rt_size_t key_len = rt_strlen(key);
+    struct kvdb_slot *slot;
+    rt_err_t err = -RT_EEMPTY;
+
+    rt_sem_take(&kvdb_lock, RT_WAITING_FOREVER);
+
+    slot = _kvdb_lookup(key, key_len, _kvdb_hash(key, key_len));
+    if (kvdb_mounted && slot && slot->addr &&
+        ((const struct kvdb_rec *)(rt_ubase_t)slot->addr)->flags == KVDB_REC_LIVE)
+    {
+        err = _kvdb_append(_kvdb_build(key, key_len, RT_NULL, 0, KVDB_REC_TOMBSTONE), RT_FALSE);
+    }
+
+    rt_sem_release(&kvdb_lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           读取统计
+ *
+ * @param[out]      stats 统计
+ *
+ * @return          none
+ *============================================================================*/
+void kvdb_get_stats(struct kvdb_stats *stats)
+{
+    rt_sem_take(&kvdb_lock, RT_WAITING_FOREVER);
+    *stats = kvdb_stat;
+    stats->flash_bytes += kvdb_fw.program_count * 2;
+    stats->erase_count += kvdb_fw.erase_count;
+    stats->used = kvdb_tail - kvdb_sector;
+    stats->size = KVDB_SECTOR_SIZE;
+    rt_sem_release(&kvdb_lock);
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           kvdb 命令，打印统计
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void kvdb(void)
+{
+    struct kvdb_stats s;
+
+    kvdb_get_stats(&s);
+    rt_kprintf("used      : %d/%d bytes, %d keys\n", s.used, s.size, kvdb_keys);
+    rt_kprintf("mount     : %d ticks, %d records\n", s.mount_ticks, s.mount_records);
+    rt_kprintf("gc        : %d times, %d ticks\n", s.gc_count, s.gc_ticks);
+    rt_kprintf("written   : user %d, flash %d bytes, %d page erases\n",
+               s.user_bytes, s.flash_bytes, s.erase_count);
+}
+MSH_CMD_EXPORT(kvdb, show key-value store statistics);
+#endif
@@ -0,0 +1,57 @@
+/**
+  ******************************************************************************
+  * @file			kvdb.h
+  * @brief			key-value store header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __KVDB_H_
+#define __KVDB_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define KVDB_KEY_MAX        16          /*!< 键最大长度，不含结束符 */
+#define KVDB_VALUE_MAX      256         /*!< 值最大长度 */
+#define KVDB_MAX_KEYS       48          /*!< 同时存在的键（含已删除未回收的）个数上限 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+struct kvdb_stats
+{
+    rt_tick_t   mount_ticks;            /*!< 最近一次挂载耗时 */
+    rt_uint32_t mount_records;          /*!< 挂载时扫描的记录数 */
+    rt_uint32_t gc_count;
+    rt_tick_t   gc_ticks;               /*!< 回收累计耗时 */
+    rt_uint32_t user_bytes;             /*!< 调用者写入的键+值字节数 */
+    rt_uint32_t flash_bytes;            /*!< 实际编程的字节数，与 user_bytes 之比即写放大 */
+    rt_uint32_t erase_count;
+    rt_uint32_t used;                   /*!< 当前扇区已用字节 */
+    rt_uint32_t size;                   /*!< 扇区大小 */
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+int      kvdb_init(void);
+rt_err_t kvdb_mount(void);
+rt_err_t kvdb_set(const char *key, const void *value, rt_size_t len);
+rt_err_t kvdb_get(const char *key, void *value, rt_size_t size, rt_size_t *len);
+rt_err_t kvdb_delete(const char *key);
+void     kvdb_get_stats(struct kvdb_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __KVDB_H_ */
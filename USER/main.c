@@ -14,6 +14,8 @@
 #include <rtthread.h>
 #include "stm32f1xx_hal.h"
 #include <console.h>
+#include <gpio_batch.h>
+#include <gpio_group.h>
 
 /* Private constants ---------------------------------------------------------*/
 #define LED1_GPIO_PORT  GPIOD
@@ -22,9 +24,26 @@
 #define LED2_GPIO_PORT  GPIOA
 #define LED2_PIN        GPIO_PIN_8
 
+#define LED1_PINS(PIN)  PIN(2, GPIO_MODE_OUTPUT_PP, GPIO_NOPULL, GPIO_SPEED_FREQ_LOW)
+#define LED2_PINS(PIN)  PIN(8, GPIO_MODE_OUTPUT_PP, GPIO_NOPULL, GPIO_SPEED_FREQ_LOW)
+
 /* Private macro -------------------------------------------------------------*/
 /* Private typedef -----------------------------------------------------------*/
 /* Private variables ---------------------------------------------------------*/
+static const struct gpio_batch_port led_ports[] =
+{
+    GPIO_BATCH_PORT(LED1_GPIO_PORT, LED1_PINS),
+    GPIO_BATCH_PORT(LED2_GPIO_PORT, LED2_PINS),
+};
+
+static const struct gpio_group_pin led_pins[] =
+{
+    {LED1_GPIO_PORT, LED1_PIN},
+    {LED2_GPIO_PORT, LED2_PIN},
+};
+
+static struct gpio_group led_group;
+
 /* Private function ----------------------------------------------------------*/
 
 /**=============================================================================
@@ -36,21 +55,12 @@
  *============================================================================*/
 static void _led_gpio_init(void)
 {
-    GPIO_InitTypeDef GPIO_InitStruct = {0};
-
     __HAL_RCC_GPIOA_CLK_ENABLE();
     __HAL_RCC_GPIOD_CLK_ENABLE();
-    HAL_GPIO_WritePin(LED1_GPIO_PORT, LED1_PIN, GPIO_PIN_RESET);
-    HAL_GPIO_WritePin(LED2_GPIO_PORT, LED2_PIN, GPIO_PIN_RESET);
+    gpio_group_init(&led_group, led_pins, sizeof(led_pins) / sizeof(led_pins[0]));
+    gpio_group_write(&led_group, 0);
 
-    GPIO_InitStruct.Pin   = LED1_PIN;
-    GPIO_InitStruct.Mode  = GPIO_MODE_OUTPUT_PP;
-    GPIO_InitStruct.Pull  = GPIO_NOPULL;
-    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_LOW;
-    HAL_GPIO_Init(LED1_GPIO_PORT, &GPIO_InitStruct);
-  
-    GPIO_InitStruct.Pin   = LED2_PIN;
-    HAL_GPIO_Init(LED2_GPIO_PORT, &GPIO_InitStruct);    
+    gpio_batch_apply(led_ports, sizeof(led_ports) / sizeof(led_ports[0]));
 }
 
 /**=============================================================================
@@ -62,18 +72,14 @@ static void _led_gpio_init(void)
  *============================================================================*/
 int main(void) 
 {
-    rt_console_init();
-
     _led_gpio_init();
 
     while (1)
     {
         //rt_kprintf("led blink\r\n");
-        HAL_GPIO_WritePin(LED1_GPIO_PORT, LED1_PIN, GPIO_PIN_RESET);
-        HAL_GPIO_WritePin(LED2_GPIO_PORT, LED2_PIN, GPIO_PIN_SET);
+        gpio_group_write(&led_group, 0x2);     /* LED1 灭，LED2 亮 */
         rt_thread_mdelay(500);
-        HAL_GPIO_WritePin(LED1_GPIO_PORT, LED1_PIN, GPIO_PIN_SET);
-        HAL_GPIO_WritePin(LED2_GPIO_PORT, LED2_PIN, GPIO_PIN_RESET);
+        gpio_group_write(&led_group, 0x1);
         rt_thread_mdelay(500);
     }
     
@@ -0,0 +1,309 @@
+/**
+  ******************************************************************************
+  * @file			prof.c
+  * @brief			dwt cycle counter probes and latency histograms
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <string.h>
+#include <prof.h>
+#ifdef RT_PROF_HOST_CLOCK
+#include <time.h>
+#endif
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+#ifdef RT_USING_PROF
+
+#ifndef RT_USING_HOOK
+#error "RT_USING_PROF needs RT_USING_HOOK for the interrupt enter/leave hooks"
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#define PROF_EXC_SYSTICK    15u
+#define PROF_EXC_IRQ(irqn)  ((rt_uint32_t)(irqn) + 16u)
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+struct prof_probe
+{
+    const char  *name;
+    rt_uint32_t  count;
+    rt_uint32_t  min;
+    rt_uint32_t  max;
+    rt_uint64_t  sum;
+    rt_uint32_t  hist[PROF_HIST_BUCKETS];
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct prof_probe prof_probes[PROF_ID_NUM];
+static rt_uint32_t       prof_isr_start[PROF_ISR_NEST_MAX];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           中断号映射到探针
+ *
+ * @param[in]       exc 异常号（IPSR）
+ *
+ * @return          探针编号
+ *============================================================================*/
+static rt_uint32_t _prof_isr_id(rt_uint32_t exc)
+{
+    if (exc == PROF_EXC_SYSTICK)
+        return PROF_ID_ISR_SYSTICK;
+    if (exc == PROF_EXC_IRQ(USART1_IRQn))
+        return PROF_ID_ISR_USART1;
+    if ((exc >= PROF_EXC_IRQ(DMA1_Channel1_IRQn) && exc <= PROF_EXC_IRQ(DMA1_Channel7_IRQn)) ||
+        (exc >= PROF_EXC_IRQ(DMA2_Channel1_IRQn) && exc <= PROF_EXC_IRQ(DMA2_Channel4_5_IRQn)))
+        return PROF_ID_ISR_DMA;
+
+    return PROF_ID_ISR_OTHER;
+}
+
+/**=============================================================================
+ * @brief           rt_interrupt_enter 钩子，此时已关中断且嵌套层数已加一
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void _prof_isr_enter(void)
+{
+    rt_uint8_t nest = rt_interrupt_get_nest();
+
+    if (nest > 0 && nest <= PROF_ISR_NEST_MAX)
+        prof_isr_start[nest - 1] = PROF_NOW();
+}
+
+/**=============================================================================
+ * @brief           rt_interrupt_leave 钩子，此时已关中断且嵌套层数已减一
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *
+ * @note            测得的是包含被嵌套中断在内的总时间
+ *============================================================================*/
+static void _prof_isr_leave(void)
+{
+    rt_uint8_t nest = rt_interrupt_get_nest();
+
+    if (nest < PROF_ISR_NEST_MAX)
+        prof_record(_prof_isr_id(__get_IPSR()), PROF_NOW() - prof_isr_start[nest]);
+}
+
+#ifdef RT_PROF_HOST_CLOCK
+/**=============================================================================
+ * @brief           主机上的周期计数：单调时钟按 SystemCoreClock 折算
+ *
+ * @param[in]       none
+ *
+ * @return          周期数，32 位回绕，与 DWT->CYCCNT 相同
+ *============================================================================*/
+rt_uint32_t prof_host_cycles(void)
+{
+    struct timespec ts;
+    rt_uint64_t ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ns = (rt_uint64_t)ts.tv_sec * 1000000000u + (rt_uint64_t)ts.tv_nsec;
+
+    return (rt_uint32_t)(ns * (SystemCoreClock / 1000000u) / 1000u);
+}
+#endif
+
+/**=============================================================================
+ * @brief           打开 DWT 周期计数器并挂上中断钩子
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+int prof_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    prof_probes[PROF_ID_ISR_SYSTICK].name = "systick";
+    prof_probes[PROF_ID_ISR_USART1].name  = "usart1";
+    prof_probes[PROF_ID_ISR_DMA].name     = "dma";
+    prof_probes[PROF_ID_ISR_OTHER].name   = "irq";
+    prof_reset();
+
+    rt_interrupt_enter_sethook(_prof_isr_enter);
+    rt_interrupt_leave_sethook(_prof_isr_leave);
+
+    return 0;
+}
+INIT_BOARD_EXPORT(prof_init);
+
+/**=============================================================================
+ * @brief           记录一次测量，中断中也可调用
+ *
+ * @param[in]       id     探针编号
+ * @param[in]       cycles 周期数
+ *
+ * @return          none
+ *============================================================================*/
+void prof_record(rt_uint32_t id, rt_uint32_t cycles)
+{
+    struct prof_probe *p;
+    rt_uint32_t bucket;
+    rt_base_t level;
+
+    if (id >= PROF_ID_NUM)
+        return;
+    p = &prof_probes[id];
+
+    bucket = 31u - __CLZ(cycles | 1u);
+    if (bucket >= PROF_HIST_BUCKETS)
+        bucket = PROF_HIST_BUCKETS - 1;
+
+    level = rt_hw_interrupt_disable();
+    p->count++;
+    p->sum += cycles;
+    if (cycles < p->min)
+        p->min = cycles;
+    if (cycles > p->max)
+        p->max = cycles;
+    p->hist[bucket]++;
+    rt_hw_interrupt_enable(level);
+}
+
+/**=============================================================================
+ * @brief           设置探针名称，prof 命令中显示
+ *
+ * @param[in]       id   探针编号
+ * @param[in]       name 名称，需长期有效
+ *
+ * @return          none
+ *============================================================================*/
+void prof_set_name(rt_uint32_t id, const char *name)
+{
+    if (id < PROF_ID_NUM)
+        prof_probes[id].name = name;
+}
+
+/**=============================================================================
+ * @brief           读取探针统计
+ *
+ * @param[in]       id    探针编号
+ * @param[out]      stats 统计结果
+ *
+ * @return          RT_EOK 成功，-RT_EEMPTY 尚无记录
+ *============================================================================*/
+rt_err_t prof_get_stats(rt_uint32_t id, struct prof_stats *stats)
+{
+    struct prof_probe snap;
+    rt_uint32_t i, target, acc = 0;
+    rt_base_t level;
+
+    RT_ASSERT(stats != RT_NULL);
+
+    if (id >= PROF_ID_NUM)
+        return -RT_EINVAL;
+
+    level = rt_hw_interrupt_disable();
+    snap = prof_probes[id];
+    rt_hw_interrupt_enable(level);
+
+    if (snap.count == 0)
+        return -RT_EEMPTY;
+
+    stats->count = snap.count;
+    stats->min   = snap.min;
+    stats->max   = snap.max;
+    stats->avg   = (rt_uint32_t)(snap.sum / snap.count);
+
+    /* 取累计达到 99% 的分桶上界 */
+    target = snap.count - snap.count / 100;
+    for (i = 0; i < PROF_HIST_BUCKETS - 1; i++)
+    {
+        acc += snap.hist[i];
+        if (acc >= target)
+            break;
+    }
+    stats->p99 = (i < PROF_HIST_BUCKETS - 1) ? (2u << i) - 1u : snap.max;
+    if (stats->p99 > snap.max)
+        stats->p99 = snap.max;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           清空所有探针的统计
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+void prof_reset(void)
+{
+    rt_base_t level;
+    rt_uint32_t i;
+
+    level = rt_hw_interrupt_disable();
+    for (i = 0; i < PROF_ID_NUM; i++)
+    {
+        prof_probes[i].count = 0;
+        prof_probes[i].sum   = 0;
+        prof_probes[i].min   = 0xFFFFFFFF;
+        prof_probes[i].max   = 0;
+        memset(prof_probes[i].hist, 0, sizeof(prof_probes[i].hist));
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           打印各探针的 min/avg/max/p99，单位为周期和微秒
+ *
+ * @param[in]       argc 参数个数
+ * @param[in]       argv prof [reset]
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int prof(int argc, char **argv)
+{
+    struct prof_stats st;
+    rt_uint32_t i, mhz;
+
+    if (argc > 1 && rt_strcmp(argv[1], "reset") == 0)
+    {
+        prof_reset();
+        return 0;
+    }
+
+    mhz = SystemCoreClock / 1000000u;
+    rt_kprintf("probe    count      min      avg      max      p99  (cycles, p99 us)\n");
+    for (i = 0; i < PROF_ID_NUM; i++)
+    {
+        if (prof_get_stats(i, &st) != RT_EOK)
+            continue;
+        if (prof_probes[i].name)
+            rt_kprintf("%-8s", prof_probes[i].name);
+        else
+            rt_kprintf("user%-4d", i - PROF_ID_USER);
+        rt_kprintf(" %8u %8u %8u %8u %8u  %u\n",
+                   st.count, st.min, st.avg, st.max, st.p99, st.p99 / mhz);
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(prof, dump profiling probes or reset them);
+#endif
+
+#endif  /* RT_USING_PROF */
@@ -0,0 +1,91 @@
+/**
+  ******************************************************************************
+  * @file			prof.h
+  * @brief			dwt cycle counter profiling header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __PROF_H_
+#define __PROF_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#ifndef RT_PROF_USER_PROBES
+#define RT_PROF_USER_PROBES     8
+#endif
+
+#define PROF_HIST_BUCKETS       24          /*!< log2 分桶，最后一桶包含 2^23 以上 */
+#define PROF_ISR_NEST_MAX       8
+
+/* Exported macros -----------------------------------------------------------*/
+#ifdef RT_PROF_HOST_CLOCK
+/* 主机构建：寄存器访问经过模拟器，按 clock_gettime 折算成 SystemCoreClock 周期 */
+#define PROF_NOW()              prof_host_cycles()
+#else
+#define PROF_NOW()              (DWT->CYCCNT)
+#endif
+
+/**
+ * 成对使用，包住要测量的代码：
+ *
+ *   PROF_BEGIN(PROF_ID_USER + 0);
+ *   HAL_SPI_Transmit(&hspi, buf, len, 10);
+ *   PROF_END(PROF_ID_USER + 0);
+ */
+#ifdef RT_USING_PROF
+#define PROF_BEGIN(id)          do { rt_uint32_t _prof_start = PROF_NOW()
+#define PROF_END(id)            prof_record((id), PROF_NOW() - _prof_start); } while (0)
+#else
+#define PROF_BEGIN(id)          do {
+#define PROF_END(id)            } while (0)
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+enum prof_id
+{
+    PROF_ID_ISR_SYSTICK = 0,
+    PROF_ID_ISR_USART1,
+    PROF_ID_ISR_DMA,
+    PROF_ID_ISR_OTHER,
+    PROF_ID_USER,                           /*!< 用户探针从这里开始 */
+    PROF_ID_NUM = PROF_ID_USER + RT_PROF_USER_PROBES
+};
+
+struct prof_stats
+{
+    rt_uint32_t count;
+    rt_uint32_t min;                        /*!< 周期数 */
+    rt_uint32_t avg;
+    rt_uint32_t max;
+    rt_uint32_t p99;                        /*!< 所在分桶的上界，不超过 max */
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+int      prof_init(void);
+void     prof_record(rt_uint32_t id, rt_uint32_t cycles);
+void     prof_set_name(rt_uint32_t id, const char *name);
+rt_err_t prof_get_stats(rt_uint32_t id, struct prof_stats *stats);
+void     prof_reset(void);
+#ifdef RT_PROF_HOST_CLOCK
+rt_uint32_t prof_host_cycles(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __PROF_H_ */
@@ -0,0 +1,288 @@
+/**
+  ******************************************************************************
+  * @file			ringbuffer.c
+  * @brief			single producer / single consumer ringbuffer
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <ringbuffer.h>
+#include <string.h>
+
+/* Private constants ---------------------------------------------------------*/
+/* Private macro -------------------------------------------------------------*/
+/* 数据先写入缓冲，再发布索引，防止对方读到未写完的数据 */
+#define RB_PUBLISH(idx, val)    do { __DMB(); (idx) = (val); } while (0)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           ringbuffer init
+ *
+ * @param[in]       rb   ringbuffer
+ * @param[in]       pool 缓冲区
+ * @param[in]       size 缓冲区大小，不是 2 的幂时向下取整到 2 的幂
+ *
+ * @return          none
+ *============================================================================*/
+void rt_ringbuffer_init(struct rt_ringbuffer *rb,
+                        rt_uint8_t           *pool,
+                        rt_uint32_t           size)
+{
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(size > 0);
+
+    /* 只保留最高位 */
+    while (size & (size - 1))
+        size &= size - 1;
+
+    /* set buffer pool and size */
+    rb->buffer_ptr  = pool;
+    rb->buffer_mask = size - 1;
+
+    /* initialize read and write index */
+    rb->read_index  = 0;
+    rb->write_index = 0;
+}
+
+/**=============================================================================
+ * @brief           清空 ringbuffer，调用者需保证此时没有读写
+ *
+ * @param[in]       rb   ringbuffer
+ *
+ * @return          none
+ *============================================================================*/
+void rt_ringbuffer_reset(struct rt_ringbuffer *rb)
+{
+    RT_ASSERT(rb != RT_NULL);
+
+    rb->read_index  = 0;
+    rb->write_index = 0;
+}
+
+/**=============================================================================
+ * @brief           put a block of data into ring buffer
+ *
+ * @param[in]       rb     ringbuffer
+ * @param[in]       ptr    数据
+ * @param[in]       length 数据长度
+ *
+ * @return          实际写入的长度，空间不足时只写入能放下的部分
+ *============================================================================*/
+rt_size_t rt_ringbuffer_put(struct rt_ringbuffer *rb,
+                            const rt_uint8_t     *ptr,
+                            rt_size_t             length)
+{
+    rt_uint32_t write_index, offset, first;
+    rt_size_t space;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    write_index = rb->write_index;
+    space = rt_ringbuffer_get_size(rb) - (write_index - rb->read_index);
+    if (length > space)
+        length = space;
+    if (length == 0)
+        return 0;
+
+    /* 最多分两段拷贝 */
+    offset = write_index & rb->buffer_mask;
+    first  = rt_ringbuffer_get_size(rb) - offset;
+    if (first > length)
+        first = length;
+
+    memcpy(&rb->buffer_ptr[offset], ptr, first);
+    memcpy(&rb->buffer_ptr[0], ptr + first, length - first);
+
+    RB_PUBLISH(rb->write_index, write_index + length);
+
+    return length;
+}
+
+/**=============================================================================
+ * @brief           put a character into ring buffer
+ *
+ * @param[in]       rb  ringbuffer
+ * @param[in]       ch  字符
+ *
+ * @return          1 成功，0 缓冲已满
+ *============================================================================*/
+rt_size_t rt_ringbuffer_putchar(struct rt_ringbuffer *rb, const rt_uint8_t ch)
+{
+    rt_uint32_t write_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    write_index = rb->write_index;
+    /* whether has enough space */
+    if (write_index - rb->read_index > rb->buffer_mask)
+        return 0;
+
+    rb->buffer_ptr[write_index & rb->buffer_mask] = ch;
+    RB_PUBLISH(rb->write_index, write_index + 1);
+
+    return 1;
+}
+
+/**=============================================================================
+ * @brief           取得可直接写入的连续空间
+ *
+ * @param[in]       rb  ringbuffer
+ * @param[out]      ptr 连续空间起始地址
+ *
+ * @return          连续空间长度，写完后用 rt_ringbuffer_put_commit 提交
+ *============================================================================*/
+rt_size_t rt_ringbuffer_put_reserve(struct rt_ringbuffer *rb, rt_uint8_t **ptr)
+{
+    rt_uint32_t write_index, offset;
+    rt_size_t space, contiguous;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    write_index = rb->write_index;
+    space  = rt_ringbuffer_get_size(rb) - (write_index - rb->read_index);
+    offset = write_index & rb->buffer_mask;
+    contiguous = rt_ringbuffer_get_size(rb) - offset;
+
+    *ptr = &rb->buffer_ptr[offset];
+
+    return contiguous < space ? contiguous : space;
+}
+
+/**=============================================================================
+ * @brief           提交 rt_ringbuffer_put_reserve 取得的空间中已写入的数据
+ *
+ * @param[in]       rb     ringbuffer
+ * @param[in]       length 已写入的长度，不能超过 reserve 返回值
+ *
+ * @return          none
+ *============================================================================*/
+void rt_ringbuffer_put_commit(struct rt_ringbuffer *rb, rt_size_t length)
+{
+    RT_ASSERT(rb != RT_NULL);
+    RT_ASSERT(length <= rt_ringbuffer_space_len(rb));
+
+    RB_PUBLISH(rb->write_index, rb->write_index + length);
+}
+
+/**=============================================================================
+ * @brief           get a block of data from ring buffer
+ *
+ * @param[in]       rb     ringbuffer
+ * @param[out]      ptr    数据
+ * @param[in]       length 期望读取的长度
+ *
+ * @return          实际读取的长度
+ *============================================================================*/
+rt_size_t rt_ringbuffer_get(struct rt_ringbuffer *rb,
+                            rt_uint8_t           *ptr,
+                            rt_size_t             length)
+{
+    rt_uint32_t read_index, offset, first;
+    rt_size_t size;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = rb->read_index;
+    size = rb->write_index - read_index;
+    if (length > size)
+        length = size;
+    if (length == 0)
+        return 0;
+
+    /* 最多分两段拷贝 */
+    offset = read_index & rb->buffer_mask;
+    first  = rt_ringbuffer_get_size(rb) - offset;
+    if (first > length)
+        first = length;
+
+    memcpy(ptr, &rb->buffer_ptr[offset], first);
+    memcpy(ptr + first, &rb->buffer_ptr[0], length - first);
+
+    RB_PUBLISH(rb->read_index, read_index + length);
+
+    return length;
+}
+
+/**=============================================================================
+ * @brief           get a character from a ringbuffer
+ *
+ * @param[in]       rb  ringbuffer
+ * @param[out]      ch  字符
+ *
+ * @return          1 成功，0 缓冲为空
+ *============================================================================*/
+rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch)
+{
+    rt_uint32_t read_index;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = rb->read_index;
+    /* ringbuffer is empty */
+    if (read_index == rb->write_index)
+        return 0;
+
+    *ch = rb->buffer_ptr[read_index & rb->buffer_mask];
+    RB_PUBLISH(rb->read_index, read_index + 1);
+
+    return 1;
+}
+
+/**=============================================================================
+ * @brief           取得可直接读取的连续数据，不移动读索引
+ *
+ * @param[in]       rb  ringbuffer
+ * @param[out]      ptr 连续数据起始地址
+ *
+ * @return          连续数据长度，用完后用 rt_ringbuffer_skip 释放
+ *============================================================================*/
+rt_size_t rt_ringbuffer_peek(struct rt_ringbuffer *rb, rt_uint8_t **ptr)
+{
+    rt_uint32_t read_index, offset;
+    rt_size_t size, contiguous;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = rb->read_index;
+    size   = rb->write_index - read_index;
+    offset = read_index & rb->buffer_mask;
+    contiguous = rt_ringbuffer_get_size(rb) - offset;
+
+    *ptr = &rb->buffer_ptr[offset];
+
+    return contiguous < size ? contiguous : size;
+}
+
+/**=============================================================================
+ * @brief           丢弃 ringbuffer 头部的数据
+ *
+ * @param[in]       rb     ringbuffer
+ * @param[in]       length 丢弃的长度
+ *
+ * @return          实际丢弃的长度
+ *============================================================================*/
+rt_size_t rt_ringbuffer_skip(struct rt_ringbuffer *rb, rt_size_t length)
+{
+    rt_uint32_t read_index;
+    rt_size_t size;
+
+    RT_ASSERT(rb != RT_NULL);
+
+    read_index = rb->read_index;
+    size = rb->write_index - read_index;
+    if (length > size)
+        length = size;
+
+    RB_PUBLISH(rb->read_index, read_index + length);
+
+    return length;
+}
@@ -0,0 +1,67 @@
+/**
+  ******************************************************************************
+  * @file			ringbuffer.h
+  * @brief			ringbuffer header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RINGBUFFER_H_
+#define __RINGBUFFER_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported macros -----------------------------------------------------------*/
+#define rt_ringbuffer_get_size(rb)  ((rb)->buffer_mask + 1)
+#define rt_ringbuffer_data_len(rb)  ((rt_size_t)((rb)->write_index - (rb)->read_index))
+#define rt_ringbuffer_space_len(rb) (rt_ringbuffer_get_size(rb) - rt_ringbuffer_data_len(rb))
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 单生产者/单消费者环形缓冲
+ *
+ * read_index/write_index 为自由递增的 32 位计数，取模由 buffer_mask 完成，
+ * 因此缓冲大小必须是 2 的幂。write_index 只由生产者写，read_index 只由消费者
+ * 写，一方在线程、一方在中断中使用时无需关中断。
+ */
+struct rt_ringbuffer
+{
+    rt_uint8_t *buffer_ptr;
+
+    volatile rt_uint32_t read_index;
+    volatile rt_uint32_t write_index;
+
+    rt_uint32_t buffer_mask;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+void rt_ringbuffer_init(struct rt_ringbuffer *rb, rt_uint8_t *pool, rt_uint32_t size);
+void rt_ringbuffer_reset(struct rt_ringbuffer *rb);
+
+rt_size_t rt_ringbuffer_put(struct rt_ringbuffer *rb, const rt_uint8_t *ptr, rt_size_t length);
+rt_size_t rt_ringbuffer_putchar(struct rt_ringbuffer *rb, const rt_uint8_t ch);
+rt_size_t rt_ringbuffer_put_reserve(struct rt_ringbuffer *rb, rt_uint8_t **ptr);
+void      rt_ringbuffer_put_commit(struct rt_ringbuffer *rb, rt_size_t length);
+
+rt_size_t rt_ringbuffer_get(struct rt_ringbuffer *rb, rt_uint8_t *ptr, rt_size_t length);
+rt_size_t rt_ringbuffer_getchar(struct rt_ringbuffer *rb, rt_uint8_t *ch);
+rt_size_t rt_ringbuffer_peek(struct rt_ringbuffer *rb, rt_uint8_t **ptr);
+rt_size_t rt_ringbuffer_skip(struct rt_ringbuffer *rb, rt_size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __RINGBUFFER_H_ */
@@ -0,0 +1,750 @@
+/**
+  ******************************************************************************
+  * @file			spi_stream.c
+  * @brief			dma driven spi master with double-buffered streaming
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <dma_alloc.h>
+#include <spi_stream.h>
+
+/* Private constants ---------------------------------------------------------*/
+#define SPI_STREAM_MAX_FRAMES   0xFFFF                      /*!< CNDTR 为 16 位 */
+#define SPI_STREAM_TIMEOUT      (RT_TICK_PER_SECOND * 10)   /*!< 单段最慢约 7.5 秒 */
+#define SPI_STREAM_WAIT_LOOPS   100000                      /*!< 轮询标志的上限，远大于最慢 PCLK/256 时的一帧 */
+
+/* Private macro -------------------------------------------------------------*/
+#define SPI_STREAM_FLAGS(hdma, f)   ((f) << (hdma)->ChannelIndex)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static rt_uint16_t spi_stream_dummy;        /*!< 丢弃的接收数据 */
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           装载一段到收发两个通道，关中断或在中断中调用
+ *
+ * @param[in]       bus 总线
+ * @param[in]       tx  发送数据，为空时重复发送 bus->pattern
+ * @param[in]       rx  接收缓冲，为空时丢弃
+ * @param[in]       len 字节数
+ *
+ * @return          none
+ *============================================================================*/
+static void _spi_stream_dma_load(struct spi_stream_bus *bus, const void *tx, void *rx, rt_size_t len)
+{
+    DMA_Channel_TypeDef *ct = bus->hdma_tx.Instance;
+    DMA_Channel_TypeDef *cr = bus->hdma_rx.Instance;
+    rt_uint32_t frames = len / bus->width;
+
+    ct->CCR &= ~DMA_CCR_EN;
+    cr->CCR &= ~DMA_CCR_EN;
+    bus->hdma_tx.DmaBaseAddress->IFCR = SPI_STREAM_FLAGS(&bus->hdma_tx, DMA_FLAG_GL1);
+    bus->hdma_rx.DmaBaseAddress->IFCR = SPI_STREAM_FLAGS(&bus->hdma_rx, DMA_FLAG_GL1);
+
+    cr->CMAR  = rx ? (rt_uint32_t)(rt_ubase_t)rx : (rt_uint32_t)(rt_ubase_t)&spi_stream_dummy;
+    cr->CNDTR = frames;
+    MODIFY_REG(cr->CCR, DMA_CCR_MINC, rx ? DMA_CCR_MINC : 0);
+
+    ct->CMAR  = tx ? (rt_uint32_t)(rt_ubase_t)tx : (rt_uint32_t)(rt_ubase_t)&bus->pattern;
+    ct->CNDTR = frames;
+    MODIFY_REG(ct->CCR, DMA_CCR_MINC, tx ? DMA_CCR_MINC : 0);
+
+    /* 先使能接收，发送一开始 DR 就会有数据 */
+    cr->CCR |= DMA_CCR_EN;
+    ct->CCR |= DMA_CCR_EN;
+
+    bus->chunk = len;
+}
+
+/**=============================================================================
+ * @brief           装载当前传输的下一段，关中断或在中断中调用
+ *
+ * @param[in]       bus 总线
+ *
+ * @return          none
+ *============================================================================*/
+static void _spi_stream_dma_next(struct spi_stream_bus *bus)
+{
+    rt_size_t n = bus->remain;
+
+    if (n > SPI_STREAM_MAX_FRAMES * bus->width)
+        n = SPI_STREAM_MAX_FRAMES * bus->width;
+
+    _spi_stream_dma_load(bus, bus->tx, bus->rx, n);
+
+    if (bus->tx)
+        bus->tx += n;
+    if (bus->rx)
+        bus->rx += n;
+    bus->remain -= n;
+}
+
+/**=============================================================================
+ * @brief           停止两个通道并结束传输，关中断或在中断中调用
+ *
+ * @param[in]       bus    总线
+ * @param[in]       result 结果
+ *
+ * @return          none
+ *============================================================================*/
+static void _spi_stream_dma_stop(struct spi_stream_bus *bus, rt_err_t result)
+{
+    bus->hdma_tx.Instance->CCR &= ~DMA_CCR_EN;
+    bus->hdma_rx.Instance->CCR &= ~DMA_CCR_EN;
+    bus->hdma_tx.DmaBaseAddress->IFCR = SPI_STREAM_FLAGS(&bus->hdma_tx, DMA_FLAG_GL1);
+    bus->hdma_rx.DmaBaseAddress->IFCR = SPI_STREAM_FLAGS(&bus->hdma_rx, DMA_FLAG_GL1);
+
+    bus->result = result;
+    bus->idle   = 1;
+    rt_sem_release(&bus->done);
+}
+
+/**=============================================================================
+ * @brief           接收通道中断，接收完成即整段已移出
+ *
+ * @param[in]       arg 总线
+ *
+ * @return          RT_TRUE 已处理
+ *============================================================================*/
+static rt_bool_t _spi_stream_rx_irq(void *arg)
+{
+    struct spi_stream_bus *bus = (struct spi_stream_bus *)arg;
+    DMA_HandleTypeDef *hdma = &bus->hdma_rx;
+    rt_uint32_t isr = hdma->DmaBaseAddress->ISR;
+
+    if (isr & SPI_STREAM_FLAGS(hdma, DMA_FLAG_TE1))
+    {
+        _spi_stream_dma_stop(bus, -RT_EIO);
+        return RT_TRUE;
+    }
+    if (!(isr & SPI_STREAM_FLAGS(hdma, DMA_FLAG_TC1)))
+        return RT_TRUE;
+
+    hdma->DmaBaseAddress->IFCR = SPI_STREAM_FLAGS(hdma, DMA_FLAG_GL1);
+    bus->bytes += bus->chunk;
+
+    if (bus->streaming)
+    {
+        /* 另一个缓冲已填好就立刻接上，否则停下等填充 */
+        bus->len[bus->cur] = 0;
+        bus->cur ^= 1;
+        if (bus->len[bus->cur])
+            _spi_stream_dma_load(bus, bus->buf[bus->cur], RT_NULL, bus->len[bus->cur]);
+        else
+            bus->idle = 1;
+        rt_sem_release(&bus->done);
+    }
+    else if (bus->remain)
+    {
+        _spi_stream_dma_next(bus);
+    }
+    else
+    {
+        bus->result = RT_EOK;
+        rt_sem_release(&bus->done);
+    }
+
+    return RT_TRUE;
+}
+
+/**=============================================================================
+ * @brief           发送通道中断，只处理传输错误
+ *
+ * @param[in]       arg 总线
+ *
+ * @return          RT_TRUE 已处理
+ *============================================================================*/
+static rt_bool_t _spi_stream_tx_irq(void *arg)
+{
+    struct spi_stream_bus *bus = (struct spi_stream_bus *)arg;
+    DMA_HandleTypeDef *hdma = &bus->hdma_tx;
+
+    if (hdma->DmaBaseAddress->ISR & SPI_STREAM_FLAGS(hdma, DMA_FLAG_TE1))
+        _spi_stream_dma_stop(bus, -RT_EIO);
+    hdma->DmaBaseAddress->IFCR = SPI_STREAM_FLAGS(hdma, DMA_FLAG_GL1);
+
+    return RT_TRUE;
+}
+
+/**=============================================================================
+ * @brief           等待 SR 中的标志变为指定状态
+ *
+ * @param[in]       spi  SPI
+ * @param[in]       flag 标志
+ * @param[in]       set  RT_TRUE 等置位，RT_FALSE 等清零
+ *
+ * @return          RT_EOK 成功，-RT_ETIMEOUT 超时，SPI 时钟被关或配置错误时不会结束
+ *============================================================================*/
+static rt_err_t _spi_stream_wait(SPI_TypeDef *spi, rt_uint32_t flag, rt_bool_t set)
+{
+    rt_uint32_t loops = SPI_STREAM_WAIT_LOOPS;
+
+    while (((spi->SR & flag) ? RT_TRUE : RT_FALSE) != set)
+    {
+        if (--loops == 0)
+            return -RT_ETIMEOUT;
+    }
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           切换帧宽度
+ *
+ * @param[in]       bus   总线
+ * @param[in]       width 帧字节数 1/2
+ *
+ * @return          RT_EOK 成功，-RT_ETIMEOUT 等 BSY 超时，宽度不变
+ *============================================================================*/
+static rt_err_t _spi_stream_set_width(struct spi_stream_bus *bus, rt_uint8_t width)
+{
+    SPI_TypeDef *spi = bus->spi;
+    rt_uint32_t size = width == 2 ? DMA_CCR_PSIZE_0 | DMA_CCR_MSIZE_0 : 0;
+
+    if (bus->width == width)
+        return RT_EOK;
+
+    /* DFF 只能在 SPE 为 0 时修改，上一次传输已全部接收，只需等 BSY 清零 */
+    if (_spi_stream_wait(spi, SPI_SR_BSY, RT_FALSE) != RT_EOK)
+        return -RT_ETIMEOUT;
+    bus->width = width;
+    spi->CR1 &= ~SPI_CR1_SPE;
+    MODIFY_REG(spi->CR1, SPI_CR1_DFF, width == 2 ? SPI_CR1_DFF : 0);
+    spi->CR1 |= SPI_CR1_SPE;
+
+    MODIFY_REG(bus->hdma_tx.Instance->CCR, DMA_CCR_PSIZE | DMA_CCR_MSIZE, size);
+    MODIFY_REG(bus->hdma_rx.Instance->CCR, DMA_CCR_PSIZE | DMA_CCR_MSIZE, size);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           时钟切换前检查，关中断调用
+ *
+ * @param[in]       n 总线的通知
+ *
+ * @return          RT_TRUE 总线被占用，分频要到下次 take 才重算
+ *============================================================================*/
+static rt_bool_t _spi_stream_clk_busy(struct sysclk_notifier *n)
+{
+    struct spi_stream_bus *bus = n->user_data;
+
+    return bus->owner != RT_NULL;
+}
+
+/**=============================================================================
+ * @brief           轮询收发，直接读写寄存器，不像 HAL_SPI_TransmitReceive 每帧
+ *                  检查超时
+ *
+ * @param[in]       bus 总线
+ * @param[in]       tx  发送数据，为空时发送 bus->pattern
+ * @param[out]      rx  接收缓冲，可为空
+ * @param[in]       len 字节数，帧宽度的整数倍
+ *
+ * @return          RT_EOK 成功，-RT_ETIMEOUT TXE/RXNE 等不到
+ *============================================================================*/
+static rt_err_t _spi_stream_poll(struct spi_stream_bus *bus, const rt_uint8_t *tx,
+                             rt_uint8_t *rx, rt_size_t len)
+{
+    SPI_TypeDef *spi = bus->spi;
+    rt_uint8_t width = bus->width;
+    rt_uint16_t frame;
+
+    for (; len; len -= width)
+    {
+        if (tx == RT_NULL)
+            frame = bus->pattern;
+        else if (width == 2)
+            frame = *(const rt_uint16_t *)tx;
+        else
+            frame = *tx;
+
+        if (_spi_stream_wait(spi, SPI_SR_TXE, RT_TRUE) != RT_EOK)
+            return -RT_ETIMEOUT;
+        spi->DR = frame;
+        if (_spi_stream_wait(spi, SPI_SR_RXNE, RT_TRUE) != RT_EOK)
+            return -RT_ETIMEOUT;
+        frame = (rt_uint16_t)spi->DR;
+
+        if (rx)
+        {
+            if (width == 2)
+                *(rt_uint16_t *)rx = frame;
+            else
+                *rx = (rt_uint8_t)frame;
+            rx += width;
+        }
+        if (tx)
+            tx += width;
+    }
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           初始化总线：引脚、主机模式和收发 DMA 通道
+ *
+ * @param[in]       bus 总线
+ * @param[in]       spi SPI1(PA5~7)、SPI2(PB13~15) 或 SPI3(PB3~5，会关闭 JTAG
+ *                      只保留 SWD)
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 不支持的 SPI，-RT_EBUSY DMA 通道被占用
+ *============================================================================*/
+rt_err_t spi_stream_bus_init(struct spi_stream_bus *bus, SPI_TypeDef *spi)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+    GPIO_TypeDef *port;
+    rt_uint16_t sck_mosi, miso;
+    dma_request_t req_tx, req_rx;
+
+    RT_ASSERT(bus != RT_NULL);
+
+    if (spi == SPI1)
+    {
+        __HAL_RCC_SPI1_CLK_ENABLE();
+        __HAL_RCC_GPIOA_CLK_ENABLE();
+        port     = GPIOA;
+        sck_mosi = GPIO_PIN_5 | GPIO_PIN_7;
+        miso     = GPIO_PIN_6;
+        req_tx   = DMA_REQ_SPI1_TX;
+        req_rx   = DMA_REQ_SPI1_RX;
+    }
+    else if (spi == SPI2)
+    {
+        __HAL_RCC_SPI2_CLK_ENABLE();
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+        port     = GPIOB;
+        sck_mosi = GPIO_PIN_13 | GPIO_PIN_15;
+        miso     = GPIO_PIN_14;
+        req_tx   = DMA_REQ_SPI2_TX;
+        req_rx   = DMA_REQ_SPI2_RX;
+    }
+    else if (spi == SPI3)
+    {
+        __HAL_RCC_SPI3_CLK_ENABLE();
+        __HAL_RCC_GPIOB_CLK_ENABLE();
+        __HAL_RCC_AFIO_CLK_ENABLE();
+        __HAL_AFIO_REMAP_SWJ_NOJTAG();
+        port     = GPIOB;
+        sck_mosi = GPIO_PIN_3 | GPIO_PIN_5;
+        miso     = GPIO_PIN_4;
+        req_tx   = DMA_REQ_SPI3_TX;
+        req_rx   = DMA_REQ_SPI3_RX;
+    }
+    else
+    {
+        return -RT_EINVAL;
+    }
+
+    rt_memset(bus, 0, sizeof(*bus));
+    bus->spi   = spi;
+    bus->width = 1;
+
+    /* 接收优先级高于发送，否则 DR 来不及搬走会溢出 */
+    if (dma_alloc(&bus->hdma_rx, req_rx, DMA_CLASS_LATENCY) != RT_EOK)
+        return -RT_EBUSY;
+    if (dma_alloc(&bus->hdma_tx, req_tx, DMA_CLASS_STREAM) != RT_EOK)
+    {
+        dma_free(&bus->hdma_rx);
+        return -RT_EBUSY;
+    }
+
+    GPIO_InitStruct.Pin   = sck_mosi;
+    GPIO_InitStruct.Mode  = GPIO_MODE_AF_PP;
+    GPIO_InitStruct.Pull  = GPIO_NOPULL;
+    GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
+
+    GPIO_InitStruct.Pin   = miso;
+    GPIO_InitStruct.Mode  = GPIO_MODE_AF_INPUT;
+    HAL_GPIO_Init(port, &GPIO_InitStruct);
+
+    bus->hdma_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+    bus->hdma_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    bus->hdma_rx.Init.MemInc              = DMA_MINC_ENABLE;
+    bus->hdma_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    bus->hdma_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    bus->hdma_rx.Init.Mode                = DMA_NORMAL;
+    HAL_DMA_Init(&bus->hdma_rx);
+
+    bus->hdma_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    bus->hdma_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    bus->hdma_tx.Init.MemInc              = DMA_MINC_ENABLE;
+    bus->hdma_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    bus->hdma_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    bus->hdma_tx.Init.Mode                = DMA_NORMAL;
+    HAL_DMA_Init(&bus->hdma_tx);
+
+    /* 不经过 HAL_DMA_Start，外设地址和中断只设置一次，完成以接收通道为准 */
+    bus->hdma_rx.Instance->CPAR = (rt_uint32_t)(rt_ubase_t)&spi->DR;
+    bus->hdma_tx.Instance->CPAR = (rt_uint32_t)(rt_ubase_t)&spi->DR;
+    bus->hdma_rx.Instance->CCR |= DMA_CCR_TCIE | DMA_CCR_TEIE;
+    bus->hdma_tx.Instance->CCR |= DMA_CCR_TEIE;
+    dma_set_irq_hook(&bus->hdma_rx, _spi_stream_rx_irq, bus);
+    dma_set_irq_hook(&bus->hdma_tx, _spi_stream_tx_irq, bus);
+
+    rt_sem_init(&bus->lock, "spi", 1, RT_IPC_FLAG_FIFO);
+    rt_sem_init(&bus->done, "spidone", 0, RT_IPC_FLAG_FIFO);
+
+    spi->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | SPI_CR1_BR;
+    spi->CR1 |= SPI_CR1_SPE;
+
+    /* 空闲时允许切换时钟，take 时按新的 PCLK 重算分频 */
+    bus->clk.periph    = spi;
+    bus->clk.busy      = _spi_stream_clk_busy;
+    bus->clk.user_data = bus;
+    sysclk_register_notifier(&bus->clk);
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           初始化挂在总线上的设备，片选引脚配置为推挽输出并置高
+ *
+ * @param[in]       dev     设备
+ * @param[in]       bus     已初始化的总线
+ * @param[in]       cs_port 片选端口，为空时由调用者控制片选
+ * @param[in]       cs_pin  片选引脚
+ * @param[in]       mode    SPI 模式 0~3
+ * @param[in]       max_hz  最高时钟，按 PCLK 分频向下取整
+ *
+ * @return          none
+ *============================================================================*/
+void spi_stream_dev_init(struct spi_stream_dev *dev, struct spi_stream_bus *bus,
+                         GPIO_TypeDef *cs_port, rt_uint16_t cs_pin,
+                         rt_uint8_t mode, rt_uint32_t max_hz)
+{
+    GPIO_InitTypeDef GPIO_InitStruct = {0};
+
+    RT_ASSERT(dev != RT_NULL && bus != RT_NULL);
+
+    dev->bus     = bus;
+    dev->cs_port = cs_port;
+    dev->cs_pin  = cs_pin;
+    dev->mode    = mode & 3;
+    dev->max_hz  = max_hz;
+
+    if (cs_port)
+    {
+        /* F1 的 GPIOx 时钟位从 IOPAEN 起依次排列 */
+        SET_BIT(RCC->APB2ENR, RCC_APB2ENR_IOPAEN << (((rt_uint32_t)(rt_ubase_t)cs_port - GPIOA_BASE) / 0x400));
+        cs_port->BSRR = cs_pin;
+
+        GPIO_InitStruct.Pin   = cs_pin;
+        GPIO_InitStruct.Mode  = GPIO_MODE_OUTPUT_PP;
+        GPIO_InitStruct.Pull  = GPIO_NOPULL;
+        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_HIGH;
+        HAL_GPIO_Init(cs_port, &GPIO_InitStruct);
+    }
+}
+
+/**=============================================================================
+ * @brief           占用总线：按设备配置时钟和模式并拉低片选
+ *
+ * @param[in]       dev     设备
+ * @param[in]       timeout 等待总线的时间
+ *
+ * @return          RT_EOK 成功，-RT_ETIMEOUT 等总线或 BSY 超时
+ *
+ * @note            多个线程访问同一总线时按先后排队，拿到后可连续调用
+ *                  spi_stream_xfer/spi_stream_write，最后 spi_stream_release
+ *============================================================================*/
+rt_err_t spi_stream_take(struct spi_stream_dev *dev, rt_int32_t timeout)
+{
+    struct spi_stream_bus *bus = dev->bus;
+    SPI_TypeDef *spi = bus->spi;
+    rt_uint32_t pclk, br;
+
+    if (rt_sem_take(&bus->lock, timeout) != RT_EOK)
+        return -RT_ETIMEOUT;
+    bus->owner = dev;
+
+    /* 每次重新计算，系统时钟可能已被 sysclk_switch 切换 */
+    pclk = spi == SPI1 ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+    for (br = 0; br < 7 && (pclk >> (br + 1)) > dev->max_hz; br++)
+        ;
+
+    if (_spi_stream_wait(spi, SPI_SR_BSY, RT_FALSE) != RT_EOK)
+    {
+        bus->owner = RT_NULL;
+        rt_sem_release(&bus->lock);
+        return -RT_ETIMEOUT;
+    }
+    spi->CR1 &= ~SPI_CR1_SPE;
+    spi->CR1 = SPI_CR1_MSTR | SPI_CR1_SSM | SPI_CR1_SSI | (br << SPI_CR1_BR_Pos) |
+               (bus->width == 2 ? SPI_CR1_DFF : 0) | dev->mode;
+    spi->CR1 |= SPI_CR1_SPE;
+    /* 上次超时后才收完的帧留在 DR 中，丢掉，以免收发错位 */
+    (void)spi->DR;
+
+    if (dev->cs_port)
+        dev->cs_port->BSRR = (rt_uint32_t)dev->cs_pin << 16;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           释放总线，拉高片选
+ *
+ * @param[in]       dev 设备
+ *
+ * @return          RT_EOK 成功，-RT_ETIMEOUT 最后一帧没有发完，总线仍然释放
+ *============================================================================*/
+rt_err_t spi_stream_release(struct spi_stream_dev *dev)
+{
+    struct spi_stream_bus *bus = dev->bus;
+    rt_err_t err;
+
+    RT_ASSERT(bus->owner == dev);
+
+    err = _spi_stream_wait(bus->spi, SPI_SR_BSY, RT_FALSE);
+    if (dev->cs_port)
+        dev->cs_port->BSRR = dev->cs_pin;
+
+    bus->owner = RT_NULL;
+    rt_sem_release(&bus->lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           全双工收发，须先 spi_stream_take
+ *
+ * @param[in]       dev   设备
+ * @param[in]       tx    发送数据，为空时发送 0xFF
+ * @param[out]      rx    接收缓冲，为空时丢弃
+ * @param[in]       len   字节数
+ * @param[in]       flags SPI_STREAM_16BIT、SPI_STREAM_REPEAT
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 16 位帧时长度或地址未对齐，
+ *                  -RT_EIO DMA 错误，-RT_ETIMEOUT 超时
+ *
+ * @note            帧宽度自动选择：只发不收且为填充或空发（tx 为空）时字节
+ *                  顺序无关，长度为偶数就用 16 位帧，帧间空档减半
+ *============================================================================*/
+rt_err_t spi_stream_xfer(struct spi_stream_dev *dev, const void *tx, void *rx,
+                         rt_size_t len, rt_uint16_t flags)
+{
+    struct spi_stream_bus *bus = dev->bus;
+    rt_uint8_t width = 1;
+    rt_base_t level;
+    rt_err_t err;
+
+    RT_ASSERT(bus->owner == dev);
+
+    if (len == 0)
+        return RT_EOK;
+
+    if (flags & SPI_STREAM_16BIT)
+    {
+        if ((len | (rt_uint32_t)(rt_ubase_t)tx | (rt_uint32_t)(rt_ubase_t)rx) & 1)
+            return -RT_EINVAL;
+        width = 2;
+    }
+    else if (rx == RT_NULL && (tx == RT_NULL || (flags & SPI_STREAM_REPEAT)) && !(len & 1))
+    {
+        width = 2;
+    }
+
+    if (tx == RT_NULL)
+        bus->pattern = 0xFFFF;
+    else if (flags & SPI_STREAM_REPEAT)
+        bus->pattern = (flags & SPI_STREAM_16BIT) ? *(const rt_uint16_t *)tx :
+                       (rt_uint16_t)(*(const rt_uint8_t *)tx * 0x0101);
+    if (flags & SPI_STREAM_REPEAT)
+        tx = RT_NULL;
+
+    if (_spi_stream_set_width(bus, width) != RT_EOK)
+        return -RT_ETIMEOUT;
+
+    /* 短传输配置 DMA 不划算，调度器启动前也不能等信号量 */
+    if (len < SPI_STREAM_DMA_THRESHOLD || rt_thread_self() == RT_NULL)
+    {
+        err = _spi_stream_poll(bus, (const rt_uint8_t *)tx, (rt_uint8_t *)rx, len);
+        bus->poll_xfers++;
+        if (err == RT_EOK)
+            bus->bytes += len;
+        return err;
+    }
+
+    while (rt_sem_trytake(&bus->done) == RT_EOK)
+        ;
+    bus->tx        = (const rt_uint8_t *)tx;
+    bus->rx        = (rt_uint8_t *)rx;
+    bus->remain    = len;
+    bus->streaming = 0;
+    bus->result    = -RT_EBUSY;
+
+    level = rt_hw_interrupt_disable();
+    _spi_stream_dma_next(bus);
+    rt_hw_interrupt_enable(level);
+    bus->spi->CR2 |= SPI_CR2_RXDMAEN;
+    bus->spi->CR2 |= SPI_CR2_TXDMAEN;
+
+    err = rt_sem_take(&bus->done, SPI_STREAM_TIMEOUT);
+    if (err != RT_EOK)
+    {
+        level = rt_hw_interrupt_disable();
+        _spi_stream_dma_stop(bus, -RT_ETIMEOUT);
+        rt_hw_interrupt_enable(level);
+    }
+    bus->spi->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+    bus->dma_xfers++;
+
+    return bus->result;
+}
+
+/**=============================================================================
+ * @brief           双缓冲流式发送，一个缓冲在发送时调用 fill 填充另一个，
+ *                  须先 spi_stream_take
+ *
+ * @param[in]       dev   设备
+ * @param[in]       buf0  缓冲 0
+ * @param[in]       buf1  缓冲 1
+ * @param[in]       size  每个缓冲的字节数，不超过 65535 帧
+ * @param[in]       fill  填充回调，返回 0 结束
+ * @param[in]       arg   回调参数
+ * @param[in]       flags SPI_STREAM_16BIT
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 参数错误，-RT_EIO DMA 错误，
+ *                  -RT_ETIMEOUT 超时
+ *
+ * @note            缓冲在中断中直接改写 CMAR/CNDTR 衔接；填充赶不上时 DMA
+ *                  停下等待，计入 underruns，时钟暂停但数据不会错
+ *============================================================================*/
+rt_err_t spi_stream_write(struct spi_stream_dev *dev, void *buf0, void *buf1, rt_size_t size,
+                          spi_stream_fill_t fill, void *arg, rt_uint16_t flags)
+{
+    struct spi_stream_bus *bus = dev->bus;
+    rt_uint8_t width = (flags & SPI_STREAM_16BIT) ? 2 : 1;
+    rt_err_t err = RT_EOK;
+    rt_base_t level;
+    rt_size_t n;
+    rt_uint8_t i;
+
+    RT_ASSERT(bus->owner == dev);
+    RT_ASSERT(buf0 != RT_NULL && buf1 != RT_NULL && fill != RT_NULL);
+
+    if (size / width > SPI_STREAM_MAX_FRAMES || size < width ||
+        (width == 2 && ((size | (rt_uint32_t)(rt_ubase_t)buf0 | (rt_uint32_t)(rt_ubase_t)buf1) & 1)))
+        return -RT_EINVAL;
+
+    if (_spi_stream_set_width(bus, width) != RT_EOK)
+        return -RT_ETIMEOUT;
+
+    n = fill(buf0, size, arg) & ~(rt_size_t)(width - 1);
+    if (n == 0)
+        return RT_EOK;
+
+    /* 调度器启动前没有中断衔接，逐个缓冲轮询发送 */
+    if (rt_thread_self() == RT_NULL)
+    {
+        for (i = 0; n; i ^= 1)
+        {
+            err = _spi_stream_poll(bus, i ? buf1 : buf0, RT_NULL, n);
+            if (err != RT_EOK)
+                break;
+            bus->bytes += n;
+            n = fill(i ? buf0 : buf1, size, arg) & ~(rt_size_t)(width - 1);
+        }
+        bus->poll_xfers++;
+        return err;
+    }
+
+    while (rt_sem_trytake(&bus->done) == RT_EOK)
+        ;
+    bus->buf[0]    = buf0;
+    bus->buf[1]    = buf1;
+    bus->len[0]    = n;
+    bus->len[1]    = 0;
+    bus->cur       = 0;
+    bus->idle      = 0;
+    bus->streaming = 1;
+    bus->result    = RT_EOK;
+
+    level = rt_hw_interrupt_disable();
+    _spi_stream_dma_load(bus, buf0, RT_NULL, n);
+    rt_hw_interrupt_enable(level);
+    bus->spi->CR2 |= SPI_CR2_RXDMAEN;
+    bus->spi->CR2 |= SPI_CR2_TXDMAEN;
+
+    /**
+     * 第 k 次填充前已等到 k-1 次完成，缓冲按 0、1、0 ... 的顺序发完，
+     * 所以将要填充的缓冲一定已经空闲
+     */
+    for (i = 1; ; i ^= 1)
+    {
+        n = fill(bus->buf[i], size, arg) & ~(rt_size_t)(width - 1);
+
+        level = rt_hw_interrupt_disable();
+        if (bus->result != RT_EOK)
+        {
+            rt_hw_interrupt_enable(level);
+            break;
+        }
+        bus->len[i] = n;
+        if (n && bus->idle)
+        {
+            bus->idle = 0;
+            bus->cur  = i;
+            bus->underruns++;
+            _spi_stream_dma_load(bus, bus->buf[i], RT_NULL, n);
+        }
+        rt_hw_interrupt_enable(level);
+
+        /* 数据结束时还有一个缓冲在发送 */
+        if (rt_sem_take(&bus->done, SPI_STREAM_TIMEOUT) != RT_EOK)
+        {
+            err = -RT_ETIMEOUT;
+            break;
+        }
+        if (n == 0)
+            break;
+    }
+
+    level = rt_hw_interrupt_disable();
+    bus->streaming = 0;
+    if (err != RT_EOK)
+        _spi_stream_dma_stop(bus, err);
+    rt_hw_interrupt_enable(level);
+    bus->spi->CR2 &= ~(SPI_CR2_TXDMAEN | SPI_CR2_RXDMAEN);
+    bus->dma_xfers++;
+
+    return bus->result;
+}
+
+/**=============================================================================
+ * @brief           占用总线、收发一次后释放
+ *
+ * @param[in]       dev   设备
+ * @param[in]       tx    发送数据，可为空
+ * @param[out]      rx    接收缓冲，可为空
+ * @param[in]       len   字节数
+ * @param[in]       flags 同 spi_stream_xfer
+ *
+ * @return          同 spi_stream_xfer
+ *============================================================================*/
+rt_err_t spi_stream_transfer(struct spi_stream_dev *dev, const void *tx, void *rx,
+                             rt_size_t len, rt_uint16_t flags)
+{
+    rt_err_t err;
+
+    err = spi_stream_take(dev, RT_WAITING_FOREVER);
+    if (err != RT_EOK)
+        return err;
+    err = spi_stream_xfer(dev, tx, rx, len, flags);
+    if (spi_stream_release(dev) != RT_EOK && err == RT_EOK)
+        err = -RT_ETIMEOUT;
+
+    return err;
+}
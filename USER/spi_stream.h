@@ -0,0 +1,107 @@
+/**
+  ******************************************************************************
+  * @file			spi_stream.h
+  * @brief			dma driven spi master with double-buffered streaming
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SPI_STREAM_H_
+#define __SPI_STREAM_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <sysclk.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define SPI_STREAM_DMA_THRESHOLD    16          /*!< 少于该字节数用轮询收发 */
+
+/* 传输标志 */
+#define SPI_STREAM_16BIT            0x0001      /*!< 数据为半字（如 RGB565），用 16 位帧，长度须为偶数 */
+#define SPI_STREAM_REPEAT           0x0002      /*!< tx 只指向一帧，重复发送 len 字节，用于填充 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 双缓冲流式发送的填充回调，在调用线程中执行
+ *
+ * @return 写入 buf 的字节数，0 表示数据结束
+ */
+typedef rt_size_t (*spi_stream_fill_t)(void *buf, rt_size_t size, void *arg);
+
+struct spi_stream_dev;
+
+/**
+ * 一条 SPI 总线（主机），同一时刻只有一个设备占用，其余线程按先后排队
+ */
+struct spi_stream_bus
+{
+    SPI_TypeDef            *spi;
+    DMA_HandleTypeDef       hdma_tx;
+    DMA_HandleTypeDef       hdma_rx;
+    struct rt_semaphore     lock;
+    struct rt_semaphore     done;
+    struct spi_stream_dev  *owner;
+    struct sysclk_notifier  clk;
+
+    /* 内部使用，当前传输 */
+    const rt_uint8_t       *tx;
+    rt_uint8_t             *rx;
+    rt_size_t               remain;         /*!< 未装载的字节数 */
+    rt_size_t               chunk;          /*!< 当前段的字节数 */
+    rt_uint16_t             flags;
+    rt_uint16_t             pattern;        /*!< 填充时的 16 位帧 */
+    rt_uint8_t              width;          /*!< 帧字节数 1/2 */
+    volatile rt_uint8_t     streaming;
+    volatile rt_uint8_t     idle;           /*!< 流式发送时 DMA 已停下 */
+    rt_uint8_t              cur;            /*!< 流式发送时正在发送的缓冲 */
+    void                   *buf[2];
+    volatile rt_size_t      len[2];         /*!< 已填充待发送的字节数 */
+    volatile rt_err_t       result;
+
+    /* 统计 */
+    rt_uint32_t             dma_xfers;
+    rt_uint32_t             poll_xfers;
+    rt_uint32_t             underruns;      /*!< 流式发送时填充赶不上发送的次数 */
+    rt_uint32_t             bytes;
+};
+
+struct spi_stream_dev
+{
+    struct spi_stream_bus  *bus;
+    GPIO_TypeDef           *cs_port;        /*!< 低电平有效，为空时不控制片选 */
+    rt_uint16_t             cs_pin;
+    rt_uint8_t              mode;           /*!< 0~3，bit1 为 CPOL，bit0 为 CPHA */
+    rt_uint32_t             max_hz;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t spi_stream_bus_init(struct spi_stream_bus *bus, SPI_TypeDef *spi);
+void     spi_stream_dev_init(struct spi_stream_dev *dev, struct spi_stream_bus *bus,
+                             GPIO_TypeDef *cs_port, rt_uint16_t cs_pin,
+                             rt_uint8_t mode, rt_uint32_t max_hz);
+rt_err_t spi_stream_take(struct spi_stream_dev *dev, rt_int32_t timeout);
+rt_err_t spi_stream_release(struct spi_stream_dev *dev);
+rt_err_t spi_stream_xfer(struct spi_stream_dev *dev, const void *tx, void *rx,
+                         rt_size_t len, rt_uint16_t flags);
+rt_err_t spi_stream_write(struct spi_stream_dev *dev, void *buf0, void *buf1, rt_size_t size,
+                          spi_stream_fill_t fill, void *arg, rt_uint16_t flags);
+rt_err_t spi_stream_transfer(struct spi_stream_dev *dev, const void *tx, void *rx,
+                             rt_size_t len, rt_uint16_t flags);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __SPI_STREAM_H_ */
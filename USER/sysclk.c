@@ -0,0 +1,493 @@
+/**
+  ******************************************************************************
+  * @file			sysclk.c
+  * @brief			hse/pll clock bring-up and runtime clock profiles
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <timebase.h>
+#include <sysclk.h>
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#ifndef RT_SYSCLK_DEFAULT_PROFILE
+#define RT_SYSCLK_DEFAULT_PROFILE   SYSCLK_PROFILE_72MHZ
+#endif
+
+#define SYSCLK_TC_LOOPS     0x40000     /*!< 等待串口发完最后一帧，9600bps 下约 2ms */
+#define SYSCLK_HSE_WAIT_US  (HSE_STARTUP_TIMEOUT * 1000u)
+#define SYSCLK_PLL_WAIT_US  2000u
+#define SYSCLK_POLL_US      50u
+
+/* Private macro -------------------------------------------------------------*/
+#define SYSCLK_PERIPH_END   (sysclk_periphs + sizeof(sysclk_periphs) / sizeof(sysclk_periphs[0]))
+
+/* Private typedef -----------------------------------------------------------*/
+/**
+ * 时钟来自 PCLK 的外设，运行位置位时分频已按旧时钟算好
+ */
+struct sysclk_periph
+{
+    const char  *name;
+    rt_uint32_t  base;
+    rt_uint8_t   reg;                   /*!< 运行位所在寄存器的偏移 */
+    rt_uint8_t   apb2;                  /*!< 时钟使能在 APB2ENR */
+    rt_uint32_t  run;
+    rt_uint32_t  clk_en;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static const struct sysclk_profile sysclk_profiles[SYSCLK_PROFILE_NUM] =
+{
+    {"72MHz", 72000000, RCC_PLL_MUL9, FLASH_LATENCY_2, RCC_HCLK_DIV2},
+    {"48MHz", 48000000, RCC_PLL_MUL6, FLASH_LATENCY_1, RCC_HCLK_DIV2},
+    {"24MHz", 24000000, RCC_PLL_MUL3, FLASH_LATENCY_0, RCC_HCLK_DIV1},
+    {"8MHz",   8000000, 0,            FLASH_LATENCY_0, RCC_HCLK_DIV1},
+};
+
+static const struct sysclk_periph sysclk_periphs[] =
+{
+    {"TIM1",   TIM1_BASE,   0x00, 1, TIM_CR1_CEN,   RCC_APB2ENR_TIM1EN},
+    {"TIM2",   TIM2_BASE,   0x00, 0, TIM_CR1_CEN,   RCC_APB1ENR_TIM2EN},
+    {"TIM3",   TIM3_BASE,   0x00, 0, TIM_CR1_CEN,   RCC_APB1ENR_TIM3EN},
+    {"TIM4",   TIM4_BASE,   0x00, 0, TIM_CR1_CEN,   RCC_APB1ENR_TIM4EN},
+    {"TIM5",   TIM5_BASE,   0x00, 0, TIM_CR1_CEN,   RCC_APB1ENR_TIM5EN},
+    {"TIM6",   TIM6_BASE,   0x00, 0, TIM_CR1_CEN,   RCC_APB1ENR_TIM6EN},
+    {"TIM7",   TIM7_BASE,   0x00, 0, TIM_CR1_CEN,   RCC_APB1ENR_TIM7EN},
+    {"TIM8",   TIM8_BASE,   0x00, 1, TIM_CR1_CEN,   RCC_APB2ENR_TIM8EN},
+    {"SPI1",   SPI1_BASE,   0x00, 1, SPI_CR1_SPE,   RCC_APB2ENR_SPI1EN},
+    {"SPI2",   SPI2_BASE,   0x00, 0, SPI_CR1_SPE,   RCC_APB1ENR_SPI2EN},
+    {"SPI3",   SPI3_BASE,   0x00, 0, SPI_CR1_SPE,   RCC_APB1ENR_SPI3EN},
+    {"ADC1",   ADC1_BASE,   0x08, 1, ADC_CR2_ADON,  RCC_APB2ENR_ADC1EN},
+    {"ADC2",   ADC2_BASE,   0x08, 1, ADC_CR2_ADON,  RCC_APB2ENR_ADC2EN},
+    {"ADC3",   ADC3_BASE,   0x08, 1, ADC_CR2_ADON,  RCC_APB2ENR_ADC3EN},
+    {"I2C1",   I2C1_BASE,   0x00, 0, I2C_CR1_PE,    RCC_APB1ENR_I2C1EN},
+    {"I2C2",   I2C2_BASE,   0x00, 0, I2C_CR1_PE,    RCC_APB1ENR_I2C2EN},
+    {"USART1", USART1_BASE, 0x0C, 1, USART_CR1_UE,  RCC_APB2ENR_USART1EN},
+    {"USART2", USART2_BASE, 0x0C, 0, USART_CR1_UE,  RCC_APB1ENR_USART2EN},
+    {"USART3", USART3_BASE, 0x0C, 0, USART_CR1_UE,  RCC_APB1ENR_USART3EN},
+    {"UART4",  UART4_BASE,  0x0C, 0, USART_CR1_UE,  RCC_APB1ENR_UART4EN},
+    {"UART5",  UART5_BASE,  0x0C, 0, USART_CR1_UE,  RCC_APB1ENR_UART5EN},
+};
+
+static UART_HandleTypeDef     *sysclk_uarts[SYSCLK_MAX_UARTS];
+static rt_uint32_t             sysclk_uart_dmat[SYSCLK_MAX_UARTS];
+static struct sysclk_notifier *sysclk_notifiers[SYSCLK_MAX_NOTIFIERS];
+static sysclk_profile_t        sysclk_current = SYSCLK_PROFILE_NUM;  /*!< 未初始化时为 HSI */
+static const char             *sysclk_busy_name;                     /*!< 最近一次拒绝切换的外设 */
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           开中断等待 RCC 就绪位
+ *
+ * @param[in]       flag       RCC_FLAG_HSERDY/RCC_FLAG_PLLRDY
+ * @param[in]       set        等待置位还是清零
+ * @param[in]       timeout_us 最长等待时间
+ *
+ * @return          RT_EOK 成功，-RT_EIO 超时
+ *
+ * @note            按 SysTick 计数限时，不依赖 HAL_GetTick，上电时关中断
+ *                  调用也能按时返回
+ *============================================================================*/
+static rt_err_t _sysclk_wait_flag(rt_uint32_t flag, rt_bool_t set, rt_uint32_t timeout_us)
+{
+    rt_uint32_t step;
+
+    for (;;)
+    {
+        if ((__HAL_RCC_GET_FLAG(flag) != RESET) == (set != RT_FALSE))
+            return RT_EOK;
+        if (timeout_us == 0)
+            return -RT_EIO;
+
+        step = timeout_us < SYSCLK_POLL_US ? timeout_us : SYSCLK_POLL_US;
+        timebase_delay_us(step);
+        timeout_us -= step;
+    }
+}
+
+/**=============================================================================
+ * @brief           查找正在运行、分频按旧时钟算好的外设，关中断调用
+ *
+ * @param[in]       none
+ *
+ * @return          外设名，都空闲时为 RT_NULL
+ *
+ * @note            已登记的串口切换后重算波特率；已登记通知的外设由其
+ *                  busy 回调决定
+ *============================================================================*/
+static const char *_sysclk_busy(void)
+{
+    const struct sysclk_periph *p;
+    struct sysclk_notifier *n;
+    rt_uint32_t i, enr;
+    rt_bool_t handled;
+
+    for (i = 0; i < SYSCLK_MAX_NOTIFIERS && sysclk_notifiers[i]; i++)
+    {
+        n = sysclk_notifiers[i];
+        if (n->busy && n->busy(n))
+        {
+            for (p = sysclk_periphs; p < SYSCLK_PERIPH_END; p++)
+            {
+                if (p->base == (rt_uint32_t)(rt_ubase_t)n->periph)
+                    return p->name;
+            }
+            return "notifier";
+        }
+    }
+
+    for (p = sysclk_periphs; p < SYSCLK_PERIPH_END; p++)
+    {
+        enr = p->apb2 ? RCC->APB2ENR : RCC->APB1ENR;
+        if ((enr & p->clk_en) == 0 || (*(volatile rt_uint32_t *)(rt_ubase_t)(p->base + p->reg) & p->run) == 0)
+            continue;
+
+        handled = RT_FALSE;
+        for (i = 0; i < SYSCLK_MAX_UARTS && sysclk_uarts[i]; i++)
+        {
+            if ((rt_uint32_t)(rt_ubase_t)sysclk_uarts[i]->Instance == p->base)
+                handled = RT_TRUE;
+        }
+        for (i = 0; i < SYSCLK_MAX_NOTIFIERS && sysclk_notifiers[i]; i++)
+        {
+            if ((rt_uint32_t)(rt_ubase_t)sysclk_notifiers[i]->periph == p->base)
+                handled = RT_TRUE;
+        }
+        if (!handled)
+            return p->name;
+    }
+
+    return RT_NULL;
+}
+
+/**=============================================================================
+ * @brief           暂停已登记串口的 DMA 发送，等最后一帧发完
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void _sysclk_uart_quiesce(void)
+{
+    USART_TypeDef *uart;
+    rt_uint32_t i, loops;
+
+    for (i = 0; i < SYSCLK_MAX_UARTS && sysclk_uarts[i]; i++)
+    {
+        uart = sysclk_uarts[i]->Instance;
+
+        sysclk_uart_dmat[i] = uart->CR3 & USART_CR3_DMAT;
+        uart->CR3 &= ~USART_CR3_DMAT;
+
+        if ((uart->CR1 & USART_CR1_TE) == 0)
+            continue;
+        for (loops = SYSCLK_TC_LOOPS; (uart->SR & USART_SR_TC) == 0 && loops; loops--)
+            ;
+    }
+}
+
+/**=============================================================================
+ * @brief           按新的 PCLK 重算已登记串口的 BRR，并恢复 DMA 发送
+ *
+ * @param[in]       none
+ *
+ * @return          none
+ *============================================================================*/
+static void _sysclk_uart_resume(void)
+{
+    UART_HandleTypeDef *huart;
+    rt_uint32_t i, pclk;
+
+    for (i = 0; i < SYSCLK_MAX_UARTS && sysclk_uarts[i]; i++)
+    {
+        huart = sysclk_uarts[i];
+
+        pclk = (huart->Instance == USART1) ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq();
+        huart->Instance->BRR = UART_BRR_SAMPLING16(pclk, huart->Init.BaudRate);
+
+        huart->Instance->CR3 |= sysclk_uart_dmat[i];
+    }
+}
+
+/**=============================================================================
+ * @brief           切换系统时钟源，关中断完成，时钟源必须已经就绪
+ *
+ * @param[in]       source   RCC_SYSCLKSOURCE_HSE/RCC_SYSCLKSOURCE_PLLCLK
+ * @param[in]       latency  FLASH_LATENCY_x
+ * @param[in]       apb1_div RCC_HCLK_DIVx
+ *
+ * @return          RT_EOK 成功，-RT_EBUSY 有外设正在使用旧时钟，-RT_EIO 失败
+ *
+ * @note            flash 等待周期的增减顺序由 HAL_RCC_ClockConfig 保证，它
+ *                  最后还会调用 HAL_InitTick 按新频率重算 SysTick 重装值
+ *============================================================================*/
+static rt_err_t _sysclk_select(rt_uint32_t source, rt_uint32_t latency, rt_uint32_t apb1_div)
+{
+    RCC_ClkInitTypeDef clk;
+    rt_base_t level;
+    rt_uint32_t i;
+    rt_err_t err = RT_EOK;
+
+    clk.ClockType      = RCC_CLOCKTYPE_SYSCLK | RCC_CLOCKTYPE_HCLK |
+                         RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource   = source;
+    clk.AHBCLKDivider  = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = apb1_div;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+
+    level = rt_hw_interrupt_disable();
+
+    sysclk_busy_name = _sysclk_busy();
+    if (sysclk_busy_name == RT_NULL)
+    {
+        _sysclk_uart_quiesce();
+        if (HAL_RCC_ClockConfig(&clk, latency) != HAL_OK)
+            err = -RT_EIO;
+        /* 失败时也按实际频率更新 */
+        SystemCoreClockUpdate();
+        HAL_InitTick(uwTickPrio);
+        _sysclk_uart_resume();
+
+        for (i = 0; i < SYSCLK_MAX_NOTIFIERS && sysclk_notifiers[i]; i++)
+        {
+            if (sysclk_notifiers[i]->changed)
+                sysclk_notifiers[i]->changed(sysclk_notifiers[i]);
+        }
+    }
+    else
+    {
+        err = -RT_EBUSY;
+    }
+
+    rt_hw_interrupt_enable(level);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           上电时切到默认时钟配置，在 HAL_Init 之后调用
+ *
+ * @param[in]       none
+ *
+ * @return          RT_EOK 成功，失败时保持 HSI 8MHz
+ *============================================================================*/
+rt_err_t sysclk_init(void)
+{
+    return sysclk_switch((sysclk_profile_t)RT_SYSCLK_DEFAULT_PROFILE);
+}
+
+/**=============================================================================
+ * @brief           运行时切换时钟配置
+ *
+ * @param[in]       profile 目标配置
+ *
+ * @return          RT_EOK 成功，-RT_EBUSY 有外设正在使用旧时钟，
+ *                  -RT_EIO HSE 或 PLL 未就绪
+ *
+ * @note            HSE 起振和 PLL 锁定在开中断时等待，只有切换时钟源的几个
+ *                  寄存器操作关中断。SysTick 重装值和已登记串口的波特率随之
+ *                  更新；其他时钟来自 PCLK 的外设（TIM/SPI/ADC/I2C/USART）
+ *                  运行时拒绝切换，驱动可用 sysclk_register_notifier 自行处理。
+ *                  PLL 是系统时钟时不能改倍频，需要先切到 HSE，之后失败会
+ *                  停在 HSE 8MHz 上
+ *============================================================================*/
+rt_err_t sysclk_switch(sysclk_profile_t profile)
+{
+    const struct sysclk_profile *p;
+    rt_err_t err;
+
+    if ((rt_uint32_t)profile >= SYSCLK_PROFILE_NUM)
+        return -RT_EINVAL;
+    if (profile == sysclk_current)
+        return RT_EOK;
+    p = &sysclk_profiles[profile];
+
+    if (__HAL_RCC_GET_FLAG(RCC_FLAG_HSERDY) == RESET)
+    {
+        __HAL_RCC_HSE_CONFIG(RCC_HSE_ON);
+        if (_sysclk_wait_flag(RCC_FLAG_HSERDY, RT_TRUE, SYSCLK_HSE_WAIT_US) != RT_EOK)
+        {
+            __HAL_RCC_HSE_CONFIG(RCC_HSE_OFF);
+            return -RT_EIO;
+        }
+    }
+
+    if (__HAL_RCC_GET_SYSCLK_SOURCE() == RCC_SYSCLKSOURCE_STATUS_PLLCLK ||
+        (p->pll_mul == 0 && __HAL_RCC_GET_SYSCLK_SOURCE() != RCC_SYSCLKSOURCE_STATUS_HSE))
+    {
+        err = _sysclk_select(RCC_SYSCLKSOURCE_HSE, FLASH_LATENCY_0, RCC_HCLK_DIV1);
+        if (err != RT_EOK)
+            return err;
+        sysclk_current = SYSCLK_PROFILE_8MHZ;
+    }
+
+    __HAL_RCC_PLL_DISABLE();
+    if (p->pll_mul == 0)
+    {
+        sysclk_current = profile;
+        return RT_EOK;
+    }
+
+    if (_sysclk_wait_flag(RCC_FLAG_PLLRDY, RT_FALSE, SYSCLK_PLL_WAIT_US) != RT_EOK)
+        return -RT_EIO;
+    __HAL_RCC_PLL_CONFIG(RCC_PLLSOURCE_HSE, p->pll_mul);
+    __HAL_RCC_PLL_ENABLE();
+    if (_sysclk_wait_flag(RCC_FLAG_PLLRDY, RT_TRUE, SYSCLK_PLL_WAIT_US) != RT_EOK)
+    {
+        __HAL_RCC_PLL_DISABLE();
+        return -RT_EIO;
+    }
+
+    err = _sysclk_select(RCC_SYSCLKSOURCE_PLLCLK, p->latency, p->apb1_div);
+    if (err == RT_EOK)
+        sysclk_current = profile;
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           当前时钟配置
+ *
+ * @param[in]       none
+ *
+ * @return          配置编号，尚未切换过时为 SYSCLK_PROFILE_NUM
+ *============================================================================*/
+sysclk_profile_t sysclk_get_profile(void)
+{
+    return sysclk_current;
+}
+
+/**=============================================================================
+ * @brief           时钟配置的参数
+ *
+ * @param[in]       profile 配置编号
+ *
+ * @return          配置参数，编号非法时为 RT_NULL
+ *============================================================================*/
+const struct sysclk_profile *sysclk_get_profile_info(sysclk_profile_t profile)
+{
+    if ((rt_uint32_t)profile >= SYSCLK_PROFILE_NUM)
+        return RT_NULL;
+
+    return &sysclk_profiles[profile];
+}
+
+/**=============================================================================
+ * @brief           登记一个串口，切换时钟后自动重算波特率
+ *
+ * @param[in]       huart 已初始化的串口
+ *
+ * @return          RT_EOK 成功，-RT_EFULL 登记已满
+ *============================================================================*/
+rt_err_t sysclk_register_uart(UART_HandleTypeDef *huart)
+{
+    rt_base_t level;
+    rt_uint32_t i;
+    rt_err_t err = -RT_EFULL;
+
+    RT_ASSERT(huart != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    for (i = 0; i < SYSCLK_MAX_UARTS; i++)
+    {
+        if (sysclk_uarts[i] == huart || sysclk_uarts[i] == RT_NULL)
+        {
+            sysclk_uarts[i] = huart;
+            err = RT_EOK;
+            break;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           登记外设的时钟切换通知
+ *
+ * @param[in]       n 通知，登记后不能释放
+ *
+ * @return          RT_EOK 成功，-RT_EFULL 登记已满
+ *============================================================================*/
+rt_err_t sysclk_register_notifier(struct sysclk_notifier *n)
+{
+    rt_base_t level;
+    rt_uint32_t i;
+    rt_err_t err = -RT_EFULL;
+
+    RT_ASSERT(n != RT_NULL);
+
+    level = rt_hw_interrupt_disable();
+    for (i = 0; i < SYSCLK_MAX_NOTIFIERS; i++)
+    {
+        if (sysclk_notifiers[i] == n || sysclk_notifiers[i] == RT_NULL)
+        {
+            sysclk_notifiers[i] = n;
+            err = RT_EOK;
+            break;
+        }
+    }
+    rt_hw_interrupt_enable(level);
+
+    return err;
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           查看或切换时钟配置
+ *
+ * @param[in]       argc 参数个数
+ * @param[in]       argv clk [72MHz|48MHz|24MHz|8MHz]
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int clk(int argc, char **argv)
+{
+    rt_uint32_t i;
+    rt_err_t err;
+
+    if (argc < 2)
+    {
+        rt_kprintf("SYSCLK %d Hz, HCLK %d Hz, PCLK1 %d Hz, PCLK2 %d Hz\n",
+                   HAL_RCC_GetSysClockFreq(), HAL_RCC_GetHCLKFreq(),
+                   HAL_RCC_GetPCLK1Freq(), HAL_RCC_GetPCLK2Freq());
+        for (i = 0; i < SYSCLK_PROFILE_NUM; i++)
+            rt_kprintf("%c %s\n", i == (rt_uint32_t)sysclk_current ? '*' : ' ', sysclk_profiles[i].name);
+        return 0;
+    }
+
+    for (i = 0; i < SYSCLK_PROFILE_NUM; i++)
+    {
+        if (rt_strncmp(argv[1], sysclk_profiles[i].name, RT_NAME_MAX) == 0)
+            break;
+    }
+    if (i == SYSCLK_PROFILE_NUM)
+    {
+        rt_kprintf("unknown profile %s\n", argv[1]);
+        return -RT_EINVAL;
+    }
+
+    err = sysclk_switch((sysclk_profile_t)i);
+    if (err == -RT_EBUSY)
+        rt_kprintf("switch to %s refused: %s is running\n", sysclk_profiles[i].name, sysclk_busy_name);
+    else if (err != RT_EOK)
+        rt_kprintf("switch to %s failed: %d\n", sysclk_profiles[i].name, err);
+
+    return err;
+}
+MSH_CMD_EXPORT(clk, show or switch system clock profile);
+#endif
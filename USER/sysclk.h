@@ -0,0 +1,74 @@
+/**
+  ******************************************************************************
+  * @file			sysclk.h
+  * @brief			system clock manager header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SYSCLK_H_
+#define __SYSCLK_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define SYSCLK_MAX_UARTS    4           /*!< 切换时钟时需要重算波特率的串口个数 */
+#define SYSCLK_MAX_NOTIFIERS 6          /*!< 自行处理时钟变化的外设个数 */
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+typedef enum
+{
+    SYSCLK_PROFILE_72MHZ = 0,           /*!< HSE x9，满速 */
+    SYSCLK_PROFILE_48MHZ,               /*!< HSE x6，USB 可用 */
+    SYSCLK_PROFILE_24MHZ,               /*!< HSE x3，flash 零等待 */
+    SYSCLK_PROFILE_8MHZ,                /*!< HSE 直接作系统时钟，PLL 关闭 */
+    SYSCLK_PROFILE_NUM
+} sysclk_profile_t;
+
+struct sysclk_profile
+{
+    const char  *name;
+    rt_uint32_t  hclk;
+    rt_uint32_t  pll_mul;               /*!< RCC_PLL_MULx，0 表示不用 PLL */
+    rt_uint32_t  latency;               /*!< FLASH_LATENCY_x */
+    rt_uint32_t  apb1_div;              /*!< PCLK1 不超过 36MHz */
+};
+
+/**
+ * 外设的时钟切换通知。没有登记的 TIM/SPI/ADC/I2C/USART 在使能时拒绝切换；
+ * 登记后改由回调决定，两个回调都在关中断时调用，不能阻塞
+ */
+struct sysclk_notifier
+{
+    void               *periph;         /*!< 外设寄存器基址 */
+    rt_bool_t         (*busy)(struct sysclk_notifier *n);      /*!< 正在传输时返回 RT_TRUE，可为空 */
+    void              (*changed)(struct sysclk_notifier *n);   /*!< 新时钟生效后重算分频，可为空 */
+    void               *user_data;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t                     sysclk_init(void);
+rt_err_t                     sysclk_switch(sysclk_profile_t profile);
+sysclk_profile_t             sysclk_get_profile(void);
+const struct sysclk_profile *sysclk_get_profile_info(sysclk_profile_t profile);
+rt_err_t                     sysclk_register_uart(UART_HandleTypeDef *huart);
+rt_err_t                     sysclk_register_notifier(struct sysclk_notifier *n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __SYSCLK_H_ */
@@ -0,0 +1,168 @@
+/**
+  ******************************************************************************
+  * @file			timebase.c
+  * @brief			hal timebase on top of the rt-thread tick
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <timebase.h>
+
+/* Private constants ---------------------------------------------------------*/
+#if (1000 % RT_TICK_PER_SECOND) != 0
+#error "RT_TICK_PER_SECOND must divide 1000"
+#endif
+
+#define TB_MS_PER_TICK      (1000u / RT_TICK_PER_SECOND)
+#define TB_US_PER_TICK      (1000000u / RT_TICK_PER_SECOND)
+
+/* Private macro -------------------------------------------------------------*/
+/* SysTick 是最低优先级，关中断或在任意中断中它都得不到执行 */
+#define TB_TICK_BLOCKED()   (__get_PRIMASK() != 0 || __get_IPSR() != 0)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           按 SystemCoreClock 配置 SysTick，HAL_Init 和
+ *                  HAL_RCC_ClockConfig 会调用
+ *
+ * @param[in]       TickPriority HAL 要求的优先级，仅记录
+ *
+ * @return          HAL_OK 成功
+ *
+ * @note            SysTick 驱动 RT-Thread 调度，节拍为 RT_TICK_PER_SECOND，
+ *                  优先级固定为最低
+ *============================================================================*/
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority)
+{
+    rt_uint32_t reload = SystemCoreClock / RT_TICK_PER_SECOND;
+
+    if (reload == 0 || reload - 1 > SysTick_LOAD_RELOAD_Msk)
+        return HAL_ERROR;
+
+    SysTick->LOAD = reload - 1;
+    SysTick->VAL  = 0;
+    NVIC_SetPriority(SysTick_IRQn, (1UL << __NVIC_PRIO_BITS) - 1UL);
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk | SysTick_CTRL_ENABLE_Msk;
+
+    uwTickPrio = TickPriority;
+
+    return HAL_OK;
+}
+
+/**=============================================================================
+ * @brief           HAL 毫秒计数，由 rt_tick 换算
+ *
+ * @param[in]       none
+ *
+ * @return          毫秒计数，32 位回绕
+ *
+ * @note            rt_tick 与 SysTick 挂起位一起取快照：已经重装但中断还没
+ *                  处理的那个节拍算进去，最多一个，不另外累计。SysTick 中断
+ *                  得不到执行时（关中断、中断服务中）计数最多前进一个节拍，
+ *                  这种上下文中的等待要用 timebase_delay_us 限定时长
+ *============================================================================*/
+uint32_t HAL_GetTick(void)
+{
+    rt_tick_t tick;
+    rt_uint32_t pending;
+
+    do
+    {
+        tick    = rt_tick_get();
+        pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+    } while (tick != rt_tick_get());
+
+    if (pending)
+        tick++;
+
+    return (uint32_t)tick * TB_MS_PER_TICK;
+}
+
+/**=============================================================================
+ * @brief           HAL 延时，线程上下文中让出 CPU
+ *
+ * @param[in]       Delay 毫秒
+ *
+ * @return          none
+ *============================================================================*/
+void HAL_Delay(uint32_t Delay)
+{
+    rt_uint64_t ticks;
+
+    if (rt_thread_self() != RT_NULL && !TB_TICK_BLOCKED())
+    {
+        /* 多睡一个节拍，保证至少 Delay 毫秒 */
+        ticks = ((rt_uint64_t)Delay * RT_TICK_PER_SECOND + 999u) / 1000u + 1u;
+        if (ticks > RT_TICK_MAX / 2)
+            ticks = RT_TICK_MAX / 2;
+        rt_thread_delay((rt_tick_t)ticks);
+        return;
+    }
+
+    /* 节拍不前进，直接按 SysTick 计数忙等 */
+    while (Delay--)
+        timebase_delay_us(1000u);
+}
+
+/**=============================================================================
+ * @brief           微秒时间戳，由 rt_tick 和 SysTick 当前计数合成
+ *
+ * @param[in]       none
+ *
+ * @return          上电以来的微秒数
+ *============================================================================*/
+rt_uint64_t timebase_get_us(void)
+{
+    rt_uint32_t tick, val, load, pending;
+
+    do
+    {
+        tick    = rt_tick_get();
+        load    = SysTick->LOAD + 1;
+        val     = SysTick->VAL;
+        pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+
+        /* 已经重装但中断还没处理，重新读数并算到下一个节拍 */
+        if (pending)
+            val = SysTick->VAL;
+    } while (tick != rt_tick_get());
+
+    if (pending)
+        tick++;
+
+    return (rt_uint64_t)tick * TB_US_PER_TICK
+         + (rt_uint64_t)(load - 1 - val) * TB_US_PER_TICK / load;
+}
+
+/**=============================================================================
+ * @brief           忙等延时，可在中断和关中断时使用
+ *
+ * @param[in]       us 微秒
+ *
+ * @return          none
+ *============================================================================*/
+void timebase_delay_us(rt_uint32_t us)
+{
+    rt_uint32_t cycles_per_us = SystemCoreClock / 1000000u;
+    rt_uint32_t last, now;
+    rt_uint64_t elapsed = 0, target = (rt_uint64_t)us * cycles_per_us;
+
+    /* 直接累计 SysTick 递减量，不依赖中断 */
+    last = SysTick->VAL;
+    while (elapsed < target)
+    {
+        now = SysTick->VAL;
+        elapsed += (now <= last) ? last - now : last + SysTick->LOAD + 1 - now;
+        last = now;
+    }
+}
@@ -0,0 +1,36 @@
+/**
+  ******************************************************************************
+  * @file			timebase.h
+  * @brief			hal timebase header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TIMEBASE_H_
+#define __TIMEBASE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_uint64_t timebase_get_us(void);
+void        timebase_delay_us(rt_uint32_t us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __TIMEBASE_H_ */
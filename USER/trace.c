@@ -0,0 +1,221 @@
+/**
+  ******************************************************************************
+  * @file			trace.c
+  * @brief			binary event trace over itm/swo with a ram ring fallback
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <rthw.h>
+#include <trace.h>
+
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+#ifdef RT_USING_TRACE
+
+/* Private constants ---------------------------------------------------------*/
+#if (RT_TRACE_RING_SIZE & (RT_TRACE_RING_SIZE - 1)) != 0
+#error "RT_TRACE_RING_SIZE must be a power of two"
+#endif
+
+#define TRACE_ITM_SPIN      64          /*!< ITM FIFO 满时最多轮询次数，超过即丢弃 */
+
+/* Private macro -------------------------------------------------------------*/
+/* 调试器打开 ITM 并使能了两个通道才认为 SWO 已连接 */
+#define TRACE_ITM_PORTS     ((1UL << RT_TRACE_ITM_PORT) | (1UL << TRACE_ITM_PORT_DATA))
+#define TRACE_ITM_READY()   ((CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) &&      \
+                             (ITM->TCR & ITM_TCR_ITMENA_Msk) &&                     \
+                             (ITM->TER & TRACE_ITM_PORTS) == TRACE_ITM_PORTS)
+
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+static struct trace_record trace_ring[RT_TRACE_RING_SIZE];
+static rt_uint32_t         trace_head;      /*!< 写入计数 */
+static rt_uint32_t         trace_tail;      /*!< 读出计数 */
+static rt_uint32_t         trace_lost;
+static rt_uint8_t          trace_seq;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           向 ITM 通道写一个字，FIFO 长时间满则放弃
+ *
+ * @param[in]       port 通道
+ * @param[in]       word 数据
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _trace_itm_put(rt_uint32_t port, rt_uint32_t word)
+{
+    rt_uint32_t spin = TRACE_ITM_SPIN;
+
+    while (ITM->PORT[port].u32 == 0UL)
+    {
+        if (--spin == 0)
+            return -RT_EFULL;
+    }
+    ITM->PORT[port].u32 = word;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           打开 DWT 周期计数器作为时间戳
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+int trace_init(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    TRACE1(TRACE_ID_BOOT, SystemCoreClock);
+
+    return 0;
+}
+INIT_BOARD_EXPORT(trace_init);
+
+/**=============================================================================
+ * @brief           记录一个事件，任意上下文可调用
+ *
+ * @param[in]       id    事件 ID
+ * @param[in]       nargs 有效参数个数
+ * @param[in]       a0~a3 参数
+ *
+ * @return          none
+ *
+ * @note            SWO 已连接时写 ITM，否则写入 RAM 环形缓冲（满时覆盖最旧
+ *                  的记录）。ITM FIFO 持续满时丢弃事件的剩余部分并计数，
+ *                  不会长时间阻塞
+ *============================================================================*/
+void trace_event(rt_uint16_t id, rt_uint32_t nargs,
+                 rt_uint32_t a0, rt_uint32_t a1, rt_uint32_t a2, rt_uint32_t a3)
+{
+    struct trace_record *rec;
+    rt_uint32_t hdr, ts;
+    rt_base_t level;
+
+    if (nargs > TRACE_ARGS_MAX)
+        nargs = TRACE_ARGS_MAX;
+
+    level = rt_hw_interrupt_disable();
+    hdr = TRACE_HDR(id, nargs, trace_seq++);
+    ts = DWT->CYCCNT;
+
+    if (TRACE_ITM_READY())
+    {
+        /* 失败后剩余部分丢弃，上位机按首字所在的通道和字数识别截断的事件 */
+        if (_trace_itm_put(RT_TRACE_ITM_PORT, hdr) != RT_EOK ||
+            _trace_itm_put(TRACE_ITM_PORT_DATA, ts) != RT_EOK ||
+            (nargs > 0 && _trace_itm_put(TRACE_ITM_PORT_DATA, a0) != RT_EOK) ||
+            (nargs > 1 && _trace_itm_put(TRACE_ITM_PORT_DATA, a1) != RT_EOK) ||
+            (nargs > 2 && _trace_itm_put(TRACE_ITM_PORT_DATA, a2) != RT_EOK) ||
+            (nargs > 3 && _trace_itm_put(TRACE_ITM_PORT_DATA, a3) != RT_EOK))
+        {
+            trace_lost++;
+        }
+    }
+    else
+    {
+        rec = &trace_ring[trace_head & (RT_TRACE_RING_SIZE - 1)];
+        rec->hdr       = hdr;
+        rec->timestamp = ts;
+        rec->arg[0]    = a0;
+        rec->arg[1]    = a1;
+        rec->arg[2]    = a2;
+        rec->arg[3]    = a3;
+        trace_head++;
+        if (trace_head - trace_tail > RT_TRACE_RING_SIZE)
+        {
+            trace_tail = trace_head - RT_TRACE_RING_SIZE;
+            trace_lost++;
+        }
+    }
+
+    rt_hw_interrupt_enable(level);
+}
+
+/**=============================================================================
+ * @brief           从 RAM 环形缓冲中按时间顺序取出记录
+ *
+ * @param[out]      rec   记录缓冲
+ * @param[in]       count 缓冲可容纳的记录数
+ *
+ * @return          取出的记录数
+ *============================================================================*/
+rt_size_t trace_read(struct trace_record *rec, rt_size_t count)
+{
+    rt_base_t level;
+    rt_size_t n = 0;
+
+    RT_ASSERT(rec != RT_NULL || count == 0);
+
+    while (n < count)
+    {
+        level = rt_hw_interrupt_disable();
+        if (trace_tail == trace_head)
+        {
+            rt_hw_interrupt_enable(level);
+            break;
+        }
+        rec[n++] = trace_ring[trace_tail & (RT_TRACE_RING_SIZE - 1)];
+        trace_tail++;
+        rt_hw_interrupt_enable(level);
+    }
+
+    return n;
+}
+
+/**=============================================================================
+ * @brief           丢失的事件数（ITM 阻塞或 RAM 缓冲被覆盖）
+ *
+ * @param[in]       none
+ *
+ * @return          事件数
+ *============================================================================*/
+rt_uint32_t trace_get_lost(void)
+{
+    return trace_lost;
+}
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           导出 RAM 中的事件，每行一条，逗号分隔便于上位机转换
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int trace(void)
+{
+    struct trace_record rec;
+    rt_uint32_t i, n;
+
+    rt_kprintf("timestamp,seq,id,args\n");
+    while (trace_read(&rec, 1) == 1)
+    {
+        rt_kprintf("%u,%u,0x%04x", rec.timestamp, TRACE_HDR_SEQ(rec.hdr), TRACE_HDR_ID(rec.hdr));
+        n = TRACE_HDR_NARGS(rec.hdr);
+        for (i = 0; i < n; i++)
+            rt_kprintf(",0x%08x", rec.arg[i]);
+        rt_kprintf("\n");
+    }
+    rt_kprintf("lost %u\n", trace_lost);
+
+    return 0;
+}
+MSH_CMD_EXPORT(trace, dump buffered trace events as csv);
+#endif
+
+#endif  /* RT_USING_TRACE */
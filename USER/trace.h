@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file			trace.h
+  * @brief			binary event trace header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#ifndef RT_TRACE_ITM_PORT
+#define RT_TRACE_ITM_PORT       1
+#endif
+#ifndef RT_TRACE_RING_SIZE
+#define RT_TRACE_RING_SIZE      64
+#endif
+
+/**
+ * 事件格式，ITM 和 RAM 中相同，均为小端 32 位字：
+ *
+ *   word0  [31:16] 事件 ID  [15:12] 参数个数 0~4  [11:8] 0  [7:0] 序号
+ *   word1  DWT 周期计数
+ *   word2~ 参数
+ *
+ * ITM 输出时 word0 写端口 RT_TRACE_ITM_PORT，其余写下一个端口。SWO 包头
+ * 带端口号，上位机据此找到每个事件的起点，不依赖数据内容；起点之后的字数
+ * 必须等于参数个数加一，否则该事件在 FIFO 满时被截断。序号不连续说明整条
+ * 事件丢失（ITM 阻塞或 RAM 缓冲被覆盖）
+ *
+ * 格式字符串只存在于上位机（host/tools/trace_decode），事件 ID 与含义的
+ * 对应由上位机维护
+ */
+#define TRACE_ARGS_MAX          4
+#define TRACE_ITM_PORT_DATA     (RT_TRACE_ITM_PORT + 1)
+
+/* 系统保留的事件 ID，用户事件从 TRACE_ID_USER 开始 */
+#define TRACE_ID_BOOT           0x0001u
+#define TRACE_ID_USER           0x0100u
+
+/* Exported macros -----------------------------------------------------------*/
+#define TRACE_HDR(id, n, seq)   (((rt_uint32_t)(id) << 16) | ((rt_uint32_t)(n) << 12) | ((seq) & 0xFFu))
+#define TRACE_HDR_ID(hdr)       ((rt_uint16_t)((hdr) >> 16))
+#define TRACE_HDR_NARGS(hdr)    (((hdr) >> 12) & 0xFu)
+#define TRACE_HDR_SEQ(hdr)      ((hdr) & 0xFFu)
+#define TRACE_HDR_VALID(hdr)    (((hdr) & 0x0F00u) == 0 && TRACE_HDR_NARGS(hdr) <= TRACE_ARGS_MAX)
+
+#ifdef RT_USING_TRACE
+#define TRACE0(id)              trace_event((id), 0, 0, 0, 0, 0)
+#define TRACE1(id, a)           trace_event((id), 1, (rt_uint32_t)(a), 0, 0, 0)
+#define TRACE2(id, a, b)        trace_event((id), 2, (rt_uint32_t)(a), (rt_uint32_t)(b), 0, 0)
+#define TRACE3(id, a, b, c)     trace_event((id), 3, (rt_uint32_t)(a), (rt_uint32_t)(b), (rt_uint32_t)(c), 0)
+#define TRACE4(id, a, b, c, d)  trace_event((id), 4, (rt_uint32_t)(a), (rt_uint32_t)(b), (rt_uint32_t)(c), (rt_uint32_t)(d))
+#else
+#define TRACE0(id)
+#define TRACE1(id, a)
+#define TRACE2(id, a, b)
+#define TRACE3(id, a, b, c)
+#define TRACE4(id, a, b, c, d)
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+struct trace_record
+{
+    rt_uint32_t hdr;
+    rt_uint32_t timestamp;
+    rt_uint32_t arg[TRACE_ARGS_MAX];
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+int         trace_init(void);
+void        trace_event(rt_uint16_t id, rt_uint32_t nargs,
+                        rt_uint32_t a0, rt_uint32_t a1, rt_uint32_t a2, rt_uint32_t a3);
+rt_size_t   trace_read(struct trace_record *rec, rt_size_t count);
+rt_uint32_t trace_get_lost(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __TRACE_H_ */
@@ -0,0 +1,675 @@
+/**
+  ******************************************************************************
+  * @file			w25q.c
+  * @brief			w25qxx spi nor flash with sector write-back cache
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <string.h>
+#include <timebase.h>
+#include <w25q.h>
+#ifdef RT_USING_FINSH
+#include <finsh.h>
+#endif
+
+/* Private constants ---------------------------------------------------------*/
+#define W25Q_CMD_WRITE_ENABLE   0x06
+#define W25Q_CMD_READ_SR1       0x05
+#define W25Q_CMD_PAGE_PROGRAM   0x02
+#define W25Q_CMD_SECTOR_ERASE   0x20
+#define W25Q_CMD_FAST_READ      0x0B
+#define W25Q_CMD_JEDEC_ID       0x9F
+#define W25Q_CMD_RELEASE_PD     0xAB
+
+#define W25Q_SR_BUSY            0x01
+
+#define W25Q_PROGRAM_TIMEOUT    (RT_TICK_PER_SECOND / 100 + 1)  /*!< tPP 最长 3ms */
+#define W25Q_ERASE_TIMEOUT      (RT_TICK_PER_SECOND / 2 + 1)    /*!< tSE 最长 400ms */
+#define W25Q_MAX_SIZE           (16UL << 20)                    /*!< 3 字节地址 */
+
+/* Private macro -------------------------------------------------------------*/
+/* Private typedef -----------------------------------------------------------*/
+/* Private variables ---------------------------------------------------------*/
+#ifdef RT_USING_W25Q
+static struct spi_stream_bus w25q_bus;
+static struct w25q w25q_flash;
+#endif
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           发送一条命令，片选在命令和数据阶段之间保持
+ *
+ * @param[in]       flash   芯片
+ * @param[in]       hdr     命令、地址和空字节
+ * @param[in]       hdr_len 命令部分的字节数
+ * @param[in]       tx      数据阶段发送的数据，为空时接收
+ * @param[out]      rx      数据阶段接收的缓冲
+ * @param[in]       len     数据阶段字节数，可为 0
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _w25q_cmd(struct w25q *flash, const rt_uint8_t *hdr, rt_size_t hdr_len,
+                          const void *tx, void *rx, rt_size_t len)
+{
+    rt_err_t err;
+
+    err = spi_stream_take(&flash->spi, RT_WAITING_FOREVER);
+    if (err != RT_EOK)
+        return err;
+
+    err = spi_stream_xfer(&flash->spi, hdr, RT_NULL, hdr_len, 0);
+    if (err == RT_EOK && len)
+        err = spi_stream_xfer(&flash->spi, tx, tx ? RT_NULL : rx, len, 0);
+
+    if (spi_stream_release(&flash->spi) != RT_EOK && err == RT_EOK)
+        err = -RT_ETIMEOUT;
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           发送写使能和一条带 3 字节地址的命令，不等待完成
+ *
+ * @param[in]       flash 芯片
+ * @param[in]       cmd   命令
+ * @param[in]       addr  地址
+ * @param[in]       data  页编程的数据，擦除时为空
+ * @param[in]       len   数据字节数
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _w25q_write_cmd(struct w25q *flash, rt_uint8_t cmd, rt_uint32_t addr,
+                                const void *data, rt_size_t len)
+{
+    rt_uint8_t hdr[4];
+    rt_err_t err;
+
+    hdr[0] = W25Q_CMD_WRITE_ENABLE;
+    err = _w25q_cmd(flash, hdr, 1, RT_NULL, RT_NULL, 0);
+    if (err != RT_EOK)
+        return err;
+
+    hdr[0] = cmd;
+    hdr[1] = (rt_uint8_t)(addr >> 16);
+    hdr[2] = (rt_uint8_t)(addr >> 8);
+    hdr[3] = (rt_uint8_t)addr;
+
+    return _w25q_cmd(flash, hdr, 4, data, RT_NULL, len);
+}
+
+/**=============================================================================
+ * @brief           等待擦除或编程结束
+ *
+ * @param[in]       flash   芯片
+ * @param[in]       timeout 超时
+ * @param[in]       sleep   每次查询之间让出 CPU，用于擦除等长操作
+ *
+ * @return          RT_EOK 成功，-RT_ETIMEOUT 超时
+ *
+ * @note            每次查询都释放总线，等待期间同一总线上的其他设备可以访问
+ *============================================================================*/
+static rt_err_t _w25q_wait(struct w25q *flash, rt_tick_t timeout, rt_bool_t sleep)
+{
+    rt_tick_t start = rt_tick_get();
+    rt_uint8_t cmd = W25Q_CMD_READ_SR1, sr;
+    rt_err_t err;
+
+    if (rt_thread_self() == RT_NULL)
+        sleep = RT_FALSE;
+
+    for (;;)
+    {
+        err = _w25q_cmd(flash, &cmd, 1, RT_NULL, &sr, 1);
+        if (err != RT_EOK)
+            return err;
+        if (!(sr & W25Q_SR_BUSY))
+            return RT_EOK;
+        if (rt_tick_get() - start > timeout)
+            return -RT_ETIMEOUT;
+        if (sleep)
+            rt_thread_delay(1);
+    }
+}
+
+/**=============================================================================
+ * @brief           快速读（0x0B），长度足够时由 DMA 接收
+ *
+ * @param[in]       flash 芯片
+ * @param[in]       addr  地址
+ * @param[out]      buf   缓冲
+ * @param[in]       len   字节数
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _w25q_fast_read(struct w25q *flash, rt_uint32_t addr, void *buf, rt_size_t len)
+{
+    rt_uint8_t hdr[5];
+
+    hdr[0] = W25Q_CMD_FAST_READ;
+    hdr[1] = (rt_uint8_t)(addr >> 16);
+    hdr[2] = (rt_uint8_t)(addr >> 8);
+    hdr[3] = (rt_uint8_t)addr;
+    hdr[4] = 0xFF;                          /* 8 个空时钟 */
+
+    return _w25q_cmd(flash, hdr, sizeof(hdr), RT_NULL, buf, len);
+}
+
+/**=============================================================================
+ * @brief           从 from 开始找下一个要编程的页：擦除后是不全为 0xFF 的页，
+ *                  否则是改动过的页，跳过的页计入统计
+ *
+ * @param[in]       flash  芯片
+ * @param[in]       from   起始页号
+ * @param[in]       erased 扇区已擦除
+ *
+ * @return          页号，W25Q_SECTOR_PAGES 表示没有了
+ *============================================================================*/
+static rt_uint32_t _w25q_next_page(struct w25q *flash, rt_uint32_t from, rt_bool_t erased)
+{
+    const rt_uint32_t *w;
+    rt_uint32_t i, j;
+
+    for (i = from; i < W25Q_SECTOR_PAGES; i++)
+    {
+        if (!erased)
+        {
+            if (flash->dirty & (1 << i))
+                return i;
+        }
+        else
+        {
+            w = &flash->cache.w[i * (W25Q_PAGE_SIZE / 4)];
+            for (j = 0; j < W25Q_PAGE_SIZE / 4; j++)
+            {
+                if (w[j] != 0xFFFFFFFFUL)
+                    return i;
+            }
+        }
+        flash->stats.program_skipped++;
+    }
+
+    return W25Q_SECTOR_PAGES;
+}
+
+/**=============================================================================
+ * @brief           把缓存的扇区写回芯片
+ *
+ * @param[in]       flash 芯片
+ *
+ * @return          RT_EOK 成功
+ *
+ * @note            擦除或页编程发出后不空等，先找出下一个要编程的页再查询
+ *                  状态，扫描与芯片内部的编程时间重叠
+ *============================================================================*/
+static rt_err_t _w25q_writeback(struct w25q *flash)
+{
+    rt_uint32_t sector = flash->cache_sector;
+    rt_bool_t erased = flash->need_erase ? RT_TRUE : RT_FALSE;
+    rt_uint32_t page, next;
+    rt_err_t err;
+
+    if (sector == W25Q_NO_SECTOR || flash->dirty == 0)
+        return RT_EOK;
+
+    if (erased)
+    {
+        err = _w25q_write_cmd(flash, W25Q_CMD_SECTOR_ERASE, sector, RT_NULL, 0);
+        if (err != RT_EOK)
+            return err;
+        flash->stats.erase_count++;
+
+        /* 擦除后整个扇区都要重写，全为 0xFF 的页除外 */
+        page = _w25q_next_page(flash, 0, RT_TRUE);
+
+        err = _w25q_wait(flash, W25Q_ERASE_TIMEOUT, RT_TRUE);
+        if (err != RT_EOK)
+            return err;
+    }
+    else
+    {
+        flash->stats.erase_skipped++;
+        page = _w25q_next_page(flash, 0, RT_FALSE);
+    }
+
+    while (page < W25Q_SECTOR_PAGES)
+    {
+        err = _w25q_write_cmd(flash, W25Q_CMD_PAGE_PROGRAM, sector + page * W25Q_PAGE_SIZE,
+                              &flash->cache.b[page * W25Q_PAGE_SIZE], W25Q_PAGE_SIZE);
+        if (err != RT_EOK)
+            return err;
+
+        next = _w25q_next_page(flash, page + 1, erased);
+
+        err = _w25q_wait(flash, W25Q_PROGRAM_TIMEOUT, RT_FALSE);
+        if (err != RT_EOK)
+            return err;
+        flash->stats.program_count++;
+        page = next;
+    }
+
+    flash->dirty      = 0;
+    flash->need_erase = 0;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           把扇区装入缓存，原来的扇区先写回
+ *
+ * @param[in]       flash  芯片
+ * @param[in]       sector 扇区地址
+ * @param[in]       whole  将被整个覆盖，不必读出
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _w25q_load(struct w25q *flash, rt_uint32_t sector, rt_bool_t whole)
+{
+    rt_err_t err;
+
+    if (flash->cache_sector == sector)
+    {
+        flash->stats.cache_hits++;
+        return RT_EOK;
+    }
+    flash->stats.cache_misses++;
+
+    err = _w25q_writeback(flash);
+    if (err != RT_EOK)
+        return err;
+
+    flash->cache_sector = W25Q_NO_SECTOR;
+    flash->dirty        = 0;
+    flash->need_erase   = whole;        /* 不知道原内容，只能擦除 */
+    if (!whole)
+    {
+        err = _w25q_fast_read(flash, sector, flash->cache.b, W25Q_SECTOR_SIZE);
+        if (err != RT_EOK)
+            return err;
+    }
+    flash->cache_sector = sector;
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           初始化芯片：唤醒并读取 JEDEC ID
+ *
+ * @param[in]       flash   芯片
+ * @param[in]       bus     已初始化的 SPI 总线
+ * @param[in]       cs_port 片选端口
+ * @param[in]       cs_pin  片选引脚
+ * @param[in]       max_hz  最高时钟，快速读最高 104MHz，F1 上受 PCLK/2 限制
+ *
+ * @return          RT_EOK 成功，-RT_EIO 没有识别到芯片
+ *============================================================================*/
+rt_err_t w25q_init(struct w25q *flash, struct spi_stream_bus *bus,
+                   GPIO_TypeDef *cs_port, rt_uint16_t cs_pin, rt_uint32_t max_hz)
+{
+    rt_uint8_t cmd, id[3];
+    rt_err_t err;
+
+    RT_ASSERT(flash != RT_NULL && bus != RT_NULL);
+
+    rt_memset(flash, 0, sizeof(*flash) - sizeof(flash->cache));
+    flash->cache_sector = W25Q_NO_SECTOR;
+    rt_sem_init(&flash->lock, "w25q", 1, RT_IPC_FLAG_FIFO);
+    spi_stream_dev_init(&flash->spi, bus, cs_port, cs_pin, 0, max_hz);
+
+    /* 可能处于掉电模式，唤醒需要 tRES1 = 3us */
+    cmd = W25Q_CMD_RELEASE_PD;
+    err = _w25q_cmd(flash, &cmd, 1, RT_NULL, RT_NULL, 0);
+    if (err != RT_EOK)
+        return err;
+    timebase_delay_us(3);
+
+    cmd = W25Q_CMD_JEDEC_ID;
+    err = _w25q_cmd(flash, &cmd, 1, RT_NULL, id, sizeof(id));
+    if (err != RT_EOK)
+        return err;
+
+    flash->jedec_id = ((rt_uint32_t)id[0] << 16) | ((rt_uint32_t)id[1] << 8) | id[2];
+    if (id[0] == 0x00 || id[0] == 0xFF || id[2] < 16 || id[2] > 31)
+        return -RT_EIO;
+
+    /* 超过 16MB 的型号只用前 16MB */
+    flash->size = id[2] > 24 ? W25Q_MAX_SIZE : 1UL << id[2];
+
+    return RT_EOK;
+}
+
+/**=============================================================================
+ * @brief           读取，与缓存重叠的部分从缓存返回
+ *
+ * @param[in]       flash 芯片
+ * @param[in]       addr  地址
+ * @param[out]      buf   缓冲
+ * @param[in]       len   字节数
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 越界
+ *============================================================================*/
+rt_err_t w25q_read(struct w25q *flash, rt_uint32_t addr, void *buf, rt_size_t len)
+{
+    rt_uint8_t *p = (rt_uint8_t *)buf;
+    rt_uint32_t cs;
+    rt_err_t err = RT_EOK;
+    rt_size_t n;
+
+    if (addr > flash->size || len > flash->size - addr)
+        return -RT_EINVAL;
+
+    rt_sem_take(&flash->lock, RT_WAITING_FOREVER);
+    cs = flash->cache_sector;
+
+    while (len && err == RT_EOK)
+    {
+        if (cs != W25Q_NO_SECTOR && addr >= cs && addr < cs + W25Q_SECTOR_SIZE)
+        {
+            n = cs + W25Q_SECTOR_SIZE - addr;
+            if (n > len)
+                n = len;
+            memcpy(p, &flash->cache.b[addr - cs], n);
+        }
+        else
+        {
+            /* 一条快速读命令读到缓存扇区之前为止 */
+            n = len;
+            if (cs != W25Q_NO_SECTOR && addr < cs && addr + len > cs)
+                n = cs - addr;
+            err = _w25q_fast_read(flash, addr, p, n);
+        }
+
+        addr += n;
+        p    += n;
+        len  -= n;
+    }
+
+    rt_sem_release(&flash->lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           写入，先写到扇区缓存，换扇区或 w25q_flush 时落到芯片
+ *
+ * @param[in]       flash 芯片
+ * @param[in]       addr  地址
+ * @param[in]       buf   数据
+ * @param[in]       len   字节数
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 越界
+ *============================================================================*/
+rt_err_t w25q_write(struct w25q *flash, rt_uint32_t addr, const void *buf, rt_size_t len)
+{
+    const rt_uint8_t *src = (const rt_uint8_t *)buf;
+    rt_uint32_t sector, off, first, last, i;
+    rt_uint8_t *dst;
+    rt_err_t err = RT_EOK;
+    rt_size_t n;
+
+    if (addr > flash->size || len > flash->size - addr)
+        return -RT_EINVAL;
+
+    rt_sem_take(&flash->lock, RT_WAITING_FOREVER);
+
+    while (len)
+    {
+        sector = addr & ~(W25Q_SECTOR_SIZE - 1);
+        off    = addr - sector;
+        n      = W25Q_SECTOR_SIZE - off;
+        if (n > len)
+            n = len;
+
+        err = _w25q_load(flash, sector, n == W25Q_SECTOR_SIZE);
+        if (err != RT_EOK)
+            break;
+
+        /* NOR 只能把 1 编程为 0 */
+        dst = &flash->cache.b[off];
+        for (i = 0; !flash->need_erase && i < n; i++)
+        {
+            if (src[i] & ~dst[i])
+                flash->need_erase = 1;
+        }
+        memcpy(dst, src, n);
+
+        first = off / W25Q_PAGE_SIZE;
+        last  = (off + n - 1) / W25Q_PAGE_SIZE;
+        flash->dirty |= (rt_uint16_t)(((1UL << (last + 1)) - 1) & ~((1UL << first) - 1));
+
+        addr += n;
+        src  += n;
+        len  -= n;
+    }
+
+    rt_sem_release(&flash->lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           擦除扇区
+ *
+ * @param[in]       flash 芯片
+ * @param[in]       addr  地址，4KB 对齐
+ * @param[in]       len   字节数，4KB 的整数倍
+ *
+ * @return          RT_EOK 成功，-RT_EINVAL 未对齐或越界
+ *============================================================================*/
+rt_err_t w25q_erase(struct w25q *flash, rt_uint32_t addr, rt_size_t len)
+{
+    rt_err_t err = RT_EOK;
+
+    if (((addr | len) & (W25Q_SECTOR_SIZE - 1)) || addr > flash->size || len > flash->size - addr)
+        return -RT_EINVAL;
+
+    rt_sem_take(&flash->lock, RT_WAITING_FOREVER);
+
+    for (; len && err == RT_EOK; addr += W25Q_SECTOR_SIZE, len -= W25Q_SECTOR_SIZE)
+    {
+        /* 缓存中的改动随擦除作废 */
+        if (flash->cache_sector == addr)
+            flash->cache_sector = W25Q_NO_SECTOR;
+
+        err = _w25q_write_cmd(flash, W25Q_CMD_SECTOR_ERASE, addr, RT_NULL, 0);
+        if (err == RT_EOK)
+            err = _w25q_wait(flash, W25Q_ERASE_TIMEOUT, RT_TRUE);
+        if (err == RT_EOK)
+            flash->stats.erase_count++;
+    }
+
+    rt_sem_release(&flash->lock);
+
+    return err;
+}
+
+/**=============================================================================
+ * @brief           把缓存写回芯片，缓存保持有效
+ *
+ * @param[in]       flash 芯片
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t w25q_flush(struct w25q *flash)
+{
+    rt_err_t err;
+
+    rt_sem_take(&flash->lock, RT_WAITING_FOREVER);
+    err = _w25q_writeback(flash);
+    rt_sem_release(&flash->lock);
+
+    return err;
+}
+
+#ifdef RT_USING_DEVICE
+/**=============================================================================
+ * @brief           块设备读，单位为扇区
+ *
+ * @param[in]       dev    设备
+ * @param[in]       pos    起始扇区
+ * @param[out]      buffer 缓冲
+ * @param[in]       size   扇区数
+ *
+ * @return          读取的扇区数
+ *============================================================================*/
+static rt_size_t _w25q_dev_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    struct w25q *flash = (struct w25q *)dev->user_data;
+
+    if (w25q_read(flash, pos * W25Q_SECTOR_SIZE, buffer, size * W25Q_SECTOR_SIZE) != RT_EOK)
+        return 0;
+
+    return size;
+}
+
+/**=============================================================================
+ * @brief           块设备写，单位为扇区
+ *
+ * @param[in]       dev    设备
+ * @param[in]       pos    起始扇区
+ * @param[in]       buffer 数据
+ * @param[in]       size   扇区数
+ *
+ * @return          写入的扇区数
+ *============================================================================*/
+static rt_size_t _w25q_dev_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    struct w25q *flash = (struct w25q *)dev->user_data;
+
+    if (w25q_write(flash, pos * W25Q_SECTOR_SIZE, buffer, size * W25Q_SECTOR_SIZE) != RT_EOK)
+        return 0;
+
+    return size;
+}
+
+/**=============================================================================
+ * @brief           块设备控制
+ *
+ * @param[in]       dev  设备
+ * @param[in]       cmd  RT_DEVICE_CTRL_BLK_GETGEOME/SYNC/ERASE
+ * @param[in]       args 参数，ERASE 为起止扇区 rt_uint32_t[2]，不含结束扇区
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+static rt_err_t _w25q_dev_control(rt_device_t dev, int cmd, void *args)
+{
+    struct w25q *flash = (struct w25q *)dev->user_data;
+    struct rt_device_blk_geometry *geometry;
+    rt_uint32_t *addrs;
+
+    switch (cmd)
+    {
+    case RT_DEVICE_CTRL_BLK_GETGEOME:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        geometry = (struct rt_device_blk_geometry *)args;
+        geometry->bytes_per_sector = W25Q_SECTOR_SIZE;
+        geometry->block_size       = W25Q_SECTOR_SIZE;
+        geometry->sector_count     = flash->size / W25Q_SECTOR_SIZE;
+        return RT_EOK;
+
+    case RT_DEVICE_CTRL_BLK_SYNC:
+        return w25q_flush(flash);
+
+    case RT_DEVICE_CTRL_BLK_ERASE:
+        if (args == RT_NULL)
+            return -RT_EINVAL;
+        addrs = (rt_uint32_t *)args;
+        if (addrs[1] < addrs[0])
+            return -RT_EINVAL;
+        return w25q_erase(flash, addrs[0] * W25Q_SECTOR_SIZE,
+                          (addrs[1] - addrs[0]) * W25Q_SECTOR_SIZE);
+
+    default:
+        return -RT_ERROR;
+    }
+}
+
+/**=============================================================================
+ * @brief           注册为块设备，块大小为 4KB 扇区
+ *
+ * @param[in]       flash 已初始化的芯片
+ * @param[in]       name  设备名
+ *
+ * @return          RT_EOK 成功
+ *============================================================================*/
+rt_err_t w25q_register(struct w25q *flash, const char *name)
+{
+    flash->parent.type      = RT_Device_Class_Block;
+    flash->parent.init      = RT_NULL;
+    flash->parent.open      = RT_NULL;
+    flash->parent.close     = RT_NULL;
+    flash->parent.read      = _w25q_dev_read;
+    flash->parent.write     = _w25q_dev_write;
+    flash->parent.control   = _w25q_dev_control;
+    flash->parent.user_data = flash;
+
+    return rt_device_register(&flash->parent, name, RT_DEVICE_FLAG_RDWR | RT_DEVICE_FLAG_STANDALONE);
+}
+#endif
+
+#ifdef RT_USING_W25Q
+/**=============================================================================
+ * @brief           初始化板上的 SPI flash 并注册块设备
+ *
+ * @param[in]       none
+ *
+ * @return          0 成功
+ *============================================================================*/
+int w25q_board_init(void)
+{
+    static SPI_TypeDef * const spis[] = {SPI1, SPI2, SPI3};
+    static GPIO_TypeDef * const ports[] = {GPIOA, GPIOB, GPIOC, GPIOD};
+    rt_err_t err;
+
+    err = spi_stream_bus_init(&w25q_bus, spis[RT_W25Q_SPI_BUS - 1]);
+    if (err == RT_EOK)
+        err = w25q_init(&w25q_flash, &w25q_bus, ports[RT_W25Q_CS_PORT],
+                        1 << RT_W25Q_CS_PIN, RT_W25Q_MAX_HZ);
+#ifdef RT_USING_DEVICE
+    if (err == RT_EOK)
+        err = w25q_register(&w25q_flash, "w25q");
+#endif
+    if (err != RT_EOK)
+        rt_kprintf("w25q init failed %d\n", err);
+
+    return err;
+}
+INIT_DEVICE_EXPORT(w25q_board_init);
+
+#ifdef RT_USING_FINSH
+/**=============================================================================
+ * @brief           打印芯片信息和统计，w25q sync 写回缓存
+ *
+ * @param[in]       argc 参数个数
+ * @param[in]       argv 参数
+ *
+ * @return          0 成功
+ *============================================================================*/
+static int w25q(int argc, char **argv)
+{
+    struct w25q_stats *st = &w25q_flash.stats;
+
+    if (argc > 1 && !rt_strcmp(argv[1], "sync"))
+        return w25q_flush(&w25q_flash);
+
+    rt_kprintf("jedec id   %06x, %u KB\n", w25q_flash.jedec_id, w25q_flash.size >> 10);
+    rt_kprintf("erase      %u (skipped %u)\n", st->erase_count, st->erase_skipped);
+    rt_kprintf("program    %u pages (skipped %u)\n", st->program_count, st->program_skipped);
+    rt_kprintf("cache      %u hits, %u misses\n", st->cache_hits, st->cache_misses);
+    rt_kprintf("spi        %u dma, %u poll, %u bytes\n",
+               w25q_bus.dma_xfers, w25q_bus.poll_xfers, w25q_bus.bytes);
+
+    return 0;
+}
+MSH_CMD_EXPORT(w25q, show spi flash stats: w25q [sync]);
+#endif
+#endif
@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file			w25q.h
+  * @brief			w25qxx spi nor flash driver header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __W25Q_H_
+#define __W25Q_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <rtthread.h>
+#include <spi_stream.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define W25Q_PAGE_SIZE          256
+#define W25Q_SECTOR_SIZE        4096
+#define W25Q_SECTOR_PAGES       (W25Q_SECTOR_SIZE / W25Q_PAGE_SIZE)
+#define W25Q_NO_SECTOR          0xFFFFFFFFUL
+
+/* Exported macros -----------------------------------------------------------*/
+/* Exported typedef ----------------------------------------------------------*/
+struct w25q_stats
+{
+    rt_uint32_t erase_count;
+    rt_uint32_t erase_skipped;      /*!< 只有 1->0 的改写，不擦除直接编程 */
+    rt_uint32_t program_count;      /*!< 编程的页数 */
+    rt_uint32_t program_skipped;    /*!< 擦除后全为 0xFF 或没有改动而跳过的页 */
+    rt_uint32_t cache_hits;
+    rt_uint32_t cache_misses;
+};
+
+/**
+ * 一片 W25Qxx，带一个 4KB 扇区的回写缓存
+ *
+ * 写入先改缓存，换扇区或 flush 时才落到芯片：只有出现 0->1 的位时才
+ * 擦除扇区，擦除期间顺便找出需要编程的页，没有改动或全为 0xFF 的页
+ * 不再编程。读取同一扇区时直接从缓存返回。
+ */
+struct w25q
+{
+#ifdef RT_USING_DEVICE
+    struct rt_device        parent;
+#endif
+    struct spi_stream_dev   spi;
+    struct rt_semaphore     lock;
+    rt_uint32_t             jedec_id;
+    rt_uint32_t             size;               /*!< 字节数 */
+
+    rt_uint32_t             cache_sector;       /*!< 缓存的扇区地址，W25Q_NO_SECTOR 表示没有 */
+    rt_uint16_t             dirty;              /*!< 改动过的页，每页一位 */
+    rt_uint8_t              need_erase;         /*!< 缓存中有 0->1 的位 */
+    struct w25q_stats       stats;
+
+    union
+    {
+        rt_uint8_t  b[W25Q_SECTOR_SIZE];
+        rt_uint32_t w[W25Q_SECTOR_SIZE / 4];
+    } cache;
+};
+
+/* Exported variables ------------------------------------------------------- */
+/* Exported functions ------------------------------------------------------- */
+rt_err_t w25q_init(struct w25q *flash, struct spi_stream_bus *bus,
+                   GPIO_TypeDef *cs_port, rt_uint16_t cs_pin, rt_uint32_t max_hz);
+rt_err_t w25q_read(struct w25q *flash, rt_uint32_t addr, void *buf, rt_size_t len);
+rt_err_t w25q_write(struct w25q *flash, rt_uint32_t addr, const void *buf, rt_size_t len);
+rt_err_t w25q_erase(struct w25q *flash, rt_uint32_t addr, rt_size_t len);
+rt_err_t w25q_flush(struct w25q *flash);
+#ifdef RT_USING_DEVICE
+rt_err_t w25q_register(struct w25q *flash, const char *name);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __W25Q_H_ */
@@ -0,0 +1,166 @@
+/**
+  ******************************************************************************
+  * @file			cmsis_gcc.h
+  * @brief			cmsis compiler intrinsics for the host build
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __CMSIS_GCC_H
+#define __CMSIS_GCC_H
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported macros -----------------------------------------------------------*/
+#ifndef   __ASM
+  #define __ASM                                  __asm
+#endif
+#ifndef   __INLINE
+  #define __INLINE                               inline
+#endif
+#ifndef   __STATIC_INLINE
+  #define __STATIC_INLINE                        static inline
+#endif
+#ifndef   __STATIC_FORCEINLINE
+  #define __STATIC_FORCEINLINE                   __attribute__((always_inline)) static inline
+#endif
+#ifndef   __NO_RETURN
+  #define __NO_RETURN                            __attribute__((__noreturn__))
+#endif
+#ifndef   __USED
+  #define __USED                                 __attribute__((used))
+#endif
+#ifndef   __WEAK
+  #define __WEAK                                 __attribute__((weak))
+#endif
+#ifndef   __PACKED
+  #define __PACKED                               __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __PACKED_STRUCT
+  #define __PACKED_STRUCT                        struct __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __PACKED_UNION
+  #define __PACKED_UNION                         union __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __UNALIGNED_UINT32
+  #define __UNALIGNED_UINT32(x)                  (*(const uint32_t *)(x))
+#endif
+#ifndef   __ALIGNED
+  #define __ALIGNED(x)                           __attribute__((aligned(x)))
+#endif
+#ifndef   __RESTRICT
+  #define __RESTRICT                             __restrict
+#endif
+
+/* Exported functions ------------------------------------------------------- */
+/*
+ * 与 CPU 状态有关的指令交给模拟器：PRIMASK 即 rt_hw_interrupt_disable 的
+ * 状态，IPSR 为正在执行的异常号，WFI 推进模拟时间到下一个事件
+ */
+uint32_t sim_cpu_get_primask(void);
+void     sim_cpu_set_primask(uint32_t primask);
+uint32_t sim_cpu_get_ipsr(void);
+void     sim_cpu_wfi(void);
+
+__STATIC_INLINE uint32_t __get_PRIMASK(void)            { return sim_cpu_get_primask(); }
+__STATIC_INLINE void     __set_PRIMASK(uint32_t v)      { sim_cpu_set_primask(v); }
+__STATIC_INLINE void     __disable_irq(void)            { sim_cpu_set_primask(1); }
+__STATIC_INLINE void     __enable_irq(void)             { sim_cpu_set_primask(0); }
+__STATIC_INLINE uint32_t __get_IPSR(void)               { return sim_cpu_get_ipsr(); }
+__STATIC_INLINE uint32_t __get_CONTROL(void)            { return 0; }
+__STATIC_INLINE void     __set_CONTROL(uint32_t v)      { (void)v; }
+__STATIC_INLINE uint32_t __get_BASEPRI(void)            { return 0; }
+__STATIC_INLINE void     __set_BASEPRI(uint32_t v)      { (void)v; }
+__STATIC_INLINE uint32_t __get_FAULTMASK(void)          { return 0; }
+__STATIC_INLINE void     __set_FAULTMASK(uint32_t v)    { (void)v; }
+
+__STATIC_INLINE void     __NOP(void)                    { __ASM volatile ("" ::: "memory"); }
+/* 中断由同一线程上的信号模拟，屏障只需约束编译器，代价与单核 M3 相当 */
+__STATIC_INLINE void     __DSB(void)                    { __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+__STATIC_INLINE void     __ISB(void)                    { __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+__STATIC_INLINE void     __DMB(void)                    { __atomic_signal_fence(__ATOMIC_SEQ_CST); }
+__STATIC_INLINE void     __WFI(void)                    { sim_cpu_wfi(); }
+__STATIC_INLINE void     __WFE(void)                    { sim_cpu_wfi(); }
+__STATIC_INLINE void     __SEV(void)                    { }
+
+__STATIC_INLINE uint32_t __REV(uint32_t v)              { return __builtin_bswap32(v); }
+__STATIC_INLINE uint32_t __REV16(uint32_t v)
+{
+    return ((v & 0xFF00FF00u) >> 8) | ((v & 0x00FF00FFu) << 8);
+}
+__STATIC_INLINE int16_t  __REVSH(int16_t v)             { return (int16_t)__builtin_bswap16((uint16_t)v); }
+__STATIC_INLINE uint32_t __ROR(uint32_t v, uint32_t n)
+{
+    n %= 32u;
+    return n ? (v >> n) | (v << (32u - n)) : v;
+}
+__STATIC_INLINE uint32_t __RBIT(uint32_t v)
+{
+    uint32_t r = 0;
+    int i;
+
+    for (i = 0; i < 32; i++, v >>= 1)
+        r = (r << 1) | (v & 1u);
+    return r;
+}
+__STATIC_INLINE uint8_t  __CLZ(uint32_t v)              { return v ? (uint8_t)__builtin_clz(v) : 32u; }
+
+/* 有符号饱和到 sat 位，与 SSAT 指令相同 */
+__STATIC_INLINE int32_t  __SSAT(int32_t v, uint32_t sat)
+{
+    int32_t max, min;
+
+    if (sat >= 1u && sat <= 32u)
+    {
+        max = (int32_t)((1ull << (sat - 1u)) - 1u);
+        min = -max - 1;
+        if (v > max)
+            return max;
+        if (v < min)
+            return min;
+    }
+    return v;
+}
+
+__STATIC_INLINE uint32_t __USAT(int32_t v, uint32_t sat)
+{
+    uint32_t max;
+
+    if (sat <= 31u)
+    {
+        max = (1u << sat) - 1u;
+        if (v > (int32_t)max)
+            return max;
+        if (v < 0)
+            return 0;
+    }
+    return (uint32_t)v;
+}
+
+/*
+ * 独占访问：模拟中断只在开中断和阻塞点投递，LDREX 与 STREX 之间不会被打断，
+ * STREX 总是成功
+ */
+__STATIC_INLINE uint8_t  __LDREXB(volatile uint8_t *a)  { return *a; }
+__STATIC_INLINE uint16_t __LDREXH(volatile uint16_t *a) { return *a; }
+__STATIC_INLINE uint32_t __LDREXW(volatile uint32_t *a) { return *a; }
+__STATIC_INLINE uint32_t __STREXB(uint8_t v, volatile uint8_t *a)   { *a = v; return 0; }
+__STATIC_INLINE uint32_t __STREXH(uint16_t v, volatile uint16_t *a) { *a = v; return 0; }
+__STATIC_INLINE uint32_t __STREXW(uint32_t v, volatile uint32_t *a) { *a = v; return 0; }
+__STATIC_INLINE void     __CLREX(void)                  { }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __CMSIS_GCC_H */
@@ -0,0 +1,55 @@
+/**
+  ******************************************************************************
+  * @file			finsh.h
+  * @brief			msh command export for the host build
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __FINSH_H__
+#define __FINSH_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+typedef long (*syscall_func)(void);
+
+struct finsh_syscall
+{
+    const char             *name;
+    const char             *desc;
+    syscall_func            func;
+    struct finsh_syscall   *next;
+};
+
+/* Exported macros -----------------------------------------------------------*/
+/* 目标上放进 FSymTab 段，主机上由构造函数登记，msh_exec 按名字查找 */
+#define MSH_CMD_EXPORT_ALIAS(command, alias, desc)                          \
+    static void __attribute__((constructor)) __msh_reg_##alias(void)       \
+    {                                                                       \
+        static struct finsh_syscall call = {#alias, #desc, (syscall_func)command, RT_NULL}; \
+        finsh_syscall_register(&call);                                      \
+    }
+#define MSH_CMD_EXPORT(command, desc)   MSH_CMD_EXPORT_ALIAS(command, command, desc)
+#define FINSH_FUNCTION_EXPORT(name, desc)
+#define FINSH_FUNCTION_EXPORT_ALIAS(name, alias, desc)
+
+/* Exported functions ------------------------------------------------------- */
+void finsh_syscall_register(struct finsh_syscall *call);
+int  msh_exec(char *cmd, rt_size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __FINSH_H__ */
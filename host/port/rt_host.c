@@ -0,0 +1,1014 @@
+/**
+  ******************************************************************************
+  * @file			rt_host.c
+  * @brief			rt-thread nano kernel subset running on the host simulator
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <rtthread.h>
+#include <rthw.h>
+#include <finsh.h>
+#include "sim.h"
+#include "sim_host.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define RT_HOST_STACK_SIZE      (256u * 1024u)      /*!< 主机 libc 需要的栈远大于目标 */
+#define RT_HOST_MAIN_PRIORITY   (RT_THREAD_PRIORITY_MAX / 3)
+#define RT_HOST_MAIN_TICK       20
+#define RT_HOST_MSH_ARGS        10
+
+/* Private macro -------------------------------------------------------------*/
+/* a 在 b 之后或相等，回绕安全 */
+#define RT_TICK_AFTER_EQ(a, b)  ((rt_tick_t)((a) - (b)) < RT_TICK_MAX / 2)
+
+/* Private variables ---------------------------------------------------------*/
+static struct rt_thread     *rt_threads;
+static struct rt_thread     *rt_current;
+static struct rt_timer      *rt_timers;
+static volatile rt_tick_t    rt_tick;
+static volatile rt_uint8_t   rt_nest;
+static volatile rt_uint16_t  rt_critical;
+static int                   rt_yield_pending;
+static rt_uint32_t           rt_seq;
+static int                   rt_started;
+static int                   rt_failures;
+
+static struct rt_init_desc  *rt_inits;
+static struct finsh_syscall *rt_syscalls;
+#ifdef RT_USING_DEVICE
+static struct rt_device     *rt_devices;
+#endif
+#ifdef RT_USING_HOOK
+static void                (*rt_enter_hook)(void);
+static void                (*rt_leave_hook)(void);
+#endif
+
+static struct rt_thread      rt_main_thread;
+static void                (*rt_main_entry)(void);
+static int                   rt_main_components;
+static char                  rt_log_buf[RT_CONSOLEBUF_SIZE];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           优先级最高的就绪线程，同优先级按就绪先后
+ *============================================================================*/
+static struct rt_thread *_rt_pick(void)
+{
+    struct rt_thread *t, *best = RT_NULL;
+
+    for (t = rt_threads; t; t = t->next)
+    {
+        if (t->stat != RT_THREAD_READY)
+            continue;
+        if (best == RT_NULL || t->current_priority < best->current_priority ||
+            (t->current_priority == best->current_priority && (rt_int32_t)(t->wait_seq - best->wait_seq) < 0))
+            best = t;
+    }
+    return best;
+}
+
+/**=============================================================================
+ * @brief           切换到指定线程，各线程的 PRIMASK 随上下文保存
+ *============================================================================*/
+static void _rt_switch(struct rt_thread *to)
+{
+    struct rt_thread *from = rt_current;
+
+    if (to == from)
+        return;
+
+    from->host_primask = sim_host_swap_primask(to->host_primask);
+    rt_current = to;
+    swapcontext(&from->ctx, &to->ctx);
+}
+
+/**=============================================================================
+ * @brief           线程就绪
+ *============================================================================*/
+static void _rt_ready(struct rt_thread *t)
+{
+    t->stat       = RT_THREAD_READY;
+    t->wait_obj   = RT_NULL;
+    t->wake_armed = 0;
+    t->wait_seq   = ++rt_seq;
+}
+
+/**=============================================================================
+ * @brief           死锁时列出各线程状态
+ *============================================================================*/
+static void _rt_deadlock(void)
+{
+    struct rt_thread *t;
+
+    fprintf(stderr, "sim: deadlock, no thread ready and no pending event\n");
+    for (t = rt_threads; t; t = t->next)
+    {
+        fprintf(stderr, "  %-8.*s prio %d stat %d wait %p\n", RT_NAME_MAX, t->name,
+                t->current_priority, t->stat, t->wait_obj);
+    }
+    sim_fatal("deadlock");
+}
+
+/**=============================================================================
+ * @brief           当前线程已不再就绪，切到其他线程，全部阻塞时推进时间
+ *============================================================================*/
+static void _rt_block(void)
+{
+    struct rt_thread *self = rt_current, *next;
+
+    while (self->stat != RT_THREAD_READY)
+    {
+        next = _rt_pick();
+        if (next)
+        {
+            _rt_switch(next);
+            continue;
+        }
+        if (!sim_idle())
+            _rt_deadlock();
+    }
+}
+
+/**=============================================================================
+ * @brief           当前线程等待 IPC 对象或超时
+ *
+ * @param[in]       obj  等待的对象，延时为 RT_NULL
+ * @param[in]       time 节拍数，RT_WAITING_FOREVER 不超时
+ *
+ * @return          唤醒者设置的错误码，超时为 -RT_ETIMEOUT
+ *============================================================================*/
+static rt_err_t _rt_wait(void *obj, rt_int32_t time)
+{
+    struct rt_thread *self = rt_current;
+
+    if (self == RT_NULL || rt_nest != 0 || sim_cpu_get_ipsr() != 0)
+        sim_fatal("blocking call outside thread context");
+
+    self->error    = RT_EOK;
+    self->wait_obj = obj;
+    self->wait_seq = ++rt_seq;
+    self->stat     = RT_THREAD_SUSPEND;
+    if (time > 0)
+    {
+        self->wake_tick  = rt_tick + (rt_tick_t)time;
+        self->wake_armed = 1;
+    }
+    _rt_block();
+
+    return self->error;
+}
+
+/**=============================================================================
+ * @brief           唤醒一个等待 obj 的线程
+ *
+ * @param[in]       obj  IPC 对象
+ * @param[in]       prio RT_IPC_FLAG_PRIO 时按优先级，否则先来先服务
+ *
+ * @return          被唤醒的线程
+ *============================================================================*/
+static struct rt_thread *_rt_wake_one(void *obj, rt_uint8_t prio)
+{
+    struct rt_thread *t, *best = RT_NULL;
+
+    for (t = rt_threads; t; t = t->next)
+    {
+        if (t->stat != RT_THREAD_SUSPEND || t->wait_obj != obj)
+            continue;
+        if (best == RT_NULL ||
+            (prio == RT_IPC_FLAG_PRIO && t->current_priority < best->current_priority) ||
+            ((prio != RT_IPC_FLAG_PRIO || t->current_priority == best->current_priority) &&
+             (rt_int32_t)(t->wait_seq - best->wait_seq) < 0))
+            best = t;
+    }
+    if (best)
+    {
+        best->error = RT_EOK;
+        _rt_ready(best);
+    }
+    return best;
+}
+
+/**=============================================================================
+ * @brief           线程入口的外壳，入口返回即线程结束
+ *============================================================================*/
+static void _rt_thread_entry(void)
+{
+    struct rt_thread *self = rt_current;
+
+    self->entry(self->parameter);
+
+    self->stat = RT_THREAD_CLOSE;
+    if (self == &rt_main_thread)
+        sim_host_return();
+    _rt_block();
+}
+
+/**=============================================================================
+ * @brief           检查到期的定时器，在 SysTick 中断中执行回调
+ *============================================================================*/
+static void _rt_timer_check(void)
+{
+    struct rt_timer *t, **pp;
+
+    for (;;)
+    {
+        for (pp = &rt_timers; (t = *pp) != RT_NULL; pp = &t->next)
+        {
+            if (RT_TICK_AFTER_EQ(rt_tick, t->timeout_tick))
+                break;
+        }
+        if (t == RT_NULL)
+            break;
+
+        *pp = t->next;
+        t->next = RT_NULL;
+        t->flag &= ~RT_TIMER_FLAG_ACTIVATED;
+        t->timeout_func(t->parameter);
+
+        if ((t->flag & RT_TIMER_FLAG_PERIODIC) && !(t->flag & RT_TIMER_FLAG_ACTIVATED))
+            rt_timer_start(t);
+    }
+}
+
+/**=============================================================================
+ * @brief           主线程：组件初始化后运行测试
+ *============================================================================*/
+static void _rt_main_entry(void *parameter)
+{
+    (void)parameter;
+    if (rt_main_components)
+        rt_components_init();
+    rt_main_entry();
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           创建主线程并启动调度，不返回
+ *
+ * @param[in]       entry      主线程运行的函数
+ * @param[in]       components 是否先调用 rt_components_init
+ *============================================================================*/
+void sim_host_start(void (*entry)(void), int components)
+{
+    struct rt_thread *first;
+
+    rt_main_entry      = entry;
+    rt_main_components = components;
+    rt_thread_init(&rt_main_thread, "main", _rt_main_entry, RT_NULL, RT_NULL, 0,
+                   RT_HOST_MAIN_PRIORITY, RT_HOST_MAIN_TICK);
+    rt_thread_startup(&rt_main_thread);
+
+    rt_started = 1;
+    first = _rt_pick();
+    rt_current = first;
+    sim_host_swap_primask(first->host_primask);
+    setcontext(&first->ctx);
+}
+
+/**=============================================================================
+ * @brief           线程模式下的抢占检查点
+ *============================================================================*/
+void sim_host_preempt(void)
+{
+    struct rt_thread *best;
+
+    if (!rt_started || rt_current == RT_NULL || rt_critical || rt_nest)
+        return;
+
+    best = _rt_pick();
+    if (best == RT_NULL || best == rt_current)
+    {
+        rt_yield_pending = 0;
+        return;
+    }
+    if (rt_current->stat != RT_THREAD_READY ||
+        best->current_priority < rt_current->current_priority ||
+        (rt_yield_pending && best->current_priority == rt_current->current_priority))
+    {
+        rt_yield_pending = 0;
+        _rt_switch(best);
+    }
+}
+
+void sim_host_fail(void)
+{
+    rt_failures++;
+}
+
+int sim_host_exit_code(void)
+{
+    return rt_failures ? 1 : 0;
+}
+
+void rt_assert_handler(const char *ex, const char *func, rt_size_t line)
+{
+    sim_fatal("(%s) assertion failed at function:%s, line number:%lu", ex, func, (unsigned long)line);
+}
+
+void rt_init_register(struct rt_init_desc *desc)
+{
+    struct rt_init_desc **pp;
+
+    for (pp = &rt_inits; *pp; pp = &(*pp)->next)
+        ;
+    *pp = desc;
+}
+
+static void _rt_init_level(int from, int to)
+{
+    struct rt_init_desc *d;
+    int level;
+
+    for (level = from; level <= to; level++)
+    {
+        for (d = rt_inits; d; d = d->next)
+        {
+            if (d->level == level)
+                d->fn();
+        }
+    }
+}
+
+void rt_components_board_init(void)
+{
+    _rt_init_level(RT_INIT_LEVEL_BOARD, RT_INIT_LEVEL_BOARD);
+}
+
+void rt_components_init(void)
+{
+    _rt_init_level(RT_INIT_LEVEL_PREV, RT_INIT_LEVEL_APP);
+}
+
+void rt_system_heap_init(void *begin_addr, void *end_addr)
+{
+    (void)begin_addr;
+    (void)end_addr;
+}
+
+/* 中断 ----------------------------------------------------------------------*/
+rt_base_t rt_hw_interrupt_disable(void)
+{
+    rt_base_t level = sim_cpu_get_primask();
+
+    sim_host_swap_primask(1);
+    return level;
+}
+
+void rt_hw_interrupt_enable(rt_base_t level)
+{
+    sim_cpu_set_primask((uint32_t)level);
+}
+
+void rt_interrupt_enter(void)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    rt_nest++;
+#ifdef RT_USING_HOOK
+    if (rt_enter_hook)
+        rt_enter_hook();
+#endif
+    rt_hw_interrupt_enable(level);
+}
+
+void rt_interrupt_leave(void)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    rt_nest--;
+#ifdef RT_USING_HOOK
+    if (rt_leave_hook)
+        rt_leave_hook();
+#endif
+    rt_hw_interrupt_enable(level);
+}
+
+rt_uint8_t rt_interrupt_get_nest(void)
+{
+    return rt_nest;
+}
+
+#ifdef RT_USING_HOOK
+void rt_interrupt_enter_sethook(void (*hook)(void))
+{
+    rt_enter_hook = hook;
+}
+
+void rt_interrupt_leave_sethook(void (*hook)(void))
+{
+    rt_leave_hook = hook;
+}
+#endif
+
+/* 时钟与定时器 --------------------------------------------------------------*/
+/**=============================================================================
+ * @brief           当前节拍，同时让模拟时间前进一点，轮询节拍的循环才能结束
+ *============================================================================*/
+rt_tick_t rt_tick_get(void)
+{
+    sim_host_tick_poll();
+    return rt_tick;
+}
+
+void rt_tick_set(rt_tick_t tick)
+{
+    rt_tick = tick;
+}
+
+/**=============================================================================
+ * @brief           SysTick 中断调用：时间片、延时唤醒和硬定时器
+ *============================================================================*/
+void rt_tick_increase(void)
+{
+    struct rt_thread *t;
+
+    ++rt_tick;
+
+    if (rt_current && rt_current->stat == RT_THREAD_READY && --rt_current->remaining_tick == 0)
+    {
+        rt_current->remaining_tick = rt_current->init_tick;
+        rt_current->wait_seq = ++rt_seq;
+        rt_yield_pending = 1;
+    }
+
+    for (t = rt_threads; t; t = t->next)
+    {
+        if (t->stat == RT_THREAD_SUSPEND && t->wake_armed && RT_TICK_AFTER_EQ(rt_tick, t->wake_tick))
+        {
+            _rt_ready(t);
+            t->error = -RT_ETIMEOUT;
+        }
+    }
+
+    _rt_timer_check();
+}
+
+rt_tick_t rt_tick_from_millisecond(rt_int32_t ms)
+{
+    if (ms < 0)
+        return (rt_tick_t)RT_WAITING_FOREVER;
+    return (rt_tick_t)(((rt_uint64_t)ms * RT_TICK_PER_SECOND + 999u) / 1000u);
+}
+
+void rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter),
+                   void *parameter, rt_tick_t time, rt_uint8_t flag)
+{
+    memset(timer, 0, sizeof(*timer));
+    strncpy(timer->name, name, RT_NAME_MAX);
+    timer->timeout_func = timeout;
+    timer->parameter    = parameter;
+    timer->init_tick    = time;
+    timer->flag         = flag & ~RT_TIMER_FLAG_ACTIVATED;
+}
+
+rt_err_t rt_timer_detach(rt_timer_t timer)
+{
+    return rt_timer_stop(timer);
+}
+
+rt_err_t rt_timer_start(rt_timer_t timer)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    struct rt_timer **pp;
+
+    for (pp = &rt_timers; *pp; pp = &(*pp)->next)
+    {
+        if (*pp == timer)
+        {
+            *pp = timer->next;
+            break;
+        }
+    }
+    timer->timeout_tick = rt_tick + timer->init_tick;
+    timer->flag |= RT_TIMER_FLAG_ACTIVATED;
+    timer->next = rt_timers;
+    rt_timers = timer;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_stop(rt_timer_t timer)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    struct rt_timer **pp;
+
+    if (!(timer->flag & RT_TIMER_FLAG_ACTIVATED))
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_ERROR;
+    }
+    for (pp = &rt_timers; *pp; pp = &(*pp)->next)
+    {
+        if (*pp == timer)
+        {
+            *pp = timer->next;
+            break;
+        }
+    }
+    timer->next = RT_NULL;
+    timer->flag &= ~RT_TIMER_FLAG_ACTIVATED;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_timer_control(rt_timer_t timer, int cmd, void *arg)
+{
+    switch (cmd)
+    {
+    case RT_TIMER_CTRL_SET_TIME:
+        timer->init_tick = *(rt_tick_t *)arg;
+        break;
+    case RT_TIMER_CTRL_GET_TIME:
+        *(rt_tick_t *)arg = timer->init_tick;
+        break;
+    case RT_TIMER_CTRL_SET_ONESHOT:
+        timer->flag &= ~RT_TIMER_FLAG_PERIODIC;
+        break;
+    case RT_TIMER_CTRL_SET_PERIODIC:
+        timer->flag |= RT_TIMER_FLAG_PERIODIC;
+        break;
+    default:
+        break;
+    }
+    return RT_EOK;
+}
+
+/* 线程 ----------------------------------------------------------------------*/
+/**=============================================================================
+ * @brief           初始化线程，目标上的栈参数只作记录，主机另分配大栈
+ *============================================================================*/
+rt_err_t rt_thread_init(struct rt_thread *thread, const char *name,
+                        void (*entry)(void *parameter), void *parameter,
+                        void *stack_start, rt_uint32_t stack_size,
+                        rt_uint8_t priority, rt_uint32_t tick)
+{
+    struct rt_thread *t;
+
+    (void)stack_start;
+    (void)stack_size;
+    RT_ASSERT(priority < RT_THREAD_PRIORITY_MAX);
+
+    for (t = rt_threads; t; t = t->next)
+    {
+        if (t == thread)
+            sim_fatal("thread %s initialized twice", name);
+    }
+
+    memset(thread, 0, sizeof(*thread));
+    strncpy(thread->name, name, RT_NAME_MAX);
+    thread->entry            = entry;
+    thread->parameter        = parameter;
+    thread->init_priority    = priority;
+    thread->current_priority = priority;
+    thread->init_tick        = tick ? tick : 1;
+    thread->remaining_tick   = thread->init_tick;
+    thread->stat             = RT_THREAD_INIT;
+    thread->host_stack_size  = RT_HOST_STACK_SIZE;
+    thread->host_stack       = sim_alloc_low(RT_HOST_STACK_SIZE);
+
+    getcontext(&thread->ctx);
+    thread->ctx.uc_stack.ss_sp   = thread->host_stack;
+    thread->ctx.uc_stack.ss_size = thread->host_stack_size;
+    thread->ctx.uc_link          = RT_NULL;
+    makecontext(&thread->ctx, _rt_thread_entry, 0);
+
+    thread->next = rt_threads;
+    rt_threads = thread;
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_detach(rt_thread_t thread)
+{
+    thread->stat = RT_THREAD_CLOSE;
+    if (thread == rt_current)
+        _rt_block();
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_startup(rt_thread_t thread)
+{
+    RT_ASSERT(thread->stat == RT_THREAD_INIT);
+    _rt_ready(thread);
+    rt_schedule();
+    return RT_EOK;
+}
+
+rt_thread_t rt_thread_self(void)
+{
+    return rt_started ? rt_current : RT_NULL;
+}
+
+rt_err_t rt_thread_yield(void)
+{
+    struct rt_thread *best;
+    rt_base_t level;
+
+    /* 同内核实现在关中断下操作就绪表，也让只让出 CPU 的循环消耗时间 */
+    level = rt_hw_interrupt_disable();
+    rt_current->wait_seq = ++rt_seq;
+    best = _rt_pick();
+    rt_hw_interrupt_enable(level);
+    if (best && best != rt_current)
+        _rt_switch(best);
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_delay(rt_tick_t tick)
+{
+    rt_base_t level;
+
+    if (tick == 0)
+        return rt_thread_yield();
+
+    level = rt_hw_interrupt_disable();
+    _rt_wait(RT_NULL, (rt_int32_t)tick);
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+rt_err_t rt_thread_mdelay(rt_int32_t ms)
+{
+    return rt_thread_delay(rt_tick_from_millisecond(ms));
+}
+
+/**=============================================================================
+ * @brief           请求调度，中断中、关中断或锁调度时推迟到检查点
+ *============================================================================*/
+void rt_schedule(void)
+{
+    if (sim_cpu_get_ipsr() != 0 || sim_cpu_get_primask() != 0)
+        return;
+    sim_host_preempt();
+}
+
+void rt_enter_critical(void)
+{
+    rt_critical++;
+}
+
+void rt_exit_critical(void)
+{
+    if (rt_critical && --rt_critical == 0)
+        rt_schedule();
+}
+
+rt_uint16_t rt_critical_level(void)
+{
+    return rt_critical;
+}
+
+/* IPC -----------------------------------------------------------------------*/
+rt_err_t rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag)
+{
+    memset(sem, 0, sizeof(*sem));
+    strncpy(sem->name, name, RT_NAME_MAX);
+    sem->value = (rt_uint16_t)value;
+    sem->flag  = flag;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_detach(rt_sem_t sem)
+{
+    struct rt_thread *t;
+
+    /* 等待者以 -RT_ERROR 返回 */
+    while ((t = _rt_wake_one(sem, RT_IPC_FLAG_FIFO)) != RT_NULL)
+        t->error = -RT_ERROR;
+    return RT_EOK;
+}
+
+rt_err_t rt_sem_take(rt_sem_t sem, rt_int32_t time)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_err_t err = RT_EOK;
+
+    if (sem->value > 0)
+        sem->value--;
+    else if (time == 0)
+        err = -RT_ETIMEOUT;
+    else
+        err = _rt_wait(sem, time);
+
+    rt_hw_interrupt_enable(level);
+    return err;
+}
+
+rt_err_t rt_sem_trytake(rt_sem_t sem)
+{
+    return rt_sem_take(sem, 0);
+}
+
+rt_err_t rt_sem_release(rt_sem_t sem)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_err_t err = RT_EOK;
+
+    if (_rt_wake_one(sem, sem->flag) == RT_NULL)
+    {
+        if (sem->value < RT_UINT16_MAX)
+            sem->value++;
+        else
+            err = -RT_EFULL;
+    }
+    rt_hw_interrupt_enable(level);
+    rt_schedule();
+
+    return err;
+}
+
+rt_err_t rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag)
+{
+    rt_sem_init(&mutex->sem, name, 1, flag);
+    mutex->owner = RT_NULL;
+    mutex->hold  = 0;
+    return RT_EOK;
+}
+
+rt_err_t rt_mutex_detach(rt_mutex_t mutex)
+{
+    return rt_sem_detach(&mutex->sem);
+}
+
+rt_err_t rt_mutex_take(rt_mutex_t mutex, rt_int32_t time)
+{
+    rt_err_t err;
+
+    if (mutex->owner == rt_current && mutex->hold)
+    {
+        mutex->hold++;
+        return RT_EOK;
+    }
+    err = rt_sem_take(&mutex->sem, time);
+    if (err == RT_EOK)
+    {
+        mutex->owner = rt_current;
+        mutex->hold  = 1;
+    }
+    return err;
+}
+
+rt_err_t rt_mutex_release(rt_mutex_t mutex)
+{
+    if (mutex->owner != rt_current)
+        return -RT_ERROR;
+    if (--mutex->hold)
+        return RT_EOK;
+    mutex->owner = RT_NULL;
+    return rt_sem_release(&mutex->sem);
+}
+
+rt_err_t rt_mb_init(rt_mailbox_t mb, const char *name, void *msgpool, rt_size_t size, rt_uint8_t flag)
+{
+    (void)flag;
+    memset(mb, 0, sizeof(*mb));
+    strncpy(mb->name, name, RT_NAME_MAX);
+    mb->msg_pool = msgpool;
+    mb->size     = (rt_uint16_t)size;
+    return RT_EOK;
+}
+
+rt_err_t rt_mb_detach(rt_mailbox_t mb)
+{
+    struct rt_thread *t;
+
+    while ((t = _rt_wake_one(mb, RT_IPC_FLAG_FIFO)) != RT_NULL)
+        t->error = -RT_ERROR;
+    return RT_EOK;
+}
+
+rt_err_t rt_mb_send(rt_mailbox_t mb, rt_ubase_t value)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+
+    if (mb->entry == mb->size)
+    {
+        rt_hw_interrupt_enable(level);
+        return -RT_EFULL;
+    }
+    mb->msg_pool[mb->in_offset] = value;
+    if (++mb->in_offset >= mb->size)
+        mb->in_offset = 0;
+    mb->entry++;
+    _rt_wake_one(mb, RT_IPC_FLAG_FIFO);
+    rt_hw_interrupt_enable(level);
+    rt_schedule();
+
+    return RT_EOK;
+}
+
+rt_err_t rt_mb_recv(rt_mailbox_t mb, rt_ubase_t *value, rt_int32_t timeout)
+{
+    rt_base_t level = rt_hw_interrupt_disable();
+    rt_err_t err;
+
+    while (mb->entry == 0)
+    {
+        if (timeout == 0)
+        {
+            rt_hw_interrupt_enable(level);
+            return -RT_ETIMEOUT;
+        }
+        err = _rt_wait(mb, timeout);
+        if (err != RT_EOK)
+        {
+            rt_hw_interrupt_enable(level);
+            return err;
+        }
+    }
+    *value = mb->msg_pool[mb->out_offset];
+    if (++mb->out_offset >= mb->size)
+        mb->out_offset = 0;
+    mb->entry--;
+    rt_hw_interrupt_enable(level);
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_DEVICE
+rt_err_t rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags)
+{
+    strncpy(dev->name, name, RT_NAME_MAX);
+    dev->flag = flags;
+    dev->next = rt_devices;
+    rt_devices = dev;
+    return RT_EOK;
+}
+
+rt_device_t rt_device_find(const char *name)
+{
+    struct rt_device *dev;
+
+    for (dev = rt_devices; dev; dev = dev->next)
+    {
+        if (strncmp(dev->name, name, RT_NAME_MAX) == 0)
+            return dev;
+    }
+    return RT_NULL;
+}
+
+/* 与内核相同：没有对应操作时读写返回 0，控制返回 -RT_ENOSYS */
+rt_size_t rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size)
+{
+    RT_ASSERT(dev != RT_NULL);
+    return dev->read ? dev->read(dev, pos, buffer, size) : 0;
+}
+
+rt_size_t rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size)
+{
+    RT_ASSERT(dev != RT_NULL);
+    return dev->write ? dev->write(dev, pos, buffer, size) : 0;
+}
+
+rt_err_t rt_device_control(rt_device_t dev, int cmd, void *arg)
+{
+    RT_ASSERT(dev != RT_NULL);
+    return dev->control ? dev->control(dev, cmd, arg) : -RT_ENOSYS;
+}
+#endif
+
+/* 输出与字符串 --------------------------------------------------------------*/
+/**=============================================================================
+ * @brief           没有链接 console.c 时直接输出到标准输出
+ *============================================================================*/
+RT_WEAK void rt_hw_console_output(const char *str)
+{
+    fputs(str, stdout);
+}
+
+/**=============================================================================
+ * @brief           与 nano 相同：格式化到静态缓冲后交给 rt_hw_console_output
+ *============================================================================*/
+void rt_kprintf(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    rt_vsnprintf(rt_log_buf, sizeof(rt_log_buf) - 1, fmt, args);
+    va_end(args);
+    rt_hw_console_output(rt_log_buf);
+}
+
+void rt_kputs(const char *str)
+{
+    rt_hw_console_output(str);
+}
+
+rt_int32_t rt_vsnprintf(char *buf, rt_size_t size, const char *fmt, va_list args)
+{
+    return vsnprintf(buf, size, fmt, args);
+}
+
+rt_int32_t rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...)
+{
+    va_list args;
+    rt_int32_t n;
+
+    va_start(args, fmt);
+    n = vsnprintf(buf, size, fmt, args);
+    va_end(args);
+    return n;
+}
+
+rt_int32_t rt_sprintf(char *buf, const char *format, ...)
+{
+    va_list args;
+    rt_int32_t n;
+
+    va_start(args, format);
+    n = vsprintf(buf, format, args);
+    va_end(args);
+    return n;
+}
+
+void *rt_memset(void *s, int c, rt_ubase_t count)
+{
+    return memset(s, c, count);
+}
+
+void *rt_memcpy(void *dst, const void *src, rt_ubase_t count)
+{
+    return memcpy(dst, src, count);
+}
+
+void *rt_memmove(void *dest, const void *src, rt_ubase_t n)
+{
+    return memmove(dest, src, n);
+}
+
+rt_int32_t rt_memcmp(const void *cs, const void *ct, rt_ubase_t count)
+{
+    return memcmp(cs, ct, count);
+}
+
+rt_size_t rt_strlen(const char *src)
+{
+    return strlen(src);
+}
+
+rt_int32_t rt_strcmp(const char *cs, const char *ct)
+{
+    return strcmp(cs, ct);
+}
+
+rt_int32_t rt_strncmp(const char *cs, const char *ct, rt_ubase_t count)
+{
+    return strncmp(cs, ct, count);
+}
+
+char *rt_strncpy(char *dst, const char *src, rt_ubase_t n)
+{
+    return strncpy(dst, src, n);
+}
+
+/* msh -----------------------------------------------------------------------*/
+void finsh_syscall_register(struct finsh_syscall *call)
+{
+    call->next = rt_syscalls;
+    rt_syscalls = call;
+}
+
+/**=============================================================================
+ * @brief           按空格拆分命令行并执行
+ *
+ * @return          命令的返回值，找不到命令为 -1
+ *============================================================================*/
+int msh_exec(char *cmd, rt_size_t length)
+{
+    char line[RT_CONSOLEBUF_SIZE], *argv[RT_HOST_MSH_ARGS], *p;
+    struct finsh_syscall *call;
+    int argc = 0;
+
+    if (length >= sizeof(line))
+        length = sizeof(line) - 1;
+    memcpy(line, cmd, length);
+    line[length] = '\0';
+
+    for (p = strtok(line, " \t\r\n"); p && argc < RT_HOST_MSH_ARGS; p = strtok(RT_NULL, " \t\r\n"))
+        argv[argc++] = p;
+    if (argc == 0)
+        return 0;
+
+    for (call = rt_syscalls; call; call = call->next)
+    {
+        if (strcmp(call->name, argv[0]) == 0)
+            return ((int (*)(int, char **))call->func)(argc, argv);
+    }
+    rt_kprintf("%s: command not found.\n", argv[0]);
+    return -1;
+}
@@ -0,0 +1,37 @@
+/**
+  ******************************************************************************
+  * @file			rthw.h
+  * @brief			rt-thread cpu port interface for the host build
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RT_HW_H__
+#define __RT_HW_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtthread.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported functions ------------------------------------------------------- */
+/*
+ * 关中断即置位模拟的 PRIMASK；开中断时如有挂起的中断会在返回前投递，
+ * 相当于目标上 CPSIE 之后立即进入中断
+ */
+rt_base_t rt_hw_interrupt_disable(void);
+void      rt_hw_interrupt_enable(rt_base_t level);
+void      rt_hw_board_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __RT_HW_H__ */
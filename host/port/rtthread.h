@@ -0,0 +1,358 @@
+/**
+  ******************************************************************************
+  * @file			rtthread.h
+  * @brief			rt-thread nano api subset for the host build
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __RT_THREAD_H__
+#define __RT_THREAD_H__
+
+/* Includes ------------------------------------------------------------------*/
+#include <rtconfig.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <ucontext.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported typedef ----------------------------------------------------------*/
+/*
+ * 与 Cortex-M3 上的 rtdef.h 保持相同的宽度：rt_int32_t/rt_uint32_t 必须是
+ * 32 位，回绕运算才与目标一致；rt_base_t/rt_size_t 跟随指针宽度
+ */
+typedef signed   char                   rt_int8_t;
+typedef signed   short                  rt_int16_t;
+typedef signed   int                    rt_int32_t;
+typedef signed   long long              rt_int64_t;
+typedef unsigned char                   rt_uint8_t;
+typedef unsigned short                  rt_uint16_t;
+typedef unsigned int                    rt_uint32_t;
+typedef unsigned long long              rt_uint64_t;
+typedef int                             rt_bool_t;
+typedef long                            rt_base_t;
+typedef unsigned long                   rt_ubase_t;
+
+typedef rt_base_t                       rt_err_t;
+typedef rt_uint32_t                     rt_time_t;
+typedef rt_uint32_t                     rt_tick_t;
+typedef rt_base_t                       rt_flag_t;
+typedef rt_ubase_t                      rt_size_t;
+typedef rt_ubase_t                      rt_dev_t;
+typedef rt_base_t                       rt_off_t;
+
+/* Exported constants --------------------------------------------------------*/
+#define RT_TRUE                         1
+#define RT_FALSE                        0
+#define RT_NULL                         ((void *)0)
+
+#define RT_UINT8_MAX                    0xff
+#define RT_UINT16_MAX                   0xffff
+#define RT_UINT32_MAX                   0xffffffff
+#define RT_TICK_MAX                     RT_UINT32_MAX
+
+#define RT_EOK                          0
+#define RT_ERROR                        1
+#define RT_ETIMEOUT                     2
+#define RT_EFULL                        3
+#define RT_EEMPTY                       4
+#define RT_ENOMEM                       5
+#define RT_ENOSYS                       6
+#define RT_EBUSY                        7
+#define RT_EIO                          8
+#define RT_EINTR                        9
+#define RT_EINVAL                       10
+
+#define RT_WAITING_FOREVER              -1
+#define RT_WAITING_NO                   0
+
+#define RT_IPC_FLAG_FIFO                0x00
+#define RT_IPC_FLAG_PRIO                0x01
+
+#define RT_THREAD_INIT                  0x00
+#define RT_THREAD_READY                 0x01
+#define RT_THREAD_SUSPEND               0x02
+#define RT_THREAD_RUNNING               0x03
+#define RT_THREAD_CLOSE                 0x04
+
+#define RT_TIMER_FLAG_DEACTIVATED       0x0
+#define RT_TIMER_FLAG_ACTIVATED         0x1
+#define RT_TIMER_FLAG_ONE_SHOT          0x0
+#define RT_TIMER_FLAG_PERIODIC          0x2
+#define RT_TIMER_FLAG_HARD_TIMER        0x0
+#define RT_TIMER_FLAG_SOFT_TIMER        0x4
+
+#define RT_TIMER_CTRL_SET_TIME          0x0
+#define RT_TIMER_CTRL_GET_TIME          0x1
+#define RT_TIMER_CTRL_SET_ONESHOT       0x2
+#define RT_TIMER_CTRL_SET_PERIODIC      0x3
+
+/* Exported macros -----------------------------------------------------------*/
+#define RT_ALIGN(size, align)           (((size) + (align) - 1) & ~((align) - 1))
+#define RT_ALIGN_DOWN(size, align)      ((size) & ~((align) - 1))
+
+#define rt_inline                       static __inline
+#define RT_WEAK                         __attribute__((weak))
+#define RT_UNUSED                       __attribute__((unused))
+#define RT_USED                         __attribute__((used))
+#define ALIGN(n)                        __attribute__((aligned(n)))
+#define RT_SECTION(x)
+
+/* 断言失败直接结束测试进程，打印位置 */
+#define RT_ASSERT(EX)                                                       \
+    do                                                                      \
+    {                                                                       \
+        if (!(EX))                                                          \
+            rt_assert_handler(#EX, __FUNCTION__, __LINE__);                 \
+    } while (0)
+
+/*
+ * 自动初始化：目标上靠链接段排序，主机上用构造函数登记到各级链表，
+ * rt_components_board_init/rt_components_init 按级别依次调用
+ */
+#define RT_INIT_LEVEL_BOARD             1
+#define RT_INIT_LEVEL_PREV              2
+#define RT_INIT_LEVEL_DEVICE            3
+#define RT_INIT_LEVEL_COMPONENT         4
+#define RT_INIT_LEVEL_ENV               5
+#define RT_INIT_LEVEL_APP               6
+
+#define INIT_EXPORT(fn, level)                                              \
+    static void __attribute__((constructor)) __rt_init_reg_##fn(void)      \
+    {                                                                       \
+        static struct rt_init_desc desc = {#fn, (int (*)(void))fn, level, RT_NULL}; \
+        rt_init_register(&desc);                                            \
+    }
+
+#define INIT_BOARD_EXPORT(fn)           INIT_EXPORT(fn, RT_INIT_LEVEL_BOARD)
+#define INIT_PREV_EXPORT(fn)            INIT_EXPORT(fn, RT_INIT_LEVEL_PREV)
+#define INIT_DEVICE_EXPORT(fn)          INIT_EXPORT(fn, RT_INIT_LEVEL_DEVICE)
+#define INIT_COMPONENT_EXPORT(fn)       INIT_EXPORT(fn, RT_INIT_LEVEL_COMPONENT)
+#define INIT_ENV_EXPORT(fn)             INIT_EXPORT(fn, RT_INIT_LEVEL_ENV)
+#define INIT_APP_EXPORT(fn)             INIT_EXPORT(fn, RT_INIT_LEVEL_APP)
+
+/* Exported typedef ----------------------------------------------------------*/
+struct rt_init_desc
+{
+    const char             *name;
+    int                   (*fn)(void);
+    int                     level;
+    struct rt_init_desc    *next;
+};
+
+struct rt_list_node
+{
+    struct rt_list_node    *next;
+    struct rt_list_node    *prev;
+};
+typedef struct rt_list_node rt_list_t;
+
+/**
+ * 线程：主机上每个线程有自己的低地址栈和 ucontext，调度器按优先级协作切换，
+ * 阻塞点和中断返回点都是切换点
+ */
+struct rt_thread
+{
+    char                    name[RT_NAME_MAX];
+    void                  (*entry)(void *parameter);
+    void                   *parameter;
+    rt_uint8_t              init_priority;
+    rt_uint8_t              current_priority;
+    rt_uint8_t              stat;
+    rt_err_t                error;
+
+    /* 主机调度使用 */
+    void                   *wait_obj;       /*!< 正在等待的 IPC 对象 */
+    rt_uint32_t             wait_seq;       /*!< 进入等待或就绪的顺序，同优先级先来先服务 */
+    rt_tick_t               wake_tick;
+    rt_uint8_t              wake_armed;
+    rt_uint32_t             init_tick;      /*!< 时间片 */
+    rt_uint32_t             remaining_tick;
+    rt_uint32_t             host_primask;   /*!< 切出时的 PRIMASK */
+    void                   *host_stack;
+    rt_size_t               host_stack_size;
+    ucontext_t              ctx;
+    struct rt_thread       *next;
+};
+typedef struct rt_thread *rt_thread_t;
+
+struct rt_semaphore
+{
+    char                    name[RT_NAME_MAX];
+    rt_uint8_t              flag;
+    rt_uint16_t             value;
+};
+typedef struct rt_semaphore *rt_sem_t;
+
+struct rt_mutex
+{
+    struct rt_semaphore     sem;
+    rt_thread_t             owner;
+    rt_uint16_t             hold;
+};
+typedef struct rt_mutex *rt_mutex_t;
+
+struct rt_mailbox
+{
+    char                    name[RT_NAME_MAX];
+    rt_ubase_t             *msg_pool;
+    rt_uint16_t             size;
+    rt_uint16_t             entry;
+    rt_uint16_t             in_offset;
+    rt_uint16_t             out_offset;
+};
+typedef struct rt_mailbox *rt_mailbox_t;
+
+struct rt_timer
+{
+    char                    name[RT_NAME_MAX];
+    rt_uint8_t              flag;
+    void                  (*timeout_func)(void *parameter);
+    void                   *parameter;
+    rt_tick_t               init_tick;
+    rt_tick_t               timeout_tick;
+    struct rt_timer        *next;
+};
+typedef struct rt_timer *rt_timer_t;
+
+#ifdef RT_USING_DEVICE
+enum rt_device_class_type
+{
+    RT_Device_Class_Char = 0,
+    RT_Device_Class_Block = 1,
+    RT_Device_Class_Unknown
+};
+
+#define RT_DEVICE_FLAG_RDONLY           0x001
+#define RT_DEVICE_FLAG_WRONLY           0x002
+#define RT_DEVICE_FLAG_RDWR             0x003
+#define RT_DEVICE_FLAG_STANDALONE       0x008
+
+#define RT_DEVICE_CTRL_BLK_GETGEOME     0x10
+#define RT_DEVICE_CTRL_BLK_SYNC         0x11
+#define RT_DEVICE_CTRL_BLK_ERASE        0x12
+
+struct rt_device_blk_geometry
+{
+    rt_uint32_t             sector_count;
+    rt_uint32_t             bytes_per_sector;
+    rt_uint32_t             block_size;
+};
+
+typedef struct rt_device *rt_device_t;
+struct rt_device
+{
+    char                    name[RT_NAME_MAX];
+    enum rt_device_class_type type;
+    rt_uint16_t             flag;
+    rt_err_t              (*init)   (rt_device_t dev);
+    rt_err_t              (*open)   (rt_device_t dev, rt_uint16_t oflag);
+    rt_err_t              (*close)  (rt_device_t dev);
+    rt_size_t             (*read)   (rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size);
+    rt_size_t             (*write)  (rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size);
+    rt_err_t              (*control)(rt_device_t dev, int cmd, void *args);
+    void                   *user_data;
+    struct rt_device       *next;
+};
+
+rt_err_t    rt_device_register(rt_device_t dev, const char *name, rt_uint16_t flags);
+rt_device_t rt_device_find(const char *name);
+rt_size_t   rt_device_read(rt_device_t dev, rt_off_t pos, void *buffer, rt_size_t size);
+rt_size_t   rt_device_write(rt_device_t dev, rt_off_t pos, const void *buffer, rt_size_t size);
+rt_err_t    rt_device_control(rt_device_t dev, int cmd, void *arg);
+#endif
+
+/* Exported functions ------------------------------------------------------- */
+/* 内核 */
+void        rt_assert_handler(const char *ex, const char *func, rt_size_t line);
+void        rt_init_register(struct rt_init_desc *desc);
+void        rt_components_board_init(void);
+void        rt_components_init(void);
+void        rt_system_heap_init(void *begin_addr, void *end_addr);
+
+/* 时钟与定时器 */
+rt_tick_t   rt_tick_get(void);
+void        rt_tick_set(rt_tick_t tick);
+void        rt_tick_increase(void);
+rt_tick_t   rt_tick_from_millisecond(rt_int32_t ms);
+
+void        rt_timer_init(rt_timer_t timer, const char *name, void (*timeout)(void *parameter),
+                          void *parameter, rt_tick_t time, rt_uint8_t flag);
+rt_err_t    rt_timer_detach(rt_timer_t timer);
+rt_err_t    rt_timer_start(rt_timer_t timer);
+rt_err_t    rt_timer_stop(rt_timer_t timer);
+rt_err_t    rt_timer_control(rt_timer_t timer, int cmd, void *arg);
+
+/* 线程 */
+rt_err_t    rt_thread_init(struct rt_thread *thread, const char *name,
+                           void (*entry)(void *parameter), void *parameter,
+                           void *stack_start, rt_uint32_t stack_size,
+                           rt_uint8_t priority, rt_uint32_t tick);
+rt_err_t    rt_thread_detach(rt_thread_t thread);
+rt_err_t    rt_thread_startup(rt_thread_t thread);
+rt_thread_t rt_thread_self(void);
+rt_err_t    rt_thread_yield(void);
+rt_err_t    rt_thread_delay(rt_tick_t tick);
+rt_err_t    rt_thread_mdelay(rt_int32_t ms);
+void        rt_schedule(void);
+void        rt_enter_critical(void);
+void        rt_exit_critical(void);
+rt_uint16_t rt_critical_level(void);
+
+/* 中断 */
+void        rt_interrupt_enter(void);
+void        rt_interrupt_leave(void);
+rt_uint8_t  rt_interrupt_get_nest(void);
+#ifdef RT_USING_HOOK
+void        rt_interrupt_enter_sethook(void (*hook)(void));
+void        rt_interrupt_leave_sethook(void (*hook)(void));
+#endif
+
+/* IPC */
+rt_err_t    rt_sem_init(rt_sem_t sem, const char *name, rt_uint32_t value, rt_uint8_t flag);
+rt_err_t    rt_sem_detach(rt_sem_t sem);
+rt_err_t    rt_sem_take(rt_sem_t sem, rt_int32_t time);
+rt_err_t    rt_sem_trytake(rt_sem_t sem);
+rt_err_t    rt_sem_release(rt_sem_t sem);
+
+rt_err_t    rt_mutex_init(rt_mutex_t mutex, const char *name, rt_uint8_t flag);
+rt_err_t    rt_mutex_detach(rt_mutex_t mutex);
+rt_err_t    rt_mutex_take(rt_mutex_t mutex, rt_int32_t time);
+rt_err_t    rt_mutex_release(rt_mutex_t mutex);
+
+rt_err_t    rt_mb_init(rt_mailbox_t mb, const char *name, void *msgpool, rt_size_t size, rt_uint8_t flag);
+rt_err_t    rt_mb_detach(rt_mailbox_t mb);
+rt_err_t    rt_mb_send(rt_mailbox_t mb, rt_ubase_t value);
+rt_err_t    rt_mb_recv(rt_mailbox_t mb, rt_ubase_t *value, rt_int32_t timeout);
+
+/* 输出与字符串 */
+void        rt_kprintf(const char *fmt, ...);
+void        rt_kputs(const char *str);
+void        rt_hw_console_output(const char *str);
+char        rt_hw_console_getchar(void);
+rt_int32_t  rt_vsnprintf(char *buf, rt_size_t size, const char *fmt, va_list args);
+rt_int32_t  rt_snprintf(char *buf, rt_size_t size, const char *fmt, ...);
+rt_int32_t  rt_sprintf(char *buf, const char *format, ...);
+
+void       *rt_memset(void *s, int c, rt_ubase_t count);
+void       *rt_memcpy(void *dst, const void *src, rt_ubase_t count);
+void       *rt_memmove(void *dest, const void *src, rt_ubase_t n);
+rt_int32_t  rt_memcmp(const void *cs, const void *ct, rt_ubase_t count);
+rt_size_t   rt_strlen(const char *src);
+rt_int32_t  rt_strcmp(const char *cs, const char *ct);
+rt_int32_t  rt_strncmp(const char *cs, const char *ct, rt_ubase_t count);
+char       *rt_strncpy(char *dst, const char *src, rt_ubase_t n);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __RT_THREAD_H__ */
@@ -0,0 +1,1157 @@
+/**
+  ******************************************************************************
+  * @file			sim.c
+  * @brief			host register-level simulator of the stm32f103rc
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#define _GNU_SOURCE
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <rtthread.h>
+#include <rthw.h>
+#include "sim.h"
+#include "sim_host.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_PAGE_SIZE           4096u
+#define SIM_TRAP_MAX            4           /*!< 一条指令最多访问的寄存器页 */
+#define SIM_WIN_SIZE            32u         /*!< 访问前后比较的窗口 */
+#define SIM_ACCESS_CYCLES       2           /*!< 每次寄存器访问消耗的 HCLK */
+#define SIM_PRIMASK_CYCLES      4           /*!< 开关中断及其调用开销 */
+#define SIM_SPIN_LIMIT          8           /*!< 每个读位置连续读到不变的值超过该次数视为忙等 */
+#define SIM_SPIN_SITES          4           /*!< 一个忙等循环中最多轮询的寄存器个数 */
+#define SIM_LOG_SIZE            65536
+#define SIM_IRQ_NUM             60
+#define SIM_PRIO_THREAD         0x100       /*!< 线程模式的执行优先级 */
+#define SIM_BOOT_STACK_SIZE     (1024u * 1024u)
+#define SIM_X86_TF              0x100
+#define SIM_X86_DF              0x400
+
+#define SIM_SYSMEM_BASE         0x1FFFF000u
+#define SIM_ITM_BASE            0xE0000000u
+#define SIM_SCS_BASE            0xE000E000u
+
+/* Private typedef -----------------------------------------------------------*/
+enum sim_region_kind
+{
+    SIM_REGION_PERIPH = 0,
+    SIM_REGION_BITBAND,
+    SIM_REGION_FLASH,
+    SIM_REGION_ROM,
+};
+
+struct sim_region
+{
+    uint32_t                base;
+    uint32_t                size;
+    int                     prot;           /*!< 固件侧映射的常态权限 */
+    enum sim_region_kind    kind;
+    uint8_t                *shadow;
+};
+
+struct sim_trap
+{
+    struct sim_region      *region;
+    uint32_t                addr;
+    int                     write;
+    uint32_t                win;
+    uint32_t                win_len;
+    uint8_t                 old[SIM_WIN_SIZE];
+};
+
+/* 注入中断时保存的被打断现场 */
+struct sim_frame
+{
+    greg_t                  gregs[NGREG];
+    struct _libc_fpstate    fp;
+} __attribute__((aligned(64)));
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_region sim_regions[] =
+{
+    {FLASH_BASE,     SIM_FLASH_SIZE, PROT_READ, SIM_REGION_FLASH,   NULL},
+    {SIM_SYSMEM_BASE, 0x1000,        PROT_READ, SIM_REGION_ROM,     NULL},
+    {PERIPH_BASE,    0x30000,        PROT_NONE, SIM_REGION_PERIPH,  NULL},
+    {PERIPH_BB_BASE, 0x600000,       PROT_NONE, SIM_REGION_BITBAND, NULL},
+    {SIM_ITM_BASE,   0x3000,         PROT_NONE, SIM_REGION_PERIPH,  NULL},
+    {SIM_SCS_BASE,   0x1000,         PROT_NONE, SIM_REGION_PERIPH,  NULL},
+};
+#define SIM_REGION_NUM  (sizeof(sim_regions) / sizeof(sim_regions[0]))
+
+static struct sim_periph *sim_periphs;
+
+static volatile int      sim_trap_active;
+static int               sim_trap_num;
+static struct sim_trap   sim_traps[SIM_TRAP_MAX];
+
+static uint64_t          sim_now;
+static uint64_t          sim_limit = SIM_MS(600000);
+static struct sim_event *sim_events;
+static uint32_t          sim_accesses;
+
+/* 最近的读位置（指令、地址、读到的值），循环中轮询几个寄存器也能识别 */
+static struct
+{
+    uintptr_t           rip;
+    uint32_t            addr;
+    uint32_t            val;
+} sim_spin[SIM_SPIN_SITES];
+static uint32_t          sim_spin_sites, sim_spin_count;
+
+static uint32_t          sim_primask;
+static uint32_t          sim_ipsr;
+static uint32_t          sim_active_prio = SIM_PRIO_THREAD;
+static uint32_t          sim_irq_counts[SIM_IRQ_NUM + 1];
+static int               sim_systick_pending;
+
+/* 外设中断请求是电平：处理函数返回时仍有效则再次挂起 */
+static int             (*sim_irq_levels[SIM_IRQ_NUM])(void *arg);
+static void             *sim_irq_level_args[SIM_IRQ_NUM];
+
+static IRQn_Type         sim_preempt_irq;
+static int               sim_preempt_on;
+
+static struct sim_access sim_log[SIM_LOG_SIZE];
+static size_t            sim_log_num;
+static uint32_t          sim_log_base, sim_log_size;
+
+static ucontext_t        sim_host_ctx, sim_boot_ctx;
+static void            (*sim_entry)(void);
+static int               sim_flags;
+
+/* 链接脚本把固件和 HAL 的代码放在一起，随机抢占只落在这段代码里 */
+extern const char __sim_fw_text_start[] __attribute__((weak));
+extern const char __sim_fw_text_end[] __attribute__((weak));
+
+/* 向量表，未实现的中断为空 */
+#define SIM_VECTOR(name)    extern void name(void) __attribute__((weak));
+#define SIM_VECTORS(X)                                                                  \
+    X(WWDG_IRQHandler) X(PVD_IRQHandler) X(TAMPER_IRQHandler) X(RTC_IRQHandler)         \
+    X(FLASH_IRQHandler) X(RCC_IRQHandler) X(EXTI0_IRQHandler) X(EXTI1_IRQHandler)       \
+    X(EXTI2_IRQHandler) X(EXTI3_IRQHandler) X(EXTI4_IRQHandler)                         \
+    X(DMA1_Channel1_IRQHandler) X(DMA1_Channel2_IRQHandler) X(DMA1_Channel3_IRQHandler) \
+    X(DMA1_Channel4_IRQHandler) X(DMA1_Channel5_IRQHandler) X(DMA1_Channel6_IRQHandler) \
+    X(DMA1_Channel7_IRQHandler) X(ADC1_2_IRQHandler) X(USB_HP_CAN1_TX_IRQHandler)       \
+    X(USB_LP_CAN1_RX0_IRQHandler) X(CAN1_RX1_IRQHandler) X(CAN1_SCE_IRQHandler)         \
+    X(EXTI9_5_IRQHandler) X(TIM1_BRK_IRQHandler) X(TIM1_UP_IRQHandler)                  \
+    X(TIM1_TRG_COM_IRQHandler) X(TIM1_CC_IRQHandler) X(TIM2_IRQHandler)                 \
+    X(TIM3_IRQHandler) X(TIM4_IRQHandler) X(I2C1_EV_IRQHandler) X(I2C1_ER_IRQHandler)   \
+    X(I2C2_EV_IRQHandler) X(I2C2_ER_IRQHandler) X(SPI1_IRQHandler) X(SPI2_IRQHandler)   \
+    X(USART1_IRQHandler) X(USART2_IRQHandler) X(USART3_IRQHandler)                      \
+    X(EXTI15_10_IRQHandler) X(RTC_Alarm_IRQHandler) X(USBWakeUp_IRQHandler)             \
+    X(TIM8_BRK_IRQHandler) X(TIM8_UP_IRQHandler) X(TIM8_TRG_COM_IRQHandler)             \
+    X(TIM8_CC_IRQHandler) X(ADC3_IRQHandler) X(FSMC_IRQHandler) X(SDIO_IRQHandler)      \
+    X(TIM5_IRQHandler) X(SPI3_IRQHandler) X(UART4_IRQHandler) X(UART5_IRQHandler)       \
+    X(TIM6_IRQHandler) X(TIM7_IRQHandler) X(DMA2_Channel1_IRQHandler)                   \
+    X(DMA2_Channel2_IRQHandler) X(DMA2_Channel3_IRQHandler) X(DMA2_Channel4_5_IRQHandler)
+SIM_VECTORS(SIM_VECTOR)
+extern void SysTick_Handler(void) __attribute__((weak));
+
+#define SIM_VECTOR_ENTRY(name)  name,
+static void (*const sim_vectors[SIM_IRQ_NUM])(void) = { SIM_VECTORS(SIM_VECTOR_ENTRY) };
+
+/* 中断注入的跳板：调用投递函数，再用 ud2 回到 SIGILL 处理恢复现场 */
+void sim_async_irq(void);
+extern const char sim_irq_trampoline[], sim_irq_return[];
+__asm__(
+    ".text\n"
+    ".globl sim_irq_trampoline\n"
+    "sim_irq_trampoline:\n"
+    "    movq %rdi, %rbx\n"
+    "    andq $-16, %rsp\n"
+    "    call sim_async_irq\n"
+    "    movq %rbx, %rdi\n"
+    ".globl sim_irq_return\n"
+    "sim_irq_return:\n"
+    "    ud2\n");
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           查找地址所在的映射区
+ *============================================================================*/
+static struct sim_region *_sim_region(uintptr_t addr)
+{
+    size_t i;
+
+    for (i = 0; i < SIM_REGION_NUM; i++)
+    {
+        if (addr >= sim_regions[i].base && addr - sim_regions[i].base < sim_regions[i].size)
+            return &sim_regions[i];
+    }
+    return NULL;
+}
+
+/**=============================================================================
+ * @brief           查找地址所属的外设模型
+ *============================================================================*/
+static struct sim_periph *_sim_periph(uint32_t addr)
+{
+    struct sim_periph *p;
+
+    for (p = sim_periphs; p; p = p->next)
+    {
+        if (addr >= p->base && addr - p->base < p->size)
+            return p;
+    }
+    return NULL;
+}
+
+/**=============================================================================
+ * @brief           信号处理中可用的输出
+ *============================================================================*/
+static void _sim_write_str(const char *s)
+{
+    ssize_t r = write(STDERR_FILENO, s, strlen(s));
+    (void)r;
+}
+
+/**=============================================================================
+ * @brief           访问了芯片上不存在的地址，相当于 BusFault
+ *============================================================================*/
+static void _sim_bus_fault(uintptr_t addr, ucontext_t *uc, int write)
+{
+    char buf[160];
+
+    snprintf(buf, sizeof(buf), "sim: bus fault, %s 0x%08lx at pc %p, t=%llu ns\n",
+             write ? "write" : "read", (unsigned long)addr,
+             (void *)uc->uc_mcontext.gregs[REG_RIP], (unsigned long long)sim_now);
+    _sim_write_str(buf);
+    _exit(3);
+}
+
+/**=============================================================================
+ * @brief           执行到期的事件
+ *============================================================================*/
+static void _sim_events_run(void)
+{
+    struct sim_event *ev;
+
+    while ((ev = sim_events) != NULL && ev->when <= sim_now)
+    {
+        sim_events = ev->next;
+        ev->armed = 0;
+        ev->next = NULL;
+        ev->fn(ev);
+    }
+}
+
+/**=============================================================================
+ * @brief           异常的 8 位优先级，SysTick 为 -1
+ *============================================================================*/
+static uint32_t _sim_irq_prio(int irq)
+{
+    if (irq < 0)
+        return SIM_PERIPH(SCB_Type, SCB)->SHP[11];
+    return SIM_PERIPH(NVIC_Type, NVIC)->IP[irq];
+}
+
+/**=============================================================================
+ * @brief           抢占优先级，按 AIRCR 的分组只比较组优先级
+ *============================================================================*/
+static uint32_t _sim_irq_group(uint32_t prio)
+{
+    uint32_t prigroup = (SIM_PERIPH(SCB_Type, SCB)->AIRCR & SCB_AIRCR_PRIGROUP_Msk) >> SCB_AIRCR_PRIGROUP_Pos;
+
+    return prio >> (prigroup + 1);
+}
+
+/**=============================================================================
+ * @brief           可以立即进入的最高优先级中断
+ *
+ * @return          中断号，-1 为 SysTick，-2 表示没有
+ *============================================================================*/
+static int _sim_irq_next(void)
+{
+    NVIC_Type *nvic = SIM_PERIPH(NVIC_Type, NVIC);
+    SysTick_Type *st = SIM_PERIPH(SysTick_Type, SysTick);
+    uint32_t bits, prio, best_prio = 0x1000;
+    int irq, best = -2, word;
+
+    if (sim_primask)
+        return -2;
+
+    if (sim_systick_pending && (st->CTRL & SysTick_CTRL_TICKINT_Msk))
+    {
+        best = -1;
+        best_prio = _sim_irq_prio(-1);
+    }
+    for (word = 0; word < 2; word++)
+    {
+        bits = nvic->ISPR[word] & nvic->ISER[word];
+        while (bits)
+        {
+            irq = word * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+            if (irq >= SIM_IRQ_NUM)
+                continue;
+            prio = _sim_irq_prio(irq);
+            if (prio < best_prio)
+            {
+                best = irq;
+                best_prio = prio;
+            }
+        }
+    }
+    if (best == -2)
+        return -2;
+    if (sim_active_prio != SIM_PRIO_THREAD &&
+        _sim_irq_group(best_prio) >= _sim_irq_group(sim_active_prio))
+        return -2;
+    return best;
+}
+
+/**=============================================================================
+ * @brief           把中断投递插入被打断的现场，相当于硬件压栈进入异常
+ *
+ * @param[in]       uc 信号现场，返回后从跳板开始执行
+ *============================================================================*/
+static void _sim_inject(ucontext_t *uc)
+{
+    uintptr_t sp = (uintptr_t)uc->uc_mcontext.gregs[REG_RSP];
+    struct sim_frame *frame;
+
+    /* 跳过被打断函数的红区 */
+    sp -= 128 + sizeof(struct sim_frame);
+    sp &= ~(uintptr_t)63;
+    frame = (struct sim_frame *)sp;
+
+    memcpy(frame->gregs, uc->uc_mcontext.gregs, sizeof(frame->gregs));
+    memcpy(&frame->fp, uc->uc_mcontext.fpregs, sizeof(frame->fp));
+
+    uc->uc_mcontext.gregs[REG_RSP] = (greg_t)sp;
+    uc->uc_mcontext.gregs[REG_RDI] = (greg_t)frame;
+    uc->uc_mcontext.gregs[REG_RIP] = (greg_t)sim_irq_trampoline;
+    uc->uc_mcontext.gregs[REG_EFL] &= ~(greg_t)(SIM_X86_TF | SIM_X86_DF);
+}
+
+/**=============================================================================
+ * @brief           记录一次读访问，判断固件是否在忙等
+ *
+ * @return          1 最近的几个读位置读到的值都没有变化，且已轮询足够多次
+ *============================================================================*/
+static int _sim_spin_check(uintptr_t rip, uint32_t addr)
+{
+    uint32_t i, val = SIM_REG(addr);
+
+    for (i = 0; i < sim_spin_sites; i++)
+    {
+        if (sim_spin[i].rip == rip && sim_spin[i].addr == addr)
+            break;
+    }
+    if (i == sim_spin_sites)
+    {
+        /* 新的读位置：位置太多就不是一个小的轮询循环，从这里重新开始 */
+        if (sim_spin_sites == SIM_SPIN_SITES)
+            sim_spin_sites = i = 0;
+        sim_spin[i].rip  = rip;
+        sim_spin[i].addr = addr;
+        sim_spin[i].val  = val;
+        sim_spin_sites++;
+        sim_spin_count = 0;
+        return 0;
+    }
+    if (sim_spin[i].val != val)
+    {
+        sim_spin[i].val = val;
+        sim_spin_count = 0;
+        return 0;
+    }
+
+    return ++sim_spin_count > SIM_SPIN_LIMIT * sim_spin_sites;
+}
+
+/**=============================================================================
+ * @brief           SIGSEGV：固件访问寄存器页，调用读钩子后开放该页单步执行
+ *============================================================================*/
+static void _sim_segv(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uintptr_t addr = (uintptr_t)si->si_addr;
+    struct sim_region *r = _sim_region(addr);
+    int write = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+    struct sim_periph *p;
+    struct sim_trap *t;
+    uint32_t target, word, off;
+    uintptr_t page;
+
+    (void)sig;
+    if (r == NULL || (r->kind == SIM_REGION_ROM) || (r->kind == SIM_REGION_FLASH && !write) ||
+        sim_trap_num == SIM_TRAP_MAX)
+        _sim_bus_fault(addr, uc, write);
+
+    if (!sim_trap_active)
+        _sim_events_run();
+
+    t = &sim_traps[sim_trap_num++];
+    t->region = r;
+    t->addr   = (uint32_t)addr;
+    t->write  = write;
+
+    if (r->kind == SIM_REGION_BITBAND)
+    {
+        /* 位带别名：一个字对应目标寄存器的一位 */
+        off    = (uint32_t)addr - r->base;
+        target = PERIPH_BASE + (off >> 5);
+        word   = target & ~3u;
+        p = _sim_periph(word);
+        if (p && p->read)
+            p->read(p, word, write);
+        *(volatile uint32_t *)(r->shadow + (off & ~3u)) = (SIM_REG(word) >> ((off >> 2) & 31u)) & 1u;
+    }
+    else if (r->kind == SIM_REGION_PERIPH)
+    {
+        word = (uint32_t)addr & ~3u;
+        p = _sim_periph(word);
+        if (p && p->read)
+            p->read(p, word, write);
+
+        /* 连续读到不变的值说明固件在忙等，直接跳到下一个事件 */
+        if (!write && _sim_spin_check((uintptr_t)uc->uc_mcontext.gregs[REG_RIP], word))
+        {
+            if (sim_events && sim_events->when > sim_now)
+            {
+                sim_now = sim_events->when;
+                sim_spin_sites = 0;
+                sim_spin_count = 0;
+                _sim_events_run();
+                if (p && p->read)
+                    p->read(p, word, write);
+            }
+        }
+        else if (write)
+        {
+            sim_spin_sites = 0;
+            sim_spin_count = 0;
+        }
+    }
+
+    /* 记录访问前的窗口，单步后比较得到写入的字 */
+    t->win = ((uint32_t)addr & ~(SIM_WIN_SIZE / 2 - 1u));
+    if (t->win + SIM_WIN_SIZE > r->base + r->size)
+        t->win = r->base + r->size - SIM_WIN_SIZE;
+    t->win_len = SIM_WIN_SIZE;
+    memcpy(t->old, r->shadow + (t->win - r->base), SIM_WIN_SIZE);
+
+    page = addr & ~(uintptr_t)(SIM_PAGE_SIZE - 1);
+    mprotect((void *)page, SIM_PAGE_SIZE, PROT_READ | PROT_WRITE);
+
+    sim_trap_active = 1;
+    uc->uc_mcontext.gregs[REG_EFL] |= SIM_X86_TF;
+}
+
+/**=============================================================================
+ * @brief           把一次单步访问的结果交给模型
+ *============================================================================*/
+static void _sim_commit(struct sim_trap *t, const uint8_t *now)
+{
+    struct sim_region *r = t->region;
+    struct sim_periph *p;
+    uint32_t i, addr, old, val, off, word, bit;
+    uint16_t old16, new16;
+
+    if (r->kind == SIM_REGION_BITBAND)
+    {
+        if (!t->write)
+            return;
+        off    = t->addr - r->base;
+        word   = (PERIPH_BASE + (off >> 5)) & ~3u;
+        bit    = (off >> 2) & 31u;
+        old    = SIM_REG(word);
+        val    = (*(volatile uint32_t *)(r->shadow + (off & ~3u)) & 1u) ? (old | (1u << bit)) : (old & ~(1u << bit));
+        SIM_REG(word) = val;
+        if (sim_log_size && word - sim_log_base < sim_log_size && sim_log_num < SIM_LOG_SIZE)
+            sim_log[sim_log_num++] = (struct sim_access){sim_now, word, old, val};
+        p = _sim_periph(word);
+        if (p && p->write)
+            p->write(p, word, old, val);
+        return;
+    }
+
+    if (r->kind == SIM_REGION_FLASH)
+    {
+        for (i = 0; i < t->win_len; i += 2)
+        {
+            addr = t->win + i;
+            memcpy(&old16, &t->old[i], 2);
+            memcpy(&new16, &now[i], 2);
+            if (old16 != new16 || (t->write && addr == (t->addr & ~1u)))
+                sim_flash_program(addr, old16, new16);
+        }
+        return;
+    }
+
+    for (i = 0; i < t->win_len; i += 4)
+    {
+        addr = t->win + i;
+        memcpy(&old, &t->old[i], 4);
+        memcpy(&val, &now[i], 4);
+        if (old == val && !(t->write && addr == (t->addr & ~3u)))
+            continue;
+        if (sim_log_size && addr - sim_log_base < sim_log_size && sim_log_num < SIM_LOG_SIZE)
+            sim_log[sim_log_num++] = (struct sim_access){sim_now, addr, old, val};
+        p = _sim_periph(addr);
+        if (p && p->write)
+            p->write(p, addr, old, val);
+    }
+}
+
+/**=============================================================================
+ * @brief           SIGTRAP：单步结束，关上寄存器页，调用写钩子，需要时进入中断
+ *============================================================================*/
+static void _sim_step(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uint8_t now[SIM_TRAP_MAX][SIM_WIN_SIZE];
+    struct sim_trap *t;
+    int i, n;
+
+    (void)sig;
+    (void)si;
+    if (!sim_trap_active)
+    {
+        _sim_write_str("sim: unexpected SIGTRAP\n");
+        _exit(3);
+    }
+    uc->uc_mcontext.gregs[REG_EFL] &= ~(greg_t)SIM_X86_TF;
+
+    n = sim_trap_num;
+    for (i = 0; i < n; i++)
+    {
+        t = &sim_traps[i];
+        mprotect((void *)((uintptr_t)t->addr & ~(uintptr_t)(SIM_PAGE_SIZE - 1)), SIM_PAGE_SIZE, t->region->prot);
+        memcpy(now[i], t->region->shadow + (t->win - t->region->base), SIM_WIN_SIZE);
+    }
+    sim_trap_num = 0;
+    sim_trap_active = 0;
+
+    for (i = 0; i < n; i++)
+        _sim_commit(&sim_traps[i], now[i]);
+
+    sim_accesses++;
+    sim_now += sim_cycles_to_ns(SIM_ACCESS_CYCLES, sim_clock_hclk());
+    _sim_events_run();
+
+    if (_sim_irq_next() != -2)
+        _sim_inject(uc);
+}
+
+/**=============================================================================
+ * @brief           SIGILL：跳板执行完毕，恢复被打断的现场
+ *============================================================================*/
+static void _sim_irq_resume(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    struct sim_frame *frame;
+    char buf[96];
+
+    (void)sig;
+    (void)si;
+    if ((uintptr_t)uc->uc_mcontext.gregs[REG_RIP] != (uintptr_t)sim_irq_return)
+    {
+        snprintf(buf, sizeof(buf), "sim: illegal instruction at pc %p\n",
+                 (void *)uc->uc_mcontext.gregs[REG_RIP]);
+        _sim_write_str(buf);
+        _exit(3);
+    }
+
+    frame = (struct sim_frame *)uc->uc_mcontext.gregs[REG_RDI];
+    memcpy(uc->uc_mcontext.gregs, frame->gregs, sizeof(frame->gregs));
+    memcpy(uc->uc_mcontext.fpregs, &frame->fp, sizeof(frame->fp));
+}
+
+/**=============================================================================
+ * @brief           SIGPROF：随机时刻打断固件代码，挂起指定中断
+ *============================================================================*/
+static void _sim_preempt(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uintptr_t rip = (uintptr_t)uc->uc_mcontext.gregs[REG_RIP];
+
+    (void)sig;
+    (void)si;
+    if (!sim_preempt_on || sim_trap_active || __sim_fw_text_start == NULL ||
+        rip < (uintptr_t)__sim_fw_text_start || rip >= (uintptr_t)__sim_fw_text_end)
+        return;
+
+    if ((int)sim_preempt_irq >= 0)
+        sim_irq_pend(sim_preempt_irq);
+    if (_sim_irq_next() != -2)
+        _sim_inject(uc);
+}
+
+/**=============================================================================
+ * @brief           建立固定地址映射和影子映射
+ *============================================================================*/
+static void _sim_map(void)
+{
+    struct sim_region *r;
+    void *real;
+    size_t i;
+    int fd;
+
+    for (i = 0; i < SIM_REGION_NUM; i++)
+    {
+        r = &sim_regions[i];
+        fd = memfd_create("sim", 0);
+        if (fd < 0 || ftruncate(fd, r->size) != 0)
+            sim_fatal("memfd for 0x%08x failed", r->base);
+
+        real = mmap((void *)(uintptr_t)r->base, r->size, r->prot,
+                    MAP_SHARED | MAP_FIXED_NOREPLACE, fd, 0);
+        if (real != (void *)(uintptr_t)r->base)
+            sim_fatal("cannot map 0x%08x", r->base);
+        r->shadow = mmap(NULL, r->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (r->shadow == MAP_FAILED)
+            sim_fatal("cannot map shadow of 0x%08x", r->base);
+        close(fd);
+    }
+}
+
+/**=============================================================================
+ * @brief           安装信号处理
+ *============================================================================*/
+static void _sim_signals(void)
+{
+    struct sigaction sa;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, SIGPROF);
+
+    sa.sa_sigaction = _sim_segv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sigaction(SIGBUS, &sa, NULL);
+    sa.sa_sigaction = _sim_step;
+    sigaction(SIGTRAP, &sa, NULL);
+    sa.sa_sigaction = _sim_irq_resume;
+    sigaction(SIGILL, &sa, NULL);
+    sa.sa_sigaction = _sim_preempt;
+    sigaction(SIGPROF, &sa, NULL);
+}
+
+/**=============================================================================
+ * @brief           启动上下文：板级初始化后交给调度器
+ *============================================================================*/
+static void _sim_boot(void)
+{
+    if (sim_flags & SIM_BOOT_BOARD)
+        rt_hw_board_init();
+
+    sim_host_start(sim_entry, (sim_flags & SIM_BOOT_COMPONENTS) == SIM_BOOT_COMPONENTS);
+    swapcontext(&sim_boot_ctx, &sim_host_ctx);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           终止模拟并打印原因
+ *============================================================================*/
+void sim_fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    fflush(stdout);
+    fprintf(stderr, "sim: ");
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, " (t=%llu ns)\n", (unsigned long long)sim_now);
+    fflush(stderr);
+    _exit(2);
+}
+
+/**=============================================================================
+ * @brief           建立模拟环境并运行
+ *
+ * @param[in]       entry 在主线程中运行的测试函数
+ * @param[in]       flags SIM_BOOT_xxx
+ *
+ * @return          进程退出码，测试失败时非 0
+ *============================================================================*/
+int sim_run(void (*entry)(void), int flags)
+{
+    struct sim_periph *p;
+    void *stack;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    _sim_map();
+    _sim_signals();
+    for (p = sim_periphs; p; p = p->next)
+    {
+        if (p->reset)
+            p->reset(p);
+    }
+
+    sim_entry = entry;
+    sim_flags = flags;
+    stack = sim_alloc_low(SIM_BOOT_STACK_SIZE);
+    getcontext(&sim_boot_ctx);
+    sim_boot_ctx.uc_stack.ss_sp   = stack;
+    sim_boot_ctx.uc_stack.ss_size = SIM_BOOT_STACK_SIZE;
+    sim_boot_ctx.uc_link          = NULL;
+    makecontext(&sim_boot_ctx, _sim_boot, 0);
+    swapcontext(&sim_host_ctx, &sim_boot_ctx);
+
+    return sim_host_exit_code();
+}
+
+/**=============================================================================
+ * @brief           主线程结束，回到 sim_run 的调用者
+ *============================================================================*/
+void sim_host_return(void)
+{
+    setitimer(ITIMER_PROF, &(struct itimerval){{0, 0}, {0, 0}}, NULL);
+    sim_preempt_on = 0;
+    setcontext(&sim_host_ctx);
+    __builtin_unreachable();
+}
+
+/**=============================================================================
+ * @brief           所有线程都阻塞时允许的最长模拟时间，超过认为死锁
+ *============================================================================*/
+void sim_set_time_limit(uint64_t ns)
+{
+    sim_limit = ns;
+}
+
+/**=============================================================================
+ * @brief           4GB 以下的可读写内存，用作线程栈和 DMA 缓冲
+ *============================================================================*/
+void *sim_alloc_low(size_t size)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+
+    if (p == MAP_FAILED)
+        sim_fatal("no low memory for %zu bytes", size);
+    return p;
+}
+
+/**=============================================================================
+ * @brief           寄存器或 flash 地址在影子映射中的位置
+ *============================================================================*/
+void *sim_shadow(uint32_t addr)
+{
+    struct sim_region *r = _sim_region(addr);
+
+    if (r == NULL || r->shadow == NULL)
+        sim_fatal("no shadow for 0x%08x", addr);
+    return r->shadow + (addr - r->base);
+}
+
+/**=============================================================================
+ * @brief           地址是否落在模拟的映射区内
+ *============================================================================*/
+int sim_is_mapped(uint32_t addr)
+{
+    return _sim_region(addr) != NULL;
+}
+
+/**=============================================================================
+ * @brief           登记外设模型，通常在构造函数中调用
+ *============================================================================*/
+void sim_periph_register(struct sim_periph *p)
+{
+    p->next = sim_periphs;
+    sim_periphs = p;
+}
+
+/**=============================================================================
+ * @brief           总线读，供 DMA 模型使用
+ *
+ * @param[in]       addr 外设、flash 或主机内存地址
+ * @param[in]       size 1/2/4 字节
+ *============================================================================*/
+uint32_t sim_bus_read(uint32_t addr, int size)
+{
+    struct sim_region *r = _sim_region(addr);
+    struct sim_periph *p;
+    const uint8_t *src;
+    uint32_t v = 0;
+
+    if (r == NULL)
+    {
+        if (addr < 0x10000)
+            sim_fatal("dma read from 0x%08x", addr);
+        src = (const uint8_t *)(uintptr_t)addr;
+    }
+    else
+    {
+        if (r->kind == SIM_REGION_PERIPH)
+        {
+            p = _sim_periph(addr & ~3u);
+            if (p && p->read)
+                p->read(p, addr & ~3u, 0);
+        }
+        src = r->shadow + (addr - r->base);
+    }
+    memcpy(&v, src, size);
+    return v;
+}
+
+/**=============================================================================
+ * @brief           总线写，供 DMA 模型使用，外设寄存器按 32 位写入
+ *============================================================================*/
+void sim_bus_write(uint32_t addr, uint32_t val, int size)
+{
+    struct sim_region *r = _sim_region(addr);
+    struct sim_periph *p;
+    uint32_t word, old, now;
+
+    if (r == NULL)
+    {
+        if (addr < 0x10000)
+            sim_fatal("dma write to 0x%08x", addr);
+        memcpy((void *)(uintptr_t)addr, &val, size);
+        return;
+    }
+    if (r->kind != SIM_REGION_PERIPH)
+        sim_fatal("dma write to read-only 0x%08x", addr);
+
+    word = addr & ~3u;
+    old = SIM_REG(word);
+    memcpy(r->shadow + (addr - r->base), &val, size);
+    now = SIM_REG(word);
+    p = _sim_periph(word);
+    if (p && p->write)
+        p->write(p, word, old, now);
+}
+
+/**=============================================================================
+ * @brief           当前模拟时间，纳秒
+ *============================================================================*/
+uint64_t sim_time(void)
+{
+    return sim_now;
+}
+
+/**=============================================================================
+ * @brief           周期数换算为纳秒
+ *============================================================================*/
+uint64_t sim_cycles_to_ns(uint64_t cycles, uint32_t hz)
+{
+    if (hz == 0)
+        return 0;
+    return (cycles * SIM_NS_PER_SEC + hz / 2) / hz;
+}
+
+void sim_event_init(struct sim_event *ev, void (*fn)(struct sim_event *ev), void *arg)
+{
+    memset(ev, 0, sizeof(*ev));
+    ev->fn  = fn;
+    ev->arg = arg;
+}
+
+/**=============================================================================
+ * @brief           在 when 时刻触发事件，已安排的事件改到新时刻
+ *============================================================================*/
+void sim_event_at(struct sim_event *ev, uint64_t when)
+{
+    struct sim_event **pp;
+
+    sim_event_cancel(ev);
+    ev->when = when;
+    for (pp = &sim_events; *pp && (*pp)->when <= when; pp = &(*pp)->next)
+        ;
+    ev->next = *pp;
+    *pp = ev;
+    ev->armed = 1;
+}
+
+void sim_event_cancel(struct sim_event *ev)
+{
+    struct sim_event **pp;
+
+    if (!ev->armed)
+        return;
+    for (pp = &sim_events; *pp; pp = &(*pp)->next)
+    {
+        if (*pp == ev)
+        {
+            *pp = ev->next;
+            break;
+        }
+    }
+    ev->armed = 0;
+    ev->next = NULL;
+}
+
+/**=============================================================================
+ * @brief           推进模拟时间，途中按时刻执行事件和中断
+ *
+ * @param[in]       ns 推进的纳秒数
+ *
+ * @note            相当于 CPU 在这段时间里空转，不会切换线程
+ *============================================================================*/
+void sim_advance(uint64_t ns)
+{
+    uint64_t target = sim_now + ns;
+
+    while (sim_events && sim_events->when <= target)
+    {
+        if (sim_events->when > sim_now)
+            sim_now = sim_events->when;
+        _sim_events_run();
+        sim_irq_deliver();
+    }
+    sim_now = target;
+    sim_irq_deliver();
+}
+
+/**=============================================================================
+ * @brief           所有线程阻塞时，时间跳到下一个事件
+ *
+ * @return          0 表示已没有任何事件，系统死锁
+ *============================================================================*/
+int sim_idle(void)
+{
+    uint32_t primask = sim_primask;
+
+    if (sim_events == NULL)
+        return 0;
+    if (sim_events->when > sim_limit)
+        sim_fatal("all threads blocked past the time limit");
+
+    if (sim_events->when > sim_now)
+        sim_now = sim_events->when;
+    _sim_events_run();
+
+    /* 空闲线程总是开中断运行 */
+    sim_primask = 0;
+    sim_irq_deliver();
+    sim_primask = primask;
+
+    return 1;
+}
+
+/**=============================================================================
+ * @brief           挂起外设中断
+ *============================================================================*/
+void sim_irq_pend(IRQn_Type irq)
+{
+    if ((int)irq == (int)SysTick_IRQn)
+        sim_systick_pending = 1;
+    else
+        SIM_PERIPH(NVIC_Type, NVIC)->ISPR[irq >> 5] |= 1u << (irq & 31);
+    SIM_PERIPH(NVIC_Type, NVIC)->ICPR[0] = SIM_PERIPH(NVIC_Type, NVIC)->ISPR[0];
+    SIM_PERIPH(NVIC_Type, NVIC)->ICPR[1] = SIM_PERIPH(NVIC_Type, NVIC)->ISPR[1];
+}
+
+void sim_irq_unpend(IRQn_Type irq)
+{
+    if ((int)irq == (int)SysTick_IRQn)
+        sim_systick_pending = 0;
+    else
+        SIM_PERIPH(NVIC_Type, NVIC)->ISPR[irq >> 5] &= ~(1u << (irq & 31));
+    SIM_PERIPH(NVIC_Type, NVIC)->ICPR[0] = SIM_PERIPH(NVIC_Type, NVIC)->ISPR[0];
+    SIM_PERIPH(NVIC_Type, NVIC)->ICPR[1] = SIM_PERIPH(NVIC_Type, NVIC)->ISPR[1];
+}
+
+int sim_irq_is_pending(IRQn_Type irq)
+{
+    if ((int)irq == (int)SysTick_IRQn)
+        return sim_systick_pending;
+    return (SIM_PERIPH(NVIC_Type, NVIC)->ISPR[irq >> 5] >> (irq & 31)) & 1u;
+}
+
+/**=============================================================================
+ * @brief           登记外设中断线的电平，处理函数没有清除标志时中断会再次进入
+ *============================================================================*/
+void sim_irq_level_register(IRQn_Type irq, int (*level)(void *arg), void *arg)
+{
+    sim_irq_levels[irq] = level;
+    sim_irq_level_args[irq] = arg;
+}
+
+/**=============================================================================
+ * @brief           进入过的中断次数
+ *============================================================================*/
+uint32_t sim_irq_count(IRQn_Type irq)
+{
+    return sim_irq_counts[(int)irq + 1];
+}
+
+/**=============================================================================
+ * @brief           投递所有可以进入的中断，按优先级嵌套
+ *
+ * @return          投递的个数
+ *============================================================================*/
+int sim_irq_deliver(void)
+{
+    uint32_t ipsr, active;
+    void (*handler)(void);
+    int irq, n = 0;
+
+    while ((irq = _sim_irq_next()) != -2)
+    {
+        sim_irq_unpend((IRQn_Type)irq);
+        handler = (irq < 0) ? SysTick_Handler : sim_vectors[irq];
+        if (handler == NULL)
+            sim_fatal("no handler for irq %d", irq);
+
+        ipsr   = sim_ipsr;
+        active = sim_active_prio;
+        sim_ipsr        = (uint32_t)(irq + 16);
+        sim_active_prio = _sim_irq_prio(irq);
+        sim_irq_counts[irq + 1]++;
+
+        handler();
+
+        sim_ipsr        = ipsr;
+        sim_active_prio = active;
+        if (irq >= 0 && sim_irq_levels[irq] && sim_irq_levels[irq](sim_irq_level_args[irq]))
+            sim_irq_pend((IRQn_Type)irq);
+        n++;
+    }
+    return n;
+}
+
+/**=============================================================================
+ * @brief           中断的检查点：执行到期事件、投递中断，线程模式下可能切换线程
+ *============================================================================*/
+void sim_poll(void)
+{
+    _sim_events_run();
+    sim_irq_deliver();
+    if (sim_ipsr == 0 && !sim_primask)
+        sim_host_preempt();
+}
+
+/**=============================================================================
+ * @brief           跳板调用的中断入口
+ *============================================================================*/
+void sim_async_irq(void)
+{
+    sim_poll();
+}
+
+/**=============================================================================
+ * @brief           按 CPU 时间周期性地打断固件代码并挂起一个中断，
+ *                  用于检查中断与线程之间的竞争
+ *
+ * @param[in]       interval_us 间隔，0 关闭
+ * @param[in]       irq         每次挂起的中断，可为负数表示只检查已挂起的
+ *============================================================================*/
+void sim_preempt_random(uint32_t interval_us, IRQn_Type irq)
+{
+    struct itimerval it;
+
+    memset(&it, 0, sizeof(it));
+    sim_preempt_irq = irq;
+    sim_preempt_on  = interval_us != 0;
+    it.it_interval.tv_usec = interval_us;
+    it.it_value.tv_usec    = interval_us;
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+uint32_t sim_cpu_get_primask(void)
+{
+    return sim_primask;
+}
+
+void sim_cpu_set_primask(uint32_t primask)
+{
+    /* 不访问寄存器的忙等循环也要让时间前进 */
+    sim_now += sim_cycles_to_ns(SIM_PRIMASK_CYCLES, sim_clock_hclk());
+    sim_primask = primask & 1u;
+    if (!sim_primask)
+        sim_poll();
+}
+
+uint32_t sim_cpu_get_ipsr(void)
+{
+    return sim_ipsr;
+}
+
+/**=============================================================================
+ * @brief           WFI：没有可进入的中断时时间跳到下一个事件
+ *============================================================================*/
+void sim_cpu_wfi(void)
+{
+    if (_sim_irq_next() == -2 && sim_events)
+    {
+        if (sim_events->when > sim_now)
+            sim_now = sim_events->when;
+    }
+    sim_poll();
+}
+
+/**=============================================================================
+ * @brief           SysTick 的挂起位，SCB->ICSR 的读钩子使用
+ *============================================================================*/
+int sim_systick_is_pending(void)
+{
+    return sim_systick_pending;
+}
+
+/**=============================================================================
+ * @brief           开始记录 [base, base + size) 内的写访问
+ *============================================================================*/
+void sim_log_start(uint32_t base, uint32_t size)
+{
+    sim_log_num  = 0;
+    sim_log_base = base;
+    sim_log_size = size;
+}
+
+void sim_log_stop(void)
+{
+    sim_log_size = 0;
+}
+
+size_t sim_log_count(void)
+{
+    return sim_log_num;
+}
+
+const struct sim_access *sim_log_get(size_t index)
+{
+    return index < sim_log_num ? &sim_log[index] : NULL;
+}
+
+/**=============================================================================
+ * @brief           累计的寄存器访问次数
+ *============================================================================*/
+uint32_t sim_access_count(void)
+{
+    return sim_accesses;
+}
+
+/**=============================================================================
+ * @brief           线程模式下推进一点时间，供轮询 rt_tick_get 的循环前进
+ *============================================================================*/
+void sim_host_tick_poll(void)
+{
+    sim_now += sim_cycles_to_ns(8, sim_clock_hclk());
+    if (sim_primask)
+        _sim_events_run();
+    else
+        sim_poll();
+}
+
+/**=============================================================================
+ * @brief           线程切换时保存和恢复各线程的 PRIMASK
+ *============================================================================*/
+uint32_t sim_host_swap_primask(uint32_t primask)
+{
+    uint32_t old = sim_primask;
+
+    sim_primask = primask;
+    return old;
+}
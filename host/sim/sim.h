@@ -0,0 +1,293 @@
+/**
+  ******************************************************************************
+  * @file			sim.h
+  * @brief			host register-level simulator of the stm32f103rc header file
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SIM_H_
+#define __SIM_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include "stm32f1xx_hal.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/*
+ * 原理：外设、flash、系统存储区和 SCS 映射到与芯片相同的地址，固件直接
+ * 访问这些地址。外设页平时不可访问，每次访问触发 SIGSEGV，模拟器开放该页、
+ * 单步执行这条指令后再关上，前后分别调用外设模型的读、写钩子。模型通过
+ * 同一块内存的另一个可读写映射（影子）操作寄存器，不会触发陷阱。
+ *
+ * 中断：模型置挂起位后，在下一次寄存器访问结束、开中断或阻塞点投递，
+ * 按 NVIC 优先级可以嵌套。时间以纳秒计，每次寄存器访问消耗两个 HCLK，
+ * 全部线程阻塞时直接跳到下一个事件。
+ *
+ * 固件中的 uint32_t 与指针互转要求数据和栈都在 4GB 以下：可执行文件
+ * 不使用 PIE，线程栈用 MAP_32BIT 分配。
+ */
+
+/* Exported constants --------------------------------------------------------*/
+#define SIM_FLASH_SIZE          (256u * 1024u)      /*!< STM32F103RC */
+#define SIM_SRAM_SIZE           (48u * 1024u)
+#define SIM_HSE_HZ              8000000u
+#define SIM_HSI_HZ              8000000u
+
+/* sim_run 的启动选项 */
+#define SIM_BOOT_BARE           0x00    /*!< 只有复位状态的寄存器，测试自己初始化 */
+#define SIM_BOOT_BOARD          0x01    /*!< 先执行 rt_hw_board_init（含 INIT_BOARD_EXPORT） */
+#define SIM_BOOT_COMPONENTS     0x03    /*!< 再在主线程中执行 rt_components_init */
+
+/* Exported macros -----------------------------------------------------------*/
+/* 模型访问寄存器用影子映射，如 SIM_PERIPH(USART_TypeDef, USART1)->SR */
+#define SIM_PERIPH(type, inst)  ((type *)sim_shadow((uint32_t)(uintptr_t)(inst)))
+#define SIM_REG(addr)           (*(volatile uint32_t *)sim_shadow(addr))
+
+#define SIM_NS_PER_SEC          1000000000ull
+#define SIM_US(us)              ((uint64_t)(us) * 1000ull)
+#define SIM_MS(ms)              ((uint64_t)(ms) * 1000000ull)
+
+/* Exported typedef ----------------------------------------------------------*/
+struct sim_periph;
+
+/**
+ * 外设模型，覆盖 [base, base + size)
+ *
+ * read  访问前调用，for_write 非 0 表示这是写访问（可能是读改写），
+ *       模型在此刷新随时间变化的寄存器，只有读访问才应产生读副作用
+ * write 写访问后调用，old 为访问前的值，val 为固件写入后的值，
+ *       模型可以在影子中改写最终结果（如写 0 清除的标志位）
+ */
+struct sim_periph
+{
+    const char             *name;
+    uint32_t                base;
+    uint32_t                size;
+    void                  (*reset)(struct sim_periph *p);
+    void                  (*read)(struct sim_periph *p, uint32_t addr, int for_write);
+    void                  (*write)(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val);
+    void                   *priv;
+    struct sim_periph      *next;
+};
+
+/* 定时事件，回调在模拟器上下文执行，只能改寄存器和挂起中断 */
+struct sim_event
+{
+    uint64_t                when;
+    void                  (*fn)(struct sim_event *ev);
+    void                   *arg;
+    int                     armed;
+    struct sim_event       *next;
+};
+
+/* 外设的 DMA 请求线：level 非 0 时与 CPAR、方向匹配的通道持续传输 */
+struct sim_dma_line
+{
+    uint32_t                par;            /*!< 外设数据寄存器地址 */
+    int                     dir;            /*!< 1 存储器到外设 */
+    int                   (*level)(void *arg);
+    void                   *arg;
+    struct sim_dma_line    *next;
+};
+
+/* GPIO 输出的观察者：ODR 中 pins 有变化时调用，用于片选等外部器件 */
+struct sim_gpio_watch
+{
+    GPIO_TypeDef           *gpio;
+    uint16_t                pins;
+    void                  (*changed)(void *arg, uint16_t old, uint16_t odr);
+    void                   *arg;
+    struct sim_gpio_watch  *next;
+};
+
+/* SPI 从机：每帧移完时调用，mosi 为主机发出的帧，返回从机同时送出的帧 */
+typedef uint16_t (*sim_spi_xfer_t)(void *arg, uint16_t mosi, int bits);
+
+/* I2C 总线故障注入 */
+enum
+{
+    SIM_I2C_FAULT_BUSY = 1,                 /*!< BUSY 锁住，只有 SWRST 能清除 */
+    SIM_I2C_FAULT_SDA_LOW,                  /*!< 从机拉低 SDA，arg 为再经过多少个 SCL 时钟才放开 */
+    SIM_I2C_FAULT_ARLO,                     /*!< 下一个地址字节仲裁丢失，对方占用总线 arg 微秒 */
+    SIM_I2C_FAULT_STRETCH,                  /*!< 下一个数据字节从机一直拉住 SCL，直到 PE 清零或 SWRST */
+    SIM_I2C_FAULT_STRETCH_AT,               /*!< 同上，但地址和寄存器地址字节也计数，先放过 arg 个字节 */
+};
+
+/* I2C 总线统计，时间单位 ns */
+struct sim_i2c_stats
+{
+    uint32_t                starts;         /*!< 起始条件，含重复起始 */
+    uint32_t                stops;
+    uint32_t                bytes;          /*!< 含地址字节 */
+    uint32_t                nacks;          /*!< 地址无应答 */
+    uint32_t                gaps;           /*!< 停止到下一个起始的空闲间隔 */
+    uint64_t                gap_sum_ns;
+    uint64_t                gap_max_ns;
+    uint64_t                busy_ns;        /*!< 本主机占用总线的时间 */
+    uint32_t                scl_pulses;     /*!< 引脚为通用输出时 SCL 的上升沿 */
+    uint32_t                gpio_stops;     /*!< 引脚为通用输出时 SCL 高电平期间 SDA 上升 */
+    uint32_t                resets;         /*!< SWRST */
+};
+
+/* ADC 信号源：scan 为该 ADC 的 ADON 打开以来完成的扫描次数，返回 12 位结果 */
+typedef uint16_t (*sim_adc_source_t)(void *arg, uint32_t channel, uint32_t scan);
+
+/* ADC 统计 */
+struct sim_adc_stats
+{
+    uint32_t                triggers;       /*!< 收到的触发，含同步模式下主 ADC 带来的 */
+    uint32_t                scans;          /*!< 完成的规则组扫描 */
+    uint32_t                conversions;
+    uint32_t                missed;         /*!< 扫描还没完成时到来、被忽略的触发 */
+    uint32_t                overruns;       /*!< EOC 还没清除时 DR 被新结果覆盖 */
+};
+
+/* 写访问记录 */
+struct sim_access
+{
+    uint64_t                time;
+    uint32_t                addr;
+    uint32_t                old;
+    uint32_t                val;
+};
+
+/* Exported functions ------------------------------------------------------- */
+/* 启动：建立映射、复位外设模型，在低地址栈上运行 entry，返回失败断言的个数 */
+int       sim_run(void (*entry)(void), int flags);
+void      sim_fatal(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+void      sim_set_time_limit(uint64_t ns);
+
+/* 内存映射 */
+void     *sim_shadow(uint32_t addr);
+int       sim_is_mapped(uint32_t addr);
+void     *sim_alloc_low(size_t size);
+void      sim_periph_register(struct sim_periph *p);
+uint32_t  sim_bus_read(uint32_t addr, int size);
+void      sim_bus_write(uint32_t addr, uint32_t val, int size);
+
+/* 时间与事件 */
+uint64_t  sim_time(void);
+void      sim_event_init(struct sim_event *ev, void (*fn)(struct sim_event *ev), void *arg);
+void      sim_event_at(struct sim_event *ev, uint64_t when);
+void      sim_event_cancel(struct sim_event *ev);
+void      sim_advance(uint64_t ns);
+int       sim_idle(void);
+uint64_t  sim_cycles_to_ns(uint64_t cycles, uint32_t hz);
+
+/* 中断 */
+void      sim_irq_pend(IRQn_Type irq);
+void      sim_irq_unpend(IRQn_Type irq);
+int       sim_irq_is_pending(IRQn_Type irq);
+void      sim_irq_level_register(IRQn_Type irq, int (*level)(void *arg), void *arg);
+void      sim_poll(void);
+int       sim_irq_deliver(void);
+uint32_t  sim_irq_count(IRQn_Type irq);
+void      sim_preempt_random(uint32_t interval_us, IRQn_Type irq);
+
+/* CPU 状态，由 cmsis_gcc.h 和 rt_host.c 使用 */
+uint32_t  sim_cpu_get_primask(void);
+void      sim_cpu_set_primask(uint32_t primask);
+uint32_t  sim_cpu_get_ipsr(void);
+void      sim_cpu_wfi(void);
+
+/* 写访问记录，用于核对寄存器序列 */
+void      sim_log_start(uint32_t base, uint32_t size);
+void      sim_log_stop(void);
+size_t    sim_log_count(void);
+const struct sim_access *sim_log_get(size_t index);
+uint32_t  sim_access_count(void);
+
+/* 时钟树，来自 RCC 模型 */
+uint32_t  sim_clock_sysclk(void);
+uint32_t  sim_clock_hclk(void);
+uint32_t  sim_clock_pclk1(void);
+uint32_t  sim_clock_pclk2(void);
+
+/* 内核外设模型：HCLK 变化时 SysTick/DWT 重新取基准，ITM 捕获 */
+void      sim_systick_sync(void);
+void      sim_itm_attach(uint32_t ports);
+size_t    sim_itm_take(uint32_t port, uint32_t *buf, size_t max);
+size_t    sim_itm_swo_take(uint8_t *buf, size_t max);
+void      sim_itm_stall(uint32_t after, uint32_t reads);
+
+/* RCC 模型 */
+void      sim_rcc_set_hse_startup(uint64_t ns);
+
+/* FLASH 模型 */
+uint32_t  sim_flash_erase_count(uint32_t addr);
+uint32_t  sim_flash_program_count(void);
+void      sim_flash_power_cut(int32_t ops);
+
+/* GPIO 模型 */
+void      sim_gpio_drive(GPIO_TypeDef *gpio, uint16_t pins, int level);
+uint16_t  sim_gpio_output(GPIO_TypeDef *gpio);
+uint32_t  sim_gpio_odr_writes(GPIO_TypeDef *gpio);
+void      sim_gpio_watch_register(struct sim_gpio_watch *w);
+
+/* DMA 模型 */
+void      sim_dma_line_register(struct sim_dma_line *line);
+void      sim_dma_line_update(struct sim_dma_line *line);
+uint32_t  sim_dma_line_remaining(const struct sim_dma_line *line);
+
+/* UART 模型 */
+void      sim_uart_inject(USART_TypeDef *uart, const void *data, size_t len);
+size_t    sim_uart_take(USART_TypeDef *uart, void *buf, size_t max);
+void      sim_uart_echo(USART_TypeDef *uart, int on);
+int       sim_uart_tx_idle(USART_TypeDef *uart);
+uint32_t  sim_uart_overruns(USART_TypeDef *uart);
+
+/* SPI 模型 */
+void      sim_spi_attach(SPI_TypeDef *spi, sim_spi_xfer_t xfer, void *arg);
+size_t    sim_spi_take(SPI_TypeDef *spi, void *buf, size_t max);
+int       sim_spi_idle(SPI_TypeDef *spi);
+uint64_t  sim_spi_bits(SPI_TypeDef *spi);
+uint32_t  sim_spi_overruns(SPI_TypeDef *spi);
+void      sim_spi_halt(SPI_TypeDef *spi, int halt);
+
+/* I2C 模型：寄存器文件从机，SCL/SDA 在 GPIOB 上 */
+void      sim_i2c_attach(I2C_TypeDef *i2c, uint16_t addr, int reg_len, uint8_t *regs, size_t size);
+void      sim_i2c_detach(I2C_TypeDef *i2c, uint16_t addr);
+void      sim_i2c_fault(I2C_TypeDef *i2c, int fault, uint32_t arg);
+void      sim_i2c_stats(I2C_TypeDef *i2c, struct sim_i2c_stats *st, int clear);
+
+/* TIM 模型：TIM2..4 时基，TIM3 的 TRGO 接 ADC 规则组触发 */
+uint32_t  sim_tim_updates(TIM_TypeDef *tim);
+
+/* ADC 模型：ADC1/ADC2，只有 ADC1 有 DMA 请求 */
+void      sim_adc_trigger(int extsel);
+void      sim_adc_attach(ADC_TypeDef *adc, sim_adc_source_t source, void *arg);
+void      sim_adc_stats(ADC_TypeDef *adc, struct sim_adc_stats *st, int clear);
+
+/* SPI NOR 芯片（W25Qxx 命令集），挂在 SPI 上，片选为 GPIO 输出 */
+void      sim_nor_attach(SPI_TypeDef *spi, GPIO_TypeDef *cs_port, uint16_t cs_pin, uint32_t jedec_id);
+uint8_t  *sim_nor_image(void);
+uint32_t  sim_nor_size(void);
+void      sim_nor_set_timing(uint64_t page_program_ns, uint64_t sector_erase_ns);
+uint32_t  sim_nor_erase_count(uint32_t addr);
+uint32_t  sim_nor_program_count(void);
+uint32_t  sim_nor_status_polls(void);
+uint32_t  sim_nor_violations(void);
+
+/* CRC 模型 */
+uint32_t  sim_crc_words(void);
+
+/* RTC 模型 */
+void      sim_rtc_set_counter(uint32_t cnt);
+uint32_t  sim_rtc_counter(void);
+uint32_t  sim_rtc_counter_writes(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __SIM_H_ */
@@ -0,0 +1,382 @@
+/**
+  ******************************************************************************
+  * @file			sim_adc.c
+  * @brief			ADC1/ADC2 model: triggered regular scans, conversion timing,
+  *                 regular simultaneous dual mode and the ADC1 DMA request
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_ADC_NUM             2
+#define SIM_ADC_SWSTART         7u              /*!< EXTSEL 111：SWSTART */
+#define SIM_ADC_REGSIMULT       (6u << ADC_CR1_DUALMOD_Pos)
+#define SIM_ADC_DEFAULT         0x800u          /*!< 没有信号源时读到中间值 */
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_adc
+{
+    uint32_t                base;
+    sim_adc_source_t        source;
+    void                   *arg;
+
+    int                     busy;           /*!< 正在扫描规则组 */
+    uint32_t                rank;           /*!< 下一个要转换的序号 */
+    uint32_t                scan;           /*!< ADON 打开以来完成的扫描次数，交给信号源 */
+    struct sim_adc_stats    stats;
+    struct sim_event        event;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_adc adcs[SIM_ADC_NUM] =
+{
+    {ADC1_BASE},
+    {ADC2_BASE},
+};
+static struct sim_dma_line adc_line;            /*!< 只有 ADC1 有 DMA，同步模式时一次搬两个结果 */
+
+/* 各采样时间的 ADC 时钟数 x2，转换另加 12.5 个时钟 */
+static const uint16_t adc_smp_half_cycles[8] = {3, 15, 27, 57, 83, 111, 143, 479};
+
+/* Private function ----------------------------------------------------------*/
+
+static ADC_TypeDef *_adc_regs(struct sim_adc *a)
+{
+    return (ADC_TypeDef *)sim_shadow(a->base);
+}
+
+static struct sim_adc *_adc_find(uint32_t addr)
+{
+    int i;
+
+    for (i = 0; i < SIM_ADC_NUM; i++)
+    {
+        if (addr >= adcs[i].base && addr < adcs[i].base + 0x400u)
+            return &adcs[i];
+    }
+    return NULL;
+}
+
+static int _adc_dual(void)
+{
+    return (_adc_regs(&adcs[0])->CR1 & ADC_CR1_DUALMOD) == SIM_ADC_REGSIMULT;
+}
+
+/**=============================================================================
+ * @brief           ADC 时钟：PCLK2 按 ADCPRE 2/4/6/8 分频
+ *============================================================================*/
+static uint32_t _adc_clock(void)
+{
+    uint32_t pre = (SIM_PERIPH(RCC_TypeDef, RCC)->CFGR & RCC_CFGR_ADCPRE) >> RCC_CFGR_ADCPRE_Pos;
+
+    return sim_clock_pclk2() / ((pre + 1u) * 2u);
+}
+
+static uint32_t _adc_ranks(struct sim_adc *a)
+{
+    ADC_TypeDef *r = _adc_regs(a);
+
+    if (!(r->CR1 & ADC_CR1_SCAN))
+        return 1;
+    return ((r->SQR1 & ADC_SQR1_L) >> ADC_SQR1_L_Pos) + 1u;
+}
+
+/**=============================================================================
+ * @brief           规则组第 rank 个（从 0 开始）的通道
+ *============================================================================*/
+static uint32_t _adc_channel(struct sim_adc *a, uint32_t rank)
+{
+    ADC_TypeDef *r = _adc_regs(a);
+
+    if (rank < 6)
+        return (r->SQR3 >> (5u * rank)) & 0x1Fu;
+    if (rank < 12)
+        return (r->SQR2 >> (5u * (rank - 6u))) & 0x1Fu;
+    return (r->SQR1 >> (5u * (rank - 12u))) & 0x1Fu;
+}
+
+/**=============================================================================
+ * @brief           一次转换的 ADC 时钟数 x2：采样时间加 12.5
+ *============================================================================*/
+static uint32_t _adc_half_cycles(struct sim_adc *a, uint32_t rank)
+{
+    ADC_TypeDef *r = _adc_regs(a);
+    uint32_t ch = _adc_channel(a, rank), smp;
+
+    if (ch < 10)
+        smp = (r->SMPR2 >> (3u * ch)) & 7u;
+    else
+        smp = (r->SMPR1 >> (3u * (ch - 10u))) & 7u;
+    return adc_smp_half_cycles[smp] + 25u;
+}
+
+static int _adc_irq_level(void *arg)
+{
+    ADC_TypeDef *r;
+    int i;
+
+    (void)arg;
+    for (i = 0; i < SIM_ADC_NUM; i++)
+    {
+        r = _adc_regs(&adcs[i]);
+        if ((r->SR & ADC_SR_EOC) && (r->CR1 & ADC_CR1_EOCIE))
+            return 1;
+    }
+    return 0;
+}
+
+static int _adc_dma_level(void *arg)
+{
+    ADC_TypeDef *r = _adc_regs(&adcs[0]);
+
+    (void)arg;
+    return (r->CR2 & ADC_CR2_DMA) && (r->SR & ADC_SR_EOC);
+}
+
+/**=============================================================================
+ * @brief           安排下一次转换结束，同步模式取两个 ADC 中较长的一个
+ *============================================================================*/
+static void _adc_schedule(struct sim_adc *a)
+{
+    uint32_t half = _adc_half_cycles(a, a->rank), slave;
+
+    if (a == &adcs[0] && _adc_dual() && adcs[1].busy)
+    {
+        slave = _adc_half_cycles(&adcs[1], adcs[1].rank);
+        if (slave > half)
+            half = slave;
+    }
+    sim_event_at(&a->event, sim_time() + sim_cycles_to_ns(half, _adc_clock() * 2u));
+}
+
+/**=============================================================================
+ * @brief           开始一次规则组扫描，上一次还没完成时记为丢失的触发
+ *
+ * @return          0 没有开始
+ *============================================================================*/
+static int _adc_begin(struct sim_adc *a)
+{
+    ADC_TypeDef *r = _adc_regs(a);
+
+    a->stats.triggers++;
+    if (a->busy)
+    {
+        a->stats.missed++;
+        return 0;
+    }
+    a->busy = 1;
+    a->rank = 0;
+    r->SR |= ADC_SR_STRT;
+    r->CR2 &= ~ADC_CR2_SWSTART;
+    return 1;
+}
+
+/**=============================================================================
+ * @brief           触发一个 ADC，同步模式下主 ADC 同时启动从 ADC
+ *============================================================================*/
+static void _adc_start(struct sim_adc *a)
+{
+    int started = _adc_begin(a);
+
+    if (a == &adcs[0] && _adc_dual() && (_adc_regs(&adcs[1])->CR2 & ADC_CR2_ADON))
+        _adc_begin(&adcs[1]);
+    if (started)
+        _adc_schedule(a);
+}
+
+/**=============================================================================
+ * @brief           取一个转换结果，按 ALIGN 对齐
+ *============================================================================*/
+static uint32_t _adc_sample(struct sim_adc *a)
+{
+    uint32_t ch = _adc_channel(a, a->rank), v;
+
+    v = a->source ? a->source(a->arg, ch, a->scan) : SIM_ADC_DEFAULT;
+    v &= 0xFFFu;
+    if (_adc_regs(a)->CR2 & ADC_CR2_ALIGN)
+        v <<= 4;
+    return v;
+}
+
+/**=============================================================================
+ * @brief           结果写入 DR、置 EOC，扫描完则结束，连续模式重新开始
+ *
+ * @return          本次转换的结果
+ *============================================================================*/
+static uint32_t _adc_complete(struct sim_adc *a)
+{
+    ADC_TypeDef *r = _adc_regs(a);
+    uint32_t v = _adc_sample(a);
+
+    /* 同步模式的结果都从 ADC1 DR 读出，ADC2 的 EOC 不会被清除 */
+    if ((r->SR & ADC_SR_EOC) && !(a == &adcs[1] && _adc_dual()))
+        a->stats.overruns++;
+    r->DR = v;
+    r->SR |= ADC_SR_EOC;
+    a->stats.conversions++;
+    if (++a->rank >= _adc_ranks(a))
+    {
+        a->busy = 0;
+        a->scan++;
+        a->stats.scans++;
+    }
+    return v;
+}
+
+static void _adc_convert(struct sim_event *ev)
+{
+    struct sim_adc *a = ev->arg, *s = &adcs[1];
+    ADC_TypeDef *r = _adc_regs(a);
+    uint32_t v;
+
+    /* 同步模式：从 ADC 跟着主 ADC 的节拍，ADC1 DR 高半字为 ADC2 的结果 */
+    if (a == &adcs[0] && _adc_dual() && s->busy)
+    {
+        v = _adc_complete(s);
+        _adc_complete(a);
+        r->DR |= v << 16;
+        if (!a->busy)
+            s->busy = 0;
+    }
+    else
+    {
+        _adc_complete(a);
+    }
+
+    if (a->busy)
+        _adc_schedule(a);
+    else if (r->CR2 & ADC_CR2_CONT)
+        _adc_start(a);
+
+    sim_dma_line_update(&adc_line);
+    if (_adc_irq_level(NULL))
+        sim_irq_pend(ADC1_2_IRQn);
+}
+
+static void _adc_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    struct sim_adc *a = _adc_find(addr);
+
+    (void)p;
+    if (!for_write && addr - a->base == 0x4Cu)      /* 读 DR 清 EOC */
+        _adc_regs(a)->SR &= ~ADC_SR_EOC;
+}
+
+static void _adc_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    struct sim_adc *a = _adc_find(addr);
+    ADC_TypeDef *r = _adc_regs(a);
+
+    (void)p;
+    switch (addr - a->base)
+    {
+    case 0x00:                                  /* SR 写 0 清除 */
+        r->SR = old & val;
+        break;
+    case 0x08:                                  /* CR2：校准立即完成 */
+        r->CR2 = val & ~(ADC_CR2_CAL | ADC_CR2_RSTCAL);
+        if ((val & ADC_CR2_ADON) && !(old & ADC_CR2_ADON))
+            a->scan = 0;
+        if (!(val & ADC_CR2_ADON))
+        {
+            a->busy = 0;
+            sim_event_cancel(&a->event);
+            r->CR2 &= ~ADC_CR2_SWSTART;
+        }
+        else if ((val & ADC_CR2_SWSTART) && (val & ADC_CR2_EXTTRIG) &&
+                 (val & ADC_CR2_EXTSEL) >> ADC_CR2_EXTSEL_Pos == SIM_ADC_SWSTART &&
+                 !(a == &adcs[1] && _adc_dual()))
+        {
+            _adc_start(a);
+        }
+        break;
+    case 0x4C:                                  /* DR 只读 */
+        r->DR = old;
+        break;
+    default:
+        break;
+    }
+    sim_dma_line_update(&adc_line);
+    if (_adc_irq_level(NULL))
+        sim_irq_pend(ADC1_2_IRQn);
+}
+
+static void _adc_reset(struct sim_periph *p)
+{
+    struct sim_adc *a;
+    int i;
+
+    (void)p;
+    for (i = 0; i < SIM_ADC_NUM; i++)
+    {
+        a = &adcs[i];
+        memset(_adc_regs(a), 0, sizeof(ADC_TypeDef));
+        a->source = NULL;
+        a->arg = NULL;
+        a->busy = 0;
+        a->rank = a->scan = 0;
+        memset(&a->stats, 0, sizeof(a->stats));
+        sim_event_init(&a->event, _adc_convert, a);
+    }
+    adc_line = (struct sim_dma_line){ADC1_BASE + 0x4Cu, 0, _adc_dma_level, NULL, adc_line.next};
+}
+
+static struct sim_periph sim_adc1 = {"ADC1", ADC1_BASE, 0x400, _adc_reset, _adc_read, _adc_write, NULL, NULL};
+static struct sim_periph sim_adc2 = {"ADC2", ADC2_BASE, 0x400, NULL, _adc_read, _adc_write, NULL, NULL};
+
+__attribute__((constructor)) static void _sim_adc_register(void)
+{
+    sim_periph_register(&sim_adc1);
+    sim_periph_register(&sim_adc2);
+    sim_irq_level_register(ADC1_2_IRQn, _adc_irq_level, NULL);
+    sim_dma_line_register(&adc_line);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           外部触发：EXTTRIG 打开且 EXTSEL 选中 extsel 的 ADC 开始扫描
+ *
+ * @param[in]       extsel 规则组触发源编号，如 4 为 TIM3 TRGO
+ *============================================================================*/
+void sim_adc_trigger(int extsel)
+{
+    ADC_TypeDef *r;
+    int i;
+
+    for (i = 0; i < SIM_ADC_NUM; i++)
+    {
+        r = _adc_regs(&adcs[i]);
+        if ((r->CR2 & (ADC_CR2_ADON | ADC_CR2_EXTTRIG)) == (ADC_CR2_ADON | ADC_CR2_EXTTRIG) &&
+            (int)((r->CR2 & ADC_CR2_EXTSEL) >> ADC_CR2_EXTSEL_Pos) == extsel)
+            _adc_start(&adcs[i]);
+    }
+}
+
+/**=============================================================================
+ * @brief           设置 ADC 输入的信号源，NULL 恢复为固定的中间值
+ *============================================================================*/
+void sim_adc_attach(ADC_TypeDef *adc, sim_adc_source_t source, void *arg)
+{
+    struct sim_adc *a = _adc_find((uint32_t)(uintptr_t)adc);
+
+    a->source = source;
+    a->arg = arg;
+}
+
+void sim_adc_stats(ADC_TypeDef *adc, struct sim_adc_stats *st, int clear)
+{
+    struct sim_adc *a = _adc_find((uint32_t)(uintptr_t)adc);
+
+    *st = a->stats;
+    if (clear)
+        memset(&a->stats, 0, sizeof(a->stats));
+}
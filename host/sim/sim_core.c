@@ -0,0 +1,429 @@
+/**
+  ******************************************************************************
+  * @file			sim_core.c
+  * @brief			cortex-m3 core peripherals model: NVIC, SCB, SysTick, DWT, ITM
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+#include "sim_host.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_SCS_BASE            0xE000E000u
+#define SIM_ITM_BASE            0xE0000000u
+#define SIM_ITM_PORTS           32
+#define SIM_ITM_CAPTURE         16384       /*!< 每个端口保存的字数 */
+#define SIM_SWO_CAPTURE         (256u * 1024u)  /*!< SWO 线上保存的字节数 */
+
+/* Private typedef -----------------------------------------------------------*/
+/* 按 HCLK 或 HCLK/8 计数的自由计数器，时钟变化时重新取基准 */
+struct sim_counter
+{
+    uint64_t                t0;             /*!< 基准时刻 */
+    uint64_t                p0;             /*!< 基准时刻的计数 */
+    uint32_t                hz;             /*!< 当前计数频率，0 为停止 */
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_counter   st_cnt;         /*!< SysTick 自重装以来的计数 */
+static uint64_t             st_mark;        /*!< 上次同步时已回零的次数 */
+static uint32_t             st_flag;        /*!< COUNTFLAG */
+static struct sim_event     st_event;
+
+static struct sim_counter   dwt_cnt;
+
+static uint32_t             itm_buf[SIM_ITM_PORTS][SIM_ITM_CAPTURE];
+static uint32_t             itm_num[SIM_ITM_PORTS];
+static uint8_t              swo_buf[SIM_SWO_CAPTURE];
+static size_t               swo_num;
+static uint32_t             itm_ready;      /*!< 还有这么多次读端口为就绪 */
+static uint32_t             itm_stall;      /*!< 之后这么多次读端口时 FIFO 为满 */
+
+/* Private function ----------------------------------------------------------*/
+
+static uint64_t _counter_now(const struct sim_counter *c)
+{
+    return c->p0 + (sim_time() - c->t0) * c->hz / SIM_NS_PER_SEC;
+}
+
+static void _counter_rebase(struct sim_counter *c, uint32_t hz)
+{
+    c->p0 = _counter_now(c);
+    c->t0 = sim_time();
+    c->hz = hz;
+}
+
+/**=============================================================================
+ * @brief           SysTick 的计数频率
+ *============================================================================*/
+static uint32_t _st_hz(void)
+{
+    SysTick_Type *st = SIM_PERIPH(SysTick_Type, SysTick);
+
+    if (!(st->CTRL & SysTick_CTRL_ENABLE_Msk))
+        return 0;
+    return (st->CTRL & SysTick_CTRL_CLKSOURCE_Msk) ? sim_clock_hclk() : sim_clock_hclk() / 8u;
+}
+
+static uint64_t _st_period(void)
+{
+    return (uint64_t)(SIM_PERIPH(SysTick_Type, SysTick)->LOAD & SysTick_LOAD_RELOAD_Msk) + 1u;
+}
+
+/* 计数 p 时已经回零的次数：计数从 LOAD 开始，p = LOAD 时第一次到 0 */
+static uint64_t _st_zeros(uint64_t p)
+{
+    return (p + 1u) / _st_period();
+}
+
+/**=============================================================================
+ * @brief           计算当前 VAL 和 COUNTFLAG，写回影子
+ *============================================================================*/
+static void _st_update(void)
+{
+    SysTick_Type *st = SIM_PERIPH(SysTick_Type, SysTick);
+    uint64_t p = _counter_now(&st_cnt), zeros = _st_zeros(p);
+
+    if (zeros != st_mark)
+        st_flag = 1;
+    st_mark = zeros;
+    st->VAL = (uint32_t)(_st_period() - 1u - p % _st_period());
+    st->CTRL = (st->CTRL & ~SysTick_CTRL_COUNTFLAG_Msk) | (st_flag ? SysTick_CTRL_COUNTFLAG_Msk : 0u);
+}
+
+/**=============================================================================
+ * @brief           安排下一次回零
+ *============================================================================*/
+static void _st_schedule(void)
+{
+    uint64_t p, next, cycles;
+
+    if (st_cnt.hz == 0)
+    {
+        sim_event_cancel(&st_event);
+        return;
+    }
+    p = _counter_now(&st_cnt);
+    next = (_st_zeros(p) + 1u) * _st_period() - 1u;
+    cycles = next - st_cnt.p0;
+    /* 向上取整，事件时刻的计数一定已经到达 next */
+    sim_event_at(&st_event, st_cnt.t0 + (cycles * SIM_NS_PER_SEC + st_cnt.hz - 1u) / st_cnt.hz);
+}
+
+static void _st_tick(struct sim_event *ev)
+{
+    (void)ev;
+    _st_update();
+    if (SIM_PERIPH(SysTick_Type, SysTick)->CTRL & SysTick_CTRL_TICKINT_Msk)
+        sim_irq_pend(SysTick_IRQn);
+    _st_schedule();
+}
+
+/**=============================================================================
+ * @brief           从 SysTick 当前计数 val 重新开始
+ *============================================================================*/
+static void _st_restart(uint32_t val)
+{
+    uint64_t period = _st_period();
+
+    if (val >= period)
+        val = (uint32_t)(period - 1u);
+    st_cnt.t0 = sim_time();
+    st_cnt.p0 = period - 1u - val;
+    st_cnt.hz = _st_hz();
+    st_mark   = _st_zeros(st_cnt.p0);
+    _st_update();
+    _st_schedule();
+}
+
+static void _scs_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    SCB_Type *scb = SIM_PERIPH(SCB_Type, SCB);
+    uint32_t icsr;
+
+    (void)p;
+    if (addr == (uint32_t)(uintptr_t)&SysTick->CTRL || addr == (uint32_t)(uintptr_t)&SysTick->VAL)
+    {
+        _st_update();
+        /* 读 CTRL 清 COUNTFLAG，影子里保留本次读到的值 */
+        if (addr == (uint32_t)(uintptr_t)&SysTick->CTRL && !for_write)
+            st_flag = 0;
+    }
+    else if (addr == (uint32_t)(uintptr_t)&SCB->ICSR)
+    {
+        icsr = scb->ICSR & ~(SCB_ICSR_PENDSTSET_Msk | SCB_ICSR_PENDSTCLR_Msk | SCB_ICSR_VECTACTIVE_Msk);
+        if (sim_systick_is_pending())
+            icsr |= SCB_ICSR_PENDSTSET_Msk;
+        icsr |= sim_cpu_get_ipsr() & SCB_ICSR_VECTACTIVE_Msk;
+        scb->ICSR = icsr;
+    }
+}
+
+static void _scs_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    SysTick_Type *st = SIM_PERIPH(SysTick_Type, SysTick);
+    NVIC_Type *nvic = SIM_PERIPH(NVIC_Type, NVIC);
+    SCB_Type *scb = SIM_PERIPH(SCB_Type, SCB);
+    uint32_t base = (uint32_t)(uintptr_t)NVIC, n, irq;
+    uint32_t cur;
+
+    (void)p;
+    if (addr == (uint32_t)(uintptr_t)&SysTick->CTRL)
+    {
+        /* COUNTFLAG 只读 */
+        st->CTRL = (val & ~SysTick_CTRL_COUNTFLAG_Msk) | (old & SysTick_CTRL_COUNTFLAG_Msk);
+        _counter_rebase(&st_cnt, _st_hz());
+        _st_update();
+        _st_schedule();
+    }
+    else if (addr == (uint32_t)(uintptr_t)&SysTick->VAL)
+    {
+        /* 写任意值清零计数器和 COUNTFLAG，下一个时钟重装 */
+        _st_restart(0);
+        st_flag = 0;
+        _st_update();
+    }
+    else if (addr == (uint32_t)(uintptr_t)&SysTick->LOAD)
+    {
+        st->LOAD = old;
+        _st_update();
+        cur = st->VAL;
+        st->LOAD = val & SysTick_LOAD_RELOAD_Msk;
+        _st_restart(cur);
+    }
+    else if (addr >= base && addr < base + 0x20u)
+    {
+        n = (addr - base) / 4u;
+        nvic->ISER[n] = old | val;
+        nvic->ICER[n] = nvic->ISER[n];
+    }
+    else if (addr >= base + 0x80u && addr < base + 0xA0u)
+    {
+        n = (addr - base - 0x80u) / 4u;
+        nvic->ISER[n] &= ~val;
+        nvic->ICER[n] = nvic->ISER[n];
+    }
+    else if (addr >= base + 0x100u && addr < base + 0x120u)
+    {
+        n = (addr - base - 0x100u) / 4u;
+        nvic->ISPR[n] = old;
+        for (irq = 0; irq < 32; irq++)
+        {
+            if (val & (1u << irq))
+                sim_irq_pend((IRQn_Type)(n * 32u + irq));
+        }
+    }
+    else if (addr >= base + 0x180u && addr < base + 0x1A0u)
+    {
+        n = (addr - base - 0x180u) / 4u;
+        for (irq = 0; irq < 32; irq++)
+        {
+            if (val & (1u << irq))
+                sim_irq_unpend((IRQn_Type)(n * 32u + irq));
+        }
+    }
+    else if (addr == (uint32_t)(uintptr_t)&SCB->ICSR)
+    {
+        if (val & SCB_ICSR_PENDSTSET_Msk)
+            sim_irq_pend(SysTick_IRQn);
+        if (val & SCB_ICSR_PENDSTCLR_Msk)
+            sim_irq_unpend(SysTick_IRQn);
+        scb->ICSR = old;
+    }
+    else if (addr == (uint32_t)(uintptr_t)&SCB->AIRCR)
+    {
+        /* 写入要带 VECTKEY，读出为 VECTKEYSTAT */
+        if ((val >> SCB_AIRCR_VECTKEY_Pos) == 0x05FAu)
+        {
+            if (val & SCB_AIRCR_SYSRESETREQ_Msk)
+                sim_fatal("system reset requested");
+            scb->AIRCR = (0xFA05u << SCB_AIRCR_VECTKEY_Pos) | (val & SCB_AIRCR_PRIGROUP_Msk);
+        }
+        else
+        {
+            scb->AIRCR = old;
+        }
+    }
+}
+
+static void _scs_reset(struct sim_periph *p)
+{
+    (void)p;
+    memset(sim_shadow(SIM_SCS_BASE), 0, 0x1000);
+    SIM_REG((uint32_t)(uintptr_t)&SCB->CPUID) = 0x411FC231u;
+    SIM_PERIPH(SCB_Type, SCB)->AIRCR = 0xFA050000u;
+    SIM_REG((uint32_t)(uintptr_t)&SysTick->CALIB) = 9000u;
+
+    sim_event_init(&st_event, _st_tick, NULL);
+    memset(&st_cnt, 0, sizeof(st_cnt));
+    st_mark = 0;
+    st_flag = 0;
+}
+
+static struct sim_periph sim_scs =
+{
+    .name  = "SCS",
+    .base  = SIM_SCS_BASE,
+    .size  = 0x1000,
+    .reset = _scs_reset,
+    .read  = _scs_read,
+    .write = _scs_write,
+};
+
+/**=============================================================================
+ * @brief           ITM 和 DWT：端口除注入的阻塞外总是就绪，写入的字按端口
+ *                  保存，使能的端口同时按 SWO 协议编成软件源数据包
+ *============================================================================*/
+static void _itm_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    (void)p;
+    if (addr < SIM_ITM_BASE + SIM_ITM_PORTS * 4u)
+    {
+        SIM_REG(addr) = 1u;
+        if (!for_write && itm_stall)
+        {
+            if (itm_ready)
+                itm_ready--;
+            else
+            {
+                SIM_REG(addr) = 0u;
+                itm_stall--;
+            }
+        }
+    }
+    else if (addr == (uint32_t)(uintptr_t)&DWT->CYCCNT)
+        SIM_REG(addr) = (uint32_t)_counter_now(&dwt_cnt);
+}
+
+static void _itm_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    ITM_Type *itm = SIM_PERIPH(ITM_Type, ITM);
+    uint32_t port, i;
+
+    (void)p;
+    (void)old;
+    if (addr < SIM_ITM_BASE + SIM_ITM_PORTS * 4u)
+    {
+        port = (addr - SIM_ITM_BASE) / 4u;
+        if (itm_num[port] < SIM_ITM_CAPTURE)
+            itm_buf[port][itm_num[port]++] = val;
+        SIM_REG(addr) = 1u;
+
+        /* 包头 [7:3] 端口 [2] 0 软件源 [1:0] 3 表示 4 字节，数据小端 */
+        if ((itm->TCR & ITM_TCR_ITMENA_Msk) && (itm->TER & (1u << port)) &&
+            swo_num + 5u <= SIM_SWO_CAPTURE)
+        {
+            swo_buf[swo_num++] = (uint8_t)((port << 3) | 0x3u);
+            for (i = 0; i < 4; i++)
+                swo_buf[swo_num++] = (uint8_t)(val >> (i * 8u));
+        }
+    }
+    else if (addr == (uint32_t)(uintptr_t)&DWT->CYCCNT)
+    {
+        dwt_cnt.t0 = sim_time();
+        dwt_cnt.p0 = val;
+    }
+    else if (addr == (uint32_t)(uintptr_t)&DWT->CTRL)
+    {
+        _counter_rebase(&dwt_cnt, (val & DWT_CTRL_CYCCNTENA_Msk) ? sim_clock_hclk() : 0u);
+    }
+}
+
+static void _itm_reset(struct sim_periph *p)
+{
+    (void)p;
+    memset(sim_shadow(SIM_ITM_BASE), 0, 0x3000);
+    /* DWT 有 4 个比较器 */
+    SIM_PERIPH(DWT_Type, DWT)->CTRL = 4u << DWT_CTRL_NUMCOMP_Pos;
+    memset(&dwt_cnt, 0, sizeof(dwt_cnt));
+    memset(itm_num, 0, sizeof(itm_num));
+    swo_num   = 0;
+    itm_ready = 0;
+    itm_stall = 0;
+}
+
+static struct sim_periph sim_itm =
+{
+    .name  = "ITM",
+    .base  = SIM_ITM_BASE,
+    .size  = 0x3000,
+    .reset = _itm_reset,
+    .read  = _itm_read,
+    .write = _itm_write,
+};
+
+__attribute__((constructor)) static void _sim_core_register(void)
+{
+    sim_periph_register(&sim_scs);
+    sim_periph_register(&sim_itm);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           HCLK 改变时由 RCC 模型调用，按旧频率结算后换成新频率
+ *============================================================================*/
+void sim_systick_sync(void)
+{
+    _st_update();
+    _counter_rebase(&st_cnt, _st_hz());
+    _st_schedule();
+    if (dwt_cnt.hz)
+        _counter_rebase(&dwt_cnt, sim_clock_hclk());
+}
+
+/**=============================================================================
+ * @brief           调试器连接：打开 ITM 和指定端口，相当于 SWO 查看器的设置
+ *============================================================================*/
+void sim_itm_attach(uint32_t ports)
+{
+    SIM_PERIPH(ITM_Type, ITM)->TCR |= ITM_TCR_ITMENA_Msk;
+    SIM_PERIPH(ITM_Type, ITM)->TER = ports;
+}
+
+/**=============================================================================
+ * @brief           取出端口上捕获的字
+ *
+ * @return          取出的个数
+ *============================================================================*/
+size_t sim_itm_take(uint32_t port, uint32_t *buf, size_t max)
+{
+    size_t n = itm_num[port] < max ? itm_num[port] : max;
+
+    memcpy(buf, itm_buf[port], n * sizeof(uint32_t));
+    memmove(itm_buf[port], itm_buf[port] + n, (itm_num[port] - n) * sizeof(uint32_t));
+    itm_num[port] -= (uint32_t)n;
+    return n;
+}
+
+/**=============================================================================
+ * @brief           取出 SWO 线上的字节流，与调试器捕获的格式相同
+ *
+ * @return          取出的字节数
+ *============================================================================*/
+size_t sim_itm_swo_take(uint8_t *buf, size_t max)
+{
+    size_t n = swo_num < max ? swo_num : max;
+
+    memcpy(buf, swo_buf, n);
+    memmove(swo_buf, swo_buf + n, swo_num - n);
+    swo_num -= n;
+    return n;
+}
+
+/**=============================================================================
+ * @brief           再读 after 次端口之后，接下来 reads 次读端口时 FIFO 为满，
+ *                  模拟 SWO 带宽不足
+ *============================================================================*/
+void sim_itm_stall(uint32_t after, uint32_t reads)
+{
+    itm_ready = after;
+    itm_stall = reads;
+}
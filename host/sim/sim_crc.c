@@ -0,0 +1,87 @@
+/**
+  ******************************************************************************
+  * @file			sim_crc.c
+  * @brief			CRC calculation unit model (CRC-32/MPEG-2, 32-bit words)
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "sim.h"
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t crc_words;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           按位计算：多项式 0x04C11DB7，高位在前，无反射
+ *============================================================================*/
+static uint32_t _crc_word(uint32_t crc, uint32_t data)
+{
+    int i;
+
+    crc ^= data;
+    for (i = 0; i < 32; i++)
+        crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04C11DB7u : (crc << 1);
+    return crc;
+}
+
+static void _crc_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    CRC_TypeDef *c = SIM_PERIPH(CRC_TypeDef, CRC);
+
+    (void)p;
+    if (addr == (uint32_t)(uintptr_t)&CRC->DR)
+    {
+        c->DR = _crc_word(old, val);
+        crc_words++;
+    }
+    else if (addr == (uint32_t)(uintptr_t)&CRC->IDR)
+    {
+        c->IDR = val & 0xFFu;
+    }
+    else if (addr == (uint32_t)(uintptr_t)&CRC->CR)
+    {
+        if (val & CRC_CR_RESET)
+            c->DR = 0xFFFFFFFFu;
+        c->CR = 0;
+    }
+}
+
+static void _crc_reset(struct sim_periph *p)
+{
+    (void)p;
+    SIM_PERIPH(CRC_TypeDef, CRC)->DR  = 0xFFFFFFFFu;
+    SIM_PERIPH(CRC_TypeDef, CRC)->IDR = 0;
+    SIM_PERIPH(CRC_TypeDef, CRC)->CR  = 0;
+    crc_words = 0;
+}
+
+static struct sim_periph sim_crc =
+{
+    .name  = "CRC",
+    .base  = CRC_BASE,
+    .size  = 0x400,
+    .reset = _crc_reset,
+    .write = _crc_write,
+};
+
+__attribute__((constructor)) static void _sim_crc_register(void)
+{
+    sim_periph_register(&sim_crc);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           CRC 单元累计处理的字数
+ *============================================================================*/
+uint32_t sim_crc_words(void)
+{
+    return crc_words;
+}
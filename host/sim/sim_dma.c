@@ -0,0 +1,365 @@
+/**
+  ******************************************************************************
+  * @file			sim_dma.c
+  * @brief			DMA1/DMA2 model: memory-to-memory and peripheral request lines
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_DMA_CHANNELS        12              /*!< DMA1 7 个 + DMA2 5 个 */
+#define SIM_DMA_ITEM_CYCLES     4               /*!< 存储器到存储器每项的 HCLK */
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_dma_chan
+{
+    uint32_t                reload;         /*!< 使能时的 CNDTR */
+    uint32_t                par, mar;       /*!< 当前地址 */
+    struct sim_event        event;          /*!< 存储器到存储器的完成时刻 */
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_dma_chan   dma_chans[SIM_DMA_CHANNELS];
+static struct sim_dma_line  *dma_lines;
+static int                   dma_busy;          /*!< 正在传输，外设的请求稍后统一处理 */
+static int                   dma_again;
+
+/* Private function ----------------------------------------------------------*/
+
+static DMA_TypeDef *_dma_ctrl(int ch)
+{
+    return (DMA_TypeDef *)sim_shadow(ch < 7 ? DMA1_BASE : DMA2_BASE);
+}
+
+static DMA_Channel_TypeDef *_dma_regs(int ch)
+{
+    uint32_t base = ch < 7 ? DMA1_BASE : DMA2_BASE;
+
+    return (DMA_Channel_TypeDef *)sim_shadow(base + 0x08u + 20u * (uint32_t)(ch < 7 ? ch : ch - 7));
+}
+
+static int _dma_shift(int ch)
+{
+    return 4 * (ch < 7 ? ch : ch - 7);
+}
+
+static IRQn_Type _dma_irq(int ch)
+{
+    if (ch < 7)
+        return (IRQn_Type)(DMA1_Channel1_IRQn + ch);
+    if (ch < 10)
+        return (IRQn_Type)(DMA2_Channel1_IRQn + (ch - 7));
+    return DMA2_Channel4_5_IRQn;
+}
+
+/**=============================================================================
+ * @brief           通道的中断请求：标志与使能位同时有效
+ *============================================================================*/
+static int _dma_asserted(int ch)
+{
+    uint32_t isr = _dma_ctrl(ch)->ISR >> _dma_shift(ch), ccr = _dma_regs(ch)->CCR;
+
+    return ((isr & DMA_ISR_TCIF1) && (ccr & DMA_CCR_TCIE)) ||
+           ((isr & DMA_ISR_HTIF1) && (ccr & DMA_CCR_HTIE)) ||
+           ((isr & DMA_ISR_TEIF1) && (ccr & DMA_CCR_TEIE));
+}
+
+static int _dma_irq_level(void *arg)
+{
+    int ch = (int)(intptr_t)arg;
+
+    /* DMA2 通道 4、5 共用一个中断 */
+    if (ch == 10)
+        return _dma_asserted(10) || _dma_asserted(11);
+    return _dma_asserted(ch);
+}
+
+static void _dma_irq_update(int ch)
+{
+    if (_dma_asserted(ch))
+        sim_irq_pend(_dma_irq(ch));
+}
+
+/**=============================================================================
+ * @brief           置通道标志，开了对应中断则挂起
+ *============================================================================*/
+static void _dma_flag(int ch, uint32_t flags)
+{
+    _dma_ctrl(ch)->ISR |= (flags | DMA_ISR_GIF1) << _dma_shift(ch);
+    _dma_irq_update(ch);
+}
+
+/**=============================================================================
+ * @brief           传输一项，更新地址、计数和标志
+ *
+ * @return          0 通道已无剩余
+ *============================================================================*/
+static int _dma_item(int ch)
+{
+    struct sim_dma_chan *s = &dma_chans[ch];
+    DMA_Channel_TypeDef *c = _dma_regs(ch);
+    uint32_t ccr = c->CCR, v;
+    int psize = 1 << ((ccr & DMA_CCR_PSIZE) >> DMA_CCR_PSIZE_Pos);
+    int msize = 1 << ((ccr & DMA_CCR_MSIZE) >> DMA_CCR_MSIZE_Pos);
+
+    if (!(ccr & DMA_CCR_EN) || c->CNDTR == 0)
+        return 0;
+
+    if (ccr & DMA_CCR_DIR)
+    {
+        v = sim_bus_read(s->mar, msize);
+        sim_bus_write(s->par, v, psize);
+    }
+    else
+    {
+        v = sim_bus_read(s->par, psize);
+        sim_bus_write(s->mar, v, msize);
+    }
+    if (ccr & DMA_CCR_PINC)
+        s->par += (uint32_t)psize;
+    if (ccr & DMA_CCR_MINC)
+        s->mar += (uint32_t)msize;
+
+    c->CNDTR--;
+    if (c->CNDTR == s->reload / 2u)
+        _dma_flag(ch, DMA_ISR_HTIF1);
+    if (c->CNDTR == 0)
+    {
+        if (ccr & DMA_CCR_CIRC)
+        {
+            c->CNDTR = s->reload;
+            s->par = c->CPAR;
+            s->mar = c->CMAR;
+        }
+        _dma_flag(ch, DMA_ISR_TCIF1);
+    }
+    return c->CNDTR != 0;
+}
+
+/**=============================================================================
+ * @brief           存储器到存储器：半程和结束各一个事件
+ *============================================================================*/
+static void _dma_m2m_schedule(int ch)
+{
+    DMA_Channel_TypeDef *c = _dma_regs(ch);
+    uint32_t items = c->CNDTR - (c->CNDTR > dma_chans[ch].reload / 2u ? dma_chans[ch].reload / 2u : 0u);
+
+    sim_event_at(&dma_chans[ch].event,
+                 sim_time() + sim_cycles_to_ns((uint64_t)items * SIM_DMA_ITEM_CYCLES, sim_clock_hclk()));
+}
+
+static void _dma_m2m_event(struct sim_event *ev)
+{
+    int ch = (int)(intptr_t)ev->arg;
+    DMA_Channel_TypeDef *c = _dma_regs(ch);
+    uint32_t stop = c->CNDTR > dma_chans[ch].reload / 2u ? dma_chans[ch].reload / 2u : 0u;
+
+    while (c->CNDTR > stop && _dma_item(ch))
+        ;
+    if ((c->CCR & DMA_CCR_EN) && c->CNDTR)
+        _dma_m2m_schedule(ch);
+}
+
+/**=============================================================================
+ * @brief           通道是否响应该请求线
+ *============================================================================*/
+static int _dma_match(int ch, const struct sim_dma_line *l)
+{
+    DMA_Channel_TypeDef *c = _dma_regs(ch);
+
+    return (c->CCR & DMA_CCR_EN) && !(c->CCR & DMA_CCR_MEM2MEM) && c->CPAR == l->par &&
+           ((c->CCR & DMA_CCR_DIR) != 0) == (l->dir != 0);
+}
+
+/**=============================================================================
+ * @brief           外设请求：请求线有效时持续传输
+ *============================================================================*/
+static void _dma_pump(int ch, struct sim_dma_line *l)
+{
+    while (_dma_match(ch, l) && l->level(l->arg) && _dma_item(ch))
+        ;
+}
+
+/**=============================================================================
+ * @brief           服务所有有效的请求，传输中外设再次发出的请求在本轮之后处理
+ *============================================================================*/
+static void _dma_pump_all(void)
+{
+    struct sim_dma_line *l;
+    int ch;
+
+    if (dma_busy)
+    {
+        dma_again = 1;
+        return;
+    }
+    dma_busy = 1;
+    do
+    {
+        dma_again = 0;
+        for (ch = 0; ch < SIM_DMA_CHANNELS; ch++)
+        {
+            for (l = dma_lines; l; l = l->next)
+                _dma_pump(ch, l);
+        }
+    } while (dma_again);
+    dma_busy = 0;
+}
+
+static int _dma_channel(uint32_t addr)
+{
+    uint32_t base = addr < DMA2_BASE ? DMA1_BASE : DMA2_BASE;
+    int ch = (int)((addr - base - 0x08u) / 20u);
+
+    return (base == DMA1_BASE) ? ch : ch + 7;
+}
+
+static void _dma_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    uint32_t base = addr < DMA2_BASE ? DMA1_BASE : DMA2_BASE, off = addr - base;
+    int nch = base == DMA1_BASE ? 7 : 5;
+    DMA_TypeDef *d = (DMA_TypeDef *)sim_shadow(base);
+    DMA_Channel_TypeDef *c;
+    struct sim_dma_chan *s;
+    int ch, i;
+
+    (void)p;
+    if (off == 0x00u)                           /* ISR 只读 */
+    {
+        d->ISR = old;
+        return;
+    }
+    if (off == 0x04u)                           /* IFCR 写 1 清除，读为 0 */
+    {
+        d->IFCR = 0;
+        for (i = 0; i < nch; i++)
+        {
+            if (val & (DMA_IFCR_CGIF1 << (4 * i)))
+                val |= 0xFu << (4 * i);
+        }
+        d->ISR &= ~val;
+        return;
+    }
+    if (off >= 0x08u + 20u * (uint32_t)nch)
+        return;
+
+    ch = _dma_channel(addr);
+    c = _dma_regs(ch);
+    s = &dma_chans[ch];
+
+    switch ((off - 0x08u) % 20u)
+    {
+    case 0x00:                                  /* CCR */
+        _dma_irq_update(ch);
+        if ((val & DMA_CCR_EN) && !(old & DMA_CCR_EN))
+        {
+            s->reload = c->CNDTR;
+            s->par = c->CPAR;
+            s->mar = c->CMAR;
+            if (val & DMA_CCR_MEM2MEM)
+            {
+                /* 存储器到存储器时 CPAR 为源 */
+                if (c->CNDTR)
+                    _dma_m2m_schedule(ch);
+            }
+            else
+            {
+                _dma_pump_all();
+            }
+        }
+        else if (!(val & DMA_CCR_EN))
+        {
+            sim_event_cancel(&s->event);
+        }
+        break;
+    case 0x04:                                  /* CNDTR 只能在关闭时写 */
+        if (old != val && (c->CCR & DMA_CCR_EN))
+            c->CNDTR = old;
+        else
+            c->CNDTR = val & 0xFFFFu;
+        break;
+    case 0x08:
+    case 0x0C:
+        if (c->CCR & DMA_CCR_EN)
+            *(volatile uint32_t *)sim_shadow(addr) = old;
+        break;
+    default:
+        break;
+    }
+}
+
+static void _dma_reset(struct sim_periph *p)
+{
+    int ch;
+
+    (void)p;
+    dma_busy = dma_again = 0;
+    memset(sim_shadow(DMA1_BASE), 0, 0x400);
+    memset(sim_shadow(DMA2_BASE), 0, 0x400);
+    for (ch = 0; ch < SIM_DMA_CHANNELS; ch++)
+    {
+        memset(&dma_chans[ch], 0, sizeof(dma_chans[ch]));
+        sim_event_init(&dma_chans[ch].event, _dma_m2m_event, (void *)(intptr_t)ch);
+    }
+}
+
+static struct sim_periph sim_dma =
+{
+    .name  = "DMA",
+    .base  = DMA1_BASE,
+    .size  = 0x800,
+    .reset = _dma_reset,
+    .write = _dma_write,
+};
+
+__attribute__((constructor)) static void _sim_dma_register(void)
+{
+    int ch;
+
+    sim_periph_register(&sim_dma);
+    for (ch = 0; ch < 11; ch++)
+        sim_irq_level_register(_dma_irq(ch), _dma_irq_level, (void *)(intptr_t)ch);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           登记外设的 DMA 请求线，按 CPAR 与通道匹配
+ *============================================================================*/
+void sim_dma_line_register(struct sim_dma_line *line)
+{
+    line->next = dma_lines;
+    dma_lines = line;
+}
+
+/**=============================================================================
+ * @brief           外设的请求可能变为有效，服务匹配的通道
+ *============================================================================*/
+void sim_dma_line_update(struct sim_dma_line *line)
+{
+    (void)line;
+    _dma_pump_all();
+}
+
+/**=============================================================================
+ * @brief           响应该请求线的通道还剩多少项，没有通道时返回 0
+ *============================================================================*/
+uint32_t sim_dma_line_remaining(const struct sim_dma_line *line)
+{
+    int ch;
+
+    for (ch = 0; ch < SIM_DMA_CHANNELS; ch++)
+    {
+        if (_dma_match(ch, line))
+            return _dma_regs(ch)->CNDTR;
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+/**
+  ******************************************************************************
+  * @file			sim_flash.c
+  * @brief			embedded flash model: unlock, page erase, half-word program
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+#include "sim_host.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_FLASH_PAGE          2048u           /*!< 大容量产品的页 */
+#define SIM_FLASH_PAGES         (SIM_FLASH_SIZE / SIM_FLASH_PAGE)
+#define SIM_FLASH_ERASE_NS      SIM_MS(20)      /*!< tERASE 典型值 */
+#define SIM_FLASH_PROG_NS       SIM_US(52)      /*!< tPROG 典型值 */
+#define SIM_FLASHSIZE_ADDR      0x1FFFF7E0u
+#define SIM_UID_ADDR            0x1FFFF7E8u
+
+/* Private variables ---------------------------------------------------------*/
+static uint32_t             flash_key_state;    /*!< 已写入的解锁序列长度 */
+static struct sim_event     flash_done_event;
+static uint32_t             flash_erase_counts[SIM_FLASH_PAGES];
+static uint32_t             flash_programs;
+static int32_t              flash_cut;          /*!< 还允许的编程/擦除次数，-1 不限 */
+
+/* Private function ----------------------------------------------------------*/
+
+static void _flash_done(struct sim_event *ev)
+{
+    FLASH_TypeDef *f = SIM_PERIPH(FLASH_TypeDef, FLASH);
+
+    (void)ev;
+    f->SR = (f->SR & ~FLASH_SR_BSY) | FLASH_SR_EOP;
+    if (f->CR & FLASH_CR_EOPIE)
+        sim_irq_pend(FLASH_IRQn);
+}
+
+static void _flash_busy(uint64_t ns)
+{
+    SIM_PERIPH(FLASH_TypeDef, FLASH)->SR |= FLASH_SR_BSY;
+    sim_event_at(&flash_done_event, sim_time() + ns);
+}
+
+/**=============================================================================
+ * @brief           模拟掉电：允许的操作次数用完后停止模拟
+ *============================================================================*/
+static void _flash_count_op(void)
+{
+    if (flash_cut < 0)
+        return;
+    if (flash_cut == 0)
+        sim_fatal("flash: power cut");
+    flash_cut--;
+}
+
+static void _flash_erase_page(uint32_t addr)
+{
+    uint32_t page = (addr - FLASH_BASE) / SIM_FLASH_PAGE;
+
+    if (addr < FLASH_BASE || page >= SIM_FLASH_PAGES)
+    {
+        SIM_PERIPH(FLASH_TypeDef, FLASH)->SR |= FLASH_SR_PGERR;
+        return;
+    }
+    _flash_count_op();
+    memset(sim_shadow(FLASH_BASE + page * SIM_FLASH_PAGE), 0xFF, SIM_FLASH_PAGE);
+    flash_erase_counts[page]++;
+    _flash_busy(SIM_FLASH_ERASE_NS);
+}
+
+static void _flash_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    FLASH_TypeDef *f = SIM_PERIPH(FLASH_TypeDef, FLASH);
+
+    (void)p;
+    if (addr == (uint32_t)(uintptr_t)&FLASH->KEYR)
+    {
+        if (flash_key_state == 0 && val == FLASH_KEY1)
+            flash_key_state = 1;
+        else if (flash_key_state == 1 && val == FLASH_KEY2)
+        {
+            flash_key_state = 2;
+            f->CR &= ~FLASH_CR_LOCK;
+        }
+        else
+            flash_key_state = 3;            /* 错误序列，直到复位都不能解锁 */
+        f->KEYR = 0;
+    }
+    else if (addr == (uint32_t)(uintptr_t)&FLASH->SR)
+    {
+        /* EOP、WRPRTERR、PGERR 写 1 清除，BSY 只读 */
+        f->SR = old & ~(val & (FLASH_SR_EOP | FLASH_SR_WRPRTERR | FLASH_SR_PGERR));
+    }
+    else if (addr == (uint32_t)(uintptr_t)&FLASH->CR)
+    {
+        if (old & FLASH_CR_LOCK)
+        {
+            f->CR = old;
+            return;
+        }
+        /* LOCK 只能写 1 */
+        f->CR = val | (old & FLASH_CR_LOCK);
+        if (val & FLASH_CR_LOCK)
+            flash_key_state = 0;
+        if ((val & FLASH_CR_STRT) && !(old & FLASH_CR_STRT))
+        {
+            if (f->SR & FLASH_SR_BSY)
+                sim_fatal("flash: STRT while busy");
+            if (val & FLASH_CR_PER)
+                _flash_erase_page(f->AR);
+            else if (val & FLASH_CR_MER)
+            {
+                uint32_t a;
+
+                for (a = FLASH_BASE; a < FLASH_BASE + SIM_FLASH_SIZE; a += SIM_FLASH_PAGE)
+                    _flash_erase_page(a);
+            }
+            f->CR &= ~FLASH_CR_STRT;
+        }
+    }
+}
+
+static void _flash_reset(struct sim_periph *p)
+{
+    FLASH_TypeDef *f = SIM_PERIPH(FLASH_TypeDef, FLASH);
+    static const uint32_t uid[3] = {0x0668FF49u, 0x49578349u, 0x67134822u};
+
+    (void)p;
+    memset(f, 0, sizeof(*f));
+    f->ACR = 0x30u;
+    f->CR  = FLASH_CR_LOCK;
+    f->OBR = 0x03FFFFFCu;
+    f->WRPR = 0xFFFFFFFFu;
+    flash_key_state = 0;
+    flash_programs = 0;
+    flash_cut = -1;
+    memset(flash_erase_counts, 0, sizeof(flash_erase_counts));
+    sim_event_init(&flash_done_event, _flash_done, NULL);
+
+    memset(sim_shadow(FLASH_BASE), 0xFF, SIM_FLASH_SIZE);
+    *(volatile uint16_t *)sim_shadow(SIM_FLASHSIZE_ADDR) = (uint16_t)(SIM_FLASH_SIZE / 1024u);
+    memcpy(sim_shadow(SIM_UID_ADDR), uid, sizeof(uid));
+}
+
+static struct sim_periph sim_flash =
+{
+    .name  = "FLASH",
+    .base  = FLASH_R_BASE,
+    .size  = 0x400,
+    .reset = _flash_reset,
+    .write = _flash_write,
+};
+
+__attribute__((constructor)) static void _sim_flash_register(void)
+{
+    sim_periph_register(&sim_flash);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           固件写 flash 存储区的一个半字，按 NOR 规则决定结果
+ *
+ * @param[in]       addr 半字地址
+ * @param[in]       old  写之前的内容
+ * @param[in]       val  固件写入的值，影子里已经是这个值
+ *============================================================================*/
+void sim_flash_program(uint32_t addr, uint16_t old, uint16_t val)
+{
+    FLASH_TypeDef *f = SIM_PERIPH(FLASH_TypeDef, FLASH);
+    volatile uint16_t *cell = sim_shadow(addr);
+
+    if ((f->CR & FLASH_CR_LOCK) || !(f->CR & FLASH_CR_PG))
+        sim_fatal("flash: write to 0x%08x without PG", addr);
+    if (f->SR & FLASH_SR_BSY)
+        sim_fatal("flash: write to 0x%08x while busy", addr);
+
+    /* 目标不是 0xFFFF 时只允许写 0x0000，否则 PGERR 且不编程 */
+    if (old != 0xFFFFu && val != 0x0000u)
+    {
+        *cell = old;
+        f->SR |= FLASH_SR_PGERR;
+        return;
+    }
+    _flash_count_op();
+    *cell = val;
+    flash_programs++;
+    _flash_busy(SIM_FLASH_PROG_NS);
+}
+
+/**=============================================================================
+ * @brief           页被擦除的次数
+ *============================================================================*/
+uint32_t sim_flash_erase_count(uint32_t addr)
+{
+    return flash_erase_counts[(addr - FLASH_BASE) / SIM_FLASH_PAGE];
+}
+
+uint32_t sim_flash_program_count(void)
+{
+    return flash_programs;
+}
+
+/**=============================================================================
+ * @brief           再允许 ops 次编程或擦除，之后模拟掉电；-1 取消
+ *============================================================================*/
+void sim_flash_power_cut(int32_t ops)
+{
+    flash_cut = ops;
+}
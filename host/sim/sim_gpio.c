@@ -0,0 +1,216 @@
+/**
+  ******************************************************************************
+  * @file			sim_gpio.c
+  * @brief			GPIO/AFIO model: BSRR/BRR set-reset and external pin levels
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_GPIO_PORTS          7               /*!< GPIOA..GPIOG */
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_gpio_port
+{
+    uint16_t                drive;          /*!< 外部驱动的引脚 */
+    uint16_t                level;          /*!< 外部驱动的电平 */
+    uint32_t                odr_writes;     /*!< ODR 发生变化的次数 */
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_gpio_port gpio_ports[SIM_GPIO_PORTS];
+static struct sim_gpio_watch *gpio_watches;
+
+/* Private function ----------------------------------------------------------*/
+
+static uint32_t _gpio_index(uint32_t addr)
+{
+    return (addr - GPIOA_BASE) / 0x400u;
+}
+
+static GPIO_TypeDef *_gpio_regs(uint32_t port)
+{
+    return (GPIO_TypeDef *)sim_shadow(GPIOA_BASE + port * 0x400u);
+}
+
+/**=============================================================================
+ * @brief           引脚模式：0 输入，1 输出
+ *============================================================================*/
+static int _gpio_is_output(GPIO_TypeDef *g, uint32_t pin)
+{
+    uint32_t cfg = (pin < 8u) ? (g->CRL >> (pin * 4u)) : (g->CRH >> ((pin - 8u) * 4u));
+
+    return (cfg & 0x3u) != 0;
+}
+
+/**=============================================================================
+ * @brief           IDR：输出引脚读回 ODR，开漏输出与外部驱动线与，输入引脚取
+ *                  外部电平，悬空时按上下拉
+ *============================================================================*/
+static uint32_t _gpio_idr(uint32_t port)
+{
+    GPIO_TypeDef *g = _gpio_regs(port);
+    struct sim_gpio_port *s = &gpio_ports[port];
+    uint32_t pin, idr = 0, cfg, bit;
+
+    for (pin = 0; pin < 16u; pin++)
+    {
+        bit = 1u << pin;
+        cfg = (pin < 8u) ? (g->CRL >> (pin * 4u)) : (g->CRH >> ((pin - 8u) * 4u));
+        if (_gpio_is_output(g, pin) && (cfg & 0x4u) && (s->drive & bit))
+            idr |= (g->ODR & s->level & bit);
+        else if (_gpio_is_output(g, pin))
+            idr |= (g->ODR & bit);
+        else if (s->drive & bit)
+            idr |= (s->level & bit);
+        else if ((cfg & 0xCu) == 0x8u)          /* 上拉/下拉输入由 ODR 选择 */
+            idr |= (g->ODR & bit);
+    }
+    return idr;
+}
+
+static void _gpio_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    uint32_t port = _gpio_index(addr);
+
+    (void)p;
+    (void)for_write;
+    if ((addr & 0x3FFu) == 0x08u)
+        _gpio_regs(port)->IDR = _gpio_idr(port);
+}
+
+/**=============================================================================
+ * @brief           输出变化时通知关心这些引脚的外部器件，如片选
+ *============================================================================*/
+static void _gpio_notify(uint32_t port, uint16_t old, uint16_t odr)
+{
+    struct sim_gpio_watch *w;
+
+    for (w = gpio_watches; w; w = w->next)
+    {
+        if (_gpio_index((uint32_t)(uintptr_t)w->gpio) == port && ((old ^ odr) & w->pins))
+            w->changed(w->arg, old, odr);
+    }
+}
+
+static void _gpio_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    uint32_t port = _gpio_index(addr), off = addr & 0x3FFu;
+    GPIO_TypeDef *g = _gpio_regs(port);
+    uint32_t odr = g->ODR;
+
+    (void)p;
+    switch (off)
+    {
+    case 0x08:                                  /* IDR 只读 */
+        g->IDR = old;
+        return;
+    case 0x0C:
+        odr = old & 0xFFFFu;
+        g->ODR = val & 0xFFFFu;
+        break;
+    case 0x10:                                  /* BSRR：同时置位和复位时置位优先 */
+        g->BSRR = 0;
+        g->ODR = ((g->ODR & ~(val >> 16)) | val) & 0xFFFFu;
+        break;
+    case 0x14:
+        g->BRR = 0;
+        g->ODR &= ~val & 0xFFFFu;
+        break;
+    default:
+        return;
+    }
+    if (g->ODR != odr)
+    {
+        gpio_ports[port].odr_writes++;
+        _gpio_notify(port, (uint16_t)odr, (uint16_t)g->ODR);
+    }
+}
+
+static void _gpio_reset(struct sim_periph *p)
+{
+    uint32_t port;
+
+    (void)p;
+    memset(gpio_ports, 0, sizeof(gpio_ports));
+    memset(sim_shadow(AFIO_BASE), 0, 0x400);
+    for (port = 0; port < SIM_GPIO_PORTS; port++)
+    {
+        memset(_gpio_regs(port), 0, sizeof(GPIO_TypeDef));
+        _gpio_regs(port)->CRL = 0x44444444u;     /* 浮空输入 */
+        _gpio_regs(port)->CRH = 0x44444444u;
+    }
+}
+
+static struct sim_periph sim_gpio =
+{
+    .name  = "GPIO",
+    .base  = GPIOA_BASE,
+    .size  = SIM_GPIO_PORTS * 0x400u,
+    .reset = _gpio_reset,
+    .read  = _gpio_read,
+    .write = _gpio_write,
+};
+
+__attribute__((constructor)) static void _sim_gpio_register(void)
+{
+    sim_periph_register(&sim_gpio);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           外部驱动引脚电平
+ *
+ * @param[in]       gpio  GPIOA..GPIOG
+ * @param[in]       pins  GPIO_PIN_x 的组合
+ * @param[in]       level 0/1，-1 表示撤掉外部驱动
+ *============================================================================*/
+void sim_gpio_drive(GPIO_TypeDef *gpio, uint16_t pins, int level)
+{
+    struct sim_gpio_port *s = &gpio_ports[_gpio_index((uint32_t)(uintptr_t)gpio)];
+
+    if (level < 0)
+    {
+        s->drive &= ~pins;
+        return;
+    }
+    s->drive |= pins;
+    if (level)
+        s->level |= pins;
+    else
+        s->level &= ~pins;
+}
+
+/**=============================================================================
+ * @brief           登记输出变化的观察者，复位后仍然有效
+ *============================================================================*/
+void sim_gpio_watch_register(struct sim_gpio_watch *w)
+{
+    w->next = gpio_watches;
+    gpio_watches = w;
+}
+
+/**=============================================================================
+ * @brief           引脚当前的输出电平（ODR）
+ *============================================================================*/
+uint16_t sim_gpio_output(GPIO_TypeDef *gpio)
+{
+    return (uint16_t)SIM_PERIPH(GPIO_TypeDef, gpio)->ODR;
+}
+
+/**=============================================================================
+ * @brief           ODR 被改变的次数，每次 BSRR 原子更新计一次
+ *============================================================================*/
+uint32_t sim_gpio_odr_writes(GPIO_TypeDef *gpio)
+{
+    return gpio_ports[_gpio_index((uint32_t)(uintptr_t)gpio)].odr_writes;
+}
@@ -0,0 +1,44 @@
+/**
+  ******************************************************************************
+  * @file			sim_host.h
+  * @brief			interfaces between the simulator, the kernel port and the models
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __SIM_HOST_H_
+#define __SIM_HOST_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported functions ------------------------------------------------------- */
+/* rt_host.c 提供 */
+void     sim_host_start(void (*entry)(void), int components);
+void     sim_host_preempt(void);
+int      sim_host_exit_code(void);
+void     sim_host_fail(void);
+
+/* sim.c 提供 */
+void     sim_host_return(void) __attribute__((noreturn));
+void     sim_host_tick_poll(void);
+uint32_t sim_host_swap_primask(uint32_t primask);
+int      sim_systick_is_pending(void);
+
+/* sim_flash.c 提供：flash 存储阵列被写入一个半字 */
+void     sim_flash_program(uint32_t addr, uint16_t old, uint16_t val);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __SIM_HOST_H_ */
@@ -0,0 +1,765 @@
+/**
+  ******************************************************************************
+  * @file			sim_i2c.c
+  * @brief			I2C1/I2C2 master model with register-file slaves, bit timing,
+  *                 DMA requests and bus fault injection
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_I2C_NUM             2
+#define SIM_I2C_DEVS            4               /*!< 每条总线上的从机数 */
+
+/* SR1 中由事件置位、软件清除的标志，TXE/RXNE/BTF 由状态算出 */
+#define SIM_I2C_SR1_ERRORS      (I2C_SR1_BERR | I2C_SR1_ARLO | I2C_SR1_AF | I2C_SR1_OVR | \
+                                 I2C_SR1_PECERR | I2C_SR1_TIMEOUT | I2C_SR1_SMBALERT)
+#define SIM_I2C_SR1_STATE       (I2C_SR1_TXE | I2C_SR1_RXNE | I2C_SR1_BTF)
+
+/* Private typedef -----------------------------------------------------------*/
+enum sim_i2c_action
+{
+    SIM_I2C_IDLE = 0,
+    SIM_I2C_START,
+    SIM_I2C_BYTE,
+    SIM_I2C_STOP,
+};
+
+/* 从机：寄存器文件，写操作的前 reg_len 个字节是寄存器地址，之后读写地址递增 */
+struct sim_i2c_dev
+{
+    uint16_t                addr;           /*!< 7 位地址，0 表示空闲 */
+    int                     reg_len;
+    uint8_t                *regs;
+    size_t                  size;
+    uint32_t                ptr;
+    int                     index;          /*!< 本次写操作已收到的字节数 */
+};
+
+struct sim_i2c
+{
+    uint32_t                base;
+    IRQn_Type               ev_irq;
+    IRQn_Type               er_irq;
+    uint16_t                scl;            /*!< GPIOB 上的引脚 */
+    uint16_t                sda;
+
+    int                     master;         /*!< MSL */
+    int                     own_busy;       /*!< 本主机在起始和停止之间 */
+    int                     other_busy;     /*!< 仲裁丢失后另一个主机占用总线 */
+    int                     stuck_busy;     /*!< BUSY 锁住 */
+    int                     tra;
+    int                     data;           /*!< 地址已应答且 ADDR 已清除 */
+
+    enum sim_i2c_action     action;         /*!< event 对应的总线动作 */
+    int                     shifting;       /*!< 移位寄存器正在收发一个字节 */
+    int                     shift_addr;
+    uint8_t                 shift;
+    int                     dr_full;        /*!< 发送时 DR 中有待发字节，接收时 DR 中有未读字节 */
+    uint8_t                 dr;
+    int                     tx_btf;         /*!< 发送：字节发完时 DR 中没有下一个字节，拉低 SCL */
+    int                     rx_held;        /*!< 接收：DR 未读，新字节留在移位寄存器，拉低 SCL */
+    int                     rx_ack;         /*!< 当前接收字节的应答，-1 表示字节结束时按 ACK 位 */
+    int                     nacked;         /*!< 接收：上一个字节已 NACK，不再产生时钟 */
+    uint32_t                sr1_seen;       /*!< 读 SR1 时已看到的 SB/ADDR，之后写 DR 或读 SR2 才清除 */
+    struct sim_i2c_dev     *dev;
+    struct sim_i2c_dev      devs[SIM_I2C_DEVS];
+
+    int                     arlo_armed;
+    uint64_t                arlo_hold;
+    int                     stretch_armed;
+    int                     stretch_any;    /*!< 地址字节也算，stretch_skip 个字节之后拉住 */
+    uint32_t                stretch_skip;
+    int                     stretched;
+    uint32_t                sda_hold;       /*!< 从机还要多少个 SCL 时钟才放开 SDA */
+
+    struct sim_i2c_stats    stats;
+    uint64_t                start_at;
+    uint64_t                stop_at;
+
+    struct sim_event        event;
+    struct sim_event        other;          /*!< 另一个主机释放总线 */
+    struct sim_dma_line     tx_line;
+    struct sim_dma_line     rx_line;
+    struct sim_gpio_watch   watch;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_i2c i2cs[SIM_I2C_NUM] =
+{
+    {I2C1_BASE, I2C1_EV_IRQn, I2C1_ER_IRQn, GPIO_PIN_6,  GPIO_PIN_7},
+    {I2C2_BASE, I2C2_EV_IRQn, I2C2_ER_IRQn, GPIO_PIN_10, GPIO_PIN_11},
+};
+
+/* Private function ----------------------------------------------------------*/
+
+static I2C_TypeDef *_i2c_regs(struct sim_i2c *s)
+{
+    return (I2C_TypeDef *)sim_shadow(s->base);
+}
+
+static struct sim_i2c *_i2c_find(uint32_t addr)
+{
+    int i;
+
+    for (i = 0; i < SIM_I2C_NUM; i++)
+    {
+        if (addr >= i2cs[i].base && addr < i2cs[i].base + 0x400u)
+            return &i2cs[i];
+    }
+    return NULL;
+}
+
+/**=============================================================================
+ * @brief           一个 SCL 周期：标准模式高低各 CCR 个 PCLK1，快速模式 3 或
+ *                  25 个 CCR
+ *============================================================================*/
+static uint64_t _i2c_bit_ns(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+    uint32_t ccr = r->CCR & I2C_CCR_CCR, cycles;
+
+    if (ccr < 4u)
+        ccr = 4u;
+    if (!(r->CCR & I2C_CCR_FS))
+        cycles = 2u * ccr;
+    else if (r->CCR & I2C_CCR_DUTY)
+        cycles = 25u * ccr;
+    else
+        cycles = 3u * ccr;
+    return sim_cycles_to_ns(cycles, sim_clock_pclk1());
+}
+
+static int _i2c_line_busy(struct sim_i2c *s)
+{
+    return s->own_busy || s->other_busy || s->stuck_busy || s->sda_hold != 0;
+}
+
+static int _i2c_ev_level(void *arg)
+{
+    I2C_TypeDef *r = _i2c_regs(arg);
+    uint32_t sr1 = r->SR1, cr2 = r->CR2;
+
+    if (!(cr2 & I2C_CR2_ITEVTEN))
+        return 0;
+    return (sr1 & (I2C_SR1_SB | I2C_SR1_ADDR | I2C_SR1_ADD10 | I2C_SR1_STOPF | I2C_SR1_BTF)) ||
+           ((cr2 & I2C_CR2_ITBUFEN) && (sr1 & (I2C_SR1_TXE | I2C_SR1_RXNE)));
+}
+
+static int _i2c_er_level(void *arg)
+{
+    I2C_TypeDef *r = _i2c_regs(arg);
+
+    return (r->CR2 & I2C_CR2_ITERREN) && (r->SR1 & SIM_I2C_SR1_ERRORS);
+}
+
+/**=============================================================================
+ * @brief           由内部状态刷新 SR1 的 TXE/RXNE/BTF 和 SR2，再更新中断与 DMA 请求
+ *============================================================================*/
+static void _i2c_update(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+    uint32_t sr1 = r->SR1 & ~SIM_I2C_SR1_STATE;
+
+    if (s->master && s->data && s->tra && !s->dr_full)
+    {
+        sr1 |= I2C_SR1_TXE;
+        if (s->tx_btf)
+            sr1 |= I2C_SR1_BTF;
+    }
+    if (s->master && s->data && !s->tra)
+    {
+        if (s->dr_full)
+            sr1 |= I2C_SR1_RXNE;
+        if (s->rx_held)
+            sr1 |= I2C_SR1_BTF;
+    }
+    r->SR1 = sr1;
+    r->SR2 = (s->master ? I2C_SR2_MSL : 0u) | (_i2c_line_busy(s) ? I2C_SR2_BUSY : 0u) |
+             (s->master && s->tra ? I2C_SR2_TRA : 0u);
+
+    if (_i2c_ev_level(s))
+        sim_irq_pend(s->ev_irq);
+    if (_i2c_er_level(s))
+        sim_irq_pend(s->er_irq);
+    sim_dma_line_update(&s->tx_line);
+}
+
+static void _i2c_schedule(struct sim_i2c *s, enum sim_i2c_action action, uint64_t bits)
+{
+    s->action = action;
+    sim_event_at(&s->event, sim_time() + bits * _i2c_bit_ns(s));
+}
+
+static struct sim_i2c_dev *_i2c_dev_find(struct sim_i2c *s, uint16_t addr)
+{
+    int i;
+
+    for (i = 0; i < SIM_I2C_DEVS; i++)
+    {
+        if (s->devs[i].addr == addr && addr != 0)
+            return &s->devs[i];
+    }
+    return NULL;
+}
+
+static void _i2c_dev_write(struct sim_i2c_dev *d, uint8_t byte)
+{
+    if (d->index < d->reg_len)
+    {
+        d->ptr = d->index ? (d->ptr << 8) | byte : byte;
+        d->index++;
+        return;
+    }
+    d->regs[d->ptr % d->size] = byte;
+    d->ptr++;
+}
+
+static uint8_t _i2c_dev_read(struct sim_i2c_dev *d)
+{
+    return d ? d->regs[d->ptr++ % d->size] : 0xFFu;
+}
+
+/**=============================================================================
+ * @brief           开始移出或移入一个字节；接收时 POS=1 在开始时取 ACK，
+ *                  DMA 的 LAST=1 时在字节结束时判断
+ *============================================================================*/
+static void _i2c_shift(struct sim_i2c *s, uint8_t byte, int addr)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+
+    s->shifting   = 1;
+    s->shift      = byte;
+    s->shift_addr = addr;
+    s->rx_ack     = -1;
+    if (!addr && !s->tra && (r->CR1 & I2C_CR1_POS))
+        s->rx_ack = (r->CR1 & I2C_CR1_ACK) != 0;
+    if (s->stretch_any && s->stretch_skip)
+    {
+        s->stretch_skip--;
+    }
+    else if (s->stretch_any || (!addr && s->stretch_armed))
+    {
+        /* 从机拉住 SCL，字节一直完不成 */
+        s->stretch_armed = s->stretch_any = 0;
+        s->stretched = 1;
+        return;
+    }
+    _i2c_schedule(s, SIM_I2C_BYTE, 9);
+}
+
+/**=============================================================================
+ * @brief           接收方向没有阻挡时接着收下一个字节
+ *============================================================================*/
+static void _i2c_rx_next(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+
+    if (!s->master || s->tra || !s->data || s->shifting || s->event.armed || s->rx_held ||
+        s->nacked || (r->CR1 & (I2C_CR1_START | I2C_CR1_STOP)))
+        return;
+    _i2c_shift(s, 0, 0);
+}
+
+/**=============================================================================
+ * @brief           START 请求：字节传输中或总线被占用时等待
+ *============================================================================*/
+static void _i2c_start_req(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+
+    if (!(r->CR1 & I2C_CR1_PE) || !(r->CR1 & I2C_CR1_START) || s->shifting || s->event.armed)
+        return;
+    if (!s->own_busy && _i2c_line_busy(s))
+        return;
+    _i2c_schedule(s, SIM_I2C_START, 1);
+}
+
+static void _i2c_stop_req(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+
+    if (!s->master)
+    {
+        r->CR1 &= ~I2C_CR1_STOP;
+        return;
+    }
+    if (s->shifting || s->event.armed)
+        return;
+    _i2c_schedule(s, SIM_I2C_STOP, 1);
+}
+
+/**=============================================================================
+ * @brief           放弃本主机的传输，PE 清零或 SWRST 时调用
+ *============================================================================*/
+static void _i2c_abort(struct sim_i2c *s)
+{
+    sim_event_cancel(&s->event);
+    s->action = SIM_I2C_IDLE;
+    if (s->own_busy)
+    {
+        s->stats.busy_ns += sim_time() - s->start_at;
+        s->stop_at = sim_time();
+    }
+    s->master = s->own_busy = s->tra = s->data = 0;
+    s->shifting = s->shift_addr = s->dr_full = s->tx_btf = s->rx_held = s->nacked = 0;
+    s->stretched = 0;
+    s->dev = NULL;
+}
+
+static void _i2c_start_done(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+    uint64_t gap;
+
+    r->CR1 &= ~I2C_CR1_START;
+    if (!s->own_busy && s->stats.stops)
+    {
+        gap = sim_time() - s->stop_at;
+        s->stats.gaps++;
+        s->stats.gap_sum_ns += gap;
+        if (gap > s->stats.gap_max_ns)
+            s->stats.gap_max_ns = gap;
+    }
+    if (!s->own_busy)
+        s->start_at = sim_time();
+    s->stats.starts++;
+
+    s->master = s->own_busy = 1;
+    s->tra = s->data = 0;
+    s->dr_full = s->tx_btf = s->rx_held = s->nacked = 0;
+    s->dev = NULL;
+    s->sr1_seen &= ~I2C_SR1_SB;
+    r->SR1 |= I2C_SR1_SB;
+}
+
+static void _i2c_stop_done(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+
+    r->CR1 &= ~I2C_CR1_STOP;
+    s->stats.stops++;
+    s->stats.busy_ns += sim_time() - s->start_at;
+    s->stop_at = sim_time();
+    s->master = s->own_busy = s->tra = s->data = 0;
+    s->dev = NULL;
+    r->SR1 &= ~(I2C_SR1_SB | I2C_SR1_ADDR);
+    _i2c_start_req(s);
+}
+
+/**=============================================================================
+ * @brief           一个字节（含应答位）结束
+ *============================================================================*/
+static void _i2c_byte_done(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+    int ack;
+
+    s->shifting = 0;
+    s->stats.bytes++;
+    if (s->shift_addr)
+    {
+        s->shift_addr = 0;
+        if (s->arlo_armed)
+        {
+            /* 另一个主机赢得仲裁，本主机退为从机，总线由对方占用 */
+            s->arlo_armed = 0;
+            s->stats.busy_ns += sim_time() - s->start_at;
+            s->master = s->own_busy = 0;
+            s->other_busy = 1;
+            sim_event_at(&s->other, sim_time() + s->arlo_hold);
+            r->SR1 |= I2C_SR1_ARLO;
+            return;
+        }
+        s->dev = _i2c_dev_find(s, s->shift >> 1);
+        if (s->dev == NULL)
+        {
+            s->stats.nacks++;
+            r->SR1 |= I2C_SR1_AF;
+        }
+        else
+        {
+            s->tra = !(s->shift & 1u);
+            s->dev->index = 0;
+            s->sr1_seen &= ~I2C_SR1_ADDR;
+            r->SR1 |= I2C_SR1_ADDR;
+        }
+    }
+    else if (s->tra)
+    {
+        _i2c_dev_write(s->dev, s->shift);
+        if (s->dr_full)
+        {
+            s->dr_full = 0;
+            _i2c_shift(s, s->dr, 0);
+        }
+        else
+        {
+            s->tx_btf = 1;
+        }
+    }
+    else
+    {
+        ack = s->rx_ack >= 0 ? s->rx_ack : (r->CR1 & I2C_CR1_ACK) != 0;
+        /* DMA 的 LAST=1：这是最后一项（DR 中还没取走的也算）则 NACK */
+        if ((r->CR2 & I2C_CR2_DMAEN) && (r->CR2 & I2C_CR2_LAST) &&
+            sim_dma_line_remaining(&s->rx_line) == (s->dr_full ? 2u : 1u))
+            ack = 0;
+        s->nacked = !ack;
+        s->shift = _i2c_dev_read(s->dev);
+        if (s->dr_full)
+        {
+            s->rx_held = 1;
+        }
+        else
+        {
+            s->dr = s->shift;
+            s->dr_full = 1;
+        }
+    }
+
+    if (!s->shifting)
+    {
+        if (r->CR1 & I2C_CR1_STOP)
+            _i2c_stop_req(s);
+        else if (r->CR1 & I2C_CR1_START)
+            _i2c_start_req(s);
+    }
+    _i2c_update(s);
+    _i2c_rx_next(s);
+}
+
+static void _i2c_event(struct sim_event *ev)
+{
+    struct sim_i2c *s = ev->arg;
+    enum sim_i2c_action action = s->action;
+
+    s->action = SIM_I2C_IDLE;
+    switch (action)
+    {
+    case SIM_I2C_START:
+        _i2c_start_done(s);
+        break;
+    case SIM_I2C_BYTE:
+        _i2c_byte_done(s);
+        return;
+    case SIM_I2C_STOP:
+        _i2c_stop_done(s);
+        break;
+    default:
+        break;
+    }
+    _i2c_update(s);
+}
+
+static void _i2c_other_done(struct sim_event *ev)
+{
+    struct sim_i2c *s = ev->arg;
+
+    s->other_busy = 0;
+    _i2c_start_req(s);
+    _i2c_update(s);
+}
+
+static int _i2c_tx_level(void *arg)
+{
+    I2C_TypeDef *r = _i2c_regs(arg);
+
+    return (r->CR2 & I2C_CR2_DMAEN) && (r->SR1 & I2C_SR1_TXE);
+}
+
+static int _i2c_rx_level(void *arg)
+{
+    I2C_TypeDef *r = _i2c_regs(arg);
+
+    return (r->CR2 & I2C_CR2_DMAEN) && (r->SR1 & I2C_SR1_RXNE);
+}
+
+static void _i2c_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    struct sim_i2c *s = _i2c_find(addr);
+    I2C_TypeDef *r = _i2c_regs(s);
+    uint32_t off = addr - s->base;
+
+    (void)p;
+    if (for_write)
+        return;
+    switch (off)
+    {
+    case 0x10:                                  /* DR：读出当前字节，移位寄存器中的字节补上 */
+        r->DR = s->dr;
+        if (!s->tra && s->dr_full)
+        {
+            s->dr_full = 0;
+            if (s->rx_held)
+            {
+                s->rx_held = 0;
+                s->dr = s->shift;
+                s->dr_full = 1;
+            }
+            _i2c_rx_next(s);
+            _i2c_update(s);
+        }
+        break;
+    case 0x14:
+        s->sr1_seen |= r->SR1 & (I2C_SR1_SB | I2C_SR1_ADDR);
+        break;
+    case 0x18:                                  /* 读 SR1 后读 SR2 清除 ADDR */
+        if (s->sr1_seen & r->SR1 & I2C_SR1_ADDR)
+        {
+            r->SR1 &= ~I2C_SR1_ADDR;
+            s->data = 1;
+            _i2c_rx_next(s);
+            _i2c_update(s);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static void _i2c_reset_regs(struct sim_i2c *s)
+{
+    I2C_TypeDef *r = _i2c_regs(s);
+
+    memset(r, 0, sizeof(I2C_TypeDef));
+    r->TRISE = 2u;
+}
+
+static void _i2c_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    struct sim_i2c *s = _i2c_find(addr);
+    I2C_TypeDef *r = _i2c_regs(s);
+    uint32_t off = addr - s->base;
+
+    (void)p;
+    switch (off)
+    {
+    case 0x00:                                  /* CR1 */
+        if ((val & I2C_CR1_SWRST) && !(old & I2C_CR1_SWRST))
+        {
+            /* 软件复位：寄存器和状态全部复位，锁住的 BUSY 也清除 */
+            s->stats.resets++;
+            _i2c_abort(s);
+            s->stuck_busy = 0;
+            _i2c_reset_regs(s);
+            r->CR1 = I2C_CR1_SWRST;
+            break;
+        }
+        if (val & I2C_CR1_SWRST)
+            break;
+        if (!(val & I2C_CR1_PE))
+        {
+            if (old & I2C_CR1_PE)
+                _i2c_abort(s);
+            r->CR1 &= ~(I2C_CR1_START | I2C_CR1_STOP);
+            r->SR1 = 0;
+            break;
+        }
+        if ((val & I2C_CR1_STOP) && !(old & I2C_CR1_STOP))
+            _i2c_stop_req(s);
+        else if ((val & I2C_CR1_START) && !(old & I2C_CR1_START))
+            _i2c_start_req(s);
+        break;
+    case 0x10:                                  /* DR */
+        if (s->sr1_seen & r->SR1 & I2C_SR1_SB)
+        {
+            /* 读 SR1 后写 DR 清除 SB，发出地址 */
+            r->SR1 &= ~I2C_SR1_SB;
+            _i2c_shift(s, (uint8_t)val, 1);
+        }
+        else if (s->master && s->data && s->tra)
+        {
+            s->tx_btf = 0;
+            if (!s->shifting)
+            {
+                _i2c_shift(s, (uint8_t)val, 0);
+            }
+            else
+            {
+                s->dr = (uint8_t)val;
+                s->dr_full = 1;
+            }
+        }
+        break;
+    case 0x14:                                  /* SR1：错误标志写 0 清除，其余只读 */
+        r->SR1 = old & ~(SIM_I2C_SR1_ERRORS & ~val);
+        break;
+    case 0x18:                                  /* SR2 只读 */
+        r->SR2 = old;
+        break;
+    default:
+        break;
+    }
+    _i2c_update(s);
+}
+
+/**=============================================================================
+ * @brief           引脚切为通用开漏输出时的手动时钟和 STOP
+ *============================================================================*/
+static int _i2c_pin_is_gpio(uint16_t pin)
+{
+    GPIO_TypeDef *g = SIM_PERIPH(GPIO_TypeDef, GPIOB);
+    uint32_t n = 0, cfg;
+
+    while (!(pin & (1u << n)))
+        n++;
+    cfg = (n < 8u) ? (g->CRL >> (n * 4u)) : (g->CRH >> ((n - 8u) * 4u));
+    return (cfg & 0x3u) != 0 && !(cfg & 0x8u);
+}
+
+static void _i2c_pins_changed(void *arg, uint16_t old, uint16_t odr)
+{
+    struct sim_i2c *s = arg;
+
+    if (!_i2c_pin_is_gpio(s->scl) || !_i2c_pin_is_gpio(s->sda))
+        return;
+    if (!(old & s->scl) && (odr & s->scl))
+    {
+        s->stats.scl_pulses++;
+        if (s->sda_hold && --s->sda_hold == 0)
+        {
+            sim_gpio_drive(GPIOB, s->sda, -1);
+            _i2c_start_req(s);
+            _i2c_update(s);
+        }
+    }
+    if ((old & s->scl) && (odr & s->scl) && !(old & s->sda) && (odr & s->sda) && !s->sda_hold)
+        s->stats.gpio_stops++;
+}
+
+static void _i2c_reset(struct sim_periph *p)
+{
+    struct sim_i2c *s;
+    int i;
+
+    (void)p;
+    for (i = 0; i < SIM_I2C_NUM; i++)
+    {
+        s = &i2cs[i];
+        _i2c_reset_regs(s);
+        s->master = s->own_busy = s->other_busy = s->stuck_busy = 0;
+        s->tra = s->data = 0;
+        s->action = SIM_I2C_IDLE;
+        s->shifting = s->shift_addr = s->dr_full = s->tx_btf = s->rx_held = s->nacked = 0;
+        s->rx_ack = -1;
+        s->sr1_seen = 0;
+        s->dev = NULL;
+        memset(s->devs, 0, sizeof(s->devs));
+        s->arlo_armed = s->stretch_armed = s->stretch_any = s->stretched = 0;
+        s->arlo_hold = 0;
+        s->sda_hold = 0;
+        memset(&s->stats, 0, sizeof(s->stats));
+        s->start_at = s->stop_at = 0;
+        sim_event_init(&s->event, _i2c_event, s);
+        sim_event_init(&s->other, _i2c_other_done, s);
+        s->tx_line = (struct sim_dma_line){s->base + 0x10u, 1, _i2c_tx_level, s, s->tx_line.next};
+        s->rx_line = (struct sim_dma_line){s->base + 0x10u, 0, _i2c_rx_level, s, s->rx_line.next};
+    }
+}
+
+static struct sim_periph sim_i2c1 = {"I2C1", I2C1_BASE, 0x400, _i2c_reset, _i2c_read, _i2c_write, NULL, NULL};
+static struct sim_periph sim_i2c2 = {"I2C2", I2C2_BASE, 0x400, NULL, _i2c_read, _i2c_write, NULL, NULL};
+
+__attribute__((constructor)) static void _sim_i2c_register(void)
+{
+    int i;
+
+    sim_periph_register(&sim_i2c1);
+    sim_periph_register(&sim_i2c2);
+    for (i = 0; i < SIM_I2C_NUM; i++)
+    {
+        sim_irq_level_register(i2cs[i].ev_irq, _i2c_ev_level, &i2cs[i]);
+        sim_irq_level_register(i2cs[i].er_irq, _i2c_er_level, &i2cs[i]);
+        sim_dma_line_register(&i2cs[i].tx_line);
+        sim_dma_line_register(&i2cs[i].rx_line);
+        i2cs[i].watch = (struct sim_gpio_watch){GPIOB, i2cs[i].scl | i2cs[i].sda,
+                                                _i2c_pins_changed, &i2cs[i], NULL};
+        sim_gpio_watch_register(&i2cs[i].watch);
+    }
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           挂接寄存器文件从机，reg_len 为寄存器地址字节数 1/2
+ *============================================================================*/
+void sim_i2c_attach(I2C_TypeDef *i2c, uint16_t addr, int reg_len, uint8_t *regs, size_t size)
+{
+    struct sim_i2c *s = _i2c_find((uint32_t)(uintptr_t)i2c);
+    struct sim_i2c_dev *d = _i2c_dev_find(s, addr);
+    int i;
+
+    for (i = 0; d == NULL && i < SIM_I2C_DEVS; i++)
+    {
+        if (s->devs[i].addr == 0)
+            d = &s->devs[i];
+    }
+    if (d == NULL)
+        sim_fatal("too many i2c devices");
+    *d = (struct sim_i2c_dev){addr, reg_len, regs, size, 0, 0};
+}
+
+/**=============================================================================
+ * @brief           移除从机，之后对该地址的访问无应答
+ *============================================================================*/
+void sim_i2c_detach(I2C_TypeDef *i2c, uint16_t addr)
+{
+    struct sim_i2c_dev *d = _i2c_dev_find(_i2c_find((uint32_t)(uintptr_t)i2c), addr);
+
+    if (d)
+        d->addr = 0;
+}
+
+/**=============================================================================
+ * @brief           注入总线故障，见 SIM_I2C_FAULT_*
+ *============================================================================*/
+void sim_i2c_fault(I2C_TypeDef *i2c, int fault, uint32_t arg)
+{
+    struct sim_i2c *s = _i2c_find((uint32_t)(uintptr_t)i2c);
+
+    switch (fault)
+    {
+    case SIM_I2C_FAULT_BUSY:
+        s->stuck_busy = 1;
+        break;
+    case SIM_I2C_FAULT_SDA_LOW:
+        s->sda_hold = arg;
+        sim_gpio_drive(GPIOB, s->sda, 0);
+        break;
+    case SIM_I2C_FAULT_ARLO:
+        s->arlo_armed = 1;
+        s->arlo_hold = SIM_US(arg);
+        break;
+    case SIM_I2C_FAULT_STRETCH:
+        s->stretch_armed = 1;
+        break;
+    case SIM_I2C_FAULT_STRETCH_AT:
+        s->stretch_any = 1;
+        s->stretch_skip = arg;
+        break;
+    default:
+        sim_fatal("unknown i2c fault %d", fault);
+    }
+    _i2c_update(s);
+}
+
+/**=============================================================================
+ * @brief           总线统计，clear 非 0 时读出后清零
+ *============================================================================*/
+void sim_i2c_stats(I2C_TypeDef *i2c, struct sim_i2c_stats *st, int clear)
+{
+    struct sim_i2c *s = _i2c_find((uint32_t)(uintptr_t)i2c);
+
+    *st = s->stats;
+    if (clear)
+        memset(&s->stats, 0, sizeof(s->stats));
+}
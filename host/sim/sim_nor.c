@@ -0,0 +1,363 @@
+/**
+  ******************************************************************************
+  * @file			sim_nor.c
+  * @brief			W25Qxx SPI NOR model: command decoder over a memory image,
+  *                 WEL/BUSY status, page program and erase timing
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define NOR_CMD_WRITE_ENABLE    0x06
+#define NOR_CMD_WRITE_DISABLE   0x04
+#define NOR_CMD_READ_SR1        0x05
+#define NOR_CMD_READ_SR2        0x35
+#define NOR_CMD_READ            0x03
+#define NOR_CMD_FAST_READ       0x0B
+#define NOR_CMD_PAGE_PROGRAM    0x02
+#define NOR_CMD_SECTOR_ERASE    0x20
+#define NOR_CMD_BLOCK_ERASE     0xD8
+#define NOR_CMD_CHIP_ERASE      0xC7
+#define NOR_CMD_JEDEC_ID        0x9F
+#define NOR_CMD_POWER_DOWN      0xB9
+#define NOR_CMD_RELEASE_PD      0xAB
+
+#define NOR_SR_BUSY             0x01
+#define NOR_SR_WEL              0x02
+
+#define NOR_PAGE                256u
+#define NOR_SECTOR              4096u
+#define NOR_BLOCK               65536u
+#define NOR_MAX_SIZE            (16u << 20)
+
+/* W25Q64JV 典型值 */
+#define NOR_PP_NS               SIM_US(400)
+#define NOR_SE_NS               SIM_MS(45)
+#define NOR_BE_NS               SIM_MS(150)
+#define NOR_CE_NS               SIM_MS(20000)
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_nor
+{
+    SPI_TypeDef            *spi;
+    struct sim_gpio_watch   cs;
+    uint32_t                jedec_id;
+    uint32_t                size;
+    uint8_t                *image;
+    uint32_t               *erase_counts;
+
+    uint64_t                pp_ns, se_ns;
+    uint64_t                busy_until;
+    int                     wel;
+    int                     power_down;
+
+    /* 片选有效期间的一条命令 */
+    int                     selected;
+    uint32_t                index;          /*!< 已收到的字节数 */
+    uint8_t                 cmd;
+    uint32_t                addr;
+    int                     ignored;        /*!< 忙或掉电时不响应 */
+    uint8_t                 page[NOR_PAGE];
+    uint32_t                page_len;
+
+    uint32_t                programs;
+    uint32_t                polls;
+    uint32_t                violations;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_nor nor;
+
+/* Private function ----------------------------------------------------------*/
+
+static int _nor_busy(void)
+{
+    return sim_time() < nor.busy_until;
+}
+
+static uint8_t _nor_sr1(void)
+{
+    return (uint8_t)((_nor_busy() ? NOR_SR_BUSY : 0) | (nor.wel ? NOR_SR_WEL : 0));
+}
+
+/**=============================================================================
+ * @brief           命令的第一个字节：忙或掉电时只响应读状态和唤醒，其余
+ *                  计为驱动的时序错误
+ *============================================================================*/
+static void _nor_command(uint8_t cmd)
+{
+    nor.cmd = cmd;
+    nor.addr = 0;
+    nor.page_len = 0;
+    nor.ignored = 0;
+
+    if (nor.power_down && cmd != NOR_CMD_RELEASE_PD)
+    {
+        nor.ignored = 1;
+        nor.violations++;
+        return;
+    }
+    if (_nor_busy() && cmd != NOR_CMD_READ_SR1 && cmd != NOR_CMD_READ_SR2)
+    {
+        nor.ignored = 1;
+        nor.violations++;
+        return;
+    }
+    if (cmd == NOR_CMD_READ_SR1)
+        nor.polls++;
+}
+
+/**=============================================================================
+ * @brief           命令之后的字节，返回 MISO
+ *============================================================================*/
+static uint8_t _nor_byte(uint8_t mosi)
+{
+    uint32_t n = nor.index;
+    uint8_t miso = 0xFF;
+
+    if (n == 0)
+    {
+        _nor_command(mosi);
+        return miso;
+    }
+    if (nor.ignored)
+        return miso;
+
+    switch (nor.cmd)
+    {
+    case NOR_CMD_READ_SR1:
+        miso = _nor_sr1();
+        break;
+    case NOR_CMD_READ_SR2:
+        miso = 0x00;
+        break;
+    case NOR_CMD_JEDEC_ID:
+        if (n <= 3)
+            miso = (uint8_t)(nor.jedec_id >> (8 * (3 - n)));
+        break;
+    case NOR_CMD_READ:
+    case NOR_CMD_FAST_READ:
+        if (n <= 3)
+        {
+            nor.addr = (nor.addr << 8) | mosi;
+            break;
+        }
+        /* 快速读在地址之后有 8 个空时钟 */
+        if (nor.cmd == NOR_CMD_FAST_READ && n == 4)
+            break;
+        miso = nor.image[nor.addr % nor.size];
+        nor.addr++;
+        break;
+    case NOR_CMD_PAGE_PROGRAM:
+        if (n <= 3)
+        {
+            nor.addr = (nor.addr << 8) | mosi;
+            break;
+        }
+        /* 超过页尾回到页首，与芯片相同，但这说明驱动拆页有误 */
+        if (nor.page_len == NOR_PAGE - (nor.addr % NOR_PAGE))
+            nor.violations++;
+        if (nor.page_len < NOR_PAGE)
+            nor.page[nor.page_len++] = mosi;
+        break;
+    case NOR_CMD_SECTOR_ERASE:
+    case NOR_CMD_BLOCK_ERASE:
+        if (n <= 3)
+            nor.addr = (nor.addr << 8) | mosi;
+        break;
+    default:
+        break;
+    }
+    return miso;
+}
+
+/**=============================================================================
+ * @brief           片选拉高：写使能、编程和擦除在此时执行
+ *============================================================================*/
+static void _nor_execute(void)
+{
+    uint32_t i, a, start, len;
+
+    if (nor.index == 0 || nor.ignored)
+        return;
+
+    switch (nor.cmd)
+    {
+    case NOR_CMD_WRITE_ENABLE:
+        nor.wel = 1;
+        break;
+    case NOR_CMD_WRITE_DISABLE:
+        nor.wel = 0;
+        break;
+    case NOR_CMD_POWER_DOWN:
+        nor.power_down = 1;
+        break;
+    case NOR_CMD_RELEASE_PD:
+        nor.power_down = 0;
+        break;
+    case NOR_CMD_PAGE_PROGRAM:
+        if (!nor.wel || nor.index < 5)
+        {
+            nor.violations++;
+            break;
+        }
+        a = nor.addr % nor.size;
+        for (i = 0; i < nor.page_len; i++)
+            nor.image[(a & ~(NOR_PAGE - 1)) + ((a + i) % NOR_PAGE)] &= nor.page[i];
+        nor.programs++;
+        nor.wel = 0;
+        nor.busy_until = sim_time() + nor.pp_ns;
+        break;
+    case NOR_CMD_SECTOR_ERASE:
+    case NOR_CMD_BLOCK_ERASE:
+    case NOR_CMD_CHIP_ERASE:
+        if (!nor.wel || (nor.cmd != NOR_CMD_CHIP_ERASE && nor.index != 4))
+        {
+            nor.violations++;
+            break;
+        }
+        len = nor.cmd == NOR_CMD_SECTOR_ERASE ? NOR_SECTOR :
+              nor.cmd == NOR_CMD_BLOCK_ERASE ? NOR_BLOCK : nor.size;
+        start = (nor.addr % nor.size) & ~(len - 1);
+        memset(nor.image + start, 0xFF, len);
+        for (a = start; a < start + len; a += NOR_SECTOR)
+            nor.erase_counts[a / NOR_SECTOR]++;
+        nor.wel = 0;
+        nor.busy_until = sim_time() + (nor.cmd == NOR_CMD_SECTOR_ERASE ? nor.se_ns :
+                                       nor.cmd == NOR_CMD_BLOCK_ERASE ? NOR_BE_NS : NOR_CE_NS);
+        break;
+    default:
+        break;
+    }
+}
+
+static uint16_t _nor_xfer(void *arg, uint16_t mosi, int bits)
+{
+    uint16_t hi;
+
+    (void)arg;
+    if (!nor.selected)
+        return 0xFFFF;
+
+    /* 16 位帧高字节先出 */
+    if (bits == 16)
+    {
+        hi = _nor_byte((uint8_t)(mosi >> 8));
+        nor.index++;
+        hi = (uint16_t)((hi << 8) | _nor_byte((uint8_t)mosi));
+        nor.index++;
+        return hi;
+    }
+    hi = _nor_byte((uint8_t)mosi);
+    nor.index++;
+    return hi;
+}
+
+static void _nor_cs_changed(void *arg, uint16_t old, uint16_t odr)
+{
+    (void)arg;
+    (void)old;
+    if (!(odr & nor.cs.pins))
+    {
+        nor.selected = 1;
+        nor.index = 0;
+    }
+    else if (nor.selected)
+    {
+        nor.selected = 0;
+        _nor_execute();
+    }
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           在 SPI 上挂一片 NOR，容量由 JEDEC ID 的低字节决定，
+ *                  初始内容全为 0xFF
+ *============================================================================*/
+void sim_nor_attach(SPI_TypeDef *spi, GPIO_TypeDef *cs_port, uint16_t cs_pin, uint32_t jedec_id)
+{
+    uint32_t size = 1u << (jedec_id & 0xFFu);
+
+    if (size > NOR_MAX_SIZE)
+        size = NOR_MAX_SIZE;
+    if (nor.image == NULL || nor.size != size)
+    {
+        free(nor.image);
+        free(nor.erase_counts);
+        nor.image = malloc(size);
+        nor.erase_counts = malloc(size / NOR_SECTOR * sizeof(uint32_t));
+        if (nor.image == NULL || nor.erase_counts == NULL)
+            sim_fatal("nor: out of memory");
+    }
+    nor.size = size;
+    memset(nor.image, 0xFF, size);
+    memset(nor.erase_counts, 0, size / NOR_SECTOR * sizeof(uint32_t));
+    nor.spi = spi;
+    nor.jedec_id = jedec_id;
+    nor.pp_ns = NOR_PP_NS;
+    nor.se_ns = NOR_SE_NS;
+    nor.busy_until = 0;
+    nor.wel = nor.power_down = nor.selected = 0;
+    nor.programs = nor.polls = nor.violations = 0;
+
+    if (nor.cs.changed == NULL)
+    {
+        nor.cs.gpio = cs_port;
+        nor.cs.pins = cs_pin;
+        nor.cs.changed = _nor_cs_changed;
+        sim_gpio_watch_register(&nor.cs);
+    }
+    sim_spi_attach(spi, _nor_xfer, &nor);
+}
+
+uint8_t *sim_nor_image(void)
+{
+    return nor.image;
+}
+
+uint32_t sim_nor_size(void)
+{
+    return nor.size;
+}
+
+void sim_nor_set_timing(uint64_t page_program_ns, uint64_t sector_erase_ns)
+{
+    nor.pp_ns = page_program_ns;
+    nor.se_ns = sector_erase_ns;
+}
+
+uint32_t sim_nor_erase_count(uint32_t addr)
+{
+    return nor.erase_counts[(addr % nor.size) / NOR_SECTOR];
+}
+
+uint32_t sim_nor_program_count(void)
+{
+    return nor.programs;
+}
+
+/**=============================================================================
+ * @brief           读状态寄存器 1 的次数
+ *============================================================================*/
+uint32_t sim_nor_status_polls(void)
+{
+    return nor.polls;
+}
+
+/**=============================================================================
+ * @brief           驱动的协议错误：忙时发命令、没有写使能、页编程跨页等
+ *============================================================================*/
+uint32_t sim_nor_violations(void)
+{
+    return nor.violations;
+}
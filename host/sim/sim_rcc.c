@@ -0,0 +1,221 @@
+/**
+  ******************************************************************************
+  * @file			sim_rcc.c
+  * @brief			RCC model: HSE/PLL start-up, clock switch and the clock tree
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_PLL_LOCK_NS         SIM_US(200)
+
+/* Private variables ---------------------------------------------------------*/
+static uint64_t             rcc_hse_startup = SIM_MS(2);   /*!< 0 表示晶振不起振 */
+static struct sim_event     rcc_hse_event;
+static struct sim_event     rcc_pll_event;
+static uint32_t             rcc_sysclk = SIM_HSI_HZ;       /*!< 当前生效的频率 */
+static uint32_t             rcc_hclk   = SIM_HSI_HZ;
+
+/* Private function ----------------------------------------------------------*/
+
+static uint32_t _rcc_pll_hz(uint32_t cfgr)
+{
+    uint32_t mul = ((cfgr & RCC_CFGR_PLLMULL) >> RCC_CFGR_PLLMULL_Pos) + 2u;
+    uint32_t src;
+
+    if (mul > 16u)
+        mul = 16u;
+    if (cfgr & RCC_CFGR_PLLSRC)
+        src = (cfgr & RCC_CFGR_PLLXTPRE) ? SIM_HSE_HZ / 2u : SIM_HSE_HZ;
+    else
+        src = SIM_HSI_HZ / 2u;
+    return src * mul;
+}
+
+static uint32_t _rcc_sysclk(void)
+{
+    uint32_t cfgr = SIM_PERIPH(RCC_TypeDef, RCC)->CFGR;
+
+    switch ((cfgr & RCC_CFGR_SWS) >> RCC_CFGR_SWS_Pos)
+    {
+    case 1:  return SIM_HSE_HZ;
+    case 2:  return _rcc_pll_hz(cfgr);
+    default: return SIM_HSI_HZ;
+    }
+}
+
+static uint32_t _rcc_ahb_div(uint32_t cfgr)
+{
+    static const uint8_t shift[8] = {1, 2, 3, 4, 6, 7, 8, 9};
+    uint32_t hpre = (cfgr & RCC_CFGR_HPRE) >> RCC_CFGR_HPRE_Pos;
+
+    return (hpre & 0x8u) ? (1u << shift[hpre & 0x7u]) : 1u;
+}
+
+static uint32_t _rcc_apb_div(uint32_t ppre)
+{
+    return (ppre & 0x4u) ? (2u << (ppre & 0x3u)) : 1u;
+}
+
+/**=============================================================================
+ * @brief           SW 选择的时钟已就绪时切换，并通知依赖 HCLK 的模型
+ *============================================================================*/
+static void _rcc_update(void)
+{
+    RCC_TypeDef *rcc = SIM_PERIPH(RCC_TypeDef, RCC);
+    uint32_t sw = rcc->CFGR & RCC_CFGR_SW, sws = (rcc->CFGR & RCC_CFGR_SWS) >> RCC_CFGR_SWS_Pos;
+    uint32_t hclk;
+
+    if (sw != sws)
+    {
+        if ((sw == 1 && (rcc->CR & RCC_CR_HSERDY)) || (sw == 2 && (rcc->CR & RCC_CR_PLLRDY)) || sw == 0)
+            rcc->CFGR = (rcc->CFGR & ~RCC_CFGR_SWS) | (sw << RCC_CFGR_SWS_Pos);
+    }
+
+    /* 正在使用的时钟被关掉时硬件不允许，这里直接报错 */
+    sws = (rcc->CFGR & RCC_CFGR_SWS) >> RCC_CFGR_SWS_Pos;
+    if ((sws == 1 && !(rcc->CR & RCC_CR_HSEON)) || (sws == 2 && !(rcc->CR & RCC_CR_PLLON)))
+        sim_fatal("rcc: system clock source switched off");
+
+    rcc_sysclk = _rcc_sysclk();
+    hclk = rcc_sysclk / _rcc_ahb_div(rcc->CFGR);
+    if (hclk != rcc_hclk)
+    {
+        rcc_hclk = hclk;
+        sim_systick_sync();
+    }
+}
+
+static void _rcc_hse_ready(struct sim_event *ev)
+{
+    (void)ev;
+    SIM_PERIPH(RCC_TypeDef, RCC)->CR |= RCC_CR_HSERDY;
+    _rcc_update();
+}
+
+static void _rcc_pll_ready(struct sim_event *ev)
+{
+    (void)ev;
+    SIM_PERIPH(RCC_TypeDef, RCC)->CR |= RCC_CR_PLLRDY;
+    _rcc_update();
+}
+
+static void _rcc_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    RCC_TypeDef *rcc = SIM_PERIPH(RCC_TypeDef, RCC);
+    uint32_t pll;
+
+    (void)p;
+    if (addr == (uint32_t)(uintptr_t)&RCC->CR)
+    {
+        /* 就绪位只读 */
+        rcc->CR = (val & ~(RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY)) |
+                  (old & (RCC_CR_HSIRDY | RCC_CR_HSERDY | RCC_CR_PLLRDY));
+
+        if ((val & RCC_CR_HSEON) && !(old & RCC_CR_HSEON) && rcc_hse_startup)
+            sim_event_at(&rcc_hse_event, sim_time() + rcc_hse_startup);
+        if (!(val & RCC_CR_HSEON))
+        {
+            sim_event_cancel(&rcc_hse_event);
+            rcc->CR &= ~RCC_CR_HSERDY;
+        }
+
+        if ((val & RCC_CR_PLLON) && !(old & RCC_CR_PLLON))
+            sim_event_at(&rcc_pll_event, sim_time() + SIM_PLL_LOCK_NS);
+        if (!(val & RCC_CR_PLLON))
+        {
+            sim_event_cancel(&rcc_pll_event);
+            rcc->CR &= ~RCC_CR_PLLRDY;
+        }
+        _rcc_update();
+    }
+    else if (addr == (uint32_t)(uintptr_t)&RCC->CFGR)
+    {
+        /* SWS 只读；PLL 运行时倍频和时钟源写入无效（HAL_RCC_DeInit 依赖这一点） */
+        pll = RCC_CFGR_PLLMULL | RCC_CFGR_PLLSRC | RCC_CFGR_PLLXTPRE;
+        if (!(rcc->CR & RCC_CR_PLLON))
+            pll = 0;
+        rcc->CFGR = (val & ~(RCC_CFGR_SWS | pll)) | (old & (RCC_CFGR_SWS | pll));
+        _rcc_update();
+    }
+    else if (addr == (uint32_t)(uintptr_t)&RCC->CIR)
+    {
+        /* 就绪标志清除位写 1 清除，读为 0 */
+        rcc->CIR = val & 0x0000FF00u;
+    }
+    else if (addr == (uint32_t)(uintptr_t)&RCC->CSR)
+    {
+        rcc->CSR = (val & RCC_CSR_RMVF) ? (val & 0x1u) : ((old & 0xFF000000u) | (val & 0x1u));
+    }
+}
+
+static void _rcc_reset(struct sim_periph *p)
+{
+    RCC_TypeDef *rcc = SIM_PERIPH(RCC_TypeDef, RCC);
+
+    (void)p;
+    memset(rcc, 0, sizeof(*rcc));
+    rcc->CR     = 0x00000083u;
+    rcc->AHBENR = 0x00000014u;
+    rcc->CSR    = 0x0C000000u;
+    sim_event_init(&rcc_hse_event, _rcc_hse_ready, NULL);
+    sim_event_init(&rcc_pll_event, _rcc_pll_ready, NULL);
+    rcc_sysclk = SIM_HSI_HZ;
+    rcc_hclk   = SIM_HSI_HZ;
+}
+
+static struct sim_periph sim_rcc =
+{
+    .name  = "RCC",
+    .base  = RCC_BASE,
+    .size  = 0x400,
+    .reset = _rcc_reset,
+    .write = _rcc_write,
+};
+
+__attribute__((constructor)) static void _sim_rcc_register(void)
+{
+    sim_periph_register(&sim_rcc);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           HSE 起振时间，0 表示晶振坏了永远不就绪
+ *============================================================================*/
+void sim_rcc_set_hse_startup(uint64_t ns)
+{
+    rcc_hse_startup = ns;
+}
+
+uint32_t sim_clock_sysclk(void)
+{
+    return rcc_sysclk;
+}
+
+uint32_t sim_clock_hclk(void)
+{
+    return rcc_hclk;
+}
+
+uint32_t sim_clock_pclk1(void)
+{
+    uint32_t cfgr = SIM_PERIPH(RCC_TypeDef, RCC)->CFGR;
+
+    return rcc_hclk / _rcc_apb_div((cfgr & RCC_CFGR_PPRE1) >> RCC_CFGR_PPRE1_Pos);
+}
+
+uint32_t sim_clock_pclk2(void)
+{
+    uint32_t cfgr = SIM_PERIPH(RCC_TypeDef, RCC)->CFGR;
+
+    return rcc_hclk / _rcc_apb_div((cfgr & RCC_CFGR_PPRE2) >> RCC_CFGR_PPRE2_Pos);
+}
@@ -0,0 +1,167 @@
+/**
+  ******************************************************************************
+  * @file			sim_rtc.c
+  * @brief			RTC model: 32-bit seconds counter, configuration mode, RSF/RTOFF
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_RTC_SECOND_NS       SIM_NS_PER_SEC
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_event rtc_second_event;
+static uint32_t         rtc_cnt_writes;
+
+/* Private function ----------------------------------------------------------*/
+
+static RTC_TypeDef *_rtc_regs(void)
+{
+    return SIM_PERIPH(RTC_TypeDef, RTC);
+}
+
+static uint32_t _rtc_counter(void)
+{
+    RTC_TypeDef *r = _rtc_regs();
+
+    return (r->CNTH << 16) | (r->CNTL & 0xFFFFu);
+}
+
+static void _rtc_set_counter(uint32_t cnt)
+{
+    RTC_TypeDef *r = _rtc_regs();
+
+    r->CNTH = cnt >> 16;
+    r->CNTL = cnt & 0xFFFFu;
+}
+
+/**=============================================================================
+ * @brief           每秒计数加一，置 SECF，计数回绕置 OWF，与闹钟相等置 ALRF
+ *============================================================================*/
+static void _rtc_second(struct sim_event *ev)
+{
+    RTC_TypeDef *r = _rtc_regs();
+    uint32_t cnt;
+
+    (void)ev;
+    sim_event_at(&rtc_second_event, sim_time() + SIM_RTC_SECOND_NS);
+    if (r->CRL & RTC_CRL_CNF)
+        return;
+
+    cnt = _rtc_counter() + 1u;
+    _rtc_set_counter(cnt);
+    r->CRL |= RTC_CRL_SECF;
+    if (cnt == 0)
+        r->CRL |= RTC_CRL_OWF;
+    if (cnt == ((r->ALRH << 16) | (r->ALRL & 0xFFFFu)))
+        r->CRL |= RTC_CRL_ALRF;
+    if (r->CRH & r->CRL & (RTC_CRH_SECIE | RTC_CRH_ALRIE | RTC_CRH_OWIE))
+        sim_irq_pend(RTC_IRQn);
+}
+
+static void _rtc_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    RTC_TypeDef *r = _rtc_regs();
+    uint32_t off = addr - RTC_BASE;
+
+    (void)p;
+    switch (off)
+    {
+    case 0x04:                                  /* CRL */
+        /* RTOFF 只读恒为 1（写操作瞬间完成）；RSF、标志位只能写 0 清除 */
+        r->CRL = (val & RTC_CRL_CNF) | (old & val & (RTC_CRL_RSF | RTC_CRL_OWF | RTC_CRL_ALRF | RTC_CRL_SECF)) |
+                 RTC_CRL_RTOFF;
+        break;
+    case 0x08: case 0x0C: case 0x18: case 0x1C: case 0x20: case 0x24:
+        /* PRL、CNT、ALR 只能在配置模式下写，否则写入无效 */
+        if (!(r->CRL & RTC_CRL_CNF))
+        {
+            *(volatile uint32_t *)sim_shadow(addr) = old;
+            break;
+        }
+        *(volatile uint32_t *)sim_shadow(addr) = val & (off == 0x08 ? 0xFu : 0xFFFFu);
+        if (off == 0x18 || off == 0x1C)
+            rtc_cnt_writes++;
+        break;
+    case 0x10: case 0x14:                       /* DIV 只读 */
+        *(volatile uint32_t *)sim_shadow(addr) = old;
+        break;
+    default:
+        break;
+    }
+}
+
+static void _rtc_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    RTC_TypeDef *r = _rtc_regs();
+
+    (void)p;
+    /* 清除 RSF 后下一次读到时已完成同步 */
+    if (!for_write && addr == RTC_BASE + 0x04u)
+        r->CRL |= RTC_CRL_RSF;
+}
+
+static void _rtc_reset(struct sim_periph *p)
+{
+    RTC_TypeDef *r = _rtc_regs();
+
+    (void)p;
+    r->CRH  = 0;
+    r->CRL  = RTC_CRL_RTOFF;
+    r->PRLH = 0;
+    r->PRLL = 0x8000u;
+    r->DIVH = 0;
+    r->DIVL = 0x8000u;
+    r->CNTH = 0;
+    r->CNTL = 0;
+    r->ALRH = 0xFFFFu;
+    r->ALRL = 0xFFFFu;
+    rtc_cnt_writes = 0;
+    sim_event_init(&rtc_second_event, _rtc_second, NULL);
+    sim_event_at(&rtc_second_event, SIM_RTC_SECOND_NS);
+}
+
+static struct sim_periph sim_rtc =
+{
+    .name  = "RTC",
+    .base  = RTC_BASE,
+    .size  = 0x400,
+    .reset = _rtc_reset,
+    .read  = _rtc_read,
+    .write = _rtc_write,
+};
+
+__attribute__((constructor)) static void _sim_rtc_register(void)
+{
+    sim_periph_register(&sim_rtc);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           直接设置计数值，模拟掉电期间由后备电池维持的走时
+ *============================================================================*/
+void sim_rtc_set_counter(uint32_t cnt)
+{
+    _rtc_set_counter(cnt);
+}
+
+uint32_t sim_rtc_counter(void)
+{
+    return _rtc_counter();
+}
+
+/**=============================================================================
+ * @brief           固件写 CNTH/CNTL 的次数
+ *============================================================================*/
+uint32_t sim_rtc_counter_writes(void)
+{
+    return rtc_cnt_writes;
+}
@@ -0,0 +1,361 @@
+/**
+  ******************************************************************************
+  * @file			sim_spi.c
+  * @brief			SPI1..3 master model: frame timing, TX buffer, overrun, DMA requests
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_SPI_NUM             3
+#define SIM_SPI_CAPTURE         (128u * 1024u)
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_spi
+{
+    uint32_t                base;
+    IRQn_Type               irq;
+    int                     apb2;           /*!< SPI1 在 APB2 */
+
+    int                     shift_busy;     /*!< 移位寄存器正在收发 */
+    uint16_t                shift;
+    uint16_t                hold;           /*!< 发送缓冲中等待的帧，TXE 为 0 */
+    int                     hold_full;
+    uint16_t                rx_data;        /*!< DR 读出的值 */
+    int                     dr_read;        /*!< 上一次访问是读 DR，接着读 SR 清 OVR */
+
+    sim_spi_xfer_t          xfer;
+    void                   *xfer_arg;
+
+    uint8_t                 tx[SIM_SPI_CAPTURE];
+    size_t                  tx_num;
+    uint64_t                frames;
+    uint64_t                bits;
+    uint32_t                overruns;
+    int                     halted;         /*!< SCK 停住，移位中的帧不会完成 */
+
+    struct sim_event        event;
+    struct sim_dma_line     tx_line;
+    struct sim_dma_line     rx_line;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_spi spis[SIM_SPI_NUM] =
+{
+    {SPI1_BASE, SPI1_IRQn, 1},
+    {SPI2_BASE, SPI2_IRQn, 0},
+    {SPI3_BASE, SPI3_IRQn, 0},
+};
+
+/* Private function ----------------------------------------------------------*/
+
+static SPI_TypeDef *_spi_regs(struct sim_spi *s)
+{
+    return (SPI_TypeDef *)sim_shadow(s->base);
+}
+
+static struct sim_spi *_spi_find(uint32_t addr)
+{
+    int i;
+
+    for (i = 0; i < SIM_SPI_NUM; i++)
+    {
+        if (addr >= spis[i].base && addr < spis[i].base + 0x400u)
+            return &spis[i];
+    }
+    return NULL;
+}
+
+static int _spi_frame_bits(struct sim_spi *s)
+{
+    return (_spi_regs(s)->CR1 & SPI_CR1_DFF) ? 16 : 8;
+}
+
+/**=============================================================================
+ * @brief           一帧的时间：位数乘以 SCK 周期，SCK = PCLK / 2^(BR+1)
+ *============================================================================*/
+static uint64_t _spi_frame_ns(struct sim_spi *s)
+{
+    uint32_t br = (_spi_regs(s)->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos;
+    uint32_t pclk = s->apb2 ? sim_clock_pclk2() : sim_clock_pclk1();
+
+    return sim_cycles_to_ns((uint64_t)_spi_frame_bits(s) << (br + 1u), pclk);
+}
+
+static int _spi_irq_level(void *arg)
+{
+    SPI_TypeDef *r = _spi_regs(arg);
+    uint32_t sr = r->SR, cr2 = r->CR2;
+
+    return ((sr & SPI_SR_TXE) && (cr2 & SPI_CR2_TXEIE)) ||
+           ((sr & SPI_SR_RXNE) && (cr2 & SPI_CR2_RXNEIE)) ||
+           ((sr & (SPI_SR_OVR | SPI_SR_MODF)) && (cr2 & SPI_CR2_ERRIE));
+}
+
+static void _spi_update(struct sim_spi *s)
+{
+    if (_spi_irq_level(s))
+        sim_irq_pend(s->irq);
+    sim_dma_line_update(&s->tx_line);
+    sim_dma_line_update(&s->rx_line);
+}
+
+static void _spi_start(struct sim_spi *s, uint16_t frame)
+{
+    s->shift = frame;
+    s->shift_busy = 1;
+    _spi_regs(s)->SR |= SPI_SR_BSY;
+    if (!s->halted)
+        sim_event_at(&s->event, sim_time() + _spi_frame_ns(s));
+}
+
+/**=============================================================================
+ * @brief           一帧移完：MOSI 交给从机并保存，MISO 进 DR，RXNE 未清时溢出
+ *                  丢弃；发送缓冲中有帧则紧接着开始下一帧
+ *============================================================================*/
+static void _spi_frame_done(struct sim_event *ev)
+{
+    struct sim_spi *s = ev->arg;
+    SPI_TypeDef *r = _spi_regs(s);
+    int bits = _spi_frame_bits(s);
+    uint16_t miso = bits == 16 ? 0xFFFFu : 0xFFu;
+
+    if (s->xfer)
+        miso = s->xfer(s->xfer_arg, s->shift, bits);
+    if (bits == 8)
+        miso &= 0xFFu;
+
+    /* 16 位帧按半字的小端顺序保存，与发送缓冲的内存内容一致 */
+    if (s->tx_num < SIM_SPI_CAPTURE)
+        s->tx[s->tx_num++] = (uint8_t)s->shift;
+    if (bits == 16 && s->tx_num < SIM_SPI_CAPTURE)
+        s->tx[s->tx_num++] = (uint8_t)(s->shift >> 8);
+    s->frames++;
+    s->bits += (uint64_t)bits;
+
+    if (r->SR & SPI_SR_RXNE)
+    {
+        r->SR |= SPI_SR_OVR;
+        s->overruns++;
+    }
+    else
+    {
+        s->rx_data = miso;
+        r->DR = miso;
+        r->SR |= SPI_SR_RXNE;
+    }
+
+    s->shift_busy = 0;
+    if (s->hold_full)
+    {
+        s->hold_full = 0;
+        r->SR |= SPI_SR_TXE;
+        _spi_start(s, s->hold);
+    }
+    else
+    {
+        r->SR &= ~SPI_SR_BSY;
+    }
+    _spi_update(s);
+}
+
+static int _spi_tx_level(void *arg)
+{
+    SPI_TypeDef *r = _spi_regs(arg);
+
+    return (r->CR2 & SPI_CR2_TXDMAEN) && (r->SR & SPI_SR_TXE) && (r->CR1 & SPI_CR1_SPE);
+}
+
+static int _spi_rx_level(void *arg)
+{
+    SPI_TypeDef *r = _spi_regs(arg);
+
+    return (r->CR2 & SPI_CR2_RXDMAEN) && (r->SR & SPI_SR_RXNE);
+}
+
+static void _spi_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    struct sim_spi *s = _spi_find(addr);
+    SPI_TypeDef *r = _spi_regs(s);
+    uint32_t off = addr - s->base;
+
+    (void)p;
+    if (for_write)
+        return;
+    if (off == 0x08u)
+    {
+        /* 读 DR 之后读 SR 清除 OVR */
+        if (s->dr_read)
+            r->SR &= ~SPI_SR_OVR;
+    }
+    else if (off == 0x0Cu)
+    {
+        r->SR &= ~SPI_SR_RXNE;
+        s->dr_read = 1;
+        return;
+    }
+    s->dr_read = 0;
+}
+
+static void _spi_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    struct sim_spi *s = _spi_find(addr);
+    SPI_TypeDef *r = _spi_regs(s);
+    uint32_t off = addr - s->base;
+
+    (void)p;
+    switch (off)
+    {
+    case 0x00:                                  /* CR1：使能时开始发送已写入的帧 */
+        if ((val & SPI_CR1_SPE) && !(old & SPI_CR1_SPE) && s->hold_full && !s->shift_busy)
+        {
+            s->hold_full = 0;
+            r->SR |= SPI_SR_TXE;
+            _spi_start(s, s->hold);
+        }
+        break;
+    case 0x08:                                  /* SR：只有 CRCERR 写 0 清除 */
+        r->SR = old & ~(~val & SPI_SR_CRCERR);
+        break;
+    case 0x0C:
+        /* DR 写入的是发送数据，读出的仍然是接收数据 */
+        r->DR = s->rx_data;
+        if (!(r->CR1 & SPI_CR1_MSTR))
+            break;
+        if ((r->CR1 & SPI_CR1_SPE) && !s->shift_busy)
+        {
+            _spi_start(s, (uint16_t)val);
+        }
+        else
+        {
+            /* TXE 为 0 时再写会覆盖发送缓冲，与芯片相同 */
+            s->hold = (uint16_t)val;
+            s->hold_full = 1;
+            r->SR &= ~SPI_SR_TXE;
+        }
+        break;
+    default:
+        break;
+    }
+    s->dr_read = 0;
+    _spi_update(s);
+}
+
+static void _spi_reset(struct sim_periph *p)
+{
+    struct sim_spi *s;
+    int i;
+
+    (void)p;
+    for (i = 0; i < SIM_SPI_NUM; i++)
+    {
+        s = &spis[i];
+        memset(_spi_regs(s), 0, sizeof(SPI_TypeDef));
+        _spi_regs(s)->SR = SPI_SR_TXE;
+        _spi_regs(s)->CRCPR = 7;
+        s->shift_busy = s->hold_full = s->dr_read = 0;
+        s->rx_data = 0;
+        s->tx_num = 0;
+        s->frames = s->bits = 0;
+        s->overruns = 0;
+        s->halted = 0;
+        sim_event_init(&s->event, _spi_frame_done, s);
+        s->tx_line = (struct sim_dma_line){s->base + 0x0Cu, 1, _spi_tx_level, s, s->tx_line.next};
+        s->rx_line = (struct sim_dma_line){s->base + 0x0Cu, 0, _spi_rx_level, s, s->rx_line.next};
+    }
+}
+
+static struct sim_periph sim_spi1 = {"SPI1", SPI1_BASE, 0x400, _spi_reset, _spi_read, _spi_write, NULL, NULL};
+static struct sim_periph sim_spi2 = {"SPI2", SPI2_BASE, 0x400, NULL, _spi_read, _spi_write, NULL, NULL};
+static struct sim_periph sim_spi3 = {"SPI3", SPI3_BASE, 0x400, NULL, _spi_read, _spi_write, NULL, NULL};
+
+__attribute__((constructor)) static void _sim_spi_register(void)
+{
+    int i;
+
+    sim_periph_register(&sim_spi1);
+    sim_periph_register(&sim_spi2);
+    sim_periph_register(&sim_spi3);
+    for (i = 0; i < SIM_SPI_NUM; i++)
+    {
+        sim_irq_level_register(spis[i].irq, _spi_irq_level, &spis[i]);
+        sim_dma_line_register(&spis[i].tx_line);
+        sim_dma_line_register(&spis[i].rx_line);
+    }
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           挂接从机：每帧移完时以 MOSI 调用，返回值作为 MISO；
+ *                  没有从机时 MISO 为全 1
+ *============================================================================*/
+void sim_spi_attach(SPI_TypeDef *spi, sim_spi_xfer_t xfer, void *arg)
+{
+    struct sim_spi *s = _spi_find((uint32_t)(uintptr_t)spi);
+
+    s->xfer = xfer;
+    s->xfer_arg = arg;
+}
+
+/**=============================================================================
+ * @brief           取出 MOSI 上已发送的数据
+ *
+ * @return          取出的字节数
+ *============================================================================*/
+size_t sim_spi_take(SPI_TypeDef *spi, void *buf, size_t max)
+{
+    struct sim_spi *s = _spi_find((uint32_t)(uintptr_t)spi);
+    size_t n = s->tx_num < max ? s->tx_num : max;
+
+    memcpy(buf, s->tx, n);
+    memmove(s->tx, s->tx + n, s->tx_num - n);
+    s->tx_num -= n;
+    return n;
+}
+
+/**=============================================================================
+ * @brief           移位寄存器和发送缓冲都空闲
+ *============================================================================*/
+int sim_spi_idle(SPI_TypeDef *spi)
+{
+    struct sim_spi *s = _spi_find((uint32_t)(uintptr_t)spi);
+
+    return !s->shift_busy && !s->hold_full;
+}
+
+/**=============================================================================
+ * @brief           复位以来移出的位数，即输出的 SCK 周期数
+ *============================================================================*/
+uint64_t sim_spi_bits(SPI_TypeDef *spi)
+{
+    return _spi_find((uint32_t)(uintptr_t)spi)->bits;
+}
+
+uint32_t sim_spi_overruns(SPI_TypeDef *spi)
+{
+    return _spi_find((uint32_t)(uintptr_t)spi)->overruns;
+}
+
+/**=============================================================================
+ * @brief           停住或恢复 SCK，模拟时钟被关或总线配置错误：停住时移位中的
+ *                  帧不完成，BSY 保持、TXE 不再置位；恢复后这一帧从头开始
+ *============================================================================*/
+void sim_spi_halt(SPI_TypeDef *spi, int halt)
+{
+    struct sim_spi *s = _spi_find((uint32_t)(uintptr_t)spi);
+
+    s->halted = halt;
+    if (halt)
+        sim_event_cancel(&s->event);
+    else if (s->shift_busy)
+        sim_event_at(&s->event, sim_time() + _spi_frame_ns(s));
+}
@@ -0,0 +1,243 @@
+/**
+  ******************************************************************************
+  * @file			sim_tim.c
+  * @brief			TIM2..4 model: up-counting time base, update interrupt and TRGO
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_TIM_NUM             3
+#define SIM_TIM_MMS_RESET       (0u << TIM_CR2_MMS_Pos)
+#define SIM_TIM_MMS_UPDATE      (2u << TIM_CR2_MMS_Pos)
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_tim
+{
+    uint32_t                base;
+    IRQn_Type               irq;
+    int                     trgo;           /*!< TRGO 对应的 ADC 规则组 EXTSEL，-1 表示不接 ADC */
+
+    uint32_t                psc, arr;       /*!< 生效中的值，PSC 总是、ARR 在 ARPE 时等到更新事件才装入 */
+    uint64_t                zero;           /*!< 计数器为 0 的时刻 */
+    uint32_t                updates;
+    struct sim_event        event;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_tim tims[SIM_TIM_NUM] =
+{
+    {TIM2_BASE, TIM2_IRQn, -1},
+    {TIM3_BASE, TIM3_IRQn, 4},                  /*!< ADC1/2 EXTSEL 100：TIM3 TRGO */
+    {TIM4_BASE, TIM4_IRQn, -1},
+};
+
+/* Private function ----------------------------------------------------------*/
+
+static TIM_TypeDef *_tim_regs(struct sim_tim *t)
+{
+    return (TIM_TypeDef *)sim_shadow(t->base);
+}
+
+static struct sim_tim *_tim_find(uint32_t addr)
+{
+    int i;
+
+    for (i = 0; i < SIM_TIM_NUM; i++)
+    {
+        if (addr >= tims[i].base && addr < tims[i].base + 0x400u)
+            return &tims[i];
+    }
+    return NULL;
+}
+
+/**=============================================================================
+ * @brief           定时器时钟：APB1 分频不为 1 时为 PCLK1 x2
+ *============================================================================*/
+static uint32_t _tim_clock(void)
+{
+    uint32_t pclk1 = sim_clock_pclk1();
+
+    if (SIM_PERIPH(RCC_TypeDef, RCC)->CFGR & RCC_CFGR_PPRE1_2)
+        return pclk1 * 2u;
+    return pclk1;
+}
+
+static uint64_t _tim_ticks_to_ns(struct sim_tim *t, uint64_t ticks)
+{
+    return sim_cycles_to_ns(ticks * (t->psc + 1u), _tim_clock());
+}
+
+/**=============================================================================
+ * @brief           当前计数值，由计数器为 0 的时刻推算
+ *============================================================================*/
+static uint32_t _tim_count(struct sim_tim *t)
+{
+    uint64_t clk = _tim_clock();
+
+    if (clk == 0 || sim_time() <= t->zero)
+        return 0;
+    return (uint32_t)((sim_time() - t->zero) * clk / SIM_NS_PER_SEC / (t->psc + 1u));
+}
+
+static int _tim_irq_level(void *arg)
+{
+    TIM_TypeDef *r = _tim_regs(arg);
+
+    return (r->SR & TIM_SR_UIF) && (r->DIER & TIM_DIER_UIE);
+}
+
+static void _tim_schedule(struct sim_tim *t)
+{
+    sim_event_at(&t->event, t->zero + _tim_ticks_to_ns(t, (uint64_t)t->arr + 1u));
+}
+
+/**=============================================================================
+ * @brief           更新事件：装入预装载值，置 UIF，按 MMS 输出 TRGO
+ *
+ * @param[in]       ug 由 EGR.UG 产生
+ *============================================================================*/
+static void _tim_update(struct sim_tim *t, int ug)
+{
+    TIM_TypeDef *r = _tim_regs(t);
+    uint32_t mms = r->CR2 & TIM_CR2_MMS;
+
+    t->psc = r->PSC & 0xFFFFu;
+    t->arr = r->ARR & 0xFFFFu;
+    t->updates++;
+    if (!ug || !(r->CR1 & TIM_CR1_URS))
+        r->SR |= TIM_SR_UIF;
+    if (_tim_irq_level(t))
+        sim_irq_pend(t->irq);
+
+    if (t->trgo >= 0 && (mms == SIM_TIM_MMS_UPDATE || (ug && mms == SIM_TIM_MMS_RESET)))
+        sim_adc_trigger(t->trgo);
+}
+
+static void _tim_overflow(struct sim_event *ev)
+{
+    struct sim_tim *t = ev->arg;
+
+    t->zero = ev->when;
+    _tim_update(t, 0);
+    if (_tim_regs(t)->CR1 & TIM_CR1_CEN)
+        _tim_schedule(t);
+}
+
+static void _tim_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    struct sim_tim *t = _tim_find(addr);
+
+    (void)p;
+    (void)for_write;
+    if (addr - t->base == 0x24u && (_tim_regs(t)->CR1 & TIM_CR1_CEN))
+        _tim_regs(t)->CNT = _tim_count(t);
+}
+
+static void _tim_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    struct sim_tim *t = _tim_find(addr);
+    TIM_TypeDef *r = _tim_regs(t);
+
+    (void)p;
+    switch (addr - t->base)
+    {
+    case 0x00:                                  /* CR1 */
+        if ((val & TIM_CR1_CEN) && !(old & TIM_CR1_CEN))
+        {
+            t->zero = sim_time() - _tim_ticks_to_ns(t, r->CNT);
+            _tim_schedule(t);
+        }
+        else if (!(val & TIM_CR1_CEN) && (old & TIM_CR1_CEN))
+        {
+            r->CNT = _tim_count(t);
+            sim_event_cancel(&t->event);
+        }
+        break;
+    case 0x10:                                  /* SR 写 0 清除 */
+        r->SR = old & val;
+        break;
+    case 0x14:                                  /* EGR 读为 0 */
+        r->EGR = 0;
+        if (val & TIM_EGR_UG)
+        {
+            r->CNT = 0;
+            t->zero = sim_time();
+            _tim_update(t, 1);
+            if (r->CR1 & TIM_CR1_CEN)
+                _tim_schedule(t);
+        }
+        break;
+    case 0x24:                                  /* CNT */
+        if (r->CR1 & TIM_CR1_CEN)
+        {
+            t->zero = sim_time() - _tim_ticks_to_ns(t, val & 0xFFFFu);
+            _tim_schedule(t);
+        }
+        break;
+    case 0x2C:                                  /* ARR 没有预装载时立即生效 */
+        if (!(r->CR1 & TIM_CR1_ARPE))
+        {
+            t->arr = val & 0xFFFFu;
+            if (r->CR1 & TIM_CR1_CEN)
+                _tim_schedule(t);
+        }
+        break;
+    default:
+        break;
+    }
+    if (_tim_irq_level(t))
+        sim_irq_pend(t->irq);
+}
+
+static void _tim_reset(struct sim_periph *p)
+{
+    struct sim_tim *t;
+    int i;
+
+    (void)p;
+    for (i = 0; i < SIM_TIM_NUM; i++)
+    {
+        t = &tims[i];
+        memset(_tim_regs(t), 0, 0x50);
+        _tim_regs(t)->ARR = 0xFFFFu;
+        t->psc = 0;
+        t->arr = 0xFFFFu;
+        t->zero = 0;
+        t->updates = 0;
+        sim_event_init(&t->event, _tim_overflow, t);
+    }
+}
+
+static struct sim_periph sim_tim2 = {"TIM2", TIM2_BASE, 0x400, _tim_reset, _tim_read, _tim_write, NULL, NULL};
+static struct sim_periph sim_tim3 = {"TIM3", TIM3_BASE, 0x400, NULL, _tim_read, _tim_write, NULL, NULL};
+static struct sim_periph sim_tim4 = {"TIM4", TIM4_BASE, 0x400, NULL, _tim_read, _tim_write, NULL, NULL};
+
+__attribute__((constructor)) static void _sim_tim_register(void)
+{
+    int i;
+
+    sim_periph_register(&sim_tim2);
+    sim_periph_register(&sim_tim3);
+    sim_periph_register(&sim_tim4);
+    for (i = 0; i < SIM_TIM_NUM; i++)
+        sim_irq_level_register(tims[i].irq, _tim_irq_level, &tims[i]);
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           复位以来的更新事件数，含 EGR.UG
+ *============================================================================*/
+uint32_t sim_tim_updates(TIM_TypeDef *tim)
+{
+    return _tim_find((uint32_t)(uintptr_t)tim)->updates;
+}
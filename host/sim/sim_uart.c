@@ -0,0 +1,388 @@
+/**
+  ******************************************************************************
+  * @file			sim_uart.c
+  * @brief			USART1..3 model: byte timing, status flags, IDLE and DMA requests
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <string.h>
+#include "sim.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SIM_UART_NUM            3
+#define SIM_UART_CAPTURE        65536
+#define SIM_UART_RX_QUEUE       4096
+#define SIM_UART_SR_ERRORS      (USART_SR_PE | USART_SR_FE | USART_SR_NE | USART_SR_ORE | USART_SR_IDLE)
+
+/* Private typedef -----------------------------------------------------------*/
+struct sim_uart
+{
+    uint32_t                base;
+    IRQn_Type               irq;
+    int                     apb2;           /*!< USART1 在 APB2 */
+    int                     echo;           /*!< 发送的字节同时输出到标准输出 */
+
+    int                     shift_busy;     /*!< 移位寄存器正在发送 */
+    uint8_t                 shift;
+    uint8_t                 hold;           /*!< DR 中等待的字节，TXE 为 0 */
+    int                     hold_full;
+    int                     sr_read;        /*!< 上一次访问是读 SR，用于清错误标志 */
+
+    uint8_t                 tx[SIM_UART_CAPTURE];
+    size_t                  tx_num;
+
+    uint8_t                 rx[SIM_UART_RX_QUEUE];
+    size_t                  rx_head, rx_tail;
+    int                     rx_active;      /*!< 接收线上有数据，结束后一帧时间置 IDLE */
+    uint32_t                rx_overruns;
+
+    struct sim_event        tx_event;
+    struct sim_event        rx_event;
+    struct sim_event        idle_event;
+    struct sim_dma_line     tx_line;
+    struct sim_dma_line     rx_line;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sim_uart uarts[SIM_UART_NUM] =
+{
+    {USART1_BASE, USART1_IRQn, 1, 1},
+    {USART2_BASE, USART2_IRQn, 0, 0},
+    {USART3_BASE, USART3_IRQn, 0, 0},
+};
+
+/* Private function ----------------------------------------------------------*/
+
+static USART_TypeDef *_uart_regs(struct sim_uart *u)
+{
+    return (USART_TypeDef *)sim_shadow(u->base);
+}
+
+static struct sim_uart *_uart_find(uint32_t addr)
+{
+    int i;
+
+    for (i = 0; i < SIM_UART_NUM; i++)
+    {
+        if (addr >= uarts[i].base && addr < uarts[i].base + 0x400u)
+            return &uarts[i];
+    }
+    return NULL;
+}
+
+/**=============================================================================
+ * @brief           一帧（起始位 + 8 数据位 + 停止位）的时间
+ *============================================================================*/
+static uint64_t _uart_frame_ns(struct sim_uart *u)
+{
+    uint32_t brr = _uart_regs(u)->BRR, pclk = u->apb2 ? sim_clock_pclk2() : sim_clock_pclk1();
+
+    if (brr == 0 || pclk == 0)
+        return SIM_US(100);
+    return sim_cycles_to_ns((uint64_t)brr * 10u, pclk);
+}
+
+/**=============================================================================
+ * @brief           中断请求：状态位与使能位同时有效
+ *============================================================================*/
+static int _uart_irq_level(void *arg)
+{
+    USART_TypeDef *r = _uart_regs(arg);
+    uint32_t sr = r->SR, cr1 = r->CR1, cr3 = r->CR3;
+
+    return ((sr & USART_SR_TXE) && (cr1 & USART_CR1_TXEIE)) ||
+           ((sr & USART_SR_TC) && (cr1 & USART_CR1_TCIE)) ||
+           ((sr & (USART_SR_RXNE | USART_SR_ORE)) && (cr1 & USART_CR1_RXNEIE)) ||
+           ((sr & USART_SR_IDLE) && (cr1 & USART_CR1_IDLEIE)) ||
+           ((sr & USART_SR_PE) && (cr1 & USART_CR1_PEIE)) ||
+           ((sr & (USART_SR_FE | USART_SR_NE | USART_SR_ORE)) && (cr3 & USART_CR3_EIE) && (cr3 & USART_CR3_DMAR));
+}
+
+static void _uart_irq_update(struct sim_uart *u)
+{
+    if (_uart_irq_level(u))
+        sim_irq_pend(u->irq);
+}
+
+static void _uart_tx_start(struct sim_uart *u, uint8_t byte)
+{
+    u->shift = byte;
+    u->shift_busy = 1;
+    _uart_regs(u)->SR &= ~USART_SR_TC;
+    sim_event_at(&u->tx_event, sim_time() + _uart_frame_ns(u));
+}
+
+/**=============================================================================
+ * @brief           一个字节发完：保存，装入 DR 中等待的字节或置 TC
+ *============================================================================*/
+static void _uart_tx_done(struct sim_event *ev)
+{
+    struct sim_uart *u = ev->arg;
+    USART_TypeDef *r = _uart_regs(u);
+
+    if (u->tx_num < SIM_UART_CAPTURE)
+        u->tx[u->tx_num++] = u->shift;
+    if (u->echo)
+        putchar(u->shift);
+    u->shift_busy = 0;
+
+    if (u->hold_full)
+    {
+        u->hold_full = 0;
+        r->SR |= USART_SR_TXE;
+        _uart_tx_start(u, u->hold);
+    }
+    else
+    {
+        r->SR |= USART_SR_TC;
+    }
+    sim_dma_line_update(&u->tx_line);
+    _uart_irq_update(u);
+}
+
+/**=============================================================================
+ * @brief           收到一个字节：RXNE 已置位时溢出丢弃
+ *============================================================================*/
+static void _uart_rx_byte(struct sim_event *ev)
+{
+    struct sim_uart *u = ev->arg;
+    USART_TypeDef *r = _uart_regs(u);
+
+    if (u->rx_head == u->rx_tail)
+        return;
+
+    if ((r->CR1 & (USART_CR1_UE | USART_CR1_RE)) == (USART_CR1_UE | USART_CR1_RE))
+    {
+        if (r->SR & USART_SR_RXNE)
+        {
+            r->SR |= USART_SR_ORE;
+            u->rx_overruns++;
+        }
+        else
+        {
+            r->DR = u->rx[u->rx_tail];
+            r->SR |= USART_SR_RXNE;
+        }
+    }
+    u->rx_tail = (u->rx_tail + 1u) % SIM_UART_RX_QUEUE;
+
+    sim_dma_line_update(&u->rx_line);
+    _uart_irq_update(u);
+
+    if (u->rx_head != u->rx_tail)
+        sim_event_at(&u->rx_event, sim_time() + _uart_frame_ns(u));
+    else
+        sim_event_at(&u->idle_event, sim_time() + _uart_frame_ns(u));
+}
+
+static void _uart_idle(struct sim_event *ev)
+{
+    struct sim_uart *u = ev->arg;
+    USART_TypeDef *r = _uart_regs(u);
+
+    if (!u->rx_active)
+        return;
+    u->rx_active = 0;
+    if (r->CR1 & USART_CR1_RE)
+        r->SR |= USART_SR_IDLE;
+    _uart_irq_update(u);
+}
+
+static int _uart_tx_level(void *arg)
+{
+    struct sim_uart *u = arg;
+    USART_TypeDef *r = _uart_regs(u);
+
+    return (r->CR3 & USART_CR3_DMAT) && (r->SR & USART_SR_TXE) && (r->CR1 & USART_CR1_TE);
+}
+
+static int _uart_rx_level(void *arg)
+{
+    struct sim_uart *u = arg;
+    USART_TypeDef *r = _uart_regs(u);
+
+    return (r->CR3 & USART_CR3_DMAR) && (r->SR & USART_SR_RXNE);
+}
+
+static void _uart_read(struct sim_periph *p, uint32_t addr, int for_write)
+{
+    struct sim_uart *u = _uart_find(addr);
+    USART_TypeDef *r = _uart_regs(u);
+    uint32_t off = addr - u->base;
+
+    (void)p;
+    if (for_write)
+        return;
+    if (off == 0x00u)
+    {
+        u->sr_read = 1;
+        return;
+    }
+    if (off == 0x04u)
+    {
+        /* 读 DR 清 RXNE，紧跟在读 SR 之后还清除错误和 IDLE */
+        r->SR &= ~USART_SR_RXNE;
+        if (u->sr_read)
+            r->SR &= ~SIM_UART_SR_ERRORS;
+    }
+    u->sr_read = 0;
+}
+
+static void _uart_write(struct sim_periph *p, uint32_t addr, uint32_t old, uint32_t val)
+{
+    struct sim_uart *u = _uart_find(addr);
+    USART_TypeDef *r = _uart_regs(u);
+    uint32_t off = addr - u->base;
+
+    (void)p;
+    switch (off)
+    {
+    case 0x00:                                  /* SR：RXNE、TC 写 0 清除，其余只读 */
+        r->SR = old & ~(~val & (USART_SR_RXNE | USART_SR_TC | USART_SR_LBD | USART_SR_CTS));
+        break;
+    case 0x04:
+        /* DR 写入的是发送数据，读出的仍然是接收数据 */
+        r->DR = old;
+        if (!(r->CR1 & USART_CR1_UE) || !(r->CR1 & USART_CR1_TE))
+            break;
+        if (u->sr_read)
+            r->SR &= ~USART_SR_TC;
+        if (!u->shift_busy)
+        {
+            _uart_tx_start(u, (uint8_t)val);
+        }
+        else if (!u->hold_full)
+        {
+            u->hold = (uint8_t)val;
+            u->hold_full = 1;
+            r->SR &= ~USART_SR_TXE;
+        }
+        else
+        {
+            sim_fatal("%s: DR written while TXE is 0", u->base == USART1_BASE ? "USART1" : "USART");
+        }
+        break;
+    case 0x0C:                                  /* CR1 */
+        if ((val & USART_CR1_TE) && !(old & USART_CR1_TE))
+            r->SR |= USART_SR_TXE;
+        break;
+    default:
+        break;
+    }
+    u->sr_read = 0;
+    _uart_irq_update(u);
+    sim_dma_line_update(&u->tx_line);
+    sim_dma_line_update(&u->rx_line);
+}
+
+static void _uart_reset(struct sim_periph *p)
+{
+    struct sim_uart *u;
+    int i;
+
+    (void)p;
+    for (i = 0; i < SIM_UART_NUM; i++)
+    {
+        u = &uarts[i];
+        memset(_uart_regs(u), 0, sizeof(USART_TypeDef));
+        _uart_regs(u)->SR = USART_SR_TXE | USART_SR_TC;
+        u->shift_busy = u->hold_full = u->sr_read = u->rx_active = 0;
+        u->tx_num = 0;
+        u->rx_head = u->rx_tail = 0;
+        u->rx_overruns = 0;
+        sim_event_init(&u->tx_event, _uart_tx_done, u);
+        sim_event_init(&u->rx_event, _uart_rx_byte, u);
+        sim_event_init(&u->idle_event, _uart_idle, u);
+        u->tx_line = (struct sim_dma_line){u->base + 0x04u, 1, _uart_tx_level, u, u->tx_line.next};
+        u->rx_line = (struct sim_dma_line){u->base + 0x04u, 0, _uart_rx_level, u, u->rx_line.next};
+    }
+}
+
+static struct sim_periph sim_usart1 = {"USART1", USART1_BASE, 0x400, _uart_reset, _uart_read, _uart_write, NULL, NULL};
+static struct sim_periph sim_usart2 = {"USART2", USART2_BASE, 0x400, NULL, _uart_read, _uart_write, NULL, NULL};
+static struct sim_periph sim_usart3 = {"USART3", USART3_BASE, 0x400, NULL, _uart_read, _uart_write, NULL, NULL};
+
+__attribute__((constructor)) static void _sim_uart_register(void)
+{
+    int i;
+
+    sim_periph_register(&sim_usart1);
+    sim_periph_register(&sim_usart2);
+    sim_periph_register(&sim_usart3);
+    for (i = 0; i < SIM_UART_NUM; i++)
+    {
+        sim_irq_level_register(uarts[i].irq, _uart_irq_level, &uarts[i]);
+        sim_dma_line_register(&uarts[i].tx_line);
+        sim_dma_line_register(&uarts[i].rx_line);
+    }
+}
+
+/* Public function -----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           从外部向 UART 发送数据，按波特率逐字节到达
+ *============================================================================*/
+void sim_uart_inject(USART_TypeDef *uart, const void *data, size_t len)
+{
+    struct sim_uart *u = _uart_find((uint32_t)(uintptr_t)uart);
+    const uint8_t *b = data;
+    int start = (u->rx_head == u->rx_tail);
+
+    while (len--)
+    {
+        u->rx[u->rx_head] = *b++;
+        u->rx_head = (u->rx_head + 1u) % SIM_UART_RX_QUEUE;
+        if (u->rx_head == u->rx_tail)
+            sim_fatal("uart rx queue overflow");
+    }
+    u->rx_active = 1;
+    sim_event_cancel(&u->idle_event);
+    if (start && !u->rx_event.armed)
+        sim_event_at(&u->rx_event, sim_time() + _uart_frame_ns(u));
+}
+
+/**=============================================================================
+ * @brief           取出 UART 已发送的数据
+ *
+ * @return          取出的字节数
+ *============================================================================*/
+size_t sim_uart_take(USART_TypeDef *uart, void *buf, size_t max)
+{
+    struct sim_uart *u = _uart_find((uint32_t)(uintptr_t)uart);
+    size_t n = u->tx_num < max ? u->tx_num : max;
+
+    memcpy(buf, u->tx, n);
+    memmove(u->tx, u->tx + n, u->tx_num - n);
+    u->tx_num -= n;
+    return n;
+}
+
+/**=============================================================================
+ * @brief           发送的数据是否同时打印到标准输出
+ *============================================================================*/
+void sim_uart_echo(USART_TypeDef *uart, int on)
+{
+    _uart_find((uint32_t)(uintptr_t)uart)->echo = on;
+}
+
+/**=============================================================================
+ * @brief           移位寄存器和 DR 都空闲
+ *============================================================================*/
+int sim_uart_tx_idle(USART_TypeDef *uart)
+{
+    struct sim_uart *u = _uart_find((uint32_t)(uintptr_t)uart);
+
+    return !u->shift_busy && !u->hold_full;
+}
+
+uint32_t sim_uart_overruns(USART_TypeDef *uart)
+{
+    return _uart_find((uint32_t)(uintptr_t)uart)->rx_overruns;
+}
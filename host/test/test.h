@@ -0,0 +1,63 @@
+/**
+  ******************************************************************************
+  * @file			test.h
+  * @brief			assertions for the host simulator tests
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Define to prevent recursive inclusion -------------------------------------*/
+#ifndef __TEST_H_
+#define __TEST_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <rtthread.h>
+#include "sim.h"
+#include "sim_host.h"
+
+/* Exported macros -----------------------------------------------------------*/
+/* 失败只记录不退出，sim_run 返回时汇总为进程退出码 */
+#define TEST_ASSERT(cond)                                                   \
+    do {                                                                    \
+        if (!(cond))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: assertion failed: %s\n",                \
+                    __FILE__, __LINE__, #cond);                             \
+            sim_host_fail();                                                \
+        }                                                                   \
+    } while (0)
+
+#define TEST_EQ(a, b)                                                       \
+    do {                                                                    \
+        long long _a = (long long)(a), _b = (long long)(b);                 \
+        if (_a != _b)                                                       \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: %s == %lld, expected %s == %lld\n",     \
+                    __FILE__, __LINE__, #a, _a, #b, _b);                    \
+            sim_host_fail();                                                \
+        }                                                                   \
+    } while (0)
+
+#define TEST_MEM_EQ(a, b, n)                                                \
+    do {                                                                    \
+        if (memcmp((a), (b), (n)) != 0)                                     \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: %s differs from %s\n",                  \
+                    __FILE__, __LINE__, #a, #b);                            \
+            sim_host_fail();                                                \
+        }                                                                   \
+    } while (0)
+
+/* 一个测试用例，打印名字便于定位 */
+#define TEST_CASE(fn)                                                       \
+    do {                                                                    \
+        printf("-- %s\n", #fn);                                             \
+        fn();                                                               \
+    } while (0)
+
+#endif  /* __TEST_H_ */
@@ -0,0 +1,682 @@
+/**
+  ******************************************************************************
+  * @file			test_adc_scan.c
+  * @brief			adc_scan: ping-pong block order, pending/held/torn/overrun
+  *                 accounting, dual mode packing, sustained sample rate,
+  *                 overruns behind a slow consumer, oversampling and HAL
+  *                 callbacks for other ADCs
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <time.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <dma_alloc.h>
+#include <adc_scan.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define MAX_COUNT           6
+#define MAX_SAMPLES         256
+#define SAMPLES             32
+#define RATE                10000
+#define FAST_RATE           150000
+#define RATE_BLOCKS         50
+#define OS_BLOCKS           3
+#define BENCH_ROUNDS        2000
+
+/* 过采样测试的信号 */
+enum
+{
+    OS_NOISE,                               /*!< 按通道和扫描序号散列的 12 位值 */
+    OS_FULL,                                /*!< 偶数通道满量程，奇数通道 0 */
+    OS_FRACTION,                            /*!< 每 4 次扫描中前 channel 次为 1 */
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct adc_scan      scan;
+static rt_uint16_t          buf[ADC_SCAN_BUF_SIZE(MAX_COUNT, MAX_SAMPLES)] __attribute__((aligned(4)));
+
+static const rt_uint8_t     quad[4] = {ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2, ADC_CHANNEL_3};
+static const rt_uint8_t     hexa[6] = {ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_4,
+                                       ADC_CHANNEL_5, ADC_CHANNEL_10, ADC_CHANNEL_11};
+static const rt_uint8_t     tri[3]  = {ADC_CHANNEL_0, ADC_CHANNEL_1, ADC_CHANNEL_2};
+static int                  os_pattern;
+
+/* Private function ----------------------------------------------------------*/
+
+/* 信号源：高 4 位为通道，低 8 位为扫描序号，能看出每个采样来自哪次触发的哪个通道 */
+static uint16_t _source(void *arg, uint32_t channel, uint32_t index)
+{
+    (void)arg;
+    return (uint16_t)(channel << 8 | (index & 0xFFu));
+}
+
+static uint16_t _os_value(uint32_t channel, uint32_t index)
+{
+    switch (os_pattern)
+    {
+    case OS_FULL:
+        return (channel & 1) ? 0 : 0xFFF;
+    case OS_FRACTION:
+        return (index & 3) < channel;
+    default:
+        return (uint16_t)(((index * 2654435761u) ^ (channel * 40503u)) >> 20);
+    }
+}
+
+static uint16_t _os_source(void *arg, uint32_t channel, uint32_t index)
+{
+    (void)arg;
+    return _os_value(channel, index) & 0xFFF;
+}
+
+static rt_uint16_t _expect(rt_uint8_t channel, rt_uint32_t group)
+{
+    return (rt_uint16_t)(channel << 8 | (group & 0xFFu));
+}
+
+static rt_uint64_t _block_ns(rt_uint16_t samples)
+{
+    return SIM_NS_PER_SEC * samples / scan.rate;
+}
+
+static void _setup(rt_uint8_t flags, const rt_uint8_t *channels, rt_uint8_t count, rt_uint16_t samples)
+{
+    struct sim_adc_stats st;
+
+    TEST_EQ(adc_scan_init(&scan, flags, channels, count, buf, samples), RT_EOK);
+    sim_adc_stats(ADC1, &st, 1);
+    sim_adc_stats(ADC2, &st, 1);
+}
+
+static void _teardown(void)
+{
+    TEST_EQ(adc_scan_stop(&scan), RT_EOK);
+    dma_free(&scan.hdma);
+}
+
+/**=============================================================================
+ * @brief           检查一块数据：每组每个通道都来自连续的扫描
+ *
+ * @return          不符合的采样数
+ *============================================================================*/
+static rt_uint32_t _check_block(const struct adc_scan_block *blk, const rt_uint8_t *channels)
+{
+    rt_uint32_t i, ch, bad = 0;
+
+    for (i = 0; i < blk->samples; i++)
+    {
+        for (ch = 0; ch < blk->count; ch++)
+        {
+            if (ADC_SCAN_SAMPLE(blk, ch, i) != _expect(channels[ch], blk->seq * blk->samples + i))
+                bad++;
+        }
+    }
+    return bad;
+}
+
+/**=============================================================================
+ * @brief           检查过采样的一块：每个结果等于对应 ratio 组原始采样之和舍入右移
+ *
+ * @return          不符合的结果数
+ *============================================================================*/
+static rt_uint32_t _os_check(const struct adc_scan_block *blk, const rt_uint8_t *channels)
+{
+    const rt_uint32_t ratio = scan.os_ratio, shift = scan.os_shift;
+    const rt_uint32_t round = shift ? 1u << (shift - 1) : 0;
+    rt_uint32_t j, ch, k, sum, bad = 0;
+
+    for (j = 0; j < blk->samples; j++)
+    {
+        for (ch = 0; ch < blk->count; ch++)
+        {
+            sum = 0;
+            for (k = 0; k < ratio; k++)
+                sum += _os_value(channels[ch], blk->seq * scan.samples + j * ratio + k) & 0xFFF;
+            if (ADC_SCAN_SAMPLE(blk, ch, j) != (sum + round) >> shift)
+                bad++;
+        }
+    }
+    return bad;
+}
+
+/**=============================================================================
+ * @brief           按给定配置过采样采集几块，逐个结果核对
+ *
+ * @return          不符合的结果数
+ *============================================================================*/
+static rt_uint32_t _os_run(rt_uint8_t flags, const rt_uint8_t *channels, rt_uint8_t count,
+                           rt_uint16_t *data, rt_uint16_t ratio, rt_uint8_t shift)
+{
+    struct adc_scan_block blk;
+    rt_uint32_t i, bad = 0;
+
+    TEST_EQ(adc_scan_init(&scan, flags, channels, count, data, MAX_SAMPLES), RT_EOK);
+    TEST_EQ(adc_scan_set_oversample(&scan, ratio, shift), RT_EOK);
+    TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+    for (i = 0; i < OS_BLOCKS; i++)
+    {
+        TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+        TEST_EQ(blk.samples, MAX_SAMPLES / ratio);
+        bad += _os_check(&blk, channels);
+        TEST_EQ(adc_scan_release(&scan), RT_EOK);
+    }
+    _teardown();
+    return bad;
+}
+
+/**=============================================================================
+ * @brief           乒乓顺序：前后半交替交出，块序号连续，数据不缺不重
+ *============================================================================*/
+static void test_pingpong(void)
+{
+    struct adc_scan_block blk;
+    struct sim_adc_stats st;
+    rt_uint32_t i;
+
+    _setup(0, quad, 4, SAMPLES);
+    TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+    TEST_EQ(scan.rate, RATE);
+    TEST_EQ(adc_scan_start(&scan, RATE), -RT_EBUSY);
+
+    for (i = 0; i < 8; i++)
+    {
+        TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+        TEST_EQ(blk.index, i & 1);
+        TEST_EQ(blk.seq, i);
+        TEST_EQ(blk.samples, SAMPLES);
+        TEST_EQ(blk.count, 4);
+        TEST_ASSERT(blk.data == buf + (i & 1) * 4 * SAMPLES);
+        TEST_EQ(_check_block(&blk, quad), 0);
+        TEST_EQ(adc_scan_release(&scan), RT_EOK);
+    }
+    _teardown();
+
+    TEST_EQ(adc_scan_wait(&scan, &blk, 0), -RT_EINTR);
+    TEST_EQ(scan.stats.delivered, 8);
+    TEST_EQ(scan.stats.overruns, 0);
+    TEST_EQ(scan.stats.torn, 0);
+    TEST_EQ(scan.stats.errors, 0);
+
+    sim_adc_stats(ADC1, &st, 0);
+    TEST_EQ(st.missed, 0);
+    TEST_EQ(st.overruns, 0);
+    TEST_EQ(st.conversions, st.scans * 4);
+}
+
+/**=============================================================================
+ * @brief           待取、处理中、被覆盖、被丢弃：每一步的状态和计数
+ *============================================================================*/
+static void test_counters(void)
+{
+    struct adc_scan_block blk;
+    rt_uint64_t block;
+
+    _setup(0, quad, 4, SAMPLES);
+    TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+    block = _block_ns(SAMPLES);
+
+    /* 取走块 0，处理中 */
+    TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+    TEST_EQ(blk.index, 0);
+    TEST_EQ(scan.held, 0);
+    TEST_EQ(scan.pending, ADC_SCAN_NONE);
+
+    /* 块 1 采满，DMA 开始覆盖块 0 */
+    sim_advance(block + block / 2);
+    TEST_EQ(scan.pending, 1);
+    TEST_EQ(scan.held, ADC_SCAN_NONE);
+    TEST_EQ(scan.stats.torn, 1);
+    TEST_EQ(scan.stats.overruns, 0);
+    TEST_EQ(adc_scan_release(&scan), -RT_EFULL);
+
+    /* 块 1 没人取，块 0 采满时丢弃块 1 */
+    sim_advance(block);
+    TEST_EQ(scan.pending, 0);
+    TEST_EQ(scan.stats.overruns, 1);
+    TEST_EQ(scan.stats.blocks, 3);
+
+    /* 信号量只释放过一次，取到的是最新的块，序号跳过被丢弃的块 */
+    TEST_EQ(adc_scan_wait(&scan, &blk, 0), RT_EOK);
+    TEST_EQ(blk.index, 0);
+    TEST_EQ(blk.seq, 2);
+    TEST_EQ(_check_block(&blk, quad), 0);
+    TEST_EQ(adc_scan_release(&scan), RT_EOK);
+    TEST_EQ(adc_scan_wait(&scan, &blk, 0), -RT_ETIMEOUT);
+
+    TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+    TEST_EQ(blk.index, 1);
+    TEST_EQ(blk.seq, 3);
+    TEST_EQ(adc_scan_release(&scan), RT_EOK);
+
+    /* 再次等待自动释放上一块 */
+    TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+    TEST_EQ(scan.held, 0);
+    TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+    TEST_EQ(scan.held, 1);
+    TEST_EQ(scan.stats.delivered, 5);
+    TEST_EQ(scan.stats.torn, 1);
+    TEST_EQ(scan.stats.overruns, 1);
+    _teardown();
+}
+
+/**=============================================================================
+ * @brief           其他 ADC 的 HAL 回调不碰引擎：不交块、不停采集
+ *============================================================================*/
+static void test_foreign(void)
+{
+    ADC_HandleTypeDef other = {0};
+    struct adc_scan_block blk;
+
+    _setup(0, quad, 4, SAMPLES);
+    TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+
+    other.Instance = ADC2;
+    HAL_ADC_ConvHalfCpltCallback(&other);
+    HAL_ADC_ConvCpltCallback(&other);
+    HAL_ADC_ErrorCallback(&other);
+    TEST_EQ(scan.stats.blocks, 0);
+    TEST_EQ(scan.stats.errors, 0);
+    TEST_EQ(scan.pending, ADC_SCAN_NONE);
+    TEST_EQ(scan.running, 1);
+
+    TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+    TEST_EQ(blk.index, 0);
+    TEST_EQ(blk.seq, 0);
+    TEST_EQ(_check_block(&blk, quad), 0);
+    _teardown();
+}
+
+/**=============================================================================
+ * @brief           同步模式：一个字里低半字为 ADC1、高半字为 ADC2，
+ *                  两者来自同一次触发
+ *============================================================================*/
+static void test_dual(void)
+{
+    struct adc_scan_block blk;
+    struct sim_adc_stats st1, st2;
+    const rt_uint32_t *w;
+    rt_uint32_t i, k, bad = 0;
+
+    TEST_EQ(adc_scan_init(&scan, ADC_SCAN_DUAL, hexa, 5, buf, SAMPLES), -RT_EINVAL);
+    TEST_EQ(adc_scan_init(&scan, ADC_SCAN_DUAL, hexa, 6, buf + 1, SAMPLES), -RT_EINVAL);
+
+    _setup(ADC_SCAN_DUAL, hexa, 6, SAMPLES);
+    TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+    for (i = 0; i < 4; i++)
+    {
+        TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+        TEST_EQ(blk.seq, i);
+        TEST_EQ(blk.count, 6);
+        TEST_EQ(_check_block(&blk, hexa), 0);
+
+        w = (const rt_uint32_t *)blk.data;
+        for (k = 0; k < 3u * SAMPLES; k++)
+        {
+            if ((w[k] & 0xFFFF) != _expect(hexa[2 * (k % 3)], i * SAMPLES + k / 3) ||
+                (w[k] >> 16) != _expect(hexa[2 * (k % 3) + 1], i * SAMPLES + k / 3))
+                bad++;
+        }
+        TEST_EQ(adc_scan_release(&scan), RT_EOK);
+    }
+    _teardown();
+    TEST_EQ(bad, 0);
+
+    /* 两个 ADC 各做 3 个转换，DMA 按字读走，ADC1 没有被覆盖的结果 */
+    sim_adc_stats(ADC1, &st1, 0);
+    sim_adc_stats(ADC2, &st2, 0);
+    TEST_EQ(st1.scans, st2.scans);
+    TEST_EQ(st1.conversions, st1.scans * 3);
+    TEST_EQ(st2.conversions, st2.scans * 3);
+    TEST_EQ(st1.missed, 0);
+    TEST_EQ(st1.overruns, 0);
+}
+
+/**=============================================================================
+ * @brief           持续速率：块的间隔与 scan->rate 一致，扫描不丢触发；
+ *                  最高速率下采样时间降到最短，再高则拒绝
+ *============================================================================*/
+static void test_rate(void)
+{
+    static const rt_uint32_t rates[] = {RATE, 44100, FAST_RATE};
+    struct adc_scan_block blk;
+    struct sim_adc_stats st;
+    rt_uint64_t t0, ns, expect;
+    rt_uint32_t i, n, gaps, bad, updates = 0;
+
+    for (i = 0; i < sizeof(rates) / sizeof(rates[0]); i++)
+    {
+        _setup(0, quad, 4, 64);
+        TEST_EQ(adc_scan_start(&scan, rates[i]), RT_EOK);
+        TEST_ASSERT(scan.rate >= rates[i] - rates[i] / 1000 && scan.rate <= rates[i] + rates[i] / 1000);
+
+        t0 = 0;
+        gaps = bad = 0;
+        for (n = 0; n < RATE_BLOCKS; n++)
+        {
+            TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+            if (n == 0)
+            {
+                t0 = sim_time();
+                updates = sim_tim_updates(TIM3);
+            }
+            if (blk.seq != n)
+                gaps++;
+            bad += _check_block(&blk, quad);
+            adc_scan_release(&scan);
+        }
+        ns = sim_time() - t0;
+        updates = sim_tim_updates(TIM3) - updates;
+        _teardown();
+
+        /* 首尾两块之间经过 RATE_BLOCKS - 1 块，允许 0.1% 误差 */
+        expect = SIM_NS_PER_SEC * 64 * (RATE_BLOCKS - 1) / scan.rate;
+        printf("   %6u Hz: sample time %u, %u blocks in %llu us, measured %llu Hz\n",
+               scan.rate, scan.sample_time, RATE_BLOCKS, (unsigned long long)(ns / 1000),
+               (unsigned long long)(SIM_NS_PER_SEC * 64 * (RATE_BLOCKS - 1) / ns));
+        TEST_ASSERT(ns >= expect - expect / 1000 && ns <= expect + expect / 1000);
+        TEST_EQ(gaps, 0);
+        TEST_EQ(bad, 0);
+        TEST_EQ(scan.stats.overruns, 0);
+
+        sim_adc_stats(ADC1, &st, 0);
+        TEST_EQ(st.missed, 0);
+        TEST_EQ(st.overruns, 0);
+        TEST_ASSERT(st.triggers - st.scans <= 1);
+        TEST_ASSERT(updates >= (rt_uint64_t)scan.rate * ns / SIM_NS_PER_SEC - 1 &&
+                    updates <= (rt_uint64_t)scan.rate * ns / SIM_NS_PER_SEC + 1);
+    }
+    TEST_EQ(scan.sample_time, ADC_SAMPLETIME_1CYCLE_5);
+
+    /* 4 个通道在 12MHz 下每次扫描至少 4 x 14 个时钟 */
+    _setup(0, quad, 4, 64);
+    TEST_EQ(adc_scan_start(&scan, 250000), -RT_EINVAL);
+    TEST_EQ(adc_scan_start(&scan, 0), -RT_EINVAL);
+    dma_free(&scan.hdma);
+}
+
+/**=============================================================================
+ * @brief           慢速使用者：处理一块的时间超过两块，块被覆盖和丢弃，
+ *                  计数与序号的跳跃一致，恢复正常速度后序号重新连续
+ *============================================================================*/
+static void test_slow_consumer(void)
+{
+    struct adc_scan_block blk;
+    rt_uint64_t block;
+    rt_uint32_t i, prev, skipped = 0, efull = 0;
+    rt_base_t level;
+    rt_int8_t pending;
+    rt_uint32_t blocks, delivered, overruns;
+
+    _setup(0, quad, 4, SAMPLES);
+    TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+    block = _block_ns(SAMPLES);
+
+    prev = (rt_uint32_t)-1;
+    for (i = 0; i < 10; i++)
+    {
+        TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+        skipped += blk.seq - prev - 1;
+        prev = blk.seq;
+        sim_advance(block * 5 / 2);
+        if (adc_scan_release(&scan) == -RT_EFULL)
+            efull++;
+    }
+
+    /* 每块要么交出，要么被丢弃，要么还在等待 */
+    level = rt_hw_interrupt_disable();
+    pending   = scan.pending;
+    blocks    = scan.stats.blocks;
+    delivered = scan.stats.delivered;
+    overruns  = scan.stats.overruns;
+    rt_hw_interrupt_enable(level);
+    printf("   %u blocks, %u delivered, %u overruns, %u torn\n",
+           blocks, delivered, overruns, scan.stats.torn);
+    TEST_EQ(blocks, delivered + overruns + (pending != ADC_SCAN_NONE));
+    TEST_EQ(efull, 10);
+    TEST_EQ(scan.stats.torn, 10);
+    TEST_ASSERT(overruns > 0);
+
+    /* 等待时取到的是最新的块，跳过的序号都记为丢弃 */
+    TEST_EQ(adc_scan_wait(&scan, &blk, 0), RT_EOK);
+    skipped += blk.seq - prev - 1;
+    prev = blk.seq;
+    TEST_EQ(skipped, scan.stats.overruns);
+
+    /* 跟上后不再丢块，数据仍然连续 */
+    for (i = 0; i < 4; i++)
+    {
+        TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+        TEST_EQ(blk.seq, prev + 1);
+        prev = blk.seq;
+        TEST_EQ(_check_block(&blk, quad), 0);
+        TEST_EQ(adc_scan_release(&scan), RT_EOK);
+    }
+    TEST_EQ(scan.stats.overruns, skipped);
+    TEST_EQ(scan.stats.errors, 0);
+    _teardown();
+}
+
+/**=============================================================================
+ * @brief           过采样参数：比值须为 4 ~ 256 之间 2 的幂并整除每块组数，
+ *                  结果不超过 16 位，采集中不能修改
+ *============================================================================*/
+static void test_os_reject(void)
+{
+    static const rt_uint16_t bad_ratios[] = {2, 3, 5, 6, 12, 24, 48, 96, 192, 128, 256, 512};
+    static const rt_uint16_t good[][2] = {{4, 0}, {8, 0}, {16, 0}, {32, 1}, {64, 2}};
+    rt_size_t i;
+
+    /* 192 组能被 3、12、96 等整除，只有 2 的幂检查能拒绝它们 */
+    _setup(0, quad, 4, 192);
+    for (i = 0; i < sizeof(bad_ratios) / sizeof(bad_ratios[0]); i++)
+        TEST_EQ(adc_scan_set_oversample(&scan, bad_ratios[i], 0), -RT_EINVAL);
+    TEST_EQ(scan.os_ratio, 1);
+    for (i = 0; i < sizeof(good) / sizeof(good[0]); i++)
+    {
+        TEST_EQ(adc_scan_set_oversample(&scan, good[i][0], (rt_uint8_t)good[i][1]), RT_EOK);
+        TEST_EQ(scan.os_ratio, good[i][0]);
+    }
+    /* 32x 不右移会超出 16 位 */
+    TEST_EQ(adc_scan_set_oversample(&scan, 32, 0), -RT_EINVAL);
+    TEST_EQ(adc_scan_set_oversample(&scan, 0, 0), RT_EOK);
+    TEST_EQ(scan.os_ratio, 1);
+    TEST_EQ(adc_scan_set_oversample(&scan, 64, 3), RT_EOK);
+    TEST_EQ(adc_scan_set_oversample(&scan, 1, 3), RT_EOK);
+    TEST_EQ(scan.os_shift, 0);
+
+    /* 右移不超过 log2(ratio)，16x 最多右移 4 */
+    TEST_EQ(adc_scan_set_oversample(&scan, 16, 5), -RT_EINVAL);
+    TEST_EQ(adc_scan_set_oversample(&scan, 16, 4), RT_EOK);
+
+    TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+    TEST_EQ(adc_scan_set_oversample(&scan, 4, 0), -RT_EBUSY);
+    _teardown();
+
+    /* 256x 累加和 20 位，至少右移 4 */
+    _setup(0, quad, 4, MAX_SAMPLES);
+    TEST_EQ(adc_scan_set_oversample(&scan, 256, 3), -RT_EINVAL);
+    TEST_EQ(adc_scan_set_oversample(&scan, 256, 9), -RT_EINVAL);
+    TEST_EQ(adc_scan_set_oversample(&scan, 256, 4), RT_EOK);
+    TEST_EQ(adc_scan_set_oversample(&scan, 256, 8), RT_EOK);
+    dma_free(&scan.hdma);
+}
+
+/**=============================================================================
+ * @brief           偶数通道按字累加两个通道：比值超过 ADC_SCAN_LANE_RUN 时
+ *                  分段拆开高低半字，满量程的低半字不会进位到相邻通道
+ *============================================================================*/
+static void test_os_lanes(void)
+{
+    static const rt_uint16_t cfg[][2] = {{4, 1}, {16, 2}, {32, 2}, {64, 3}, {256, 4}};
+    rt_size_t i;
+
+    sim_adc_attach(ADC1, _os_source, RT_NULL);
+    sim_adc_attach(ADC2, _os_source, RT_NULL);
+    for (i = 0; i < sizeof(cfg) / sizeof(cfg[0]); i++)
+    {
+        os_pattern = OS_NOISE;
+        TEST_EQ(_os_run(0, quad, 4, buf, cfg[i][0], (rt_uint8_t)cfg[i][1]), 0);
+        os_pattern = OS_FULL;
+        TEST_EQ(_os_run(0, quad, 4, buf, cfg[i][0], (rt_uint8_t)cfg[i][1]), 0);
+    }
+
+    /* 同步模式 6 个通道，3 个字 */
+    os_pattern = OS_NOISE;
+    TEST_EQ(_os_run(ADC_SCAN_DUAL, hexa, 6, buf, 32, 2), 0);
+    os_pattern = OS_FULL;
+    TEST_EQ(_os_run(ADC_SCAN_DUAL, hexa, 6, buf, 32, 2), 0);
+}
+
+/**=============================================================================
+ * @brief           奇数通道和不对齐的缓冲走逐个相加的路径，结果相同
+ *============================================================================*/
+static void test_os_scalar(void)
+{
+    os_pattern = OS_NOISE;
+    TEST_EQ(_os_run(0, tri, 3, buf, 32, 2), 0);
+    TEST_EQ(_os_run(0, quad, 2, buf + 1, 16, 2), 0);
+    TEST_EQ(_os_run(0, tri, 3, buf, 256, 4), 0);
+
+    os_pattern = OS_FULL;
+    TEST_EQ(_os_run(0, tri, 3, buf, 32, 2), 0);
+    TEST_EQ(_os_run(0, quad, 2, buf + 1, 256, 4), 0);
+}
+
+/**=============================================================================
+ * @brief           256x 满量程：右移 4 得 16 位的 0xFFF0，右移 8 回到 12 位
+ *============================================================================*/
+static void test_os_full_scale(void)
+{
+    static const rt_uint8_t shifts[] = {4, 8};
+    struct adc_scan_block blk;
+    rt_uint32_t s, ch, full;
+
+    os_pattern = OS_FULL;
+    for (s = 0; s < sizeof(shifts) / sizeof(shifts[0]); s++)
+    {
+        full = (0xFFFu * 256 + (1u << (shifts[s] - 1))) >> shifts[s];
+        printf("   256x >> %u: %u\n", shifts[s], full);
+
+        _setup(0, quad, 4, MAX_SAMPLES);
+        TEST_EQ(adc_scan_set_oversample(&scan, 256, shifts[s]), RT_EOK);
+        TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+        TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+        TEST_EQ(blk.samples, 1);
+        for (ch = 0; ch < 4; ch++)
+            TEST_EQ(ADC_SCAN_SAMPLE(&blk, ch, 0), (ch & 1) ? 0 : full);
+        _teardown();
+    }
+    TEST_EQ((0xFFFu * 256 + 8) >> 4, 0xFFF0);
+}
+
+/**=============================================================================
+ * @brief           舍入：累加和加上 2^(shift-1) 再右移，0.5 进位，0.25 舍去
+ *============================================================================*/
+static void test_os_rounding(void)
+{
+    /* 4x 时第 c 个通道的累加和为 c */
+    static const rt_uint16_t expect[3][4] = {{0, 1, 2, 3}, {0, 1, 1, 2}, {0, 0, 1, 1}};
+    struct adc_scan_block blk;
+    rt_uint32_t shift, j, ch, bad;
+
+    os_pattern = OS_FRACTION;
+    for (shift = 0; shift <= 2; shift++)
+    {
+        _setup(0, quad, 4, SAMPLES);
+        TEST_EQ(adc_scan_set_oversample(&scan, 4, (rt_uint8_t)shift), RT_EOK);
+        TEST_EQ(adc_scan_start(&scan, RATE), RT_EOK);
+        TEST_EQ(adc_scan_wait(&scan, &blk, rt_tick_from_millisecond(100)), RT_EOK);
+        bad = 0;
+        for (j = 0; j < blk.samples; j++)
+        {
+            for (ch = 0; ch < 4; ch++)
+                bad += ADC_SCAN_SAMPLE(&blk, ch, j) != expect[shift][ch];
+        }
+        TEST_EQ(bad, 0);
+        TEST_EQ(_os_check(&blk, quad), 0);
+        _teardown();
+    }
+    sim_adc_attach(ADC1, _source, RT_NULL);
+    sim_adc_attach(ADC2, _source, RT_NULL);
+}
+
+/**=============================================================================
+ * @brief           过采样在 DMA 中断里的开销，按每个输出结果计
+ *
+ * @note            模拟器里 CPU 执行不耗时，直接调用半满回调，用主机时钟测量；
+ *                  打包路径与逐个相加的路径在同一主机上比较
+ *============================================================================*/
+static void test_os_bench(void)
+{
+    static const struct
+    {
+        const char     *name;
+        rt_uint8_t      count;
+        rt_uint8_t      offset;             /*!< 缓冲偏移半字数，1 时不对齐 */
+        rt_uint16_t     ratio;
+        rt_uint8_t      shift;
+    } cfg[] =
+    {
+        {"packed  4ch 16x",  4, 0, 16,  2},
+        {"scalar  4ch 16x",  4, 1, 16,  2},
+        {"packed  4ch 256x", 4, 0, 256, 4},
+        {"scalar  4ch 256x", 4, 1, 256, 4},
+        {"scalar  3ch 256x", 3, 0, 256, 4},
+    };
+    struct timespec t0, t1;
+    rt_uint32_t i, r, outputs;
+    double ns;
+
+    for (i = 0; i < sizeof(cfg) / sizeof(cfg[0]); i++)
+    {
+        _setup(0, quad, cfg[i].count, MAX_SAMPLES);
+        scan.buf += cfg[i].offset;
+        TEST_EQ(adc_scan_set_oversample(&scan, cfg[i].ratio, cfg[i].shift), RT_EOK);
+        for (r = 0; r < (rt_uint32_t)cfg[i].count * MAX_SAMPLES; r++)
+            scan.buf[r] = _os_value(r % cfg[i].count, r) & 0xFFF;
+
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (r = 0; r < BENCH_ROUNDS; r++)
+            HAL_ADC_ConvHalfCpltCallback(&scan.hadc);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        dma_free(&scan.hdma);
+
+        outputs = (rt_uint32_t)cfg[i].count * (MAX_SAMPLES / cfg[i].ratio);
+        ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / BENCH_ROUNDS;
+        printf("   %-18s %8.1f ns/result, %5.2f ns/input (host)\n", cfg[i].name,
+               ns / outputs, ns / outputs / cfg[i].ratio);
+    }
+}
+
+static void test_main(void)
+{
+    sim_adc_attach(ADC1, _source, RT_NULL);
+    sim_adc_attach(ADC2, _source, RT_NULL);
+
+    TEST_CASE(test_pingpong);
+    TEST_CASE(test_counters);
+    TEST_CASE(test_foreign);
+    TEST_CASE(test_dual);
+    TEST_CASE(test_rate);
+    TEST_CASE(test_slow_consumer);
+    TEST_CASE(test_os_reject);
+    TEST_CASE(test_os_lanes);
+    TEST_CASE(test_os_scalar);
+    TEST_CASE(test_os_full_scale);
+    TEST_CASE(test_os_rounding);
+    TEST_CASE(test_os_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
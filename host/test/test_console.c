@@ -0,0 +1,333 @@
+/**
+  ******************************************************************************
+  * @file			test_console.c
+  * @brief			console over the simulated USART1: DMA TX ring and RX path,
+ *                  caller time and throughput against per-byte HAL_UART_Transmit
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <string.h>
+#include <rtthread.h>
+#include <console.h>
+#include "stm32f1xx_hal.h"
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define PRODUCER_LINES      200
+#define PRODUCER_WIDTH      30
+#define BENCH_SHORT_LINES   32
+#define BENCH_LONG_LINES    4
+#define BENCH_LONG_WIDTH    120
+
+/* Private variables ---------------------------------------------------------*/
+static struct rt_thread     producer_thread[2];
+static struct rt_thread     worker_thread;
+static rt_uint8_t           producer_stack[2][512];
+static rt_uint8_t           worker_stack[512];
+static struct rt_semaphore  producer_done;
+static volatile rt_uint32_t worker_runs;
+static volatile int         worker_stop;
+static char                 output[40000];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           等待 USART1 发完，取出发送的数据
+ *============================================================================*/
+static size_t _tx_drain(char *buf, size_t max)
+{
+    size_t n;
+
+    while (!sim_uart_tx_idle(USART1))
+        rt_thread_delay(1);
+    rt_thread_delay(2);
+    n = sim_uart_take(USART1, buf, max - 1);
+    buf[n] = '\0';
+    return n;
+}
+
+static void test_output(void)
+{
+    char buf[256];
+
+    _tx_drain(buf, sizeof(buf));
+    rt_kprintf("hello %d\n", 42);
+    _tx_drain(buf, sizeof(buf));
+    TEST_ASSERT(strcmp(buf, "hello 42\r\n") == 0);
+}
+
+static void test_input(void)
+{
+    char c[4];
+    int i;
+
+    sim_uart_inject(USART1, "abc", 3);
+    for (i = 0; i < 3; i++)
+        c[i] = rt_hw_console_getchar();
+    TEST_MEM_EQ(c, "abc", 3);
+}
+
+/**=============================================================================
+ * @brief           自动初始化之后再调用 rt_console_init：正在发送的输出不被截断，
+ *                  循环 DMA 接收继续工作
+ *============================================================================*/
+static void test_reinit(void)
+{
+    static const char line[] = "boot banner still going out over DMA\n";
+    char buf[64], c[6];
+    int i;
+
+    _tx_drain(buf, sizeof(buf));
+    sim_uart_inject(USART1, "abc", 3);
+    rt_thread_mdelay(5);
+    rt_kprintf("%s", line);
+    rt_console_init();
+
+    _tx_drain(buf, sizeof(buf));
+    TEST_ASSERT(strcmp(buf, "boot banner still going out over DMA\r\n") == 0);
+
+    /* 重新初始化前收到而未取走的数据还在，DMA 接收位置也没有被打乱 */
+    sim_uart_inject(USART1, "xyz", 3);
+    for (i = 0; i < 6; i++)
+        c[i] = rt_hw_console_getchar();
+    TEST_MEM_EQ(c, "abcxyz", 6);
+}
+
+/**=============================================================================
+ * @brief           921600 波特率下连续突发接收，线程边收边取，不丢字节
+ *============================================================================*/
+static void test_rx_burst(void)
+{
+    static const rt_size_t bursts[] = {1000, 37, 1, 2000};
+    static char in[2000], out[2000];
+    rt_uint32_t dropped = rt_console_get_rx_dropped();
+    rt_uint32_t brr = USART1->BRR;
+    rt_size_t b, i;
+
+    USART1->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK2Freq(), 921600);
+    for (b = 0; b < sizeof(bursts) / sizeof(bursts[0]); b++)
+    {
+        for (i = 0; i < bursts[b]; i++)
+            in[i] = (char)(i * 7 + b);
+        sim_uart_inject(USART1, in, bursts[b]);
+        for (i = 0; i < bursts[b]; i++)
+            out[i] = rt_hw_console_getchar();
+        TEST_MEM_EQ(out, in, bursts[b]);
+    }
+    USART1->BRR = brr;
+
+    TEST_EQ(rt_console_get_rx_dropped() - dropped, 0);
+    TEST_EQ(sim_uart_overruns(USART1), 0);
+}
+
+/**=============================================================================
+ * @brief           没有线程取数据时，ringbuffer 放不下的字节计入丢弃数
+ *============================================================================*/
+static void test_rx_dropped(void)
+{
+    static char in[400], out[RT_CONSOLE_RX_BUF_SIZE];
+    rt_uint32_t dropped = rt_console_get_rx_dropped();
+    rt_size_t i;
+
+    for (i = 0; i < sizeof(in); i++)
+        in[i] = (char)i;
+    sim_uart_inject(USART1, in, sizeof(in));
+    rt_thread_mdelay(100);
+
+    TEST_EQ(rt_console_get_rx_dropped() - dropped, sizeof(in) - RT_CONSOLE_RX_BUF_SIZE);
+    for (i = 0; i < sizeof(out); i++)
+        out[i] = rt_hw_console_getchar();
+    TEST_MEM_EQ(out, in, sizeof(out));
+}
+
+/* 随机时刻进入的中断，也往控制台输出 */
+void EXTI0_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    rt_kputs("i\n");
+    rt_interrupt_leave();
+}
+
+static void _producer_entry(void *parameter)
+{
+    char line[PRODUCER_WIDTH + 2];
+    int i;
+
+    memset(line, (int)(intptr_t)parameter, PRODUCER_WIDTH);
+    line[PRODUCER_WIDTH] = '\n';
+    line[PRODUCER_WIDTH + 1] = '\0';
+    for (i = 0; i < PRODUCER_LINES; i++)
+        rt_kputs(line);
+    rt_sem_release(&producer_done);
+}
+
+static void _worker_entry(void *parameter)
+{
+    (void)parameter;
+    while (!worker_stop)
+    {
+        worker_runs++;
+        rt_thread_yield();
+    }
+}
+
+/**=============================================================================
+ * @brief           两个线程和一个中断同时输出：线程的字符不丢不乱，缓冲满时
+ *                  输出线程阻塞，低优先级线程仍能运行
+ *============================================================================*/
+static void test_producers(void)
+{
+    size_t n, i, count[256] = {0};
+
+    _tx_drain(output, sizeof(output));
+    rt_sem_init(&producer_done, "done", 0, RT_IPC_FLAG_FIFO);
+    rt_thread_init(&producer_thread[0], "pa", _producer_entry, (void *)'A',
+                   producer_stack[0], sizeof(producer_stack[0]), 2, 2);
+    rt_thread_init(&producer_thread[1], "pb", _producer_entry, (void *)'B',
+                   producer_stack[1], sizeof(producer_stack[1]), 2, 3);
+    rt_thread_init(&worker_thread, "work", _worker_entry, RT_NULL,
+                   worker_stack, sizeof(worker_stack), 6, 5);
+
+    HAL_NVIC_SetPriority(EXTI0_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+    sim_preempt_random(20, EXTI0_IRQn);
+
+    worker_runs = 0;
+    rt_thread_startup(&worker_thread);
+    rt_thread_startup(&producer_thread[0]);
+    rt_thread_startup(&producer_thread[1]);
+    rt_sem_take(&producer_done, RT_WAITING_FOREVER);
+    rt_sem_take(&producer_done, RT_WAITING_FOREVER);
+
+    sim_preempt_random(0, EXTI0_IRQn);
+    HAL_NVIC_DisableIRQ(EXTI0_IRQn);
+    worker_stop = 1;
+    n = _tx_drain(output, sizeof(output));
+
+    for (i = 0; i < n; i++)
+        count[(rt_uint8_t)output[i]]++;
+    TEST_EQ(count['A'], PRODUCER_LINES * PRODUCER_WIDTH);
+    TEST_EQ(count['B'], PRODUCER_LINES * PRODUCER_WIDTH);
+    TEST_EQ(count['\r'], count['\n']);
+    TEST_EQ(count['A'] + count['B'] + count['i'] + count['\r'] + count['\n'], n);
+    for (i = 0; i < n; i++)
+    {
+        if (output[i] == '\n' && (i == 0 || output[i - 1] != '\r'))
+        {
+            TEST_ASSERT(!"\\n without \\r");
+            break;
+        }
+    }
+    /* 输出线程优先级更高，忙等时工作线程得不到运行 */
+    TEST_ASSERT(worker_runs > 100);
+    printf("   %zu bytes, %zu from isr, worker ran %u times\n", n, count['i'], (unsigned)worker_runs);
+}
+
+/**=============================================================================
+ * @brief           改动前的输出：每个字符一次 HAL_UART_Transmit，超时 1ms
+ *============================================================================*/
+static void _legacy_output(UART_HandleTypeDef *huart, const char *str)
+{
+    rt_size_t i = 0, size = 0;
+    char a = '\r';
+
+    __HAL_UNLOCK(huart);
+
+    size = rt_strlen(str);
+    for (i = 0; i < size; i++)
+    {
+        if (*(str + i) == '\n')
+        {
+            HAL_UART_Transmit(huart, (uint8_t *)&a, 1, 1);
+        }
+        HAL_UART_Transmit(huart, (uint8_t *)(str + i), 1, 1);
+    }
+}
+
+/**=============================================================================
+ * @brief           短行和长行各输出一批：调用方耗时、每行耗时、调用方和线上的
+ *                  字节率，与逐字节 HAL_UART_Transmit 比较
+ *
+ * @note            一批的总长不超过发送缓冲，DMA 路径的调用方不会等待；
+ *                  模拟时间只计寄存器访问和开关中断，拷贝本身不计时
+ *============================================================================*/
+static void test_bench(void)
+{
+    static const char * const path[] = {"rt_hw_console_output", "HAL_UART_Transmit x1"};
+    static char line[2][BENCH_LONG_WIDTH + 2];
+    static const int lines[2] = {BENCH_SHORT_LINES, BENCH_LONG_LINES};
+    UART_HandleTypeDef huart;
+    rt_uint64_t t0, caller[2][2], wire[2][2];
+    size_t bytes[2];
+    int k, m, i;
+
+    /* 与 rt_hw_uart_init 相同的格式，句柄直接就绪，不重新初始化 USART1 */
+    memset(&huart, 0, sizeof(huart));
+    huart.Instance            = USART1;
+    huart.Init.WordLength     = UART_WORDLENGTH_8B;
+    huart.Init.StopBits       = UART_STOPBITS_1;
+    huart.Init.Parity         = UART_PARITY_NONE;
+    huart.Init.Mode           = UART_MODE_TX_RX;
+    huart.gState              = HAL_UART_STATE_READY;
+
+    memcpy(line[0], "tick 12345 ok\n", 15);
+    memset(line[1], '=', BENCH_LONG_WIDTH);
+    line[1][BENCH_LONG_WIDTH] = '\n';
+    line[1][BENCH_LONG_WIDTH + 1] = '\0';
+
+    for (k = 0; k < 2; k++)
+    {
+        for (m = 0; m < 2; m++)
+        {
+            _tx_drain(output, sizeof(output));
+            t0 = sim_time();
+            for (i = 0; i < lines[k]; i++)
+            {
+                if (m == 0)
+                    rt_hw_console_output(line[k]);
+                else
+                    _legacy_output(&huart, line[k]);
+            }
+            caller[k][m] = sim_time() - t0;
+            while (!sim_uart_tx_idle(USART1))
+                sim_advance(SIM_US(10));
+            wire[k][m] = sim_time() - t0;
+
+            bytes[k] = sim_uart_take(USART1, output, sizeof(output) - 1);
+            TEST_EQ(bytes[k], (size_t)lines[k] * (strlen(line[k]) + 1));
+            TEST_ASSERT(output[bytes[k] - 2] == '\r' && output[bytes[k] - 1] == '\n');
+
+            printf("   %-20s %2d x %3u bytes: caller %8.1f us (%6.1f us/line, %9.0f B/s), "
+                   "wire %8.1f us (%5.0f B/s)\n", path[m], lines[k], (unsigned)strlen(line[k]),
+                   caller[k][m] / 1e3, caller[k][m] / 1e3 / lines[k],
+                   bytes[k] / (caller[k][m] * 1e-9), wire[k][m] / 1e3, bytes[k] / (wire[k][m] * 1e-9));
+        }
+
+        /* 调用方只付拷贝的时间；线上吞吐不低于逐字节发送 */
+        TEST_ASSERT(caller[k][0] * 20 < caller[k][1]);
+        TEST_ASSERT(wire[k][0] <= wire[k][1]);
+    }
+}
+
+static void test_main(void)
+{
+    sim_uart_echo(USART1, 0);
+    TEST_CASE(test_output);
+    TEST_CASE(test_input);
+    TEST_CASE(test_reinit);
+    TEST_CASE(test_rx_burst);
+    TEST_CASE(test_rx_dropped);
+    TEST_CASE(test_producers);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
@@ -0,0 +1,189 @@
+/**
+  ******************************************************************************
+  * @file			test_crc_engine.c
+  * @brief			crc_engine: known vectors and agreement between backends
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rtthread.h>
+#include <crc_engine.h>
+#include "test.h"
+
+/* Private define ------------------------------------------------------------*/
+#define BENCH_LEN       4096
+#define BENCH_ROUNDS    2000
+
+/* Private typedef -----------------------------------------------------------*/
+struct crc_vector
+{
+    const char     *name;
+    rt_size_t       len;
+    rt_uint32_t     crc;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static const crc_engine_t engines[] =
+{
+    CRC_ENGINE_HW, CRC_ENGINE_HW_DMA, CRC_ENGINE_SW_SLICE4, CRC_ENGINE_SW_SLICE8, CRC_ENGINE_SW,
+};
+
+static const char *const engine_names[] =
+{
+    "HW", "DMA", "SLICE4", "SLICE8", "SW",
+};
+
+/* 数据为 i & 0xFF；"123456789" 单独检查。结果由逐位计算的参考实现给出 */
+static const struct crc_vector vectors[] =
+{
+    {"empty",       0,      0xFFFFFFFFUL},
+    {"1027 bytes",  1027,   0x98DB6D82UL},
+    {"1024 bytes",  1024,   0x8ADA4578UL},
+};
+
+static rt_uint8_t data[4096 + 8] __attribute__((aligned(4)));
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           逐位参考实现：小端字高位在前，剩余字节高位在前
+ *============================================================================*/
+static rt_uint32_t _crc_ref(rt_uint32_t crc, const rt_uint8_t *p, rt_size_t len)
+{
+    rt_uint32_t v;
+    rt_size_t i;
+    int bit, bits;
+
+    for (i = 0; i < len; i += bits / 8)
+    {
+        if (len - i >= 4)
+        {
+            memcpy(&v, p + i, 4);
+            bits = 32;
+        }
+        else
+        {
+            v = p[i];
+            bits = 8;
+        }
+        for (bit = bits - 1; bit >= 0; bit--)
+            crc = (crc << 1) ^ ((((crc >> 31) ^ (v >> bit)) & 1) ? CRC_ENGINE_POLY : 0);
+    }
+    return crc;
+}
+
+static void test_vectors(void)
+{
+    static const rt_uint32_t word = 0x12345678UL;
+    rt_size_t e, v;
+
+    for (v = 0; v < sizeof(data); v++)
+        data[v] = (rt_uint8_t)v;
+
+    for (e = 0; e < sizeof(engines) / sizeof(engines[0]); e++)
+    {
+        /* RM0008 中的例子 */
+        TEST_EQ(crc_engine_calculate(engines[e], &word, 4), 0xDF8A8A2BUL);
+        TEST_EQ(crc_engine_calculate(engines[e], "123456789", 9), 0xBF99399CUL);
+        for (v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++)
+        {
+            if (crc_engine_calculate(engines[e], data, vectors[v].len) != vectors[v].crc)
+            {
+                printf("   engine %d, %s\n", (int)engines[e], vectors[v].name);
+                TEST_ASSERT(!"vector mismatch");
+            }
+        }
+    }
+}
+
+/**=============================================================================
+ * @brief           随机长度、随机对齐、分段累加，各后端与参考实现一致
+ *============================================================================*/
+static void test_random(void)
+{
+    rt_uint32_t ref, crc;
+    rt_size_t round, e, off, len, split;
+
+    srand(5);
+    for (round = 0; round < 300; round++)
+    {
+        for (off = 0; off < sizeof(data); off++)
+            data[off] = (rt_uint8_t)rand();
+        off   = rand() % 8;
+        len   = rand() % 4096;
+        split = len ? RT_ALIGN_DOWN(rand() % len, 4) : 0;
+        ref   = _crc_ref(CRC_ENGINE_INIT_VALUE, data + off, len);
+
+        for (e = 0; e < sizeof(engines) / sizeof(engines[0]); e++)
+        {
+            TEST_EQ(crc_engine_calculate(engines[e], data + off, len), ref);
+
+            /* 前一段必须是整字，剩余字节的处理才与一次算完相同 */
+            crc = crc_engine_calculate(engines[e], data + off, split);
+            crc = crc_engine_accumulate(engines[e], crc, data + off + split, len - split);
+            TEST_EQ(crc, ref);
+        }
+        if (sim_host_exit_code() != 0)
+            return;
+    }
+}
+
+/**=============================================================================
+ * @brief           各后端 MB/s
+ *
+ * @note            模拟器只对寄存器访问计时，软件查表在模拟时间里不花时间。
+ *                  软件后端打印主机时钟下的速度，只作参考不做断言；硬件后端用模拟时间换算成
+ *                  目标板上的 MB/s，两组数字不能直接对比
+ *============================================================================*/
+static void test_bench(void)
+{
+    double host[sizeof(engines) / sizeof(engines[0])];
+    struct timespec t0, t1;
+    rt_uint32_t sum = 0;
+    rt_uint64_t ns;
+    rt_size_t e, i;
+    double dt;
+
+    for (i = 0; i < BENCH_LEN; i++)
+        data[i] = (rt_uint8_t)rand();
+
+    for (e = 0; e < sizeof(engines) / sizeof(engines[0]); e++)
+    {
+        ns = sim_time();
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < BENCH_ROUNDS; i++)
+            sum += crc_engine_calculate(engines[e], data, BENCH_LEN);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        ns = sim_time() - ns;
+        dt = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) * 1e-9;
+        host[e] = (double)BENCH_LEN * BENCH_ROUNDS / dt / 1e6;
+
+        if (engines[e] == CRC_ENGINE_HW || engines[e] == CRC_ENGINE_HW_DMA)
+            printf("   %-6s %8.1f MB/s (sim)\n", engine_names[e],
+                   (double)BENCH_LEN * BENCH_ROUNDS / ns * 1e3);
+        else
+            printf("   %-6s %8.1f MB/s (host)\n", engine_names[e], host[e]);
+    }
+    TEST_ASSERT(sum != 0);
+}
+
+static void test_main(void)
+{
+    crc_engine_init();
+    TEST_CASE(test_vectors);
+    TEST_CASE(test_random);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
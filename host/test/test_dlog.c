@@ -0,0 +1,271 @@
+/**
+  ******************************************************************************
+  * @file			test_dlog.c
+  * @brief			dlog: deferred formatting, multi-producer ordering with an
+  *                 interrupt producer, overflow accounting, caller-side latency
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <dlog.h>
+#include <prof.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define PRODUCERS           3                   /*!< 两个线程和一个中断 */
+#define PRODUCER_MSGS       300
+#define ISR_MSGS            100
+#define BENCH_CALLS         200
+#define PROBE_DLOG          (PROF_ID_USER + 0)
+#define PROBE_KPRINTF       (PROF_ID_USER + 1)
+
+/* Private variables ---------------------------------------------------------*/
+static struct rt_thread     producer_thread[2];
+static rt_uint8_t           producer_stack[2][1024];
+static struct rt_semaphore  producer_done;
+static volatile rt_uint32_t isr_sent;
+static volatile int         isr_on;
+static char                 output[64 * 1024];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           等后台线程和 USART1 都空闲，取出发送的数据
+ *============================================================================*/
+static size_t _drain(char *buf, size_t max)
+{
+    size_t n = 0;
+    int idle = 0;
+
+    /* 连续几个节拍没有新数据才算输出完 */
+    while (idle < 20 && n < max - 1)
+    {
+        rt_thread_delay(1);
+        if (sim_uart_tx_idle(USART1))
+        {
+            size_t got = sim_uart_take(USART1, buf + n, max - 1 - n);
+
+            idle = got ? 0 : idle + 1;
+            n += got;
+        }
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+static void _producer_entry(void *parameter)
+{
+    rt_uint32_t id = (rt_uint32_t)(rt_ubase_t)parameter, i;
+
+    for (i = 0; i < PRODUCER_MSGS; i++)
+    {
+        dlog("P%u %u\n", id, i);
+        if (rand() % 16 == 0)
+            rt_thread_delay(1);
+    }
+    rt_sem_release(&producer_done);
+}
+
+/* 随机时刻进入的中断也写日志 */
+void EXTI0_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    if (isr_on && isr_sent < ISR_MSGS)
+    {
+        dlog("P%u %u\n", 2, isr_sent);
+        isr_sent++;
+    }
+    rt_interrupt_leave();
+}
+
+/**=============================================================================
+ * @brief           延后格式化的结果与 rt_snprintf 相同，包括 %%、* 宽度和 %s
+ *============================================================================*/
+static void test_format(void)
+{
+    static const char *const str = "const";
+    char expect[256];
+    rt_size_t n;
+
+    _drain(output, sizeof(output));
+    dlog("int %d hex %08x %%\n", -3, 0xBEEFu);
+    dlog("str %s width [%*d]\n", str, 6, 42);
+    dlog("four %c%c %u %x\n", 'o', 'k', 0xFFFFFFFFu, 0);
+    _drain(output, sizeof(output));
+
+    n  = rt_snprintf(expect, sizeof(expect), "int %d hex %08x %%\r\n", -3, 0xBEEFu);
+    n += rt_snprintf(expect + n, sizeof(expect) - n, "str %s width [%*d]\r\n", str, 6, 42);
+    rt_snprintf(expect + n, sizeof(expect) - n, "four %c%c %u %x\r\n", 'o', 'k', 0xFFFFFFFFu, 0);
+    if (strcmp(output, expect) != 0)
+        printf("   got:\n%s   expected:\n%s", output, expect);
+    TEST_ASSERT(strcmp(output, expect) == 0);
+}
+
+/**=============================================================================
+ * @brief           两个线程和一个中断同时写：每个生产者的消息按顺序输出，
+ *                  不重复，输出数加丢弃数等于写入数
+ *============================================================================*/
+static void test_producers(void)
+{
+    rt_uint32_t next[PRODUCERS] = {0}, count = 0, dropped, id, seq, i;
+    char *line, *save;
+    time_t t0;
+
+    _drain(output, sizeof(output));
+    dropped = dlog_get_dropped();
+    rt_sem_init(&producer_done, "done", 0, RT_IPC_FLAG_FIFO);
+    srand(15);
+    isr_sent = 0;
+    isr_on = 1;
+    HAL_NVIC_SetPriority(EXTI0_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+    sim_preempt_random(5, EXTI0_IRQn);
+    for (i = 0; i < 2; i++)
+    {
+        rt_thread_init(&producer_thread[i], "prod", _producer_entry, (void *)(rt_ubase_t)i,
+                       producer_stack[i], sizeof(producer_stack[i]), 4, 2);
+        rt_thread_startup(&producer_thread[i]);
+    }
+    for (i = 0; i < 2; i++)
+        rt_sem_take(&producer_done, RT_WAITING_FOREVER);
+
+    /* 随机中断只打断固件代码，主线程在固件里空转等它写完或超时 */
+    t0 = time(NULL);
+    while (isr_sent < ISR_MSGS && time(NULL) - t0 < 5)
+        dlog_get_dropped();
+    isr_on = 0;
+    sim_preempt_random(0, EXTI0_IRQn);
+    HAL_NVIC_DisableIRQ(EXTI0_IRQn);
+    _drain(output, sizeof(output));
+    dropped = dlog_get_dropped() - dropped;
+
+    for (line = strtok_r(output, "\r\n", &save); line; line = strtok_r(RT_NULL, "\r\n", &save))
+    {
+        if (sscanf(line, "P%u %u", &id, &seq) != 2 || id >= PRODUCERS)
+        {
+            printf("   unexpected line \"%s\"\n", line);
+            TEST_ASSERT(!"garbled line");
+            break;
+        }
+        if (seq < next[id])
+        {
+            printf("   P%u %u after %u\n", id, seq, next[id] - 1);
+            TEST_ASSERT(!"producer order broken");
+            break;
+        }
+        next[id] = seq + 1;
+        count++;
+    }
+    printf("   %u thread + %u interrupt messages, %u printed, %u dropped\n",
+           2 * PRODUCER_MSGS, (unsigned)isr_sent, (unsigned)count, (unsigned)dropped);
+    TEST_ASSERT(isr_sent > 0);
+    TEST_EQ(count + dropped, 2 * PRODUCER_MSGS + isr_sent);
+}
+
+/**=============================================================================
+ * @brief           后台线程来不及输出时按配置的策略处理并计数
+ *============================================================================*/
+static void test_overflow(void)
+{
+    rt_uint32_t dropped, first, last, seq, count = 0, i;
+    char *line, *save;
+
+    _drain(output, sizeof(output));
+    dropped = dlog_get_dropped();
+
+    /* 主线程优先级高于后台线程，不让出 CPU 时环形缓冲只进不出 */
+    for (i = 0; i < RT_DLOG_RING_SIZE + 10; i++)
+        dlog("O %u\n", i);
+    TEST_EQ(dlog_get_dropped() - dropped, 10);
+    _drain(output, sizeof(output));
+
+    first = last = ~0u;
+    for (line = strtok_r(output, "\r\n", &save); line; line = strtok_r(RT_NULL, "\r\n", &save))
+    {
+        TEST_EQ(sscanf(line, "O %u", &seq), 1);
+        if (first == ~0u)
+            first = seq;
+        last = seq;
+        count++;
+    }
+    TEST_EQ(count, RT_DLOG_RING_SIZE);
+#if RT_DLOG_OVERFLOW_POLICY == DLOG_OVERFLOW_DROP_OLDEST
+    TEST_EQ(first, 10);
+    TEST_EQ(last, RT_DLOG_RING_SIZE + 9);
+#else
+    TEST_EQ(first, 0);
+    TEST_EQ(last, RT_DLOG_RING_SIZE - 1);
+#endif
+}
+
+/**=============================================================================
+ * @brief           调用者一侧的开销：dlog 与同步的 rt_kprintf，主机时钟和
+ *                  模拟时间两个角度
+ *============================================================================*/
+static void test_bench(void)
+{
+    struct prof_stats st_dlog, st_kprintf;
+    rt_uint64_t ns[2], t0;
+    int i;
+
+    _drain(output, sizeof(output));
+    prof_reset();
+
+    t0 = sim_time();
+    for (i = 0; i < BENCH_CALLS; i++)
+    {
+        PROF_BEGIN(PROBE_KPRINTF);
+        rt_kprintf("bench %d %s %08x\n", i, "kprintf", 0x1234u);
+        PROF_END(PROBE_KPRINTF);
+    }
+    ns[0] = sim_time() - t0;
+    _drain(output, sizeof(output));
+
+    /* 每批不超过环形缓冲的容量，批间让后台线程输出 */
+    ns[1] = 0;
+    for (i = 0; i < BENCH_CALLS; i++)
+    {
+        t0 = sim_time();
+        PROF_BEGIN(PROBE_DLOG);
+        dlog("bench %d %s %08x\n", i, "dlog", 0x1234u);
+        PROF_END(PROBE_DLOG);
+        ns[1] += sim_time() - t0;
+        if (i % (RT_DLOG_RING_SIZE / 2) == RT_DLOG_RING_SIZE / 2 - 1)
+            _drain(output, sizeof(output));
+    }
+    _drain(output, sizeof(output));
+
+    TEST_EQ(prof_get_stats(PROBE_KPRINTF, &st_kprintf), RT_EOK);
+    TEST_EQ(prof_get_stats(PROBE_DLOG, &st_dlog), RT_EOK);
+    printf("   rt_kprintf: avg %u p99 %u max %u cycles, %.1f us simulated per call\n",
+           st_kprintf.avg, st_kprintf.p99, st_kprintf.max, ns[0] / 1e3 / BENCH_CALLS);
+    printf("   dlog:       avg %u p99 %u max %u cycles, %.1f us simulated per call\n",
+           st_dlog.avg, st_dlog.p99, st_dlog.max, ns[1] / 1e3 / BENCH_CALLS);
+    TEST_EQ(st_dlog.count, BENCH_CALLS);
+    TEST_ASSERT(st_dlog.avg < st_kprintf.avg);
+    TEST_ASSERT(ns[1] < ns[0]);
+}
+
+static void test_main(void)
+{
+    sim_uart_echo(USART1, 0);
+    TEST_CASE(test_format);
+    TEST_CASE(test_producers);
+    TEST_CASE(test_overflow);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_COMPONENTS);
+}
@@ -0,0 +1,257 @@
+/**
+  ******************************************************************************
+  * @file			test_dma_copy.c
+  * @brief			dma_copy: data against memcpy, completion order of mixed
+  *                 small and large requests, interrupt submitters, throughput
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <dma_copy.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define BUF_SIZE            (80 * 1024)         /*!< 字节传输超过 65535 项 */
+#define QUEUE_REQS          24
+#define ISR_REQS            64
+#define BENCH_SIZE          4096
+
+/* Private variables ---------------------------------------------------------*/
+static rt_uint8_t           src[BUF_SIZE + 4], dst[BUF_SIZE + 4], ref[BUF_SIZE + 4];
+static struct dma_copy_req  reqs[QUEUE_REQS];
+static rt_uint32_t          order[QUEUE_REQS];
+static volatile rt_uint32_t order_num;
+
+static struct dma_copy_req  isr_reqs[ISR_REQS];
+static rt_uint8_t           isr_src[ISR_REQS][16], isr_dst[ISR_REQS][16];
+static volatile rt_uint32_t isr_submitted;
+static volatile rt_uint32_t isr_done;
+
+/* Private function ----------------------------------------------------------*/
+
+static void _fill(rt_uint8_t *buf, rt_size_t len)
+{
+    rt_size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (rt_uint8_t)rand();
+}
+
+static void _record(struct dma_copy_req *req)
+{
+    order[order_num++] = (rt_uint32_t)(rt_ubase_t)req->user_data;
+}
+
+static void _isr_done(struct dma_copy_req *req)
+{
+    (void)req;
+    isr_done++;
+}
+
+/* 随机时刻的中断提交小块拷贝，与线程提交的大块排在同一队列 */
+void EXTI0_IRQHandler(void)
+{
+    struct dma_copy_req *req;
+    rt_uint32_t n = isr_submitted;
+
+    rt_interrupt_enter();
+    if (n < ISR_REQS)
+    {
+        req = &isr_reqs[n];
+        memset(req, 0, sizeof(*req));
+        req->dst  = isr_dst[n];
+        req->src  = isr_src[n];
+        req->len  = sizeof(isr_src[n]);
+        req->done = _isr_done;
+        dma_copy_submit(req);
+        isr_submitted = n + 1;
+    }
+    rt_interrupt_leave();
+}
+
+/**=============================================================================
+ * @brief           随机长度和对齐，结果与 memcpy 相同，目的缓冲之外不被改写
+ *============================================================================*/
+static void test_copy(void)
+{
+    static const rt_size_t sizes[] = {0, 1, 3, 127, 128, 129, 1000, 4096, 65535, 65536, BUF_SIZE};
+    rt_size_t len, so, doff;
+    int round;
+
+    srand(16);
+    for (round = 0; round < 60; round++)
+    {
+        len  = round < (int)(sizeof(sizes) / sizeof(sizes[0])) ? sizes[round] : (rt_size_t)(rand() % 3000);
+        so   = rand() % 4;
+        doff = rand() % 4;
+        if (len > BUF_SIZE - 4)
+            so = doff = 0;
+        _fill(src, sizeof(src));
+        _fill(dst, sizeof(dst));
+        memcpy(ref, dst, sizeof(ref));
+        memcpy(ref + doff, src + so, len);
+
+        TEST_EQ(dma_copy(dst + doff, src + so, len), RT_EOK);
+        if (memcmp(dst, ref, sizeof(dst)) != 0)
+        {
+            printf("   len %u src +%u dst +%u\n", (unsigned)len, (unsigned)so, (unsigned)doff);
+            TEST_ASSERT(!"copy differs from memcpy");
+            return;
+        }
+    }
+
+    /* 关中断时走 CPU 路径 */
+    __disable_irq();
+    TEST_EQ(dma_copy(dst, src, 300), RT_EOK);
+    __enable_irq();
+    TEST_MEM_EQ(dst, src, 300);
+}
+
+/**=============================================================================
+ * @brief           大块和小块交替提交到同一目的：完成回调按提交顺序，最后
+ *                  的内容是最后一次提交的数据
+ *============================================================================*/
+static void test_order(void)
+{
+    static rt_uint8_t srcs[QUEUE_REQS][512];
+    static rt_uint8_t target[512];
+    struct rt_semaphore sem;
+    rt_size_t len[QUEUE_REQS];
+    rt_uint32_t i;
+    int round;
+
+    rt_sem_init(&sem, "order", 0, RT_IPC_FLAG_FIFO);
+    srand(17);
+    for (round = 0; round < 20; round++)
+    {
+        memset(target, 0, sizeof(target));
+        memset(ref, 0, sizeof(target));
+        order_num = 0;
+        for (i = 0; i < QUEUE_REQS; i++)
+        {
+            /* 第一个总是大块，后面的小块一定落在排队路径上 */
+            len[i] = i == 0 || rand() % 2 ? 128 + rand() % 384 : 1 + rand() % 127;
+            _fill(srcs[i], len[i]);
+            memcpy(ref, srcs[i], len[i]);
+
+            memset(&reqs[i], 0, sizeof(reqs[i]));
+            reqs[i].dst       = target;
+            reqs[i].src       = srcs[i];
+            reqs[i].len       = len[i];
+            reqs[i].done      = _record;
+            reqs[i].user_data = (void *)(rt_ubase_t)i;
+            reqs[i].sem       = i == QUEUE_REQS - 1 ? &sem : RT_NULL;
+            TEST_EQ(dma_copy_submit(&reqs[i]), RT_EOK);
+        }
+        TEST_EQ(rt_sem_take(&sem, 1000), RT_EOK);
+
+        TEST_EQ(order_num, QUEUE_REQS);
+        for (i = 0; i < order_num; i++)
+            TEST_EQ(order[i], i);
+        for (i = 0; i < QUEUE_REQS; i++)
+            TEST_EQ(reqs[i].result, RT_EOK);
+        if (memcmp(target, ref, sizeof(target)) != 0)
+        {
+            printf("   round %d\n", round);
+            TEST_ASSERT(!"a later small copy was overwritten by an earlier request");
+            break;
+        }
+    }
+    rt_sem_detach(&sem);
+
+    /* 队列非空时同步的小块拷贝也要等前面的请求 */
+    _fill(src, 1024);
+    memset(&reqs[0], 0, sizeof(reqs[0]));
+    reqs[0].dst = dst;
+    reqs[0].src = src;
+    reqs[0].len = 1024;
+    TEST_EQ(dma_copy_submit(&reqs[0]), RT_EOK);
+    TEST_EQ(dma_copy(dst, src + 1024, 64), RT_EOK);
+    TEST_EQ(reqs[0].result, RT_EOK);
+    TEST_MEM_EQ(dst, src + 1024, 64);
+    TEST_MEM_EQ(dst + 64, src + 64, 1024 - 64);
+}
+
+/**=============================================================================
+ * @brief           中断在线程提交大块的同时提交小块，全部完成且数据正确
+ *============================================================================*/
+static void test_isr(void)
+{
+    rt_uint32_t i, rounds = 0;
+    time_t t0;
+
+    srand(18);
+    for (i = 0; i < ISR_REQS; i++)
+        _fill(isr_src[i], sizeof(isr_src[i]));
+    memset(isr_dst, 0, sizeof(isr_dst));
+    isr_submitted = isr_done = 0;
+
+    HAL_NVIC_SetPriority(EXTI0_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+    sim_preempt_random(5, EXTI0_IRQn);
+    t0 = time(NULL);
+    while (isr_submitted < ISR_REQS && time(NULL) - t0 < 10)
+    {
+        _fill(src, 2048);
+        TEST_EQ(dma_copy(dst, src, 2048), RT_EOK);
+        if (memcmp(dst, src, 2048) != 0)
+        {
+            TEST_ASSERT(!"thread copy corrupted");
+            break;
+        }
+        rounds++;
+    }
+    sim_preempt_random(0, EXTI0_IRQn);
+    HAL_NVIC_DisableIRQ(EXTI0_IRQn);
+
+    /* 最后一个中断请求可能排在队尾，再走一次队列等它完成 */
+    TEST_EQ(dma_copy(dst, src, 2048), RT_EOK);
+    printf("   %u thread copies, %u interrupt copies submitted, %u completed\n",
+           (unsigned)rounds, (unsigned)isr_submitted, (unsigned)isr_done);
+    TEST_ASSERT(isr_submitted > 0);
+    TEST_EQ(isr_done, isr_submitted);
+    for (i = 0; i < isr_submitted; i++)
+        TEST_MEM_EQ(isr_dst[i], isr_src[i], sizeof(isr_src[i]));
+}
+
+/**=============================================================================
+ * @brief           模拟时间中 4KB 字对齐拷贝的耗时，线程在等待期间让出 CPU
+ *============================================================================*/
+static void test_bench(void)
+{
+    rt_uint64_t t0, ns;
+    int i;
+
+    _fill(src, BENCH_SIZE);
+    t0 = sim_time();
+    for (i = 0; i < 10; i++)
+        TEST_EQ(dma_copy(dst, src, BENCH_SIZE), RT_EOK);
+    ns = (sim_time() - t0) / 10;
+    printf("   %u bytes: %.1f us simulated, %.1f MB/s at %u Hz\n", BENCH_SIZE, ns / 1e3,
+           BENCH_SIZE * 1e3 / ns, (unsigned)SystemCoreClock);
+    TEST_MEM_EQ(dst, src, BENCH_SIZE);
+    TEST_ASSERT(ns > 0);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_copy);
+    TEST_CASE(test_order);
+    TEST_CASE(test_isr);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_COMPONENTS);
+}
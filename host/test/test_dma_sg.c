@@ -0,0 +1,369 @@
+/**
+  ******************************************************************************
+  * @file			test_dma_sg.c
+  * @brief			dma_sg: header + payload + crc on USART2 without copying,
+  *                 empty and oversized fragments, busy rejection, segment gap,
+  *                 SPI1 at 36 MHz / 256 with BSY clear at completion
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <dma_sg.h>
+#include <dma_alloc.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define BAUD                2000000u
+#define BIG_SIZE            (70 * 1024)         /*!< 一个片段超过 65535 项 */
+#define BENCH_FRAGS         32
+#define SPI_FRAGS           8
+
+/* Private variables ---------------------------------------------------------*/
+static UART_HandleTypeDef   huart2;
+static DMA_HandleTypeDef    hdma_tx;
+static struct dma_sg        sg;
+static struct rt_semaphore  done_sem;
+static volatile rt_err_t    done_result;
+static volatile rt_uint64_t done_time;
+
+static SPI_HandleTypeDef    hspi1;
+static DMA_HandleTypeDef    hdma_spi;
+static struct dma_sg        sg_spi;
+static volatile rt_uint32_t done_bsy;
+
+static rt_uint8_t           big[BIG_SIZE];
+static rt_uint8_t           rx[BIG_SIZE + 64];
+
+/* Private function ----------------------------------------------------------*/
+
+static void _fill(rt_uint8_t *buf, rt_size_t len)
+{
+    rt_size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (rt_uint8_t)rand();
+}
+
+static void _done(struct dma_sg *s, rt_err_t result)
+{
+    (void)s;
+    done_result = result;
+    done_time   = sim_time();
+    rt_sem_release(&done_sem);
+}
+
+/**=============================================================================
+ * @brief           SPI 完成回调里记下 BSY，调用者在这里拉高片选
+ *============================================================================*/
+static void _spi_done(struct dma_sg *s, rt_err_t result)
+{
+    done_bsy = SPI1->SR & SPI_SR_BSY;
+    _done(s, result);
+}
+
+/**=============================================================================
+ * @brief           USART2 发送接 DMA1 通道 7，由 dma_alloc 分配
+ *============================================================================*/
+static void _setup(void)
+{
+    __HAL_RCC_USART2_CLK_ENABLE();
+    huart2.Instance          = USART2;
+    huart2.Init.BaudRate     = BAUD;
+    huart2.Init.WordLength   = UART_WORDLENGTH_8B;
+    huart2.Init.StopBits     = UART_STOPBITS_1;
+    huart2.Init.Parity       = UART_PARITY_NONE;
+    huart2.Init.Mode         = UART_MODE_TX;
+    huart2.Init.HwFlowCtl    = UART_HWCONTROL_NONE;
+    huart2.Init.OverSampling = UART_OVERSAMPLING_16;
+    TEST_EQ(HAL_UART_Init(&huart2), HAL_OK);
+
+    TEST_EQ(dma_alloc(&hdma_tx, DMA_REQ_USART2_TX, DMA_CLASS_STREAM), RT_EOK);
+    TEST_ASSERT(hdma_tx.Instance == DMA1_Channel7);
+    hdma_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    hdma_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma_tx.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma_tx.Init.Mode                = DMA_NORMAL;
+    TEST_EQ(HAL_DMA_Init(&hdma_tx), HAL_OK);
+    __HAL_LINKDMA(&huart2, hdmatx, hdma_tx);
+
+    memset(&sg, 0, sizeof(sg));
+    sg.done = _done;
+    rt_sem_init(&done_sem, "sg", 0, RT_IPC_FLAG_FIFO);
+}
+
+/**=============================================================================
+ * @brief           SPI1 主机只发，发送接 DMA1 通道 3；PCLK2 降到 36 MHz，
+ *                  PCLK2/256 约 140 kHz，两帧超过 100 us
+ *============================================================================*/
+static void _spi_setup(void)
+{
+    MODIFY_REG(RCC->CFGR, RCC_CFGR_PPRE2, RCC_CFGR_PPRE2_DIV2);
+    __HAL_RCC_SPI1_CLK_ENABLE();
+    hspi1.Instance               = SPI1;
+    hspi1.Init.Mode              = SPI_MODE_MASTER;
+    hspi1.Init.Direction         = SPI_DIRECTION_2LINES;
+    hspi1.Init.DataSize          = SPI_DATASIZE_8BIT;
+    hspi1.Init.CLKPolarity       = SPI_POLARITY_LOW;
+    hspi1.Init.CLKPhase          = SPI_PHASE_1EDGE;
+    hspi1.Init.NSS               = SPI_NSS_SOFT;
+    hspi1.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_256;
+    hspi1.Init.FirstBit          = SPI_FIRSTBIT_MSB;
+    TEST_EQ(HAL_SPI_Init(&hspi1), HAL_OK);
+
+    TEST_EQ(dma_alloc(&hdma_spi, DMA_REQ_SPI1_TX, DMA_CLASS_STREAM), RT_EOK);
+    TEST_ASSERT(hdma_spi.Instance == DMA1_Channel3);
+    hdma_spi.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+    hdma_spi.Init.PeriphInc           = DMA_PINC_DISABLE;
+    hdma_spi.Init.MemInc              = DMA_MINC_ENABLE;
+    hdma_spi.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_spi.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+    hdma_spi.Init.Mode                = DMA_NORMAL;
+    TEST_EQ(HAL_DMA_Init(&hdma_spi), HAL_OK);
+    __HAL_LINKDMA(&hspi1, hdmatx, hdma_spi);
+
+    memset(&sg_spi, 0, sizeof(sg_spi));
+    sg_spi.done = _spi_done;
+}
+
+/**=============================================================================
+ * @brief           等完成回调和移位寄存器都结束，取出线上的全部字节
+ *============================================================================*/
+static size_t _wait(rt_uint8_t *buf, size_t max)
+{
+    size_t n = 0;
+
+    /* 捕获缓冲有限，大块传输要边等边取 */
+    while (rt_sem_take(&done_sem, 1) != RT_EOK && !sim_host_exit_code())
+        n += sim_uart_take(USART2, buf + n, max - n);
+    while (!sim_uart_tx_idle(USART2))
+        rt_thread_delay(1);
+    n += sim_uart_take(USART2, buf + n, max - n);
+
+    return n;
+}
+
+static rt_uint64_t _frame_ns(void)
+{
+    return sim_cycles_to_ns((rt_uint64_t)USART2->BRR * 10u, sim_clock_pclk1());
+}
+
+static rt_uint64_t _spi_frame_ns(void)
+{
+    rt_uint32_t br = (SPI1->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos;
+
+    return sim_cycles_to_ns(8ull << (br + 1u), sim_clock_pclk2());
+}
+
+/**=============================================================================
+ * @brief           帧头、负载、空片段、CRC 拼接后线上的字节与拼接结果相同，
+ *                  串口和通道状态恢复，可以再次发送
+ *============================================================================*/
+static void test_frame(void)
+{
+    static rt_uint8_t head[4] = {0xA5, 0x5A, 0x00, 0x20};
+    static rt_uint8_t payload[32], crc[2];
+    static rt_uint8_t expect[sizeof(head) + sizeof(payload) + sizeof(crc)];
+    struct dma_sg_iov iov[4];
+    int round;
+
+    srand(17);
+    for (round = 0; round < 3; round++)
+    {
+        _fill(payload, sizeof(payload));
+        _fill(crc, sizeof(crc));
+        memcpy(expect, head, sizeof(head));
+        memcpy(expect + sizeof(head), payload, sizeof(payload));
+        memcpy(expect + sizeof(head) + sizeof(payload), crc, sizeof(crc));
+
+        iov[0].base = head;    iov[0].len = sizeof(head);
+        iov[1].base = payload; iov[1].len = sizeof(payload);
+        iov[2].base = crc;     iov[2].len = 0;
+        iov[3].base = crc;     iov[3].len = sizeof(crc);
+        sg.segments = 0;
+        TEST_EQ(dma_sg_uart_transmit(&sg, &huart2, iov, 4), RT_EOK);
+
+        TEST_EQ(_wait(rx, sizeof(rx)), sizeof(expect));
+        TEST_MEM_EQ(rx, expect, sizeof(expect));
+        TEST_EQ(done_result, RT_EOK);
+        TEST_EQ(sg.segments, 3);
+        TEST_EQ(huart2.gState, HAL_UART_STATE_READY);
+        TEST_EQ(hdma_tx.State, HAL_DMA_STATE_READY);
+        TEST_EQ(USART2->CR3 & USART_CR3_DMAT, 0);
+    }
+}
+
+/**=============================================================================
+ * @brief           发送中再次提交返回忙，全空的片段数组返回没有数据且不占用
+ *                  串口
+ *============================================================================*/
+static void test_reject(void)
+{
+    static rt_uint8_t data[64];
+    struct dma_sg_iov iov[2] = {{data, sizeof(data)}, {data, 0}};
+
+    TEST_EQ(dma_sg_uart_transmit(&sg, &huart2, iov, 1), RT_EOK);
+    TEST_EQ(dma_sg_uart_transmit(&sg, &huart2, iov, 1), -RT_EBUSY);
+    TEST_EQ(_wait(rx, sizeof(rx)), sizeof(data));
+
+    TEST_EQ(dma_sg_uart_transmit(&sg, &huart2, &iov[1], 1), -RT_EEMPTY);
+    TEST_EQ(dma_sg_uart_transmit(&sg, &huart2, iov, 0), -RT_EEMPTY);
+    TEST_EQ(huart2.gState, HAL_UART_STATE_READY);
+    TEST_EQ(rt_sem_take(&done_sem, 0), -RT_ETIMEOUT);
+}
+
+/**=============================================================================
+ * @brief           超过 CNDTR 上限的片段分两段装载，线上连续
+ *============================================================================*/
+static void test_split(void)
+{
+    static rt_uint8_t tail[3] = {1, 2, 3};
+    struct dma_sg_iov iov[2] = {{big, BIG_SIZE}, {tail, sizeof(tail)}};
+    size_t n;
+
+    srand(18);
+    _fill(big, sizeof(big));
+    sg.segments = 0;
+    TEST_EQ(dma_sg_uart_transmit(&sg, &huart2, iov, 2), RT_EOK);
+    n = _wait(rx, sizeof(rx));
+
+    TEST_EQ(n, BIG_SIZE + sizeof(tail));
+    TEST_MEM_EQ(rx, big, BIG_SIZE);
+    TEST_MEM_EQ(rx + BIG_SIZE, tail, sizeof(tail));
+    TEST_EQ(sg.segments, 3);
+}
+
+/**=============================================================================
+ * @brief           片段衔接：线上总时间与逐字节连续发送相同，每次衔接写几个
+ *                  通道寄存器
+ *============================================================================*/
+static void test_bench(void)
+{
+    static struct dma_sg_iov iov[BENCH_FRAGS];
+    rt_uint64_t t0, elapsed, wire;
+    size_t i, bytes = 0, writes;
+
+    for (i = 0; i < BENCH_FRAGS; i++)
+    {
+        iov[i].base = big + bytes;
+        iov[i].len  = 1 + i % 7;
+        bytes += iov[i].len;
+    }
+
+    sg.segments = 0;
+    sim_log_start((uint32_t)(uintptr_t)DMA1_Channel7, sizeof(DMA_Channel_TypeDef));
+    t0 = sim_time();
+    TEST_EQ(dma_sg_uart_transmit(&sg, &huart2, iov, BENCH_FRAGS), RT_EOK);
+    TEST_EQ(_wait(rx, sizeof(rx)), bytes);
+    writes = sim_log_count();
+    sim_log_stop();
+    elapsed = done_time - t0;
+    TEST_MEM_EQ(rx, big, bytes);
+
+    /* 完成回调在最后一个字节进入 DR 时，此后还有两帧在 DR 和移位寄存器中 */
+    wire = (bytes - 2) * _frame_ns();
+    printf("   %u fragments, %u bytes: %.2f us to last DR write, %.2f us back-to-back, "
+           "%.1f channel writes per segment\n", BENCH_FRAGS, (unsigned)bytes,
+           elapsed / 1e3, wire / 1e3, (double)writes / sg.segments);
+    TEST_EQ(sg.segments, BENCH_FRAGS);
+    TEST_ASSERT(elapsed <= wire + _frame_ns());
+    TEST_ASSERT(writes <= 4 * sg.segments + 4);
+}
+
+/**=============================================================================
+ * @brief           SPI1 慢时钟下发送一组片段：线上字节正确，完成回调时最后
+ *                  一帧已经移出、BSY 已清，总时间等于逐帧连续发送，衔接空档
+ *                  不超过一帧
+ *============================================================================*/
+static void test_spi(void)
+{
+    static struct dma_sg_iov iov[SPI_FRAGS];
+    rt_uint64_t t0, elapsed, wire;
+    size_t i, bytes = 0;
+
+    srand(19);
+    _fill(big, 64);
+    for (i = 0; i < SPI_FRAGS; i++)
+    {
+        iov[i].base = big + bytes;
+        iov[i].len  = 1 + i % 3;
+        bytes += iov[i].len;
+    }
+
+    sim_spi_take(SPI1, rx, sizeof(rx));
+    sg_spi.segments = 0;
+    done_bsy = SPI_SR_BSY;
+    t0 = sim_time();
+    TEST_EQ(dma_sg_spi_transmit(&sg_spi, &hspi1, iov, SPI_FRAGS), RT_EOK);
+    TEST_EQ(dma_sg_spi_transmit(&sg_spi, &hspi1, iov, SPI_FRAGS), -RT_EBUSY);
+    TEST_EQ(rt_sem_take(&done_sem, RT_WAITING_FOREVER), RT_EOK);
+    elapsed = done_time - t0;
+
+    TEST_EQ(done_result, RT_EOK);
+    TEST_EQ(done_bsy, 0);
+    TEST_ASSERT(sim_spi_idle(SPI1));
+    TEST_EQ(sim_spi_take(SPI1, rx, sizeof(rx)), bytes);
+    TEST_MEM_EQ(rx, big, bytes);
+    TEST_EQ(sg_spi.segments, SPI_FRAGS);
+    TEST_EQ(hspi1.State, HAL_SPI_STATE_READY);
+    TEST_EQ(SPI1->CR2 & SPI_CR2_TXDMAEN, 0);
+    TEST_EQ(SPI1->SR & SPI_SR_OVR, 0);
+
+    wire = bytes * _spi_frame_ns();
+    printf("   SPI1 %.0f kHz, %u fragments, %u bytes: %.2f us to BSY clear, %.2f us back-to-back, "
+           "%.2f us gap per segment\n", 1e6 / (_spi_frame_ns() / 8.0), SPI_FRAGS, (unsigned)bytes,
+           elapsed / 1e3, wire / 1e3, (elapsed > wire ? elapsed - wire : 0) / 1e3 / SPI_FRAGS);
+    TEST_ASSERT(elapsed >= wire);
+    TEST_ASSERT(elapsed <= wire + _spi_frame_ns());
+}
+
+/**=============================================================================
+ * @brief           SCK 停住时等 BSY 超时，完成回调收到 -RT_ETIMEOUT，SPI 和
+ *                  通道仍然释放
+ *============================================================================*/
+static void test_spi_timeout(void)
+{
+    static rt_uint8_t data[1] = {0x3C};
+    struct dma_sg_iov iov = {data, sizeof(data)};
+
+    sim_spi_halt(SPI1, 1);
+    TEST_EQ(dma_sg_spi_transmit(&sg_spi, &hspi1, &iov, 1), RT_EOK);
+    TEST_EQ(rt_sem_take(&done_sem, RT_WAITING_FOREVER), RT_EOK);
+    TEST_EQ(done_result, -RT_ETIMEOUT);
+    TEST_ASSERT(done_bsy != 0);
+    TEST_EQ(hspi1.State, HAL_SPI_STATE_READY);
+    TEST_EQ(hdma_spi.State, HAL_DMA_STATE_READY);
+
+    sim_spi_halt(SPI1, 0);
+    while (!sim_spi_idle(SPI1))
+        rt_thread_delay(1);
+    TEST_EQ(sim_spi_take(SPI1, rx, sizeof(rx)), 1);
+    TEST_EQ(rx[0], 0x3C);
+}
+
+static void test_main(void)
+{
+    _setup();
+    _spi_setup();
+    TEST_CASE(test_frame);
+    TEST_CASE(test_reject);
+    TEST_CASE(test_split);
+    TEST_CASE(test_bench);
+    TEST_CASE(test_spi);
+    TEST_CASE(test_spi_timeout);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
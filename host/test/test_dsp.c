@@ -0,0 +1,635 @@
+/**
+  ******************************************************************************
+  * @file			test_dsp.c
+  * @brief			dsp: fixed-point filters against double-precision references
+  *                 on step, impulse and random input, decimation phase, state
+  *                 across blocks and per-sample cost of each kernel
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rtthread.h>
+#include <dsp.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define N                   512
+#define TAPS                31
+#define BENCH_N             4096
+#define BENCH_ROUNDS        200
+
+/* 输入信号 */
+enum
+{
+    SIG_STEP,
+    SIG_IMPULSE,
+    SIG_RANDOM,
+    SIG_NUM,
+};
+
+/* Private variables ---------------------------------------------------------*/
+static const char *const sig_names[SIG_NUM] = {"step", "impulse", "random"};
+
+static double               x[N], ref[N], tmp[N];
+static q15_t                in15[N], out15[N], blk15[N];
+static q31_t                in31[N], out31[N], blk31[N];
+static rt_uint16_t          adc[3 * N], outu[N], blku[N];
+static rt_int32_t           outi[N], blki[N];
+
+static q15_t                fir15_coeffs[TAPS], fir15_state[DSP_FIR_STATE_SIZE(TAPS)];
+static q31_t                fir31_coeffs[TAPS], fir31_state[DSP_FIR_STATE_SIZE(TAPS)];
+static double               fir15_ref[TAPS], fir31_ref[TAPS];
+static q15_t                biquad_coeffs[10], biquad_state[DSP_BIQUAD_STATE_SIZE(2)];
+static double               biquad_ref[10];
+static rt_uint16_t          mavg_hist[16];
+
+/* 分块处理时每块的长度，有 1 和奇数，轮流使用 */
+static const rt_size_t      chunks[] = {1, 7, 3, 64, 13, 2, 33, 5};
+
+static q15_t                bench15[BENCH_N];
+static q31_t                bench31[BENCH_N];
+static rt_uint16_t          bench_adc[BENCH_N], bench_u16[BENCH_N];
+static rt_int32_t           bench_i32[BENCH_N];
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           生成输入：阶跃从第 3 个样本开始，冲激在第 5 个样本，
+ *                  随机为 [-amp, amp] 均匀分布；结果取整，x 与定点输入一致
+ *============================================================================*/
+static void _signal(int kind, double amp, double offset)
+{
+    rt_size_t i;
+
+    for (i = 0; i < N; i++)
+    {
+        if (kind == SIG_STEP)
+            x[i] = i >= 3 ? amp : 0;
+        else if (kind == SIG_IMPULSE)
+            x[i] = i == 5 ? amp : 0;
+        else
+            x[i] = amp * (2.0 * rand() / RAND_MAX - 1.0);
+        x[i] = rint(x[i] + offset);
+    }
+}
+
+/**=============================================================================
+ * @brief           双精度抽取 FIR：第 j 个输出对应输入 (j + 1) * decim - 1
+ *
+ * @return          输出个数
+ *============================================================================*/
+static rt_size_t _ref_fir(const double *c, rt_size_t taps, const double *in, rt_size_t n,
+                          rt_size_t decim, double *out)
+{
+    rt_size_t i, k, m = 0;
+    double acc;
+
+    for (i = decim - 1; i < n; i += decim)
+    {
+        acc = 0;
+        for (k = 0; k < taps && k <= i; k++)
+            acc += c[k] * in[i - k];
+        out[m++] = acc;
+    }
+    return m;
+}
+
+/**=============================================================================
+ * @brief           双精度双二阶级联，c 为每级 {b0, b1, b2, a1, a2}
+ *============================================================================*/
+static void _ref_biquad(const double *c, rt_size_t stages, const double *in, rt_size_t n, double *out)
+{
+    double x1, x2, y1, y2, y;
+    rt_size_t s, i;
+
+    memmove(out, in, n * sizeof(double));
+    for (s = 0; s < stages; s++, c += 5)
+    {
+        x1 = x2 = y1 = y2 = 0;
+        for (i = 0; i < n; i++)
+        {
+            y  = c[0] * out[i] + c[1] * x1 + c[2] * x2 - c[3] * y1 - c[4] * y2;
+            x2 = x1;
+            x1 = out[i];
+            y2 = y1;
+            y1 = y;
+            out[i] = y;
+        }
+    }
+}
+
+/**=============================================================================
+ * @brief           冲激响应绝对值之和，即最坏情况下的增益
+ *
+ * @param[in]       c      每级系数，只用 a 时 b 取 {1, 0, 0}
+ * @param[in]       stages 级数
+ *============================================================================*/
+static double _l1(const double *c, rt_size_t stages)
+{
+    double sum = 0;
+    rt_size_t i;
+
+    for (i = 0; i < N; i++)
+        tmp[i] = i == 0;
+    _ref_biquad(c, stages, tmp, N, tmp);
+    for (i = 0; i < N; i++)
+        sum += fabs(tmp[i]);
+    return sum;
+}
+
+static double _max_err(const double *out, const double *r, rt_size_t n)
+{
+    double e, max = 0;
+    rt_size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        e = fabs(out[i] - r[i]);
+        if (e > max)
+            max = e;
+    }
+    return max;
+}
+
+/**=============================================================================
+ * @brief           Hamming 窗低通，直流增益为 gain
+ *============================================================================*/
+static void _lowpass(double *c, rt_size_t taps, double fc, double gain)
+{
+    double m = (taps - 1) / 2.0, sum = 0, t;
+    rt_size_t k;
+
+    for (k = 0; k < taps; k++)
+    {
+        t    = k - m;
+        c[k] = (t == 0 ? 2 * fc : sin(2 * M_PI * fc * t) / (M_PI * t)) *
+               (0.54 - 0.46 * cos(2 * M_PI * k / (taps - 1)));
+        sum += c[k];
+    }
+    for (k = 0; k < taps; k++)
+        c[k] *= gain / sum;
+}
+
+/**=============================================================================
+ * @brief           二阶巴特沃斯低通，量化为 Q14，d 为量化后的值
+ *============================================================================*/
+static void _butter(double fc, q15_t *q, double *d)
+{
+    double k = tan(M_PI * fc), norm = 1 / (1 + M_SQRT2 * k + k * k);
+    double c[5];
+    rt_size_t i;
+
+    c[0] = k * k * norm;
+    c[1] = 2 * c[0];
+    c[2] = c[0];
+    c[3] = 2 * (k * k - 1) * norm;
+    c[4] = (1 - M_SQRT2 * k + k * k) * norm;
+    for (i = 0; i < 5; i++)
+    {
+        q[i] = DSP_Q14(c[i]);
+        d[i] = q[i] / 16384.0;
+    }
+}
+
+static void _setup_coeffs(void)
+{
+    double c[TAPS], abs_sum = 0;
+    rt_size_t i;
+
+    /* Q31 要求系数绝对值之和小于 1，按绝对值之和 0.95 缩放 */
+    _lowpass(c, TAPS, 0.1, 1.0);
+    for (i = 0; i < TAPS; i++)
+        abs_sum += fabs(c[i]);
+    for (i = 0; i < TAPS; i++)
+    {
+        c[i] *= 0.95 / abs_sum;
+        fir15_coeffs[i] = DSP_Q15(c[i]);
+        fir31_coeffs[i] = DSP_Q31(c[i]);
+        fir15_ref[i]    = fir15_coeffs[i] / 32768.0;
+        fir31_ref[i]    = fir31_coeffs[i] / 2147483648.0;
+    }
+
+    _butter(0.1, &biquad_coeffs[0], &biquad_ref[0]);
+    _butter(0.2, &biquad_coeffs[5], &biquad_ref[5]);
+}
+
+/**=============================================================================
+ * @brief           Q15 FIR：误差只来自输出截断，小于 1 LSB；
+ *                  抽取时输出对齐到每 decim 个输入的最后一个
+ *============================================================================*/
+static void test_fir_q15(void)
+{
+    static const rt_uint16_t decims[] = {1, 3, 4};
+    struct dsp_fir_q15 fir;
+    double out[N], err;
+    rt_size_t d, s, i, n, m;
+
+    srand(24);
+    for (d = 0; d < sizeof(decims) / sizeof(decims[0]); d++)
+    {
+        for (s = 0; s < SIG_NUM; s++)
+        {
+            _signal((int)s, 16384, 0);
+            for (i = 0; i < N; i++)
+                in15[i] = (q15_t)x[i];
+
+            TEST_EQ(dsp_fir_q15_init(&fir, fir15_coeffs, fir15_state, TAPS, decims[d]), RT_EOK);
+            n = dsp_fir_q15_process(&fir, in15, out15, N);
+            m = _ref_fir(fir15_ref, TAPS, x, N, decims[d], ref);
+            TEST_EQ(n, m);
+            for (i = 0; i < n; i++)
+                out[i] = out15[i];
+            err = _max_err(out, ref, n);
+            printf("   /%u %-7s max error %.3f LSB\n", decims[d], sig_names[s], err);
+            TEST_ASSERT(err < 1.0);
+        }
+    }
+
+    /* 冲激在输入 5，抽取 4 时输出 j 对应输入 4j+3：输出 1、2 为第 2、6 个系数 */
+    _signal(SIG_IMPULSE, 32767, 0);
+    for (i = 0; i < N; i++)
+        in15[i] = (q15_t)x[i];
+    dsp_fir_q15_init(&fir, fir15_coeffs, fir15_state, TAPS, 4);
+    dsp_fir_q15_process(&fir, in15, out15, N);
+    TEST_EQ(out15[0], 0);
+    TEST_EQ(out15[1], (32767 * fir15_coeffs[2]) >> 15);
+    TEST_EQ(out15[2], (32767 * fir15_coeffs[6]) >> 15);
+
+    TEST_EQ(dsp_fir_q15_init(&fir, fir15_coeffs, fir15_state, 0, 1), -RT_EINVAL);
+    TEST_EQ(dsp_fir_q15_init(&fir, fir15_coeffs, fir15_state, TAPS, 0), -RT_EINVAL);
+}
+
+/**=============================================================================
+ * @brief           Q31 FIR：64 位累加，误差小于 1 LSB
+ *============================================================================*/
+static void test_fir_q31(void)
+{
+    static const rt_uint16_t decims[] = {1, 4};
+    struct dsp_fir_q31 fir;
+    double out[N], err;
+    rt_size_t d, s, i, n, m;
+
+    srand(31);
+    for (d = 0; d < sizeof(decims) / sizeof(decims[0]); d++)
+    {
+        for (s = 0; s < SIG_NUM; s++)
+        {
+            /* 满量程输入，系数绝对值之和小于 1 不会饱和 */
+            _signal((int)s, 2147483647.0, 0);
+            for (i = 0; i < N; i++)
+                in31[i] = (q31_t)x[i];
+
+            TEST_EQ(dsp_fir_q31_init(&fir, fir31_coeffs, fir31_state, TAPS, decims[d]), RT_EOK);
+            n = dsp_fir_q31_process(&fir, in31, out31, N);
+            m = _ref_fir(fir31_ref, TAPS, x, N, decims[d], ref);
+            TEST_EQ(n, m);
+            for (i = 0; i < n; i++)
+                out[i] = out31[i];
+            err = _max_err(out, ref, n);
+            printf("   /%u %-7s max error %.3f LSB\n", decims[d], sig_names[s], err);
+            TEST_ASSERT(err < 1.0);
+        }
+    }
+}
+
+/**=============================================================================
+ * @brief           Q14 双二阶：每级输出截断的误差经反馈放大，上限为
+ *                  第一级 1/A1 的增益经过第二级 H2，再加第二级 1/A2 的增益
+ *============================================================================*/
+static void test_biquad(void)
+{
+    struct dsp_biquad_q15 iir;
+    double out[N], a1[5], a2[5], bound, err, dc;
+    rt_size_t s, i;
+
+    a1[0] = a2[0] = 1;
+    a1[1] = a1[2] = a2[1] = a2[2] = 0;
+    a1[3] = biquad_ref[3];
+    a1[4] = biquad_ref[4];
+    a2[3] = biquad_ref[8];
+    a2[4] = biquad_ref[9];
+    bound = _l1(&biquad_ref[5], 1) * _l1(a1, 1) + _l1(a2, 1);
+
+    srand(14);
+    for (s = 0; s < SIG_NUM; s++)
+    {
+        /* 1/4 满量程，阶跃过冲和随机输入的峰值增益都不会饱和 */
+        _signal((int)s, 8192, 0);
+        for (i = 0; i < N; i++)
+            in15[i] = (q15_t)x[i];
+
+        TEST_EQ(dsp_biquad_q15_init(&iir, biquad_coeffs, biquad_state, 2), RT_EOK);
+        dsp_biquad_q15_process(&iir, in15, out15, N);
+        _ref_biquad(biquad_ref, 2, x, N, ref);
+        for (i = 0; i < N; i++)
+            out[i] = out15[i];
+        err = _max_err(out, ref, N);
+        printf("   %-7s max error %.3f LSB, bound %.3f LSB\n", sig_names[s], err, bound);
+        TEST_ASSERT(err <= bound);
+    }
+
+    /* 阶跃稳定后为两级直流增益之积 */
+    _signal(SIG_STEP, 8192, 0);
+    for (i = 0; i < N; i++)
+        in15[i] = (q15_t)x[i];
+    dsp_biquad_q15_init(&iir, biquad_coeffs, biquad_state, 2);
+    dsp_biquad_q15_process(&iir, in15, out15, N);
+    dc = 8192;
+    for (s = 0; s < 2; s++)
+        dc *= (biquad_ref[5 * s] + biquad_ref[5 * s + 1] + biquad_ref[5 * s + 2]) /
+              (1 + biquad_ref[5 * s + 3] + biquad_ref[5 * s + 4]);
+    printf("   step settles at %d, dc gain %.1f\n", out15[N - 1], dc);
+    TEST_ASSERT(fabs(out15[N - 1] - dc) <= bound);
+
+    TEST_EQ(dsp_biquad_q15_init(&iir, biquad_coeffs, biquad_state, 0), -RT_EINVAL);
+}
+
+/**=============================================================================
+ * @brief           双精度 CIC：order 次长度为 rate 的滑动和，每 rate 个取一个
+ *
+ * @return          输出个数
+ *============================================================================*/
+static rt_size_t _ref_cic(rt_size_t order, rt_size_t rate, double *out)
+{
+    rt_size_t o, i, k, m = 0;
+    double acc;
+
+    memcpy(tmp, x, sizeof(tmp));
+    for (o = 0; o < order; o++)
+    {
+        for (i = N; i-- > 0;)
+        {
+            acc = 0;
+            for (k = 0; k < rate && k <= i; k++)
+                acc += tmp[i - k];
+            tmp[i] = acc;
+        }
+    }
+    for (i = rate - 1; i < N; i += rate)
+        out[m++] = tmp[i];
+    return m;
+}
+
+/**=============================================================================
+ * @brief           CIC：整数运算，结果等于参考值右移后向下取整，
+ *                  与参考值之差小于 1 LSB；按 stride 读交错的通道
+ *============================================================================*/
+static void test_cic(void)
+{
+    static const rt_uint8_t cfg[][2] = {{1, 4}, {2, 10}, {3, 16}, {4, 16}};
+    struct dsp_cic cic;
+    rt_size_t c, s, i, n, m, bad, bits;
+    double scale, err, e;
+
+    srand(12);
+    for (c = 0; c < sizeof(cfg) / sizeof(cfg[0]); c++)
+    {
+        for (s = 0; s < SIG_NUM; s++)
+        {
+            /* 12 位无符号，另一个通道填满 1，读错位置会很明显 */
+            _signal((int)s, s == SIG_RANDOM ? 2047 : 4095, s == SIG_RANDOM ? 2048 : 0);
+            for (i = 0; i < N; i++)
+            {
+                adc[2 * i]     = (rt_uint16_t)x[i];
+                adc[2 * i + 1] = 0xFFFF;
+            }
+
+            TEST_EQ(dsp_cic_init(&cic, cfg[c][0], cfg[c][1], 16), RT_EOK);
+            bits = DSP_ADC_BITS + cfg[c][0] * (32 - __builtin_clz(cfg[c][1] - 1));
+            TEST_EQ(cic.shift, bits > 16 ? bits - 16 : 0);
+            n = dsp_cic_process(&cic, adc, 2, outi, N);
+            m = _ref_cic(cfg[c][0], cfg[c][1], ref);
+            TEST_EQ(n, m);
+
+            scale = ldexp(1.0, -cic.shift);
+            err = 0;
+            bad = 0;
+            for (i = 0; i < n; i++)
+            {
+                if (outi[i] != (rt_int32_t)floor(ref[i] * scale))
+                    bad++;
+                e = fabs(outi[i] - ref[i] * scale);
+                if (e > err)
+                    err = e;
+            }
+            printf("   order %u /%-2u %-7s max error %.3f LSB\n", cfg[c][0], cfg[c][1], sig_names[s], err);
+            TEST_EQ(bad, 0);
+            TEST_ASSERT(err < 1.0);
+            TEST_ASSERT(outi[n - 1] < 1 << 16);
+        }
+    }
+
+    /* 满量程阶跃：抽取比为 2 的幂时正好到 16 位满量程减去输入的 1 LSB */
+    _signal(SIG_STEP, 4095, 0);
+    for (i = 0; i < N; i++)
+        adc[i] = (rt_uint16_t)x[i];
+    dsp_cic_init(&cic, 3, 16, 16);
+    n = dsp_cic_process(&cic, adc, 1, outi, N);
+    TEST_EQ(outi[n - 1], (4095 << 12) >> 8);
+
+    TEST_EQ(dsp_cic_init(&cic, 0, 16, 16), -RT_EINVAL);
+    TEST_EQ(dsp_cic_init(&cic, DSP_CIC_MAX_ORDER + 1, 16, 16), -RT_EINVAL);
+    TEST_EQ(dsp_cic_init(&cic, 3, 1, 16), -RT_EINVAL);
+    TEST_EQ(dsp_cic_init(&cic, 4, 64, 16), -RT_EINVAL);
+}
+
+/**=============================================================================
+ * @brief           滑动平均：长度为 2 的幂和不是 2 的幂两条路径，
+ *                  结果为窗口均值向下取整
+ *============================================================================*/
+static void test_mavg(void)
+{
+    static const rt_uint16_t lens[] = {16, 10};
+    struct dsp_mavg avg;
+    rt_size_t l, s, i, k, bad;
+    double sum, err, e;
+
+    srand(16);
+    for (l = 0; l < sizeof(lens) / sizeof(lens[0]); l++)
+    {
+        for (s = 0; s < SIG_NUM; s++)
+        {
+            _signal((int)s, s == SIG_RANDOM ? 2047 : 4095, s == SIG_RANDOM ? 2048 : 0);
+            for (i = 0; i < N; i++)
+            {
+                adc[3 * i]     = (rt_uint16_t)x[i];
+                adc[3 * i + 1] = adc[3 * i + 2] = 0xFFFF;
+            }
+
+            TEST_EQ(dsp_mavg_init(&avg, mavg_hist, lens[l]), RT_EOK);
+            TEST_EQ(avg.shift, lens[l] == 16 ? 4 : -1);
+            dsp_mavg_process(&avg, adc, 3, outu, N);
+
+            err = 0;
+            bad = 0;
+            for (i = 0; i < N; i++)
+            {
+                sum = 0;
+                for (k = 0; k < lens[l] && k <= i; k++)
+                    sum += x[i - k];
+                if (outu[i] != (rt_uint16_t)floor(sum / lens[l]))
+                    bad++;
+                e = fabs(outu[i] - sum / lens[l]);
+                if (e > err)
+                    err = e;
+            }
+            printf("   len %-2u %-7s max error %.3f LSB\n", lens[l], sig_names[s], err);
+            TEST_EQ(bad, 0);
+            TEST_ASSERT(err < 1.0);
+        }
+    }
+
+    TEST_EQ(dsp_mavg_init(&avg, mavg_hist, 0), -RT_EINVAL);
+}
+
+/**=============================================================================
+ * @brief           分块处理与整块处理结果相同：延迟线、抽取相位和累加和跨块保持
+ *============================================================================*/
+static void test_blocks(void)
+{
+    struct dsp_fir_q15 fir15;
+    struct dsp_fir_q31 fir31;
+    struct dsp_biquad_q15 iir;
+    struct dsp_cic cic;
+    struct dsp_mavg avg;
+    rt_size_t i, pos, len, c, n, m;
+
+    srand(7);
+    _signal(SIG_RANDOM, 8192, 0);
+    for (i = 0; i < N; i++)
+    {
+        in15[i] = (q15_t)x[i];
+        in31[i] = (q31_t)x[i] * 65536;
+        adc[i]  = (rt_uint16_t)(x[i] + 2048);
+    }
+
+#define BLOCKS(init, whole, part, out, blk)                                     \
+    do {                                                                        \
+        init;                                                                   \
+        n = whole;                                                              \
+        init;                                                                   \
+        for (pos = 0, c = 0, m = 0; pos < N; pos += len, c++)                   \
+        {                                                                       \
+            len = chunks[c % (sizeof(chunks) / sizeof(chunks[0]))];             \
+            if (len > N - pos)                                                  \
+                len = N - pos;                                                  \
+            m += part;                                                          \
+        }                                                                       \
+        TEST_EQ(m, n);                                                          \
+        TEST_MEM_EQ(out, blk, n * sizeof(out[0]));                              \
+    } while (0)
+
+    BLOCKS(dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, TAPS, 3),
+           dsp_fir_q15_process(&fir15, in15, out15, N),
+           dsp_fir_q15_process(&fir15, in15 + pos, blk15 + m, len), out15, blk15);
+    BLOCKS(dsp_fir_q31_init(&fir31, fir31_coeffs, fir31_state, TAPS, 4),
+           dsp_fir_q31_process(&fir31, in31, out31, N),
+           dsp_fir_q31_process(&fir31, in31 + pos, blk31 + m, len), out31, blk31);
+    BLOCKS(dsp_biquad_q15_init(&iir, biquad_coeffs, biquad_state, 2),
+           (dsp_biquad_q15_process(&iir, in15, out15, N), N),
+           (dsp_biquad_q15_process(&iir, in15 + pos, blk15 + m, len), len), out15, blk15);
+    BLOCKS(dsp_cic_init(&cic, 3, 10, 16),
+           dsp_cic_process(&cic, adc, 1, outi, N),
+           dsp_cic_process(&cic, adc + pos, 1, blki + m, len), outi, blki);
+    BLOCKS(dsp_mavg_init(&avg, mavg_hist, 10),
+           (dsp_mavg_process(&avg, adc, 1, outu, N), N),
+           (dsp_mavg_process(&avg, adc + pos, 1, blku + m, len), len), outu, blku);
+
+#undef BLOCKS
+
+    /* FIR 可以原地处理 */
+    dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, TAPS, 1);
+    dsp_fir_q15_process(&fir15, in15, out15, N);
+    memcpy(blk15, in15, sizeof(blk15));
+    dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, TAPS, 1);
+    dsp_fir_q15_process(&fir15, blk15, blk15, N);
+    TEST_MEM_EQ(out15, blk15, sizeof(out15));
+}
+
+static double _now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/**=============================================================================
+ * @brief           各滤波器每个输入样本的耗时
+ *
+ * @note            模拟器只对寄存器访问计时，固件 dsp 命令用 DWT 测得的周期数
+ *                  在这里为 0，所以用主机时钟，数字只用于比较各内核的相对开销
+ *============================================================================*/
+static void test_bench(void)
+{
+    struct dsp_fir_q15 fir15;
+    struct dsp_fir_q31 fir31;
+    struct dsp_biquad_q15 iir;
+    struct dsp_cic cic;
+    struct dsp_mavg avg;
+    double t;
+    rt_size_t i, r;
+
+    for (i = 0; i < BENCH_N; i++)
+    {
+        bench_adc[i] = (rt_uint16_t)((i * 97) & 0xFFF);
+        bench31[i]   = (q31_t)(i * 0x01234567u);
+    }
+    dsp_adc_to_q15(bench_adc, 1, bench15, BENCH_N);
+
+#define BENCH(name, init, call)                                                 \
+    do {                                                                        \
+        init;                                                                   \
+        t = _now();                                                             \
+        for (r = 0; r < BENCH_ROUNDS; r++)                                      \
+            call;                                                               \
+        t = (_now() - t) * 1e9 / ((double)BENCH_N * BENCH_ROUNDS);              \
+        printf("   %-20s %6.2f ns/sample (host)\n", name, t);                   \
+    } while (0)
+
+    BENCH("adc_to_q15", (void)0, dsp_adc_to_q15(bench_adc, 1, bench15, BENCH_N));
+    BENCH("fir_q15 31 taps", dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, TAPS, 1),
+          dsp_fir_q15_process(&fir15, bench15, bench15, BENCH_N));
+    BENCH("fir_q15 31 taps /4", dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, TAPS, 4),
+          dsp_fir_q15_process(&fir15, bench15, bench15, BENCH_N));
+    BENCH("fir_q31 31 taps", dsp_fir_q31_init(&fir31, fir31_coeffs, fir31_state, TAPS, 1),
+          dsp_fir_q31_process(&fir31, bench31, bench31, BENCH_N));
+    BENCH("biquad_q15 2 stages", dsp_biquad_q15_init(&iir, biquad_coeffs, biquad_state, 2),
+          dsp_biquad_q15_process(&iir, bench15, bench15, BENCH_N));
+    BENCH("cic 3rd order /16", dsp_cic_init(&cic, 3, 16, 16),
+          dsp_cic_process(&cic, bench_adc, 1, bench_i32, BENCH_N));
+    BENCH("mavg 16", dsp_mavg_init(&avg, mavg_hist, 16),
+          dsp_mavg_process(&avg, bench_adc, 1, bench_u16, BENCH_N));
+
+#undef BENCH
+
+    /* 抽取 FIR 只计算要输出的点；主机时钟的数字只打印，不作为通过条件 */
+    dsp_fir_q15_init(&fir15, fir15_coeffs, fir15_state, TAPS, 4);
+    TEST_EQ(dsp_fir_q15_process(&fir15, bench15, bench15, BENCH_N), BENCH_N / 4);
+}
+
+static void test_main(void)
+{
+    _setup_coeffs();
+    TEST_CASE(test_fir_q15);
+    TEST_CASE(test_fir_q31);
+    TEST_CASE(test_biquad);
+    TEST_CASE(test_cic);
+    TEST_CASE(test_mavg);
+    TEST_CASE(test_blocks);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
@@ -0,0 +1,158 @@
+/**
+  ******************************************************************************
+  * @file			test_flash_writer.c
+  * @brief			flash_writer on the NOR flash model: bounds, erase/program skipping
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rtthread.h>
+#include <flash_writer.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define REGION_PAGES        8
+#define REGION_SIZE         (REGION_PAGES * FLASH_PAGE_SIZE)
+#define REGION_ADDR         (FLASH_BASE + 0x30000u)
+#define BENCH_ADDR          (FLASH_BASE + 0x20000u)
+
+/* Private variables ---------------------------------------------------------*/
+static struct flash_writer  fw;
+static rt_uint8_t           image[REGION_SIZE] __attribute__((aligned(2)));
+
+/* Private function ----------------------------------------------------------*/
+
+static rt_uint32_t _region_erases(rt_uint32_t addr)
+{
+    rt_uint32_t i, n = 0;
+
+    for (i = 0; i < REGION_PAGES; i++)
+        n += sim_flash_erase_count(addr + i * FLASH_PAGE_SIZE);
+    return n;
+}
+
+/**=============================================================================
+ * @brief           按乱序块长写入整个区域
+ *============================================================================*/
+static void _write_image(rt_uint32_t addr)
+{
+    rt_size_t off = 0, n;
+
+    TEST_EQ(flash_writer_open(&fw, addr, REGION_SIZE), RT_EOK);
+    while (off < REGION_SIZE)
+    {
+        n = rand() % 700 + 1;
+        if (n > REGION_SIZE - off)
+            n = REGION_SIZE - off;
+        TEST_EQ(flash_writer_write(&fw, image + off, n), RT_EOK);
+        off += n;
+    }
+    TEST_EQ(flash_writer_close(&fw), RT_EOK);
+    TEST_MEM_EQ((const void *)(rt_ubase_t)addr, image, REGION_SIZE);
+}
+
+/**=============================================================================
+ * @brief           区域边界按 FLASHSIZE 寄存器给出的 256KB，而不是头文件的 512KB
+ *============================================================================*/
+static void test_bounds(void)
+{
+    rt_uint32_t end = flash_writer_flash_end();
+
+    TEST_EQ(end, FLASH_BASE + *(volatile rt_uint16_t *)FLASHSIZE_BASE * 1024u);
+    TEST_EQ(end, 0x08040000UL);
+    TEST_EQ(flash_writer_open(&fw, end - FLASH_PAGE_SIZE, FLASH_PAGE_SIZE), RT_EOK);
+    TEST_EQ(flash_writer_open(&fw, end - FLASH_PAGE_SIZE, 2 * FLASH_PAGE_SIZE), -RT_EINVAL);
+    TEST_EQ(flash_writer_open(&fw, end, FLASH_PAGE_SIZE), -RT_EINVAL);
+    TEST_EQ(flash_writer_open(&fw, FLASH_BASE - 2, 4), -RT_EINVAL);
+    TEST_EQ(flash_writer_open(&fw, FLASH_BASE, 0xFFFFFFFFUL), -RT_EINVAL);
+}
+
+/**=============================================================================
+ * @brief           空白页不擦除，0xFFFF 与未变化的半字不编程，需要 0->1 时才擦除
+ *============================================================================*/
+static void test_stream(void)
+{
+    rt_uint32_t programs, erases, expect = 0, i;
+
+    srand(6);
+    for (i = 0; i < REGION_SIZE; i++)
+        image[i] = (i / 256) % 3 == 0 ? 0xFF : (rt_uint8_t)rand();
+    image[2 * FLASH_PAGE_SIZE + 300] = 0x00;
+    for (i = 0; i < REGION_SIZE; i += 2)
+        expect += *(rt_uint16_t *)&image[i] != 0xFFFF;
+
+    programs = sim_flash_program_count();
+    erases = _region_erases(REGION_ADDR);
+    _write_image(REGION_ADDR);
+    TEST_EQ(_region_erases(REGION_ADDR) - erases, 0);
+    TEST_EQ(sim_flash_program_count() - programs, expect);
+    TEST_EQ(fw.erase_skipped, REGION_PAGES);
+
+    /* 内容不变：既不擦除也不编程 */
+    programs = sim_flash_program_count();
+    _write_image(REGION_ADDR);
+    TEST_EQ(_region_erases(REGION_ADDR) - erases, 0);
+    TEST_EQ(sim_flash_program_count() - programs, 0);
+
+    /* 第 3 页的一个字节出现 0->1，只擦这一页 */
+    image[2 * FLASH_PAGE_SIZE + 300] = 0x01;
+    _write_image(REGION_ADDR);
+    TEST_EQ(_region_erases(REGION_ADDR) - erases, 1);
+    TEST_EQ(sim_flash_erase_count(REGION_ADDR + 2 * FLASH_PAGE_SIZE), 1);
+    TEST_EQ(fw.erase_count, 1);
+}
+
+/**=============================================================================
+ * @brief           固件升级场景：含 1/3 空白的镜像写入空白区域，与先整片擦除
+ *                  再逐半字 HAL_FLASH_Program 比较模拟时间和操作数
+ *============================================================================*/
+static void test_bench(void)
+{
+    FLASH_EraseInitTypeDef erase = {FLASH_TYPEERASE_PAGES, FLASH_BANK_1, BENCH_ADDR, REGION_PAGES};
+    rt_uint64_t t0, naive_ns, writer_ns;
+    rt_uint32_t p0, naive_ops, writer_ops, page_error, i;
+
+    for (i = 0; i < REGION_SIZE; i++)
+        image[i] = (i / 256) % 3 == 0 ? 0xFF : (rt_uint8_t)rand();
+
+    t0 = sim_time();
+    p0 = sim_flash_program_count();
+    HAL_FLASH_Unlock();
+    HAL_FLASHEx_Erase(&erase, &page_error);
+    for (i = 0; i < REGION_SIZE; i += 2)
+        HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, BENCH_ADDR + i, *(rt_uint16_t *)&image[i]);
+    HAL_FLASH_Lock();
+    naive_ns = sim_time() - t0;
+    naive_ops = sim_flash_program_count() - p0 + REGION_PAGES;
+    TEST_MEM_EQ((const void *)BENCH_ADDR, image, REGION_SIZE);
+
+    t0 = sim_time();
+    p0 = sim_flash_program_count();
+    _write_image(BENCH_ADDR + REGION_SIZE);
+    writer_ns = sim_time() - t0;
+    writer_ops = sim_flash_program_count() - p0 + fw.erase_count;
+
+    printf("   erase + HAL_FLASH_Program: %6.2f ms, %u erase/program ops\n", naive_ns / 1e6, (unsigned)naive_ops);
+    printf("   flash_writer:              %6.2f ms, %u erase/program ops\n", writer_ns / 1e6, (unsigned)writer_ops);
+    TEST_ASSERT(writer_ns < naive_ns);
+    TEST_ASSERT(writer_ops < naive_ops);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_bounds);
+    TEST_CASE(test_stream);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
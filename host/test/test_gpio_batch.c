@@ -0,0 +1,271 @@
+/**
+  ******************************************************************************
+  * @file			test_gpio_batch.c
+  * @brief			gpio_batch: register-level equivalence with HAL_GPIO_Init
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rtthread.h>
+#include <gpio_batch.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define PORTS               5                   /*!< GPIOA..GPIOE */
+#define MAX_PINS            12
+#define ROUNDS              2000
+/* AFIO、EXTI、GPIOA..GPIOE 连续排列 */
+#define LOG_BASE            AFIO_BASE
+#define LOG_SIZE            (GPIOE_BASE + 0x400u - AFIO_BASE)
+
+/* Private typedef -----------------------------------------------------------*/
+struct gpio_state
+{
+    rt_uint32_t cr[PORTS][2];
+    rt_uint32_t odr[PORTS];
+    rt_uint32_t exticr[4];
+    rt_uint32_t imr, emr, rtsr, ftsr;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static GPIO_TypeDef *const ports[PORTS] = {GPIOA, GPIOB, GPIOC, GPIOD, GPIOE};
+
+static const rt_uint32_t modes[] =
+{
+    GPIO_MODE_INPUT, GPIO_MODE_OUTPUT_PP, GPIO_MODE_OUTPUT_OD, GPIO_MODE_AF_PP,
+    GPIO_MODE_AF_OD, GPIO_MODE_ANALOG, GPIO_MODE_IT_RISING, GPIO_MODE_IT_FALLING,
+    GPIO_MODE_IT_RISING_FALLING, GPIO_MODE_EVT_RISING, GPIO_MODE_EVT_FALLING,
+    GPIO_MODE_EVT_RISING_FALLING,
+};
+static const rt_uint32_t pulls[]  = {GPIO_NOPULL, GPIO_PULLUP, GPIO_PULLDOWN};
+static const rt_uint32_t speeds[] = {GPIO_SPEED_FREQ_LOW, GPIO_SPEED_FREQ_MEDIUM, GPIO_SPEED_FREQ_HIGH};
+
+/* 编译期生成的镜像，与运行时 compile 的结果比较 */
+#define KEY_PINS(PIN)                                                       \
+    PIN(0,  GPIO_MODE_IT_FALLING,        GPIO_PULLUP,   0)                  \
+    PIN(3,  GPIO_MODE_INPUT,             GPIO_PULLDOWN, 0)                  \
+    PIN(9,  GPIO_MODE_OUTPUT_OD,         GPIO_NOPULL,   GPIO_SPEED_FREQ_HIGH) \
+    PIN(13, GPIO_MODE_EVT_RISING_FALLING, GPIO_NOPULL,  0)
+static const struct gpio_batch_port key_port = GPIO_BATCH_PORT(GPIOC, KEY_PINS);
+
+static const gpio_batch_pin_t key_pins[] =
+{
+    {GPIOC, GPIO_PIN_0,  GPIO_MODE_IT_FALLING,         GPIO_PULLUP,   0},
+    {GPIOC, GPIO_PIN_3,  GPIO_MODE_INPUT,              GPIO_PULLDOWN, 0},
+    {GPIOC, GPIO_PIN_9,  GPIO_MODE_OUTPUT_OD,          GPIO_NOPULL,   GPIO_SPEED_FREQ_HIGH},
+    {GPIOC, GPIO_PIN_13, GPIO_MODE_EVT_RISING_FALLING, GPIO_NOPULL,   0},
+};
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           通过影子映射直接读写，不产生寄存器访问
+ *============================================================================*/
+static void _save(struct gpio_state *s)
+{
+    EXTI_TypeDef *exti = SIM_PERIPH(EXTI_TypeDef, EXTI);
+    int i;
+
+    for (i = 0; i < PORTS; i++)
+    {
+        s->cr[i][0] = SIM_PERIPH(GPIO_TypeDef, ports[i])->CRL;
+        s->cr[i][1] = SIM_PERIPH(GPIO_TypeDef, ports[i])->CRH;
+        s->odr[i]   = SIM_PERIPH(GPIO_TypeDef, ports[i])->ODR;
+    }
+    memcpy(s->exticr, (const void *)SIM_PERIPH(AFIO_TypeDef, AFIO)->EXTICR, sizeof(s->exticr));
+    s->imr  = exti->IMR;
+    s->emr  = exti->EMR;
+    s->rtsr = exti->RTSR;
+    s->ftsr = exti->FTSR;
+}
+
+static void _restore(const struct gpio_state *s)
+{
+    EXTI_TypeDef *exti = SIM_PERIPH(EXTI_TypeDef, EXTI);
+    int i;
+
+    for (i = 0; i < PORTS; i++)
+    {
+        SIM_PERIPH(GPIO_TypeDef, ports[i])->CRL = s->cr[i][0];
+        SIM_PERIPH(GPIO_TypeDef, ports[i])->CRH = s->cr[i][1];
+        SIM_PERIPH(GPIO_TypeDef, ports[i])->ODR = s->odr[i];
+    }
+    memcpy((void *)SIM_PERIPH(AFIO_TypeDef, AFIO)->EXTICR, s->exticr, sizeof(s->exticr));
+    exti->IMR  = s->imr;
+    exti->EMR  = s->emr;
+    exti->RTSR = s->rtsr;
+    exti->FTSR = s->ftsr;
+}
+
+/**=============================================================================
+ * @brief           随机的起始寄存器状态，保证 CNF/MODE 合法
+ *============================================================================*/
+static void _randomize(struct gpio_state *s)
+{
+    int i, j;
+
+    for (i = 0; i < PORTS; i++)
+    {
+        s->cr[i][0] = ((rt_uint32_t)rand() << 16) ^ (rt_uint32_t)rand();
+        s->cr[i][1] = ((rt_uint32_t)rand() << 16) ^ (rt_uint32_t)rand();
+        s->odr[i]   = rand() & 0xFFFF;
+    }
+    for (j = 0; j < 4; j++)
+        s->exticr[j] = (rand() & 0x3333);
+    s->imr  = rand() & 0xFFFF;
+    s->emr  = rand() & 0xFFFF;
+    s->rtsr = rand() & 0xFFFF;
+    s->ftsr = rand() & 0xFFFF;
+}
+
+static void _random_table(gpio_batch_pin_t *pins, rt_size_t count)
+{
+    rt_size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        pins[i].Port  = ports[rand() % PORTS];
+        /* 多数为单个引脚，也有多引脚组合，引脚和端口之间可能重复 */
+        pins[i].Pin   = rand() % 4 ? 1u << (rand() % 16) : (rand() & 0xFFFF) | 1u;
+        pins[i].Mode  = modes[rand() % (sizeof(modes) / sizeof(modes[0]))];
+        pins[i].Pull  = pulls[rand() % 3];
+        pins[i].Speed = speeds[rand() % 3];
+    }
+}
+
+static void _hal_init(const gpio_batch_pin_t *pins, rt_size_t count)
+{
+    GPIO_InitTypeDef init;
+    rt_size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        init.Pin   = pins[i].Pin;
+        init.Mode  = pins[i].Mode;
+        init.Pull  = pins[i].Pull;
+        init.Speed = pins[i].Speed;
+        HAL_GPIO_Init(pins[i].Port, &init);
+    }
+}
+
+/**=============================================================================
+ * @brief           每个寄存器地址最多写一次
+ *============================================================================*/
+static int _writes_unique(void)
+{
+    size_t i, j, n = sim_log_count();
+
+    for (i = 0; i < n; i++)
+    {
+        for (j = i + 1; j < n; j++)
+        {
+            if (sim_log_get(i)->addr == sim_log_get(j)->addr)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/**=============================================================================
+ * @brief           随机描述表：HAL_GPIO_Init 逐项配置与 gpio_batch_init 一次
+ *                  提交后，CRL/CRH/ODR/EXTICR/EXTI 完全相同
+ *============================================================================*/
+static void test_equivalence(void)
+{
+    gpio_batch_pin_t pins[MAX_PINS];
+    struct gpio_state start, hal, batch;
+    rt_size_t count, hal_writes = 0, batch_writes = 0;
+    int round;
+
+    srand(9);
+    for (round = 0; round < ROUNDS; round++)
+    {
+        count = rand() % MAX_PINS + 1;
+        _random_table(pins, count);
+        _randomize(&start);
+
+        _restore(&start);
+        sim_log_start(LOG_BASE, LOG_SIZE);
+        _hal_init(pins, count);
+        hal_writes += sim_log_count();
+        _save(&hal);
+
+        _restore(&start);
+        sim_log_start(LOG_BASE, LOG_SIZE);
+        TEST_EQ(gpio_batch_init(pins, count), RT_EOK);
+        batch_writes += sim_log_count();
+        TEST_ASSERT(_writes_unique());
+        sim_log_stop();
+        _save(&batch);
+
+        if (memcmp(&hal, &batch, sizeof(hal)) != 0)
+        {
+            printf("   round %d, %u entries\n", round, (unsigned)count);
+            TEST_ASSERT(!"register state differs from HAL_GPIO_Init");
+        }
+        if (sim_host_exit_code() != 0)
+            return;
+    }
+
+    printf("   register writes: HAL_GPIO_Init %u, gpio_batch %u (%d tables)\n",
+           (unsigned)hal_writes, (unsigned)batch_writes, ROUNDS);
+    TEST_ASSERT(batch_writes < hal_writes);
+}
+
+/**=============================================================================
+ * @brief           GPIO_BATCH_PORT 编译期镜像与 gpio_batch_compile 结果相同
+ *============================================================================*/
+static void test_macro(void)
+{
+    struct gpio_batch_port p[GPIO_BATCH_MAX_PORTS];
+
+    memset(p, 0, sizeof(p));
+    TEST_EQ(gpio_batch_compile(key_pins, sizeof(key_pins) / sizeof(key_pins[0]), p, GPIO_BATCH_MAX_PORTS), 1);
+    TEST_ASSERT(p[0].port == key_port.port);
+    TEST_EQ(p[0].crl_mask, key_port.crl_mask);
+    TEST_EQ(p[0].crl, key_port.crl);
+    TEST_EQ(p[0].crh_mask, key_port.crh_mask);
+    TEST_EQ(p[0].crh, key_port.crh);
+    TEST_EQ(p[0].odr_set, key_port.odr_set);
+    TEST_EQ(p[0].odr_reset, key_port.odr_reset);
+    TEST_EQ(p[0].exti, key_port.exti);
+    TEST_EQ(p[0].imr, key_port.imr);
+    TEST_EQ(p[0].emr, key_port.emr);
+    TEST_EQ(p[0].rtsr, key_port.rtsr);
+    TEST_EQ(p[0].ftsr, key_port.ftsr);
+}
+
+/**=============================================================================
+ * @brief           端口镜像容量不足
+ *============================================================================*/
+static void test_full(void)
+{
+    static const gpio_batch_pin_t two[] =
+    {
+        {GPIOA, GPIO_PIN_1, GPIO_MODE_OUTPUT_PP, GPIO_NOPULL, GPIO_SPEED_FREQ_LOW},
+        {GPIOB, GPIO_PIN_1, GPIO_MODE_OUTPUT_PP, GPIO_NOPULL, GPIO_SPEED_FREQ_LOW},
+    };
+    struct gpio_batch_port p[1];
+
+    TEST_EQ(gpio_batch_compile(two, 2, p, 1), -RT_EFULL);
+    TEST_EQ(gpio_batch_compile(two, 1, p, 1), 1);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_equivalence);
+    TEST_CASE(test_macro);
+    TEST_CASE(test_full);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
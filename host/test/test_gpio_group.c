@@ -0,0 +1,293 @@
+/**
+  ******************************************************************************
+  * @file			test_gpio_group.c
+  * @brief			gpio_group: BSRR updates against a model, ISR safety, write count
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rtthread.h>
+#include <gpio_group.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define PORTS               4
+#define ROUNDS              300
+#define OPS                 50
+#define ISR_PIN             GPIO_PIN_15         /*!< 中断中翻转，不属于组 */
+#define BUS_WIDTH           8
+#define BUS_WORDS           1000
+
+/* Private variables ---------------------------------------------------------*/
+static GPIO_TypeDef *const ports[PORTS] = {GPIOA, GPIOB, GPIOC, GPIOD};
+
+static struct gpio_group    grp;
+static volatile rt_uint32_t isr_count;
+static volatile int         isr_level;
+
+/* Private function ----------------------------------------------------------*/
+
+static rt_uint16_t _odr(GPIO_TypeDef *port)
+{
+    return sim_gpio_output(port);
+}
+
+/**=============================================================================
+ * @brief           按成员表把组值换成各端口的输出电平
+ *============================================================================*/
+static void _expect(const struct gpio_group_pin *pins, rt_size_t count, rt_uint32_t value,
+                    const rt_uint16_t *before, rt_uint16_t *odr)
+{
+    rt_size_t i;
+    int k;
+
+    memcpy(odr, before, PORTS * sizeof(odr[0]));
+    for (i = 0; i < count; i++)
+    {
+        for (k = 0; ports[k] != pins[i].port; k++)
+            ;
+        if (value & (1u << i))
+            odr[k] |= pins[i].pin;
+        else
+            odr[k] &= ~pins[i].pin;
+    }
+}
+
+/* 中断中用 BSRR 翻转同一端口上不属于组的引脚 */
+void EXTI0_IRQHandler(void)
+{
+    isr_level = !isr_level;
+    GPIOA->BSRR = isr_level ? ISR_PIN : (rt_uint32_t)ISR_PIN << 16;
+    isr_count++;
+}
+
+static void test_init(void)
+{
+    const struct gpio_group_pin dup[]   = {{GPIOA, GPIO_PIN_1}, {GPIOA, GPIO_PIN_1}};
+    const struct gpio_group_pin multi[] = {{GPIOA, GPIO_PIN_1 | GPIO_PIN_2}};
+    const struct gpio_group_pin many[]  = {{GPIOA, GPIO_PIN_0}, {GPIOB, GPIO_PIN_0}, {GPIOC, GPIO_PIN_0},
+                                           {GPIOD, GPIO_PIN_0}, {GPIOE, GPIO_PIN_0}};
+    const struct gpio_group_pin bus[]   = {{GPIOB, GPIO_PIN_8}, {GPIOB, GPIO_PIN_9}, {GPIOB, GPIO_PIN_10}};
+
+    TEST_EQ(gpio_group_init(&grp, dup, 2), -RT_EINVAL);
+    TEST_EQ(gpio_group_init(&grp, multi, 1), -RT_EINVAL);
+    TEST_EQ(gpio_group_init(&grp, many, 5), -RT_EFULL);
+    TEST_EQ(gpio_group_init(&grp, bus, 3), RT_EOK);
+    TEST_EQ(grp.nports, 1);
+    TEST_EQ(grp.port[0].shift, 8);
+    TEST_EQ(grp.port[0].mask, 0x0700);
+}
+
+/**=============================================================================
+ * @brief           随机成员表上随机 write/modify/toggle，与参考模型比较，
+ *                  每次更新每个端口只写一次 BSRR
+ *============================================================================*/
+static void test_model(void)
+{
+    struct gpio_group_pin pins[GPIO_GROUP_MAX_PINS];
+    rt_uint16_t before[PORTS], expect[PORTS], now[PORTS];
+    rt_uint32_t value, set, clear, all;
+    rt_size_t count, i, j, w;
+    int round, op, k;
+
+    srand(10);
+    for (round = 0; round < ROUNDS; round++)
+    {
+        /* 一半的组按连续引脚排列，走整体移位的路径 */
+        count = rand() % GPIO_GROUP_MAX_PINS + 1;
+        for (i = 0, w = 0; i < count; i++)
+        {
+            if (round & 1)
+            {
+                pins[w].port = ports[rand() % PORTS];
+                pins[w].pin  = 1u << (rand() % 16);
+            }
+            else
+            {
+                pins[w].port = ports[(i + round) / 16 % PORTS];
+                pins[w].pin  = 1u << ((i + round) % 16);
+            }
+            /* 去掉重复的引脚 */
+            for (j = 0; j < w; j++)
+            {
+                if (pins[j].port == pins[w].port && pins[j].pin == pins[w].pin)
+                    break;
+            }
+            if (j == w)
+                w++;
+        }
+        count = w;
+        TEST_EQ(gpio_group_init(&grp, pins, count), RT_EOK);
+        all = count == 32 ? 0xFFFFFFFFu : (1u << count) - 1u;
+
+        value = 0;
+        gpio_group_write(&grp, 0);
+        for (op = 0; op < OPS; op++)
+        {
+            for (k = 0; k < PORTS; k++)
+                before[k] = _odr(ports[k]);
+
+            sim_log_start(GPIOA_BASE, PORTS * 0x400u);
+            switch (rand() % 3)
+            {
+            case 0:
+                value = ((rt_uint32_t)rand() << 16 ^ (rt_uint32_t)rand()) & all;
+                gpio_group_write(&grp, value);
+                break;
+            case 1:
+                set   = (rt_uint32_t)rand() & all;
+                clear = (rt_uint32_t)rand() & all;
+                gpio_group_modify(&grp, set, clear);
+                value = (value & ~clear) | set;
+                break;
+            default:
+                set = (rt_uint32_t)rand() & all;
+                gpio_group_toggle(&grp, set);
+                value ^= set;
+                break;
+            }
+            for (i = 0; i < sim_log_count(); i++)
+                TEST_EQ(sim_log_get(i)->addr & 0x3FFu, 0x10);
+            TEST_ASSERT(sim_log_count() <= grp.nports);
+            sim_log_stop();
+
+            _expect(pins, count, value, before, expect);
+            for (k = 0; k < PORTS; k++)
+                now[k] = _odr(ports[k]);
+            TEST_MEM_EQ(now, expect, sizeof(now));
+            TEST_EQ(gpio_group_read(&grp), value);
+        }
+        if (sim_host_exit_code() != 0)
+            return;
+    }
+}
+
+/**=============================================================================
+ * @brief           随机时刻的中断翻转同一端口的其他引脚，组更新不会覆盖它
+ *============================================================================*/
+static void test_isr(void)
+{
+    const struct gpio_group_pin pins[] = {{GPIOA, GPIO_PIN_0}, {GPIOA, GPIO_PIN_5}, {GPIOB, GPIO_PIN_3}};
+    rt_uint32_t i, value = 0;
+
+    TEST_EQ(gpio_group_init(&grp, pins, 3), RT_EOK);
+    isr_level = (_odr(GPIOA) & ISR_PIN) != 0;
+    isr_count = 0;
+    HAL_NVIC_SetPriority(EXTI0_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+    sim_preempt_random(5, EXTI0_IRQn);
+
+    for (i = 0; i < 20000; i++)
+    {
+        switch (i % 3)
+        {
+        case 0:
+            value = i & 7;
+            gpio_group_write(&grp, value);
+            break;
+        case 1:
+            gpio_group_toggle(&grp, 5);
+            value ^= 5;
+            break;
+        default:
+            gpio_group_modify(&grp, 2, 1);
+            value = (value & ~1u) | 2u;
+            break;
+        }
+        TEST_EQ(gpio_group_read(&grp), value);
+        if (((_odr(GPIOA) & ISR_PIN) != 0) != isr_level)
+        {
+            TEST_ASSERT(!"pin owned by the ISR was overwritten");
+            break;
+        }
+    }
+
+    sim_preempt_random(0, EXTI0_IRQn);
+    HAL_NVIC_DisableIRQ(EXTI0_IRQn);
+    printf("   %u interrupts during 20000 group updates\n", (unsigned)isr_count);
+    TEST_ASSERT(isr_count > 20);
+}
+
+/**=============================================================================
+ * @brief           8 位并行总线 PB8..PB15 输出 1000 个字：逐位 HAL_GPIO_WritePin
+ *                  与一次 gpio_group_write 比较寄存器写次数和中间状态
+ *============================================================================*/
+static void test_bench(void)
+{
+    struct gpio_group_pin pins[BUS_WIDTH];
+    rt_uint32_t writes[2], glitches[2], odr0, word, i, b;
+    rt_uint64_t t0, ns[2];
+
+    for (b = 0; b < BUS_WIDTH; b++)
+    {
+        pins[b].port = GPIOB;
+        pins[b].pin  = GPIO_PIN_8 << b;
+    }
+    TEST_EQ(gpio_group_init(&grp, pins, BUS_WIDTH), RT_EOK);
+    srand(11);
+
+    /* ODR 的每次变化都是总线上可见的一个状态，多于一次即出现中间值 */
+    t0 = sim_time();
+    odr0 = sim_gpio_odr_writes(GPIOB);
+    sim_log_start(GPIOB_BASE, 0x400);
+    for (i = 0; i < BUS_WORDS; i++)
+    {
+        word = rand() & 0xFF;
+        for (b = 0; b < BUS_WIDTH; b++)
+            HAL_GPIO_WritePin(GPIOB, GPIO_PIN_8 << b, (word >> b) & 1 ? GPIO_PIN_SET : GPIO_PIN_RESET);
+        TEST_EQ(_odr(GPIOB) >> 8, word);
+    }
+    writes[0] = sim_log_count();
+    glitches[0] = sim_gpio_odr_writes(GPIOB) - odr0;
+    ns[0] = sim_time() - t0;
+
+    t0 = sim_time();
+    odr0 = sim_gpio_odr_writes(GPIOB);
+    sim_log_start(GPIOB_BASE, 0x400);
+    for (i = 0; i < BUS_WORDS; i++)
+    {
+        word = rand() & 0xFF;
+        gpio_group_write(&grp, word);
+        TEST_EQ(_odr(GPIOB) >> 8, word);
+    }
+    writes[1] = sim_log_count();
+    glitches[1] = sim_gpio_odr_writes(GPIOB) - odr0;
+    ns[1] = sim_time() - t0;
+    sim_log_stop();
+
+    printf("   HAL_GPIO_WritePin x8: %.2f register writes/word, %u ODR changes, %.1f us\n",
+           (double)writes[0] / BUS_WORDS, (unsigned)glitches[0], ns[0] / 1e3);
+    printf("   gpio_group_write:     %.2f register writes/word, %u ODR changes, %.1f us\n",
+           (double)writes[1] / BUS_WORDS, (unsigned)glitches[1], ns[1] / 1e3);
+    TEST_EQ(writes[0], BUS_WORDS * BUS_WIDTH);
+    TEST_EQ(writes[1], BUS_WORDS);
+    TEST_ASSERT(glitches[1] <= BUS_WORDS);
+}
+
+static void test_main(void)
+{
+    int k;
+
+    /* 全部设为推挽输出，IDR 读回 ODR */
+    for (k = 0; k < PORTS; k++)
+    {
+        ports[k]->CRL = 0x33333333u;
+        ports[k]->CRH = 0x33333333u;
+    }
+    TEST_CASE(test_init);
+    TEST_CASE(test_model);
+    TEST_CASE(test_isr);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
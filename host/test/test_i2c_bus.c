@@ -0,0 +1,534 @@
+/**
+  ******************************************************************************
+  * @file			test_i2c_bus.c
+  * @brief			i2c_bus: register reads and writes against model slaves,
+  *                 DMA or interrupt selection, requests chained from the HAL
+  *                 callbacks, the per-message timeout, idle gaps and throughput,
+  *                 bus recovery and the per-address breaker under injected faults
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <i2c_bus.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define EEPROM_ADDR         0x50                /*!< 1 字节寄存器地址 */
+#define SENSOR_ADDR         0x68
+#define MISSING_ADDR        0x33                /*!< 不存在的地址，无应答 */
+#define CHAIN_REQS          8
+#define BENCH_REQS          32
+#define BENCH_LEN           16
+
+/* Private variables ---------------------------------------------------------*/
+static struct i2c_bus       bus;
+static rt_uint8_t           eeprom[256], sensor[64];
+static rt_uint8_t           buf[256];
+
+static struct i2c_req       reqs[BENCH_REQS];
+static struct i2c_msg       msgs[BENCH_REQS][2];
+static rt_uint8_t           bufs[BENCH_REQS][2][BENCH_LEN];
+static volatile rt_uint32_t done_count, done_in_isr, done_order_ok;
+
+/* Private function ----------------------------------------------------------*/
+
+static void _fill(rt_uint8_t *p, rt_size_t len)
+{
+    rt_size_t i;
+
+    for (i = 0; i < len; i++)
+        p[i] = (rt_uint8_t)rand();
+}
+
+static double _bit_ns(void)
+{
+    return 1e9 / bus.hi2c.Init.ClockSpeed;
+}
+
+/**=============================================================================
+ * @brief           I2C1 100kHz，EEPROM 和传感器两个从机
+ *============================================================================*/
+static void _setup(void)
+{
+    TEST_EQ(i2c_bus_init(&bus, I2C1, 100000), RT_EOK);
+    TEST_EQ(bus.use_dma, 1);
+    _fill(eeprom, sizeof(eeprom));
+    _fill(sensor, sizeof(sensor));
+    sim_i2c_attach(I2C1, EEPROM_ADDR, 1, eeprom, sizeof(eeprom));
+    sim_i2c_attach(I2C1, SENSOR_ADDR, 1, sensor, sizeof(sensor));
+}
+
+/**=============================================================================
+ * @brief           寄存器读写：各种长度的中断和 DMA 路径，不带寄存器地址的
+ *                  收发，线上的数据和从机的寄存器一致
+ *============================================================================*/
+static void test_xfer(void)
+{
+    static const rt_uint16_t sizes[] = {1, 2, 3, 4, 7, 8, 9, 16, 100};
+    struct i2c_msg msg;
+    rt_size_t i;
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        _fill(buf, sizes[i]);
+        TEST_EQ(i2c_bus_write_reg(&bus, EEPROM_ADDR, (rt_uint8_t)(i * 8), buf, sizes[i]), RT_EOK);
+        TEST_MEM_EQ(eeprom + i * 8, buf, sizes[i]);
+
+        memset(buf, 0, sizes[i]);
+        TEST_EQ(i2c_bus_read_reg(&bus, SENSOR_ADDR, (rt_uint8_t)i, buf, sizes[i] < 50 ? sizes[i] : 50), RT_EOK);
+        TEST_MEM_EQ(buf, sensor + i, sizes[i] < 50 ? sizes[i] : 50);
+    }
+
+    /* 不带寄存器地址：先写指针，再从指针处连续读 */
+    buf[0] = 0x20;
+    msg = (struct i2c_msg){EEPROM_ADDR, 0, 0, I2C_MSG_WR, 1, buf};
+    TEST_EQ(i2c_bus_transfer(&bus, &msg, 1), RT_EOK);
+    msg = (struct i2c_msg){EEPROM_ADDR, 0, 0, I2C_MSG_RD, 12, buf};
+    TEST_EQ(i2c_bus_transfer(&bus, &msg, 1), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom + 0x20, 12);
+    TEST_EQ(bus.stats.errors, 0);
+}
+
+/**=============================================================================
+ * @brief           不少于 I2C_BUS_DMA_THRESHOLD 字节的消息走 DMA，DMA 完成
+ *                  中断各一次，事件中断只有起始、地址和寄存器地址阶段；短消息
+ *                  不动 DMA；DMA 之后的中断方式传输不受影响
+ *============================================================================*/
+static void test_dma_select(void)
+{
+    struct i2c_msg msg;
+    rt_uint32_t tx0, rx0, ev0;
+
+    tx0 = sim_irq_count(DMA1_Channel6_IRQn);
+    rx0 = sim_irq_count(DMA1_Channel7_IRQn);
+    ev0 = sim_irq_count(I2C1_EV_IRQn);
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 64), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom, 64);
+    TEST_EQ(sim_irq_count(DMA1_Channel7_IRQn) - rx0, 1);
+    TEST_EQ(sim_irq_count(DMA1_Channel6_IRQn) - tx0, 0);
+    printf("   64-byte DMA read: %u event interrupts\n",
+           (unsigned)(sim_irq_count(I2C1_EV_IRQn) - ev0));
+    TEST_ASSERT(sim_irq_count(I2C1_EV_IRQn) - ev0 < 24);
+
+    _fill(buf, 32);
+    TEST_EQ(i2c_bus_write_reg(&bus, EEPROM_ADDR, 0x40, buf, 32), RT_EOK);
+    TEST_MEM_EQ(eeprom + 0x40, buf, 32);
+    TEST_EQ(sim_irq_count(DMA1_Channel6_IRQn) - tx0, 1);
+
+    /* 短消息：逐字节中断，DMA 不参与 */
+    tx0 = sim_irq_count(DMA1_Channel6_IRQn);
+    rx0 = sim_irq_count(DMA1_Channel7_IRQn);
+    ev0 = sim_irq_count(I2C1_EV_IRQn);
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0x40, buf, I2C_BUS_DMA_THRESHOLD - 1), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom + 0x40, I2C_BUS_DMA_THRESHOLD - 1);
+    TEST_EQ(i2c_bus_write_reg(&bus, EEPROM_ADDR, 0x80, buf, 4), RT_EOK);
+    TEST_MEM_EQ(eeprom + 0x80, buf, 4);
+    msg = (struct i2c_msg){EEPROM_ADDR, 0, 0, I2C_MSG_RD, 4, buf};
+    TEST_EQ(i2c_bus_transfer(&bus, &msg, 1), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom + 0x84, 4);
+    msg = (struct i2c_msg){EEPROM_ADDR, 0, 0, I2C_MSG_WR, 3, buf};
+    TEST_EQ(i2c_bus_transfer(&bus, &msg, 1), RT_EOK);
+    TEST_EQ(sim_irq_count(DMA1_Channel6_IRQn) - tx0, 0);
+    TEST_EQ(sim_irq_count(DMA1_Channel7_IRQn) - rx0, 0);
+    TEST_ASSERT(sim_irq_count(I2C1_EV_IRQn) - ev0 >= I2C_BUS_DMA_THRESHOLD - 1);
+    TEST_EQ(I2C1->CR2 & I2C_CR2_DMAEN, 0);
+}
+
+static void _chain_done(struct i2c_req *req)
+{
+    rt_uint32_t index = (rt_uint32_t)(rt_ubase_t)req->user_data;
+
+    if (rt_interrupt_get_nest() > 0)
+        done_in_isr++;
+    if (index == done_count && req->result == RT_EOK)
+        done_order_ok++;
+    done_count++;
+}
+
+static void _chain_prepare(rt_uint32_t n, rt_uint16_t len)
+{
+    rt_uint32_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        msgs[i][0] = (struct i2c_msg){EEPROM_ADDR, (rt_uint16_t)(i * 4), 1, I2C_MSG_RD, len, bufs[i][0]};
+        msgs[i][1] = (struct i2c_msg){SENSOR_ADDR, (rt_uint16_t)i, 1, I2C_MSG_RD, len, bufs[i][1]};
+        memset(&reqs[i], 0, sizeof(reqs[i]));
+        reqs[i].msgs      = msgs[i];
+        reqs[i].count     = 2;
+        reqs[i].done      = _chain_done;
+        reqs[i].user_data = (void *)(rt_ubase_t)i;
+    }
+    done_count = done_in_isr = done_order_ok = 0;
+}
+
+/**=============================================================================
+ * @brief           一次提交多个请求：按顺序在中断里背靠背执行，每个请求的
+ *                  两条消息之间和请求之间都由完成回调直接启动
+ *============================================================================*/
+static void test_chain(void)
+{
+    struct i2c_bus_stats st = bus.stats;
+    rt_uint32_t i;
+
+    _chain_prepare(CHAIN_REQS, 5);
+    for (i = 0; i < CHAIN_REQS; i++)
+        TEST_EQ(i2c_bus_submit(&bus, &reqs[i]), RT_EOK);
+    TEST_EQ(reqs[CHAIN_REQS - 1].result, -RT_EBUSY);
+    while (done_count < CHAIN_REQS)
+        rt_thread_delay(1);
+
+    TEST_EQ(done_in_isr, CHAIN_REQS);
+    TEST_EQ(done_order_ok, CHAIN_REQS);
+    for (i = 0; i < CHAIN_REQS; i++)
+    {
+        TEST_MEM_EQ(bufs[i][0], eeprom + i * 4, 5);
+        TEST_MEM_EQ(bufs[i][1], sensor + i, 5);
+    }
+    TEST_EQ(bus.stats.reqs - st.reqs, CHAIN_REQS);
+    TEST_EQ(bus.stats.msgs - st.msgs, 2 * CHAIN_REQS);
+    /* 除第一条消息由提交启动外，其余都在完成中断里接上 */
+    TEST_EQ(bus.stats.chained - st.chained, 2 * CHAIN_REQS - 1);
+    TEST_EQ(bus.stats.bytes - st.bytes, 2 * CHAIN_REQS * 5);
+    TEST_EQ(bus.head, RT_NULL);
+}
+
+/**=============================================================================
+ * @brief           从机一直拉住 SCL：硬定时器在 I2C_BUS_MSG_TIMEOUT 后结束
+ *                  请求并恢复总线，之后的传输正常
+ *============================================================================*/
+static void test_timeout(void)
+{
+    struct i2c_bus_stats st = bus.stats;
+    rt_uint64_t t0, ns;
+
+    sim_i2c_fault(I2C1, SIM_I2C_FAULT_STRETCH, 0);
+    t0 = sim_time();
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 4), -RT_ETIMEOUT);
+    ns = sim_time() - t0;
+    printf("   timed out after %.1f ms\n", ns / 1e6);
+    TEST_ASSERT(ns >= SIM_MS(1000 / 20) && ns < SIM_MS(1000 / 20 + 5));
+    TEST_EQ(bus.stats.timeouts - st.timeouts, 1);
+    TEST_EQ(bus.stats.recoveries - st.recoveries, 1);
+    TEST_EQ(bus.head, RT_NULL);
+
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 4), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom, 4);
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 16), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom, 16);
+}
+
+/**=============================================================================
+ * @brief           DMA 长度的寄存器读写，从机在地址或寄存器地址字节拉住 SCL：
+ *                  提交的线程不卡在 HAL 的轮询里，照样由硬定时器超时恢复
+ *============================================================================*/
+static void test_stretch_dma(void)
+{
+    struct i2c_bus_stats st;
+    rt_uint64_t t0, ns;
+    rt_uint32_t skip;
+
+    for (skip = 0; skip < 2; skip++)
+    {
+        st = bus.stats;
+        sim_i2c_fault(I2C1, SIM_I2C_FAULT_STRETCH_AT, skip);
+        t0 = sim_time();
+        TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 16), -RT_ETIMEOUT);
+        ns = sim_time() - t0;
+        TEST_ASSERT(ns >= SIM_MS(1000 / 20 - 1) && ns < SIM_MS(1000 / 20 + 5));
+
+        _fill(buf, 16);
+        sim_i2c_fault(I2C1, SIM_I2C_FAULT_STRETCH_AT, skip);
+        TEST_EQ(i2c_bus_write_reg(&bus, EEPROM_ADDR, 0x10, buf, 16), -RT_ETIMEOUT);
+        TEST_EQ(bus.stats.timeouts - st.timeouts, 2);
+        TEST_EQ(bus.stats.recoveries - st.recoveries, 2);
+        TEST_EQ(bus.head, RT_NULL);
+
+        TEST_EQ(i2c_bus_write_reg(&bus, EEPROM_ADDR, 0x10, buf, 16), RT_EOK);
+        TEST_MEM_EQ(eeprom + 0x10, buf, 16);
+        TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 16), RT_EOK);
+        TEST_MEM_EQ(buf, eeprom, 16);
+    }
+}
+
+/**=============================================================================
+ * @brief           请求之间 BUSY 被锁住：完成中断接上下一个请求前发现并恢复，
+ *                  不让 HAL 空等 25ms 后失败
+ *============================================================================*/
+static void test_busy_chained(void)
+{
+    struct i2c_bus_stats st = bus.stats;
+    rt_uint64_t t0, ns;
+
+    _chain_prepare(2, BENCH_LEN);
+    reqs[0].count = reqs[1].count = 1;
+    t0 = sim_time();
+    TEST_EQ(i2c_bus_submit(&bus, &reqs[0]), RT_EOK);
+    TEST_EQ(i2c_bus_submit(&bus, &reqs[1]), RT_EOK);
+    sim_i2c_fault(I2C1, SIM_I2C_FAULT_BUSY, 0);
+    while (done_count < 2)
+        rt_thread_delay(1);
+    ns = sim_time() - t0;
+
+    TEST_EQ(done_order_ok, 2);
+    TEST_MEM_EQ(bufs[1][0], eeprom + 4, BENCH_LEN);
+    TEST_EQ(bus.stats.recoveries - st.recoveries, 1);
+    TEST_EQ(bus.stats.chained - st.chained, 1);
+    TEST_ASSERT(ns < SIM_MS(10));
+}
+
+/**=============================================================================
+ * @brief           不是 i2c_bus_init 登记的句柄的 HAL 回调被忽略：进行中的
+ *                  请求不被提前结束，外来句柄不被改写，请求照常完成
+ *============================================================================*/
+static void test_foreign(void)
+{
+    struct i2c_bus_stats st = bus.stats;
+    I2C_HandleTypeDef other = {0}, copy;
+    rt_base_t level;
+
+    other.Instance  = I2C2;
+    other.ErrorCode = HAL_I2C_ERROR_AF;
+    copy = other;
+
+    _chain_prepare(1, BENCH_LEN);
+    level = rt_hw_interrupt_disable();
+    TEST_EQ(i2c_bus_submit(&bus, &reqs[0]), RT_EOK);
+    HAL_I2C_MasterTxCpltCallback(&other);
+    HAL_I2C_MasterRxCpltCallback(&other);
+    HAL_I2C_MemTxCpltCallback(&other);
+    HAL_I2C_MemRxCpltCallback(&other);
+    HAL_I2C_ErrorCallback(&other);
+    HAL_I2C_AbortCpltCallback(&other);
+    rt_hw_interrupt_enable(level);
+
+    TEST_EQ(done_count, 0);
+    TEST_EQ(bus.stats.msgs - st.msgs, 1);
+    TEST_ASSERT(bus.head == &reqs[0]);
+    TEST_EQ(reqs[0].index, 0);
+    TEST_MEM_EQ(&other, &copy, sizeof(other));
+
+    while (done_count < 1)
+        rt_thread_delay(1);
+    TEST_EQ(done_order_ok, 1);
+    TEST_MEM_EQ(bufs[0][0], eeprom, BENCH_LEN);
+    TEST_MEM_EQ(bufs[0][1], sensor, BENCH_LEN);
+    TEST_EQ(bus.stats.msgs - st.msgs, 2);
+}
+
+/**=============================================================================
+ * @brief           32 个 16 字节的 DMA 读请求一次提交：统计停止到下一个起始的
+ *                  空闲间隔，和背靠背时的线上时间比较
+ *============================================================================*/
+static void test_bench(void)
+{
+    struct sim_i2c_stats st;
+    rt_uint64_t t0, ns, bits;
+    rt_uint32_t i;
+
+    _chain_prepare(BENCH_REQS, BENCH_LEN);
+    for (i = 0; i < BENCH_REQS; i++)
+        reqs[i].count = 1;
+
+    /* 完成回调在 STOP 发出时就来了，等上一个测试的 STOP 结束再开始统计 */
+    rt_thread_delay(1);
+    sim_i2c_stats(I2C1, &st, 1);
+    t0 = sim_time();
+    for (i = 0; i < BENCH_REQS; i++)
+        TEST_EQ(i2c_bus_submit(&bus, &reqs[i]), RT_EOK);
+    while (done_count < BENCH_REQS)
+        rt_thread_delay(1);
+    ns = sim_time() - t0;
+    sim_i2c_stats(I2C1, &st, 1);
+    TEST_EQ(done_order_ok, BENCH_REQS);
+
+    /* 每个请求：起始、地址、寄存器、重复起始、地址、数据、停止 */
+    bits = BENCH_REQS * (1 + 9 + 9 + 1 + 9 + BENCH_LEN * 9 + 1);
+    printf("   %u reads of %u bytes in %.1f us, back-to-back %.1f us, %.0f bytes/s\n",
+           BENCH_REQS, BENCH_LEN, ns / 1e3, bits * _bit_ns() / 1e3,
+           BENCH_REQS * BENCH_LEN / (ns * 1e-9));
+    printf("   %u idle gaps: mean %.1f us, max %.1f us (SCL period %.1f us)\n",
+           (unsigned)st.gaps, st.gaps ? st.gap_sum_ns / 1e3 / st.gaps : 0.0,
+           st.gap_max_ns / 1e3, _bit_ns() / 1e3);
+    TEST_EQ(st.starts, 2 * BENCH_REQS);
+    TEST_EQ(st.gaps, BENCH_REQS - 1);
+    TEST_ASSERT(st.gap_max_ns < 3 * _bit_ns());
+    TEST_ASSERT(ns < bits * _bit_ns() * 1.1);
+}
+
+/**=============================================================================
+ * @brief           BUSY 锁住：提交时发现后立即恢复，SDA 为高不需要时钟，STOP
+ *                  之后 SWRST 复位，不等 HAL 的 25ms 超时
+ *============================================================================*/
+static void test_busy_stuck(void)
+{
+    struct i2c_bus_stats st = bus.stats;
+    struct sim_i2c_stats ss;
+    rt_uint64_t t0, ns;
+
+    sim_i2c_stats(I2C1, &ss, 1);
+    sim_i2c_fault(I2C1, SIM_I2C_FAULT_BUSY, 0);
+    TEST_ASSERT(I2C1->SR2 & I2C_SR2_BUSY);
+
+    t0 = sim_time();
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 4), RT_EOK);
+    ns = sim_time() - t0;
+    TEST_MEM_EQ(buf, eeprom, 4);
+    sim_i2c_stats(I2C1, &ss, 1);
+    printf("   recovered and read in %.1f us\n", ns / 1e3);
+    TEST_EQ(bus.stats.recoveries - st.recoveries, 1);
+    TEST_EQ(ss.scl_pulses, 1);                  /* 只有 STOP 的时钟 */
+    TEST_EQ(ss.gpio_stops, 1);
+    TEST_EQ(ss.resets, 1);
+    TEST_ASSERT(ns < SIM_MS(1));
+    TEST_EQ(bus.stats.errors, st.errors);
+}
+
+/**=============================================================================
+ * @brief           从机拉住 SDA：手动时钟直到 SDA 放开，最多 9 个，然后 STOP
+ *                  和复位；9 个时钟放不开时本次失败，下一次提交再恢复
+ *============================================================================*/
+static void test_sda_low(void)
+{
+    static const rt_uint32_t holds[] = {1, 5, 9};
+    struct i2c_bus_stats st;
+    struct sim_i2c_stats ss;
+    rt_size_t i;
+
+    for (i = 0; i < sizeof(holds) / sizeof(holds[0]); i++)
+    {
+        st = bus.stats;
+        sim_i2c_stats(I2C1, &ss, 1);
+        sim_i2c_fault(I2C1, SIM_I2C_FAULT_SDA_LOW, holds[i]);
+        TEST_ASSERT(I2C1->SR2 & I2C_SR2_BUSY);
+        TEST_EQ(GPIOB->IDR & GPIO_PIN_7, 0);
+
+        TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0x10, buf, 4), RT_EOK);
+        TEST_MEM_EQ(buf, eeprom + 0x10, 4);
+        sim_i2c_stats(I2C1, &ss, 1);
+        TEST_EQ(ss.scl_pulses, holds[i] + 1);
+        TEST_EQ(ss.gpio_stops, 1);
+        TEST_EQ(ss.resets, 1);
+        TEST_EQ(bus.stats.recoveries - st.recoveries, 1);
+    }
+
+    /* 12 个时钟才放开：9 个时钟加 STOP 的一个时钟后仍被拉住 */
+    st = bus.stats;
+    sim_i2c_stats(I2C1, &ss, 1);
+    sim_i2c_fault(I2C1, SIM_I2C_FAULT_SDA_LOW, 12);
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 4), -RT_EIO);
+    sim_i2c_stats(I2C1, &ss, 0);
+    TEST_EQ(ss.scl_pulses, 9 + 1);
+    TEST_EQ(ss.gpio_stops, 0);
+    TEST_EQ(bus.stats.recoveries - st.recoveries, 1);
+
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 4), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom, 4);
+    sim_i2c_stats(I2C1, &ss, 1);
+    TEST_EQ(ss.scl_pulses, 9 + 1 + 2 + 1);
+    TEST_EQ(ss.gpio_stops, 1);
+    TEST_EQ(bus.stats.recoveries - st.recoveries, 2);
+}
+
+/**=============================================================================
+ * @brief           仲裁丢失：请求以 -RT_ERROR 结束并恢复总线，不计入熔断，
+ *                  对方释放总线后正常传输
+ *============================================================================*/
+static void test_arlo(void)
+{
+    struct i2c_bus_stats st = bus.stats;
+    struct sim_i2c_stats ss;
+
+    sim_i2c_stats(I2C1, &ss, 1);
+    sim_i2c_fault(I2C1, SIM_I2C_FAULT_ARLO, 50);
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 4), -RT_ERROR);
+    sim_i2c_stats(I2C1, &ss, 1);
+    TEST_EQ(bus.stats.recoveries - st.recoveries, 1);
+    TEST_EQ(bus.stats.errors - st.errors, 1);
+    TEST_EQ(ss.resets, 1);
+
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 4), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom, 4);
+    TEST_EQ(bus.stats.recoveries - st.recoveries, 1);
+    TEST_EQ(bus.stats.trips, st.trips);
+}
+
+/**=============================================================================
+ * @brief           地址连续无应答：中断和 DMA 两种方式都计数，第 3 次熔断，
+ *                  冷却期内直接拒绝不占总线，冷却结束放行一次试探，失败立即
+ *                  再断开，成功则恢复；无应答不需要总线恢复
+ *============================================================================*/
+static void test_breaker(void)
+{
+    struct i2c_bus_stats st = bus.stats;
+    struct sim_i2c_stats ss;
+    int i;
+
+    for (i = 0; i < I2C_BUS_BREAKER_FAILS; i++)
+    {
+        TEST_EQ(bus.stats.trips, st.trips);
+        TEST_EQ(i2c_bus_read_reg(&bus, MISSING_ADDR, 0, buf, i == 1 ? 16 : 4), -RT_EIO);
+    }
+    TEST_EQ(bus.stats.trips - st.trips, 1);
+    TEST_EQ(bus.stats.recoveries, st.recoveries);
+
+    /* 冷却期内：直接拒绝，总线上什么也没有；其他设备和 DMA 不受影响 */
+    sim_i2c_stats(I2C1, &ss, 1);
+    TEST_EQ(i2c_bus_read_reg(&bus, MISSING_ADDR, 0, buf, 4), -RT_EBUSY);
+    TEST_EQ(bus.stats.fast_fails - st.fast_fails, 1);
+    sim_i2c_stats(I2C1, &ss, 1);
+    TEST_EQ(ss.starts, 0);
+    TEST_EQ(i2c_bus_read_reg(&bus, EEPROM_ADDR, 0, buf, 16), RT_EOK);
+    TEST_MEM_EQ(buf, eeprom, 16);
+    rt_thread_delay(I2C_BUS_BREAKER_COOLDOWN / 2);
+    TEST_EQ(i2c_bus_read_reg(&bus, MISSING_ADDR, 0, buf, 4), -RT_EBUSY);
+
+    /* 冷却结束：试探一次失败，立即再断开 */
+    rt_thread_delay(I2C_BUS_BREAKER_COOLDOWN - I2C_BUS_BREAKER_COOLDOWN / 2);
+    TEST_EQ(i2c_bus_read_reg(&bus, MISSING_ADDR, 0, buf, 4), -RT_EIO);
+    TEST_EQ(bus.stats.trips - st.trips, 2);
+    TEST_EQ(i2c_bus_read_reg(&bus, MISSING_ADDR, 0, buf, 4), -RT_EBUSY);
+
+    /* 设备恢复：下一次试探成功，之后正常访问 */
+    sim_i2c_attach(I2C1, MISSING_ADDR, 1, sensor, sizeof(sensor));
+    rt_thread_delay(I2C_BUS_BREAKER_COOLDOWN);
+    TEST_EQ(i2c_bus_read_reg(&bus, MISSING_ADDR, 0, buf, 4), RT_EOK);
+    TEST_MEM_EQ(buf, sensor, 4);
+    TEST_EQ(i2c_bus_read_reg(&bus, MISSING_ADDR, 4, buf, 16), RT_EOK);
+    TEST_MEM_EQ(buf, sensor + 4, 16);
+    TEST_EQ(bus.stats.trips - st.trips, 2);
+    TEST_EQ(bus.stats.fast_fails - st.fast_fails, 3);
+    TEST_EQ(bus.stats.recoveries, st.recoveries);
+    sim_i2c_detach(I2C1, MISSING_ADDR);
+}
+
+static void test_main(void)
+{
+    _setup();
+    TEST_CASE(test_xfer);
+    TEST_CASE(test_dma_select);
+    TEST_CASE(test_chain);
+    TEST_CASE(test_timeout);
+    TEST_CASE(test_stretch_dma);
+    TEST_CASE(test_bench);
+    TEST_CASE(test_busy_stuck);
+    TEST_CASE(test_busy_chained);
+    TEST_CASE(test_foreign);
+    TEST_CASE(test_sda_low);
+    TEST_CASE(test_arlo);
+    TEST_CASE(test_breaker);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
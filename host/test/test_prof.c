@@ -0,0 +1,246 @@
+/**
+  ******************************************************************************
+  * @file			test_prof.c
+  * @brief			prof: statistics against a sorted reference, interrupt hooks,
+  *                 host-clock probes around driver code
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <ringbuffer.h>
+#include <prof.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SAMPLES             20000
+#define SPIN_US             200u
+#define PROBE_RB            (PROF_ID_USER + 0)
+#define PROBE_GPIO          (PROF_ID_USER + 1)
+#define PROBE_SPIN          (PROF_ID_USER + 2)
+#define PROBE_ISR           (PROF_ID_USER + 3)
+
+/* Private variables ---------------------------------------------------------*/
+static rt_uint32_t          samples[SAMPLES];
+static volatile rt_uint32_t isr_records;
+
+/* Private function ----------------------------------------------------------*/
+
+static int _cmp_u32(const void *a, const void *b)
+{
+    rt_uint32_t x = *(const rt_uint32_t *)a, y = *(const rt_uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static void _spin_host_us(rt_uint32_t us)
+{
+    struct timespec t0, t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do
+    {
+        clock_gettime(CLOCK_MONOTONIC, &t);
+    } while ((t.tv_sec - t0.tv_sec) * 1000000000L + (t.tv_nsec - t0.tv_nsec) < (long)us * 1000L);
+}
+
+/* 随机时刻进入的中断，与线程同时记录同一个探针 */
+void EXTI0_IRQHandler(void)
+{
+    rt_interrupt_enter();
+    prof_record(PROBE_ISR, 100u);
+    isr_records++;
+    rt_interrupt_leave();
+}
+
+/**=============================================================================
+ * @brief           已知分布：count/min/max/avg 精确，p99 是包含真实 p99 的
+ *                  log2 分桶的上界
+ *============================================================================*/
+static void test_stats(void)
+{
+    struct prof_stats st;
+    rt_uint64_t sum = 0;
+    rt_uint32_t ref_p99, i;
+    int round;
+
+    TEST_EQ(prof_get_stats(PROF_ID_NUM, &st), -RT_EINVAL);
+    prof_reset();
+    TEST_EQ(prof_get_stats(PROBE_RB, &st), -RT_EEMPTY);
+
+    srand(13);
+    for (round = 0; round < 4; round++)
+    {
+        prof_reset();
+        sum = 0;
+        for (i = 0; i < SAMPLES; i++)
+        {
+            /* 对数均匀分布加上少量长尾，最后一轮的长尾落在不封顶的最后一桶 */
+            samples[i] = ((rt_uint32_t)rand() & 0x7FFFFFu) >> (rand() % 23);
+            if (rand() % 50 == 0)
+                samples[i] = round == 3 ? 0x80000000u + (rt_uint32_t)rand() : 0x400000u + (rand() & 0x3FFFFFu);
+            if (round == 0)
+                samples[i] = 1000u;
+            prof_record(PROBE_RB, samples[i]);
+            sum += samples[i];
+        }
+        qsort(samples, SAMPLES, sizeof(samples[0]), _cmp_u32);
+        ref_p99 = samples[SAMPLES - SAMPLES / 100 - 1];
+
+        TEST_EQ(prof_get_stats(PROBE_RB, &st), RT_EOK);
+        TEST_EQ(st.count, SAMPLES);
+        TEST_EQ(st.min, samples[0]);
+        TEST_EQ(st.max, samples[SAMPLES - 1]);
+        TEST_EQ(st.avg, (rt_uint32_t)(sum / SAMPLES));
+        TEST_ASSERT(st.p99 >= ref_p99);
+        TEST_ASSERT(st.p99 <= st.max);
+        if (ref_p99 >= 1u << (PROF_HIST_BUCKETS - 1))
+            TEST_EQ(st.p99, st.max);
+        else
+            TEST_ASSERT(st.p99 / 2u <= ref_p99);
+        printf("   round %d: min %u avg %u max %u p99 %u (exact %u)\n", round,
+               st.min, st.avg, st.max, st.p99, ref_p99);
+    }
+}
+
+/**=============================================================================
+ * @brief           主机时钟：探针包住 200us 忙等，按 SystemCoreClock 折算
+ *============================================================================*/
+static void test_probe_clock(void)
+{
+    struct prof_stats st;
+    rt_uint32_t expect = SPIN_US * (SystemCoreClock / 1000000u);
+    int i;
+
+    prof_reset();
+    for (i = 0; i < 20; i++)
+    {
+        PROF_BEGIN(PROBE_SPIN);
+        _spin_host_us(SPIN_US);
+        PROF_END(PROBE_SPIN);
+    }
+    TEST_EQ(prof_get_stats(PROBE_SPIN, &st), RT_EOK);
+    printf("   %u us spin: min %u cycles, expected %u at %u Hz\n",
+           SPIN_US, st.min, expect, (unsigned)SystemCoreClock);
+    TEST_EQ(st.count, 20);
+    TEST_ASSERT(st.min >= expect);
+    TEST_ASSERT(st.min < expect * 2u);
+}
+
+/**=============================================================================
+ * @brief           中断钩子：SysTick 和 USART1 各自计数，时间非零
+ *============================================================================*/
+static void test_isr_hooks(void)
+{
+    struct prof_stats st;
+    rt_tick_t tick;
+    int i;
+
+    prof_reset();
+    tick = rt_tick_get();
+    rt_thread_mdelay(50);
+    tick = rt_tick_get() - tick;
+    TEST_EQ(prof_get_stats(PROF_ID_ISR_SYSTICK, &st), RT_EOK);
+    printf("   systick: %u entries over %u ticks, avg %u max %u cycles\n",
+           st.count, (unsigned)tick, st.avg, st.max);
+    TEST_ASSERT(st.count >= tick - 1 && st.count <= tick + 1);
+    TEST_ASSERT(st.max > 0);
+
+    for (i = 0; i < 8; i++)
+    {
+        sim_uart_inject(USART1, "\r", 1);
+        rt_thread_mdelay(2);
+    }
+    TEST_EQ(prof_get_stats(PROF_ID_ISR_USART1, &st), RT_EOK);
+    printf("   usart1: %u entries, avg %u max %u cycles\n", st.count, st.avg, st.max);
+    TEST_ASSERT(st.count >= 8);
+}
+
+/**=============================================================================
+ * @brief           线程和随机时刻的中断同时记录同一个探针，计数不丢
+ *============================================================================*/
+static void test_concurrent(void)
+{
+    struct prof_stats st;
+    rt_uint32_t i, n;
+    time_t t0;
+
+    prof_reset();
+    isr_records = 0;
+    HAL_NVIC_SetPriority(EXTI0_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+    sim_preempt_random(5, EXTI0_IRQn);
+    t0 = time(NULL);
+    for (i = 0; isr_records < 50 && time(NULL) - t0 < 5; )
+    {
+        for (n = 0; n < 10000; n++, i++)
+            prof_record(PROBE_ISR, 10u);
+    }
+    sim_preempt_random(0, EXTI0_IRQn);
+    HAL_NVIC_DisableIRQ(EXTI0_IRQn);
+
+    TEST_EQ(prof_get_stats(PROBE_ISR, &st), RT_EOK);
+    printf("   %u thread + %u interrupt records\n", (unsigned)i, (unsigned)isr_records);
+    TEST_ASSERT(isr_records > 0);
+    TEST_EQ(st.count, i + isr_records);
+    TEST_EQ(st.min, 10);
+    TEST_EQ(st.max, 100);
+    TEST_EQ(prof_get_stats(PROF_ID_ISR_OTHER, &st), RT_EOK);
+    TEST_EQ(st.count, isr_records);
+}
+
+/**=============================================================================
+ * @brief           在主机上用同一组探针比较纯软件代码和寄存器访问的开销
+ *============================================================================*/
+static void test_bench(void)
+{
+    static rt_uint8_t pool[256], data[64];
+    struct rt_ringbuffer rb;
+    struct prof_stats st_rb, st_gpio;
+    int i;
+
+    prof_reset();
+    rt_ringbuffer_init(&rb, pool, sizeof(pool));
+    __HAL_RCC_GPIOC_CLK_ENABLE();
+    for (i = 0; i < 2000; i++)
+    {
+        PROF_BEGIN(PROBE_RB);
+        rt_ringbuffer_put(&rb, data, sizeof(data));
+        rt_ringbuffer_get(&rb, data, sizeof(data));
+        PROF_END(PROBE_RB);
+
+        PROF_BEGIN(PROBE_GPIO);
+        HAL_GPIO_WritePin(GPIOC, GPIO_PIN_13, (GPIO_PinState)(i & 1));
+        PROF_END(PROBE_GPIO);
+    }
+    TEST_EQ(prof_get_stats(PROBE_RB, &st_rb), RT_EOK);
+    TEST_EQ(prof_get_stats(PROBE_GPIO, &st_gpio), RT_EOK);
+    printf("   ringbuffer 64B put+get: min %u avg %u p99 %u cycles\n", st_rb.min, st_rb.avg, st_rb.p99);
+    printf("   HAL_GPIO_WritePin (trapped): min %u avg %u p99 %u cycles\n",
+           st_gpio.min, st_gpio.avg, st_gpio.p99);
+    TEST_EQ(st_rb.count, 2000);
+    TEST_EQ(st_gpio.count, 2000);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_stats);
+    TEST_CASE(test_probe_clock);
+    TEST_CASE(test_isr_hooks);
+    TEST_CASE(test_concurrent);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
@@ -0,0 +1,332 @@
+/**
+  ******************************************************************************
+  * @file			test_ringbuffer.c
+  * @brief			rt_ringbuffer: model check, SPSC with ISR consumer, benchmark
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rtthread.h>
+#include <ringbuffer.h>
+#include "stm32f1xx_hal.h"
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define MODEL_ROUNDS        200000
+#define SPSC_BYTES          200000
+#define BENCH_BYTES         (16u * 1024u * 1024u)
+
+/* Private typedef -----------------------------------------------------------*/
+/* 原 console.c 中的实现：15 位位域索引加镜像位，只有单字符操作 */
+struct legacy_ringbuffer
+{
+    rt_uint8_t *buffer_ptr;
+
+    rt_uint16_t read_mirror : 1;
+    rt_uint16_t read_index : 15;
+    rt_uint16_t write_mirror : 1;
+    rt_uint16_t write_index : 15;
+
+    rt_int16_t buffer_size;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static rt_uint8_t           pool[1024];
+static rt_uint8_t           model[1024];
+static struct rt_ringbuffer spsc_rb;
+static rt_uint8_t           spsc_pool[64];
+static volatile rt_uint32_t spsc_next;
+static volatile rt_uint32_t spsc_errors;
+static rt_uint8_t           bench_buf[256];
+
+/* Private function ----------------------------------------------------------*/
+
+static rt_size_t legacy_data_len(struct legacy_ringbuffer *rb)
+{
+    if (rb->read_index == rb->write_index)
+        return rb->read_mirror == rb->write_mirror ? 0 : rb->buffer_size;
+    if (rb->write_index > rb->read_index)
+        return rb->write_index - rb->read_index;
+    return rb->buffer_size - (rb->read_index - rb->write_index);
+}
+
+static rt_size_t legacy_putchar(struct legacy_ringbuffer *rb, rt_uint8_t ch)
+{
+    if (rb->buffer_size - legacy_data_len(rb) == 0)
+        return 0;
+    rb->buffer_ptr[rb->write_index] = ch;
+    if (rb->write_index == rb->buffer_size - 1)
+    {
+        rb->write_mirror = ~rb->write_mirror;
+        rb->write_index = 0;
+    }
+    else
+    {
+        rb->write_index++;
+    }
+    return 1;
+}
+
+static rt_size_t legacy_getchar(struct legacy_ringbuffer *rb, rt_uint8_t *ch)
+{
+    if (legacy_data_len(rb) == 0)
+        return 0;
+    *ch = rb->buffer_ptr[rb->read_index];
+    if (rb->read_index == rb->buffer_size - 1)
+    {
+        rb->read_mirror = ~rb->read_mirror;
+        rb->read_index = 0;
+    }
+    else
+    {
+        rb->read_index++;
+    }
+    return 1;
+}
+
+static double _now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**=============================================================================
+ * @brief           大小向下取整到 2 的幂
+ *============================================================================*/
+static void test_init(void)
+{
+    struct rt_ringbuffer rb;
+
+    rt_ringbuffer_init(&rb, pool, 1000);
+    TEST_EQ(rt_ringbuffer_get_size(&rb), 512);
+    rt_ringbuffer_init(&rb, pool, 256);
+    TEST_EQ(rt_ringbuffer_get_size(&rb), 256);
+    TEST_EQ(rt_ringbuffer_data_len(&rb), 0);
+    TEST_EQ(rt_ringbuffer_space_len(&rb), 256);
+}
+
+/**=============================================================================
+ * @brief           随机操作序列与参考队列逐步比较，索引从 32 位回绕点附近开始
+ *============================================================================*/
+static void test_model(void)
+{
+    struct rt_ringbuffer rb;
+    rt_uint8_t in[300], out[300], *ptr;
+    rt_size_t head = 0, len = 0, size = 0, n, want, i;
+    rt_uint8_t seq = 0;
+    int round;
+
+    srand(1);
+    for (round = 0; round < MODEL_ROUNDS; round++)
+    {
+        if (round % 20000 == 0)
+        {
+            size = 1u << (rand() % 9 + 1);
+            rt_ringbuffer_init(&rb, pool, size);
+            rb.read_index = rb.write_index = 0xFFFFFF00u + (rand() & 0xFF);
+            /* 参考队列与缓冲按相同的物理位置存放 */
+            head = rb.read_index & (size - 1);
+            len = 0;
+        }
+
+        want = rand() % 300;
+        switch (rand() % 6)
+        {
+        case 0:                                 /* put */
+            for (i = 0; i < want; i++)
+                in[i] = seq + i;
+            n = rt_ringbuffer_put(&rb, in, want);
+            TEST_EQ(n, want < size - len ? want : size - len);
+            for (i = 0; i < n; i++)
+                model[(head + len + i) % size] = in[i];
+            seq += n;
+            len += n;
+            break;
+        case 1:                                 /* putchar */
+            n = rt_ringbuffer_putchar(&rb, seq);
+            TEST_EQ(n, len < size);
+            if (n)
+                model[(head + len++) % size] = seq++;
+            break;
+        case 2:                                 /* reserve + commit */
+            n = rt_ringbuffer_put_reserve(&rb, &ptr);
+            TEST_ASSERT(n <= size - len);
+            TEST_ASSERT(n == 0 || ptr == &pool[(rb.write_index) & (size - 1)]);
+            if (want < n)
+                n = want;
+            for (i = 0; i < n; i++)
+                model[(head + len + i) % size] = ptr[i] = seq++;
+            rt_ringbuffer_put_commit(&rb, n);
+            len += n;
+            break;
+        case 3:                                 /* get */
+            n = rt_ringbuffer_get(&rb, out, want);
+            TEST_EQ(n, want < len ? want : len);
+            for (i = 0; i < n; i++)
+                TEST_EQ(out[i], model[(head + i) % size]);
+            head = (head + n) % size;
+            len -= n;
+            break;
+        case 4:                                 /* getchar */
+            n = rt_ringbuffer_getchar(&rb, out);
+            TEST_EQ(n, len > 0);
+            if (n)
+            {
+                TEST_EQ(out[0], model[head]);
+                head = (head + 1) % size;
+                len--;
+            }
+            break;
+        default:                                /* peek + skip */
+            n = rt_ringbuffer_peek(&rb, &ptr);
+            TEST_ASSERT(n <= len && (len == 0 || n > 0));
+            TEST_ASSERT(n == len || head + n == size);
+            for (i = 0; i < n; i++)
+                TEST_EQ(ptr[i], model[(head + i) % size]);
+            n = rt_ringbuffer_skip(&rb, want);
+            TEST_EQ(n, want < len ? want : len);
+            head = (head + n) % size;
+            len -= n;
+            break;
+        }
+        TEST_EQ(rt_ringbuffer_data_len(&rb), len);
+        if (sim_host_exit_code() != 0)
+            return;
+    }
+}
+
+/* 消费者在中断中，随机时刻打断生产者 */
+void EXTI0_IRQHandler(void)
+{
+    rt_uint8_t buf[16];
+    rt_size_t n, i;
+
+    n = rt_ringbuffer_get(&spsc_rb, buf, rand() % sizeof(buf) + 1);
+    for (i = 0; i < n; i++)
+    {
+        if (buf[i] != (rt_uint8_t)spsc_next)
+            spsc_errors++;
+        spsc_next++;
+    }
+}
+
+/**=============================================================================
+ * @brief           线程生产、中断消费，不关中断也不丢不乱
+ *============================================================================*/
+static void test_spsc_isr(void)
+{
+    rt_uint8_t buf[24];
+    rt_uint32_t sent = 0;
+    rt_size_t n, i;
+
+    rt_ringbuffer_init(&spsc_rb, spsc_pool, sizeof(spsc_pool));
+    spsc_next = spsc_errors = 0;
+    HAL_NVIC_SetPriority(EXTI0_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+    sim_preempt_random(5, EXTI0_IRQn);
+
+    while (sent < SPSC_BYTES)
+    {
+        n = rand() % sizeof(buf) + 1;
+        if (n > SPSC_BYTES - sent)
+            n = SPSC_BYTES - sent;
+        for (i = 0; i < n; i++)
+            buf[i] = (rt_uint8_t)(sent + i);
+        if (rand() & 1)
+        {
+            n = rt_ringbuffer_put(&spsc_rb, buf, n);
+        }
+        else
+        {
+            rt_uint8_t *ptr;
+            rt_size_t room = rt_ringbuffer_put_reserve(&spsc_rb, &ptr);
+
+            if (n > room)
+                n = room;
+            memcpy(ptr, buf, n);
+            rt_ringbuffer_put_commit(&spsc_rb, n);
+        }
+        sent += n;
+        if (n == 0)
+            NVIC_SetPendingIRQ(EXTI0_IRQn);
+    }
+    while (rt_ringbuffer_data_len(&spsc_rb))
+        NVIC_SetPendingIRQ(EXTI0_IRQn);
+
+    sim_preempt_random(0, EXTI0_IRQn);
+    HAL_NVIC_DisableIRQ(EXTI0_IRQn);
+    TEST_EQ(spsc_next, SPSC_BYTES);
+    TEST_EQ(spsc_errors, 0);
+}
+
+/**=============================================================================
+ * @brief           吞吐量：原单字符实现与新实现的单字符、整块操作
+ *
+ * @note            主机时钟受共享机器负载影响，只打印不作为通过条件
+ *============================================================================*/
+static void test_bench(void)
+{
+    struct legacy_ringbuffer lrb = {pool, 0, 0, 0, 0, 512};
+    struct rt_ringbuffer rb;
+    rt_uint32_t done, sum = 0;
+    double t, legacy, bytewise, bulk;
+    rt_uint8_t ch;
+    int i;
+
+    t = _now();
+    for (done = 0; done < BENCH_BYTES; done += 256)
+    {
+        for (i = 0; i < 256; i++)
+            legacy_putchar(&lrb, (rt_uint8_t)i);
+        for (i = 0; i < 256; i++)
+            sum += legacy_getchar(&lrb, &ch) + ch;
+    }
+    legacy = BENCH_BYTES / (_now() - t);
+
+    rt_ringbuffer_init(&rb, pool, 512);
+    t = _now();
+    for (done = 0; done < BENCH_BYTES; done += 256)
+    {
+        for (i = 0; i < 256; i++)
+            rt_ringbuffer_putchar(&rb, (rt_uint8_t)i);
+        for (i = 0; i < 256; i++)
+            sum += rt_ringbuffer_getchar(&rb, &ch) + ch;
+    }
+    bytewise = BENCH_BYTES / (_now() - t);
+
+    t = _now();
+    for (done = 0; done < BENCH_BYTES; done += 256)
+    {
+        rt_ringbuffer_put(&rb, bench_buf, 256);
+        sum += rt_ringbuffer_get(&rb, bench_buf, 256);
+    }
+    bulk = BENCH_BYTES / (_now() - t);
+
+    printf("   legacy putchar/getchar %8.1f MB/s\n", legacy / 1e6);
+    printf("   putchar/getchar        %8.1f MB/s\n", bytewise / 1e6);
+    printf("   put/get 256 bytes      %8.1f MB/s (%.1fx legacy)\n", bulk / 1e6, bulk / legacy);
+    TEST_ASSERT(sum != 0);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_init);
+    TEST_CASE(test_model);
+    TEST_CASE(test_spsc_isr);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BARE);
+}
@@ -0,0 +1,279 @@
+/**
+  ******************************************************************************
+  * @file			test_rtc.c
+  * @brief			HAL RTC calendar: closed-form date update against the old loop
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rtthread.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define DAYS_2000_2099      36525u              /*!< 2000-01-01 至 2099-12-31 */
+#define TIME_OF_DAY         3661u               /*!< 01:01:01 */
+#define BENCH_ROUNDS        200
+#define START_STRIDE        5u                  /*!< 与星期错开，起点覆盖每个星期几 */
+#define BENCH_DAYS          (30u * 365u + 7u)
+
+/* Private typedef -----------------------------------------------------------*/
+struct ref_date
+{
+    uint32_t    year;                           /*!< 与 RTC_DateTypeDef 相同，相对 2000 */
+    uint32_t    month;
+    uint32_t    day;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static RTC_HandleTypeDef hrtc;
+
+/* Private function ----------------------------------------------------------*/
+
+/**=============================================================================
+ * @brief           原 HAL 的 RTC_IsLeapYear
+ *============================================================================*/
+static int _ref_is_leap(uint32_t year)
+{
+    if ((year % 4U) != 0U)
+        return 0;
+    if ((year % 100U) != 0U)
+        return 1;
+    return (year % 400U) == 0U;
+}
+
+/**=============================================================================
+ * @brief           原 HAL 的 RTC_DateUpdate：逐日递推
+ *============================================================================*/
+static void _ref_date_update(struct ref_date *d, uint32_t elapsed)
+{
+    uint32_t loop;
+
+    for (loop = 0U; loop < elapsed; loop++)
+    {
+        if (d->month == 1U || d->month == 3U || d->month == 5U || d->month == 7U ||
+            d->month == 8U || d->month == 10U || d->month == 12U)
+        {
+            if (d->day < 31U)
+                d->day++;
+            else if (d->month != 12U)
+            {
+                d->month++;
+                d->day = 1U;
+            }
+            else
+            {
+                d->month = 1U;
+                d->day = 1U;
+                d->year++;
+            }
+        }
+        else if (d->month == 4U || d->month == 6U || d->month == 9U || d->month == 11U)
+        {
+            if (d->day < 30U)
+                d->day++;
+            else
+            {
+                d->month++;
+                d->day = 1U;
+            }
+        }
+        else if (d->month == 2U)
+        {
+            if (d->day < 28U)
+                d->day++;
+            else if (d->day == 28U && _ref_is_leap(d->year))
+                d->day++;
+            else
+            {
+                d->month++;
+                d->day = 1U;
+            }
+        }
+    }
+}
+
+/**=============================================================================
+ * @brief           原 HAL 的 RTC_WeekDayNum
+ *============================================================================*/
+static uint32_t _ref_weekday(const struct ref_date *d)
+{
+    uint32_t year = 2000U + d->year;
+
+    if (d->month < 3U)
+        return (((23U * d->month) / 9U) + d->day + 4U + year + ((year - 1U) / 4U) -
+                ((year - 1U) / 100U) + ((year - 1U) / 400U)) % 7U;
+
+    return (((23U * d->month) / 9U) + d->day + 4U + year + (year / 4U) - (year / 100U) +
+            (year / 400U) - 2U) % 7U;
+}
+
+static double _now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _set_date(const struct ref_date *d)
+{
+    RTC_DateTypeDef date;
+
+    date.Year  = d->year;
+    date.Month = d->month;
+    date.Date  = d->day;
+    sim_rtc_set_counter(0);
+    TEST_EQ(HAL_RTC_SetDate(&hrtc, &date, RTC_FORMAT_BIN), HAL_OK);
+    TEST_EQ(date.WeekDay, _ref_weekday(d));
+}
+
+/**=============================================================================
+ * @brief           计数器走过 elapsed 天零 01:01:01 后读时间和日期，
+ *                  与参考实现比较
+ *============================================================================*/
+static void _check_elapsed(struct ref_date *d, uint32_t elapsed)
+{
+    RTC_TimeTypeDef time;
+    RTC_DateTypeDef date;
+
+    sim_rtc_set_counter(elapsed * 86400u + TIME_OF_DAY);
+    TEST_EQ(HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN), HAL_OK);
+    TEST_EQ(HAL_RTC_GetDate(&hrtc, &date, RTC_FORMAT_BIN), HAL_OK);
+    _ref_date_update(d, elapsed);
+
+    TEST_EQ(time.Hours, 1);
+    TEST_EQ(time.Minutes, 1);
+    TEST_EQ(time.Seconds, 1);
+    /* 跨天后计数器只保留当天的秒数 */
+    TEST_EQ(sim_rtc_counter(), TIME_OF_DAY);
+    if (date.Year != d->year || date.Month != d->month || date.Date != d->day ||
+        date.WeekDay != _ref_weekday(d))
+    {
+        printf("   +%u days: got %02u-%02u-%02u/%u, expected %02u-%02u-%02u/%u\n", (unsigned)elapsed,
+               date.Year, date.Month, date.Date, date.WeekDay,
+               (unsigned)d->year, (unsigned)d->month, (unsigned)d->day, (unsigned)_ref_weekday(d));
+        TEST_ASSERT(!"date mismatch");
+    }
+}
+
+static void test_init(void)
+{
+    hrtc.Instance          = RTC;
+    hrtc.Init.AsynchPrediv = 32767u;
+    hrtc.Init.OutPut       = RTC_OUTPUTSOURCE_NONE;
+    TEST_EQ(HAL_RTC_Init(&hrtc), HAL_OK);
+    TEST_EQ(RTC->PRLL, 32767u);
+    TEST_EQ(RTC->CRL & RTC_CRL_CNF, 0);
+}
+
+/**=============================================================================
+ * @brief           2000-01-01 起逐日前进到 2099-12-31
+ *============================================================================*/
+static void test_every_day(void)
+{
+    struct ref_date d = {0, 1, 1};
+    uint32_t i;
+
+    _set_date(&d);
+    for (i = 1; i < DAYS_2000_2099; i++)
+    {
+        _check_elapsed(&d, 1);
+        if (sim_host_exit_code() != 0)
+            return;
+    }
+    TEST_EQ(d.year, 99);
+    TEST_EQ(d.month, 12);
+    TEST_EQ(d.day, 31);
+}
+
+/**=============================================================================
+ * @brief           每隔 5 天取一个起点，随机跨越若干天（不超过 2099 年底）
+ *============================================================================*/
+static void test_every_start(void)
+{
+    struct ref_date start = {0, 1, 1}, d;
+    uint32_t i;
+
+    srand(8);
+    for (i = 0; i < DAYS_2000_2099; i += START_STRIDE)
+    {
+        d = start;
+        _set_date(&d);
+        _check_elapsed(&d, rand() % (DAYS_2000_2099 - i));
+        _ref_date_update(&start, START_STRIDE);
+        if (sim_host_exit_code() != 0)
+            return;
+    }
+}
+
+/**=============================================================================
+ * @brief           HAL_RTC_GetTime 的寄存器访问次数和模拟时间与掉电天数无关；
+ *                  主机墙钟耗时只打印，不参与断言
+ *============================================================================*/
+static void test_latency(void)
+{
+    static const uint32_t days[] = {1, BENCH_DAYS};
+    struct ref_date ref, d = {0, 1, 1};
+    RTC_TimeTypeDef time;
+    double t0, best[2], loop_s;
+    uint32_t acc[2];
+    uint64_t ns[2];
+    int k, r;
+
+    for (k = 0; k < 2; k++)
+    {
+        best[k] = 1e9;
+        for (r = 0; r < BENCH_ROUNDS; r++)
+        {
+            _set_date(&d);
+            sim_rtc_set_counter(days[k] * 86400u + TIME_OF_DAY);
+            acc[k] = sim_access_count();
+            ns[k] = sim_time();
+            t0 = _now();
+            HAL_RTC_GetTime(&hrtc, &time, RTC_FORMAT_BIN);
+            t0 = _now() - t0;
+            ns[k] = sim_time() - ns[k];
+            acc[k] = sim_access_count() - acc[k];
+            if (t0 < best[k])
+                best[k] = t0;
+        }
+    }
+
+    t0 = _now();
+    for (r = 0; r < BENCH_ROUNDS; r++)
+    {
+        ref = d;
+        _ref_date_update(&ref, BENCH_DAYS + (r & 1));
+    }
+    loop_s = (_now() - t0) / BENCH_ROUNDS;
+    TEST_ASSERT(ref.year == 30);
+
+    printf("   HAL_RTC_GetTime after 1 day:    %8.2f us (host, incl. register traps), %u accesses\n",
+           best[0] * 1e6, (unsigned)acc[0]);
+    printf("   HAL_RTC_GetTime after %u days: %8.2f us, %u accesses\n",
+           (unsigned)BENCH_DAYS, best[1] * 1e6, (unsigned)acc[1]);
+    printf("   old loop date update, %u days: %8.2f us (pure host code)\n", (unsigned)BENCH_DAYS, loop_s * 1e6);
+    TEST_ASSERT(acc[1] == acc[0]);
+    TEST_ASSERT(ns[1] == ns[0]);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_init);
+    TEST_CASE(test_every_day);
+    TEST_CASE(test_every_start);
+    TEST_CASE(test_latency);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
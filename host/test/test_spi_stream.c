@@ -0,0 +1,404 @@
+/**
+  ******************************************************************************
+  * @file			test_spi_stream.c
+  * @brief			spi_stream: full duplex against a model slave, fills and
+  *                 16-bit frames, double-buffered streaming, queuing between
+  *                 threads, bytes per SCK against HAL_SPI_Transmit
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <spi_stream.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define CS_A                GPIO_PIN_4          /*!< PA4 */
+#define CS_B                GPIO_PIN_3          /*!< PA3 */
+#define BIG_SIZE            (70 * 1024)         /*!< 超过 65535 帧 */
+#define STREAM_BUF          512
+#define STREAM_TOTAL        (16 * 1024)
+#define QUEUE_XFERS         20
+#define QUEUE_LEN           300
+#define BENCH_SIZE          4096
+
+/* Private variables ---------------------------------------------------------*/
+static struct spi_stream_bus bus;
+static struct spi_stream_dev dev_a, dev_b;
+
+static rt_uint8_t           tx[BIG_SIZE], rx[BIG_SIZE], wire[BIG_SIZE + 64];
+static rt_uint8_t           sbuf[2][STREAM_BUF];
+static rt_size_t            stream_pos;
+
+/* 从机：MISO 为 MOSI 取反，记录片选状态 */
+static volatile rt_uint32_t frames_unselected, frames_both;
+static volatile rt_uint32_t frames_a, frames_b;
+
+static struct rt_thread     queue_thread[2];
+static rt_uint8_t           queue_stack[2][1024];
+static struct rt_semaphore  queue_done;
+
+/* Private function ----------------------------------------------------------*/
+
+static void _fill(rt_uint8_t *buf, rt_size_t len)
+{
+    rt_size_t i;
+
+    for (i = 0; i < len; i++)
+        buf[i] = (rt_uint8_t)rand();
+}
+
+static uint16_t _slave(void *arg, uint16_t mosi, int bits)
+{
+    uint16_t cs = sim_gpio_output(GPIOA);
+
+    (void)arg;
+    if (!(cs & CS_A) && !(cs & CS_B))
+        frames_both++;
+    else if (!(cs & CS_A))
+        frames_a++;
+    else if (!(cs & CS_B))
+        frames_b++;
+    else
+        frames_unselected++;
+
+    return (uint16_t)~mosi & (bits == 16 ? 0xFFFFu : 0xFFu);
+}
+
+static void _wait_idle(void)
+{
+    while (!sim_spi_idle(SPI1))
+        rt_thread_delay(1);
+}
+
+static double _sck_hz(void)
+{
+    return (double)HAL_RCC_GetPCLK2Freq() / (2u << ((SPI1->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos));
+}
+
+/**=============================================================================
+ * @brief           SPI1 主机，PA4、PA3 两个片选，最高时钟 PCLK2/2
+ *============================================================================*/
+static void _setup(void)
+{
+    TEST_EQ(spi_stream_bus_init(&bus, SPI1), RT_EOK);
+    spi_stream_dev_init(&dev_a, &bus, GPIOA, CS_A, 0, 36000000);
+    spi_stream_dev_init(&dev_b, &bus, GPIOA, CS_B, 3, 36000000);
+    sim_spi_attach(SPI1, _slave, RT_NULL);
+}
+
+/**=============================================================================
+ * @brief           轮询和 DMA 两条路径的全双工收发，线上和收到的数据都正确，
+ *                  只在片选有效时有时钟
+ *============================================================================*/
+static void test_xfer(void)
+{
+    static const rt_size_t sizes[] = {1, 2, 15, 16, 17, 255, 256, 1000, 4096};
+    rt_size_t i, k;
+
+    srand(19);
+    frames_unselected = frames_a = 0;
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+    {
+        _fill(tx, sizes[i]);
+        memset(rx, 0, sizes[i]);
+        TEST_EQ(spi_stream_transfer(&dev_a, tx, rx, sizes[i], 0), RT_EOK);
+        TEST_EQ(sim_spi_take(SPI1, wire, sizeof(wire)), sizes[i]);
+        TEST_MEM_EQ(wire, tx, sizes[i]);
+        for (k = 0; k < sizes[i] && rx[k] == (rt_uint8_t)~tx[k]; k++)
+            ;
+        TEST_EQ(k, sizes[i]);
+    }
+    TEST_EQ(frames_unselected, 0);
+    TEST_ASSERT(sim_gpio_output(GPIOA) & CS_A);
+    TEST_ASSERT(bus.poll_xfers > 0 && bus.dma_xfers > 0);
+    TEST_EQ(sim_spi_overruns(SPI1), 0);
+
+    /* 16 位帧：半字数据原样出现在线上，奇数长度拒绝 */
+    _fill(tx, 1024);
+    TEST_EQ(spi_stream_transfer(&dev_a, tx, rx, 1024, SPI_STREAM_16BIT), RT_EOK);
+    TEST_EQ(sim_spi_take(SPI1, wire, sizeof(wire)), 1024);
+    TEST_MEM_EQ(wire, tx, 1024);
+    TEST_EQ(bus.width, 2);
+    for (k = 0; k < 1024 && rx[k] == (rt_uint8_t)~tx[k]; k++)
+        ;
+    TEST_EQ(k, 1024);
+    TEST_EQ(spi_stream_transfer(&dev_a, tx, rx, 1023, SPI_STREAM_16BIT), -RT_EINVAL);
+
+    /* 超过 CNDTR 上限分段装载 */
+    _fill(tx, BIG_SIZE);
+    TEST_EQ(spi_stream_transfer(&dev_a, tx, rx, BIG_SIZE, 0), RT_EOK);
+    TEST_EQ(sim_spi_take(SPI1, wire, sizeof(wire)), BIG_SIZE);
+    TEST_MEM_EQ(wire, tx, BIG_SIZE);
+    TEST_EQ(rx[BIG_SIZE - 1], (rt_uint8_t)~tx[BIG_SIZE - 1]);
+    TEST_EQ(sim_spi_overruns(SPI1), 0);
+}
+
+/**=============================================================================
+ * @brief           填充和空发：偶数长度自动用 16 位帧，奇数长度用 8 位帧
+ *============================================================================*/
+static void test_fill(void)
+{
+    static const rt_uint8_t pattern = 0x3C;
+    rt_size_t i, n;
+
+    TEST_EQ(spi_stream_transfer(&dev_a, &pattern, RT_NULL, 1000, SPI_STREAM_REPEAT), RT_EOK);
+    TEST_EQ(bus.width, 2);
+    n = sim_spi_take(SPI1, wire, sizeof(wire));
+    TEST_EQ(n, 1000);
+    for (i = 0; i < n && wire[i] == pattern; i++)
+        ;
+    TEST_EQ(i, 1000);
+
+    TEST_EQ(spi_stream_transfer(&dev_a, RT_NULL, rx, 999, 0), RT_EOK);
+    TEST_EQ(bus.width, 1);
+    n = sim_spi_take(SPI1, wire, sizeof(wire));
+    TEST_EQ(n, 999);
+    for (i = 0; i < n && wire[i] == 0xFF && rx[i] == 0x00; i++)
+        ;
+    TEST_EQ(i, 999);
+}
+
+static rt_size_t _stream_fill(void *buf, rt_size_t size, void *arg)
+{
+    rt_size_t n = STREAM_TOTAL - stream_pos;
+
+    (void)arg;
+    if (n > size)
+        n = size;
+    memcpy(buf, tx + stream_pos, n);
+    stream_pos += n;
+    return n;
+}
+
+/**=============================================================================
+ * @brief           双缓冲流式发送：数据按顺序连续输出，填充跟得上时不停顿
+ *============================================================================*/
+static void test_stream(void)
+{
+    rt_uint64_t t0, ns, ideal;
+    rt_uint32_t under;
+
+    _fill(tx, STREAM_TOTAL);
+    stream_pos = 0;
+    under = bus.underruns;
+    TEST_EQ(spi_stream_take(&dev_a, RT_WAITING_FOREVER), RT_EOK);
+    t0 = sim_time();
+    TEST_EQ(spi_stream_write(&dev_a, sbuf[0], sbuf[1], STREAM_BUF, _stream_fill, RT_NULL,
+                             SPI_STREAM_16BIT), RT_EOK);
+    ns = sim_time() - t0;
+    spi_stream_release(&dev_a);
+
+    TEST_EQ(sim_spi_take(SPI1, wire, sizeof(wire)), STREAM_TOTAL);
+    TEST_MEM_EQ(wire, tx, STREAM_TOTAL);
+    ideal = (rt_uint64_t)(STREAM_TOTAL * 8 / _sck_hz() * 1e9);
+    printf("   %u bytes in %.1f us, back-to-back %.1f us, %u underruns\n", STREAM_TOTAL,
+           ns / 1e3, ideal / 1e3, (unsigned)(bus.underruns - under));
+    TEST_EQ(bus.underruns, under);
+    TEST_ASSERT(ns < ideal + ideal / 20);
+}
+
+static void _queue_entry(void *parameter)
+{
+    struct spi_stream_dev *dev = parameter;
+    static rt_uint8_t data[2][QUEUE_LEN];
+    rt_uint8_t *d = data[dev == &dev_b];
+    int i;
+
+    memset(d, dev == &dev_b ? 0xBB : 0xAA, QUEUE_LEN);
+    for (i = 0; i < QUEUE_XFERS; i++)
+    {
+        TEST_EQ(spi_stream_transfer(dev, d, RT_NULL, QUEUE_LEN, 0), RT_EOK);
+        rt_thread_delay(rand() % 2);
+    }
+    rt_sem_release(&queue_done);
+}
+
+/**=============================================================================
+ * @brief           两个线程访问同一总线上的两个设备：按先后排队，片选不会
+ *                  同时有效，每次传输在线上连续
+ *============================================================================*/
+static void test_queue(void)
+{
+    rt_size_t n, i, run;
+    int k;
+
+    sim_spi_take(SPI1, wire, sizeof(wire));
+    frames_a = frames_b = frames_both = frames_unselected = 0;
+    rt_sem_init(&queue_done, "queue", 0, RT_IPC_FLAG_FIFO);
+    for (k = 0; k < 2; k++)
+    {
+        rt_thread_init(&queue_thread[k], "spiq", _queue_entry, k ? &dev_b : &dev_a,
+                       queue_stack[k], sizeof(queue_stack[k]), 4, 2);
+        rt_thread_startup(&queue_thread[k]);
+    }
+    for (k = 0; k < 2; k++)
+        rt_sem_take(&queue_done, RT_WAITING_FOREVER);
+    rt_sem_detach(&queue_done);
+
+    n = sim_spi_take(SPI1, wire, sizeof(wire));
+    TEST_EQ(n, 2 * QUEUE_XFERS * QUEUE_LEN);
+    TEST_EQ(frames_both, 0);
+    TEST_EQ(frames_unselected, 0);
+    TEST_EQ(frames_a * bus.width, QUEUE_XFERS * QUEUE_LEN);
+    for (i = 0, run = 0; i < n; i++)
+    {
+        run++;
+        if (i + 1 == n || wire[i + 1] != wire[i])
+        {
+            if (run % QUEUE_LEN != 0)
+            {
+                printf("   run of %u bytes 0x%02X at %u\n", (unsigned)run, wire[i], (unsigned)i);
+                TEST_ASSERT(!"transfers interleaved");
+                break;
+            }
+            run = 0;
+        }
+    }
+}
+
+/**=============================================================================
+ * @brief           SCK 停住（时钟被关或配置错误）：轮询、切换帧宽度、占用和
+ *                  释放都在有限时间内返回 -RT_ETIMEOUT，总线不被锁死；恢复后
+ *                  收发正常，不会错位
+ *============================================================================*/
+static void test_halt(void)
+{
+    rt_uint8_t width = bus.width;
+    rt_size_t k;
+
+    sim_spi_take(SPI1, wire, sizeof(wire));
+    TEST_EQ(spi_stream_take(&dev_a, RT_WAITING_FOREVER), RT_EOK);
+    sim_spi_halt(SPI1, 1);
+    TEST_EQ(spi_stream_xfer(&dev_a, tx, rx, 4, 0), -RT_ETIMEOUT);
+    TEST_EQ(spi_stream_xfer(&dev_a, tx, RT_NULL, 4, SPI_STREAM_16BIT), -RT_ETIMEOUT);
+    TEST_EQ(bus.width, width);
+    TEST_EQ(spi_stream_release(&dev_a), -RT_ETIMEOUT);
+    TEST_ASSERT(sim_gpio_output(GPIOA) & CS_A);
+    TEST_ASSERT(bus.owner == RT_NULL);
+
+    /* 总线锁已经放开，BSY 不清时占用也超时返回 */
+    TEST_EQ(spi_stream_take(&dev_b, 0), -RT_ETIMEOUT);
+    TEST_ASSERT(bus.owner == RT_NULL);
+
+    sim_spi_halt(SPI1, 0);
+    rt_thread_mdelay(1);
+    sim_spi_take(SPI1, wire, sizeof(wire));
+    _fill(tx, 64);
+    TEST_EQ(spi_stream_transfer(&dev_b, tx, rx, 4, 0), RT_EOK);
+    TEST_EQ(spi_stream_transfer(&dev_a, tx, rx, 64, 0), RT_EOK);
+    for (k = 0; k < 64 && rx[k] == (rt_uint8_t)~tx[k]; k++)
+        ;
+    TEST_EQ(k, 64);
+    sim_spi_take(SPI1, wire, sizeof(wire));
+}
+
+/**=============================================================================
+ * @brief           同样 4KB 发送：HAL_SPI_Transmit 轮询与 DMA 8 位、16 位帧、
+ *                  双缓冲，比较每个 SCK 周期发出的字节数（上限 1/8）和 CPU
+ *                  访问寄存器的次数
+ *============================================================================*/
+static void test_bench(void)
+{
+    static const char * const name[] =
+    {
+        "HAL_SPI_Transmit", "spi_stream_xfer 8-bit", "spi_stream_xfer 16-bit", "spi_stream_write",
+    };
+    SPI_HandleTypeDef hspi;
+    rt_uint64_t t0, ns;
+    rt_uint32_t acc;
+    double bpc[4], sck = 0;
+    int m;
+
+    _fill(tx, BENCH_SIZE);
+    memset(&hspi, 0, sizeof(hspi));
+    hspi.Instance               = SPI1;
+    hspi.Init.Mode              = SPI_MODE_MASTER;
+    hspi.Init.Direction         = SPI_DIRECTION_2LINES;
+    hspi.Init.DataSize          = SPI_DATASIZE_8BIT;
+    hspi.Init.CLKPolarity       = SPI_POLARITY_LOW;
+    hspi.Init.CLKPhase          = SPI_PHASE_1EDGE;
+    hspi.Init.NSS               = SPI_NSS_SOFT;
+    hspi.Init.BaudRatePrescaler = SPI_BAUDRATEPRESCALER_2;
+    hspi.Init.FirstBit          = SPI_FIRSTBIT_MSB;
+
+    for (m = 0; m < 4; m++)
+    {
+        sim_spi_take(SPI1, wire, sizeof(wire));
+        if (m == 0)
+        {
+            TEST_EQ(HAL_SPI_Init(&hspi), HAL_OK);
+            GPIOA->BSRR = (rt_uint32_t)CS_A << 16;
+        }
+        else
+        {
+            TEST_EQ(spi_stream_take(&dev_a, RT_WAITING_FOREVER), RT_EOK);
+        }
+        sck = _sck_hz();
+
+        acc = sim_access_count();
+        t0 = sim_time();
+        if (m == 0)
+        {
+            TEST_EQ(HAL_SPI_Transmit(&hspi, tx, BENCH_SIZE, 1000), HAL_OK);
+        }
+        else if (m < 3)
+        {
+            TEST_EQ(spi_stream_xfer(&dev_a, tx, RT_NULL, BENCH_SIZE, m == 2 ? SPI_STREAM_16BIT : 0), RT_EOK);
+        }
+        else
+        {
+            stream_pos = STREAM_TOTAL - BENCH_SIZE;
+            memcpy(tx + stream_pos, tx, BENCH_SIZE);
+            TEST_EQ(spi_stream_write(&dev_a, sbuf[0], sbuf[1], STREAM_BUF, _stream_fill, RT_NULL,
+                                     SPI_STREAM_16BIT), RT_EOK);
+        }
+        _wait_idle();
+        ns  = sim_time() - t0;
+        acc = sim_access_count() - acc;
+
+        if (m == 0)
+        {
+            GPIOA->BSRR = CS_A;
+            HAL_SPI_DeInit(&hspi);
+        }
+        else
+        {
+            spi_stream_release(&dev_a);
+        }
+        TEST_EQ(sim_spi_take(SPI1, wire, sizeof(wire)), BENCH_SIZE);
+        TEST_MEM_EQ(wire, tx, BENCH_SIZE);
+
+        bpc[m] = BENCH_SIZE / (ns * 1e-9 * sck);
+        printf("   %-24s %7.1f us  %.4f bytes/SCK  %5u register accesses\n",
+               name[m], ns / 1e3, bpc[m], (unsigned)acc);
+    }
+    printf("   SCK %.0f Hz, back-to-back limit 0.1250 bytes/SCK\n", sck);
+
+    TEST_ASSERT(bpc[1] > bpc[0]);
+    TEST_ASSERT(bpc[2] > 0.12 && bpc[3] > 0.12);
+}
+
+static void test_main(void)
+{
+    _setup();
+    TEST_CASE(test_xfer);
+    TEST_CASE(test_fill);
+    TEST_CASE(test_stream);
+    TEST_CASE(test_queue);
+    TEST_CASE(test_halt);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
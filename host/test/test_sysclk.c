@@ -0,0 +1,331 @@
+/**
+  ******************************************************************************
+  * @file			test_sysclk.c
+  * @brief			sysclk: RCC write order, recomputed divisors, busy peripherals
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <sysclk.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+/* RCC 和 FLASH 接口连续排列，一起记录 */
+#define LOG_BASE            RCC_BASE
+#define LOG_SIZE            (FLASH_R_BASE + 0x400u - RCC_BASE)
+#define CONSOLE_UART        USART1
+
+/* Private variables ---------------------------------------------------------*/
+static rt_uint32_t          console_baud;
+
+static struct sysclk_notifier notifier;
+static rt_bool_t            notifier_busy;
+static rt_uint32_t          notifier_calls;
+static rt_uint32_t          notifier_pclk1;
+static rt_uint32_t          notifier_primask;
+
+/* Private function ----------------------------------------------------------*/
+
+static rt_uint32_t _baud(void)
+{
+    return sim_clock_pclk2() / CONSOLE_UART->BRR;
+}
+
+/**=============================================================================
+ * @brief           CFGR 请求的系统时钟
+ *============================================================================*/
+static rt_uint32_t _cfgr_sysclk(rt_uint32_t cfgr)
+{
+    switch (cfgr & RCC_CFGR_SW)
+    {
+    case RCC_CFGR_SW_HSE:
+        return SIM_HSE_HZ;
+    case RCC_CFGR_SW_PLL:
+        return (cfgr & RCC_CFGR_PLLSRC ? SIM_HSE_HZ : SIM_HSI_HZ / 2u) *
+               (((cfgr & RCC_CFGR_PLLMULL) >> RCC_CFGR_PLLMULL_Pos) + 2u);
+    default:
+        return SIM_HSI_HZ;
+    }
+}
+
+static rt_uint32_t _latency_needed(rt_uint32_t hz)
+{
+    return hz > 48000000u ? 2u : hz > 24000000u ? 1u : 0u;
+}
+
+/**=============================================================================
+ * @brief           按记录的写顺序重放 CR、CFGR 和 ACR：任何时刻 flash 等待
+ *                  周期都不少于当时系统时钟的要求，PLL 运行时不改倍频
+ *
+ * @return          违反的记录序号，没有时为 -1
+ *============================================================================*/
+static int _check_write_order(rt_uint32_t cr, rt_uint32_t cfgr, rt_uint32_t acr)
+{
+    const rt_uint32_t pll = RCC_CFGR_PLLMULL | RCC_CFGR_PLLSRC | RCC_CFGR_PLLXTPRE;
+    const struct sim_access *a;
+    size_t i;
+
+    for (i = 0; i < sim_log_count(); i++)
+    {
+        a = sim_log_get(i);
+        if (a->addr == (rt_uint32_t)(rt_ubase_t)&RCC->CR)
+        {
+            cr = a->val;
+            continue;
+        }
+        if (a->addr == (rt_uint32_t)(rt_ubase_t)&RCC->CFGR)
+        {
+            if ((cr & RCC_CR_PLLON) && ((cfgr ^ a->val) & pll))
+                return (int)i;
+            cfgr = a->val;
+        }
+        else if (a->addr == (rt_uint32_t)(rt_ubase_t)&FLASH->ACR)
+        {
+            acr = a->val;
+        }
+        else
+        {
+            continue;
+        }
+        if ((acr & FLASH_ACR_LATENCY) < _latency_needed(_cfgr_sysclk(cfgr)))
+            return (int)i;
+    }
+
+    return -1;
+}
+
+static void _check_clocks(const struct sysclk_profile *info)
+{
+    TEST_EQ(sim_clock_hclk(), info->hclk);
+    TEST_EQ(SystemCoreClock, info->hclk);
+    TEST_EQ(SysTick->LOAD, info->hclk / RT_TICK_PER_SECOND - 1u);
+    TEST_EQ(FLASH->ACR & FLASH_ACR_LATENCY, info->latency);
+    TEST_ASSERT(sim_clock_pclk1() <= 36000000u);
+    /* 控制台波特率误差不超过 1% */
+    TEST_ASSERT(abs((int)_baud() - (int)console_baud) * 100 <= (int)console_baud);
+}
+
+static rt_bool_t _notifier_busy(struct sysclk_notifier *n)
+{
+    return *(rt_bool_t *)n->user_data;
+}
+
+static void _notifier_changed(struct sysclk_notifier *n)
+{
+    (void)n;
+    notifier_calls++;
+    notifier_pclk1   = sim_clock_pclk1();
+    notifier_primask = sim_cpu_get_primask();
+}
+
+/**=============================================================================
+ * @brief           上电后处于默认的 72MHz
+ *============================================================================*/
+static void test_boot(void)
+{
+    TEST_EQ(sysclk_get_profile(), SYSCLK_PROFILE_72MHZ);
+    TEST_ASSERT(CONSOLE_UART->CR1 & USART_CR1_UE);
+    console_baud = _baud();
+    printf("   console %u baud at PCLK2 %u Hz\n", (unsigned)console_baud, (unsigned)sim_clock_pclk2());
+    TEST_ASSERT(console_baud > 100000u && console_baud < 130000u);
+    _check_clocks(sysclk_get_profile_info(SYSCLK_PROFILE_72MHZ));
+}
+
+/**=============================================================================
+ * @brief           各配置之间来回切换：频率、SysTick、BRR 随之更新，升频前
+ *                  先加等待周期，降频后才减，PLL 运行时不改倍频
+ *============================================================================*/
+static void test_profiles(void)
+{
+    static const sysclk_profile_t seq[] =
+    {
+        SYSCLK_PROFILE_24MHZ, SYSCLK_PROFILE_48MHZ, SYSCLK_PROFILE_8MHZ, SYSCLK_PROFILE_72MHZ,
+        SYSCLK_PROFILE_8MHZ, SYSCLK_PROFILE_24MHZ, SYSCLK_PROFILE_72MHZ, SYSCLK_PROFILE_48MHZ,
+        SYSCLK_PROFILE_72MHZ,
+    };
+    const struct sysclk_profile *info;
+    rt_uint32_t cr, cfgr, acr, i;
+    int bad;
+
+    for (i = 0; i < sizeof(seq) / sizeof(seq[0]); i++)
+    {
+        info = sysclk_get_profile_info(seq[i]);
+        cr   = RCC->CR;
+        cfgr = RCC->CFGR;
+        acr  = FLASH->ACR;
+        sim_log_start(LOG_BASE, LOG_SIZE);
+        TEST_EQ(sysclk_switch(seq[i]), RT_EOK);
+        bad = _check_write_order(cr, cfgr, acr);
+        sim_log_stop();
+
+        if (bad >= 0)
+        {
+            printf("   -> %s: RCC/FLASH write %d out of order\n", info->name, bad);
+            TEST_ASSERT(!"flash latency or PLL write order");
+        }
+        TEST_EQ(sysclk_get_profile(), seq[i]);
+        _check_clocks(info);
+        TEST_EQ(!!(RCC->CR & RCC_CR_PLLON), info->pll_mul != 0);
+        if (sim_host_exit_code() != 0)
+            return;
+    }
+}
+
+/**=============================================================================
+ * @brief           从 HSI 启动 HSE：等待起振期间中断照常执行
+ *============================================================================*/
+static void test_irq_during_wait(void)
+{
+    rt_tick_t tick;
+    rt_uint64_t ns;
+
+    TEST_EQ(HAL_RCC_DeInit(), HAL_OK);
+    TEST_EQ(RCC->CR & RCC_CR_HSEON, 0);
+    sim_rcc_set_hse_startup(SIM_MS(10));
+
+    tick = rt_tick_get();
+    ns = sim_time();
+    TEST_EQ(sysclk_switch(SYSCLK_PROFILE_48MHZ), RT_EOK);
+    ns = sim_time() - ns;
+    tick = rt_tick_get() - tick;
+    printf("   HSE start-up 10 ms: switch took %.3f ms, %u ticks serviced\n", ns / 1e6, (unsigned)tick);
+    TEST_ASSERT(ns >= SIM_MS(10));
+    TEST_ASSERT(tick >= 9);
+    _check_clocks(sysclk_get_profile_info(SYSCLK_PROFILE_48MHZ));
+    sim_rcc_set_hse_startup(SIM_MS(2));
+}
+
+/**=============================================================================
+ * @brief           晶振不起振：按时返回 -RT_EIO，保持 HSI
+ *============================================================================*/
+static void test_hse_fail(void)
+{
+    rt_tick_t tick;
+    rt_uint64_t ns;
+
+    TEST_EQ(HAL_RCC_DeInit(), HAL_OK);
+    sim_rcc_set_hse_startup(0);
+
+    tick = rt_tick_get();
+    ns = sim_time();
+    TEST_EQ(sysclk_switch(SYSCLK_PROFILE_24MHZ), -RT_EIO);
+    ns = sim_time() - ns;
+    tick = rt_tick_get() - tick;
+    printf("   HSE dead: gave up after %.3f ms, %u ticks serviced\n", ns / 1e6, (unsigned)tick);
+    TEST_ASSERT(ns >= SIM_MS(HSE_STARTUP_TIMEOUT));
+    TEST_ASSERT(ns <= SIM_MS(HSE_STARTUP_TIMEOUT + 5));
+    TEST_ASSERT(tick >= HSE_STARTUP_TIMEOUT - 1);
+    TEST_EQ(RCC->CR & RCC_CR_HSEON, 0);
+    TEST_EQ(sim_clock_hclk(), SIM_HSI_HZ);
+    TEST_EQ(SysTick->LOAD, SIM_HSI_HZ / RT_TICK_PER_SECOND - 1u);
+
+    sim_rcc_set_hse_startup(SIM_MS(2));
+    TEST_EQ(sysclk_switch(SYSCLK_PROFILE_72MHZ), RT_EOK);
+    _check_clocks(sysclk_get_profile_info(SYSCLK_PROFILE_72MHZ));
+}
+
+/**=============================================================================
+ * @brief           运行中的 TIM/SPI/ADC/I2C/未登记串口拒绝切换，时钟不变；
+ *                  外设时钟关闭或停止后允许
+ *============================================================================*/
+static void test_busy(void)
+{
+    static const struct
+    {
+        volatile rt_uint32_t *reg;
+        rt_uint32_t           run;
+        volatile rt_uint32_t *enr;
+        rt_uint32_t           en;
+    } periphs[] =
+    {
+        {&TIM2->CR1,   TIM_CR1_CEN,  &RCC->APB1ENR, RCC_APB1ENR_TIM2EN},
+        {&TIM1->CR1,   TIM_CR1_CEN,  &RCC->APB2ENR, RCC_APB2ENR_TIM1EN},
+        {&SPI2->CR1,   SPI_CR1_SPE,  &RCC->APB1ENR, RCC_APB1ENR_SPI2EN},
+        {&ADC1->CR2,   ADC_CR2_ADON, &RCC->APB2ENR, RCC_APB2ENR_ADC1EN},
+        {&I2C1->CR1,   I2C_CR1_PE,   &RCC->APB1ENR, RCC_APB1ENR_I2C1EN},
+        {&USART2->CR1, USART_CR1_UE, &RCC->APB1ENR, RCC_APB1ENR_USART2EN},
+    };
+    rt_uint32_t i, cfgr;
+
+    for (i = 0; i < sizeof(periphs) / sizeof(periphs[0]); i++)
+    {
+        *periphs[i].enr |= periphs[i].en;
+        *periphs[i].reg |= periphs[i].run;
+
+        cfgr = RCC->CFGR;
+        TEST_EQ(sysclk_switch(SYSCLK_PROFILE_24MHZ), -RT_EBUSY);
+        TEST_EQ(RCC->CFGR, cfgr);
+        TEST_EQ(sysclk_get_profile(), SYSCLK_PROFILE_72MHZ);
+        _check_clocks(sysclk_get_profile_info(SYSCLK_PROFILE_72MHZ));
+
+        /* 时钟关闭时运行位不起作用 */
+        *periphs[i].enr &= ~periphs[i].en;
+        TEST_EQ(sysclk_switch(SYSCLK_PROFILE_24MHZ), RT_EOK);
+        TEST_EQ(sysclk_switch(SYSCLK_PROFILE_72MHZ), RT_EOK);
+
+        *periphs[i].enr |= periphs[i].en;
+        *periphs[i].reg &= ~periphs[i].run;
+        TEST_EQ(sysclk_switch(SYSCLK_PROFILE_24MHZ), RT_EOK);
+        TEST_EQ(sysclk_switch(SYSCLK_PROFILE_72MHZ), RT_EOK);
+        *periphs[i].enr &= ~periphs[i].en;
+    }
+}
+
+/**=============================================================================
+ * @brief           登记通知的外设由回调决定：忙时拒绝，空闲时切换，每次
+ *                  改时钟源后在关中断时收到新的 PCLK
+ *============================================================================*/
+static void test_notifier(void)
+{
+    __HAL_RCC_SPI2_CLK_ENABLE();
+    SPI2->CR1 |= SPI_CR1_SPE;
+
+    notifier.periph    = SPI2;
+    notifier.busy      = _notifier_busy;
+    notifier.changed   = _notifier_changed;
+    notifier.user_data = &notifier_busy;
+    TEST_EQ(sysclk_register_notifier(&notifier), RT_EOK);
+    TEST_EQ(sysclk_register_notifier(&notifier), RT_EOK);
+
+    notifier_busy = RT_TRUE;
+    TEST_EQ(sysclk_switch(SYSCLK_PROFILE_24MHZ), -RT_EBUSY);
+    TEST_EQ(notifier_calls, 0);
+
+    /* 72MHz -> 24MHz 先切到 HSE 再切到新的 PLL，通知两次 */
+    notifier_busy = RT_FALSE;
+    TEST_EQ(sysclk_switch(SYSCLK_PROFILE_24MHZ), RT_EOK);
+    TEST_EQ(notifier_calls, 2);
+    TEST_EQ(notifier_pclk1, 24000000u);
+    TEST_ASSERT(notifier_primask != 0);
+
+    TEST_EQ(sysclk_switch(SYSCLK_PROFILE_72MHZ), RT_EOK);
+    TEST_EQ(notifier_calls, 4);
+    TEST_EQ(notifier_pclk1, 36000000u);
+
+    SPI2->CR1 &= ~SPI_CR1_SPE;
+    __HAL_RCC_SPI2_CLK_DISABLE();
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_boot);
+    TEST_CASE(test_profiles);
+    TEST_CASE(test_irq_during_wait);
+    TEST_CASE(test_hse_fail);
+    TEST_CASE(test_busy);
+    TEST_CASE(test_notifier);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
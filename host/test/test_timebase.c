@@ -0,0 +1,212 @@
+/**
+  ******************************************************************************
+  * @file			test_timebase.c
+  * @brief			timebase: HAL tick snapshot, delays and HAL timeouts on the sim tick
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <timebase.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define US_SAMPLES          5000
+
+/* Private variables ---------------------------------------------------------*/
+static struct rt_thread     worker_thread;
+static rt_uint8_t           worker_stack[4096];
+static volatile rt_uint32_t worker_runs;
+static volatile int         worker_stop;
+
+static UART_HandleTypeDef   huart2;
+
+/* Private function ----------------------------------------------------------*/
+
+static void _worker_entry(void *parameter)
+{
+    (void)parameter;
+    while (!worker_stop)
+    {
+        worker_runs++;
+        rt_thread_yield();
+    }
+}
+
+/* 随机时刻进入的中断，什么也不做，只打乱读数的时机 */
+void EXTI0_IRQHandler(void)
+{
+}
+
+/**=============================================================================
+ * @brief           线程中 HAL_GetTick 与 rt_tick 一致，随模拟时间前进
+ *============================================================================*/
+static void test_get_tick(void)
+{
+    rt_uint32_t t0;
+    rt_uint64_t ns;
+
+    TEST_EQ(HAL_GetTick(), rt_tick_get());
+    t0 = HAL_GetTick();
+    ns = sim_time();
+    rt_thread_mdelay(10);
+    TEST_EQ(HAL_GetTick(), rt_tick_get());
+    TEST_ASSERT(HAL_GetTick() - t0 >= 10 && HAL_GetTick() - t0 <= 11);
+    TEST_ASSERT(sim_time() - ns >= SIM_MS(9));
+}
+
+/**=============================================================================
+ * @brief           关中断期间最多多算一个挂起的节拍，开中断后与 rt_tick 一致，
+ *                  不留下偏差
+ *============================================================================*/
+static void test_blocked(void)
+{
+    rt_uint32_t t0, t1, tick0;
+    rt_uint64_t ns;
+    rt_base_t level;
+    int round;
+
+    for (round = 0; round < 5; round++)
+    {
+        tick0 = rt_tick_get();
+        level = rt_hw_interrupt_disable();
+        t0 = HAL_GetTick();
+        timebase_delay_us(2500u + round * 1000u);
+        t1 = HAL_GetTick();
+        TEST_EQ(t1 - t0, 1);
+        TEST_EQ(HAL_GetTick(), t1);
+
+        /* 关中断时 HAL_Delay 按 SysTick 计数忙等 */
+        ns = sim_time();
+        HAL_Delay(3);
+        TEST_ASSERT(sim_time() - ns >= SIM_MS(3));
+        TEST_ASSERT(sim_time() - ns < SIM_MS(3) + SIM_US(100));
+        rt_hw_interrupt_enable(level);
+
+        /* 屏蔽期间的节拍只补一个，计数不回退也不超前 */
+        TEST_EQ(rt_tick_get(), tick0 + 1);
+        TEST_EQ(HAL_GetTick(), rt_tick_get());
+        TEST_ASSERT((rt_int32_t)(HAL_GetTick() - t1) >= 0);
+    }
+}
+
+/**=============================================================================
+ * @brief           线程中 HAL_Delay 让出 CPU，且至少延时给定的毫秒数
+ *============================================================================*/
+static void test_delay_yields(void)
+{
+    rt_uint64_t ns;
+
+    rt_thread_init(&worker_thread, "work", _worker_entry, RT_NULL,
+                   worker_stack, sizeof(worker_stack), RT_THREAD_PRIORITY_MAX - 2, 5);
+    worker_runs = 0;
+    worker_stop = 0;
+    rt_thread_startup(&worker_thread);
+
+    ns = sim_time();
+    HAL_Delay(20);
+    ns = sim_time() - ns;
+    worker_stop = 1;
+    rt_thread_mdelay(2);
+
+    printf("   HAL_Delay(20): %.3f ms, worker ran %u times\n", ns / 1e6, (unsigned)worker_runs);
+    TEST_ASSERT(ns >= SIM_MS(20));
+    TEST_ASSERT(ns <= SIM_MS(22));
+    TEST_ASSERT(worker_runs > 100);
+}
+
+/**=============================================================================
+ * @brief           HAL 的超时路径：没有数据时 HAL_UART_Receive 按时返回超时
+ *============================================================================*/
+static void test_hal_timeout(void)
+{
+    rt_uint8_t byte;
+    rt_uint64_t ns;
+    HAL_StatusTypeDef st;
+
+    __HAL_RCC_USART2_CLK_ENABLE();
+    huart2.Instance        = USART2;
+    huart2.Init.BaudRate   = 115200;
+    huart2.Init.WordLength = UART_WORDLENGTH_8B;
+    huart2.Init.StopBits   = UART_STOPBITS_1;
+    huart2.Init.Parity     = UART_PARITY_NONE;
+    huart2.Init.Mode       = UART_MODE_TX_RX;
+    huart2.Init.HwFlowCtl  = UART_HWCONTROL_NONE;
+    TEST_EQ(HAL_UART_Init(&huart2), HAL_OK);
+
+    ns = sim_time();
+    st = HAL_UART_Receive(&huart2, &byte, 1, 30);
+    ns = sim_time() - ns;
+    printf("   HAL_UART_Receive timeout 30: %.3f ms\n", ns / 1e6);
+    TEST_EQ(st, HAL_TIMEOUT);
+    TEST_ASSERT(ns >= SIM_MS(29));
+    TEST_ASSERT(ns <= SIM_MS(32));
+}
+
+/**=============================================================================
+ * @brief           微秒时间戳单调，与模拟时间的差值保持不变；SysTick 重装、
+ *                  随机中断和关中断时挂起的节拍穿插其中
+ *============================================================================*/
+static void test_us(void)
+{
+    rt_uint64_t us, last, base;
+    rt_int64_t drift, worst = 0;
+    rt_base_t level;
+    int i;
+
+    HAL_NVIC_SetPriority(EXTI0_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(EXTI0_IRQn);
+    sim_preempt_random(5, EXTI0_IRQn);
+
+    srand(11);
+    base = sim_time() / 1000u - timebase_get_us();
+    last = timebase_get_us();
+    for (i = 0; i < US_SAMPLES; i++)
+    {
+        /* 每 4 次有一次在关中断时读，跨过重装点时节拍处于挂起状态 */
+        level = (i % 4 == 0) ? rt_hw_interrupt_disable() : 0;
+        sim_advance(SIM_US(rand() % 900));
+        us = timebase_get_us();
+        if (i % 4 == 0)
+            rt_hw_interrupt_enable(level);
+        if (us < last)
+        {
+            printf("   %llu after %llu\n", (unsigned long long)us, (unsigned long long)last);
+            TEST_ASSERT(!"timestamp went backwards");
+            break;
+        }
+        drift = (rt_int64_t)(sim_time() / 1000u - us - base);
+        if (drift < 0)
+            drift = -drift;
+        if (drift > worst)
+            worst = drift;
+        last = us;
+    }
+
+    sim_preempt_random(0, EXTI0_IRQn);
+    HAL_NVIC_DisableIRQ(EXTI0_IRQn);
+    printf("   %d samples, worst deviation from simulated time %lld us\n", US_SAMPLES, (long long)worst);
+    TEST_ASSERT(worst <= 2);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_get_tick);
+    TEST_CASE(test_blocked);
+    TEST_CASE(test_delay_yields);
+    TEST_CASE(test_hal_timeout);
+    TEST_CASE(test_us);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
@@ -0,0 +1,369 @@
+/**
+  ******************************************************************************
+  * @file			test_trace.c
+  * @brief			trace: ram ring, itm framing through the host swo decoder,
+  *                 truncated and dropped events, text/csv output, cost per event
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <rthw.h>
+#include <rtthread.h>
+#include <trace.h>
+#include "trace_swo.h"
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define EVENTS              3000
+#define STALLS              200
+#define BENCH_EVENTS        5000
+#define ID_A                (TRACE_ID_USER + 0)
+#define ID_B                (TRACE_ID_USER + 1)
+#define SENT_DROPPED        0xFFu               /*!< 首字没有发出 */
+
+/* Private typedef -----------------------------------------------------------*/
+struct sent
+{
+    rt_uint16_t id;
+    rt_uint8_t  nargs;
+    rt_uint8_t  seq;
+    rt_uint8_t  words;                      /*!< 预期收到的时间戳和参数字数 */
+    rt_uint32_t arg[TRACE_ARGS_MAX];
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct sent              sent[EVENTS];
+static struct trace_swo_event   got[EVENTS + 16];
+static rt_size_t                got_num;
+static rt_uint8_t               swo[256 * 1024];
+
+/* Private function ----------------------------------------------------------*/
+
+static void _collect(const struct trace_swo_event *ev, void *arg)
+{
+    (void)arg;
+    if (got_num < sizeof(got) / sizeof(got[0]))
+        got[got_num++] = *ev;
+}
+
+/**=============================================================================
+ * @brief           取出 SWO 字节流，分成不规则的小块送进解码器
+ *============================================================================*/
+static void _decode(struct trace_swo *dec)
+{
+    size_t n = sim_itm_swo_take(swo, sizeof(swo)), off = 0, chunk;
+
+    got_num = 0;
+    trace_swo_init(dec, RT_TRACE_ITM_PORT, _collect, RT_NULL);
+    while (off < n)
+    {
+        chunk = (size_t)(rand() % 13) + 1;
+        if (chunk > n - off)
+            chunk = n - off;
+        trace_swo_feed(dec, swo + off, chunk);
+        off += chunk;
+    }
+    trace_swo_flush(dec);
+}
+
+/**=============================================================================
+ * @brief           参数专门挑容易与首字混淆的值：旧格式的 0xA5 同步字节、
+ *                  合法的首字、端口号和全 0/全 1
+ *============================================================================*/
+static rt_uint32_t _nasty(rt_uint8_t seq)
+{
+    switch (rand() % 6)
+    {
+    case 0:
+        return 0xA5A5A5A5u;
+    case 1:
+        return 0xA5000000u | ((rt_uint32_t)rand() & 0xFFFFFFu);
+    case 2:
+        return TRACE_HDR(ID_A, rand() % 5, seq + 1u);
+    case 3:
+        return (RT_TRACE_ITM_PORT << 3) | 3u;
+    case 4:
+        return rand() & 1 ? 0u : 0xFFFFFFFFu;
+    default:
+        return ((rt_uint32_t)rand() << 16) ^ (rt_uint32_t)rand();
+    }
+}
+
+static void _send(struct sent *s, rt_uint8_t seq)
+{
+    int i;
+
+    s->id    = (rt_uint16_t)(TRACE_ID_USER + rand() % 0x100);
+    s->nargs = (rt_uint8_t)(rand() % (TRACE_ARGS_MAX + 1));
+    s->seq   = seq;
+    s->words = s->nargs + 1u;
+    memset(s->arg, 0, sizeof(s->arg));
+    for (i = 0; i < s->nargs; i++)
+        s->arg[i] = _nasty(seq);
+    trace_event(s->id, s->nargs, s->arg[0], s->arg[1], s->arg[2], s->arg[3]);
+}
+
+/* 当前的序号：记一个事件读回它的首字 */
+static rt_uint8_t _next_seq(void)
+{
+    struct trace_record rec;
+
+    while (trace_read(&rec, 1) == 1)
+        ;
+    TRACE0(ID_B);
+    TEST_EQ(trace_read(&rec, 1), 1);
+    return (rt_uint8_t)(TRACE_HDR_SEQ(rec.hdr) + 1u);
+}
+
+/**=============================================================================
+ * @brief           没有调试器时写 RAM：内容和顺序正确，满时覆盖最旧的并计数
+ *============================================================================*/
+static void test_ring(void)
+{
+    struct trace_record rec[RT_TRACE_RING_SIZE];
+    rt_uint32_t lost, i;
+    rt_uint8_t seq;
+
+    sim_itm_attach(0);
+    seq = _next_seq();
+    lost = trace_get_lost();
+
+    TRACE0(ID_A);
+    TRACE4(ID_B, 1, 0xA5A5A5A5u, 3, 0xFFFFFFFFu);
+    TEST_EQ(trace_read(rec, RT_TRACE_RING_SIZE), 2);
+    TEST_EQ(rec[0].hdr, TRACE_HDR(ID_A, 0, seq));
+    TEST_EQ(rec[1].hdr, TRACE_HDR(ID_B, 4, (rt_uint8_t)(seq + 1u)));
+    TEST_EQ(rec[1].arg[1], 0xA5A5A5A5u);
+    TEST_EQ(rec[1].arg[3], 0xFFFFFFFFu);
+    TEST_ASSERT(rec[1].timestamp - rec[0].timestamp < 0x80000000u);
+
+    seq += 2;
+    for (i = 0; i < RT_TRACE_RING_SIZE + 5; i++)
+        TRACE1(ID_A, i);
+    TEST_EQ(trace_get_lost() - lost, 5);
+    TEST_EQ(trace_read(rec, RT_TRACE_RING_SIZE), RT_TRACE_RING_SIZE);
+    for (i = 0; i < RT_TRACE_RING_SIZE; i++)
+    {
+        TEST_EQ(TRACE_HDR_SEQ(rec[i].hdr), (rt_uint8_t)(seq + 5u + i));
+        TEST_EQ(rec[i].arg[0], 5u + i);
+    }
+    TEST_EQ(trace_read(rec, 1), 0);
+}
+
+/**=============================================================================
+ * @brief           SWO 输出：参数中夹杂像首字和同步字节的值，经解码器还原后
+ *                  与发出的事件逐条相同，不多不少
+ *============================================================================*/
+static void test_framing(void)
+{
+    struct trace_swo dec;
+    rt_uint32_t lost, i;
+    rt_uint8_t seq;
+
+    sim_itm_attach(0);
+    seq = _next_seq();
+    lost = trace_get_lost();
+    sim_itm_attach((1u << RT_TRACE_ITM_PORT) | (1u << TRACE_ITM_PORT_DATA) | 1u);
+    sim_itm_swo_take(swo, sizeof(swo));
+
+    srand(14);
+    for (i = 0; i < EVENTS; i++)
+    {
+        _send(&sent[i], seq++);
+        /* 控制台等其他端口的数据穿插其中 */
+        if (rand() % 8 == 0)
+            ITM_SendChar('x');
+    }
+    TEST_EQ(trace_get_lost(), lost);
+
+    _decode(&dec);
+    printf("   %u events, %u bad headers, %u orphan words\n", dec.events, dec.bad_headers, dec.orphans);
+    TEST_EQ(got_num, EVENTS);
+    TEST_EQ(dec.truncated, 0);
+    TEST_EQ(dec.lost, 0);
+    TEST_EQ(dec.bad_headers, 0);
+    TEST_EQ(dec.orphans, 0);
+    for (i = 0; i < got_num && i < EVENTS; i++)
+    {
+        if (got[i].id != sent[i].id || got[i].nargs != sent[i].nargs || got[i].seq != sent[i].seq ||
+            got[i].status != TRACE_SWO_OK || memcmp(got[i].arg, sent[i].arg, sizeof(got[i].arg)) != 0)
+        {
+            printf("   event %u: id 0x%04x/0x%04x nargs %u/%u seq %u/%u\n", (unsigned)i,
+                   got[i].id, sent[i].id, got[i].nargs, sent[i].nargs, got[i].seq, sent[i].seq);
+            TEST_ASSERT(!"decoded event differs");
+            break;
+        }
+        if (i > 0)
+            TEST_ASSERT(got[i].timestamp - got[i - 1].timestamp < 0x80000000u);
+    }
+}
+
+/**=============================================================================
+ * @brief           FIFO 持续满：首字发不出去的事件整条丢失，由序号间隔发现；
+ *                  中途失败的事件标为截断；之后的事件照常解出
+ *============================================================================*/
+static void test_stall(void)
+{
+    struct trace_swo dec;
+    rt_uint32_t lost, dropped = 0, truncated = 0, i, k, after;
+    rt_uint8_t seq;
+
+    sim_itm_attach(0);
+    seq = _next_seq();
+    lost = trace_get_lost();
+    sim_itm_attach((1u << RT_TRACE_ITM_PORT) | (1u << TRACE_ITM_PORT_DATA));
+    sim_itm_swo_take(swo, sizeof(swo));
+
+    srand(15);
+    for (i = 0; i < STALLS; i++)
+    {
+        /* 每 3 个事件中有 2 个从第 after 个字起阻塞，直到固件放弃 */
+        after = i % 3 == 1 ? TRACE_ARGS_MAX + 2u : (rt_uint32_t)(rand() % (TRACE_ARGS_MAX + 2));
+        sim_itm_stall(after, 10000);
+        _send(&sent[i], seq++);
+        sim_itm_stall(0, 0);
+        if (after == 0)
+        {
+            sent[i].words = SENT_DROPPED;
+            dropped++;
+        }
+        else if (after <= sent[i].nargs + 1u)
+        {
+            sent[i].words = (rt_uint8_t)(after - 1u);
+            truncated++;
+        }
+    }
+    TEST_EQ(trace_get_lost() - lost, dropped + truncated);
+
+    _decode(&dec);
+    printf("   %u stalled events dropped, %u truncated; decoder: %u events, %u truncated, %u lost\n",
+           (unsigned)dropped, (unsigned)truncated, dec.events, dec.truncated, dec.lost);
+    TEST_EQ(got_num, STALLS - dropped);
+    TEST_EQ(dec.truncated, truncated);
+    TEST_EQ(dec.lost, dropped);
+    TEST_EQ(dec.orphans, 0);
+
+    for (i = 0, k = 0; i < STALLS && k < got_num; i++)
+    {
+        if (sent[i].words == SENT_DROPPED)
+            continue;
+        TEST_EQ(got[k].seq, sent[i].seq);
+        TEST_EQ(got[k].id, sent[i].id);
+        TEST_EQ(got[k].words, sent[i].words);
+        TEST_EQ(got[k].status, sent[i].words == sent[i].nargs + 1u ? TRACE_SWO_OK : TRACE_SWO_TRUNCATED);
+        if (got[k].words > 1)
+            TEST_MEM_EQ(got[k].arg, sent[i].arg, (got[k].words - 1u) * sizeof(rt_uint32_t));
+        k++;
+    }
+}
+
+/**=============================================================================
+ * @brief           对照表和文本/CSV 输出，不安全的格式串不被使用
+ *============================================================================*/
+static void test_output(void)
+{
+    static const char table[] =
+        "# id name format\n"
+        "0x0001 boot SystemCoreClock=%u\n"
+        "0x0100 adc_done ch=%u value=0x%04x\n"
+        "0x0101 evil %s%n\n"
+        "\n"
+        "258 bare\n";
+    struct trace_swo_map map[8];
+    struct trace_swo_event ev;
+    char line[128];
+    FILE *f;
+    size_t n;
+
+    f = fmemopen((void *)table, sizeof(table) - 1, "r");
+    TEST_ASSERT(f != NULL);
+    n = trace_swo_map_load(map, 8, f);
+    fclose(f);
+    TEST_EQ(n, 4);
+    TEST_ASSERT(trace_swo_map_find(map, n, 0x0102) == &map[3]);
+    TEST_ASSERT(trace_swo_map_find(map, n, 0x0200) == NULL);
+    TEST_EQ(map[2].fmt[0], '\0');
+
+    memset(&ev, 0, sizeof(ev));
+    ev.id = 0x0100;
+    ev.nargs = 2;
+    ev.seq = 7;
+    ev.words = 3;
+    ev.arg[0] = 3;
+    ev.arg[1] = 0xA5;
+    trace_swo_format(line, sizeof(line), &ev, &map[1]);
+    TEST_ASSERT(strcmp(line, "adc_done ch=3 value=0x00a5") == 0);
+    trace_swo_csv(line, sizeof(line), &ev, &map[1]);
+    TEST_ASSERT(strcmp(line, "7,0x0100,adc_done,ok,0,0x00000003,0x000000a5,,") == 0);
+
+    /* 截断：只收到一个参数，第二个不当作 0 输出 */
+    ev.words = 2;
+    ev.status = TRACE_SWO_TRUNCATED;
+    ev.lost = 2;
+    trace_swo_format(line, sizeof(line), &ev, NULL);
+    TEST_ASSERT(strcmp(line, "0x0100 0x00000003 [truncated]") == 0);
+    trace_swo_csv(line, sizeof(line), &ev, NULL);
+    TEST_ASSERT(strcmp(line, "7,0x0100,,truncated,2,0x00000003,,,") == 0);
+    trace_swo_format(line, sizeof(line), &ev, &map[1]);
+    TEST_ASSERT(strcmp(line, "adc_done 0x00000003 [truncated]") == 0);
+
+    ev.id = 0x0101;
+    ev.words = 3;
+    ev.status = TRACE_SWO_OK;
+    trace_swo_format(line, sizeof(line), &ev, &map[2]);
+    TEST_ASSERT(strcmp(line, "evil 0x00000003 0x000000a5") == 0);
+
+    TEST_EQ(trace_swo_format(line, 8, &ev, &map[2]), 7);
+    TEST_EQ(strlen(line), 7);
+}
+
+/**=============================================================================
+ * @brief           每个事件的寄存器访问次数和主机上的耗时
+ *============================================================================*/
+static void test_bench(void)
+{
+    struct timespec t0, t1;
+    rt_uint32_t i, writes;
+    double ns[2];
+    int mode;
+
+    for (mode = 0; mode < 2; mode++)
+    {
+        sim_itm_attach(mode ? (1u << RT_TRACE_ITM_PORT) | (1u << TRACE_ITM_PORT_DATA) : 0);
+        sim_log_start(ITM_BASE, 0x100);
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (i = 0; i < BENCH_EVENTS; i++)
+            TRACE2(ID_A, i, 0xA5A5A5A5u);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        writes = sim_log_count();
+        sim_log_stop();
+        ns[mode] = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / BENCH_EVENTS;
+        printf("   %s: %.2f port writes/event, %.0f ns/event on the host\n",
+               mode ? "itm" : "ram", (double)writes / BENCH_EVENTS, ns[mode]);
+        TEST_EQ(writes, mode ? BENCH_EVENTS * 4u : 0u);
+    }
+    sim_itm_swo_take(swo, sizeof(swo));
+    sim_itm_attach(0);
+}
+
+static void test_main(void)
+{
+    TEST_CASE(test_ring);
+    TEST_CASE(test_framing);
+    TEST_CASE(test_stall);
+    TEST_CASE(test_output);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
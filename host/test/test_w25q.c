@@ -0,0 +1,304 @@
+/**
+  ******************************************************************************
+  * @file			test_w25q.c
+  * @brief			w25q against the NOR command model: random access against a
+  *                 mirror, erase skipping, partial-sector rewrite, the block
+  *                 device interface, write-back time against tSE + n * tPP
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdlib.h>
+#include <string.h>
+#include <rtthread.h>
+#include <w25q.h>
+#include "test.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define CS_PIN              GPIO_PIN_4          /*!< PA4 */
+#define JEDEC_ID            0xEF4017u           /*!< W25Q64，8MB */
+#define MAX_HZ              36000000u
+#define RANDOM_SIZE         (64 * 1024)
+#define RANDOM_OPS          300
+#define SECTOR_SKIP         0x20000u
+#define SECTOR_WHOLE        0x21000u
+#define SECTOR_BENCH        0x30000u
+#define SECTOR_DEV          0x40000u
+#define PP_NS               SIM_US(400)
+#define SE_NS               SIM_MS(45)
+#define FAST_PP_NS          SIM_US(5)           /*!< 功能测试缩短芯片时间 */
+#define FAST_SE_NS          SIM_US(50)
+
+/* Private variables ---------------------------------------------------------*/
+static struct spi_stream_bus bus;
+static struct w25q          flash;
+static rt_uint8_t           mirror[RANDOM_SIZE];
+static rt_uint8_t           buf[W25Q_SECTOR_SIZE], back[W25Q_SECTOR_SIZE];
+
+/* Private function ----------------------------------------------------------*/
+
+static void _fill(rt_uint8_t *p, rt_size_t len)
+{
+    rt_size_t i;
+
+    for (i = 0; i < len; i++)
+        p[i] = (rt_uint8_t)rand();
+}
+
+/**=============================================================================
+ * @brief           SPI1 上挂一片 W25Q64，片选 PA4
+ *============================================================================*/
+static void _setup(void)
+{
+    TEST_EQ(spi_stream_bus_init(&bus, SPI1), RT_EOK);
+    sim_nor_attach(SPI1, GPIOA, CS_PIN, JEDEC_ID);
+    sim_nor_set_timing(FAST_PP_NS, FAST_SE_NS);
+    TEST_EQ(w25q_init(&flash, &bus, GPIOA, CS_PIN, MAX_HZ), RT_EOK);
+    TEST_EQ(flash.jedec_id, JEDEC_ID);
+    TEST_EQ(flash.size, sim_nor_size());
+}
+
+/**=============================================================================
+ * @brief           随机地址和长度的读写与镜像一致，写回后芯片内容也一致
+ *============================================================================*/
+static void test_random(void)
+{
+    rt_uint32_t addr, len;
+    int i;
+
+    srand(20);
+    memset(mirror, 0xFF, sizeof(mirror));
+    for (i = 0; i < RANDOM_OPS; i++)
+    {
+        addr = (rt_uint32_t)rand() % RANDOM_SIZE;
+        len  = 1 + (rt_uint32_t)rand() % 600;
+        if (len > RANDOM_SIZE - addr)
+            len = RANDOM_SIZE - addr;
+
+        if (rand() & 1)
+        {
+            _fill(buf, len);
+            TEST_EQ(w25q_write(&flash, addr, buf, len), RT_EOK);
+            memcpy(mirror + addr, buf, len);
+        }
+        else
+        {
+            TEST_EQ(w25q_read(&flash, addr, back, len), RT_EOK);
+            TEST_MEM_EQ(back, mirror + addr, len);
+        }
+    }
+
+    TEST_EQ(w25q_flush(&flash), RT_EOK);
+    TEST_MEM_EQ(sim_nor_image(), mirror, RANDOM_SIZE);
+    TEST_EQ(w25q_read(&flash, flash.size, back, 1), -RT_EINVAL);
+    TEST_EQ(sim_nor_violations(), 0);
+}
+
+/**=============================================================================
+ * @brief           只把 1 改成 0 的写入不擦除，只编程改动的页
+ *============================================================================*/
+static void test_erase_skip(void)
+{
+    struct w25q_stats st = flash.stats;
+    rt_uint32_t programs = sim_nor_program_count();
+    rt_uint8_t *image = sim_nor_image() + SECTOR_SKIP;
+
+    /* 跨第 0、1 页 */
+    memset(buf, 0xF0, 200);
+    TEST_EQ(w25q_write(&flash, SECTOR_SKIP + 100, buf, 200), RT_EOK);
+    TEST_EQ(w25q_flush(&flash), RT_EOK);
+    TEST_EQ(flash.stats.erase_skipped, st.erase_skipped + 1);
+    TEST_EQ(flash.stats.erase_count, st.erase_count);
+    TEST_EQ(flash.stats.program_count, st.program_count + 2);
+    TEST_EQ(flash.stats.program_skipped, st.program_skipped + W25Q_SECTOR_PAGES - 2);
+    TEST_EQ(sim_nor_program_count(), programs + 2);
+    TEST_EQ(sim_nor_erase_count(SECTOR_SKIP), 0);
+    TEST_MEM_EQ(image + 100, buf, 200);
+
+    /* 0xF0 -> 0x30 仍然只清位，只动第 1 页 */
+    memset(buf, 0x30, 50);
+    TEST_EQ(w25q_write(&flash, SECTOR_SKIP + 260, buf, 50), RT_EOK);
+    TEST_EQ(w25q_flush(&flash), RT_EOK);
+    TEST_EQ(flash.stats.erase_count, st.erase_count);
+    TEST_EQ(flash.stats.program_count, st.program_count + 3);
+    TEST_EQ(sim_nor_erase_count(SECTOR_SKIP), 0);
+    TEST_EQ(image[259], 0xF0);
+    TEST_EQ(image[260], 0x30);
+    TEST_EQ(image[310], 0xFF);
+
+    /* 没有改动时不写回 */
+    TEST_EQ(w25q_flush(&flash), RT_EOK);
+    TEST_EQ(sim_nor_program_count(), programs + 3);
+    TEST_EQ(sim_nor_violations(), 0);
+}
+
+/**=============================================================================
+ * @brief           需要把 0 改成 1 的部分写入擦除整个扇区，其余内容保留，
+ *                  全为 0xFF 的页不编程；整扇区覆盖不先读出
+ *============================================================================*/
+static void test_partial(void)
+{
+    struct w25q_stats st = flash.stats;
+    rt_uint8_t *image = sim_nor_image();
+    rt_uint32_t programs;
+
+    memcpy(back, image + SECTOR_SKIP, W25Q_SECTOR_SIZE);
+    back[200] = 0x0F;
+    TEST_EQ(w25q_write(&flash, SECTOR_SKIP + 200, &back[200], 1), RT_EOK);
+    programs = sim_nor_program_count();
+    TEST_EQ(w25q_flush(&flash), RT_EOK);
+    TEST_EQ(flash.stats.erase_count, st.erase_count + 1);
+    TEST_EQ(sim_nor_erase_count(SECTOR_SKIP), 1);
+    TEST_EQ(sim_nor_program_count(), programs + 2);
+    TEST_MEM_EQ(image + SECTOR_SKIP, back, W25Q_SECTOR_SIZE);
+
+    /* 换扇区时写回，只有第 3 页有数据 */
+    memset(buf, 0xFF, W25Q_SECTOR_SIZE);
+    _fill(&buf[3 * W25Q_PAGE_SIZE], W25Q_PAGE_SIZE);
+    st = flash.stats;
+    programs = sim_nor_program_count();
+    TEST_EQ(w25q_write(&flash, SECTOR_WHOLE, buf, W25Q_SECTOR_SIZE), RT_EOK);
+    TEST_EQ(w25q_flush(&flash), RT_EOK);
+    TEST_EQ(flash.stats.cache_misses, st.cache_misses + 1);
+    TEST_EQ(flash.stats.erase_count, st.erase_count + 1);
+    TEST_EQ(sim_nor_erase_count(SECTOR_WHOLE), 1);
+    TEST_EQ(sim_nor_program_count(), programs + 1);
+    TEST_EQ(flash.stats.program_skipped, st.program_skipped + W25Q_SECTOR_PAGES - 1);
+    TEST_MEM_EQ(image + SECTOR_WHOLE, buf, W25Q_SECTOR_SIZE);
+
+    /* 相邻扇区不受影响 */
+    TEST_EQ(sim_nor_erase_count(SECTOR_WHOLE + W25Q_SECTOR_SIZE), 0);
+    TEST_EQ(image[SECTOR_WHOLE + W25Q_SECTOR_SIZE], 0xFF);
+    TEST_EQ(sim_nor_violations(), 0);
+}
+
+/**=============================================================================
+ * @brief           块设备接口：按扇区读写，几何参数，SYNC 写回缓存，
+ *                  ERASE [start, end) 丢弃缓存中未写回的扇区
+ *============================================================================*/
+static void test_device(void)
+{
+    struct rt_device_blk_geometry geo = {0};
+    rt_uint32_t first = SECTOR_DEV / W25Q_SECTOR_SIZE, range[2];
+    rt_uint8_t *image = sim_nor_image() + SECTOR_DEV;
+    rt_uint32_t programs, erases[2], i;
+    rt_device_t dev;
+
+    TEST_EQ(w25q_register(&flash, "w25q"), RT_EOK);
+    dev = rt_device_find("w25q");
+    TEST_ASSERT(dev == &flash.parent);
+    TEST_EQ(dev->type, RT_Device_Class_Block);
+
+    TEST_EQ(rt_device_control(dev, RT_DEVICE_CTRL_BLK_GETGEOME, &geo), RT_EOK);
+    TEST_EQ(geo.bytes_per_sector, W25Q_SECTOR_SIZE);
+    TEST_EQ(geo.block_size, W25Q_SECTOR_SIZE);
+    TEST_EQ(geo.sector_count, flash.size / W25Q_SECTOR_SIZE);
+    TEST_EQ(rt_device_control(dev, RT_DEVICE_CTRL_BLK_GETGEOME, RT_NULL), -RT_EINVAL);
+
+    /* 写入先留在缓存，SYNC 后才到芯片 */
+    srand(21);
+    _fill(buf, W25Q_SECTOR_SIZE);
+    TEST_EQ(rt_device_write(dev, first, buf, 1), 1);
+    TEST_EQ(flash.cache_sector, SECTOR_DEV);
+    TEST_ASSERT(flash.dirty != 0);
+    TEST_ASSERT(memcmp(image, buf, W25Q_SECTOR_SIZE) != 0);
+    TEST_EQ(rt_device_read(dev, first, back, 1), 1);
+    TEST_MEM_EQ(back, buf, W25Q_SECTOR_SIZE);
+    TEST_EQ(rt_device_control(dev, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL), RT_EOK);
+    TEST_EQ(flash.dirty, 0);
+    TEST_MEM_EQ(image, buf, W25Q_SECTOR_SIZE);
+
+    /* 一次读两个扇区，第二个还是擦除状态 */
+    TEST_EQ(rt_device_read(dev, first, mirror, 2), 2);
+    TEST_MEM_EQ(mirror, buf, W25Q_SECTOR_SIZE);
+    for (i = 0; i < W25Q_SECTOR_SIZE && mirror[W25Q_SECTOR_SIZE + i] == 0xFF; i++)
+        ;
+    TEST_EQ(i, W25Q_SECTOR_SIZE);
+
+    /* 第二个扇区的改动只在缓存里，擦除后作废，SYNC 不再编程 */
+    _fill(buf, W25Q_SECTOR_SIZE);
+    TEST_EQ(rt_device_write(dev, first + 1, buf, 1), 1);
+    TEST_EQ(flash.cache_sector, SECTOR_DEV + W25Q_SECTOR_SIZE);
+    programs  = sim_nor_program_count();
+    erases[0] = sim_nor_erase_count(SECTOR_DEV);
+    erases[1] = sim_nor_erase_count(SECTOR_DEV + W25Q_SECTOR_SIZE);
+    range[0] = first;
+    range[1] = first + 2;
+    TEST_EQ(rt_device_control(dev, RT_DEVICE_CTRL_BLK_ERASE, range), RT_EOK);
+    TEST_EQ(flash.cache_sector, W25Q_NO_SECTOR);
+    TEST_EQ(rt_device_control(dev, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL), RT_EOK);
+    TEST_EQ(sim_nor_program_count(), programs);
+    TEST_EQ(sim_nor_erase_count(SECTOR_DEV), erases[0] + 1);
+    TEST_EQ(sim_nor_erase_count(SECTOR_DEV + W25Q_SECTOR_SIZE), erases[1] + 1);
+    TEST_EQ(sim_nor_erase_count(SECTOR_DEV + 2 * W25Q_SECTOR_SIZE), 0);
+    TEST_EQ(rt_device_read(dev, first, mirror, 2), 2);
+    for (i = 0; i < 2 * W25Q_SECTOR_SIZE && mirror[i] == 0xFF; i++)
+        ;
+    TEST_EQ(i, 2 * W25Q_SECTOR_SIZE);
+
+    range[0] = first + 1;
+    range[1] = first;
+    TEST_EQ(rt_device_control(dev, RT_DEVICE_CTRL_BLK_ERASE, range), -RT_EINVAL);
+    TEST_EQ(rt_device_read(dev, geo.sector_count, back, 1), 0);
+    TEST_EQ(sim_nor_violations(), 0);
+}
+
+/**=============================================================================
+ * @brief           整扇区写回的时间与 tSE + 16 * tPP 加线上时间比较，
+ *                  快速读的每 SCK 字节数
+ *============================================================================*/
+static void test_bench(void)
+{
+    rt_uint64_t t0, elapsed, ideal, sck_ns, bits;
+    rt_uint32_t polls;
+
+    srand(21);
+    _fill(buf, W25Q_SECTOR_SIZE);
+    TEST_EQ(w25q_write(&flash, SECTOR_BENCH, buf, W25Q_SECTOR_SIZE), RT_EOK);
+
+    sim_nor_set_timing(PP_NS, SE_NS);
+    sck_ns = sim_cycles_to_ns(2u << ((SPI1->CR1 & SPI_CR1_BR) >> SPI_CR1_BR_Pos), HAL_RCC_GetPCLK2Freq());
+    polls = sim_nor_status_polls();
+    t0 = sim_time();
+    TEST_EQ(w25q_flush(&flash), RT_EOK);
+    elapsed = sim_time() - t0;
+    polls = sim_nor_status_polls() - polls;
+    TEST_MEM_EQ(sim_nor_image() + SECTOR_BENCH, buf, W25Q_SECTOR_SIZE);
+
+    /* 擦除：写使能 + 4 字节命令；每页：写使能 + 4 字节命令 + 256 字节数据 */
+    ideal = SE_NS + W25Q_SECTOR_PAGES * PP_NS +
+            (5 + W25Q_SECTOR_PAGES * (5 + W25Q_PAGE_SIZE)) * 8 * sck_ns;
+    printf("   sector write-back %.2f ms, tSE + 16 tPP + wire %.2f ms (%.1f%% over), "
+           "%u status polls\n", elapsed / 1e6, ideal / 1e6,
+           100.0 * ((double)elapsed - ideal) / ideal, (unsigned)polls);
+    TEST_ASSERT(elapsed >= ideal);
+    TEST_ASSERT(elapsed < ideal + SIM_MS(2));
+
+    /* 不在缓存中的扇区从芯片读 */
+    bits = sim_spi_bits(SPI1);
+    TEST_EQ(w25q_read(&flash, SECTOR_SKIP, back, W25Q_SECTOR_SIZE), RT_EOK);
+    bits = sim_spi_bits(SPI1) - bits;
+    TEST_MEM_EQ(back, sim_nor_image() + SECTOR_SKIP, W25Q_SECTOR_SIZE);
+    printf("   fast read 4096 bytes: %.4f bytes/SCK\n", (double)W25Q_SECTOR_SIZE / bits);
+    TEST_EQ(sim_nor_violations(), 0);
+}
+
+static void test_main(void)
+{
+    _setup();
+    TEST_CASE(test_random);
+    TEST_CASE(test_erase_skip);
+    TEST_CASE(test_partial);
+    TEST_CASE(test_device);
+    TEST_CASE(test_bench);
+}
+
+int main(void)
+{
+    return sim_run(test_main, SIM_BOOT_BOARD);
+}
@@ -0,0 +1,152 @@
+/**
+  ******************************************************************************
+  * @file			trace_decode.c
+  * @brief			turn a captured SWO stream of trace events into text or CSV
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace_swo.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define MAP_MAX             1024
+
+/* Private typedef -----------------------------------------------------------*/
+struct output
+{
+    const struct trace_swo_map *map;
+    size_t              map_count;
+    double              hz;                 /*!< DWT 计数频率，0 时只输出周期数 */
+    int                 csv;
+    uint64_t            wraps;              /*!< 32 位时间戳回绕展开 */
+    uint32_t            last_ts;
+};
+
+/* Private variables ---------------------------------------------------------*/
+static struct trace_swo_map map[MAP_MAX];
+
+/* Private function ----------------------------------------------------------*/
+
+static void _usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [-p port] [-m map] [-f hz] [-c] [swo.bin]\n"
+            "  -p port  ITM port of the event headers, arguments on port+1 (default 1)\n"
+            "  -m map   id table, one line per event: <id> <name> [printf format]\n"
+            "  -f hz    DWT clock, prints seconds instead of cycles\n"
+            "  -c       CSV output\n",
+            prog);
+}
+
+static void _emit(const struct trace_swo_event *ev, void *arg)
+{
+    struct output *out = arg;
+    const struct trace_swo_map *m = trace_swo_map_find(out->map, out->map_count, ev->id);
+    char body[512];
+    uint64_t ts;
+
+    if (ev->words > 0)
+    {
+        if (ev->timestamp < out->last_ts)
+            out->wraps += 1ull << 32;
+        out->last_ts = ev->timestamp;
+    }
+    ts = out->wraps + out->last_ts;
+
+    if (out->csv)
+    {
+        trace_swo_csv(body, sizeof(body), ev, m);
+        printf("%llu,", (unsigned long long)ts);
+        if (out->hz > 0)
+            printf("%.9f", ts / out->hz);
+        printf(",%s\n", body);
+        return;
+    }
+
+    if (ev->lost)
+        printf("-- %u events lost --\n", ev->lost);
+    trace_swo_format(body, sizeof(body), ev, m);
+    if (out->hz > 0)
+        printf("%14.6f  #%-3u  %s\n", ts / out->hz, ev->seq, body);
+    else
+        printf("%14llu  #%-3u  %s\n", (unsigned long long)ts, ev->seq, body);
+}
+
+int main(int argc, char **argv)
+{
+    struct trace_swo dec;
+    struct output out;
+    uint8_t buf[4096];
+    unsigned long port = 1;
+    FILE *in = stdin, *f;
+    size_t n;
+    int opt;
+
+    memset(&out, 0, sizeof(out));
+    out.map = map;
+
+    while ((opt = getopt(argc, argv, "p:m:f:ch")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            port = strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            f = fopen(optarg, "r");
+            if (f == NULL)
+            {
+                perror(optarg);
+                return 1;
+            }
+            out.map_count = trace_swo_map_load(map, MAP_MAX, f);
+            fclose(f);
+            break;
+        case 'f':
+            out.hz = strtod(optarg, NULL);
+            break;
+        case 'c':
+            out.csv = 1;
+            break;
+        default:
+            _usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (port > 30)
+    {
+        _usage(argv[0]);
+        return 1;
+    }
+    if (optind < argc && strcmp(argv[optind], "-") != 0)
+    {
+        in = fopen(argv[optind], "rb");
+        if (in == NULL)
+        {
+            perror(argv[optind]);
+            return 1;
+        }
+    }
+
+    if (out.csv)
+        printf("cycles,seconds,seq,id,name,status,lost,arg0,arg1,arg2,arg3\n");
+
+    trace_swo_init(&dec, (uint32_t)port, _emit, &out);
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+        trace_swo_feed(&dec, buf, n);
+    trace_swo_flush(&dec);
+
+    fprintf(stderr, "%u events, %u truncated, %u lost, %u bad headers, %u orphan words, %u overflows\n",
+            dec.events, dec.truncated, dec.lost, dec.bad_headers, dec.orphans, dec.overflows);
+
+    return 0;
+}
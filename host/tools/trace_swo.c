@@ -0,0 +1,331 @@
+/**
+  ******************************************************************************
+  * @file			trace_swo.c
+  * @brief			host-side decoder for the trace event stream on SWO
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+/* Includes ------------------------------------------------------------------*/
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace_swo.h"
+
+/* Private constants ---------------------------------------------------------*/
+#define SWO_NEED_CONT       0xFFu           /*!< 包长度由续接位决定 */
+
+/* Private macro -------------------------------------------------------------*/
+/* 与 USER/trace.h 的 TRACE_HDR 一致 */
+#define HDR_ID(hdr)         ((uint16_t)((hdr) >> 16))
+#define HDR_NARGS(hdr)      (((hdr) >> 12) & 0xFu)
+#define HDR_SEQ(hdr)        ((uint8_t)((hdr) & 0xFFu))
+#define HDR_VALID(hdr)      (((hdr) & 0x0F00u) == 0 && HDR_NARGS(hdr) <= TRACE_SWO_ARGS_MAX)
+
+/* Private function ----------------------------------------------------------*/
+
+static void _emit(struct trace_swo *d)
+{
+    d->cur.status = d->cur.words == d->cur.nargs + 1u ? TRACE_SWO_OK : TRACE_SWO_TRUNCATED;
+    d->events++;
+    if (d->cur.status != TRACE_SWO_OK)
+        d->truncated++;
+    d->have = 0;
+    if (d->emit)
+        d->emit(&d->cur, d->arg);
+}
+
+/**=============================================================================
+ * @brief           事件首字：结束上一条，校验格式，按序号统计丢失
+ *============================================================================*/
+static void _on_header(struct trace_swo *d, uint32_t hdr)
+{
+    if (d->have)
+        _emit(d);
+
+    if (!HDR_VALID(hdr))
+    {
+        d->bad_headers++;
+        return;
+    }
+
+    memset(&d->cur, 0, sizeof(d->cur));
+    d->cur.id    = HDR_ID(hdr);
+    d->cur.nargs = (uint8_t)HDR_NARGS(hdr);
+    d->cur.seq   = HDR_SEQ(hdr);
+    if (d->seq_valid)
+        d->cur.lost = (uint8_t)(d->cur.seq - d->next_seq);
+    d->lost     += d->cur.lost;
+    d->next_seq  = (uint8_t)(d->cur.seq + 1u);
+    d->seq_valid = 1;
+    d->have      = 1;
+}
+
+static void _on_data(struct trace_swo *d, uint32_t word)
+{
+    if (!d->have || d->cur.words > d->cur.nargs)
+    {
+        d->orphans++;
+        return;
+    }
+
+    if (d->cur.words == 0)
+        d->cur.timestamp = word;
+    else
+        d->cur.arg[d->cur.words - 1u] = word;
+    if (++d->cur.words == d->cur.nargs + 1u)
+        _emit(d);
+}
+
+/**=============================================================================
+ * @brief           一个完整的软件源包
+ *============================================================================*/
+static void _on_packet(struct trace_swo *d, uint32_t port, uint32_t size, uint32_t val)
+{
+    if (port != d->port && port != d->port + 1u)
+        return;
+
+    /* 固件只按字写，其他长度说明流已损坏，丢弃当前事件 */
+    if (size != 4u)
+    {
+        if (d->have)
+            _emit(d);
+        d->bad_headers++;
+        return;
+    }
+
+    if (port == d->port)
+        _on_header(d, val);
+    else
+        _on_data(d, val);
+}
+
+/**=============================================================================
+ * @brief           初始化解码器
+ *
+ * @param[in]       d    解码器
+ * @param[in]       port 事件首字的 ITM 端口（RT_TRACE_ITM_PORT）
+ * @param[in]       emit 每解出一条事件调用一次
+ * @param[in]       arg  回调参数
+ *============================================================================*/
+void trace_swo_init(struct trace_swo *d, uint32_t port, trace_swo_emit_t emit, void *arg)
+{
+    memset(d, 0, sizeof(*d));
+    d->port = port;
+    d->emit = emit;
+    d->arg  = arg;
+}
+
+/**=============================================================================
+ * @brief           输入 SWO 字节流，可以分多次输入任意长度
+ *
+ * @note            按 ARMv7-M ITM 协议识别同步、溢出、时间戳、扩展和硬件源
+ *                  包并跳过，只处理软件源包
+ *============================================================================*/
+void trace_swo_feed(struct trace_swo *d, const uint8_t *buf, size_t len)
+{
+    uint8_t b;
+    size_t i;
+
+    for (i = 0; i < len; i++)
+    {
+        b = buf[i];
+
+        if (d->need == SWO_NEED_CONT)
+        {
+            if ((b & 0x80u) == 0)
+                d->need = 0;
+            continue;
+        }
+        if (d->need)
+        {
+            d->val |= (uint32_t)b << (d->got * 8u);
+            d->got++;
+            if (--d->need == 0 && (d->hdr & 0x04u) == 0)
+                _on_packet(d, d->hdr >> 3, d->got, d->val);
+            continue;
+        }
+
+        /* 包头 */
+        if (b == 0x00u || b == 0x80u)
+            continue;                       /* 同步包 */
+        if (b == 0x70u)
+        {
+            d->overflows++;
+            continue;
+        }
+        if (b & 0x03u)
+        {
+            d->hdr  = b;
+            d->need = (uint8_t)(1u << ((b & 0x03u) - 1u));
+            d->got  = 0;
+            d->val  = 0;
+            continue;
+        }
+        /* 本地/全局时间戳和扩展包：最高位为 1 时后面还有续接字节 */
+        if (b & 0x80u)
+            d->need = SWO_NEED_CONT;
+    }
+}
+
+/**=============================================================================
+ * @brief           流结束，输出最后一条未收完的事件
+ *============================================================================*/
+void trace_swo_flush(struct trace_swo *d)
+{
+    if (d->have)
+        _emit(d);
+}
+
+/**=============================================================================
+ * @brief           格式串只允许整数转换且不超过参数个数，否则不用它
+ *============================================================================*/
+static int _fmt_safe(const char *fmt)
+{
+    int convs = 0;
+
+    for (; *fmt; fmt++)
+    {
+        if (*fmt != '%')
+            continue;
+        fmt++;
+        if (*fmt == '%')
+            continue;
+        while (*fmt && strchr("-+ #0", *fmt))
+            fmt++;
+        while (isdigit((unsigned char)*fmt))
+            fmt++;
+        if (*fmt == '\0' || !strchr("diouxXc", *fmt))
+            return 0;
+        convs++;
+    }
+
+    return convs <= TRACE_SWO_ARGS_MAX;
+}
+
+/**=============================================================================
+ * @brief           读 ID 对照表，每行：ID 名称 [格式串]，# 开头为注释
+ *
+ *                  0x0001 boot     SystemCoreClock=%u
+ *                  0x0100 adc_done ch=%u value=%u
+ *
+ * @return          读到的条数
+ *============================================================================*/
+size_t trace_swo_map_load(struct trace_swo_map *map, size_t max, FILE *f)
+{
+    char line[256], name[TRACE_SWO_NAME_MAX];
+    unsigned long id;
+    size_t n = 0;
+    char *p, *end;
+    int off;
+
+    while (n < max && fgets(line, sizeof(line), f))
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        for (p = line; isspace((unsigned char)*p); p++)
+            ;
+        if (*p == '\0' || *p == '#')
+            continue;
+
+        id = strtoul(p, &end, 0);
+        if (end == p || id > 0xFFFFu || sscanf(end, " %31s%n", name, &off) != 1)
+            continue;
+        for (p = end + off; isspace((unsigned char)*p); p++)
+            ;
+
+        map[n].id = (uint16_t)id;
+        snprintf(map[n].name, sizeof(map[n].name), "%s", name);
+        snprintf(map[n].fmt, sizeof(map[n].fmt), "%s", _fmt_safe(p) ? p : "");
+        n++;
+    }
+
+    return n;
+}
+
+const struct trace_swo_map *trace_swo_map_find(const struct trace_swo_map *map, size_t count, uint16_t id)
+{
+    size_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        if (map[i].id == id)
+            return &map[i];
+    }
+
+    return NULL;
+}
+
+/**=============================================================================
+ * @brief           事件正文：有对照表且参数收全时按格式串展开，否则列出名称
+ *                  或 ID 和收到的参数
+ *
+ * @return          写入的字符数，超出 size 时截断
+ *============================================================================*/
+int trace_swo_format(char *buf, size_t size, const struct trace_swo_event *ev,
+                     const struct trace_swo_map *m)
+{
+    unsigned int a[TRACE_SWO_ARGS_MAX] = {0};
+    int nargs = ev->words > 0 ? ev->words - 1 : 0;
+    size_t len;
+    int i;
+
+    if (nargs > ev->nargs)
+        nargs = ev->nargs;
+    for (i = 0; i < nargs; i++)
+        a[i] = ev->arg[i];
+
+    if (size == 0)
+        return 0;
+    if (m)
+        len = snprintf(buf, size, "%s", m->name);
+    else
+        len = snprintf(buf, size, "0x%04x", ev->id);
+
+    /* 参数不全时格式串会把缺的参数显示成 0，改为列出收到的参数 */
+    if (len < size && m && m->fmt[0] && nargs == ev->nargs)
+    {
+        len += snprintf(buf + len, size - len, " ");
+        if (len < size)
+            len += snprintf(buf + len, size - len, m->fmt, a[0], a[1], a[2], a[3]);
+    }
+    else
+    {
+        for (i = 0; i < nargs && len < size; i++)
+            len += snprintf(buf + len, size - len, " 0x%08x", a[i]);
+    }
+    if (len < size && ev->status == TRACE_SWO_TRUNCATED)
+        len += snprintf(buf + len, size - len, " [truncated]");
+
+    return (int)(len < size ? len : size - 1);
+}
+
+/**=============================================================================
+ * @brief           事件的 CSV 字段：seq,id,name,status,lost,arg0,arg1,arg2,arg3，
+ *                  没收到的参数留空
+ *
+ * @return          写入的字符数，超出 size 时截断
+ *============================================================================*/
+int trace_swo_csv(char *buf, size_t size, const struct trace_swo_event *ev,
+                  const struct trace_swo_map *m)
+{
+    size_t len;
+    int i;
+
+    if (size == 0)
+        return 0;
+    len = snprintf(buf, size, "%u,0x%04x,%s,%s,%u", ev->seq, ev->id, m ? m->name : "",
+                   ev->status == TRACE_SWO_OK ? "ok" : "truncated", ev->lost);
+    for (i = 0; i < TRACE_SWO_ARGS_MAX && len < size; i++)
+    {
+        if (i < ev->nargs && i + 1 < ev->words)
+            len += snprintf(buf + len, size - len, ",0x%08x", ev->arg[i]);
+        else
+            len += snprintf(buf + len, size - len, ",");
+    }
+
+    return (int)(len < size ? len : size - 1);
+}
@@ -0,0 +1,102 @@
+/**
+  ******************************************************************************
+  * @file			trace_swo.h
+  * @brief			host-side decoder for the trace event stream on SWO
+  * @author			Xli
+  * @email			xieliyzh@163.com
+  * @version		1.0.0
+  * @date			2020-06-17
+  * @copyright		2020, XIELI Co.,Ltd. All rights reserved
+  ******************************************************************************
+**/
+
+#ifndef __TRACE_SWO_H_
+#define __TRACE_SWO_H_
+
+/* Includes ------------------------------------------------------------------*/
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C"{
+#endif
+
+/* Exported constants --------------------------------------------------------*/
+#define TRACE_SWO_ARGS_MAX      4
+#define TRACE_SWO_NAME_MAX      32
+#define TRACE_SWO_FMT_MAX       128
+
+/* 事件状态 */
+#define TRACE_SWO_OK            0
+#define TRACE_SWO_TRUNCATED     1           /*!< 首字之后的字数少于参数个数加一 */
+
+/* Exported typedef ----------------------------------------------------------*/
+/**
+ * 一条解出的事件，字段与 USER/trace.h 中的格式一一对应
+ */
+struct trace_swo_event
+{
+    uint16_t    id;
+    uint8_t     nargs;
+    uint8_t     seq;
+    uint8_t     status;
+    uint8_t     words;                      /*!< 收到的时间戳和参数字数 */
+    uint32_t    lost;                       /*!< 按序号推算，在此之前整条丢失的事件数 */
+    uint32_t    timestamp;
+    uint32_t    arg[TRACE_SWO_ARGS_MAX];
+};
+
+typedef void (*trace_swo_emit_t)(const struct trace_swo_event *ev, void *arg);
+
+struct trace_swo
+{
+    uint32_t            port;               /*!< 事件首字的 ITM 端口，参数在下一个端口 */
+    trace_swo_emit_t    emit;
+    void               *arg;
+
+    /* SWO 包解析 */
+    uint8_t             hdr;
+    uint8_t             need;               /*!< 当前包还差的字节数，0xFF 表示以最高位续接 */
+    uint8_t             got;
+    uint32_t            val;
+
+    /* 事件拼接 */
+    int                 have;
+    int                 seq_valid;
+    uint8_t             next_seq;
+    struct trace_swo_event cur;
+
+    /* 统计 */
+    uint32_t            events;
+    uint32_t            truncated;
+    uint32_t            lost;
+    uint32_t            bad_headers;        /*!< 首字格式不对 */
+    uint32_t            orphans;            /*!< 不属于任何事件的参数字 */
+    uint32_t            overflows;          /*!< ITM 溢出包 */
+};
+
+struct trace_swo_map
+{
+    uint16_t    id;
+    char        name[TRACE_SWO_NAME_MAX];
+    char        fmt[TRACE_SWO_FMT_MAX];
+};
+
+/* Exported functions ------------------------------------------------------- */
+void        trace_swo_init(struct trace_swo *d, uint32_t port, trace_swo_emit_t emit, void *arg);
+void        trace_swo_feed(struct trace_swo *d, const uint8_t *buf, size_t len);
+void        trace_swo_flush(struct trace_swo *d);
+
+size_t      trace_swo_map_load(struct trace_swo_map *map, size_t max, FILE *f);
+const struct trace_swo_map *trace_swo_map_find(const struct trace_swo_map *map, size_t count, uint16_t id);
+int         trace_swo_format(char *buf, size_t size, const struct trace_swo_event *ev,
+                             const struct trace_swo_map *m);
+int         trace_swo_csv(char *buf, size_t size, const struct trace_swo_event *ev,
+                          const struct trace_swo_map *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __TRACE_SWO_H_ */